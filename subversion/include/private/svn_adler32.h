@@ -43,6 +43,25 @@ extern "C" {
 apr_uint32_t
 svn__adler32(apr_uint32_t checksum, const char *data, apr_off_t len);
 
+/**
+ * Set SUMS[i] to the pseudo-adler32 checksum of the @a block_size bytes
+ * starting at @a data + i * @a block_size for all 0 <= i < @a count.
+ *
+ * "Pseudo" means that no prime modulus is being applied.  Instead,
+ * the sum of all bytes (s1) and the sum of all partial sums (s2) are
+ * returned as s2 * 0x10000 + s1, modulo 2^32.  This is the rolling
+ * checksum used by our xdelta implementation.
+ *
+ * Uses the same SIMD kernels as svn__adler32(), if available.
+ *
+ * @since New in 1.11.
+ */
+void
+svn__adler32_blocks(apr_uint32_t *sums,
+                    const char *data,
+                    apr_size_t block_size,
+                    apr_size_t count);
+
 
 #ifdef __cplusplus
 }
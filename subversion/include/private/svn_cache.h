@@ -181,6 +181,68 @@ typedef struct svn_cache__info_t
   apr_uint64_t histogram[32];
 } svn_cache__info_t;
 
+/**
+ * Number of buckets in the latency histograms of #svn_cache__prefix_info_t.
+ * Bucket 0 counts operations that took less than a microsecond.  Bucket
+ * @c i counts those that took between 2^(i-1) and 2^i microseconds.
+ * The last bucket also counts all slower operations.
+ */
+#define SVN_CACHE__LATENCY_BUCKETS 16
+
+/**
+ * Access statistics for all membuffer cache front-ends within the current
+ * process that use the same key prefix.  Use
+ * svn_cache__membuffer_get_prefix_info() to get this data.
+ *
+ * Like all other cache statistics, these counters are not synchronized
+ * between threads and may therefore be slightly off.
+ */
+typedef struct svn_cache__prefix_info_t
+{
+  /** The key prefix as passed to svn_cache__create_membuffer_cache().
+   * Prefixes that did not get their own statistics because there were
+   * already too many of them will be accounted for under "(other)".
+   */
+  const char *prefix;
+
+  /** Number of getter calls (svn_cache__get() or
+   * svn_cache__get_partial()).
+   */
+  apr_uint64_t gets;
+
+  /** Number of getter calls that returned data.
+   */
+  apr_uint64_t hits;
+
+  /** Number of setter calls (svn_cache__set() or
+   * svn_cache__set_partial()).
+   */
+  apr_uint64_t sets;
+
+  /** Number of items that svn_cache__is_cachable() rejected because
+   * of their size.
+   */
+  apr_uint64_t rejections;
+
+  /** Number of entries that got removed to make room for new ones.
+   * Not available for caches shared between processes.
+   */
+  apr_uint64_t evictions;
+
+  /** Number of entries and bytes currently stored in the cache, including
+   * keys.  Not available for caches shared between processes.
+   */
+  apr_uint64_t used_entries;
+  apr_uint64_t used_size;
+
+  /** Histograms of the getter and setter latencies, including the time
+   * spent in (de-)serialization.  Only a sample of all calls is being
+   * timed.  See #SVN_CACHE__LATENCY_BUCKETS for the bucket layout.
+   */
+  apr_uint64_t get_latency[SVN_CACHE__LATENCY_BUCKETS];
+  apr_uint64_t set_latency[SVN_CACHE__LATENCY_BUCKETS];
+} svn_cache__prefix_info_t;
+
 /**
  * Creates a new cache in @a *cache_p.  This cache will use @a pool
  * for all of its storage needs.  The elements in the cache will be
@@ -299,6 +361,21 @@ svn_cache__make_memcache_from_config(svn_memcache_t **memcache_p,
  * (no data being written to the cache) if some reader or another writer
  * currently holds the segment lock.
  *
+ * Where supported, readers will first try to access the segment without
+ * taking its lock and only fall back to locking when that attempt
+ * collided with a concurrent write.
+ *
+ * If @a shared is set and the platform supports it, all cache data and
+ * the segment locks will be placed in an anonymous shared memory segment.
+ * Processes forked after this call will then use the same cache contents
+ * as their parent and each other.  In that mode, the cache will always
+ * synchronize access, regardless of @a thread_safe, and will store full
+ * keys only, i.e. it will not use key prefix indexes local to the process.
+ * Lookups may report a miss when they keep colliding with writers.
+ * If shared memory cannot be allocated or the platform lacks robust
+ * process-shared mutexes, this silently falls back to a process-local
+ * cache.
+ *
  * Allocations will be made in @a result_pool, in particular the data buffers.
  */
 svn_error_t *
@@ -308,6 +385,7 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
                                   apr_size_t segment_count,
                                   svn_boolean_t thread_safe,
                                   svn_boolean_t allow_blocking_writes,
+                                  svn_boolean_t shared,
                                   apr_pool_t *result_pool);
 
 /**
@@ -561,6 +639,26 @@ svn_cache__get_global_membuffer_cache(void);
 svn_cache__info_t *
 svn_cache__membuffer_get_global_info(apr_pool_t *pool);
 
+/**
+ * Set @a *infos to an array of #svn_cache__prefix_info_t * containing
+ * copies of the per-prefix statistics of the membuffer @a cache, sorted
+ * by prefix.  If @a reset is set, reset all access counters in @a cache
+ * afterwards.  Allocate the result in @a result_pool.
+ */
+svn_error_t *
+svn_cache__membuffer_get_prefix_info(apr_array_header_t **infos,
+                                     struct svn_membuffer_t *cache,
+                                     svn_boolean_t reset,
+                                     apr_pool_t *result_pool);
+
+/**
+ * Return the information given in @a info formatted as a multi-line string.
+ * Allocations take place in @a result_pool.
+ */
+svn_string_t *
+svn_cache__format_prefix_info(const svn_cache__prefix_info_t *info,
+                              apr_pool_t *result_pool);
+
 /**
  * Remove all current contents from CACHE.
  *
@@ -570,6 +668,110 @@ svn_cache__membuffer_get_global_info(apr_pool_t *pool);
 svn_error_t *
 svn_cache__membuffer_clear(svn_membuffer_t *cache);
 
+/**
+ * Enable or disable lock-free reads in CACHE as specified by @a enable.
+ * They are enabled by default for thread-safe caches on platforms that
+ * support them.  This is meant for tests and benchmarks and must not be
+ * called while other threads use CACHE.  Caches shared between
+ * processes always use lock-free reads.
+ */
+void
+svn_cache__membuffer_set_optimistic_reads(svn_membuffer_t *cache,
+                                          svn_boolean_t enable);
+
+/**
+ * Policies that decide whether a new item may displace existing items
+ * in a membuffer cache.  See svn_cache__membuffer_set_admission_policy().
+ */
+typedef enum svn_cache__admission_policy_t
+{
+  /** Compare the hit counts and priorities of the cached items.  Items
+   * that have not been hit yet will have a hard time getting into a
+   * full cache, but hits are only counted while an item is cached. */
+  svn_cache__admission_hit_count,
+
+  /** Like #svn_cache__admission_hit_count but compare the estimated
+   * access frequencies of the respective keys instead of the hit counts.
+   * Those estimates are tracked for all recently requested keys, cached
+   * or not, similar to TinyLFU.  This makes the cache more resistant to
+   * long scans over data that will not be used again, e.g. during an
+   * export of a large tree or "svnadmin verify".  It costs about one
+   * byte per index entry and a few cycles per lookup. */
+  svn_cache__admission_frequency
+} svn_cache__admission_policy_t;
+
+/**
+ * Select the admission @a policy to use for @a cache.  The default is
+ * #svn_cache__admission_hit_count.  This may be called at any time but
+ * access frequencies will only be tracked while @a policy is
+ * #svn_cache__admission_frequency.
+ */
+void
+svn_cache__membuffer_set_admission_policy(
+  svn_membuffer_t *cache,
+  svn_cache__admission_policy_t policy);
+
+/**
+ * Declare that the contents of all cache entries in @a cache whose key
+ * prefix starts with @a root are consistent with the data source state
+ * described by @a stamp, e.g. a repository's UUID and youngest revision.
+ * Only entries covered by a stamp will be written to snapshots.
+ *
+ * If a snapshot has been loaded into @a cache and it contains entries
+ * for @a root that have been stamped with the same @a stamp, copy them
+ * into @a cache.  Entries for @a root that carry a different stamp will
+ * be discarded.  So, this should be called before reading any data for
+ * @a root from @a cache.
+ *
+ * The stamps are stored in @a cache itself, i.e. they will be visible to
+ * all processes sharing the same cache.  Use @a scratch_pool for
+ * temporary allocations.
+ */
+svn_error_t *
+svn_cache__membuffer_set_stamp(svn_membuffer_t *cache,
+                               const char *root,
+                               const char *stamp,
+                               apr_pool_t *scratch_pool);
+
+/**
+ * Write all stamped entries of @a cache to a snapshot file at @a path.
+ * See svn_cache__membuffer_set_stamp().  Entries of the previously
+ * loaded snapshot whose stamps have not been confirmed, yet, will be
+ * carried over.  An existing file at @a path will be replaced
+ * atomically but never by an empty snapshot.  Use @a scratch_pool for
+ * temporary allocations.
+ *
+ * Other threads and processes may continue to use @a cache but their
+ * changes may or may not be included in the snapshot.
+ */
+svn_error_t *
+svn_cache__membuffer_save(svn_membuffer_t *cache,
+                          const char *path,
+                          apr_pool_t *scratch_pool);
+
+/**
+ * Prepare @a cache to reload the entries stored in the snapshot file at
+ * @a path.  This only reads the list of stamps in that file.  The
+ * entries themselves will be loaded once their stamps are confirmed by
+ * svn_cache__membuffer_set_stamp() and their checksums have been
+ * verified.  Replaces any previously loaded snapshot.  If the file at
+ * @a path gets replaced or removed, entries that have not been loaded
+ * at that point will simply be discarded.  Use @a scratch_pool for
+ * temporary allocations.
+ */
+svn_error_t *
+svn_cache__membuffer_load(svn_membuffer_t *cache,
+                          const char *path,
+                          apr_pool_t *scratch_pool);
+
+/**
+ * Return TRUE if svn_cache__membuffer_load() has been called for
+ * @a cache, i.e. if calling svn_cache__membuffer_set_stamp() is of any
+ * use.  Loading does not need to have succeeded.
+ */
+svn_boolean_t
+svn_cache__membuffer_uses_snapshots(svn_membuffer_t *cache);
+
 /** @} */
 
 
@@ -0,0 +1,108 @@
+/**
+ * @copyright
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ * @endcopyright
+ *
+ * @file svn_cpu.h
+ * @brief Run-time detection of CPU features used by our SIMD kernels
+ */
+
+#ifndef SVN_CPU_H
+#define SVN_CPU_H
+
+#include <apr.h>
+#include <apr_pools.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+
+/* Decide which kinds of SIMD kernels we may compile.  All of them can be
+ * disabled by defining SVN_DISABLE_SIMD, in which case only the portable
+ * code will be used.
+ *
+ * On x86, we need a compiler that lets us enable instruction set
+ * extensions on a per-function basis (SVN__TARGET), so that the binary
+ * still runs on CPUs that don't support them.  Which kernel actually gets
+ * used is decided at run-time using svn_cpu__features().
+ *
+ * NEON is part of the AArch64 base line and will therefore be selected
+ * at compile time.
+ */
+#ifndef SVN_DISABLE_SIMD
+#  if (defined(__x86_64__) || defined(__i386__)) \
+      && (defined(__clang__) \
+          || (defined(__GNUC__) \
+              && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#    define SVN__SIMD_X86 1
+#    define SVN__TARGET(features) __attribute__((target(features)))
+#  elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#    define SVN__SIMD_X86 1
+#    define SVN__TARGET(features)
+#  elif defined(__aarch64__) && defined(__ARM_NEON)
+#    define SVN__SIMD_NEON 1
+#  endif
+#endif
+
+/** @name CPU feature flags as returned by svn_cpu__features().
+ * @{
+ */
+#define SVN_CPU__SSE2   0x0001
+#define SVN_CPU__SSSE3  0x0002
+#define SVN_CPU__SSE4_1 0x0004
+#define SVN_CPU__AVX2   0x0008
+#define SVN_CPU__SHA    0x0010
+#define SVN_CPU__NEON   0x0100
+/** @} */
+
+/* Return the set of SVN_CPU__* features that are supported by the CPU
+ * and operating system we are running on *and* that our SIMD kernels
+ * have been compiled for.  The result is further limited by the mask
+ * set through svn_cpu__set_features_mask().
+ *
+ * This function is cheap enough to be called for every kernel invocation.
+ */
+apr_uint32_t
+svn_cpu__features(void);
+
+/* Restrict the set of features reported by svn_cpu__features() to those
+ * in MASK and return the previous mask.  Passing 0 will force all users
+ * to fall back to their portable implementations.
+ *
+ * This is meant for tests and benchmarks that want to compare the
+ * various kernels.  It is not thread-safe w.r.t. concurrent kernel usage
+ * in the sense that other threads may see the change at any time.
+ */
+apr_uint32_t
+svn_cpu__set_features_mask(apr_uint32_t mask);
+
+/* Return a space-separated list of the names of all FEATURES, e.g. for
+ * diagnostic output, allocated in POOL.  Returns "none" if FEATURES is 0.
+ */
+const char *
+svn_cpu__features_string(apr_uint32_t features,
+                         apr_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SVN_CPU_H */
@@ -102,12 +102,139 @@ svn_delta__delta_from_editor(const svn_delta_editor_t **deditor,
                              apr_pool_t *pool);
 
 /** Read the txdelta window header from @a stream and return the total
-    length of the unparsed window data in @a *window_len. */
+    length of the unparsed window data in @a *window_len.
+    @a svndiff_version is the version byte from the svndiff header. */
 svn_error_t *
 svn_txdelta__read_raw_window_len(apr_size_t *window_len,
                                  svn_stream_t *stream,
+                                 int svndiff_version,
                                  apr_pool_t *pool);
 
+/** Compression level that selects the LZ4 HC algorithm when passed to
+ * svn_txdelta_to_svndiff3() and friends together with svndiff version 2.
+ * The result can be read by any svndiff2 decoder.  Don't use it with other
+ * svndiff versions.
+ */
+#define SVN_DELTA__COMPRESSION_LEVEL_LZ4_HC \
+  (SVN_DELTA_COMPRESSION_LEVEL_MAX + 1)
+
+/** Like svn_txdelta_to_svndiff3() but merge consecutive delta windows
+ * into fewer, larger windows of up to 16 times the standard window size.
+ * The svndiff header gets flagged accordingly.
+ *
+ * Only use this if the reader is known to support large windows, i.e.
+ * if it has advertised the respective RA capability.  Any reader from
+ * Subversion 1.11 onwards can parse them.
+ */
+void
+svn_txdelta__to_svndiff_large(svn_txdelta_window_handler_t *handler,
+                              void **handler_baton,
+                              svn_stream_t *output,
+                              int svndiff_version,
+                              int compression_level,
+                              apr_pool_t *pool);
+
+/** Like svn_txdelta_to_svndiff_stream() but produce large windows as
+ * described for svn_txdelta__to_svndiff_large().
+ */
+svn_stream_t *
+svn_txdelta__to_svndiff_stream_large(svn_txdelta_stream_t *txstream,
+                                     int svndiff_version,
+                                     int compression_level,
+                                     apr_pool_t *pool);
+
+/** Compose the @a count delta windows in @a windows into a single window
+ * that turns the source view of the first window into the target view of
+ * the last one.  The windows are ordered oldest first, i.e. the target
+ * view of @a windows[i] is the source view of @a windows[i+1].
+ *
+ * The result is the same as composing the windows pairwise with
+ * svn_txdelta_compose_windows() but no intermediate windows are being
+ * built, which makes a large difference for long delta chains.
+ *
+ * @a count must be at least 1.  Allocate the result in @a pool.
+ */
+svn_txdelta_window_t *
+svn_txdelta__compose_chain(const svn_txdelta_window_t * const *windows,
+                           int count,
+                           apr_pool_t *pool);
+
+/** Like svn_txdelta_to_svndiff3() but compress up to @a max_threads
+ * consecutive windows concurrently on a process-wide pool of worker
+ * threads.  The windows are still written to @a output in order and the
+ * output is identical to that of svn_txdelta_to_svndiff3().
+ *
+ * At most 2 * @a max_threads windows will be buffered at any time.  Like
+ * for svn_txdelta_to_svndiff3(), the caller may reuse the windows passed
+ * to @a *handler after it returns.
+ *
+ * If @a max_threads is less than 2, if @a svndiff_version is 0 (i.e. no
+ * compression) or if APR has no thread support, this is equivalent to
+ * svn_txdelta_to_svndiff3().
+ */
+svn_error_t *
+svn_txdelta__to_svndiff_parallel(svn_txdelta_window_handler_t *handler,
+                                 void **handler_baton,
+                                 svn_stream_t *output,
+                                 int svndiff_version,
+                                 int compression_level,
+                                 int max_threads,
+                                 apr_pool_t *pool);
+
+/** Like svn_txdelta__to_svndiff_parallel() but select the svndiff version
+ * and compression algorithm based on a sample of the first window's new
+ * data:  Already compressed data gets stored as svndiff0, text uses
+ * svndiff1 at @a compression_level and other binary data svndiff2 with
+ * LZ4 HC.  Very small contents use plain svndiff2.
+ *
+ * The reader must support svndiff2.
+ */
+void
+svn_txdelta__to_svndiff_adaptive(svn_txdelta_window_handler_t *handler,
+                                 void **handler_baton,
+                                 svn_stream_t *output,
+                                 int compression_level,
+                                 int max_threads,
+                                 apr_pool_t *pool);
+
+/** Like svn_txdelta2() but compute up to @a max_threads consecutive delta
+ * windows concurrently on a process-wide pool of worker threads.  The
+ * windows are returned in order and are identical to those produced by
+ * svn_txdelta2().
+ *
+ * Source and target data for up to 2 * @a max_threads windows will be
+ * read ahead and buffered.
+ *
+ * If @a max_threads is less than 2 or if APR has no thread support, this
+ * is equivalent to svn_txdelta2().
+ */
+svn_error_t *
+svn_txdelta__parallel(svn_txdelta_stream_t **stream,
+                      svn_stream_t *source,
+                      svn_stream_t *target,
+                      svn_boolean_t calculate_checksum,
+                      int max_threads,
+                      apr_pool_t *pool);
+
+/** Like svn_txdelta_target_push() but compute up to @a max_threads
+ * consecutive delta windows concurrently on a process-wide pool of worker
+ * threads.  @a handler receives the windows in order and they are
+ * identical to those sent by svn_txdelta_target_push().  Return the
+ * writable target stream in @a *stream.
+ *
+ * Up to 2 * @a max_threads windows will be buffered.
+ *
+ * If @a max_threads is less than 2 or if APR has no thread support, this
+ * is equivalent to svn_txdelta_target_push().
+ */
+svn_error_t *
+svn_txdelta__target_push_parallel(svn_stream_t **stream,
+                                  svn_txdelta_window_handler_t handler,
+                                  void *handler_baton,
+                                  svn_stream_t *source,
+                                  int max_threads,
+                                  apr_pool_t *pool);
+
 /* Return a debug editor that wraps @a wrapped_editor.
  *
  * The debug editor simply prints an indication of what callbacks are being
@@ -126,6 +253,38 @@ svn_delta__get_debug_editor(const svn_delta_editor_t **editor,
                             const char *prefix,
                             apr_pool_t *pool);
 
+/** Return in @a *editor and @a *edit_baton an editor that queues all calls
+ * and text delta windows and replays them on @a wrapped_editor in a
+ * separate thread.  This allows the driver to produce the next changes
+ * while the wrapped editor is still busy, e.g. writing to the network or
+ * to disk.
+ *
+ * Up to @a queue_size calls will be buffered.  When the queue is full, the
+ * driver gets blocked until the wrapped editor caught up.  The driver may
+ * reuse or clear all parameters as soon as a call returns.
+ *
+ * Errors returned by @a wrapped_editor are reported by the next call
+ * made by the driver, at the latest by @c close_edit.  Later calls get
+ * discarded.  @c close_edit only returns when all queued calls have been
+ * processed and @c abort_edit discards all pending calls before passing
+ * it on to @a wrapped_editor.
+ *
+ * @a wrapped_editor must not share any state with the driver that is
+ * not thread-safe.  In particular, it must not allocate from pools used
+ * by the driver.  All pools passed to it are thread-safe and independent
+ * from @a pool.
+ *
+ * If @a queue_size is less than 1 or if APR has no thread support, simply
+ * return @a wrapped_editor and @a wrapped_baton.
+ */
+svn_error_t *
+svn_delta__get_threaded_editor(const svn_delta_editor_t **editor,
+                               void **edit_baton,
+                               const svn_delta_editor_t *wrapped_editor,
+                               void *wrapped_baton,
+                               int queue_size,
+                               apr_pool_t *pool);
+
 
 #ifdef __cplusplus
 }
@@ -62,6 +62,22 @@ extern "C" {
 char *
 svn_eol__find_eol_start(char *buf, apr_size_t len);
 
+/* Return a pointer to the first occurrence of any of the characters
+ * @a c1, @a c2 or @a c3 in the array @a buf of length @a len.  Return
+ * @a buf + @a len if there is none.  To look for fewer characters, simply
+ * pass the same value more than once.
+ *
+ * This uses SIMD instructions if supported by the CPU.
+ *
+ * @since New in 1.11
+ */
+const char *
+svn_eol__find_any(const char *buf,
+                  apr_size_t len,
+                  char c1,
+                  char c2,
+                  char c3);
+
 /* Return the first eol marker found in buffer @a buf as a NUL-terminated
  * string, or NULL if no eol marker is found. Do not examine more than
  * @a len bytes in @a buf.
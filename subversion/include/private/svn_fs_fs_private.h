@@ -271,6 +271,29 @@ svn_fs_fs__get_stats(svn_fs_fs__stats_t **stats,
                      apr_pool_t *result_pool,
                      apr_pool_t *scratch_pool);
 
+/* Read-ahead statistics of an FSFS instance.  See the "prefetch-blocks"
+ * option in fsfs.conf.
+ */
+typedef struct svn_fs_fs__prefetch_stats_t
+{
+  /* Number of block ranges handed to the OS to be read ahead. */
+  apr_uint64_t requests;
+
+  /* Number of blocks read from disk that had been requested before. */
+  apr_uint64_t hits;
+
+  /* Number of blocks read from disk that had not been requested. */
+  apr_uint64_t misses;
+} svn_fs_fs__prefetch_stats_t;
+
+/* Return the read-ahead statistics collected by FS since it has been
+ * opened in *STATS.  All counters will be 0, unless FS gives read-ahead
+ * hints.
+ */
+void
+svn_fs_fs__get_prefetch_stats(svn_fs_fs__prefetch_stats_t *stats,
+                              svn_fs_t *fs);
+
 /* A node-revision ID in FSFS consists of 3 sub-IDs ("parts") that consist
  * of a creation REVISION number and some revision- / transaction-local
  * counter value (NUMBER).  Old-style ID parts use global counter values.
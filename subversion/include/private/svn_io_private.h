@@ -91,6 +91,35 @@ svn_io__file_lock_autocreate(const char *lock_file,
 apr_file_t *
 svn_stream__aprfile(svn_stream_t *stream);
 
+/** Callback for svn_stream__get_write_buffer().  Set @a *buffer to at
+ * least @a len bytes of memory that the stream given by @a baton can take
+ * as the data of its next write without copying it.
+ */
+typedef svn_error_t *(*svn_stream__write_buffer_fn_t)(void *baton,
+                                                      char **buffer,
+                                                      apr_size_t len);
+
+/** Set @a stream's write buffer function to @a write_buffer_fn.  It must
+ * be consistent with @a stream's write function, i.e. this should be
+ * called after svn_stream_set_write().
+ */
+void
+svn_stream__set_write_buffer(svn_stream_t *stream,
+                             svn_stream__write_buffer_fn_t write_buffer_fn);
+
+/** Set @a *buffer to at least @a len bytes of memory that the caller may
+ * fill and then pass as data to svn_stream_write() on @a stream.  Streams
+ * that write to memory can thereby avoid copying the data.  The buffer
+ * becomes invalid with any other operation on @a stream.
+ *
+ * Set @a *buffer to NULL if @a stream does not support this.  The caller
+ * has to provide its own buffer then.
+ */
+svn_error_t *
+svn_stream__get_write_buffer(char **buffer,
+                             svn_stream_t *stream,
+                             apr_size_t len);
+
 /* Creates as *INSTALL_STREAM a stream that once completed can be installed
    using Windows checkouts much slower than Unix.
 
@@ -0,0 +1,121 @@
+/**
+ * @copyright
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ * @endcopyright
+ *
+ * @file svn_parallel.h
+ * @brief Processing a sequence of tasks in worker threads
+ */
+
+#ifndef SVN_PARALLEL_H
+#define SVN_PARALLEL_H
+
+#include <apr_pools.h>
+
+#include "svn_types.h"
+#include "svn_error.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#if APR_HAS_THREADS
+
+/** Create the private state of a worker thread in @a *worker_baton.
+ * @a baton is the one given to svn_parallel__run_ordered().  Allocate
+ * the result in @a result_pool, which is owned by the worker, and use
+ * @a scratch_pool for temporary allocations.
+ *
+ * This is called from the thread calling svn_parallel__run_ordered().
+ */
+typedef svn_error_t *
+(*svn_parallel__worker_init_t)(void **worker_baton,
+                               void *baton,
+                               apr_pool_t *result_pool,
+                               apr_pool_t *scratch_pool);
+
+/** Process task number @a task in a worker thread and return its outcome
+ * in @a *result.  @a baton is the one given to svn_parallel__run_ordered()
+ * and @a worker_baton has been created by its worker init function.
+ *
+ * @a cancel_func with @a cancel_baton returns #SVN_ERR_CANCELLED once the
+ * whole run is being aborted.  Allocate @a *result in @a result_pool,
+ * which will be cleared after the result has been reported, and use
+ * @a scratch_pool for temporary allocations.
+ */
+typedef svn_error_t *
+(*svn_parallel__task_func_t)(void **result,
+                             void *baton,
+                             void *worker_baton,
+                             apr_int64_t task,
+                             svn_cancel_func_t cancel_func,
+                             void *cancel_baton,
+                             apr_pool_t *result_pool,
+                             apr_pool_t *scratch_pool);
+
+/** Report the outcome of task number @a task, i.e. the @a result and
+ * error @a task_err returned by the task function.  This function takes
+ * ownership of @a task_err.  Returning an error aborts the whole run.
+ * @a baton is the one given to svn_parallel__run_ordered().  Use
+ * @a scratch_pool for temporary allocations.
+ *
+ * This is called from the thread calling svn_parallel__run_ordered().
+ */
+typedef svn_error_t *
+(*svn_parallel__result_func_t)(void *baton,
+                               apr_int64_t task,
+                               void *result,
+                               svn_error_t *task_err,
+                               apr_pool_t *scratch_pool);
+
+/** Process the tasks @c 0 to @a task_count - 1 by calling @a task_func
+ * from up to @a jobs worker threads and report their outcome through
+ * @a result_func in task order, i.e. in the same order a sequential loop
+ * would.  Workers may run at most @a window tasks ahead of the oldest
+ * task not reported yet.
+ *
+ * If @a init_func is not @c NULL, call it once for each worker before
+ * starting the thread.  Otherwise, the worker batons are @c NULL.  Pass
+ * @a baton to all callbacks.
+ *
+ * Stop at the first error returned by @a init_func or @a result_func and
+ * return it after all workers have finished.  While waiting for a task to
+ * complete, poll @a cancel_func with @a cancel_baton.  Use @a scratch_pool
+ * for temporary allocations.
+ */
+svn_error_t *
+svn_parallel__run_ordered(apr_int64_t task_count,
+                          int jobs,
+                          int window,
+                          svn_parallel__worker_init_t init_func,
+                          svn_parallel__task_func_t task_func,
+                          svn_parallel__result_func_t result_func,
+                          void *baton,
+                          svn_cancel_func_t cancel_func,
+                          void *cancel_baton,
+                          apr_pool_t *scratch_pool);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SVN_PARALLEL_H */
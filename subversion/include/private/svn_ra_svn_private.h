@@ -132,6 +132,17 @@ svn_ra_svn__set_capabilities(svn_ra_svn_conn_t *conn,
 int
 svn_ra_svn__svndiff_version(svn_ra_svn_conn_t *conn);
 
+/** Like svn_txdelta_to_svndiff3() but use the svndiff version and
+ * compression level preferred for connection @a conn.  Send large svndiff
+ * windows if the other side accepts them.
+ */
+void
+svn_ra_svn__to_svndiff(svn_txdelta_window_handler_t *handler,
+                       void **handler_baton,
+                       svn_stream_t *output,
+                       svn_ra_svn_conn_t *conn,
+                       apr_pool_t *pool);
+
 
 /**
  * Set the shim callbacks to be used by @a conn to @a shim_callbacks.
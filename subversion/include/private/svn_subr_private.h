@@ -295,6 +295,99 @@ svn_checksum__wrap_write_stream_fnv1a_32x4(apr_uint32_t *digest,
                                            svn_stream_t *inner_stream,
                                            apr_pool_t *pool);
 
+/**
+ * Return a stream that calculates both, a MD5 and a SHA-1 checksum, over
+ * all data written to the @a inner_stream.  When the returned stream gets
+ * closed, write the checksums to @a *md5_checksum and @a *sha1_checksum,
+ * respectively.  Allocate the result in @a pool.
+ *
+ * This is equivalent to but faster than wrapping the stream twice with
+ * svn_checksum__wrap_write_stream().
+ *
+ * @note The stream returned only supports #svn_stream_write and
+ * #svn_stream_close.
+ *
+ * @since New in 1.11
+ */
+svn_stream_t *
+svn_checksum__wrap_write_stream_md5_sha1(svn_checksum_t **md5_checksum,
+                                         svn_checksum_t **sha1_checksum,
+                                         svn_stream_t *inner_stream,
+                                         apr_pool_t *pool);
+
+/**
+ * Opaque context to calculate MD5 and SHA-1 checksums over the same data
+ * in a single pass.
+ *
+ * Most of our storage layers need both checksums for every file content.
+ * Feeding the data into a single context is faster than using two
+ * separate #svn_checksum_ctx_t because the data is read only once and
+ * we use hardware-accelerated SHA-1 where available.
+ *
+ * @since New in 1.11
+ */
+typedef struct svn_checksum__md5_sha1_ctx_t svn_checksum__md5_sha1_ctx_t;
+
+/**
+ * Return a new fused MD5 / SHA-1 checksum context allocated in @a pool.
+ *
+ * @since New in 1.11
+ */
+svn_checksum__md5_sha1_ctx_t *
+svn_checksum__md5_sha1_ctx_create(apr_pool_t *pool);
+
+/**
+ * Reset the fused MD5 / SHA-1 checksum context @a ctx to initial state.
+ *
+ * @since New in 1.11
+ */
+void
+svn_checksum__md5_sha1_ctx_reset(svn_checksum__md5_sha1_ctx_t *ctx);
+
+/**
+ * Feed @a len bytes of @a data into the fused checksum context @a ctx.
+ *
+ * @since New in 1.11
+ */
+void
+svn_checksum__md5_sha1_update(svn_checksum__md5_sha1_ctx_t *ctx,
+                              const void *data,
+                              apr_size_t len);
+
+/**
+ * Finalize the checksums in @a ctx and return them in @a *md5_checksum
+ * and @a *sha1_checksum, allocated in @a pool.  @a ctx must be reset
+ * before it can be used again.
+ *
+ * @since New in 1.11
+ */
+void
+svn_checksum__md5_sha1_final(svn_checksum_t **md5_checksum,
+                             svn_checksum_t **sha1_checksum,
+                             svn_checksum__md5_sha1_ctx_t *ctx,
+                             apr_pool_t *pool);
+
+/**
+ * Calculate checksums of @a kind for all #svn_string_t * elements in
+ * @a contents and return them as an array of #svn_checksum_t * in
+ * @a *checksums, in the same order.
+ *
+ * This is faster than calling svn_checksum() for each element because
+ * it can hash multiple independent texts in parallel using SIMD
+ * instructions.  This is most effective for many short texts.
+ *
+ * Allocate the result in @a result_pool and use @a scratch_pool for
+ * temporaries.
+ *
+ * @since New in 1.11
+ */
+svn_error_t *
+svn_checksum__multi(apr_array_header_t **checksums,
+                    svn_checksum_kind_t kind,
+                    const apr_array_header_t *contents,
+                    apr_pool_t *result_pool,
+                    apr_pool_t *scratch_pool);
+
 /**
  * Return a 32 bit FNV-1a checksum for the first @a len bytes in @a input.
  *
@@ -316,6 +409,22 @@ svn__fnv1a_32(const void *input, apr_size_t len);
 apr_uint32_t
 svn__fnv1a_32x4(const void *input, apr_size_t len);
 
+/**
+ * Set @a digests[i] to the modified FNV-1a checksum as returned by
+ * svn__fnv1a_32x4() for the @a lens[i] bytes in @a data[i] for all
+ * @a count independent messages.
+ *
+ * @note Messages will be hashed in parallel if the CPU supports it.
+ *       Batches of messages with similar lengths work best.
+ *
+ * @since New in 1.11
+ */
+void
+svn__fnv1a_32x4_multi(apr_uint32_t *digests,
+                      const void *const *data,
+                      const apr_size_t *lens,
+                      apr_size_t count);
+
 /** @} */
 
 
@@ -582,6 +691,14 @@ svn_error_t *
 svn__compress_lz4(const void *data, apr_size_t len,
                   svn_stringbuf_t *out);
 
+/* Same as svn__compress_lz4(), but use the slower LZ4 HC algorithm that
+ * achieves a better compression ratio.  The output format is the same,
+ * i.e. use svn__decompress_lz4() to decompress it.
+ */
+svn_error_t *
+svn__compress_lz4_hc(const void *data, apr_size_t len,
+                     svn_stringbuf_t *out);
+
 /* Same as svn__decompress_zlib(), but use LZ4 compression.  The caller
  * should ensure that the size and limit passed to this function do not
  * exceed INT_MAX.
@@ -0,0 +1,57 @@
+/**
+ * @copyright
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ * @endcopyright
+ *
+ * @file svn_thread_pool.h
+ * @brief Process-wide pool of worker threads
+ */
+
+#ifndef SVN_THREAD_POOL_H
+#define SVN_THREAD_POOL_H
+
+#include <apr_thread_pool.h>
+
+#include "svn_error.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#if APR_HAS_THREADS
+
+/** Set @a *threads to the process-wide pool of worker threads that is
+ * shared by all code processing data concurrently, e.g. the parallel
+ * delta computation and the parallel tokenizer of file diffs.  Create it
+ * upon first use.  Tasks should be short-lived and must not wait for
+ * other tasks in the pool.  Use @a scratch_pool for temporary
+ * allocations.
+ */
+svn_error_t *
+svn_thread_pool__get(apr_thread_pool_t **threads,
+                     apr_pool_t *scratch_pool);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SVN_THREAD_POOL_H */
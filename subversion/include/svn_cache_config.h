@@ -83,6 +83,97 @@ svn_cache_config_get(void);
 void
 svn_cache_config_set(const svn_cache_config_t *settings);
 
+/** Extended cache resource settings.  Like #svn_cache_config_t but
+   with additional options.
+
+   @note Do not extend this data structure as this would break binary
+         compatibility.
+
+   @since New in 1.11.
+ */
+typedef struct svn_cache_config2_t
+{
+  /** total cache size in bytes. Please note that this is only soft limit
+     to the total application memory usage and will be exceeded due to
+     temporary objects and other program state.
+     May be 0, resulting in default caching code being used. */
+  apr_uint64_t cache_size;
+
+  /** maximum number of files kept open */
+  apr_size_t file_handle_count;
+
+  /** is this application guaranteed to be single-threaded? */
+  svn_boolean_t single_threaded;
+
+  /** should the cache memory be shared with all processes that this
+     process forks after creating the cache?  This is useful for pre-fork
+     servers: all worker processes will then use the same cache instead
+     of each having their own copy.  Ignored on platforms that don't
+     support fork() and shared memory. */
+  svn_boolean_t shared_memory;
+
+  /** should the cache track how often keys get requested and prefer
+     frequently requested data over newly read data when it is full?
+     This protects the cache contents against being flushed by large
+     scans, e.g. a full export or "svnadmin verify", at the expense of
+     a few more CPU cycles per lookup. */
+  svn_boolean_t scan_resistant;
+
+  /* DON'T add new members here.  Bump struct and API version instead. */
+} svn_cache_config2_t;
+
+/** Like svn_cache_config_get() but return the extended settings.
+
+   @since New in 1.11.
+ */
+const svn_cache_config2_t *
+svn_cache_config_get2(void);
+
+/** Like svn_cache_config_set() but take the extended settings.
+
+   If @a settings->shared_memory is set, this function will create the
+   process-global cache immediately, i.e. the calling process should be
+   the one that will later fork the worker processes.
+
+   @since New in 1.11.
+ */
+void
+svn_cache_config_set2(const svn_cache_config2_t *settings);
+
+/** Write the contents of the process-global cache to a snapshot file
+   at @a path, replacing any existing file at that location.  Only data
+   whose validity can be checked upon reload will be included, i.e.
+   data read from repositories that had been opened after calling
+   svn_cache_config_load_snapshot() and data from the loaded snapshot
+   that has not been used, yet.  If there is nothing to save or no
+   global cache, this is a no-op.
+
+   Use @a scratch_pool for temporary allocations.
+
+   @since New in 1.11.
+ */
+svn_error_t *
+svn_cache_config_save_snapshot(const char *path,
+                               apr_pool_t *scratch_pool);
+
+/** Prepare the process-global cache to be populated with the contents
+   of the snapshot file at @a path, written by
+   svn_cache_config_save_snapshot().  The data for each repository will
+   be copied into the cache once the repository gets opened and only if
+   it has not been modified since the snapshot was taken.  If there is
+   no global cache, this is a no-op.
+
+   Call this after svn_cache_config_set2() and before opening any
+   repository, even if there is no snapshot file yet.  Repositories
+   only track the state needed for snapshots once this has been called.
+   Use @a scratch_pool for temporary allocations.
+
+   @since New in 1.11.
+ */
+svn_error_t *
+svn_cache_config_load_snapshot(const char *path,
+                               apr_pool_t *scratch_pool);
+
 /** @} */
 
 /** @} */
@@ -422,6 +422,25 @@ extern "C" {
 #define SVN_DAV_NS_DAV_SVN_PUT_RESULT_CHECKSUM\
             SVN_DAV_PROP_NS_DAV "svn/put-result-checksum"
 
+/** Presence of this in a DAV header in an OPTIONS response indicates
+ * that the transmitter (in this case, the server) accepts svndiff data
+ * with large windows.
+ *
+ * Clients indicate the same by sending the #SVN_DAV_SVNDIFF_LARGE_WINDOWS
+ * token in the Accept-Encoding header.
+ *
+ * @since New in 1.11.
+ */
+#define SVN_DAV_NS_DAV_SVN_SVNDIFF_LARGE_WINDOWS\
+            SVN_DAV_PROP_NS_DAV "svn/svndiff-large-windows"
+
+/** Accept-Encoding token indicating that the client accepts svndiff data
+ * with large windows.
+ *
+ * @since New in 1.11.
+ */
+#define SVN_DAV_SVNDIFF_LARGE_WINDOWS "svndiff-large-windows"
+
 /** @} */
 
 /** @} */
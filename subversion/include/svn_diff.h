@@ -455,6 +455,23 @@ typedef enum svn_diff_file_ignore_space_t
   svn_diff_file_ignore_space_all
 } svn_diff_file_ignore_space_t;
 
+/** The algorithm used to find the differences between two texts.
+ *
+ * @since New in 1.11.
+ */
+typedef enum svn_diff_file_algorithm_t
+{
+  /** Find a minimal diff, i.e. the longest common subsequence of lines.
+   * This may be slow for large texts with many changes. */
+  svn_diff_file_algorithm_default,
+
+  /** Use the histogram diff algorithm, which anchors the diff on lines
+   * that are rare in both texts.  Much faster for large texts with many
+   * changes or many repeated lines, and often more readable, but the
+   * result is not necessarily minimal. */
+  svn_diff_file_algorithm_histogram
+} svn_diff_file_algorithm_t;
+
 /** Options to control the behaviour of the file diff routines.
  *
  * @since New in 1.4.
@@ -487,6 +504,35 @@ typedef struct svn_diff_file_options_t
    *
    * @since New in 1.9 */
   int context_size;
+
+  /** The algorithm used to compare the lines of the texts.  It only
+   * affects two-way diffs and three-way merges.  The default is
+   * @c svn_diff_file_algorithm_default.
+   *
+   * @since New in 1.11 */
+  svn_diff_file_algorithm_t algorithm;
+
+  /** If non-zero, svn_diff_file_diff3_2() reads and compares at most this
+   * many lines of each file at a time, which bounds its memory usage for
+   * very large files.  The files get split at lines common to all three
+   * of them.  Only regions without any such lines are read as a whole.
+   *
+   * Files with fewer lines than this are merged exactly as without
+   * this option.  For longer files, changes near the splitting points may
+   * be aligned differently.  The default is 0, i.e. no limit.
+   *
+   * @since New in 1.11 */
+  apr_off_t diff3_window_lines;
+
+  /** If at least 2, large files get split into lines and hashed by up to
+   * this many worker threads while the lines read so far are being
+   * compared.  All files of a diff get processed concurrently.  The result
+   * is the same as without this option.  It has no effect if APR has no
+   * thread support and for 3-way diffs with a non-zero
+   * @a diff3_window_lines.  The default is 0, i.e. no worker threads.
+   *
+   * @since New in 1.11 */
+  int max_threads;
 } svn_diff_file_options_t;
 
 /** Allocate a @c svn_diff_file_options_t structure in @a pool, initializing
@@ -510,6 +556,7 @@ svn_diff_file_options_create(apr_pool_t *pool);
  * - --ignore-eol-style
  * - --show-c-function, -p @since New in 1.5.
  * - --context, -U ARG @since New in 1.9.
+ * - --histogram @since New in 1.11.
  * - --unified, -u (for compatibility, does nothing).
  */
 svn_error_t *
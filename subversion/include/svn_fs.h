@@ -166,6 +166,18 @@ typedef struct svn_fs_t svn_fs_t;
  */
 #define SVN_FS_CONFIG_FSFS_LOG_ADDRESSING       "fsfs-log-addressing"
 
+/** String with a decimal representation of the number of worker threads
+ * that svn_fs_verify() may use to check the FSFS format 7 indexes of
+ * different shards concurrently.  Values of 1 or less, as well as the
+ * absence of this option, result in a strictly sequential verification.
+ *
+ * Concurrent verification requires a thread-safe cache configuration,
+ * i.e. #svn_cache_config_t.single_threaded must be @c FALSE.
+ *
+ * @since New in 1.11.
+ */
+#define SVN_FS_CONFIG_FSFS_VERIFY_JOBS          "fsfs-verify-jobs"
+
 /* Note to maintainers: if you add further SVN_FS_CONFIG_FSFS_CACHE_* knobs,
    update fs_fs.c:verify_as_revision_before_current_plus_plus(). */
 
@@ -50,6 +50,7 @@ extern "C" {
 #define SVN_RA_SVN_CAP_EDIT_PIPELINE "edit-pipeline"
 #define SVN_RA_SVN_CAP_SVNDIFF1 "svndiff1"
 #define SVN_RA_SVN_CAP_SVNDIFF2_ACCEPTED "accepts-svndiff2"
+#define SVN_RA_SVN_CAP_SVNDIFF_LARGE_WINDOWS "accepts-svndiff-large-windows"
 #define SVN_RA_SVN_CAP_ABSENT_ENTRIES "absent-entries"
 /* maps to SVN_RA_CAPABILITY_COMMIT_REVPROPS: */
 #define SVN_RA_SVN_CAP_COMMIT_REVPROPS "commit-revprops"
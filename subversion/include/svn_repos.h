@@ -3131,10 +3131,10 @@ enum svn_repos_load_uuid
   svn_repos_load_uuid_force
 };
 
-/** Callback type for use with svn_repos_verify_fs3().  @a revision
+/** Callback type for use with svn_repos_verify_fs4().  @a revision
  * and @a verify_err are the details of a single verification failure
- * that occurred during the svn_repos_verify_fs3() call.  @a baton is
- * the same baton given to svn_repos_verify_fs3().  @a scratch_pool is
+ * that occurred during the svn_repos_verify_fs4() call.  @a baton is
+ * the same baton given to svn_repos_verify_fs4().  @a scratch_pool is
  * provided for the convenience of the implementor, who should not
  * expect it to live longer than a single callback call.
  *
@@ -3144,7 +3144,7 @@ enum svn_repos_load_uuid
  * should also call svn_error_dup() for @a verify_err.  Implementors of this
  * callback are forbidden to call svn_error_clear() for @a verify_err.
  *
- * @see svn_repos_verify_fs3
+ * @see svn_repos_verify_fs4
  *
  * @since New in 1.9.
  */
@@ -3213,6 +3213,15 @@ typedef svn_error_t *(*svn_repos_verify_callback_t)(void *baton,
  *            called has reached its end and is about to return?
  *        ### Not sent, currently, if a FS structure error is found.
  *
+ * If @a jobs is larger than 1 and @a repos uses FSFS, verify up to
+ * @a jobs revisions at once using separate threads and let the backend
+ * check up to @a jobs shards at once in its metadata verification.  The
+ * notifications, the invocations of @a verify_callback and the result
+ * are the same as for a sequential verification, i.e. they are reported
+ * in revision order and from the calling thread.  This requires a
+ * thread-safe cache configuration (see svn_cache_config_set());
+ * otherwise, @a jobs will be ignored.
+ *
  * If @a cancel_func is not @c NULL, call it periodically with @a
  * cancel_baton as argument to see if the caller wishes to cancel the
  * verification.
@@ -3221,8 +3230,30 @@ typedef svn_error_t *(*svn_repos_verify_callback_t)(void *baton,
  *
  * @see svn_repos_verify_callback_t
  *
+ * @since New in 1.11.
+ */
+svn_error_t *
+svn_repos_verify_fs4(svn_repos_t *repos,
+                     svn_revnum_t start_rev,
+                     svn_revnum_t end_rev,
+                     svn_boolean_t check_normalization,
+                     svn_boolean_t metadata_only,
+                     int jobs,
+                     svn_repos_notify_func_t notify_func,
+                     void *notify_baton,
+                     svn_repos_verify_callback_t verify_callback,
+                     void *verify_baton,
+                     svn_cancel_func_t cancel,
+                     void *cancel_baton,
+                     apr_pool_t *scratch_pool);
+
+/**
+ * Like svn_repos_verify_fs4(), but with @a jobs set to 1.
+ *
  * @since New in 1.9.
+ * @deprecated Provided for backward compatibility with the 1.10 API.
  */
+SVN_DEPRECATED
 svn_error_t *
 svn_repos_verify_fs3(svn_repos_t *repos,
                      svn_revnum_t start_rev,
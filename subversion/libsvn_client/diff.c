@@ -64,6 +64,10 @@
 
 #define DIFF_REVNUM_NONEXISTENT ((svn_revnum_t) -100)
 
+/* Number of worker threads used by the internal diff to split and hash
+   the lines of large files. */
+#define DIFF_MAX_THREADS 4
+
 #define MAKE_ERR_BAD_RELATIVE_PATH(path, relative_to_dir) \
         svn_error_createf(SVN_ERR_BAD_RELATIVE_PATH, NULL, \
                           _("Path '%s' must be an immediate child of " \
@@ -2591,6 +2595,7 @@ create_diff_writer_info(diff_writer_info_t *dwi,
   else  /* No command, so arrange options for internal invocation instead. */
     {
       dwi->options.for_internal = svn_diff_file_options_create(result_pool);
+      dwi->options.for_internal->max_threads = DIFF_MAX_THREADS;
       SVN_ERR(svn_diff_file_options_parse(dwi->options.for_internal,
                                           options, result_pool));
     }
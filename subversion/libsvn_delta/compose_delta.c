@@ -30,6 +30,8 @@
 #include "svn_pools.h"
 #include "delta.h"
 
+#include "private/svn_delta_private.h"
+
 /* Define a MIN macro if this platform doesn't already have one. */
 #ifndef MIN
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
@@ -627,23 +629,60 @@ build_range_list(apr_size_t offset, apr_size_t limit, range_index_t *ndx)
 }
 
 
-/* Copy the instructions from WINDOW that define the range [OFFSET,
-   LIMIT) in WINDOW's target stream to TARGET_OFFSET in the window
-   represented by BUILD_BATON. HINT is a position in the instructions
-   array that helps finding the position for OFFSET. A safe default
-   is 0. Use NDX to find the instructions in WINDOW. Allocate space
-   in BUILD_BATON from POOL. */
+/* A chain of delta windows to compose, together with the offset indexes
+   needed to find the instructions in them.  All of it gets allocated
+   from a single scratch pool that is discarded once the composite
+   window has been built. */
+typedef struct window_chain_t
+{
+  /* The windows, oldest first.  The target view of WINDOWS[i] is the
+     source view of WINDOWS[i+1]. */
+  const svn_txdelta_window_t * const *windows;
+
+  /* Offset indexes for WINDOWS.  Entries are NULL until needed. */
+  offset_index_t **indexes;
+
+  /* The last instruction found in each of INDEXES.  Lookups tend to be
+     close to each other, so this is a good hint for the next one. */
+  apr_size_t *hints;
+
+  /* Scratch pool for the indexes. */
+  apr_pool_t *pool;
+} window_chain_t;
+
+/* Return the offset index for CHAIN->WINDOWS[LEVEL], creating it if
+   necessary. */
+
+static const offset_index_t *
+get_offset_index(window_chain_t *chain, int level)
+{
+  if (chain->indexes[level] == NULL)
+    chain->indexes[level] = create_offset_index(chain->windows[level],
+                                                chain->pool);
+
+  return chain->indexes[level];
+}
+
+/* Copy the instructions that define the range [OFFSET, LIMIT) in the
+   target stream of CHAIN->WINDOWS[LEVEL] to TARGET_OFFSET in the window
+   represented by BUILD_BATON.  Source copies get resolved recursively
+   against the windows further down the CHAIN, such that the result only
+   copies from the source view of CHAIN->WINDOWS[0].  Allocate space in
+   BUILD_BATON from POOL. */
 
 static void
 copy_source_ops(apr_size_t offset, apr_size_t limit,
                 apr_size_t target_offset,
-                apr_size_t hint,
+                int level,
                 svn_txdelta__ops_baton_t *build_baton,
-                const svn_txdelta_window_t *window,
-                const offset_index_t *ndx,
+                window_chain_t *chain,
                 apr_pool_t *pool)
 {
-  apr_size_t op_ndx = search_offset_index(ndx, offset, hint);
+  const svn_txdelta_window_t *const window = chain->windows[level];
+  const offset_index_t *const ndx = get_offset_index(chain, level);
+  apr_size_t op_ndx = search_offset_index(ndx, offset, chain->hints[level]);
+
+  chain->hints[level] = op_ndx;
   for (;; ++op_ndx)
     {
       const svn_txdelta_op_t *const op = &window->ops[op_ndx];
@@ -663,7 +702,16 @@ copy_source_ops(apr_size_t offset, apr_size_t limit,
       /* It would be extremely weird if the fixed-up op had zero length. */
       assert(fix_offset + fix_limit < op->length);
 
-      if (op->action_code != svn_txdelta_target)
+      if (op->action_code == svn_txdelta_source && level > 0)
+        {
+          /* This refers to the target of the next older window. */
+          copy_source_ops(op->offset + fix_offset,
+                          op->offset + op->length - fix_limit,
+                          target_offset,
+                          level - 1,
+                          build_baton, chain, pool);
+        }
+      else if (op->action_code != svn_txdelta_target)
         {
           /* Delta ops that don't depend on the virtual target can be
              copied to the composite unchanged. */
@@ -683,6 +731,9 @@ copy_source_ops(apr_size_t offset, apr_size_t limit,
              offset in the (virtual) target stream. */
           assert(op->offset < off[0]);
 
+          /* The data being copied is close to this op. */
+          chain->hints[level] = op_ndx;
+
           if (op->offset + op->length - fix_limit <= off[0])
             {
               /* The recursion _must_ end, otherwise the delta has
@@ -690,8 +741,8 @@ copy_source_ops(apr_size_t offset, apr_size_t limit,
               copy_source_ops(op->offset + fix_offset,
                               op->offset + op->length - fix_limit,
                               target_offset,
-                              op_ndx,
-                              build_baton, window, ndx, pool);
+                              level,
+                              build_baton, chain, pool);
             }
           else
             {
@@ -715,8 +766,8 @@ copy_source_ops(apr_size_t offset, apr_size_t limit,
                 copy_source_ops(op->offset + ptn_overlap,
                                 op->offset + ptn_overlap + length,
                                 tgt_off,
-                                op_ndx,
-                                build_baton, window, ndx, pool);
+                                level,
+                                build_baton, chain, pool);
                 fix_off += length;
                 tgt_off += length;
               }
@@ -731,8 +782,8 @@ copy_source_ops(apr_size_t offset, apr_size_t limit,
                   copy_source_ops(op->offset,
                                   op->offset + length,
                                   tgt_off,
-                                  op_ndx,
-                                  build_baton, window, ndx, pool);
+                                  level,
+                                  build_baton, chain, pool);
                   fix_off += length;
                   tgt_off += length;
                 }
@@ -755,28 +806,50 @@ copy_source_ops(apr_size_t offset, apr_size_t limit,
 }
 
 
-
+
 /* ==================================================================== */
 /* Bringing it all together. */
 
 
 svn_txdelta_window_t *
-svn_txdelta_compose_windows(const svn_txdelta_window_t *window_A,
-                            const svn_txdelta_window_t *window_B,
-                            apr_pool_t *pool)
+svn_txdelta__compose_chain(const svn_txdelta_window_t * const *windows,
+                           int count,
+                           apr_pool_t *pool)
 {
+  const svn_txdelta_window_t *const window_B = windows[count - 1];
   svn_txdelta__ops_baton_t build_baton = { 0 };
   svn_txdelta_window_t *composite;
-  apr_pool_t *subpool = svn_pool_create(pool);
-  offset_index_t *offset_index = create_offset_index(window_A, subpool);
-  range_index_t *range_index = create_range_index(subpool);
+  apr_pool_t *arena;
+  window_chain_t chain;
+  range_index_t *range_index;
   apr_size_t target_offset = 0;
   int i;
 
+  assert(count > 0);
+  if (count == 1)
+    return svn_txdelta_window_dup(window_B, pool);
+
+  /* Everything but the final result gets allocated from ARENA.  The
+     composite cannot contain more new data than it has target data,
+     so its buffer never needs to grow. */
+  arena = svn_pool_create(pool);
+  chain.windows = windows;
+  chain.indexes = apr_pcalloc(arena, count * sizeof(*chain.indexes));
+  chain.hints = apr_pcalloc(arena, count * sizeof(*chain.hints));
+  chain.pool = arena;
+  range_index = create_range_index(arena);
+
   /* Read the description of the delta composition algorithm in
      notes/fs-improvements.txt before going any further.
-     You have been warned. */
-  build_baton.new_data = svn_stringbuf_create_empty(pool);
+     You have been warned.
+
+     The newest window, WINDOW_B, plays the same role as in a pairwise
+     composition.  All older windows get treated like the first window
+     of a pairwise composition, only that their source copies are
+     resolved against the next older window instead of being copied to
+     the composite.  That way, no intermediate composites get built. */
+  build_baton.new_data = svn_stringbuf_create_ensure(window_B->tview_len,
+                                                     arena);
   for (i = 0; i < window_B->num_ops; ++i)
     {
       const svn_txdelta_op_t *const op = &window_B->ops[i];
@@ -790,13 +863,13 @@ svn_txdelta_compose_windows(const svn_txdelta_window_t *window_A,
              : NULL);
           svn_txdelta__insert_op(&build_baton, op->action_code,
                                  op->offset, op->length,
-                                 new_data, pool);
+                                 new_data, arena);
         }
       else
         {
           /* NOTE: Remember that `offset' and `limit' refer to
              positions in window_B's _source_ stream, which is the
-             same as window_A's _target_ stream! */
+             same as the _target_ stream of the next older window! */
           const apr_size_t offset = op->offset;
           const apr_size_t limit = op->offset + op->length;
           range_list_node_t *range_list, *range;
@@ -811,11 +884,10 @@ svn_txdelta_compose_windows(const svn_txdelta_window_t *window_A,
                 svn_txdelta__insert_op(&build_baton, svn_txdelta_target,
                                        range->target_offset,
                                        range->limit - range->offset,
-                                       NULL, pool);
+                                       NULL, arena);
               else
-                copy_source_ops(range->offset, range->limit, tgt_off, 0,
-                                &build_baton, window_A, offset_index,
-                                pool);
+                copy_source_ops(range->offset, range->limit, tgt_off,
+                                count - 2, &build_baton, &chain, arena);
 
               tgt_off += range->limit - range->offset;
             }
@@ -829,11 +901,30 @@ svn_txdelta_compose_windows(const svn_txdelta_window_t *window_A,
       target_offset += op->length;
     }
 
-  svn_pool_destroy(subpool);
-
+  /* Copy the result out of the arena, leaving all intermediate
+     allocations behind. */
   composite = svn_txdelta__make_window(&build_baton, pool);
-  composite->sview_offset = window_A->sview_offset;
-  composite->sview_len = window_A->sview_len;
+  composite->ops = apr_pmemdup(pool, build_baton.ops,
+                               build_baton.num_ops * sizeof(*build_baton.ops));
+  composite->new_data = svn_string_ncreate(build_baton.new_data->data,
+                                           build_baton.new_data->len, pool);
+  svn_pool_destroy(arena);
+
+  composite->sview_offset = windows[0]->sview_offset;
+  composite->sview_len = windows[0]->sview_len;
   composite->tview_len = window_B->tview_len;
   return composite;
 }
+
+svn_txdelta_window_t *
+svn_txdelta_compose_windows(const svn_txdelta_window_t *window_A,
+                            const svn_txdelta_window_t *window_B,
+                            apr_pool_t *pool)
+{
+  const svn_txdelta_window_t *windows[2];
+
+  windows[0] = window_A;
+  windows[1] = window_B;
+
+  return svn_txdelta__compose_chain(windows, 2, pool);
+}
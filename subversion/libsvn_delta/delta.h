@@ -44,6 +44,11 @@ extern "C" {
 
 #define SVN_DELTA_WINDOW_SIZE 102400
 
+/* The maximum size of svndiff windows in streams that have been written
+   with large windows enabled.  See svn_txdelta__to_svndiff_large(). */
+
+#define SVN_DELTA__LARGE_WINDOW_SIZE (16 * SVN_DELTA_WINDOW_SIZE)
+
 
 /* Context/baton for building an operation sequence. */
 
@@ -24,10 +24,15 @@
 
 #include <assert.h>
 #include <string.h>
+
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
+
 #include "svn_delta.h"
 #include "svn_io.h"
 #include "delta.h"
 #include "svn_pools.h"
+#include "svn_sorts.h"
 #include "svn_private_config.h"
 
 #include "private/svn_error_private.h"
@@ -35,6 +40,7 @@
 #include "private/svn_subr_private.h"
 #include "private/svn_string_private.h"
 #include "private/svn_dep_compat.h"
+#include "private/svn_thread_pool.h"
 
 static const char SVNDIFF_V0[] = { 'S', 'V', 'N', 0 };
 static const char SVNDIFF_V1[] = { 'S', 'V', 'N', 1 };
@@ -42,6 +48,10 @@ static const char SVNDIFF_V2[] = { 'S', 'V', 'N', 2 };
 
 #define SVNDIFF_HEADER_SIZE (sizeof(SVNDIFF_V0))
 
+/* Flag in the version byte of the svndiff header, indicating that the
+   windows may be up to SVN_DELTA__LARGE_WINDOW_SIZE bytes large. */
+#define SVNDIFF_LARGE_WINDOWS 0x10
+
 static const char *
 get_svndiff_header(int version)
 {
@@ -63,6 +73,9 @@ struct encoder_baton {
   svn_boolean_t header_done;
   int version;
   int compression_level;
+  /* Flag the header to allow for windows of up to
+     SVN_DELTA__LARGE_WINDOW_SIZE bytes. */
+  svn_boolean_t large_windows;
   /* Pool for temporary allocations, will be cleared periodically. */
   apr_pool_t *scratch_pool;
 };
@@ -70,10 +83,37 @@ struct encoder_baton {
 /* This is at least as big as the largest size for a single instruction. */
 #define MAX_INSTRUCTION_LEN (2*SVN__MAX_ENCODED_UINT_LEN+1)
 /* This is at least as big as the largest possible instructions
-   section: in theory, the instructions could be SVN_DELTA_WINDOW_SIZE
-   1-byte copy-from-source instructions (though this is very unlikely). */
-#define MAX_INSTRUCTION_SECTION_LEN (SVN_DELTA_WINDOW_SIZE*MAX_INSTRUCTION_LEN)
+   section for windows of WINDOW_SIZE bytes: in theory, the instructions
+   could be WINDOW_SIZE 1-byte copy-from-source instructions (though this
+   is very unlikely). */
+#define MAX_INSTRUCTION_SECTION_LEN(window_size) \
+  ((window_size) * MAX_INSTRUCTION_LEN)
+
+
+/* Copy the svndiff stream header for the format used by EB to HEADER. */
+static void
+get_stream_header(char header[SVNDIFF_HEADER_SIZE],
+                  const struct encoder_baton *eb)
+{
+  memcpy(header, get_svndiff_header(eb->version), SVNDIFF_HEADER_SIZE);
+  if (eb->large_windows)
+    header[SVNDIFF_HEADER_SIZE - 1] |= SVNDIFF_LARGE_WINDOWS;
+}
+
+
+/* Compress the LEN bytes at DATA into OUT using LZ4.  Use the LZ4 HC
+   algorithm if COMPRESSION_LEVEL requests it. */
+static svn_error_t *
+compress_lz4(const void *data,
+             apr_size_t len,
+             svn_stringbuf_t *out,
+             int compression_level)
+{
+  if (compression_level >= SVN_DELTA__COMPRESSION_LEVEL_LZ4_HC)
+    return svn_error_trace(svn__compress_lz4_hc(data, len, out));
 
+  return svn_error_trace(svn__compress_lz4(data, len, out));
+}
 
 /* Append an encoded integer to a string.  */
 static void
@@ -107,7 +147,7 @@ send_simple_insertion_window(svn_txdelta_window_t *window,
   if (!eb->header_done)
     {
       eb->header_done = TRUE;
-      memcpy(headers, get_svndiff_header(eb->version), SVNDIFF_HEADER_SIZE);
+      get_stream_header((char *)headers, eb);
       header_current = headers + SVNDIFF_HEADER_SIZE;
     }
   else
@@ -202,8 +242,8 @@ encode_window(svn_stringbuf_t **instructions_p,
     {
       svn_stringbuf_t *compressed_instructions;
       compressed_instructions = svn_stringbuf_create_empty(pool);
-      SVN_ERR(svn__compress_lz4(instructions->data, instructions->len,
-                                compressed_instructions));
+      SVN_ERR(compress_lz4(instructions->data, instructions->len,
+                           compressed_instructions, compression_level));
       instructions = compressed_instructions;
     }
   else if (version == 1)
@@ -221,8 +261,8 @@ encode_window(svn_stringbuf_t **instructions_p,
     {
       svn_stringbuf_t *compressed = svn_stringbuf_create_empty(pool);
 
-      SVN_ERR(svn__compress_lz4(window->new_data->data, window->new_data->len,
-                                compressed));
+      SVN_ERR(compress_lz4(window->new_data->data, window->new_data->len,
+                           compressed, compression_level));
       newdata = svn_stringbuf__morph_into_string(compressed);
     }
   else if (version == 1)
@@ -245,13 +285,57 @@ encode_window(svn_stringbuf_t **instructions_p,
   return SVN_NO_ERROR;
 }
 
+/* Write the svndiff stream header to EB->OUTPUT unless that has already
+   been done. */
+static svn_error_t *
+write_stream_header(struct encoder_baton *eb)
+{
+  char header[SVNDIFF_HEADER_SIZE];
+  apr_size_t len;
+
+  if (!eb->header_done)
+    {
+      get_stream_header(header, eb);
+      len = SVNDIFF_HEADER_SIZE;
+      SVN_ERR(svn_stream_write(eb->output, header, &len));
+      eb->header_done = TRUE;
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Write the window HEADER, INSTRUCTIONS and NEWDATA as returned by
+   encode_window() to EB->OUTPUT. */
+static svn_error_t *
+write_encoded_window(struct encoder_baton *eb,
+                     const svn_stringbuf_t *header,
+                     const svn_stringbuf_t *instructions,
+                     const svn_string_t *newdata)
+{
+  apr_size_t len;
+
+  len = header->len;
+  SVN_ERR(svn_stream_write(eb->output, header->data, &len));
+  if (instructions->len > 0)
+    {
+      len = instructions->len;
+      SVN_ERR(svn_stream_write(eb->output, instructions->data, &len));
+    }
+  if (newdata->len > 0)
+    {
+      len = newdata->len;
+      SVN_ERR(svn_stream_write(eb->output, newdata->data, &len));
+    }
+
+  return SVN_NO_ERROR;
+}
+
 /* Note: When changing things here, check the related comment in
    the svn_txdelta_to_svndiff_stream() function.  */
 static svn_error_t *
 window_handler(svn_txdelta_window_t *window, void *baton)
 {
   struct encoder_baton *eb = baton;
-  apr_size_t len;
   svn_stringbuf_t *instructions;
   svn_stringbuf_t *header;
   const svn_string_t *newdata;
@@ -261,13 +345,7 @@ window_handler(svn_txdelta_window_t *window, void *baton)
     return svn_error_trace(send_simple_insertion_window(window, eb));
 
   /* Make sure we write the header.  */
-  if (!eb->header_done)
-    {
-      len = SVNDIFF_HEADER_SIZE;
-      SVN_ERR(svn_stream_write(eb->output, get_svndiff_header(eb->version),
-                               &len));
-      eb->header_done = TRUE;
-    }
+  SVN_ERR(write_stream_header(eb));
 
   if (window == NULL)
     {
@@ -286,20 +364,8 @@ window_handler(svn_txdelta_window_t *window, void *baton)
                         eb->scratch_pool));
 
   /* Write out the window.  */
-  len = header->len;
-  SVN_ERR(svn_stream_write(eb->output, header->data, &len));
-  if (instructions->len > 0)
-    {
-      len = instructions->len;
-      SVN_ERR(svn_stream_write(eb->output, instructions->data, &len));
-    }
-  if (newdata->len > 0)
-    {
-      len = newdata->len;
-      SVN_ERR(svn_stream_write(eb->output, newdata->data, &len));
-    }
-
-  return SVN_NO_ERROR;
+  return svn_error_trace(write_encoded_window(eb, header, instructions,
+                                              newdata));
 }
 
 void
@@ -318,6 +384,7 @@ svn_txdelta_to_svndiff3(svn_txdelta_window_handler_t *handler,
   eb->scratch_pool = svn_pool_create(pool);
   eb->version = svndiff_version;
   eb->compression_level = compression_level;
+  eb->large_windows = FALSE;
 
   *handler = window_handler;
   *handler_baton = eb;
@@ -344,6 +411,626 @@ svn_txdelta_to_svndiff(svn_stream_t *output,
                           SVN_DELTA_COMPRESSION_LEVEL_DEFAULT, pool);
 }
 
+
+/* ----- Text delta to svndiff, using large windows ----- */
+
+/* Baton for coalescing_window_handler(). */
+struct coalescing_baton
+{
+  /* The svndiff encoder that receives the merged windows. */
+  svn_txdelta_window_handler_t handler;
+  void *handler_baton;
+
+  /* Set if at least one window has been merged into the window being
+     built but that has not been sent to HANDLER, yet. */
+  svn_boolean_t pending;
+
+  /* Source and target views of the window being built. */
+  svn_filesize_t sview_offset;
+  apr_size_t sview_len;
+  apr_size_t tview_len;
+
+  /* Ops and new data of the window being built. */
+  svn_txdelta__ops_baton_t build_baton;
+
+  /* Holds BUILD_BATON's contents.  Cleared after each window sent. */
+  apr_pool_t *pool;
+};
+
+/* Return whether WINDOW can be appended to the window being built in CB
+   without exceeding SVN_DELTA__LARGE_WINDOW_SIZE. */
+static svn_boolean_t
+can_coalesce(const struct coalescing_baton *cb,
+             const svn_txdelta_window_t *window)
+{
+  svn_filesize_t sview_end;
+
+  if (!cb->pending)
+    return TRUE;
+
+  if (window->tview_len > SVN_DELTA__LARGE_WINDOW_SIZE - cb->tview_len)
+    return FALSE;
+
+  if (window->sview_len == 0)
+    return TRUE;
+  if (cb->sview_len == 0)
+    return window->sview_len <= SVN_DELTA__LARGE_WINDOW_SIZE;
+
+  /* Source views never slide backwards.  Merging windows must not change
+     that, i.e. the merged view covers both source views. */
+  if (window->sview_offset < cb->sview_offset)
+    return FALSE;
+
+  sview_end = MAX(window->sview_offset + window->sview_len,
+                  cb->sview_offset + cb->sview_len);
+  return sview_end - cb->sview_offset <= SVN_DELTA__LARGE_WINDOW_SIZE;
+}
+
+/* Append the ops and new data of WINDOW to the window being built in CB,
+   rebasing their offsets to the merged views. */
+static void
+coalesce_window(struct coalescing_baton *cb,
+                const svn_txdelta_window_t *window)
+{
+  apr_size_t source_shift = 0;
+  apr_size_t target_shift = cb->tview_len;
+  int i;
+
+  if (!cb->pending || cb->sview_len == 0)
+    {
+      cb->sview_offset = window->sview_offset;
+      cb->sview_len = window->sview_len;
+    }
+  else if (window->sview_len > 0)
+    {
+      source_shift = (apr_size_t)(window->sview_offset - cb->sview_offset);
+      cb->sview_len = MAX(cb->sview_len, source_shift + window->sview_len);
+    }
+
+  for (i = 0; i < window->num_ops; ++i)
+    {
+      const svn_txdelta_op_t *op = &window->ops[i];
+
+      switch (op->action_code)
+        {
+        case svn_txdelta_source:
+          svn_txdelta__insert_op(&cb->build_baton, svn_txdelta_source,
+                                 op->offset + source_shift, op->length,
+                                 NULL, cb->pool);
+          break;
+        case svn_txdelta_target:
+          svn_txdelta__insert_op(&cb->build_baton, svn_txdelta_target,
+                                 op->offset + target_shift, op->length,
+                                 NULL, cb->pool);
+          break;
+        case svn_txdelta_new:
+          svn_txdelta__insert_op(&cb->build_baton, svn_txdelta_new, 0,
+                                 op->length,
+                                 window->new_data->data + op->offset,
+                                 cb->pool);
+          break;
+        }
+    }
+
+  cb->tview_len += window->tview_len;
+  cb->pending = TRUE;
+}
+
+/* Send the window being built in CB, if any, to the encoder. */
+static svn_error_t *
+flush_coalesced_window(struct coalescing_baton *cb)
+{
+  svn_txdelta_window_t *window;
+
+  if (!cb->pending)
+    return SVN_NO_ERROR;
+
+  window = svn_txdelta__make_window(&cb->build_baton, cb->pool);
+  window->sview_offset = cb->sview_offset;
+  window->sview_len = cb->sview_len;
+  window->tview_len = cb->tview_len;
+  SVN_ERR(cb->handler(window, cb->handler_baton));
+
+  svn_pool_clear(cb->pool);
+  memset(&cb->build_baton, 0, sizeof(cb->build_baton));
+  cb->build_baton.new_data = svn_stringbuf_create_empty(cb->pool);
+  cb->sview_offset = 0;
+  cb->sview_len = 0;
+  cb->tview_len = 0;
+  cb->pending = FALSE;
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_txdelta_window_handler_t.  Merge consecutive windows
+   into windows of up to SVN_DELTA__LARGE_WINDOW_SIZE bytes and send those
+   to the svndiff encoder in BATON. */
+static svn_error_t *
+coalescing_window_handler(svn_txdelta_window_t *window,
+                          void *baton)
+{
+  struct coalescing_baton *cb = baton;
+
+  if (window == NULL)
+    {
+      SVN_ERR(flush_coalesced_window(cb));
+      svn_pool_destroy(cb->pool);
+
+      return svn_error_trace(cb->handler(NULL, cb->handler_baton));
+    }
+
+  if (!can_coalesce(cb, window))
+    SVN_ERR(flush_coalesced_window(cb));
+
+  coalesce_window(cb, window);
+
+  return SVN_NO_ERROR;
+}
+
+void
+svn_txdelta__to_svndiff_large(svn_txdelta_window_handler_t *handler,
+                              void **handler_baton,
+                              svn_stream_t *output,
+                              int svndiff_version,
+                              int compression_level,
+                              apr_pool_t *pool)
+{
+  struct coalescing_baton *cb = apr_pcalloc(pool, sizeof(*cb));
+  struct encoder_baton *eb;
+
+  svn_txdelta_to_svndiff3(&cb->handler, &cb->handler_baton, output,
+                          svndiff_version, compression_level, pool);
+  eb = cb->handler_baton;
+  eb->large_windows = TRUE;
+
+  cb->pool = svn_pool_create(pool);
+  cb->build_baton.new_data = svn_stringbuf_create_empty(cb->pool);
+
+  *handler = coalescing_window_handler;
+  *handler_baton = cb;
+}
+
+
+/* ----- Text delta to svndiff, using multiple threads ----- */
+
+#if APR_HAS_THREADS
+
+/* A window handed to a worker thread for encoding.  Once DONE has been
+   set, the encoding results may be written to the output. */
+typedef struct encoder_slot_t
+{
+  /* Thread-safe pool, private to this slot.  Holds a copy of WINDOW and
+     the encoding results.  NULL until the slot gets used for the first
+     time. */
+  apr_pool_t *pool;
+
+  /* The window to encode. */
+  svn_txdelta_window_t *window;
+
+  /* Encoding results, see encode_window(). */
+  svn_stringbuf_t *instructions;
+  svn_stringbuf_t *header;
+  const svn_string_t *newdata;
+  svn_error_t *err;
+
+  /* Set while a worker may access this slot or its results have not been
+     written, yet. */
+  svn_boolean_t busy;
+
+  /* Set by the worker when the encoding results are valid.
+     Protected by the MUTEX in PEB. */
+  svn_boolean_t done;
+
+  /* The encoder that this slot belongs to. */
+  struct parallel_encoder_baton *peb;
+} encoder_slot_t;
+
+/* Baton for parallel_window_handler(). */
+struct parallel_encoder_baton
+{
+  /* Output stream and svndiff parameters.  Its scratch pool is unused. */
+  struct encoder_baton eb;
+
+  /* Ring buffer of SLOT_COUNT windows being encoded.  The oldest one is
+     at index FIRST and USED slots are busy. */
+  encoder_slot_t *slots;
+  int slot_count;
+  int first;
+  int used;
+
+  /* Protects the DONE flags and notifies the writer of completed slots. */
+  apr_thread_mutex_t *mutex;
+  apr_thread_cond_t *cond;
+
+  /* Worker threads to encode the windows. */
+  apr_thread_pool_t *threads;
+};
+
+/* Implements apr_thread_start_t.  Encode the window in the encoder_slot_t
+   given as DATA and notify the writer. */
+static void * APR_THREAD_FUNC
+encode_window_task(apr_thread_t *thread,
+                   void *data)
+{
+  encoder_slot_t *slot = data;
+  struct parallel_encoder_baton *peb = slot->peb;
+
+  slot->err = encode_window(&slot->instructions, &slot->header,
+                            &slot->newdata, slot->window,
+                            peb->eb.version, peb->eb.compression_level,
+                            slot->pool);
+
+  apr_thread_mutex_lock(peb->mutex);
+  slot->done = TRUE;
+  apr_thread_cond_broadcast(peb->cond);
+  apr_thread_mutex_unlock(peb->mutex);
+
+  return NULL;
+}
+
+/* Block until the worker for SLOT in PEB has finished. */
+static svn_error_t *
+wait_for_slot(struct parallel_encoder_baton *peb,
+              encoder_slot_t *slot)
+{
+  apr_status_t status = apr_thread_mutex_lock(peb->mutex);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't lock mutex"));
+
+  /* This loop implicitly handles spurious wake-ups. */
+  while (!status && !slot->done)
+    status = apr_thread_cond_wait(peb->cond, peb->mutex);
+
+  apr_thread_mutex_unlock(peb->mutex);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't wait on condition variable"));
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *DONE to whether the oldest busy slot in PEB can be written without
+   blocking. */
+static svn_error_t *
+oldest_slot_done(svn_boolean_t *done,
+                 struct parallel_encoder_baton *peb)
+{
+  apr_status_t status;
+
+  if (peb->used == 0)
+    {
+      *done = FALSE;
+      return SVN_NO_ERROR;
+    }
+
+  status = apr_thread_mutex_lock(peb->mutex);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't lock mutex"));
+
+  *done = peb->slots[peb->first].done;
+  apr_thread_mutex_unlock(peb->mutex);
+
+  return SVN_NO_ERROR;
+}
+
+/* Wait for the oldest busy slot in PEB, write its encoded window to the
+   output and release the slot. */
+static svn_error_t *
+write_oldest_slot(struct parallel_encoder_baton *peb)
+{
+  encoder_slot_t *slot = &peb->slots[peb->first];
+  svn_error_t *err;
+
+  SVN_ERR(wait_for_slot(peb, slot));
+
+  err = slot->err;
+  slot->err = SVN_NO_ERROR;
+  if (!err)
+    err = write_stream_header(&peb->eb);
+  if (!err)
+    err = write_encoded_window(&peb->eb, slot->header, slot->instructions,
+                               slot->newdata);
+
+  slot->busy = FALSE;
+  slot->done = FALSE;
+  svn_pool_clear(slot->pool);
+
+  peb->first = (peb->first + 1) % peb->slot_count;
+  --peb->used;
+
+  return svn_error_trace(err);
+}
+
+/* Implements svn_txdelta_window_handler_t.  Hand WINDOW to a worker
+   thread and write all windows that have been encoded so far, in order.
+   The output is the same as that of window_handler(). */
+static svn_error_t *
+parallel_window_handler(svn_txdelta_window_t *window,
+                        void *baton)
+{
+  struct parallel_encoder_baton *peb = baton;
+  encoder_slot_t *slot;
+  svn_boolean_t done;
+  apr_status_t status;
+
+  if (window == NULL)
+    {
+      /* Flush all pending windows; we're done then. */
+      while (peb->used)
+        SVN_ERR(write_oldest_slot(peb));
+
+      SVN_ERR(write_stream_header(&peb->eb));
+      return svn_error_trace(svn_stream_close(peb->eb.output));
+    }
+
+  /* Write what has been completed so far to keep the output flowing and
+     make room for WINDOW if all slots are busy. */
+  SVN_ERR(oldest_slot_done(&done, peb));
+  while (done)
+    {
+      SVN_ERR(write_oldest_slot(peb));
+      SVN_ERR(oldest_slot_done(&done, peb));
+    }
+
+  if (peb->used == peb->slot_count)
+    SVN_ERR(write_oldest_slot(peb));
+
+  /* The caller may reuse WINDOW after we return, so take a copy. */
+  slot = &peb->slots[(peb->first + peb->used) % peb->slot_count];
+  if (slot->pool == NULL)
+    slot->pool = svn_pool_create(NULL);
+
+  slot->window = svn_txdelta_window_dup(window, slot->pool);
+  slot->busy = TRUE;
+  ++peb->used;
+
+  /* If we can't get a worker thread, do the work ourselves. */
+  status = apr_thread_pool_push(peb->threads, encode_window_task, slot,
+                                APR_THREAD_TASK_PRIORITY_NORMAL, peb);
+  if (status)
+    encode_window_task(NULL, slot);
+
+  return SVN_NO_ERROR;
+}
+
+/* Pre-cleanup function for the parallel_encoder_baton given as DATA.
+   Wait for all workers that still access its slots and release them. */
+static apr_status_t
+parallel_encoder_cleanup(void *data)
+{
+  struct parallel_encoder_baton *peb = data;
+  int i;
+
+  for (i = 0; i < peb->slot_count; ++i)
+    {
+      encoder_slot_t *slot = &peb->slots[i];
+
+      if (slot->busy)
+        {
+          svn_error_clear(wait_for_slot(peb, slot));
+          svn_error_clear(slot->err);
+        }
+
+      if (slot->pool)
+        svn_pool_destroy(slot->pool);
+    }
+
+  return APR_SUCCESS;
+}
+
+#endif /* APR_HAS_THREADS */
+
+svn_error_t *
+svn_txdelta__to_svndiff_parallel(svn_txdelta_window_handler_t *handler,
+                                 void **handler_baton,
+                                 svn_stream_t *output,
+                                 int svndiff_version,
+                                 int compression_level,
+                                 int max_threads,
+                                 apr_pool_t *pool)
+{
+#if APR_HAS_THREADS
+  struct parallel_encoder_baton *peb;
+  apr_status_t status;
+  int i;
+
+  /* svndiff0 is not compressed, i.e. there is nothing to parallelize. */
+  if (max_threads < 2 || svndiff_version == 0)
+    {
+      svn_txdelta_to_svndiff3(handler, handler_baton, output,
+                              svndiff_version, compression_level, pool);
+      return SVN_NO_ERROR;
+    }
+
+  peb = apr_pcalloc(pool, sizeof(*peb));
+  SVN_ERR(svn_thread_pool__get(&peb->threads, pool));
+  peb->eb.output = output;
+  peb->eb.header_done = FALSE;
+  peb->eb.version = svndiff_version;
+  peb->eb.compression_level = compression_level;
+
+  /* Twice as many slots as workers such that the workers are kept busy
+     while we wait for the oldest window and write it. */
+  peb->slot_count = 2 * max_threads;
+  peb->slots = apr_pcalloc(pool, peb->slot_count * sizeof(*peb->slots));
+  for (i = 0; i < peb->slot_count; ++i)
+    peb->slots[i].peb = peb;
+
+  status = apr_thread_mutex_create(&peb->mutex, APR_THREAD_MUTEX_DEFAULT,
+                                   pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create mutex"));
+
+  status = apr_thread_cond_create(&peb->cond, pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create condition variable"));
+
+  /* The workers must be done before the mutex and the slots get
+     destroyed. */
+  apr_pool_pre_cleanup_register(pool, peb, parallel_encoder_cleanup);
+
+  *handler = parallel_window_handler;
+  *handler_baton = peb;
+#else
+  svn_txdelta_to_svndiff3(handler, handler_baton, output, svndiff_version,
+                          compression_level, pool);
+#endif
+
+  return SVN_NO_ERROR;
+}
+
+
+/* ----- Text delta to svndiff, selecting the format by content ----- */
+
+/* Number of bytes from the first window's new data that we compress on
+   trial to select the svndiff format. */
+#define ADAPTIVE_SAMPLE_SIZE 0x4000
+
+/* Samples shorter than this are not conclusive and their compression
+   cost is negligible anyway. */
+#define ADAPTIVE_MIN_SAMPLE_SIZE 0x100
+
+/* Baton for adaptive_window_handler(). */
+struct adaptive_encoder_baton
+{
+  /* Parameters passed to svn_txdelta__to_svndiff_adaptive(). */
+  svn_stream_t *output;
+  int compression_level;
+  int max_threads;
+  apr_pool_t *pool;
+
+  /* The actual encoder.  NULL until we received the first window. */
+  svn_txdelta_window_handler_t handler;
+  void *handler_baton;
+};
+
+/* Return TRUE if the LEN bytes at DATA look like text, i.e. contain no
+   NUL and mostly printable characters.  Non-ASCII bytes are considered
+   printable to cover UTF-8 and other 8 bit encodings. */
+static svn_boolean_t
+looks_like_text(const unsigned char *data,
+                apr_size_t len)
+{
+  apr_size_t binary_count = 0;
+  apr_size_t i;
+
+  for (i = 0; i < len; ++i)
+    {
+      unsigned char c = data[i];
+      if (c == 0)
+        return FALSE;
+
+      if (c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\f')
+        ++binary_count;
+      else if (c == 0x7f)
+        ++binary_count;
+    }
+
+  /* Allow for some control characters, e.g. ANSI escape sequences. */
+  return binary_count <= len / 16;
+}
+
+/* Select the svndiff format for a representation that starts with WINDOW
+   and return it in *SVNDIFF_VERSION and *COMPRESSION_LEVEL.  ZLIB_LEVEL is
+   the compression level to use with svndiff1.  WINDOW may be NULL.  Use
+   SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+select_svndiff_format(int *svndiff_version,
+                      int *compression_level,
+                      const svn_txdelta_window_t *window,
+                      int zlib_level,
+                      apr_pool_t *scratch_pool)
+{
+  svn_stringbuf_t *compressed;
+  apr_size_t len;
+
+  /* Empty or almost empty contents, e.g. small changes.  Fast LZ4 will at
+     least pack the instructions and costs virtually nothing. */
+  if (window == NULL || window->new_data->len < ADAPTIVE_MIN_SAMPLE_SIZE)
+    {
+      *svndiff_version = 2;
+      *compression_level = SVN_DELTA_COMPRESSION_LEVEL_DEFAULT;
+      return SVN_NO_ERROR;
+    }
+
+  /* Already compressed data, e.g. archives and media files, will not
+     shrink by much.  Don't waste any time on it. */
+  len = MIN(window->new_data->len, ADAPTIVE_SAMPLE_SIZE);
+  compressed = svn_stringbuf_create_empty(scratch_pool);
+  SVN_ERR(svn__compress_lz4(window->new_data->data, len, compressed));
+  if (compressed->len + len / 16 >= len)
+    {
+      *svndiff_version = 0;
+      *compression_level = SVN_DELTA_COMPRESSION_LEVEL_NONE;
+    }
+
+  /* zlib's entropy coding gives the best results for text. */
+  else if (looks_like_text((const unsigned char *)window->new_data->data,
+                           len))
+    {
+      *svndiff_version = 1;
+      *compression_level = zlib_level;
+    }
+
+  /* Compressible binary data.  LZ4 HC comes close to zlib's ratio here
+     and decompresses much faster. */
+  else
+    {
+      *svndiff_version = 2;
+      *compression_level = SVN_DELTA__COMPRESSION_LEVEL_LZ4_HC;
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_txdelta_window_handler_t.  Create the actual encoder
+   upon the first call and forward all windows to it. */
+static svn_error_t *
+adaptive_window_handler(svn_txdelta_window_t *window,
+                        void *baton)
+{
+  struct adaptive_encoder_baton *aeb = baton;
+
+  if (aeb->handler == NULL)
+    {
+      apr_pool_t *scratch_pool = svn_pool_create(aeb->pool);
+      int svndiff_version;
+      int compression_level;
+
+      SVN_ERR(select_svndiff_format(&svndiff_version, &compression_level,
+                                    window, aeb->compression_level,
+                                    scratch_pool));
+      svn_pool_destroy(scratch_pool);
+
+      SVN_ERR(svn_txdelta__to_svndiff_parallel(&aeb->handler,
+                                               &aeb->handler_baton,
+                                               aeb->output,
+                                               svndiff_version,
+                                               compression_level,
+                                               aeb->max_threads,
+                                               aeb->pool));
+    }
+
+  return svn_error_trace(aeb->handler(window, aeb->handler_baton));
+}
+
+void
+svn_txdelta__to_svndiff_adaptive(svn_txdelta_window_handler_t *handler,
+                                 void **handler_baton,
+                                 svn_stream_t *output,
+                                 int compression_level,
+                                 int max_threads,
+                                 apr_pool_t *pool)
+{
+  struct adaptive_encoder_baton *aeb = apr_pcalloc(pool, sizeof(*aeb));
+  aeb->output = output;
+  aeb->compression_level = compression_level;
+  aeb->max_threads = max_threads;
+  aeb->pool = pool;
+
+  *handler = adaptive_window_handler;
+  *handler_baton = aeb;
+}
+
 
 /* ----- svndiff to text delta ----- */
 
@@ -380,7 +1067,8 @@ struct decode_baton
      be FALSE. */
   svn_boolean_t error_on_early_close;
 
-  /* svndiff version in use by delta.  */
+  /* svndiff version in use by delta, including the
+     SVNDIFF_LARGE_WINDOWS flag.  */
   unsigned char version;
 
   /* Length of parsed delta window header. 0 if window is not parsed yet. */
@@ -396,6 +1084,37 @@ struct decode_baton
 };
 
 
+/* Return the maximum window size allowed in svndiff data with the
+   given VERSION byte. */
+static apr_size_t
+max_window_size(unsigned int version)
+{
+  return (version & SVNDIFF_LARGE_WINDOWS) ? SVN_DELTA__LARGE_WINDOW_SIZE
+                                           : SVN_DELTA_WINDOW_SIZE;
+}
+
+/* Return an error if the lengths in a window header exceed the limits
+   for svndiff data with the given VERSION byte. */
+static svn_error_t *
+check_window_size(apr_size_t sview_len,
+                  apr_size_t tview_len,
+                  apr_size_t inslen,
+                  apr_size_t newlen,
+                  unsigned int version)
+{
+  apr_size_t window_size = max_window_size(version);
+
+  if (tview_len > window_size ||
+      sview_len > window_size ||
+      /* for svndiff1, newlen includes the original length */
+      newlen > window_size + SVN__MAX_ENCODED_UINT_LEN ||
+      inslen > MAX_INSTRUCTION_SECTION_LEN(window_size))
+    return svn_error_create(SVN_ERR_SVNDIFF_CORRUPT_WINDOW, NULL,
+                            _("Svndiff contains a too-large window"));
+
+  return SVN_NO_ERROR;
+}
+
 /* Wrapper aroung svn__deencode_uint taking a file size as *VAL. */
 static const unsigned char *
 decode_file_offset(svn_filesize_t *val,
@@ -544,7 +1263,8 @@ count_and_verify_instructions(int *ninst,
 
 /* Given the five integer fields of a window header and a pointer to
    the remainder of the window contents, fill in a delta window
-   structure *WINDOW.  New allocations will be performed in POOL;
+   structure *WINDOW.  VERSION is the version byte of the svndiff
+   header.  New allocations will be performed in POOL;
    the new_data field of *WINDOW will refer directly to memory pointed
    to by DATA. */
 static svn_error_t *
@@ -558,6 +1278,9 @@ decode_window(svn_txdelta_window_t *window, svn_filesize_t sview_offset,
   apr_size_t npos;
   svn_txdelta_op_t *ops, *op;
   svn_string_t *new_data;
+  apr_size_t window_size = max_window_size(version);
+
+  version &= ~SVNDIFF_LARGE_WINDOWS;
 
   window->sview_offset = sview_offset;
   window->sview_len = sview_len;
@@ -570,10 +1293,9 @@ decode_window(svn_txdelta_window_t *window, svn_filesize_t sview_offset,
       svn_stringbuf_t *instout = svn_stringbuf_create_empty(pool);
       svn_stringbuf_t *ndout = svn_stringbuf_create_empty(pool);
 
-      SVN_ERR(svn__decompress_lz4(insend, newlen, ndout,
-                                  SVN_DELTA_WINDOW_SIZE));
+      SVN_ERR(svn__decompress_lz4(insend, newlen, ndout, window_size));
       SVN_ERR(svn__decompress_lz4(data, insend - data, instout,
-                                  MAX_INSTRUCTION_SECTION_LEN));
+                                  MAX_INSTRUCTION_SECTION_LEN(window_size)));
 
       newlen = ndout->len;
       data = (unsigned char *)instout->data;
@@ -586,10 +1308,9 @@ decode_window(svn_txdelta_window_t *window, svn_filesize_t sview_offset,
       svn_stringbuf_t *instout = svn_stringbuf_create_empty(pool);
       svn_stringbuf_t *ndout = svn_stringbuf_create_empty(pool);
 
-      SVN_ERR(svn__decompress_zlib(insend, newlen, ndout,
-                                   SVN_DELTA_WINDOW_SIZE));
+      SVN_ERR(svn__decompress_zlib(insend, newlen, ndout, window_size));
       SVN_ERR(svn__decompress_zlib(data, insend - data, instout,
-                                   MAX_INSTRUCTION_SECTION_LEN));
+                                   MAX_INSTRUCTION_SECTION_LEN(window_size)));
 
       newlen = ndout->len;
       data = (unsigned char *)instout->data;
@@ -641,24 +1362,29 @@ write_handler(void *baton,
   const unsigned char *p, *end;
   apr_size_t buflen = *len;
 
-  /* Chew up four bytes at the beginning for the header.  */
-  if (db->header_bytes < SVNDIFF_HEADER_SIZE)
+  /* Chew up four bytes at the beginning for the header.  The last one
+     is the version, optionally flagged with SVNDIFF_LARGE_WINDOWS.  */
+  while (db->header_bytes < SVNDIFF_HEADER_SIZE && buflen > 0)
     {
-      apr_size_t nheader = SVNDIFF_HEADER_SIZE - db->header_bytes;
-      if (nheader > buflen)
-        nheader = buflen;
-      if (memcmp(buffer, SVNDIFF_V0 + db->header_bytes, nheader) == 0)
-        db->version = 0;
-      else if (memcmp(buffer, SVNDIFF_V1 + db->header_bytes, nheader) == 0)
-        db->version = 1;
-      else if (memcmp(buffer, SVNDIFF_V2 + db->header_bytes, nheader) == 0)
-        db->version = 2;
+      unsigned char c = (unsigned char)*buffer;
+
+      if (db->header_bytes < SVNDIFF_HEADER_SIZE - 1)
+        {
+          if (c != (unsigned char)SVNDIFF_V0[db->header_bytes])
+            return svn_error_create(SVN_ERR_SVNDIFF_INVALID_HEADER, NULL,
+                                    _("Svndiff has invalid header"));
+        }
       else
-        return svn_error_create(SVN_ERR_SVNDIFF_INVALID_HEADER, NULL,
-                                _("Svndiff has invalid header"));
-      buflen -= nheader;
-      buffer += nheader;
-      db->header_bytes += nheader;
+        {
+          if ((c & ~SVNDIFF_LARGE_WINDOWS) > 2)
+            return svn_error_create(SVN_ERR_SVNDIFF_INVALID_HEADER, NULL,
+                                    _("Svndiff has invalid header"));
+          db->version = c;
+        }
+
+      --buflen;
+      ++buffer;
+      ++db->header_bytes;
     }
 
   /* Concatenate the old with the new.  */
@@ -710,14 +1436,8 @@ write_handler(void *baton,
           if (p == NULL)
               break;
 
-          if (tview_len > SVN_DELTA_WINDOW_SIZE ||
-              sview_len > SVN_DELTA_WINDOW_SIZE ||
-              /* for svndiff1, newlen includes the original length */
-              newlen > SVN_DELTA_WINDOW_SIZE + SVN__MAX_ENCODED_UINT_LEN ||
-              inslen > MAX_INSTRUCTION_SECTION_LEN)
-            return svn_error_create(
-                     SVN_ERR_SVNDIFF_CORRUPT_WINDOW, NULL,
-                     _("Svndiff contains a too-large window"));
+          SVN_ERR(check_window_size(sview_len, tview_len, inslen, newlen,
+                                    db->version));
 
           /* Check for integer overflow.  */
           if (sview_offset < 0 || inslen + newlen < inslen
@@ -894,12 +1614,13 @@ read_one_size(apr_size_t *size,
   return SVN_NO_ERROR;
 }
 
-/* Read a window header from STREAM and check it for integer overflow. */
+/* Read a window header from STREAM and check it for integer overflow
+   and against the size limits for svndiff VERSION. */
 static svn_error_t *
 read_window_header(svn_stream_t *stream, svn_filesize_t *sview_offset,
                    apr_size_t *sview_len, apr_size_t *tview_len,
                    apr_size_t *inslen, apr_size_t *newlen,
-                   apr_size_t *header_len)
+                   apr_size_t *header_len, int svndiff_version)
 {
   unsigned char c;
 
@@ -921,13 +1642,8 @@ read_window_header(svn_stream_t *stream, svn_filesize_t *sview_offset,
   SVN_ERR(read_one_size(inslen, header_len, stream));
   SVN_ERR(read_one_size(newlen, header_len, stream));
 
-  if (*tview_len > SVN_DELTA_WINDOW_SIZE ||
-      *sview_len > SVN_DELTA_WINDOW_SIZE ||
-      /* for svndiff1, newlen includes the original length */
-      *newlen > SVN_DELTA_WINDOW_SIZE + SVN__MAX_ENCODED_UINT_LEN ||
-      *inslen > MAX_INSTRUCTION_SECTION_LEN)
-    return svn_error_create(SVN_ERR_SVNDIFF_CORRUPT_WINDOW, NULL,
-                            _("Svndiff contains a too-large window"));
+  SVN_ERR(check_window_size(*sview_len, *tview_len, *inslen, *newlen,
+                            svndiff_version));
 
   /* Check for integer overflow.  */
   if (*sview_offset < 0 || *inslen + *newlen < *inslen
@@ -950,7 +1666,8 @@ svn_txdelta_read_svndiff_window(svn_txdelta_window_t **window,
   unsigned char *buf;
 
   SVN_ERR(read_window_header(stream, &sview_offset, &sview_len, &tview_len,
-                             &inslen, &newlen, &header_len));
+                             &inslen, &newlen, &header_len,
+                             svndiff_version));
   len = inslen + newlen;
   buf = apr_palloc(pool, len);
   SVN_ERR(svn_stream_read_full(stream, (char*)buf, &len));
@@ -974,7 +1691,8 @@ svn_txdelta_skip_svndiff_window(apr_file_t *file,
   apr_off_t offset;
 
   SVN_ERR(read_window_header(stream, &sview_offset, &sview_len, &tview_len,
-                             &inslen, &newlen, &header_len));
+                             &inslen, &newlen, &header_len,
+                             svndiff_version));
 
   offset = inslen + newlen;
   return svn_io_file_seek(file, APR_CUR, &offset, pool);
@@ -983,13 +1701,15 @@ svn_txdelta_skip_svndiff_window(apr_file_t *file,
 svn_error_t *
 svn_txdelta__read_raw_window_len(apr_size_t *window_len,
                                  svn_stream_t *stream,
+                                 int svndiff_version,
                                  apr_pool_t *pool)
 {
   svn_filesize_t sview_offset;
   apr_size_t sview_len, tview_len, inslen, newlen, header_len;
 
   SVN_ERR(read_window_header(stream, &sview_offset, &sview_len, &tview_len,
-                             &inslen, &newlen, &header_len));
+                             &inslen, &newlen, &header_len,
+                             svndiff_version));
 
   *window_len = inslen + newlen + header_len;
   return SVN_NO_ERROR;
@@ -1030,7 +1750,9 @@ svndiff_stream_read_fn(void *baton, char *buffer, apr_size_t *len)
     {
       apr_size_t chunk_size;
 
-      if (b->read_pos == b->window_buffer->len && !b->hit_eof)
+      /* The handler may not write anything for some windows, e.g. while
+         it merges them into larger ones. */
+      while (b->read_pos == b->window_buffer->len && !b->hit_eof)
         {
           svn_txdelta_window_t *window;
 
@@ -1064,11 +1786,14 @@ svndiff_stream_read_fn(void *baton, char *buffer, apr_size_t *len)
   return SVN_NO_ERROR;
 }
 
-svn_stream_t *
-svn_txdelta_to_svndiff_stream(svn_txdelta_stream_t *txstream,
-                              int svndiff_version,
-                              int compression_level,
-                              apr_pool_t *pool)
+/* Implement svn_txdelta_to_svndiff_stream() and
+   svn_txdelta__to_svndiff_stream_large(), depending on LARGE_WINDOWS. */
+static svn_stream_t *
+create_svndiff_stream(svn_txdelta_stream_t *txstream,
+                      int svndiff_version,
+                      int compression_level,
+                      svn_boolean_t large_windows,
+                      apr_pool_t *pool)
 {
   svndiff_stream_baton_t *baton;
   svn_stream_t *push_stream;
@@ -1090,12 +1815,37 @@ svn_txdelta_to_svndiff_stream(svn_txdelta_stream_t *txstream,
      stream, the memory usage of this function (in other words, how
      much data can be accumulated in the internal 'window_buffer')
      is limited.  */
-  svn_txdelta_to_svndiff3(&baton->handler, &baton->handler_baton,
-                          push_stream, svndiff_version,
-                          compression_level, pool);
+  if (large_windows)
+    svn_txdelta__to_svndiff_large(&baton->handler, &baton->handler_baton,
+                                  push_stream, svndiff_version,
+                                  compression_level, pool);
+  else
+    svn_txdelta_to_svndiff3(&baton->handler, &baton->handler_baton,
+                            push_stream, svndiff_version,
+                            compression_level, pool);
 
   pull_stream = svn_stream_create(baton, pool);
   svn_stream_set_read2(pull_stream, NULL, svndiff_stream_read_fn);
 
   return pull_stream;
 }
+
+svn_stream_t *
+svn_txdelta_to_svndiff_stream(svn_txdelta_stream_t *txstream,
+                              int svndiff_version,
+                              int compression_level,
+                              apr_pool_t *pool)
+{
+  return create_svndiff_stream(txstream, svndiff_version, compression_level,
+                               FALSE, pool);
+}
+
+svn_stream_t *
+svn_txdelta__to_svndiff_stream_large(svn_txdelta_stream_t *txstream,
+                                     int svndiff_version,
+                                     int compression_level,
+                                     apr_pool_t *pool)
+{
+  return create_svndiff_stream(txstream, svndiff_version, compression_level,
+                               TRUE, pool);
+}
@@ -27,11 +27,18 @@
 
 #include <apr_general.h>        /* for APR_INLINE */
 #include <apr_md5.h>            /* for, um...MD5 stuff */
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
 
 #include "svn_delta.h"
 #include "svn_io.h"
 #include "svn_pools.h"
 #include "svn_checksum.h"
+#include "svn_private_config.h"
+
+#include "private/svn_delta_private.h"
+#include "private/svn_io_private.h"
+#include "private/svn_thread_pool.h"
 
 #include "delta.h"
 
@@ -602,6 +609,566 @@ svn_txdelta_target_push(svn_txdelta_window_handler_t handler,
 }
 
 
+
+/* Functions for computing delta windows in multiple threads. */
+
+#if APR_HAS_THREADS
+
+/* A delta window to be computed by a worker thread. */
+typedef struct delta_slot_t
+{
+  /* Source view data followed by the target view data, 2 windows in size.
+     NULL until the slot gets used for the first time. */
+  char *buf;
+  apr_size_t source_len;
+  apr_size_t target_len;
+  svn_filesize_t source_offset;
+
+  /* Thread-safe pool, private to this slot.  Holds WINDOW. */
+  apr_pool_t *pool;
+
+  /* The delta window computed from BUF.  Valid once DONE has been set. */
+  svn_txdelta_window_t *window;
+
+  /* Set while a worker may access this slot or its WINDOW has not been
+     consumed, yet. */
+  svn_boolean_t busy;
+
+  /* Set by the worker when WINDOW is valid.  Protected by the MUTEX
+     in PD. */
+  svn_boolean_t done;
+
+  /* The ring buffer that this slot belongs to. */
+  struct parallel_delta_t *pd;
+} delta_slot_t;
+
+/* Ring buffer of delta windows that get computed concurrently and are
+   consumed in order. */
+typedef struct parallel_delta_t
+{
+  /* SLOT_COUNT slots, the oldest busy one at index FIRST, followed by
+     USED-1 more busy slots. */
+  delta_slot_t *slots;
+  int slot_count;
+  int first;
+  int used;
+
+  /* Protects the DONE flags and notifies the consumer of completed
+     windows. */
+  apr_thread_mutex_t *mutex;
+  apr_thread_cond_t *cond;
+
+  /* Worker threads to compute the windows. */
+  apr_thread_pool_t *threads;
+
+  /* Allocate slot buffers from here. */
+  apr_pool_t *pool;
+} parallel_delta_t;
+
+/* Implements apr_thread_start_t.  Compute the window for the delta_slot_t
+   given as DATA and notify the consumer. */
+static void * APR_THREAD_FUNC
+compute_window_task(apr_thread_t *thread,
+                    void *data)
+{
+  delta_slot_t *slot = data;
+  parallel_delta_t *pd = slot->pd;
+
+  slot->window = compute_window(slot->buf, slot->source_len,
+                                slot->target_len, slot->source_offset,
+                                slot->pool);
+
+  apr_thread_mutex_lock(pd->mutex);
+  slot->done = TRUE;
+  apr_thread_cond_broadcast(pd->cond);
+  apr_thread_mutex_unlock(pd->mutex);
+
+  return NULL;
+}
+
+/* Block until the worker for SLOT in PD has finished. */
+static svn_error_t *
+wait_for_slot(parallel_delta_t *pd,
+              delta_slot_t *slot)
+{
+  apr_status_t status = apr_thread_mutex_lock(pd->mutex);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't lock mutex"));
+
+  /* This loop implicitly handles spurious wake-ups. */
+  while (!status && !slot->done)
+    status = apr_thread_cond_wait(pd->cond, pd->mutex);
+
+  apr_thread_mutex_unlock(pd->mutex);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't wait on condition variable"));
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *DONE to whether the window in the oldest busy slot in PD is
+   available without blocking. */
+static svn_error_t *
+oldest_slot_done(svn_boolean_t *done,
+                 parallel_delta_t *pd)
+{
+  apr_status_t status;
+
+  if (pd->used == 0)
+    {
+      *done = FALSE;
+      return SVN_NO_ERROR;
+    }
+
+  status = apr_thread_mutex_lock(pd->mutex);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't lock mutex"));
+
+  *done = pd->slots[pd->first].done;
+  apr_thread_mutex_unlock(pd->mutex);
+
+  return SVN_NO_ERROR;
+}
+
+/* Return the slot in PD that follows the busy ones.  PD must have at
+   least one slot that is not busy. */
+static delta_slot_t *
+next_free_slot(parallel_delta_t *pd)
+{
+  delta_slot_t *slot = &pd->slots[(pd->first + pd->used) % pd->slot_count];
+
+  if (slot->buf == NULL)
+    {
+      slot->buf = apr_palloc(pd->pool, 2 * SVN_DELTA_WINDOW_SIZE);
+      slot->pool = svn_pool_create(NULL);
+    }
+
+  return slot;
+}
+
+/* Hand SLOT, as returned by next_free_slot() for PD, to a worker. */
+static void
+submit_slot(parallel_delta_t *pd,
+            delta_slot_t *slot)
+{
+  apr_status_t status;
+
+  slot->busy = TRUE;
+  slot->done = FALSE;
+  ++pd->used;
+
+  /* If we can't get a worker thread, do the work ourselves. */
+  status = apr_thread_pool_push(pd->threads, compute_window_task, slot,
+                                APR_THREAD_TASK_PRIORITY_NORMAL, pd);
+  if (status)
+    compute_window_task(NULL, slot);
+}
+
+/* Wait for the oldest busy slot in PD and return it in *SLOT. */
+static svn_error_t *
+wait_for_oldest(delta_slot_t **slot,
+                parallel_delta_t *pd)
+{
+  *slot = &pd->slots[pd->first];
+  return svn_error_trace(wait_for_slot(pd, *slot));
+}
+
+/* Release the oldest busy slot in PD after its window has been
+   consumed. */
+static void
+release_oldest(parallel_delta_t *pd)
+{
+  delta_slot_t *slot = &pd->slots[pd->first];
+
+  slot->busy = FALSE;
+  slot->done = FALSE;
+  svn_pool_clear(slot->pool);
+
+  pd->first = (pd->first + 1) % pd->slot_count;
+  --pd->used;
+}
+
+/* Pre-cleanup function for the parallel_delta_t given as DATA.
+   Wait for all workers that still access its slots and release them. */
+static apr_status_t
+parallel_delta_cleanup(void *data)
+{
+  parallel_delta_t *pd = data;
+  int i;
+
+  for (i = 0; i < pd->slot_count; ++i)
+    {
+      delta_slot_t *slot = &pd->slots[i];
+
+      if (slot->busy)
+        svn_error_clear(wait_for_slot(pd, slot));
+
+      if (slot->pool)
+        svn_pool_destroy(slot->pool);
+    }
+
+  return APR_SUCCESS;
+}
+
+/* Set *PD_P to a new ring buffer, allocated in POOL, for computing up to
+   MAX_THREADS windows at once. */
+static svn_error_t *
+create_parallel_delta(parallel_delta_t **pd_p,
+                      int max_threads,
+                      apr_pool_t *pool)
+{
+  parallel_delta_t *pd = apr_pcalloc(pool, sizeof(*pd));
+  apr_status_t status;
+  int i;
+
+  SVN_ERR(svn_thread_pool__get(&pd->threads, pool));
+
+  /* Twice as many slots as workers such that the workers are kept busy
+     while we wait for the oldest window and consume it. */
+  pd->slot_count = 2 * max_threads;
+  pd->slots = apr_pcalloc(pool, pd->slot_count * sizeof(*pd->slots));
+  for (i = 0; i < pd->slot_count; ++i)
+    pd->slots[i].pd = pd;
+
+  pd->pool = pool;
+
+  status = apr_thread_mutex_create(&pd->mutex, APR_THREAD_MUTEX_DEFAULT,
+                                   pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create mutex"));
+
+  status = apr_thread_cond_create(&pd->cond, pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create condition variable"));
+
+  /* The workers must be done before the mutex and the slots get
+     destroyed. */
+  apr_pool_pre_cleanup_register(pool, pd, parallel_delta_cleanup);
+
+  *pd_p = pd;
+
+  return SVN_NO_ERROR;
+}
+
+/* Parallel delta stream baton. */
+struct parallel_txdelta_baton {
+  /* These are copied from parameters passed to svn_txdelta__parallel. */
+  svn_stream_t *source;
+  svn_stream_t *target;
+
+  /* Private data */
+  svn_boolean_t more_source;    /* FALSE if source stream hit EOF. */
+  svn_boolean_t more_target;    /* FALSE if target stream hit EOF. */
+  svn_boolean_t more;           /* TRUE if there are more windows. */
+  svn_filesize_t pos;           /* Offset of next read in source file. */
+  parallel_delta_t *pd;         /* Windows being computed. */
+
+  svn_checksum_ctx_t *context;  /* If not NULL, the context for computing
+                                   the checksum. */
+  svn_checksum_t *checksum;     /* If non-NULL, the checksum of TARGET. */
+
+  apr_pool_t *result_pool;      /* For results (e.g. checksum) */
+};
+
+/* Implements svn_txdelta_next_window_fn_t.  Like txdelta_next_window()
+   but read ahead and compute the following windows in the background. */
+static svn_error_t *
+parallel_txdelta_next_window(svn_txdelta_window_t **window,
+                             void *baton,
+                             apr_pool_t *pool)
+{
+  struct parallel_txdelta_baton *b = baton;
+  parallel_delta_t *pd = b->pd;
+  delta_slot_t *slot;
+
+  /* Keep all slots busy. */
+  while (b->more_target && pd->used < pd->slot_count)
+    {
+      apr_size_t source_len = SVN_DELTA_WINDOW_SIZE;
+      apr_size_t target_len = SVN_DELTA_WINDOW_SIZE;
+
+      slot = next_free_slot(pd);
+
+      /* Read the source stream. */
+      if (b->more_source)
+        {
+          SVN_ERR(svn_stream_read_full(b->source, slot->buf, &source_len));
+          b->more_source = (source_len == SVN_DELTA_WINDOW_SIZE);
+        }
+      else
+        source_len = 0;
+
+      /* Read the target stream. */
+      SVN_ERR(svn_stream_read_full(b->target, slot->buf + source_len,
+                                   &target_len));
+      b->pos += source_len;
+
+      if (target_len == 0)
+        {
+          /* No target data?  There will be no further windows. */
+          if (b->context != NULL)
+            SVN_ERR(svn_checksum_final(&b->checksum, b->context,
+                                       b->result_pool));
+
+          b->more_target = FALSE;
+          break;
+        }
+      else if (b->context != NULL)
+        SVN_ERR(svn_checksum_update(b->context, slot->buf + source_len,
+                                    target_len));
+
+      slot->source_len = source_len;
+      slot->target_len = target_len;
+      slot->source_offset = b->pos - source_len;
+      submit_slot(pd, slot);
+    }
+
+  if (pd->used == 0)
+    {
+      /* We're done; return the final window. */
+      *window = NULL;
+      b->more = FALSE;
+      return SVN_NO_ERROR;
+    }
+
+  /* The slot will be reused, so return a copy. */
+  SVN_ERR(wait_for_oldest(&slot, pd));
+  *window = svn_txdelta_window_dup(slot->window, pool);
+  release_oldest(pd);
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_txdelta_md5_digest_fn_t for parallel delta streams. */
+static const unsigned char *
+parallel_txdelta_md5_digest(void *baton)
+{
+  struct parallel_txdelta_baton *b = baton;
+  /* If there are more windows for this stream, the digest has not yet
+     been calculated.  */
+  if (b->more)
+    return NULL;
+
+  /* If checksumming has not been activated, there will be no digest. */
+  if (b->context == NULL)
+    return NULL;
+
+  /* The checksum should be there. */
+  return b->checksum->digest;
+}
+
+/* Parallel target-push stream descriptor. */
+struct parallel_tpush_baton {
+  /* These are copied from parameters passed to
+     svn_txdelta__target_push_parallel. */
+  svn_stream_t *source;
+  svn_txdelta_window_handler_t wh;
+  void *whb;
+
+  /* Private data */
+  svn_filesize_t source_offset;
+  svn_boolean_t source_done;
+  delta_slot_t *filling;        /* Slot receiving target data, or NULL. */
+  parallel_delta_t *pd;         /* Windows being computed. */
+};
+
+/* Wait for the oldest window in TB, send it to the window handler and
+   release its slot. */
+static svn_error_t *
+send_oldest_window(struct parallel_tpush_baton *tb)
+{
+  delta_slot_t *slot;
+  svn_error_t *err;
+
+  SVN_ERR(wait_for_oldest(&slot, tb->pd));
+  err = tb->wh(slot->window, tb->whb);
+  release_oldest(tb->pd);
+
+  return svn_error_trace(err);
+}
+
+/* Send all windows in TB that are available without blocking, in order. */
+static svn_error_t *
+send_completed_windows(struct parallel_tpush_baton *tb)
+{
+  svn_boolean_t done;
+
+  SVN_ERR(oldest_slot_done(&done, tb->pd));
+  while (done)
+    {
+      SVN_ERR(send_oldest_window(tb));
+      SVN_ERR(oldest_slot_done(&done, tb->pd));
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Start filling the next slot in TB and read the respective source data.
+   Make room for it, if necessary. */
+static svn_error_t *
+start_next_slot(struct parallel_tpush_baton *tb)
+{
+  delta_slot_t *slot;
+
+  if (tb->pd->used == tb->pd->slot_count)
+    SVN_ERR(send_oldest_window(tb));
+
+  slot = next_free_slot(tb->pd);
+  slot->source_len = 0;
+  if (!tb->source_done)
+    {
+      slot->source_len = SVN_DELTA_WINDOW_SIZE;
+      SVN_ERR(svn_stream_read_full(tb->source, slot->buf,
+                                   &slot->source_len));
+      if (slot->source_len < SVN_DELTA_WINDOW_SIZE)
+        tb->source_done = TRUE;
+    }
+
+  slot->source_offset = tb->source_offset;
+  slot->target_len = 0;
+  tb->source_offset += slot->source_len;
+  tb->filling = slot;
+
+  return SVN_NO_ERROR;
+}
+
+/* Like tpush_write_handler() but computes the windows concurrently. */
+static svn_error_t *
+parallel_tpush_write_handler(void *baton, const char *data, apr_size_t *len)
+{
+  struct parallel_tpush_baton *tb = baton;
+  apr_size_t chunk_len, data_len = *len;
+
+  while (data_len > 0)
+    {
+      delta_slot_t *slot;
+
+      if (tb->filling == NULL)
+        SVN_ERR(start_next_slot(tb));
+
+      /* Copy in the target data, up to SVN_DELTA_WINDOW_SIZE. */
+      slot = tb->filling;
+      chunk_len = SVN_DELTA_WINDOW_SIZE - slot->target_len;
+      if (chunk_len > data_len)
+        chunk_len = data_len;
+      memcpy(slot->buf + slot->source_len + slot->target_len, data,
+             chunk_len);
+      data += chunk_len;
+      data_len -= chunk_len;
+      slot->target_len += chunk_len;
+
+      /* If we're full of target data, have the window computed and fire
+         off whatever windows are ready. */
+      if (slot->target_len == SVN_DELTA_WINDOW_SIZE)
+        {
+          submit_slot(tb->pd, slot);
+          tb->filling = NULL;
+          SVN_ERR(send_completed_windows(tb));
+        }
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Like tpush_close_handler() but computes the windows concurrently. */
+static svn_error_t *
+parallel_tpush_close_handler(void *baton)
+{
+  struct parallel_tpush_baton *tb = baton;
+
+  /* Compute a final window if we have any residual target data. */
+  if (tb->filling)
+    {
+      submit_slot(tb->pd, tb->filling);
+      tb->filling = NULL;
+    }
+
+  while (tb->pd->used)
+    SVN_ERR(send_oldest_window(tb));
+
+  /* Send a final NULL window signifying the end. */
+  return tb->wh(NULL, tb->whb);
+}
+
+#endif /* APR_HAS_THREADS */
+
+svn_error_t *
+svn_txdelta__parallel(svn_txdelta_stream_t **stream,
+                      svn_stream_t *source,
+                      svn_stream_t *target,
+                      svn_boolean_t calculate_checksum,
+                      int max_threads,
+                      apr_pool_t *pool)
+{
+#if APR_HAS_THREADS
+  struct parallel_txdelta_baton *b;
+
+  if (max_threads < 2)
+    {
+      svn_txdelta2(stream, source, target, calculate_checksum, pool);
+      return SVN_NO_ERROR;
+    }
+
+  b = apr_pcalloc(pool, sizeof(*b));
+  b->source = source;
+  b->target = target;
+  b->more_source = TRUE;
+  b->more_target = TRUE;
+  b->more = TRUE;
+  b->context = calculate_checksum
+             ? svn_checksum_ctx_create(svn_checksum_md5, pool)
+             : NULL;
+  b->result_pool = pool;
+  SVN_ERR(create_parallel_delta(&b->pd, max_threads, pool));
+
+  *stream = svn_txdelta_stream_create(b, parallel_txdelta_next_window,
+                                      parallel_txdelta_md5_digest, pool);
+#else
+  svn_txdelta2(stream, source, target, calculate_checksum, pool);
+#endif
+
+  return SVN_NO_ERROR;
+}
+
+svn_error_t *
+svn_txdelta__target_push_parallel(svn_stream_t **stream,
+                                  svn_txdelta_window_handler_t handler,
+                                  void *handler_baton,
+                                  svn_stream_t *source,
+                                  int max_threads,
+                                  apr_pool_t *pool)
+{
+#if APR_HAS_THREADS
+  struct parallel_tpush_baton *tb;
+
+  if (max_threads < 2)
+    {
+      *stream = svn_txdelta_target_push(handler, handler_baton, source,
+                                        pool);
+      return SVN_NO_ERROR;
+    }
+
+  /* Initialize baton. */
+  tb = apr_pcalloc(pool, sizeof(*tb));
+  tb->source = source;
+  tb->wh = handler;
+  tb->whb = handler_baton;
+  tb->source_offset = 0;
+  tb->source_done = FALSE;
+  tb->filling = NULL;
+  SVN_ERR(create_parallel_delta(&tb->pd, max_threads, pool));
+
+  /* Create and return writable stream. */
+  *stream = svn_stream_create(tb, pool);
+  svn_stream_set_write(*stream, parallel_tpush_write_handler);
+  svn_stream_set_close(*stream, parallel_tpush_close_handler);
+#else
+  *stream = svn_txdelta_target_push(handler, handler_baton, source, pool);
+#endif
+
+  return SVN_NO_ERROR;
+}
+
 
 /* Functions for applying deltas.  */
 
@@ -720,6 +1287,7 @@ apply_window(svn_txdelta_window_t *window, void *baton)
 {
   struct apply_baton *ab = (struct apply_baton *) baton;
   apr_size_t len;
+  char *tbuf;
 
   if (window == NULL)
     {
@@ -748,9 +1316,6 @@ apply_window(svn_txdelta_window_t *window, void *baton)
                      && (window->sview_offset + window->sview_len
                          >= ab->sbuf_offset + ab->sbuf_len)));
 
-  /* Make sure there's enough room in the target buffer.  */
-  SVN_ERR(size_buffer(&ab->tbuf, &ab->tbuf_size, window->tview_len, ab->pool));
-
   /* Prepare the source buffer for reading from the input stream.  */
   if (window->sview_offset != ab->sbuf_offset
       || window->sview_len > ab->sbuf_size)
@@ -787,19 +1352,31 @@ apply_window(svn_txdelta_window_t *window, void *baton)
       ab->sbuf_len = window->sview_len;
     }
 
+  /* If the target stream lets us, construct the target view right where
+     it will end up.  Otherwise, make sure there's enough room in our own
+     target buffer.  */
+  SVN_ERR(svn_stream__get_write_buffer(&tbuf, ab->target,
+                                       window->tview_len));
+  if (tbuf == NULL)
+    {
+      SVN_ERR(size_buffer(&ab->tbuf, &ab->tbuf_size, window->tview_len,
+                          ab->pool));
+      tbuf = ab->tbuf;
+    }
+
   /* Apply the window instructions to the source view to generate
      the target view.  */
   len = window->tview_len;
-  svn_txdelta_apply_instructions(window, ab->sbuf, ab->tbuf, &len);
+  svn_txdelta_apply_instructions(window, ab->sbuf, tbuf, &len);
   SVN_ERR_ASSERT(len == window->tview_len);
 
   /* Write out the output. */
 
   /* Just update the context here. */
   if (ab->result_digest)
-    SVN_ERR(svn_checksum_update(ab->md5_context, ab->tbuf, len));
+    SVN_ERR(svn_checksum_update(ab->md5_context, tbuf, len));
 
-  return svn_stream_write(ab->target, ab->tbuf, &len);
+  return svn_stream_write(ab->target, tbuf, &len);
 }
 
 
@@ -0,0 +1,872 @@
+/*
+ * threaded_editor.c:  drive a delta editor in a separate thread
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
+#include <apr_thread_proc.h>
+
+#include "svn_delta.h"
+#include "svn_pools.h"
+#include "svn_private_config.h"
+
+#include "private/svn_delta_private.h"
+
+#if APR_HAS_THREADS
+
+/* The editor calls that get queued. */
+typedef enum command_kind_t
+{
+  command_set_target_revision,
+  command_open_root,
+  command_delete_entry,
+  command_add_directory,
+  command_open_directory,
+  command_change_dir_prop,
+  command_close_directory,
+  command_absent_directory,
+  command_add_file,
+  command_open_file,
+  command_apply_textdelta,
+  command_window,
+  command_change_file_prop,
+  command_close_file,
+  command_absent_file,
+  command_close_edit
+} command_kind_t;
+
+/* Directory and file baton handed out to the producer.  It stands in for
+   the respective baton of the wrapped editor, which only becomes known
+   once the consumer thread executed the call that creates it. */
+typedef struct node_baton_t
+{
+  struct edit_baton_t *eb;
+
+  /* The wrapped editor's baton and the pool it lives in.  Only accessed
+     by the consumer thread. */
+  void *wrapped_baton;
+  apr_pool_t *pool;
+
+  /* Text delta window handler returned by the wrapped editor.  Only
+     accessed by the consumer thread. */
+  svn_txdelta_window_handler_t handler;
+  void *handler_baton;
+
+  /* Next entry in the free list of the edit baton. */
+  struct node_baton_t *next_free;
+} node_baton_t;
+
+/* A queued editor call and its parameters.  Depending on KIND, only some
+   of the parameters are used. */
+typedef struct command_t
+{
+  command_kind_t kind;
+
+  /* Pool holding copies of all parameters.  It gets cleared after each
+     command and is never used by two threads at the same time. */
+  apr_pool_t *pool;
+
+  /* The parent directory, directory or file that the call refers to. */
+  node_baton_t *node;
+
+  /* The directory or file baton created by the call. */
+  node_baton_t *child;
+
+  /* Path of the entry to open, add, delete or mark absent. */
+  const char *path;
+
+  /* Copy-from path, property name or checksum. */
+  const char *arg;
+
+  /* Target, base or copy-from revision. */
+  svn_revnum_t revision;
+
+  /* Property value. */
+  const svn_string_t *value;
+
+  /* Text delta window.  NULL for the final window. */
+  svn_txdelta_window_t *window;
+} command_t;
+
+/* Our edit baton. */
+typedef struct edit_baton_t
+{
+  const svn_delta_editor_t *wrapped_editor;
+  void *wrapped_edit_baton;
+
+  /* Node batons get allocated here.  Only used by the producer. */
+  apr_pool_t *pool;
+
+  /* Root of all pools used by the consumer thread. */
+  apr_pool_t *consumer_pool;
+
+  /* Ring buffer of QUEUE_SIZE commands.  The oldest one is at index
+     FIRST and USED commands have been queued. */
+  command_t *queue;
+  int queue_size;
+  int first;
+  int used;
+
+  /* Node batons that the consumer has closed and may be reused. */
+  node_baton_t *free_nodes;
+
+  /* First error returned by the wrapped editor.  Once set, all further
+     commands get discarded. */
+  svn_error_t *err;
+
+  /* Set to make the consumer thread exit without processing the remaining
+     commands. */
+  svn_boolean_t abort;
+
+  /* Protect all of the above, except for the node batons' contents and
+     the command at index FIRST while it is being executed. */
+  apr_thread_mutex_t *mutex;
+  apr_thread_cond_t *not_empty;
+  apr_thread_cond_t *not_full;
+
+  /* The consumer thread.  NULL if it has been joined. */
+  apr_thread_t *thread;
+} edit_baton_t;
+
+
+/*** Consumer side ***/
+
+/* Execute COMMAND on the wrapped editor in EB.  Use SCRATCH_POOL for
+   temporary allocations. */
+static svn_error_t *
+execute_command(edit_baton_t *eb,
+                command_t *command,
+                apr_pool_t *scratch_pool)
+{
+  const svn_delta_editor_t *editor = eb->wrapped_editor;
+  node_baton_t *node = command->node;
+  node_baton_t *child = command->child;
+
+  /* The wrapped editor may keep the paths of new nodes around for as
+     long as their batons live. */
+  if (child)
+    {
+      child->pool = svn_pool_create(eb->consumer_pool);
+      command->path = apr_pstrdup(child->pool, command->path);
+      command->arg = apr_pstrdup(child->pool, command->arg);
+    }
+
+  switch (command->kind)
+    {
+      case command_set_target_revision:
+        return svn_error_trace(editor->set_target_revision(
+                                 eb->wrapped_edit_baton, command->revision,
+                                 scratch_pool));
+
+      case command_open_root:
+        return svn_error_trace(editor->open_root(eb->wrapped_edit_baton,
+                                                 command->revision,
+                                                 child->pool,
+                                                 &child->wrapped_baton));
+
+      case command_delete_entry:
+        return svn_error_trace(editor->delete_entry(command->path,
+                                                    command->revision,
+                                                    node->wrapped_baton,
+                                                    scratch_pool));
+
+      case command_add_directory:
+        return svn_error_trace(editor->add_directory(command->path,
+                                                     node->wrapped_baton,
+                                                     command->arg,
+                                                     command->revision,
+                                                     child->pool,
+                                                     &child->wrapped_baton));
+
+      case command_open_directory:
+        return svn_error_trace(editor->open_directory(command->path,
+                                                      node->wrapped_baton,
+                                                      command->revision,
+                                                      child->pool,
+                                                      &child->wrapped_baton));
+
+      case command_change_dir_prop:
+        return svn_error_trace(editor->change_dir_prop(node->wrapped_baton,
+                                                       command->arg,
+                                                       command->value,
+                                                       scratch_pool));
+
+      case command_close_directory:
+        SVN_ERR(editor->close_directory(node->wrapped_baton, scratch_pool));
+        svn_pool_destroy(node->pool);
+        return SVN_NO_ERROR;
+
+      case command_absent_directory:
+        return svn_error_trace(editor->absent_directory(command->path,
+                                                        node->wrapped_baton,
+                                                        scratch_pool));
+
+      case command_add_file:
+        return svn_error_trace(editor->add_file(command->path,
+                                                node->wrapped_baton,
+                                                command->arg,
+                                                command->revision,
+                                                child->pool,
+                                                &child->wrapped_baton));
+
+      case command_open_file:
+        return svn_error_trace(editor->open_file(command->path,
+                                                 node->wrapped_baton,
+                                                 command->revision,
+                                                 child->pool,
+                                                 &child->wrapped_baton));
+
+      case command_apply_textdelta:
+        return svn_error_trace(editor->apply_textdelta(node->wrapped_baton,
+                                                       command->arg,
+                                                       node->pool,
+                                                       &node->handler,
+                                                       &node->handler_baton));
+
+      case command_window:
+        return svn_error_trace(node->handler(command->window,
+                                             node->handler_baton));
+
+      case command_change_file_prop:
+        return svn_error_trace(editor->change_file_prop(node->wrapped_baton,
+                                                        command->arg,
+                                                        command->value,
+                                                        scratch_pool));
+
+      case command_close_file:
+        SVN_ERR(editor->close_file(node->wrapped_baton, command->arg,
+                                   scratch_pool));
+        svn_pool_destroy(node->pool);
+        return SVN_NO_ERROR;
+
+      case command_absent_file:
+        return svn_error_trace(editor->absent_file(command->path,
+                                                   node->wrapped_baton,
+                                                   scratch_pool));
+
+      case command_close_edit:
+        return svn_error_trace(editor->close_edit(eb->wrapped_edit_baton,
+                                                  scratch_pool));
+    }
+
+  SVN_ERR_MALFUNCTION();
+}
+
+/* Implements apr_thread_start_t.  Execute the commands queued in the
+   edit_baton_t given as DATA until the edit gets closed or aborted. */
+static void * APR_THREAD_FUNC
+consumer_thread(apr_thread_t *thread,
+                void *data)
+{
+  edit_baton_t *eb = data;
+  apr_pool_t *iterpool = svn_pool_create(eb->consumer_pool);
+  svn_boolean_t done = FALSE;
+
+  while (!done)
+    {
+      command_t *command;
+      node_baton_t *closed_node = NULL;
+      svn_boolean_t failed;
+      svn_error_t *err = SVN_NO_ERROR;
+
+      apr_thread_mutex_lock(eb->mutex);
+      while (eb->used == 0 && !eb->abort)
+        apr_thread_cond_wait(eb->not_empty, eb->mutex);
+
+      if (eb->abort)
+        {
+          apr_thread_mutex_unlock(eb->mutex);
+          break;
+        }
+
+      command = &eb->queue[eb->first];
+      failed = eb->err != NULL;
+      apr_thread_mutex_unlock(eb->mutex);
+
+      /* After an error, we only keep the queue moving. */
+      svn_pool_clear(iterpool);
+      if (!failed)
+        err = execute_command(eb, command, iterpool);
+
+      if (   command->kind == command_close_directory
+          || command->kind == command_close_file)
+        closed_node = command->node;
+
+      done = command->kind == command_close_edit;
+      svn_pool_clear(command->pool);
+
+      apr_thread_mutex_lock(eb->mutex);
+      if (err)
+        eb->err = err;
+
+      if (closed_node)
+        {
+          closed_node->next_free = eb->free_nodes;
+          eb->free_nodes = closed_node;
+        }
+
+      eb->first = (eb->first + 1) % eb->queue_size;
+      --eb->used;
+      apr_thread_cond_signal(eb->not_full);
+      apr_thread_mutex_unlock(eb->mutex);
+    }
+
+  svn_pool_destroy(iterpool);
+  apr_thread_exit(thread, APR_SUCCESS);
+
+  return NULL;
+}
+
+
+/*** Producer side ***/
+
+/* Wait for a free slot in EB's queue and return it in *COMMAND, prepared
+   for a call of type KIND on NODE.  If the wrapped editor has failed,
+   return a copy of its error instead. */
+static svn_error_t *
+begin_command(command_t **command,
+              edit_baton_t *eb,
+              command_kind_t kind,
+              node_baton_t *node)
+{
+  command_t *result;
+  apr_status_t status = apr_thread_mutex_lock(eb->mutex);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't lock mutex"));
+
+  /* This is where the back-pressure comes from. */
+  while (!status && eb->used == eb->queue_size && !eb->err)
+    status = apr_thread_cond_wait(eb->not_full, eb->mutex);
+
+  if (status || eb->err)
+    {
+      svn_error_t *err = status
+                       ? svn_error_wrap_apr(status, _("Can't wait on "
+                                                      "condition variable"))
+                       : svn_error_dup(eb->err);
+      apr_thread_mutex_unlock(eb->mutex);
+      return err;
+    }
+
+  result = &eb->queue[(eb->first + eb->used) % eb->queue_size];
+  apr_thread_mutex_unlock(eb->mutex);
+
+  /* The slot is ours until we queue it. */
+  if (result->pool == NULL)
+    result->pool = svn_pool_create(NULL);
+
+  result->kind = kind;
+  result->node = node;
+  result->child = NULL;
+  result->path = NULL;
+  result->arg = NULL;
+  result->revision = SVN_INVALID_REVNUM;
+  result->value = NULL;
+  result->window = NULL;
+
+  *command = result;
+  return SVN_NO_ERROR;
+}
+
+/* Hand the command returned by the last begin_command() call on EB to the
+   consumer thread. */
+static svn_error_t *
+queue_command(edit_baton_t *eb)
+{
+  apr_status_t status = apr_thread_mutex_lock(eb->mutex);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't lock mutex"));
+
+  ++eb->used;
+  apr_thread_cond_signal(eb->not_empty);
+  apr_thread_mutex_unlock(eb->mutex);
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *NODE to a new node baton for EB. */
+static svn_error_t *
+new_node(node_baton_t **node,
+         edit_baton_t *eb)
+{
+  node_baton_t *result;
+  apr_status_t status = apr_thread_mutex_lock(eb->mutex);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't lock mutex"));
+
+  result = eb->free_nodes;
+  if (result)
+    eb->free_nodes = result->next_free;
+
+  apr_thread_mutex_unlock(eb->mutex);
+
+  if (result == NULL)
+    result = apr_palloc(eb->pool, sizeof(*result));
+
+  memset(result, 0, sizeof(*result));
+  result->eb = eb;
+
+  *node = result;
+  return SVN_NO_ERROR;
+}
+
+/* Wait for EB's consumer thread to exit.  If ABORT is set, make it exit
+   without processing the remaining commands. */
+static void
+join_consumer(edit_baton_t *eb,
+              svn_boolean_t abort)
+{
+  apr_status_t retval;
+
+  if (eb->thread == NULL)
+    return;
+
+  if (abort)
+    {
+      apr_thread_mutex_lock(eb->mutex);
+      eb->abort = TRUE;
+      apr_thread_cond_signal(eb->not_empty);
+      apr_thread_mutex_unlock(eb->mutex);
+    }
+
+  apr_thread_join(&retval, eb->thread);
+  eb->thread = NULL;
+}
+
+static svn_error_t *
+set_target_revision(void *edit_baton,
+                    svn_revnum_t target_revision,
+                    apr_pool_t *pool)
+{
+  edit_baton_t *eb = edit_baton;
+  command_t *command;
+
+  SVN_ERR(begin_command(&command, eb, command_set_target_revision, NULL));
+  command->revision = target_revision;
+
+  return svn_error_trace(queue_command(eb));
+}
+
+static svn_error_t *
+open_root(void *edit_baton,
+          svn_revnum_t base_revision,
+          apr_pool_t *pool,
+          void **root_baton)
+{
+  edit_baton_t *eb = edit_baton;
+  command_t *command;
+
+  SVN_ERR(begin_command(&command, eb, command_open_root, NULL));
+  command->revision = base_revision;
+  SVN_ERR(new_node(&command->child, eb));
+  *root_baton = command->child;
+
+  return svn_error_trace(queue_command(eb));
+}
+
+static svn_error_t *
+delete_entry(const char *path,
+             svn_revnum_t base_revision,
+             void *parent_baton,
+             apr_pool_t *pool)
+{
+  node_baton_t *parent = parent_baton;
+  command_t *command;
+
+  SVN_ERR(begin_command(&command, parent->eb, command_delete_entry, parent));
+  command->path = apr_pstrdup(command->pool, path);
+  command->revision = base_revision;
+
+  return svn_error_trace(queue_command(parent->eb));
+}
+
+/* Queue an add_directory or add_file call, depending on KIND. */
+static svn_error_t *
+add_node(command_kind_t kind,
+         const char *path,
+         void *parent_baton,
+         const char *copyfrom_path,
+         svn_revnum_t copyfrom_revision,
+         void **child_baton)
+{
+  node_baton_t *parent = parent_baton;
+  command_t *command;
+
+  SVN_ERR(begin_command(&command, parent->eb, kind, parent));
+  command->path = apr_pstrdup(command->pool, path);
+  command->arg = apr_pstrdup(command->pool, copyfrom_path);
+  command->revision = copyfrom_revision;
+  SVN_ERR(new_node(&command->child, parent->eb));
+  *child_baton = command->child;
+
+  return svn_error_trace(queue_command(parent->eb));
+}
+
+/* Queue an open_directory or open_file call, depending on KIND. */
+static svn_error_t *
+open_node(command_kind_t kind,
+          const char *path,
+          void *parent_baton,
+          svn_revnum_t base_revision,
+          void **child_baton)
+{
+  node_baton_t *parent = parent_baton;
+  command_t *command;
+
+  SVN_ERR(begin_command(&command, parent->eb, kind, parent));
+  command->path = apr_pstrdup(command->pool, path);
+  command->revision = base_revision;
+  SVN_ERR(new_node(&command->child, parent->eb));
+  *child_baton = command->child;
+
+  return svn_error_trace(queue_command(parent->eb));
+}
+
+/* Queue a change_dir_prop or change_file_prop call, depending on KIND. */
+static svn_error_t *
+change_prop(command_kind_t kind,
+            void *baton,
+            const char *name,
+            const svn_string_t *value)
+{
+  node_baton_t *node = baton;
+  command_t *command;
+
+  SVN_ERR(begin_command(&command, node->eb, kind, node));
+  command->arg = apr_pstrdup(command->pool, name);
+  command->value = value ? svn_string_dup(value, command->pool) : NULL;
+
+  return svn_error_trace(queue_command(node->eb));
+}
+
+/* Queue an absent_directory or absent_file call, depending on KIND. */
+static svn_error_t *
+absent_node(command_kind_t kind,
+            const char *path,
+            void *parent_baton)
+{
+  node_baton_t *parent = parent_baton;
+  command_t *command;
+
+  SVN_ERR(begin_command(&command, parent->eb, kind, parent));
+  command->path = apr_pstrdup(command->pool, path);
+
+  return svn_error_trace(queue_command(parent->eb));
+}
+
+static svn_error_t *
+add_directory(const char *path,
+              void *parent_baton,
+              const char *copyfrom_path,
+              svn_revnum_t copyfrom_revision,
+              apr_pool_t *pool,
+              void **child_baton)
+{
+  return svn_error_trace(add_node(command_add_directory, path, parent_baton,
+                                  copyfrom_path, copyfrom_revision,
+                                  child_baton));
+}
+
+static svn_error_t *
+open_directory(const char *path,
+               void *parent_baton,
+               svn_revnum_t base_revision,
+               apr_pool_t *pool,
+               void **child_baton)
+{
+  return svn_error_trace(open_node(command_open_directory, path,
+                                   parent_baton, base_revision,
+                                   child_baton));
+}
+
+static svn_error_t *
+change_dir_prop(void *dir_baton,
+                const char *name,
+                const svn_string_t *value,
+                apr_pool_t *pool)
+{
+  return svn_error_trace(change_prop(command_change_dir_prop, dir_baton,
+                                     name, value));
+}
+
+static svn_error_t *
+close_directory(void *dir_baton,
+                apr_pool_t *pool)
+{
+  node_baton_t *node = dir_baton;
+  command_t *command;
+
+  SVN_ERR(begin_command(&command, node->eb, command_close_directory, node));
+
+  return svn_error_trace(queue_command(node->eb));
+}
+
+static svn_error_t *
+absent_directory(const char *path,
+                 void *parent_baton,
+                 apr_pool_t *pool)
+{
+  return svn_error_trace(absent_node(command_absent_directory, path,
+                                     parent_baton));
+}
+
+static svn_error_t *
+add_file(const char *path,
+         void *parent_baton,
+         const char *copyfrom_path,
+         svn_revnum_t copyfrom_revision,
+         apr_pool_t *pool,
+         void **file_baton)
+{
+  return svn_error_trace(add_node(command_add_file, path, parent_baton,
+                                  copyfrom_path, copyfrom_revision,
+                                  file_baton));
+}
+
+static svn_error_t *
+open_file(const char *path,
+          void *parent_baton,
+          svn_revnum_t base_revision,
+          apr_pool_t *pool,
+          void **file_baton)
+{
+  return svn_error_trace(open_node(command_open_file, path, parent_baton,
+                                   base_revision, file_baton));
+}
+
+/* Implements svn_txdelta_window_handler_t.  Queue WINDOW for the wrapped
+   editor's window handler of the file given by the node baton BATON. */
+static svn_error_t *
+window_handler(svn_txdelta_window_t *window,
+               void *baton)
+{
+  node_baton_t *node = baton;
+  command_t *command;
+
+  SVN_ERR(begin_command(&command, node->eb, command_window, node));
+  if (window)
+    command->window = svn_txdelta_window_dup(window, command->pool);
+
+  return svn_error_trace(queue_command(node->eb));
+}
+
+static svn_error_t *
+apply_textdelta(void *file_baton,
+                const char *base_checksum,
+                apr_pool_t *pool,
+                svn_txdelta_window_handler_t *handler,
+                void **handler_baton)
+{
+  node_baton_t *node = file_baton;
+  command_t *command;
+
+  SVN_ERR(begin_command(&command, node->eb, command_apply_textdelta, node));
+  command->arg = apr_pstrdup(command->pool, base_checksum);
+  SVN_ERR(queue_command(node->eb));
+
+  *handler = window_handler;
+  *handler_baton = node;
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+change_file_prop(void *file_baton,
+                 const char *name,
+                 const svn_string_t *value,
+                 apr_pool_t *pool)
+{
+  return svn_error_trace(change_prop(command_change_file_prop, file_baton,
+                                     name, value));
+}
+
+static svn_error_t *
+close_file(void *file_baton,
+           const char *text_checksum,
+           apr_pool_t *pool)
+{
+  node_baton_t *node = file_baton;
+  command_t *command;
+
+  SVN_ERR(begin_command(&command, node->eb, command_close_file, node));
+  command->arg = apr_pstrdup(command->pool, text_checksum);
+
+  return svn_error_trace(queue_command(node->eb));
+}
+
+static svn_error_t *
+absent_file(const char *path,
+            void *parent_baton,
+            apr_pool_t *pool)
+{
+  return svn_error_trace(absent_node(command_absent_file, path,
+                                     parent_baton));
+}
+
+static svn_error_t *
+close_edit(void *edit_baton,
+           apr_pool_t *pool)
+{
+  edit_baton_t *eb = edit_baton;
+  command_t *command;
+  svn_error_t *err;
+
+  err = begin_command(&command, eb, command_close_edit, NULL);
+  if (!err)
+    err = queue_command(eb);
+
+  /* Unless we failed to queue it, the consumer exits after processing
+     the close_edit call. */
+  join_consumer(eb, err != NULL);
+
+  /* Prefer the original error over our copy of it. */
+  if (eb->err)
+    {
+      svn_error_clear(err);
+      err = eb->err;
+      eb->err = NULL;
+    }
+
+  return svn_error_trace(err);
+}
+
+static svn_error_t *
+abort_edit(void *edit_baton,
+           apr_pool_t *pool)
+{
+  edit_baton_t *eb = edit_baton;
+
+  join_consumer(eb, TRUE);
+  svn_error_clear(eb->err);
+  eb->err = NULL;
+
+  /* The consumer thread is gone, so we may call the wrapped editor. */
+  return svn_error_trace(eb->wrapped_editor->abort_edit(
+                           eb->wrapped_edit_baton, pool));
+}
+
+/* Pre-cleanup function for the edit_baton_t given as DATA.  Stop the
+   consumer thread and release all memory it used. */
+static apr_status_t
+threaded_editor_cleanup(void *data)
+{
+  edit_baton_t *eb = data;
+  int i;
+
+  join_consumer(eb, TRUE);
+  svn_error_clear(eb->err);
+  eb->err = NULL;
+
+  for (i = 0; i < eb->queue_size; ++i)
+    if (eb->queue[i].pool)
+      svn_pool_destroy(eb->queue[i].pool);
+
+  svn_pool_destroy(eb->consumer_pool);
+
+  return APR_SUCCESS;
+}
+
+#endif /* APR_HAS_THREADS */
+
+svn_error_t *
+svn_delta__get_threaded_editor(const svn_delta_editor_t **editor,
+                               void **edit_baton,
+                               const svn_delta_editor_t *wrapped_editor,
+                               void *wrapped_edit_baton,
+                               int queue_size,
+                               apr_pool_t *pool)
+{
+#if APR_HAS_THREADS
+  svn_delta_editor_t *tree_editor;
+  edit_baton_t *eb;
+  apr_status_t status;
+
+  if (queue_size < 1)
+    {
+      *editor = wrapped_editor;
+      *edit_baton = wrapped_edit_baton;
+      return SVN_NO_ERROR;
+    }
+
+  eb = apr_pcalloc(pool, sizeof(*eb));
+  eb->wrapped_editor = wrapped_editor;
+  eb->wrapped_edit_baton = wrapped_edit_baton;
+  eb->pool = pool;
+  eb->queue_size = queue_size;
+  eb->queue = apr_pcalloc(pool, queue_size * sizeof(*eb->queue));
+
+  status = apr_thread_mutex_create(&eb->mutex, APR_THREAD_MUTEX_DEFAULT,
+                                   pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create mutex"));
+
+  status = apr_thread_cond_create(&eb->not_empty, pool);
+  if (!status)
+    status = apr_thread_cond_create(&eb->not_full, pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create condition variable"));
+
+  /* The consumer's pools must not share an allocator with the producer's
+     pools unless that is thread-safe. */
+  eb->consumer_pool = svn_pool_create(NULL);
+
+  status = apr_thread_create(&eb->thread, NULL, consumer_thread, eb, pool);
+  if (status)
+    {
+      /* Without a thread, we simply drive the wrapped editor directly. */
+      svn_pool_destroy(eb->consumer_pool);
+      *editor = wrapped_editor;
+      *edit_baton = wrapped_edit_baton;
+      return SVN_NO_ERROR;
+    }
+
+  /* The consumer thread must be gone before the mutex and the batons
+     get destroyed. */
+  apr_pool_pre_cleanup_register(pool, eb, threaded_editor_cleanup);
+
+  tree_editor = svn_delta_default_editor(pool);
+  tree_editor->set_target_revision = set_target_revision;
+  tree_editor->open_root = open_root;
+  tree_editor->delete_entry = delete_entry;
+  tree_editor->add_directory = add_directory;
+  tree_editor->open_directory = open_directory;
+  tree_editor->change_dir_prop = change_dir_prop;
+  tree_editor->close_directory = close_directory;
+  tree_editor->absent_directory = absent_directory;
+  tree_editor->add_file = add_file;
+  tree_editor->open_file = open_file;
+  tree_editor->apply_textdelta = apply_textdelta;
+  tree_editor->change_file_prop = change_file_prop;
+  tree_editor->close_file = close_file;
+  tree_editor->absent_file = absent_file;
+  tree_editor->close_edit = close_edit;
+  tree_editor->abort_edit = abort_edit;
+
+  *editor = tree_editor;
+  *edit_baton = eb;
+#else
+  *editor = wrapped_editor;
+  *edit_baton = wrapped_edit_baton;
+#endif
+
+  return SVN_NO_ERROR;
+}
@@ -29,6 +29,7 @@
 
 #include "svn_hash.h"
 #include "svn_delta.h"
+#include "private/svn_adler32.h"
 #include "private/svn_string_private.h"
 #include "delta.h"
 
@@ -44,6 +45,10 @@
  */
 #define MATCH_BLOCKSIZE 64
 
+/* Number of source block checksums that init_blocks_table() calculates
+   in one go.  */
+#define CHECKSUM_BATCH 256
+
 /* Size of the checksum presence FLAGS array in BLOCKS_T.  With standard
    MATCH_BLOCKSIZE and SVN_DELTA_WINDOW_SIZE, 32k entries is about 20x
    the number of checksums that actually occur, i.e. we expect a >95%
@@ -82,25 +87,10 @@ adler32_replace(apr_uint32_t adler32, const char c_out, const char c_in)
 static APR_INLINE apr_uint32_t
 init_adler32(const char *data)
 {
-  const unsigned char *input = (const unsigned char *)data;
-  const unsigned char *last = input + MATCH_BLOCKSIZE;
-
-  apr_uint32_t s1 = 0;
-  apr_uint32_t s2 = 0;
+  apr_uint32_t sum;
+  svn__adler32_blocks(&sum, data, MATCH_BLOCKSIZE, 1);
 
-  for (; input < last; input += 8)
-    {
-      s1 += input[0]; s2 += s1;
-      s1 += input[1]; s2 += s1;
-      s1 += input[2]; s2 += s1;
-      s1 += input[3]; s2 += s1;
-      s1 += input[4]; s2 += s1;
-      s1 += input[5]; s2 += s1;
-      s1 += input[6]; s2 += s1;
-      s1 += input[7]; s2 += s1;
-    }
-
-  return s2 * 0x10000 + s1;
+  return sum;
 }
 
 /* Information for a block of the delta source.  The length of the
@@ -217,6 +207,7 @@ init_blocks_table(const char *data,
   apr_size_t wnslots = 1;
   apr_uint32_t nslots;
   apr_uint32_t i;
+  apr_uint32_t sums[CHECKSUM_BATCH];
 
   /* Be pessimistic about the block count. */
   nblocks = datalen / MATCH_BLOCKSIZE + 1;
@@ -252,9 +243,21 @@ init_blocks_table(const char *data,
 
   /* If there is an odd block at the end of the buffer, we will
      not use that shorter block for deltification (only indirectly
-     as an extension of some previous block). */
-  for (i = 0; i + MATCH_BLOCKSIZE <= datalen; i += MATCH_BLOCKSIZE)
-    add_block(blocks, init_adler32(data + i), i);
+     as an extension of some previous block).  Checksum the blocks in
+     batches to make the best use of the SIMD code, if available. */
+  nblocks = datalen / MATCH_BLOCKSIZE;
+  for (i = 0; i < nblocks; )
+    {
+      apr_uint32_t k;
+      apr_uint32_t count = nblocks - i < CHECKSUM_BATCH
+                         ? (apr_uint32_t)(nblocks - i)
+                         : CHECKSUM_BATCH;
+
+      svn__adler32_blocks(sums, data + i * MATCH_BLOCKSIZE,
+                          MATCH_BLOCKSIZE, count);
+      for (k = 0; k < count; ++k, ++i)
+        add_block(blocks, sums[k], i * MATCH_BLOCKSIZE);
+    }
 }
 
 /* Try to find a match for the target data B in BLOCKS, and then
@@ -126,10 +126,11 @@ svn_diff__diff(svn_diff__lcs_t *lcs,
 
 
 svn_error_t *
-svn_diff_diff_2(svn_diff_t **diff,
-                void *diff_baton,
-                const svn_diff_fns2_t *vtable,
-                apr_pool_t *pool)
+svn_diff__diff_2(svn_diff_t **diff,
+                 void *diff_baton,
+                 const svn_diff_fns2_t *vtable,
+                 svn_diff_file_algorithm_t algorithm,
+                 apr_pool_t *pool)
 {
   svn_diff__tree_t *tree;
   svn_diff__position_t *position_list[2];
@@ -185,9 +186,15 @@ svn_diff_diff_2(svn_diff_t **diff,
                                                subpool);
 
   /* Get the lcs */
-  lcs = svn_diff__lcs(position_list[0], position_list[1], token_counts[0],
-                      token_counts[1], num_tokens, prefix_lines,
-                      suffix_lines, subpool);
+  if (algorithm == svn_diff_file_algorithm_histogram)
+    lcs = svn_diff__lcs_histogram(position_list[0], position_list[1],
+                                  token_counts[0], token_counts[1],
+                                  num_tokens, prefix_lines, suffix_lines,
+                                  subpool);
+  else
+    lcs = svn_diff__lcs(position_list[0], position_list[1], token_counts[0],
+                        token_counts[1], num_tokens, prefix_lines,
+                        suffix_lines, subpool);
 
   /* Produce the diff */
   *diff = svn_diff__diff(lcs, 1, 1, TRUE, pool);
@@ -197,3 +204,14 @@ svn_diff_diff_2(svn_diff_t **diff,
 
   return SVN_NO_ERROR;
 }
+
+svn_error_t *
+svn_diff_diff_2(svn_diff_t **diff,
+                void *diff_baton,
+                const svn_diff_fns2_t *vtable,
+                apr_pool_t *pool)
+{
+  return svn_error_trace(svn_diff__diff_2(diff, diff_baton, vtable,
+                                          svn_diff_file_algorithm_default,
+                                          pool));
+}
@@ -114,6 +114,22 @@ svn_diff__lcs(svn_diff__position_t *position_list1, /* pointer to tail (ring) */
               apr_off_t suffix_lines,
               apr_pool_t *pool);
 
+/*
+ * Like svn_diff__lcs() but use the histogram diff algorithm.  This is
+ * much faster for large sources with many changes or many repeated
+ * tokens, but the result is not necessarily the longest common
+ * subsequence.  TOKEN_COUNTS_LIST1 and TOKEN_COUNTS_LIST2 are not used.
+ */
+svn_diff__lcs_t *
+svn_diff__lcs_histogram(svn_diff__position_t *position_list1,
+                        svn_diff__position_t *position_list2,
+                        svn_diff__token_index_t *token_counts_list1,
+                        svn_diff__token_index_t *token_counts_list2,
+                        svn_diff__token_index_t num_tokens,
+                        apr_off_t prefix_lines,
+                        apr_off_t suffix_lines,
+                        apr_pool_t *pool);
+
 
 /*
  * Returns number of tokens in a tree
@@ -122,7 +138,8 @@ svn_diff__token_index_t
 svn_diff__get_node_count(svn_diff__tree_t *tree);
 
 /*
- * Support functions to build a tree of token positions
+ * Support functions to build the table of distinct tokens.  A single
+ * table is shared by all datasources of a diff, diff3 or diff4.
  */
 void
 svn_diff__tree_create(svn_diff__tree_t **tree, apr_pool_t *pool);
@@ -141,6 +158,16 @@ svn_diff__get_tokens(svn_diff__position_t **position_list,
                      apr_off_t prefix_lines,
                      apr_pool_t *pool);
 
+/*
+ * Return the hash of the LEN bytes at DATA for use by datasources.  To
+ * hash a token in parts, pass the hash of the preceding parts in HASH and
+ * 0 for the first part.
+ */
+apr_uint32_t
+svn_diff__token_hash(apr_uint32_t hash,
+                     const char *data,
+                     apr_size_t len);
+
 /*
  * Returns an array with the counts for the tokens in
  * the looped linked list given in loop_start.
@@ -151,6 +178,23 @@ svn_diff__get_token_counts(svn_diff__position_t *loop_start,
                            svn_diff__token_index_t num_tokens,
                            apr_pool_t *pool);
 
+/* Like svn_diff_diff_2() but use ALGORITHM to compare the sources. */
+svn_error_t *
+svn_diff__diff_2(svn_diff_t **diff,
+                 void *diff_baton,
+                 const svn_diff_fns2_t *vtable,
+                 svn_diff_file_algorithm_t algorithm,
+                 apr_pool_t *pool);
+
+/* Like svn_diff_diff3_2() but use ALGORITHM to compare the original
+ * source with the modified and the latest source. */
+svn_error_t *
+svn_diff__diff3_2(svn_diff_t **diff,
+                  void *diff_baton,
+                  const svn_diff_fns2_t *vtable,
+                  svn_diff_file_algorithm_t algorithm,
+                  apr_pool_t *pool);
+
 /* Morph a svn_lcs_t into a svn_diff_t. */
 svn_diff_t *
 svn_diff__diff(svn_diff__lcs_t *lcs,
@@ -30,6 +30,9 @@
 #include <apr_time.h>
 #include <apr_mmap.h>
 #include <apr_getopt.h>
+#include <apr_thread_pool.h>
+#include <apr_thread_mutex.h>
+#include <apr_thread_cond.h>
 
 #include <assert.h>
 
@@ -41,6 +44,7 @@
 #include "svn_io.h"
 #include "svn_utf.h"
 #include "svn_pools.h"
+#include "svn_sorts.h"
 #include "diff.h"
 #include "svn_private_config.h"
 #include "svn_path.h"
@@ -49,8 +53,8 @@
 #include "private/svn_utf_private.h"
 #include "private/svn_eol_private.h"
 #include "private/svn_dep_compat.h"
-#include "private/svn_adler32.h"
 #include "private/svn_diff_private.h"
+#include "private/svn_thread_pool.h"
 
 /* A token, i.e. a line read from a file. */
 typedef struct svn_diff__file_token_t
@@ -91,11 +95,24 @@ typedef struct svn_diff__file_baton_t
     /* Where the identical suffix starts in this datasource */
     int suffix_start_chunk;
     apr_off_t suffix_offset_in_chunk;
+
+    /* If not NULL, the lines between the identical prefix and suffix are
+       being split and hashed in the background.  CHUNK is -1 then. */
+    struct token_reader_t *reader;
   } files[4];
 
   /* List of free tokens that may be reused. */
   svn_diff__file_token_t *tokens;
 
+  /* Windowed 3-way diffs only:  The start offsets (apr_off_t) of the lines
+   * read from each datasource in the current window and the maximum number
+   * of lines per window.  NULL and 0 otherwise. */
+  apr_array_header_t *line_offsets[4];
+  apr_off_t window_lines;
+
+  /* Pool to allocate the tokens from.  Either POOL or a sub-pool of it. */
+  apr_pool_t *token_pool;
+
   apr_pool_t *pool;
 } svn_diff__file_baton_t;
 
@@ -752,6 +769,481 @@ find_identical_suffix(apr_off_t *suffix_lines, struct file_info file[],
 }
 
 
+/* Return a new token for BATON, reusing a discarded one if possible. */
+static svn_diff__file_token_t *
+alloc_token(svn_diff__file_baton_t *file_baton)
+{
+  svn_diff__file_token_t *file_token = file_baton->tokens;
+
+  if (file_token)
+    file_baton->tokens = file_token->next;
+  else
+    file_token = apr_palloc(file_baton->token_pool, sizeof(*file_token));
+
+  return file_token;
+}
+
+#if APR_HAS_THREADS
+
+/* Number of bytes that get tokenized by one worker at a time.  Lines that
+   are longer than this get a larger buffer.  If you change this number,
+   update test_parallel_tokens() in diff-diff3-test.c. */
+#define SLOT_SIZE (4 * CHUNK_SIZE)
+
+/* A line found by a tokenizer worker.  Offsets are relative to the start
+   of the slot's buffer. */
+typedef struct line_info_t
+{
+  /* Start of the line and of its normalized contents.  The latter is the
+     equivalent of svn_diff__file_token_t.norm_offset. */
+  apr_size_t offset;
+  apr_size_t norm_offset;
+
+  /* Total length before and after normalization. */
+  apr_size_t raw_length;
+  apr_size_t length;
+
+  /* Hash value of the normalized line. */
+  apr_uint32_t hash;
+} line_info_t;
+
+/* A slice of a file that gets tokenized by a worker thread. */
+typedef struct token_slot_t
+{
+  /* LEN bytes of complete lines, read from file offset OFFSET.  BUF can
+     hold BUF_SIZE bytes.  The worker normalizes the lines in place. */
+  char *buf;
+  apr_size_t buf_size;
+  apr_size_t len;
+  apr_off_t offset;
+
+  /* The LINE_COUNT lines in BUF, with room for LINES_SIZE elements.
+     Valid once DONE has been set. */
+  line_info_t *lines;
+  int line_count;
+  int lines_size;
+
+  /* Index of the next element in LINES to return as a token. */
+  int next_line;
+
+  /* Thread-safe pool, private to this slot.  Holds LINES. */
+  apr_pool_t *pool;
+
+  /* Set while a worker may access this slot or its lines have not been
+     consumed, yet. */
+  svn_boolean_t busy;
+
+  /* Set by the worker when LINES is valid.  Protected by the MUTEX
+     in READER. */
+  svn_boolean_t done;
+
+  /* Set once the consumer has seen DONE.  Needs no locking. */
+  svn_boolean_t ready;
+
+  /* The reader that this slot belongs to. */
+  struct token_reader_t *reader;
+} token_slot_t;
+
+/* Ring buffer of file slices that get tokenized concurrently and are
+   consumed in order. */
+typedef struct token_reader_t
+{
+  /* SLOT_COUNT slots, the oldest busy one at index FIRST, followed by
+     USED-1 more busy slots. */
+  token_slot_t *slots;
+  int slot_count;
+  int first;
+  int used;
+
+  /* The section of FILE that still needs to be read into the slots. */
+  apr_file_t *file;
+  apr_off_t read_offset;
+  apr_off_t end_offset;
+
+  /* How to normalize the lines. */
+  const svn_diff_file_options_t *options;
+
+  /* Protects the DONE flags and notifies the consumer of tokenized
+     slots. */
+  apr_thread_mutex_t *mutex;
+  apr_thread_cond_t *cond;
+
+  /* Worker threads to tokenize the slots. */
+  apr_thread_pool_t *threads;
+
+  /* Allocate slot buffers from here. */
+  apr_pool_t *pool;
+} token_reader_t;
+
+/* Implements apr_thread_start_t.  Split the token_slot_t given as DATA
+   into lines, normalize and hash them, and notify the consumer. */
+static void * APR_THREAD_FUNC
+tokenize_slot_task(apr_thread_t *thread,
+                   void *data)
+{
+  token_slot_t *slot = data;
+  token_reader_t *reader = slot->reader;
+  char *curp = slot->buf;
+  char *endp = slot->buf + slot->len;
+
+  slot->line_count = 0;
+  slot->lines_size = (int)(slot->len / 32) + 16;
+  slot->lines = apr_palloc(slot->pool,
+                           slot->lines_size * sizeof(*slot->lines));
+
+  while (curp < endp)
+    {
+      svn_diff__normalize_state_t state = svn_diff__normalize_state_normal;
+      char *eol = svn_eol__find_eol_start(curp, endp - curp);
+      char *c = curp;
+      apr_off_t length;
+      line_info_t *line;
+
+      if (eol)
+        {
+          /* Also skip past the '\n' in an '\r\n' sequence. */
+          if (*eol++ == '\r' && eol < endp && *eol == '\n')
+            eol++;
+        }
+      else
+        {
+          eol = endp;
+        }
+
+      if (slot->line_count == slot->lines_size)
+        {
+          line_info_t *lines = apr_palloc(slot->pool,
+                                          2 * slot->lines_size
+                                            * sizeof(*lines));
+          memcpy(lines, slot->lines, slot->line_count * sizeof(*lines));
+          slot->lines = lines;
+          slot->lines_size *= 2;
+        }
+
+      length = eol - curp;
+      svn_diff__normalize_buffer(&c, &length, &state, curp,
+                                 reader->options);
+
+      line = &slot->lines[slot->line_count++];
+      line->offset = curp - slot->buf;
+      line->norm_offset = c - slot->buf;
+      line->raw_length = eol - curp;
+      line->length = (apr_size_t)length;
+      line->hash = svn_diff__token_hash(0, c, (apr_size_t)length);
+
+      curp = eol;
+    }
+
+  apr_thread_mutex_lock(reader->mutex);
+  slot->done = TRUE;
+  apr_thread_cond_broadcast(reader->cond);
+  apr_thread_mutex_unlock(reader->mutex);
+
+  return NULL;
+}
+
+/* Block until the worker for SLOT in READER has finished. */
+static svn_error_t *
+wait_for_slot(token_reader_t *reader,
+              token_slot_t *slot)
+{
+  apr_status_t status = apr_thread_mutex_lock(reader->mutex);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't lock mutex"));
+
+  /* This loop implicitly handles spurious wake-ups. */
+  while (!status && !slot->done)
+    status = apr_thread_cond_wait(reader->cond, reader->mutex);
+
+  apr_thread_mutex_unlock(reader->mutex);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't wait on condition variable"));
+
+  return SVN_NO_ERROR;
+}
+
+/* Return the number of bytes at the start of BUF, which holds LEN bytes,
+   up to and including the last complete EOL sequence.  A CR in the last
+   byte does not count as it might be followed by a LF.  Return 0 if there
+   is no such EOL. */
+static apr_size_t
+complete_lines_length(const char *buf,
+                      apr_size_t len)
+{
+  apr_size_t i;
+
+  for (i = len - 1; i > 0; --i)
+    if (buf[i - 1] == '\n' || (buf[i - 1] == '\r' && buf[i] != '\n'))
+      return i;
+
+  return 0;
+}
+
+/* Read the next complete lines of READER's file into the slot following
+   the busy ones and hand it to a worker.  READER must have at least one
+   slot that is not busy.  Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+fill_slot(token_reader_t *reader,
+          apr_pool_t *scratch_pool)
+{
+  token_slot_t *slot
+    = &reader->slots[(reader->first + reader->used) % reader->slot_count];
+  apr_off_t offset = reader->read_offset;
+  apr_size_t len;
+  apr_status_t status;
+
+  if (slot->buf == NULL)
+    {
+      slot->buf_size = SLOT_SIZE;
+      slot->buf = apr_palloc(reader->pool, slot->buf_size);
+      slot->pool = svn_pool_create(NULL);
+    }
+
+  while (TRUE)
+    {
+      len = (apr_size_t)MIN(slot->buf_size, reader->end_offset - offset);
+      SVN_ERR(read_chunk(reader->file, slot->buf, len, offset,
+                         scratch_pool));
+      if (offset + len == reader->end_offset)
+        break;
+
+      len = complete_lines_length(slot->buf, len);
+      if (len > 0)
+        break;
+
+      /* The line does not fit into BUF. */
+      slot->buf_size *= 2;
+      slot->buf = apr_palloc(reader->pool, slot->buf_size);
+    }
+
+  slot->offset = offset;
+  slot->len = len;
+  slot->next_line = 0;
+  slot->busy = TRUE;
+  slot->done = FALSE;
+  slot->ready = FALSE;
+
+  reader->read_offset = offset + len;
+  ++reader->used;
+
+  /* If we can't get a worker thread, do the work ourselves. */
+  status = apr_thread_pool_push(reader->threads, tokenize_slot_task, slot,
+                                APR_THREAD_TASK_PRIORITY_NORMAL, reader);
+  if (status)
+    tokenize_slot_task(NULL, slot);
+
+  return SVN_NO_ERROR;
+}
+
+/* Release the oldest busy slot in READER after its lines have been
+   consumed. */
+static void
+release_oldest(token_reader_t *reader)
+{
+  token_slot_t *slot = &reader->slots[reader->first];
+
+  slot->busy = FALSE;
+  slot->done = FALSE;
+  svn_pool_clear(slot->pool);
+
+  reader->first = (reader->first + 1) % reader->slot_count;
+  --reader->used;
+}
+
+/* Pre-cleanup function for the token_reader_t given as DATA.
+   Wait for all workers that still access its slots and release them. */
+static apr_status_t
+token_reader_cleanup(void *data)
+{
+  token_reader_t *reader = data;
+  int i;
+
+  for (i = 0; i < reader->slot_count; ++i)
+    {
+      token_slot_t *slot = &reader->slots[i];
+
+      if (slot->busy)
+        svn_error_clear(wait_for_slot(reader, slot));
+
+      if (slot->pool)
+        svn_pool_destroy(slot->pool);
+    }
+
+  return APR_SUCCESS;
+}
+
+/* If the section of FILE between the identical prefix and suffix is large
+   enough, start tokenizing it with up to MAX_THREADS worker threads and
+   set FILE->READER.  Normalize the lines according to OPTIONS.  Allocate
+   the reader in POOL. */
+static svn_error_t *
+start_token_reader(struct file_info *file,
+                   const svn_diff_file_options_t *options,
+                   int max_threads,
+                   apr_pool_t *pool)
+{
+  token_reader_t *reader;
+  apr_off_t start = chunk_to_offset(file->chunk)
+                    + (file->curp - file->buffer);
+  apr_off_t end = file->size;
+  apr_status_t status;
+  int i;
+
+  if (file->suffix_start_chunk >= 0)
+    end = chunk_to_offset(file->suffix_start_chunk)
+          + file->suffix_offset_in_chunk;
+
+  /* Not worth the overhead for small files. */
+  if (end - start < 2 * SLOT_SIZE)
+    return SVN_NO_ERROR;
+
+  reader = apr_pcalloc(pool, sizeof(*reader));
+  SVN_ERR(svn_thread_pool__get(&reader->threads, pool));
+
+  /* Twice as many slots as workers such that the workers are kept busy
+     while we consume the oldest slot. */
+  reader->slot_count = 2 * max_threads;
+  reader->slots = apr_pcalloc(pool,
+                              reader->slot_count * sizeof(*reader->slots));
+  for (i = 0; i < reader->slot_count; ++i)
+    reader->slots[i].reader = reader;
+
+  reader->file = file->file;
+  reader->read_offset = start;
+  reader->end_offset = end;
+  reader->options = options;
+  reader->pool = pool;
+
+  status = apr_thread_mutex_create(&reader->mutex, APR_THREAD_MUTEX_DEFAULT,
+                                   pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create mutex"));
+
+  status = apr_thread_cond_create(&reader->cond, pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create condition variable"));
+
+  /* The workers must be done before the mutex and the slots get
+     destroyed. */
+  apr_pool_pre_cleanup_register(pool, reader, token_reader_cleanup);
+
+  while (reader->used < reader->slot_count
+         && reader->read_offset < reader->end_offset)
+    SVN_ERR(fill_slot(reader, pool));
+
+  /* The current chunk does not contain normalized tokens. */
+  file->chunk = -1;
+  file->reader = reader;
+
+  return SVN_NO_ERROR;
+}
+
+/* Like datasource_get_next_token() but for a FILE with a token reader,
+   as set by start_token_reader(). */
+static svn_error_t *
+reader_get_next_token(apr_uint32_t *hash,
+                      void **token,
+                      svn_diff__file_baton_t *file_baton,
+                      struct file_info *file,
+                      svn_diff_datasource_e datasource)
+{
+  token_reader_t *reader = file->reader;
+  svn_diff__file_token_t *file_token;
+  token_slot_t *slot;
+  line_info_t *line;
+
+  while (TRUE)
+    {
+      /* All lines have been returned? */
+      if (reader->used == 0)
+        return SVN_NO_ERROR;
+
+      slot = &reader->slots[reader->first];
+      if (!slot->ready)
+        {
+          SVN_ERR(wait_for_slot(reader, slot));
+          slot->ready = TRUE;
+        }
+
+      if (slot->next_line < slot->line_count)
+        break;
+
+      /* Reuse the consumed slot for the next lines. */
+      release_oldest(reader);
+      if (reader->read_offset < reader->end_offset)
+        SVN_ERR(fill_slot(reader, file_baton->pool));
+    }
+
+  line = &slot->lines[slot->next_line++];
+
+  file_token = alloc_token(file_baton);
+  file_token->datasource = datasource;
+  file_token->offset = slot->offset + line->offset;
+  file_token->norm_offset = slot->offset + line->norm_offset;
+  file_token->raw_length = line->raw_length;
+  file_token->length = line->length;
+
+  *hash = line->hash;
+  *token = file_token;
+
+  return SVN_NO_ERROR;
+}
+
+#endif /* APR_HAS_THREADS */
+
+/* If TOKEN, read from FILE, is in the slot currently being consumed by
+   FILE's token reader, set *DATA to its normalized contents and return
+   TRUE.  Return FALSE otherwise. */
+static APR_INLINE svn_boolean_t
+get_reader_token_data(char **data,
+                      struct file_info *file,
+                      svn_diff__file_token_t *token)
+{
+#if APR_HAS_THREADS
+  token_reader_t *reader = file->reader;
+
+  if (reader && reader->used > 0)
+    {
+      token_slot_t *slot = &reader->slots[reader->first];
+      if (slot->ready
+          && token->offset >= slot->offset
+          && token->offset < slot->offset + (apr_off_t)slot->len)
+        {
+          *data = slot->buf + (token->norm_offset - slot->offset);
+          return TRUE;
+        }
+    }
+#endif
+
+  return FALSE;
+}
+
+/* For the DATASOURCES_LEN files in BATON that are indexed by the elements
+   of DATASOURCES, start token readers if BATON's options ask for it.
+   Allocate them in BATON's pool. */
+static svn_error_t *
+start_token_readers(svn_diff__file_baton_t *file_baton,
+                    const svn_diff_datasource_e *datasources,
+                    apr_size_t datasources_len)
+{
+#if APR_HAS_THREADS
+  apr_size_t i;
+
+  /* Windowed diffs re-read the files from varying positions. */
+  if (file_baton->options->max_threads < 2 || file_baton->window_lines)
+    return SVN_NO_ERROR;
+
+  for (i = 0; i < datasources_len; i++)
+    SVN_ERR(start_token_reader(
+              &file_baton->files[datasource_to_index(datasources[i])],
+              file_baton->options, file_baton->options->max_threads,
+              file_baton->pool));
+#endif
+
+  return SVN_NO_ERROR;
+}
+
+
 /* Let FILE stand for the array of file_info struct elements of BATON->files
  * that are indexed by the elements of the DATASOURCE array.
  * BATON's type is (svn_diff__file_baton_t *).
@@ -816,7 +1308,8 @@ datasources_open(void *baton,
   for (i = 0; i < datasources_len; i++)
     if (length[i] == 0)
       /* There will not be any identical prefix/suffix, so we're done. */
-      return SVN_NO_ERROR;
+      return svn_error_trace(start_token_readers(file_baton, datasources,
+                                                 datasources_len));
 
 #ifndef SVN_DISABLE_PREFIX_SUFFIX_SCANNING
 
@@ -835,7 +1328,8 @@ datasources_open(void *baton,
   for (i = 0; i < datasources_len; i++)
     file_baton->files[datasource_to_index(datasources[i])] = files[i];
 
-  return SVN_NO_ERROR;
+  return svn_error_trace(start_token_readers(file_baton, datasources,
+                                             datasources_len));
 }
 
 
@@ -857,7 +1351,9 @@ datasource_get_next_token(apr_uint32_t *hash, void **token, void *baton,
 {
   svn_diff__file_baton_t *file_baton = baton;
   svn_diff__file_token_t *file_token;
-  struct file_info *file = &file_baton->files[datasource_to_index(datasource)];
+  int idx = datasource_to_index(datasource);
+  struct file_info *file = &file_baton->files[idx];
+  apr_array_header_t *line_offsets = file_baton->line_offsets[idx];
   char *endp;
   char *curp;
   char *eol;
@@ -869,6 +1365,12 @@ datasource_get_next_token(apr_uint32_t *hash, void **token, void *baton,
 
   *token = NULL;
 
+#if APR_HAS_THREADS
+  if (file->reader)
+    return svn_error_trace(reader_get_next_token(hash, token, file_baton,
+                                                 file, datasource));
+#endif
+
   curp = file->curp;
   endp = file->endp;
 
@@ -894,16 +1396,12 @@ datasource_get_next_token(apr_uint32_t *hash, void **token, void *baton,
       && (curp - file->buffer) == file->suffix_offset_in_chunk)
     return SVN_NO_ERROR;
 
+  /* Stop at the end of the current window, if any. */
+  if (line_offsets && line_offsets->nelts == file_baton->window_lines)
+    return SVN_NO_ERROR;
+
   /* Allocate a new token, or fetch one from the "reusable tokens" list. */
-  file_token = file_baton->tokens;
-  if (file_token)
-    {
-      file_baton->tokens = file_token->next;
-    }
-  else
-    {
-      file_token = apr_palloc(file_baton->pool, sizeof(*file_token));
-    }
+  file_token = alloc_token(file_baton);
 
   file_token->datasource = datasource;
   file_token->offset = chunk_to_offset(file->chunk)
@@ -950,7 +1448,7 @@ datasource_get_next_token(apr_uint32_t *hash, void **token, void *baton,
             file_token->norm_offset += (c - curp);
           }
         file_token->length += length;
-        h = svn__adler32(h, c, length);
+        h = svn_diff__token_hash(h, c, length);
       }
 
       curp = endp = file->buffer;
@@ -1007,8 +1505,11 @@ datasource_get_next_token(apr_uint32_t *hash, void **token, void *baton,
 
       file_token->length += length;
 
-      *hash = svn__adler32(h, c, length);
+      *hash = svn_diff__token_hash(h, c, length);
       *token = file_token;
+
+      if (line_offsets)
+        APR_ARRAY_PUSH(line_offsets, apr_off_t) = file_token->offset;
     }
 
   return SVN_NO_ERROR;
@@ -1062,7 +1563,13 @@ token_compare(void *baton, void *token1, void *token2, int *compare)
       offset[i] = file_token[i]->norm_offset;
       state[i] = svn_diff__normalize_state_normal;
 
-      if (offset_to_chunk(offset[i]) == file[i]->chunk)
+      if (get_reader_token_data(&bufp[i], file[i], file_token[i]))
+        {
+          /* The token has already been normalized in memory. */
+          length[i] = total_length;
+          raw_length[i] = 0;
+        }
+      else if (offset_to_chunk(offset[i]) == file[i]->chunk)
         {
           /* If the start of the token is in memory, the entire token is
            * in memory.
@@ -1179,9 +1686,341 @@ static const svn_diff_fns2_t svn_diff__file_vtable =
   token_discard_all
 };
 
+
+/* Implements svn_diff_fns2_t::datasources_open for windowed 3-way diffs.
+ * The datasources are already open and positioned at the start of the
+ * window, which has no identical prefix or suffix. */
+static svn_error_t *
+window_datasources_open(void *baton,
+                        apr_off_t *prefix_lines,
+                        apr_off_t *suffix_lines,
+                        const svn_diff_datasource_e *datasources,
+                        apr_size_t datasources_len)
+{
+  *prefix_lines = 0;
+  *suffix_lines = 0;
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_diff_fns2_t::token_discard_all for windowed 3-way diffs */
+static void
+window_token_discard_all(void *baton)
+{
+  svn_diff__file_baton_t *file_baton = baton;
+
+  /* Keep the files open for the next window. */
+  file_baton->tokens = NULL;
+  svn_pool_clear(file_baton->token_pool);
+}
+
+static const svn_diff_fns2_t svn_diff__file_window_vtable =
+{
+  window_datasources_open,
+  datasource_close,
+  datasource_get_next_token,
+  token_compare,
+  token_discard,
+  window_token_discard_all
+};
+
+/* Position FILE at the start of line LINE of the current window, given
+ * the LINE_OFFSETS of the lines read in that window.  Use POOL for
+ * temporary allocations. */
+static svn_error_t *
+seek_to_line(struct file_info *file,
+             const apr_array_header_t *line_offsets,
+             apr_off_t line,
+             apr_pool_t *pool)
+{
+  apr_off_t offset;
+  int chunk;
+
+  /* Right after the last line read is where we are anyway. */
+  if (line == line_offsets->nelts)
+    return SVN_NO_ERROR;
+
+  offset = APR_ARRAY_IDX(line_offsets, line, apr_off_t);
+  chunk = (int) offset_to_chunk(offset);
+  if (chunk != file->chunk)
+    {
+      apr_off_t length = chunk == offset_to_chunk(file->size)
+                       ? offset_in_chunk(file->size)
+                       : CHUNK_SIZE;
+
+      SVN_ERR(read_chunk(file->file, file->buffer, length,
+                         chunk_to_offset(chunk), pool));
+      file->chunk = chunk;
+      file->endp = file->buffer + length;
+    }
+
+  file->curp = file->buffer + offset_in_chunk(offset);
+  file->normalize_state = svn_diff__normalize_state_normal;
+
+  return SVN_NO_ERROR;
+}
+
+/* Return a copy of HUNK and of its resolved diff allocated in POOL, with
+ * all line numbers moved by the respective BASE. */
+static svn_diff_t *
+copy_window_hunk(const svn_diff_t *hunk,
+                 const apr_off_t base[3],
+                 apr_pool_t *pool)
+{
+  svn_diff_t *copy = apr_pmemdup(pool, hunk, sizeof(*hunk));
+  svn_diff_t **resolved_ref = &copy->resolved_diff;
+  const svn_diff_t *resolved;
+
+  copy->next = NULL;
+  copy->original_start += base[0];
+  copy->modified_start += base[1];
+  copy->latest_start += base[2];
+
+  for (resolved = hunk->resolved_diff; resolved; resolved = resolved->next)
+    {
+      *resolved_ref = copy_window_hunk(resolved, base, pool);
+      resolved_ref = &(*resolved_ref)->next;
+    }
+
+  return copy;
+}
+
+/* Append HUNK to the list of hunks starting at *HEAD and ending at *TAIL.
+ * Merge adjacent common hunks. */
+static void
+append_window_hunk(svn_diff_t **head,
+                   svn_diff_t **tail,
+                   svn_diff_t *hunk)
+{
+  if (*tail
+      && (*tail)->type == svn_diff__type_common
+      && hunk->type == svn_diff__type_common)
+    {
+      (*tail)->original_length += hunk->original_length;
+      (*tail)->modified_length += hunk->modified_length;
+      (*tail)->latest_length += hunk->latest_length;
+      return;
+    }
+
+  if (*tail)
+    (*tail)->next = hunk;
+  else
+    *head = hunk;
+
+  *tail = hunk;
+}
+
+/* Append a common hunk of LENGTH lines starting at START[i] in each of the
+ * three files to the list given by *HEAD and *TAIL.  Allocate it in POOL.
+ */
+static void
+append_common_hunk(svn_diff_t **head,
+                   svn_diff_t **tail,
+                   const apr_off_t start[3],
+                   apr_off_t length,
+                   apr_pool_t *pool)
+{
+  svn_diff_t *hunk;
+
+  if (length == 0)
+    return;
+
+  hunk = apr_pcalloc(pool, sizeof(*hunk));
+  hunk->type = svn_diff__type_common;
+  hunk->original_start = start[0];
+  hunk->original_length = length;
+  hunk->modified_start = start[1];
+  hunk->modified_length = length;
+  hunk->latest_start = start[2];
+  hunk->latest_length = length;
+
+  append_window_hunk(head, tail, hunk);
+}
+
+/* Find the common hunk in WINDOW_DIFF at which to end the current window,
+ * with COUNTS[i] lines read from each of the files.  Files with less than
+ * WINDOW_LINES lines read have been read completely.
+ *
+ * The alignment close to the end of the window is likely to change once
+ * we read further, so prefer cutting before the last quarter of all
+ * windows that end before EOF.  Cut in the middle of a common hunk such
+ * that the next window starts with some common context.
+ *
+ * Set *CUT_HUNK to the hunk to cut and *CUT_LENGTH to the number of its
+ * lines before the cut.  Set *CUT_HUNK to NULL if there is no suitable
+ * common hunk. */
+static void
+find_window_cut(const svn_diff_t **cut_hunk,
+                apr_off_t *cut_length,
+                const svn_diff_t *window_diff,
+                const apr_off_t counts[3],
+                apr_off_t window_lines)
+{
+  apr_off_t margin;
+
+  *cut_hunk = NULL;
+  *cut_length = 0;
+
+  for (margin = MAX(window_lines / 4, 1); margin > 0; margin /= 2)
+    {
+      const svn_diff_t *hunk;
+
+      for (hunk = window_diff; hunk; hunk = hunk->next)
+        {
+          apr_off_t start[3];
+          apr_off_t length;
+          int i;
+
+          if (hunk->type != svn_diff__type_common)
+            continue;
+
+          start[0] = hunk->original_start;
+          start[1] = hunk->modified_start;
+          start[2] = hunk->latest_start;
+
+          length = hunk->original_length / 2;
+          for (i = 0; i < 3; i++)
+            if (counts[i] == window_lines)
+              length = MIN(length, counts[i] - margin - start[i]);
+
+          /* Not before the margin or no progress at all? */
+          if (length < 0 || start[0] + start[1] + start[2] + length == 0)
+            continue;
+
+          *cut_hunk = hunk;
+          *cut_length = length;
+        }
+
+      if (*cut_hunk || margin == 1)
+        break;
+    }
+}
+
+/* Implement svn_diff_file_diff3_2() for BATON, reading and diffing the
+ * files in windows of at most OPTIONS->DIFF3_WINDOW_LINES lines.  Only
+ * windows without any lines common to all three files will grow beyond
+ * that limit, until a common line or EOF is found.
+ *
+ * Allocate the result in POOL. */
+static svn_error_t *
+diff3_windowed(svn_diff_t **diff,
+               svn_diff__file_baton_t *baton,
+               apr_pool_t *pool)
+{
+  svn_diff_datasource_e datasources[] = {svn_diff_datasource_original,
+                                         svn_diff_datasource_modified,
+                                         svn_diff_datasource_latest};
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_diff_t *tail = NULL;
+  apr_off_t prefix_lines;
+  apr_off_t suffix_lines;
+  apr_off_t base[3];
+  int i;
+
+  *diff = NULL;
+  baton->window_lines = baton->options->diff3_window_lines;
+  SVN_ERR(datasources_open(baton, &prefix_lines, &suffix_lines,
+                           datasources, 3));
+
+  baton->token_pool = svn_pool_create(baton->pool);
+
+  base[0] = base[1] = base[2] = 0;
+  append_common_hunk(diff, &tail, base, prefix_lines, pool);
+  base[0] = base[1] = base[2] = prefix_lines;
+
+  while (1)
+    {
+      svn_diff_t *window_diff;
+      const svn_diff_t *hunk;
+      const svn_diff_t *cut_hunk = NULL;
+      apr_off_t cut_length = 0;
+      apr_off_t counts[3];
+      svn_boolean_t at_eof = TRUE;
+
+      svn_pool_clear(iterpool);
+      for (i = 0; i < 3; i++)
+        baton->line_offsets[i] = apr_array_make(iterpool, 1024,
+                                                sizeof(apr_off_t));
+
+      SVN_ERR(svn_diff__diff3_2(&window_diff, baton,
+                                &svn_diff__file_window_vtable,
+                                baton->options->algorithm, iterpool));
+
+      for (i = 0; i < 3; i++)
+        {
+          counts[i] = baton->line_offsets[i]->nelts;
+          if (counts[i] == baton->window_lines)
+            at_eof = FALSE;
+        }
+
+      if (!at_eof)
+        {
+          find_window_cut(&cut_hunk, &cut_length, window_diff, counts,
+                          baton->window_lines);
+
+          /* Only conflicting changes?  Retry with a larger window. */
+          if (cut_hunk == NULL)
+            {
+              for (i = 0; i < 3; i++)
+                SVN_ERR(seek_to_line(&baton->files[i],
+                                     baton->line_offsets[i], 0, iterpool));
+
+              baton->window_lines *= 2;
+              continue;
+            }
+        }
+
+      for (hunk = window_diff; hunk != cut_hunk; hunk = hunk->next)
+        append_window_hunk(diff, &tail, copy_window_hunk(hunk, base, pool));
+
+      if (at_eof)
+        {
+          for (i = 0; i < 3; i++)
+            base[i] += counts[i];
+
+          break;
+        }
+
+      /* Continue at the cut. */
+      counts[0] = cut_hunk->original_start + cut_length;
+      counts[1] = cut_hunk->modified_start + cut_length;
+      counts[2] = cut_hunk->latest_start + cut_length;
+
+      {
+        apr_off_t start[3];
+
+        start[0] = base[0] + cut_hunk->original_start;
+        start[1] = base[1] + cut_hunk->modified_start;
+        start[2] = base[2] + cut_hunk->latest_start;
+        append_common_hunk(diff, &tail, start, cut_length, pool);
+      }
+
+      for (i = 0; i < 3; i++)
+        {
+          SVN_ERR(seek_to_line(&baton->files[i], baton->line_offsets[i],
+                               counts[i], iterpool));
+          base[i] += counts[i];
+        }
+
+      baton->window_lines = baton->options->diff3_window_lines;
+    }
+
+  append_common_hunk(diff, &tail, base, suffix_lines, pool);
+
+  for (i = 0; i < 3; i++)
+    baton->line_offsets[i] = NULL;
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
 /* Id for the --ignore-eol-style option, which doesn't have a short name. */
 #define SVN_DIFF__OPT_IGNORE_EOL_STYLE 256
 
+/* Id for the --histogram option. */
+#define SVN_DIFF__OPT_HISTOGRAM 257
+
 /* Options supported by svn_diff_file_options_parse(). */
 static const apr_getopt_option_t diff_options[] =
 {
@@ -1193,6 +2032,7 @@ static const apr_getopt_option_t diff_options[] =
    * ### we don't have optional argument support. */
   { "unified", 'u', 0, NULL },
   { "context", 'U', 1, NULL },
+  { "histogram", SVN_DIFF__OPT_HISTOGRAM, 0, NULL },
   { NULL, 0, 0, NULL }
 };
 
@@ -1298,6 +2138,9 @@ svn_diff_file_options_parse(svn_diff_file_options_t *options,
         case 'U':
           SVN_ERR(svn_cstring_atoi(&options->context_size, opt_arg));
           break;
+        case SVN_DIFF__OPT_HISTOGRAM:
+          options->algorithm = svn_diff_file_algorithm_histogram;
+          break;
         default:
           break;
         }
@@ -1325,8 +2168,10 @@ svn_diff_file_diff_2(svn_diff_t **diff,
   baton.files[0].path = original;
   baton.files[1].path = modified;
   baton.pool = svn_pool_create(pool);
+  baton.token_pool = baton.pool;
 
-  SVN_ERR(svn_diff_diff_2(diff, &baton, &svn_diff__file_vtable, pool));
+  SVN_ERR(svn_diff__diff_2(diff, &baton, &svn_diff__file_vtable,
+                           options->algorithm, pool));
 
   svn_pool_destroy(baton.pool);
   return SVN_NO_ERROR;
@@ -1347,8 +2192,13 @@ svn_diff_file_diff3_2(svn_diff_t **diff,
   baton.files[1].path = modified;
   baton.files[2].path = latest;
   baton.pool = svn_pool_create(pool);
+  baton.token_pool = baton.pool;
 
-  SVN_ERR(svn_diff_diff3_2(diff, &baton, &svn_diff__file_vtable, pool));
+  if (options->diff3_window_lines > 0)
+    SVN_ERR(diff3_windowed(diff, &baton, pool));
+  else
+    SVN_ERR(svn_diff__diff3_2(diff, &baton, &svn_diff__file_vtable,
+                              options->algorithm, pool));
 
   svn_pool_destroy(baton.pool);
   return SVN_NO_ERROR;
@@ -1371,6 +2221,7 @@ svn_diff_file_diff4_2(svn_diff_t **diff,
   baton.files[2].path = latest;
   baton.files[3].path = ancestor;
   baton.pool = svn_pool_create(pool);
+  baton.token_pool = baton.pool;
 
   SVN_ERR(svn_diff_diff4_2(diff, &baton, &svn_diff__file_vtable, pool));
 
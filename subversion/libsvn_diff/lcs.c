@@ -25,6 +25,10 @@
 #include <apr.h>
 #include <apr_pools.h>
 #include <apr_general.h>
+#include <apr_tables.h>
+
+#include "svn_pools.h"
+#include "svn_sorts.h"
 
 #include "diff.h"
 
@@ -373,3 +377,373 @@ svn_diff__lcs(svn_diff__position_t *position_list1, /* pointer to tail (ring) */
   else
     return lcs;
 }
+
+
+/*
+ * The histogram diff algorithm, as known from JGit and Git, is a variant
+ * of patience diff:  Within a region of both sources, find the longest
+ * run of matching tokens that contains the token that is the least
+ * frequent one in the first source's part of the region.  That run becomes
+ * part of the result and we continue with the regions before and after it.
+ *
+ * Tokens that occur more than HISTOGRAM_MAX_OCCURRENCES times, like empty
+ * lines or closing braces, are never used to anchor a run.  If a region
+ * has common tokens but all of them are that frequent, we use the O(NP)
+ * algorithm for it.
+ *
+ * Every step takes time linear in the size of its region and the regions
+ * quickly become small for typical input, even if there are many changes.
+ */
+
+/* Tokens that occur more often than this in a region are not used as
+ * anchors.  Same limit as in Git. */
+#define HISTOGRAM_MAX_OCCURRENCES 64
+
+/* A pending part of the histogram diff, covering the tokens at indexes
+ * START[i] up to but not including END[i] in both sources.  If IS_MATCH
+ * is set, these tokens match and just have to be added to the result. */
+typedef struct histogram_region_t
+{
+  apr_off_t start[2];
+  apr_off_t end[2];
+  svn_boolean_t is_match;
+} histogram_region_t;
+
+/* State of a histogram diff. */
+typedef struct histogram_t
+{
+  /* The positions of all tokens to compare, in order, and their number. */
+  svn_diff__position_t **position[2];
+  apr_off_t length[2];
+
+  /* For each token, the number of its occurrences in the first source's
+   * part of the current region and the index of the first one. */
+  apr_off_t *count;
+  apr_off_t *first;
+
+  /* For each index in the first source, the index of the next occurrence
+   * of the same token within the current region or -1. */
+  apr_off_t *next;
+
+  /* Token counts that make svn_diff__lcs() consider all tokens as
+   * occurring in both sources.  Allocated on demand. */
+  svn_diff__token_index_t *all_common;
+  svn_diff__token_index_t num_tokens;
+
+  /* The result so far, in order, and its last element. */
+  svn_diff__lcs_t *lcs;
+  svn_diff__lcs_t *last_lcs;
+
+  apr_pool_t *pool;
+} histogram_t;
+
+/* Add the LENGTH matching tokens starting at POSITION0 and POSITION1 to
+ * the result in H. */
+static void
+histogram_append(histogram_t *h,
+                 svn_diff__position_t *position0,
+                 svn_diff__position_t *position1,
+                 apr_off_t length)
+{
+  svn_diff__lcs_t *lcs = h->last_lcs;
+
+  /* Extend the previous run, if possible. */
+  if (lcs
+      && lcs->position[0]->offset + lcs->length == position0->offset
+      && lcs->position[1]->offset + lcs->length == position1->offset)
+    {
+      lcs->length += length;
+      return;
+    }
+
+  lcs = apr_palloc(h->pool, sizeof(*lcs));
+  lcs->position[0] = position0;
+  lcs->position[1] = position1;
+  lcs->length = length;
+  lcs->refcount = 1;
+  lcs->next = NULL;
+
+  if (h->last_lcs)
+    h->last_lcs->next = lcs;
+  else
+    h->lcs = lcs;
+
+  h->last_lcs = lcs;
+}
+
+/* Find the run of matching tokens to anchor REGION in H on and return it
+ * in *ANCHOR.  Return FALSE if there is none.  Set *HAS_COMMON if the two
+ * parts of REGION have any tokens in common. */
+static svn_boolean_t
+histogram_find_anchor(histogram_region_t *anchor,
+                      svn_boolean_t *has_common,
+                      histogram_t *h,
+                      const histogram_region_t *region)
+{
+  svn_diff__position_t **position0 = h->position[0];
+  svn_diff__position_t **position1 = h->position[1];
+  apr_off_t best_count = HISTOGRAM_MAX_OCCURRENCES;
+  apr_off_t best_length = 0;
+  apr_off_t a, b, b_next;
+
+  *has_common = FALSE;
+
+  /* Count the tokens in the first source.  Go backwards, so the chains of
+   * occurrences will be in ascending order. */
+  for (a = region->end[0] - 1; a >= region->start[0]; a--)
+    {
+      svn_diff__token_index_t token = position0[a]->token_index;
+
+      if (h->count[token] < HISTOGRAM_MAX_OCCURRENCES)
+        {
+          h->next[a] = h->count[token] ? h->first[token] : -1;
+          h->first[token] = a;
+        }
+
+      h->count[token]++;
+    }
+
+  for (b = region->start[1]; b < region->end[1]; b = b_next)
+    {
+      svn_diff__token_index_t token = position1[b]->token_index;
+
+      b_next = b + 1;
+      if (h->count[token] == 0)
+        continue;
+
+      *has_common = TRUE;
+      if (h->count[token] > best_count)
+        continue;
+
+      /* Try all occurrences of TOKEN in the first source. */
+      for (a = h->first[token]; a >= 0; )
+        {
+          apr_off_t start0 = a, start1 = b;
+          apr_off_t end0 = a + 1, end1 = b + 1;
+          apr_off_t count = h->count[token];
+
+          while (start0 > region->start[0] && start1 > region->start[1]
+                 && position0[start0 - 1]->token_index
+                    == position1[start1 - 1]->token_index)
+            {
+              start0--;
+              start1--;
+              count = MIN(count, h->count[position0[start0]->token_index]);
+            }
+
+          while (end0 < region->end[0] && end1 < region->end[1]
+                 && position0[end0]->token_index
+                    == position1[end1]->token_index)
+            {
+              count = MIN(count, h->count[position0[end0]->token_index]);
+              end0++;
+              end1++;
+            }
+
+          /* The following tokens in the second source are part of this
+           * run and need not be tried again. */
+          if (b_next < end1)
+            b_next = end1;
+
+          if (best_length < end0 - start0 || count < best_count)
+            {
+              anchor->start[0] = start0;
+              anchor->start[1] = start1;
+              anchor->end[0] = end0;
+              anchor->end[1] = end1;
+              best_length = end0 - start0;
+              best_count = count;
+            }
+
+          /* Skip the occurrences that are part of this run. */
+          do
+            a = h->next[a];
+          while (a >= 0 && a < end0);
+        }
+    }
+
+  /* Reset the counts for the next region. */
+  for (a = region->start[0]; a < region->end[0]; a++)
+    h->count[position0[a]->token_index] = 0;
+
+  return best_length > 0;
+}
+
+/* Add the result of svn_diff__lcs() for REGION to H.  Use SCRATCH_POOL
+ * for temporary allocations. */
+static void
+histogram_fallback(histogram_t *h,
+                   const histogram_region_t *region,
+                   apr_pool_t *scratch_pool)
+{
+  svn_diff__position_t *tail[2];
+  svn_diff__position_t *tail_next[2];
+  svn_diff__lcs_t *lcs;
+  int i;
+
+  /* Counts for just this region would be expensive to compute for every
+   * fallback.  Without them, svn_diff__lcs() simply skips its unique
+   * tokens optimization. */
+  if (h->all_common == NULL)
+    {
+      svn_diff__token_index_t token;
+
+      h->all_common = apr_palloc(h->pool, h->num_tokens
+                                          * sizeof(*h->all_common));
+      for (token = 0; token < h->num_tokens; token++)
+        h->all_common[token] = 1;
+    }
+
+  /* Temporarily turn the region's positions into the rings that
+   * svn_diff__lcs() expects. */
+  for (i = 0; i < 2; i++)
+    {
+      tail[i] = h->position[i][region->end[i] - 1];
+      tail_next[i] = tail[i]->next;
+      tail[i]->next = h->position[i][region->start[i]];
+    }
+
+  lcs = svn_diff__lcs(tail[0], tail[1], h->all_common, h->all_common, 0,
+                      0, 0, scratch_pool);
+
+  for (i = 0; i < 2; i++)
+    tail[i]->next = tail_next[i];
+
+  /* Copy everything but the EOF element. */
+  for (; lcs->length > 0; lcs = lcs->next)
+    histogram_append(h, lcs->position[0], lcs->position[1], lcs->length);
+}
+
+svn_diff__lcs_t *
+svn_diff__lcs_histogram(svn_diff__position_t *position_list1,
+                        svn_diff__position_t *position_list2,
+                        svn_diff__token_index_t *token_counts_list1,
+                        svn_diff__token_index_t *token_counts_list2,
+                        svn_diff__token_index_t num_tokens,
+                        apr_off_t prefix_lines,
+                        apr_off_t suffix_lines,
+                        apr_pool_t *pool)
+{
+  svn_diff__position_t *position_list[2];
+  apr_pool_t *scratch_pool;
+  apr_array_header_t *regions;
+  histogram_region_t *region;
+  histogram_t h = { { 0 } };
+  svn_diff__lcs_t *lcs;
+  apr_off_t k;
+  int i;
+
+  /* With nothing to compare, there is nothing to be gained. */
+  if (position_list1 == NULL || position_list2 == NULL)
+    return svn_diff__lcs(position_list1, position_list2, token_counts_list1,
+                         token_counts_list2, num_tokens, prefix_lines,
+                         suffix_lines, pool);
+
+  scratch_pool = svn_pool_create(pool);
+  position_list[0] = position_list1;
+  position_list[1] = position_list2;
+
+  for (i = 0; i < 2; i++)
+    {
+      svn_diff__position_t *position = position_list[i]->next;
+
+      h.length[i] = position_list[i]->offset - position->offset + 1;
+      h.position[i] = apr_palloc(scratch_pool,
+                                 h.length[i] * sizeof(*h.position[i]));
+      for (k = 0; k < h.length[i]; k++)
+        {
+          h.position[i][k] = position;
+          position = position->next;
+        }
+    }
+
+  h.count = apr_pcalloc(scratch_pool, num_tokens * sizeof(*h.count));
+  h.first = apr_palloc(scratch_pool, num_tokens * sizeof(*h.first));
+  h.next = apr_palloc(scratch_pool, h.length[0] * sizeof(*h.next));
+  h.num_tokens = num_tokens;
+  h.pool = pool;
+
+  /* Process the regions in order, using a stack instead of recursion. */
+  regions = apr_array_make(scratch_pool, 16, sizeof(histogram_region_t));
+  region = apr_array_push(regions);
+  region->start[0] = 0;
+  region->start[1] = 0;
+  region->end[0] = h.length[0];
+  region->end[1] = h.length[1];
+  region->is_match = FALSE;
+
+  while ((region = apr_array_pop(regions)) != NULL)
+    {
+      histogram_region_t current = *region;
+      histogram_region_t anchor;
+      svn_boolean_t has_common;
+
+      if (current.is_match)
+        {
+          histogram_append(&h, h.position[0][current.start[0]],
+                           h.position[1][current.start[1]],
+                           current.end[0] - current.start[0]);
+          continue;
+        }
+
+      if (   current.start[0] == current.end[0]
+          || current.start[1] == current.end[1])
+        continue;
+
+      if (histogram_find_anchor(&anchor, &has_common, &h, &current))
+        {
+          region = apr_array_push(regions);
+          region->start[0] = anchor.end[0];
+          region->start[1] = anchor.end[1];
+          region->end[0] = current.end[0];
+          region->end[1] = current.end[1];
+          region->is_match = FALSE;
+
+          region = apr_array_push(regions);
+          *region = anchor;
+          region->is_match = TRUE;
+
+          region = apr_array_push(regions);
+          region->start[0] = current.start[0];
+          region->start[1] = current.start[1];
+          region->end[0] = anchor.start[0];
+          region->end[1] = anchor.start[1];
+          region->is_match = FALSE;
+        }
+      else if (has_common)
+        {
+          histogram_fallback(&h, &current, scratch_pool);
+        }
+    }
+
+  svn_pool_destroy(scratch_pool);
+
+  /* Since EOF is always a sync point we tack on an EOF link
+   * with sentinel positions, just like svn_diff__lcs().
+   */
+  lcs = apr_palloc(pool, sizeof(*lcs));
+  lcs->position[0] = apr_pcalloc(pool, sizeof(*lcs->position[0]));
+  lcs->position[0]->offset = position_list1->offset + suffix_lines + 1;
+  lcs->position[1] = apr_pcalloc(pool, sizeof(*lcs->position[1]));
+  lcs->position[1]->offset = position_list2->offset + suffix_lines + 1;
+  lcs->length = 0;
+  lcs->refcount = 1;
+  lcs->next = NULL;
+
+  if (suffix_lines)
+    lcs = prepend_lcs(lcs, suffix_lines,
+                      lcs->position[0]->offset - suffix_lines,
+                      lcs->position[1]->offset - suffix_lines,
+                      pool);
+
+  if (h.last_lcs)
+    {
+      h.last_lcs->next = lcs;
+      lcs = h.lcs;
+    }
+
+  if (prefix_lines)
+    return prepend_lcs(lcs, prefix_lines, 1, 1, pool);
+  else
+    return lcs;
+}
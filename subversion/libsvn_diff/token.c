@@ -26,33 +26,65 @@
 #include <apr_pools.h>
 #include <apr_general.h>
 
+#include <string.h>
+
 #include "svn_error.h"
 #include "svn_diff.h"
+#include "svn_sorts.h"
 #include "svn_types.h"
 
 #include "diff.h"
 
 
 /*
- * Prime number to use as the size of the hash table.  This number was
- * not selected by testing of any kind and may need tweaking.
+ * Initial number of slots in the hash table.  Must be a power of 2.
+ */
+#define SVN_DIFF__TABLE_MIN_SIZE 256
+
+/*
+ * Initial number of positions to allocate at once in svn_diff__get_tokens.
+ */
+#define SVN_DIFF__POSITION_BLOCK_MIN 16
+
+/*
+ * Upper limit for the number of positions to allocate at once.
  */
-#define SVN_DIFF__HASH_SIZE 127
+#define SVN_DIFF__POSITION_BLOCK_MAX 4096
 
+/*
+ * A slot in the token hash table.
+ */
 struct svn_diff__node_t
 {
-  svn_diff__node_t       *parent;
-  svn_diff__node_t       *left;
-  svn_diff__node_t       *right;
-
+  /* The hash value as returned by the datasource. */
   apr_uint32_t            hash;
-  svn_diff__token_index_t index;
-  void                   *token;
+
+  /* 1 + the index of the token in svn_diff__tree_t.tokens.
+   * 0 for unused slots. */
+  apr_uint32_t            index;
 };
 
+/*
+ * The set of distinct tokens of all datasources of a diff.  This is an
+ * open addressing hash table with linear probing.  It only refers to the
+ * tokens themselves through their index, keeping the slots small and the
+ * probing sequence cache-friendly.
+ */
 struct svn_diff__tree_t
 {
-  svn_diff__node_t       *root[SVN_DIFF__HASH_SIZE];
+  /* The hash table.  Its size is a power of 2 and we keep it at most
+   * half full. */
+  svn_diff__node_t       *nodes;
+
+  /* Number of bits used from the hash to select a slot. */
+  int                     shift;
+
+  /* The latest token read for each token index. */
+  void                  **tokens;
+
+  /* Number of elements allocated for TOKENS. */
+  svn_diff__token_index_t tokens_size;
+
   apr_pool_t             *pool;
   svn_diff__token_index_t node_count;
 };
@@ -68,7 +100,7 @@ svn_diff__get_node_count(svn_diff__tree_t *tree)
 }
 
 /*
- * Support functions to build a tree of token positions
+ * Support functions to build the table of distinct tokens
  */
 
 void
@@ -79,64 +111,123 @@ svn_diff__tree_create(svn_diff__tree_t **tree, apr_pool_t *pool)
   (*tree)->node_count = 0;
 }
 
+/* Return the first slot to probe in TREE for HASH.  Datasources may
+ * return hashes with a poor distribution in the lower bits, so we use the
+ * upper bits of a multiplicative hash. */
+static APR_INLINE apr_size_t
+slot_of(const svn_diff__tree_t *tree,
+        apr_uint32_t hash)
+{
+  return (apr_size_t)((hash * 0x9e3779b1) >> tree->shift);
+}
+
+/* Double the size of the hash table in TREE, or create it if it does not
+ * exist yet. */
+static void
+tree_grow(svn_diff__tree_t *tree)
+{
+  svn_diff__node_t *old_nodes = tree->nodes;
+  apr_size_t old_size = old_nodes ? (apr_size_t)1 << (32 - tree->shift) : 0;
+  apr_size_t new_size = old_nodes ? 2 * old_size : SVN_DIFF__TABLE_MIN_SIZE;
+  apr_size_t mask = new_size - 1;
+  apr_size_t i;
+
+  tree->nodes = apr_pcalloc(tree->pool, new_size * sizeof(*tree->nodes));
+  tree->shift = 32;
+  for (i = new_size; i > 1; i >>= 1)
+    tree->shift--;
+
+  for (i = 0; i < old_size; i++)
+    if (old_nodes[i].index)
+      {
+        apr_size_t slot = slot_of(tree, old_nodes[i].hash);
+        while (tree->nodes[slot].index)
+          slot = (slot + 1) & mask;
+
+        tree->nodes[slot] = old_nodes[i];
+      }
+}
+
+/* Add another token to TREE, growing its TOKENS array as needed. */
+static svn_diff__token_index_t
+tree_add_token(svn_diff__tree_t *tree,
+               void *token)
+{
+  if (tree->node_count == tree->tokens_size)
+    {
+      void **old_tokens = tree->tokens;
+
+      tree->tokens_size = MAX(2 * tree->tokens_size,
+                              SVN_DIFF__TABLE_MIN_SIZE / 2);
+      tree->tokens = apr_palloc(tree->pool,
+                                tree->tokens_size * sizeof(*tree->tokens));
+      if (tree->node_count)
+        memcpy(tree->tokens, old_tokens,
+               tree->node_count * sizeof(*tree->tokens));
+    }
+
+  tree->tokens[tree->node_count] = token;
+
+  return tree->node_count++;
+}
 
+/* Look up TOKEN with HASH in TREE and return its index in *INDEX.  If
+ * TREE does not contain an equal token yet, add TOKEN as a new one. */
 static svn_error_t *
-tree_insert_token(svn_diff__node_t **node, svn_diff__tree_t *tree,
+tree_insert_token(svn_diff__token_index_t *index,
+                  svn_diff__tree_t *tree,
                   void *diff_baton,
                   const svn_diff_fns2_t *vtable,
                   apr_uint32_t hash, void *token)
 {
-  svn_diff__node_t *new_node;
-  svn_diff__node_t **node_ref;
-  svn_diff__node_t *parent;
+  svn_diff__node_t *node;
+  apr_size_t mask;
+  apr_size_t slot;
   int rv;
 
   SVN_ERR_ASSERT(token);
 
-  parent = NULL;
-  node_ref = &tree->root[hash % SVN_DIFF__HASH_SIZE];
-
-  while (*node_ref != NULL)
+  /* Keep the table at most half full.  The indexes must fit into
+   * apr_uint32_t, which will never be an issue in practice. */
+  if (   tree->nodes == NULL
+      || tree->node_count >= (svn_diff__token_index_t)1 << (31 - tree->shift))
     {
-      parent = *node_ref;
-
-      rv = hash - parent->hash;
-      if (!rv)
-        SVN_ERR(vtable->token_compare(diff_baton, parent->token, token, &rv));
-
-      if (rv == 0)
-        {
-          /* Discard the previous token.  This helps in cases where
-           * only recently read tokens are still in memory.
-           */
-          if (vtable->token_discard != NULL)
-            vtable->token_discard(diff_baton, parent->token);
+      SVN_ERR_ASSERT(tree->node_count < APR_INT32_MAX);
+      tree_grow(tree);
+    }
 
-          parent->token = token;
-          *node = parent;
+  mask = ((apr_size_t)1 << (32 - tree->shift)) - 1;
+  slot = slot_of(tree, hash);
 
-          return SVN_NO_ERROR;
-        }
-      else if (rv > 0)
-        {
-          node_ref = &parent->left;
-        }
-      else
+  for (node = &tree->nodes[slot]; node->index; node = &tree->nodes[slot])
+    {
+      if (node->hash == hash)
         {
-          node_ref = &parent->right;
+          void **old_token = &tree->tokens[node->index - 1];
+
+          SVN_ERR(vtable->token_compare(diff_baton, *old_token, token, &rv));
+          if (rv == 0)
+            {
+              /* Discard the previous token.  This helps in cases where
+               * only recently read tokens are still in memory.
+               */
+              if (vtable->token_discard != NULL)
+                vtable->token_discard(diff_baton, *old_token);
+
+              *old_token = token;
+              *index = node->index - 1;
+
+              return SVN_NO_ERROR;
+            }
         }
+
+      slot = (slot + 1) & mask;
     }
 
   /* Create a new node */
-  new_node = apr_palloc(tree->pool, sizeof(*new_node));
-  new_node->parent = parent;
-  new_node->left = NULL;
-  new_node->right = NULL;
-  new_node->hash = hash;
-  new_node->token = token;
-  new_node->index = tree->node_count++;
-
-  *node = *node_ref = new_node;
+  *index = tree_add_token(tree, token);
+  node->hash = hash;
+  node->index = (apr_uint32_t)(*index + 1);
 
   return SVN_NO_ERROR;
 }
@@ -158,7 +249,10 @@ svn_diff__get_tokens(svn_diff__position_t **position_list,
   svn_diff__position_t *start_position;
   svn_diff__position_t *position = NULL;
   svn_diff__position_t **position_ref;
-  svn_diff__node_t *node;
+  svn_diff__position_t *free_positions = NULL;
+  apr_size_t free_count = 0;
+  apr_size_t block_size = SVN_DIFF__POSITION_BLOCK_MIN;
+  svn_diff__token_index_t index;
   void *token;
   apr_off_t offset;
   apr_uint32_t hash;
@@ -176,12 +270,23 @@ svn_diff__get_tokens(svn_diff__position_t **position_list,
         break;
 
       offset++;
-      SVN_ERR(tree_insert_token(&node, tree, diff_baton, vtable, hash, token));
+      SVN_ERR(tree_insert_token(&index, tree, diff_baton, vtable, hash,
+                                token));
 
-      /* Create a new position */
-      position = apr_palloc(pool, sizeof(*position));
+      /* Create a new position.  Allocate them in growing blocks to
+       * minimize the overhead for both, small and large datasources. */
+      if (free_count == 0)
+        {
+          free_positions = apr_palloc(pool,
+                                      block_size * sizeof(*free_positions));
+          free_count = block_size;
+          block_size = MIN(2 * block_size, SVN_DIFF__POSITION_BLOCK_MAX);
+        }
+
+      position = free_positions++;
+      free_count--;
       position->next = NULL;
-      position->token_index = node->index;
+      position->token_index = index;
       position->offset = offset;
 
       *position_ref = position;
@@ -196,3 +301,20 @@ svn_diff__get_tokens(svn_diff__position_t **position_list,
 
   return SVN_NO_ERROR;
 }
+
+apr_uint32_t
+svn_diff__token_hash(apr_uint32_t hash,
+                     const char *data,
+                     apr_size_t len)
+{
+  /* FNV-1a.  XOR'ing with the offset basis on entry and exit makes 0 the
+   * initial value and allows for continuation. */
+  const unsigned char *p = (const unsigned char *)data;
+  const unsigned char *end = p + len;
+
+  hash ^= 0x811c9dc5;
+  for (; p < end; p++)
+    hash = (hash ^ *p) * 0x01000193;
+
+  return hash ^ 0x811c9dc5;
+}
@@ -615,6 +615,7 @@ svn_fs_verify(const char *path,
   SVN_ERR(vtable->verify_fs(fs, path, start, end,
                             notify_func, notify_baton,
                             cancel_func, cancel_baton,
+                            svn_fs_open2,
                             common_pool_lock,
                             pool, common_pool));
   return SVN_NO_ERROR;
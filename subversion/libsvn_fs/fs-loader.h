@@ -101,6 +101,8 @@ typedef struct fs_library_vtable_t
                              svn_mutex__t *common_pool_lock,
                              apr_pool_t *scratch_pool,
                              apr_pool_t *common_pool);
+  /* Verify the filesystem at PATH.  SVN_FS_OPEN_ is svn_fs_open2(), which
+     the FSAP may use to open further instances of the filesystem. */
   svn_error_t *(*verify_fs)(svn_fs_t *fs, const char *path,
                             svn_revnum_t start,
                             svn_revnum_t end,
@@ -108,6 +110,11 @@ typedef struct fs_library_vtable_t
                             void *notify_baton,
                             svn_cancel_func_t cancel_func,
                             void *cancel_baton,
+                            svn_error_t *(*svn_fs_open_)(svn_fs_t **,
+                                                         const char *,
+                                                         apr_hash_t *,
+                                                         apr_pool_t *,
+                                                         apr_pool_t *),
                             svn_mutex__t *common_pool_lock,
                             apr_pool_t *pool,
                             apr_pool_t *common_pool);
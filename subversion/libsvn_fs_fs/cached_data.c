@@ -193,21 +193,6 @@ dbg_log_access(svn_fs_t *fs,
   return SVN_NO_ERROR;
 }
 
-/* Convenience wrapper around svn_io_file_aligned_seek, taking filesystem
-   FS instead of a block size. */
-static svn_error_t *
-aligned_seek(svn_fs_t *fs,
-             apr_file_t *file,
-             apr_off_t *buffer_start,
-             apr_off_t offset,
-             apr_pool_t *pool)
-{
-  fs_fs_data_t *ffd = fs->fsap_data;
-  return svn_error_trace(svn_io_file_aligned_seek(file, ffd->block_size,
-                                                  buffer_start, offset,
-                                                  pool));
-}
-
 /* Open the revision file for revision REV in filesystem FS and store
    the newly opened file in FILE.  Seek to location OFFSET before
    returning.  Perform temporary allocations in POOL. */
@@ -227,7 +212,7 @@ open_and_seek_revision(svn_fs_fs__revision_file_t **file,
   SVN_ERR(svn_fs_fs__item_offset(&offset, fs, rev_file, rev, NULL, item,
                                  pool));
 
-  SVN_ERR(aligned_seek(fs, rev_file->file, NULL, offset, pool));
+  SVN_ERR(svn_fs_fs__rev_file_seek(rev_file, NULL, offset, pool));
 
   *file = rev_file;
 
@@ -249,7 +234,7 @@ open_and_seek_transaction(svn_fs_fs__revision_file_t **file,
 
   SVN_ERR(svn_fs_fs__item_offset(&offset, fs, NULL, SVN_INVALID_REVNUM,
                                  &rep->txn_id, rep->item_index, pool));
-  SVN_ERR(aligned_seek(fs, (*file)->file, NULL, offset, pool));
+  SVN_ERR(svn_fs_fs__rev_file_seek(*file, NULL, offset, pool));
 
   return SVN_NO_ERROR;
 }
@@ -291,6 +276,132 @@ use_block_read(svn_fs_t *fs)
   return svn_fs_fs__use_log_addressing(fs) && ffd->use_block_read;
 }
 
+/* Maximum number of directory entries for which we give read-ahead hints
+   in one go.  Keeps the number of index lookups and file opens in check. */
+#define MAX_PREFETCH_DIR_ENTRIES 64
+
+/* Return TRUE, if we shall give the OS read-ahead hints in FS for rev /
+   pack file data that we are likely to read next. */
+static svn_boolean_t
+use_prefetch(svn_fs_t *fs)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  return use_block_read(fs) && ffd->prefetch_blocks;
+}
+
+/* Return TRUE, if RANGE refers to the same rev / pack file as REV_FILE. */
+static svn_boolean_t
+is_same_file(const prefetch_range_t *range,
+             svn_fs_fs__revision_file_t *rev_file)
+{
+  return range->start_revision == rev_file->start_revision
+      && range->is_packed == rev_file->is_packed;
+}
+
+/* Return the range in FFD's read-ahead history that contains OFFSET
+   within REV_FILE.  Return NULL if there is no such range. */
+static prefetch_range_t *
+find_prefetched_range(fs_fs_data_t *ffd,
+                      svn_fs_fs__revision_file_t *rev_file,
+                      apr_off_t offset)
+{
+  int i;
+  for (i = 0; i < SVN_FS_FS__PREFETCH_HISTORY; ++i)
+    {
+      prefetch_range_t *range = &ffd->prefetched[i];
+      if (   offset >= range->start
+          && offset < range->end
+          && is_same_file(range, rev_file))
+        return range;
+    }
+
+  return NULL;
+}
+
+/* Ask the OS to read the blocks of REV_FILE in FS that overlap with
+   [START, END) ahead of time.  Blocks that have been requested recently
+   will not be requested again.  This is a mere hint, i.e. there is no
+   error reporting. */
+static void
+prefetch_range(svn_fs_t *fs,
+               svn_fs_fs__revision_file_t *rev_file,
+               apr_off_t start,
+               apr_off_t end)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  prefetch_range_t *range;
+
+  /* Block-align the range and skip what we asked for before. */
+  start -= start % ffd->block_size;
+  end += ffd->block_size - 1;
+  end -= end % ffd->block_size;
+
+  while (start < end)
+    {
+      range = find_prefetched_range(ffd, rev_file, start);
+      if (range == NULL)
+        break;
+
+      start = range->end;
+    }
+
+  if (   start >= end
+      || !svn_fs_fs__rev_file_prefetch(rev_file, start, end))
+    return;
+
+  /* Remember the hint to be able to tell hits from misses. */
+  range = &ffd->prefetched[ffd->next_prefetched];
+  range->start_revision = rev_file->start_revision;
+  range->is_packed = rev_file->is_packed;
+  range->start = start;
+  range->end = end;
+
+  ffd->next_prefetched = (ffd->next_prefetched + 1)
+                       % SVN_FS_FS__PREFETCH_HISTORY;
+  ++ffd->prefetch_requests;
+}
+
+/* We are about to read the block of the committed REV_FILE in FS that
+   contains OFFSET.  Update the read-ahead hit / miss statistics for it.
+   Repeated reads from the same block are counted only once. */
+static void
+count_block_access(svn_fs_t *fs,
+                   svn_fs_fs__revision_file_t *rev_file,
+                   apr_off_t offset)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  apr_off_t block_start = offset - offset % ffd->block_size;
+
+  if (   !use_prefetch(fs)
+      || !SVN_IS_VALID_REVNUM(rev_file->start_revision))
+    return;
+
+  if (   ffd->last_block.start == block_start
+      && is_same_file(&ffd->last_block, rev_file))
+    return;
+
+  ffd->last_block.start_revision = rev_file->start_revision;
+  ffd->last_block.is_packed = rev_file->is_packed;
+  ffd->last_block.start = block_start;
+  ffd->last_block.end = block_start + ffd->block_size;
+
+  if (find_prefetched_range(ffd, rev_file, block_start))
+    ++ffd->prefetch_hits;
+  else
+    ++ffd->prefetch_misses;
+}
+
+void
+svn_fs_fs__get_prefetch_stats(svn_fs_fs__prefetch_stats_t *stats,
+                              svn_fs_t *fs)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+
+  stats->requests = ffd->prefetch_requests;
+  stats->hits = ffd->prefetch_hits;
+  stats->misses = ffd->prefetch_misses;
+}
+
 svn_error_t *
 svn_fs_fs__fixup_expanded_size(svn_fs_t *fs,
                                representation_t *rep,
@@ -368,7 +479,8 @@ svn_fs_fs__fixup_expanded_size(svn_fs_t *fs,
    * out.  So, let's just look at the representation header. */
   SVN_ERR(open_and_seek_revision(&revision_file, fs, rep->revision,
                                  rep->item_index, scratch_pool));
-  SVN_ERR(svn_fs_fs__read_rep_header(&rep_header, revision_file->stream,
+  SVN_ERR(svn_fs_fs__read_rep_header(&rep_header,
+                                     svn_fs_fs__rev_file_stream(revision_file),
                                      scratch_pool, scratch_pool));
   SVN_ERR(svn_fs_fs__close_revision_file(revision_file));
 
@@ -483,9 +595,10 @@ get_node_revision_body(node_revision_t **noderev_p,
         }
       else
         {
+          svn_stream_t *stream = svn_fs_fs__rev_file_stream(revision_file);
+
           /* physical addressing mode reading, parsing and caching */
-          SVN_ERR(svn_fs_fs__read_noderev(noderev_p,
-                                          revision_file->stream,
+          SVN_ERR(svn_fs_fs__read_noderev(noderev_p, stream,
                                           result_pool,
                                           scratch_pool));
           SVN_ERR(fixup_node_revision(fs, *noderev_p, scratch_pool));
@@ -547,9 +660,9 @@ get_fs_id_at_offset(svn_fs_id_t **id_p,
 {
   node_revision_t *noderev;
 
-  SVN_ERR(aligned_seek(fs, rev_file->file, NULL, offset, pool));
+  SVN_ERR(svn_fs_fs__rev_file_seek(rev_file, NULL, offset, pool));
   SVN_ERR(svn_fs_fs__read_noderev(&noderev,
-                                  rev_file->stream,
+                                  svn_fs_fs__rev_file_stream(rev_file),
                                   pool, pool));
 
   /* noderev->id is const, get rid of that */
@@ -630,9 +743,8 @@ get_root_changes_offset(apr_off_t *root_offset,
     }
 
   /* Read in this last block, from which we will identify the last line. */
-  SVN_ERR(aligned_seek(fs, rev_file->file, NULL, start, pool));
-  SVN_ERR(svn_io_file_read_full2(rev_file->file, buffer, len, NULL, NULL,
-                                 pool));
+  SVN_ERR(svn_fs_fs__rev_file_seek(rev_file, NULL, start, pool));
+  SVN_ERR(svn_fs_fs__rev_file_read(rev_file, buffer, len, NULL, pool));
 
   /* Parse the last line. */
   trailer = svn_stringbuf_ncreate(buffer, len, pool);
@@ -746,27 +858,33 @@ typedef struct rep_state_t
   int chunk_index;  /* number of the window to read */
 } rep_state_t;
 
-/* Simple wrapper around svn_io_file_get_offset to simplify callers. */
+/* Simple wrapper around svn_fs_fs__rev_file_offset to simplify callers. */
 static svn_error_t *
 get_file_offset(apr_off_t *offset,
                 rep_state_t *rs,
                 apr_pool_t *pool)
 {
-  return svn_error_trace(svn_io_file_get_offset(offset,
-                                                rs->sfile->rfile->file,
-                                                pool));
+  return svn_error_trace(svn_fs_fs__rev_file_offset(offset, rs->sfile->rfile,
+                                                    pool));
+}
+
+/* Return the stream to read the representation data of RS from. */
+static svn_stream_t *
+rs_stream(rep_state_t *rs)
+{
+  return svn_fs_fs__rev_file_stream(rs->sfile->rfile);
 }
 
-/* Simple wrapper around svn_io_file_aligned_seek to simplify callers. */
+/* Simple wrapper around svn_fs_fs__rev_file_seek to simplify callers.
+   Also, keep the read-ahead statistics up to date. */
 static svn_error_t *
 rs_aligned_seek(rep_state_t *rs,
                 apr_off_t *buffer_start,
                 apr_off_t offset,
                 apr_pool_t *pool)
 {
-  fs_fs_data_t *ffd = rs->sfile->fs->fsap_data;
-  return svn_error_trace(svn_io_file_aligned_seek(rs->sfile->rfile->file,
-                                                  ffd->block_size,
+  count_block_access(rs->sfile->fs, rs->sfile->rfile, offset);
+  return svn_error_trace(svn_fs_fs__rev_file_seek(rs->sfile->rfile,
                                                   buffer_start, offset,
                                                   pool));
 }
@@ -809,8 +927,8 @@ auto_read_diff_version(rep_state_t *rs, apr_pool_t *pool)
     {
       char buf[4];
       SVN_ERR(rs_aligned_seek(rs, NULL, rs->start, pool));
-      SVN_ERR(svn_io_file_read_full2(rs->sfile->rfile->file, buf,
-                                     sizeof(buf), NULL, NULL, pool));
+      SVN_ERR(svn_fs_fs__rev_file_read(rs->sfile->rfile, buf, sizeof(buf),
+                                       NULL, pool));
 
       /* ### Layering violation */
       if (! ((buf[0] == 'S') && (buf[1] == 'V') && (buf[2] == 'N')))
@@ -939,7 +1057,7 @@ create_rep_state_body(rep_state_t **rep_state,
                                                result_pool));
         }
 
-      SVN_ERR(svn_fs_fs__read_rep_header(&rh, rs->sfile->rfile->stream,
+      SVN_ERR(svn_fs_fs__read_rep_header(&rh, rs_stream(rs),
                                          result_pool, scratch_pool));
       SVN_ERR(get_file_offset(&rs->start, rs, result_pool));
 
@@ -1422,6 +1540,28 @@ set_cached_combined_window(svn_stringbuf_t *window,
   return SVN_NO_ERROR;
 }
 
+/* If we just read the header of the committed representation RS from disk,
+   tell the OS to prefetch the remainder of its data.  We will read its
+   delta windows soon but are going to read other reps' headers first. */
+static void
+prefetch_rep_data(rep_state_t *rs)
+{
+  svn_fs_t *fs = rs->sfile->fs;
+  fs_fs_data_t *ffd = fs->fsap_data;
+  apr_off_t start;
+
+  if (   !use_prefetch(fs)
+      || rs->sfile->rfile == NULL
+      || rs->start == -1
+      || !SVN_IS_VALID_REVNUM(rs->sfile->rfile->start_revision))
+    return;
+
+  /* The block containing the header has just been read. */
+  start = rs->start - rs->start % ffd->block_size + ffd->block_size;
+  if (start < rs->start + rs->size)
+    prefetch_range(fs, rs->sfile->rfile, start, rs->start + rs->size);
+}
+
 /* Build an array of rep_state structures in *LIST giving the delta
    reps from first_rep to a plain-text or self-compressed rep.  Set
    *SRC_STATE to the plain-text rep we find at the end of the chain,
@@ -1477,6 +1617,7 @@ build_rep_list(apr_array_header_t **list,
           break;
         }
 
+      prefetch_rep_data(rs);
       if (rep_header->type == svn_fs_fs__rep_plain)
         {
           /* This is a plaintext, so just return the current rep_state. */
@@ -1601,11 +1742,14 @@ read_delta_window(svn_txdelta_window_t **nwin, int this_chunk,
   iterpool = svn_pool_create(scratch_pool);
   while (rs->chunk_index < this_chunk)
     {
+      apr_size_t window_len;
+
       svn_pool_clear(iterpool);
-      SVN_ERR(svn_txdelta_skip_svndiff_window(rs->sfile->rfile->file,
-                                              rs->ver, iterpool));
+      SVN_ERR(svn_txdelta__read_raw_window_len(&window_len, rs_stream(rs),
+                                               rs->ver, iterpool));
+      start_offset += window_len;
+      SVN_ERR(rs_aligned_seek(rs, NULL, start_offset, iterpool));
       rs->chunk_index++;
-      SVN_ERR(get_file_offset(&start_offset, rs, iterpool));
       rs->current = start_offset - rs->start;
       if (rs->current >= rs->size)
         return svn_error_create(SVN_ERR_FS_CORRUPT, NULL,
@@ -1616,7 +1760,7 @@ read_delta_window(svn_txdelta_window_t **nwin, int this_chunk,
   svn_pool_destroy(iterpool);
 
   /* Actually read the next window. */
-  SVN_ERR(svn_txdelta_read_svndiff_window(nwin, rs->sfile->rfile->stream,
+  SVN_ERR(svn_txdelta_read_svndiff_window(nwin, rs_stream(rs),
                                           rs->ver, result_pool));
   SVN_ERR(get_file_offset(&end_offset, rs, scratch_pool));
   rs->current = end_offset - rs->start;
@@ -1651,8 +1795,8 @@ read_plain_window(svn_stringbuf_t **nwin, rep_state_t *rs,
 
   /* Read the plain data. */
   *nwin = svn_stringbuf_create_ensure(size, result_pool);
-  SVN_ERR(svn_io_file_read_full2(rs->sfile->rfile->file, (*nwin)->data, size,
-                                 NULL, NULL, result_pool));
+  SVN_ERR(svn_fs_fs__rev_file_read(rs->sfile->rfile, (*nwin)->data, size,
+                                   NULL, result_pool));
   (*nwin)->data[size] = 0;
 
   /* Update RS. */
@@ -1672,15 +1816,42 @@ skip_plain_window(rep_state_t *rs,
   return SVN_NO_ERROR;
 }
 
+/* Maximum number of delta windows to compose into one before expanding
+   it.  Composition time grows with the chain length times the number of
+   fragments in the result, so expanding each window becomes cheaper at
+   some point.  For chains of small edits, that is at about 100 windows
+   (see the "compose" benchmark in tools/dev/microbench.c). */
+#define MAX_COMPOSED_WINDOWS 64
+
+/* Return whether the undeltified window of the current chunk in RS will
+   be written to the combined window cache while reading RB. */
+static svn_boolean_t
+is_combined_window_cached(struct rep_read_baton *rb,
+                          rep_state_t *rs)
+{
+  /* Cache windows only if the whole rep content could be read as a
+     single chunk.  Only then will no other chunk need a deeper RS
+     list than the cached chunk. */
+  return (rb->chunk_index == 0) && (rs->current == rs->size)
+      && SVN_IS_VALID_REVNUM(rs->revision) && rs->combined_cache;
+}
+
 /* Get the undeltified window that is a result of combining all deltas
    from the current desired representation identified in *RB with its
-   base representation.  Store the window in *RESULT. */
+   base representation.  Store the window in *RESULT.
+
+   If TARGET is not NULL, it provides *TARGET_LEN bytes of space.  If the
+   window fits and does not need to be cached, expand it directly into
+   TARGET, set *TARGET_LEN to its size and *RESULT to NULL.  This saves
+   copying the data from an intermediate buffer. */
 static svn_error_t *
 get_combined_window(svn_stringbuf_t **result,
+                    char *target,
+                    apr_size_t *target_len,
                     struct rep_read_baton *rb)
 {
   apr_pool_t *pool, *new_pool, *window_pool;
-  int i;
+  int i, k, last;
   apr_array_header_t *windows;
   svn_stringbuf_t *source, *buf = rb->base_window;
   rep_state_t *rs;
@@ -1711,17 +1882,50 @@ get_combined_window(svn_stringbuf_t **result,
         }
     }
 
-  /* Combine in the windows from the other delta reps. */
+  /* Combine in the windows from the other delta reps.  Runs of windows
+     whose intermediate results don't get cached are composed into a
+     single window first, such that we only need to expand that one. */
   pool = svn_pool_create(rb->pool);
-  for (--i; i >= 0; --i)
+  for (--i; i >= 0; i = last - 1)
     {
       svn_txdelta_window_t *window;
 
       svn_pool_clear(iterpool);
 
-      rs = APR_ARRAY_IDX(rb->rs_list, i, rep_state_t *);
       window = APR_ARRAY_IDX(windows, i, svn_txdelta_window_t *);
 
+      /* Find the newest window LAST that the run may extend to.
+         Self-compressed windows are not worth composing. */
+      last = i;
+      if (window->src_ops)
+        while (last > 0 && i - last + 1 < MAX_COMPOSED_WINDOWS
+               && !is_combined_window_cached(rb,
+                                             APR_ARRAY_IDX(rb->rs_list, last,
+                                                           rep_state_t *)))
+          {
+            const svn_txdelta_window_t *older
+              = APR_ARRAY_IDX(windows, last, svn_txdelta_window_t *);
+            const svn_txdelta_window_t *newer
+              = APR_ARRAY_IDX(windows, last - 1, svn_txdelta_window_t *);
+
+            /* Composition relies on the source view being in range. */
+            if (newer->sview_len > older->tview_len)
+              return svn_error_create(SVN_ERR_FS_CORRUPT, NULL,
+                                      _("svndiff window length is "
+                                        "corrupt"));
+            --last;
+          }
+
+      if (last < i)
+        {
+          const svn_txdelta_window_t **chain
+            = apr_palloc(iterpool, (i - last + 1) * sizeof(*chain));
+          for (k = 0; k <= i - last; ++k)
+            chain[k] = APR_ARRAY_IDX(windows, i - k, svn_txdelta_window_t *);
+
+          window = svn_txdelta__compose_chain(chain, i - last + 1, iterpool);
+        }
+
       /* Maybe, we've got a PLAIN start representation.  If we do, read
          as much data from it as the needed for the txdelta window's source
          view.
@@ -1742,6 +1946,29 @@ get_combined_window(svn_stringbuf_t **result,
             SVN_ERR(skip_plain_window(rb->src_state, window->sview_len));
         }
 
+      rs = APR_ARRAY_IDX(rb->rs_list, last, rep_state_t *);
+
+      /* The final window goes straight to the caller if possible. */
+      if (last == 0 && target && window->tview_len <= *target_len
+          && !is_combined_window_cached(rb, rs))
+        {
+          apr_size_t len = window->tview_len;
+
+          svn_txdelta_apply_instructions(window, source ? source->data : NULL,
+                                         target, &len);
+          if (len != window->tview_len)
+            return svn_error_create(SVN_ERR_FS_CORRUPT, NULL,
+                                    _("svndiff window length is "
+                                      "corrupt"));
+
+          for (k = last; k <= i; ++k)
+            APR_ARRAY_IDX(rb->rs_list, k, rep_state_t *)->chunk_index++;
+
+          *target_len = len;
+          buf = NULL;
+          break;
+        }
+
       /* Combine this window with the current one. */
       new_pool = svn_pool_create(rb->pool);
       buf = svn_stringbuf_create_ensure(window->tview_len, new_pool);
@@ -1754,14 +1981,11 @@ get_combined_window(svn_stringbuf_t **result,
                                 _("svndiff window length is "
                                   "corrupt"));
 
-      /* Cache windows only if the whole rep content could be read as a
-         single chunk.  Only then will no other chunk need a deeper RS
-         list than the cached chunk. */
-      if (   (rb->chunk_index == 0) && (rs->current == rs->size)
-          && SVN_IS_VALID_REVNUM(rs->revision))
+      if (is_combined_window_cached(rb, rs))
         SVN_ERR(set_cached_combined_window(buf, rs, new_pool));
 
-      rs->chunk_index++;
+      for (k = last; k <= i; ++k)
+        APR_ARRAY_IDX(rb->rs_list, k, rep_state_t *)->chunk_index++;
 
       /* Cycle pools so that we only need to hold three windows at a time. */
       svn_pool_destroy(pool);
@@ -1771,6 +1995,10 @@ get_combined_window(svn_stringbuf_t **result,
 
   svn_pool_destroy(window_pool);
 
+  /* Nothing to keep if the window went directly into TARGET. */
+  if (buf == NULL)
+    svn_pool_destroy(pool);
+
   *result = buf;
   return SVN_NO_ERROR;
 }
@@ -1840,8 +2068,8 @@ get_contents_from_windows(struct rep_read_baton *rb,
 
           offset = rs->start + rs->current;
           SVN_ERR(rs_aligned_seek(rs, NULL, offset, rb->pool));
-          SVN_ERR(svn_io_file_read_full2(rs->sfile->rfile->file, cur,
-                                         copy_len, NULL, NULL, rb->pool));
+          SVN_ERR(svn_fs_fs__rev_file_read(rs->sfile->rfile, cur, copy_len,
+                                           NULL, rb->pool));
         }
 
       rs->current += copy_len;
@@ -1876,15 +2104,24 @@ get_contents_from_windows(struct rep_read_baton *rb,
       else
         {
           svn_stringbuf_t *sbuf = NULL;
+          apr_size_t direct_len = remaining;
 
           rs = APR_ARRAY_IDX(rb->rs_list, 0, rep_state_t *);
           if (rs->current == rs->size)
             break;
 
-          /* Get more buffered data by evaluating a chunk. */
-          SVN_ERR(get_combined_window(&sbuf, rb));
+          /* Get more data by evaluating a chunk.  It may go directly into
+             the caller's buffer if it fits. */
+          SVN_ERR(get_combined_window(&sbuf, cur, &direct_len, rb));
 
           rb->chunk_index++;
+          if (sbuf == NULL)
+            {
+              cur += direct_len;
+              remaining -= direct_len;
+              continue;
+            }
+
           rb->buf_len = sbuf->len;
           rb->buf = sbuf->data;
           rb->buf_pos = 0;
@@ -2267,6 +2504,7 @@ svn_fs_fs__get_contents_from_file(svn_stream_t **contents_p,
                                   apr_off_t offset,
                                   apr_pool_t *pool)
 {
+  fs_fs_data_t *ffd = fs->fsap_data;
   struct rep_read_baton *rb;
   pair_cache_key_t fulltext_cache_key = { SVN_INVALID_REVNUM, 0 };
   rep_state_t *rs = apr_pcalloc(pool, sizeof(*rs));
@@ -2294,9 +2532,10 @@ svn_fs_fs__get_contents_from_file(svn_stream_t **contents_p,
   rs->sfile->rfile->start_revision = SVN_INVALID_REVNUM;
   rs->sfile->rfile->file = file;
   rs->sfile->rfile->stream = svn_stream_from_aprfile2(file, TRUE, pool);
+  rs->sfile->rfile->block_size = ffd->block_size;
 
   /* Read the rep header. */
-  SVN_ERR(aligned_seek(fs, file, NULL, offset, pool));
+  SVN_ERR(svn_fs_fs__rev_file_seek(rs->sfile->rfile, NULL, offset, pool));
   SVN_ERR(svn_fs_fs__read_rep_header(&rh, rs->sfile->rfile->stream,
                                      pool, pool));
   SVN_ERR(get_file_offset(&rs->start, rs, pool));
@@ -2538,7 +2777,8 @@ svn_fs_fs__get_file_delta_stream(svn_txdelta_stream_t **stream_p,
   /* Because source and target stream will already verify their content,
    * there is no need to do this once more.  In particular if the stream
    * content is being fetched from cache. */
-  svn_txdelta2(stream_p, source_stream, target_stream, FALSE, pool);
+  SVN_ERR(svn_txdelta__parallel(stream_p, source_stream, target_stream,
+                                FALSE, ffd->deltification_threads, pool));
 
   return SVN_NO_ERROR;
 }
@@ -2795,6 +3035,101 @@ get_dir_contents(svn_fs_fs__dir_data_t *dir,
 }
 
 
+/* A svn_sort__array compatible comparator function, sorting the
+   svn_fs_fs__id_part_t given in LHS, RHS by revision and item number. */
+static int
+compare_id_parts(const void *lhs,
+                 const void *rhs)
+{
+  return svn_fs_fs__id_part_compare(lhs, rhs);
+}
+
+/* Directory ENTRIES in FS have just been read from disk and the caller is
+   likely to traverse them.  Ask the OS to read the blocks containing their
+   node-revisions ahead of time, unless those are cached already.  Use
+   SCRATCH_POOL for temporary allocations.  Callers should ignore any
+   errors returned. */
+static svn_error_t *
+prefetch_dir_entries(svn_fs_t *fs,
+                     apr_array_header_t *entries,
+                     apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  apr_array_header_t *items;
+  svn_fs_fs__revision_file_t *rev_file = NULL;
+  apr_pool_t *iterpool;
+  int i;
+
+  if (!use_prefetch(fs))
+    return SVN_NO_ERROR;
+
+  /* Collect the noderevs that we would have to read from disk. */
+  items = apr_array_make(scratch_pool, MAX_PREFETCH_DIR_ENTRIES,
+                         sizeof(svn_fs_fs__id_part_t));
+  for (i = 0;
+       i < entries->nelts && items->nelts < MAX_PREFETCH_DIR_ENTRIES;
+       ++i)
+    {
+      svn_fs_dirent_t *dirent = APR_ARRAY_IDX(entries, i, svn_fs_dirent_t *);
+      const svn_fs_fs__id_part_t *rev_item;
+      svn_boolean_t is_cached = FALSE;
+      pair_cache_key_t key = { 0 };
+
+      if (svn_fs_fs__id_is_txn(dirent->id))
+        continue;
+
+      rev_item = svn_fs_fs__id_rev_item(dirent->id);
+      key.revision = rev_item->revision;
+      key.second = rev_item->number;
+
+      if (ffd->node_revision_cache)
+        SVN_ERR(svn_cache__has_key(&is_cached, ffd->node_revision_cache,
+                                   &key, scratch_pool));
+
+      if (!is_cached)
+        APR_ARRAY_PUSH(items, svn_fs_fs__id_part_t) = *rev_item;
+    }
+
+  /* Sorting them by revision lets us open each rev / pack file only once. */
+  svn_sort__array(items, compare_id_parts);
+
+  iterpool = svn_pool_create(scratch_pool);
+  for (i = 0; i < items->nelts; ++i)
+    {
+      svn_fs_fs__id_part_t *rev_item
+        = &APR_ARRAY_IDX(items, i, svn_fs_fs__id_part_t);
+      svn_revnum_t revision = rev_item->revision;
+      apr_off_t offset;
+
+      if (   rev_file
+          && (   rev_file->start_revision
+                   != svn_fs_fs__packed_base_rev(fs, revision)
+              || rev_file->is_packed
+                   != svn_fs_fs__is_packed_rev(fs, revision)))
+        {
+          SVN_ERR(svn_fs_fs__close_revision_file(rev_file));
+          svn_pool_clear(iterpool);
+          rev_file = NULL;
+        }
+
+      if (rev_file == NULL)
+        SVN_ERR(svn_fs_fs__open_pack_or_rev_file(&rev_file, fs, revision,
+                                                 iterpool, iterpool));
+
+      /* Node-revisions are small.  Prefetching their first byte will get
+         us the whole block, which is what block-read will process. */
+      SVN_ERR(svn_fs_fs__item_offset(&offset, fs, rev_file, revision, NULL,
+                                     rev_item->number, iterpool));
+      prefetch_range(fs, rev_file, offset, offset + 1);
+    }
+
+  if (rev_file)
+    SVN_ERR(svn_fs_fs__close_revision_file(rev_file));
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
 /* Return the cache object in FS responsible to storing the directory the
  * NODEREV plus the corresponding *KEY.  If no cache exists, return NULL.
  * PAIR_KEY must point to some key struct, which does not need to be
@@ -2875,6 +3210,10 @@ svn_fs_fs__rep_contents_dir(apr_array_header_t **entries_p,
   SVN_ERR(get_dir_contents(dir, fs, noderev, result_pool, scratch_pool));
   *entries_p = dir->entries;
 
+  /* Our caller will probably have a look at the entries next.  This is
+     only a hint; failing to give it must not fail the directory read. */
+  svn_error_clear(prefetch_dir_entries(fs, dir->entries, scratch_pool));
+
   /* Update the cache, if we are to use one.
    *
    * Don't even attempt to serialize very large directories; it would cause
@@ -3056,6 +3395,58 @@ svn_fs_fs__create_changes_context(svn_fs_fs__changes_context_t **context,
   return SVN_NO_ERROR;
 }
 
+/* CONTEXT is about to read its changed paths list from disk.  If this
+   continues a history walk across consecutive revisions in either
+   direction, ask the OS to read the list of the next revision on that
+   walk ahead of time.  Use SCRATCH_POOL for temporary allocations.
+   Callers should ignore any errors returned. */
+static svn_error_t *
+prefetch_next_changes(svn_fs_fs__changes_context_t *context,
+                      apr_pool_t *scratch_pool)
+{
+  svn_fs_t *fs = context->fs;
+  fs_fs_data_t *ffd = fs->fsap_data;
+  svn_revnum_t revision = context->revision;
+  svn_revnum_t last_revision = ffd->last_changes_revision;
+  svn_revnum_t next = SVN_INVALID_REVNUM;
+  svn_fs_fs__revision_file_t *rev_file = context->revision_file;
+  svn_fs_fs__p2l_entry_t *entry;
+  apr_off_t offset;
+
+  if (!use_prefetch(fs))
+    return SVN_NO_ERROR;
+
+  ffd->last_changes_revision = revision;
+  if (!SVN_IS_VALID_REVNUM(last_revision))
+    return SVN_NO_ERROR;
+
+  if (last_revision == revision + 1 && revision > 0)
+    next = revision - 1;
+  else if (last_revision == revision - 1 && revision < ffd->youngest_rev_cache)
+    next = revision + 1;
+  else
+    return SVN_NO_ERROR;
+
+  /* The next list may well be in the same pack file. */
+  if (   rev_file->start_revision != svn_fs_fs__packed_base_rev(fs, next)
+      || rev_file->is_packed != svn_fs_fs__is_packed_rev(fs, next))
+    SVN_ERR(svn_fs_fs__open_pack_or_rev_file(&rev_file, fs, next,
+                                             scratch_pool, scratch_pool));
+
+  /* Let the phys-to-log index tell us how long that list is. */
+  SVN_ERR(svn_fs_fs__item_offset(&offset, fs, rev_file, next, NULL,
+                                 SVN_FS_FS__ITEM_INDEX_CHANGES,
+                                 scratch_pool));
+  SVN_ERR(svn_fs_fs__p2l_entry_lookup(&entry, fs, rev_file, next, offset,
+                                      scratch_pool, scratch_pool));
+  prefetch_range(fs, rev_file, offset, offset + (entry ? entry->size : 1));
+
+  if (rev_file != context->revision_file)
+    SVN_ERR(svn_fs_fs__close_revision_file(rev_file));
+
+  return SVN_NO_ERROR;
+}
+
 svn_error_t *
 svn_fs_fs__get_changes(apr_array_header_t **changes,
                        svn_fs_fs__changes_context_t *context,
@@ -3099,6 +3490,11 @@ svn_fs_fs__get_changes(apr_array_header_t **changes,
                                                    scratch_pool));
         }
 
+      /* Only the first block of changes is a good indicator for a walk
+       * across revisions. */
+      if (context->next == 0)
+        svn_error_clear(prefetch_next_changes(context, scratch_pool));
+
       if (use_block_read(context->fs))
         {
           /* 'block-read' will probably populate the cache with the data
@@ -3118,6 +3514,7 @@ svn_fs_fs__get_changes(apr_array_header_t **changes,
       /* If we still have no data, read it here. */
       if (!found)
         {
+          svn_fs_fs__revision_file_t *rev_file = context->revision_file;
           apr_off_t changes_offset;
 
           /* Addressing is very different for old formats
@@ -3142,20 +3539,20 @@ svn_fs_fs__get_changes(apr_array_header_t **changes,
             }
 
           /* Actual reading and parsing are the same, though. */
-          SVN_ERR(aligned_seek(context->fs, context->revision_file->file,
-                               NULL, changes_offset + context->next_offset,
-                               scratch_pool));
+          SVN_ERR(svn_fs_fs__rev_file_seek(rev_file, NULL,
+                                           changes_offset
+                                             + context->next_offset,
+                                           scratch_pool));
 
           SVN_ERR(svn_fs_fs__read_changes(changes,
-                                          context->revision_file->stream,
+                                          svn_fs_fs__rev_file_stream(rev_file),
                                           SVN_FS_FS__CHANGES_BLOCK_SIZE,
                                           result_pool, scratch_pool));
 
           /* Construct the info object for the entries block we just read. */
           changes_list = apr_pcalloc(scratch_pool, sizeof(*changes_list));
-          SVN_ERR(svn_io_file_get_offset(&changes_list->end_offset,
-                                         context->revision_file->file,
-                                         scratch_pool));
+          SVN_ERR(svn_fs_fs__rev_file_offset(&changes_list->end_offset,
+                                             rev_file, scratch_pool));
           changes_list->end_offset -= changes_offset;
           changes_list->start_offset = context->next_offset;
           changes_list->count = (*changes)->nelts;
@@ -3332,14 +3729,14 @@ cache_windows(svn_fs_t *fs,
           /* navigate to the current window */
           SVN_ERR(rs_aligned_seek(rs, NULL, start_offset, iterpool));
           SVN_ERR(svn_txdelta__read_raw_window_len(&window_len,
-                                                   rs->sfile->rfile->stream,
-                                                   iterpool));
+                                                   rs_stream(rs),
+                                                   rs->ver, iterpool));
 
           /* Read the raw window. */
           buf = apr_palloc(iterpool, window_len + 1);
           SVN_ERR(rs_aligned_seek(rs, NULL, start_offset, iterpool));
-          SVN_ERR(svn_io_file_read_full2(rs->sfile->rfile->file, buf,
-                                         window_len, NULL, NULL, iterpool));
+          SVN_ERR(svn_fs_fs__rev_file_read(rs->sfile->rfile, buf, window_len,
+                                           NULL, iterpool));
           buf[window_len] = 0;
 
           /* update relative offset in representation */
@@ -3415,12 +3812,11 @@ block_read_windows(svn_fs_fs__rep_header_t *rep_header,
       /* for larger reps, the header may have crossed a block boundary.
        * make sure we still read blocks properly aligned, i.e. don't use
        * plain seek here. */
-      SVN_ERR(aligned_seek(fs, rev_file->file, NULL, offset, scratch_pool));
+      SVN_ERR(svn_fs_fs__rev_file_seek(rev_file, NULL, offset, scratch_pool));
 
       plaintext = svn_stringbuf_create_ensure(rs.size, result_pool);
-      SVN_ERR(svn_io_file_read_full2(rev_file->file, plaintext->data,
-                                     rs.size, &plaintext->len, NULL,
-                                     result_pool));
+      SVN_ERR(svn_fs_fs__rev_file_read(rev_file, plaintext->data, rs.size,
+                                       &plaintext->len, result_pool));
       plaintext->data[plaintext->len] = 0;
       rs.current += rs.size;
 
@@ -3488,7 +3884,8 @@ block_read_contents(svn_fs_t *fs,
   header_key.revision = (apr_int32_t)entry->item.revision;
   header_key.second = entry->item.number;
 
-  SVN_ERR(read_rep_header(&rep_header, fs, rev_file->stream, &header_key,
+  SVN_ERR(read_rep_header(&rep_header, fs,
+                          svn_fs_fs__rev_file_stream(rev_file), &header_key,
                           scratch_pool, scratch_pool));
   SVN_ERR(block_read_windows(rep_header, fs, rev_file, entry, max_offset,
                              scratch_pool, scratch_pool));
@@ -3515,8 +3912,8 @@ read_item(svn_stream_t **stream,
   svn_stringbuf_t *text = svn_stringbuf_create_ensure(entry->size, pool);
   text->len = entry->size;
   text->data[text->len] = 0;
-  SVN_ERR(svn_io_file_read_full2(rev_file->file, text->data, text->len,
-                                 NULL, NULL, pool));
+  SVN_ERR(svn_fs_fs__rev_file_read(rev_file, text->data, text->len, NULL,
+                                   pool));
 
   /* Return (construct, calculate) stream and checksum. */
   *stream = svn_stream_from_stringbuf(text, pool);
@@ -3718,8 +4115,9 @@ block_read(void **result,
                                           ffd->block_size, scratch_pool,
                                           scratch_pool));
 
-      SVN_ERR(aligned_seek(fs, revision_file->file, &block_start, offset,
-                           iterpool));
+      SVN_ERR(svn_fs_fs__rev_file_seek(revision_file, &block_start, offset,
+                                       iterpool));
+      count_block_access(fs, revision_file, block_start);
 
       /* read all items from the block */
       for (i = 0; i < entries->nelts; ++i)
@@ -3751,8 +4149,8 @@ block_read(void **result,
                             && entry->size < ffd->block_size))
             {
               void *item = NULL;
-              SVN_ERR(svn_io_file_seek(revision_file->file, APR_SET,
-                                       &entry->offset, iterpool));
+              SVN_ERR(svn_fs_fs__rev_file_seek(revision_file, NULL,
+                                               entry->offset, iterpool));
               switch (entry->type)
                 {
                   case SVN_FS_FS__ITEM_TYPE_FILE_REP:
@@ -346,6 +346,36 @@ create_cache(svn_cache__t **cache_p,
   return SVN_NO_ERROR;
 }
 
+svn_error_t *
+svn_fs_fs__update_cache_stamp(svn_fs_t *fs,
+                              svn_revnum_t youngest,
+                              apr_pool_t *scratch_pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  const char *stamp;
+  svn_error_t *err;
+
+  if (ffd->cache_stamp_root == NULL)
+    return SVN_NO_ERROR;
+
+  /* A repository that got replaced, upgraded or modified behind our back
+   * will produce a different stamp. */
+  stamp = apr_psprintf(scratch_pool, "%s:%s:%d:%ld", fs->uuid,
+                       ffd->instance_id, ffd->format, youngest);
+  err = svn_cache__membuffer_set_stamp(svn_cache__get_global_membuffer_cache(),
+                                       ffd->cache_stamp_root, stamp,
+                                       scratch_pool);
+
+  /* Like all caching, snapshots are optional. */
+  if (err && !ffd->fail_stop)
+    {
+      svn_error_clear(err);
+      err = SVN_NO_ERROR;
+    }
+
+  return svn_error_trace(err);
+}
+
 svn_error_t *
 svn_fs_fs__initialize_caches(svn_fs_t *fs,
                              apr_pool_t *pool)
@@ -376,6 +406,8 @@ svn_fs_fs__initialize_caches(svn_fs_t *fs,
   has_namespace = strlen(cache_namespace) > 0;
 
   membuffer = svn_cache__get_global_membuffer_cache();
+  if (membuffer && svn_cache__membuffer_uses_snapshots(membuffer))
+    ffd->cache_stamp_root = apr_pstrdup(fs->pool, prefix);
 
   /* General rules for assigning cache priorities:
    *
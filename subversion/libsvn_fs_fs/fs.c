@@ -293,6 +293,8 @@ initialize_fs_struct(svn_fs_t *fs)
   ffd->use_log_addressing = FALSE;
   ffd->revprop_prefix = 0;
   ffd->flush_to_disk = TRUE;
+  ffd->last_block.start = -1;
+  ffd->last_changes_revision = SVN_INVALID_REVNUM;
 
   fs->vtable = &fs_vtable;
   fs->fsap_data = ffd;
@@ -319,15 +321,20 @@ fs_create(svn_fs_t *fs,
           apr_pool_t *scratch_pool,
           apr_pool_t *common_pool)
 {
+  fs_fs_data_t *ffd;
+
   SVN_ERR(svn_fs__check_fs(fs, FALSE));
 
   SVN_ERR(initialize_fs_struct(fs));
+  ffd = fs->fsap_data;
 
   SVN_ERR(svn_fs_fs__create(fs, path, scratch_pool));
 
   SVN_ERR(svn_fs_fs__initialize_caches(fs, scratch_pool));
   SVN_MUTEX__WITH_LOCK(common_pool_lock,
                        fs_serialized_init(fs, common_pool, scratch_pool));
+  if (ffd->cache_stamp_root)
+    SVN_ERR(svn_fs_fs__update_cache_stamp(fs, 0, scratch_pool));
 
   return SVN_NO_ERROR;
 }
@@ -349,10 +356,13 @@ fs_open(svn_fs_t *fs,
         apr_pool_t *common_pool)
 {
   apr_pool_t *subpool = svn_pool_create(scratch_pool);
+  fs_fs_data_t *ffd;
+  svn_revnum_t youngest;
 
   SVN_ERR(svn_fs__check_fs(fs, FALSE));
 
   SVN_ERR(initialize_fs_struct(fs));
+  ffd = fs->fsap_data;
 
   SVN_ERR(svn_fs_fs__open(fs, path, subpool));
 
@@ -360,6 +370,13 @@ fs_open(svn_fs_t *fs,
   SVN_MUTEX__WITH_LOCK(common_pool_lock,
                        fs_serialized_init(fs, common_pool, subpool));
 
+  /* Let the cache load any snapshot data that matches our state. */
+  if (ffd->cache_stamp_root)
+    {
+      SVN_ERR(svn_fs_fs__youngest_rev(&youngest, fs, subpool));
+      SVN_ERR(svn_fs_fs__update_cache_stamp(fs, youngest, subpool));
+    }
+
   svn_pool_destroy(subpool);
 
   return SVN_NO_ERROR;
@@ -454,11 +471,23 @@ fs_verify(svn_fs_t *fs, const char *path,
           void *notify_baton,
           svn_cancel_func_t cancel_func,
           void *cancel_baton,
+          svn_error_t *(*svn_fs_open_)(svn_fs_t **,
+                                       const char *,
+                                       apr_hash_t *,
+                                       apr_pool_t *,
+                                       apr_pool_t *),
           svn_mutex__t *common_pool_lock,
           apr_pool_t *pool,
           apr_pool_t *common_pool)
 {
+  fs_fs_data_t *ffd;
+
   SVN_ERR(fs_open(fs, path, common_pool_lock, pool, common_pool));
+
+  /* The parallel verification opens further instances of FS. */
+  ffd = fs->fsap_data;
+  ffd->svn_fs_open_ = svn_fs_open_;
+
   return svn_fs_fs__verify(fs, start, end, notify_func, notify_baton,
                            cancel_func, cancel_baton, pool);
 }
@@ -115,10 +115,14 @@ extern "C" {
 #define CONFIG_OPTION_BLOCK_SIZE         "block-size"
 #define CONFIG_OPTION_L2P_PAGE_SIZE      "l2p-page-size"
 #define CONFIG_OPTION_P2L_PAGE_SIZE      "p2l-page-size"
+#define CONFIG_OPTION_MEMORY_MAP_REVISION_FILES "memory-map-revision-files"
+#define CONFIG_OPTION_PREFETCH_BLOCKS    "prefetch-blocks"
 #define CONFIG_SECTION_DEBUG             "debug"
 #define CONFIG_OPTION_PACK_AFTER_COMMIT  "pack-after-commit"
 #define CONFIG_OPTION_VERIFY_BEFORE_COMMIT "verify-before-commit"
 #define CONFIG_OPTION_COMPRESSION        "compression"
+#define CONFIG_OPTION_COMPRESSION_THREADS "compression-threads"
+#define CONFIG_OPTION_DELTIFICATION_THREADS "deltification-threads"
 
 /* The format number of this filesystem.
    This is independent of the repository format number, and
@@ -311,11 +315,35 @@ typedef struct window_cache_key_t
   apr_uint64_t item_index;
 } window_cache_key_t;
 
+/* Number of read-ahead ranges that we remember per svn_fs_t to tell
+   prefetch hits from misses. */
+#define SVN_FS_FS__PREFETCH_HISTORY 128
+
+/* A block-aligned section of a committed rev / pack file. */
+typedef struct prefetch_range_t
+{
+  /* First revision in the rev / pack file and whether it is a pack file,
+     i.e. the identity of the file as in svn_fs_fs__revision_file_t. */
+  svn_revnum_t start_revision;
+  svn_boolean_t is_packed;
+
+  /* Section of that file, END being exclusive. */
+  apr_off_t start;
+  apr_off_t end;
+} prefetch_range_t;
+
 typedef enum compression_type_t
 {
   compression_type_none,
   compression_type_zlib,
-  compression_type_lz4
+  compression_type_lz4,
+
+  /* LZ4 with its high compression mode, i.e. still svndiff2. */
+  compression_type_lz4_hc,
+
+  /* Select none, zlib, lz4 or lz4_hc for each representation based on
+   * its contents. */
+  compression_type_auto
 } compression_type_t;
 
 /* Private (non-shared) FSFS-specific data for each svn_fs_t object.
@@ -347,6 +375,33 @@ typedef struct fs_fs_data_t
    * (not just the one bit that we need, atm). */
   svn_boolean_t use_block_read;
 
+  /* If set, read committed rev / pack files through a read-only memory
+   * mapping instead of buffered file I/O, where the platform allows it. */
+  svn_boolean_t mmap_revision_files;
+
+  /* If set and block-read is being used, give the OS read-ahead hints
+   * for rev / pack file blocks that we are likely to read next. */
+  svn_boolean_t prefetch_blocks;
+
+  /* Ring buffer of the most recent read-ahead ranges and the index of the
+   * entry to overwrite next. */
+  prefetch_range_t prefetched[SVN_FS_FS__PREFETCH_HISTORY];
+  int next_prefetched;
+
+  /* Block most recently read from disk.  START is -1 for none. */
+  prefetch_range_t last_block;
+
+  /* Revision of the changed paths list read most recently from disk.
+   * Used to detect the direction of a history traversal. */
+  svn_revnum_t last_changes_revision;
+
+  /* Read-ahead instrumentation: number of ranges handed to the OS as well
+   * as the number of blocks read from disk that had been prefetched (hits)
+   * or not (misses).  See svn_fs_fs__get_prefetch_stats(). */
+  apr_uint64_t prefetch_requests;
+  apr_uint64_t prefetch_hits;
+  apr_uint64_t prefetch_misses;
+
   /* The revision that was youngest, last time we checked. */
   svn_revnum_t youngest_rev_cache;
 
@@ -360,6 +415,11 @@ typedef struct fs_fs_data_t
      e.g. memcached may be ignored as caching is an optional feature. */
   svn_boolean_t fail_stop;
 
+  /* Key prefix shared by all our entries in the membuffer cache.  Used to
+     stamp them with the repository state when saving cache snapshots.
+     NULL if no cache snapshot has been configured. */
+  const char *cache_stamp_root;
+
   /* A cache of revision root IDs, mapping from (svn_revnum_t *) to
      (svn_fs_id_t *).  (Not threadsafe.) */
   svn_cache__t *rev_root_id_cache;
@@ -496,9 +556,18 @@ typedef struct fs_fs_data_t
   /* Compression type to use with txdelta storage format in new revs. */
   compression_type_t delta_compression_type;
 
-  /* Compression level (currently, only used with compression_type_zlib). */
+  /* Compression level (currently, only used with compression_type_zlib
+   * and compression_type_auto, which uses it for zlib). */
   int delta_compression_level;
 
+  /* Maximum number of threads compressing the delta windows of a single
+   * file representation.  1 means no extra threads. */
+  int delta_compression_threads;
+
+  /* Maximum number of threads computing the delta windows of a single
+   * file representation.  1 means no extra threads. */
+  int deltification_threads;
+
   /* Pack after every commit. */
   svn_boolean_t pack_after_commit;
 
@@ -43,6 +43,7 @@
 #include "tree.h"
 #include "util.h"
 
+#include "private/svn_delta_private.h"
 #include "private/svn_fs_util.h"
 #include "private/svn_io_private.h"
 #include "private/svn_string_private.h"
@@ -72,6 +73,11 @@
    Values < 1 disable deltification. */
 #define SVN_FS_FS_MAX_DELTIFICATION_WALK 1023
 
+/* Upper limit for the "compression-threads" and "deltification-threads"
+   settings.  The delta library uses at most that many worker threads
+   across the whole process anyway. */
+#define SVN_FS_FS_MAX_COMPRESSION_THREADS 16
+
 /* Notes:
 
 To avoid opening and closing the rev-files all the time, it would
@@ -692,7 +698,7 @@ parse_compression_option(compression_type_t *compression_type_p,
   int level;
   svn_boolean_t is_valid = TRUE;
 
-  /* compression = none | lz4 | zlib | zlib-1 ... zlib-9 */
+  /* compression = none | lz4 | lz4-hc | zlib | zlib-1 ... zlib-9 | auto */
   if (strcmp(value, "none") == 0)
     {
       type = compression_type_none;
@@ -703,6 +709,16 @@ parse_compression_option(compression_type_t *compression_type_p,
       type = compression_type_lz4;
       level = SVN_DELTA_COMPRESSION_LEVEL_DEFAULT;
     }
+  else if (strcmp(value, "lz4-hc") == 0)
+    {
+      type = compression_type_lz4_hc;
+      level = SVN_DELTA__COMPRESSION_LEVEL_LZ4_HC;
+    }
+  else if (strcmp(value, "auto") == 0)
+    {
+      type = compression_type_auto;
+      level = SVN_DELTA_COMPRESSION_LEVEL_DEFAULT;
+    }
   else if (strncmp(value, "zlib", 4) == 0)
     {
       const char *p = value + 4;
@@ -848,6 +864,20 @@ read_config(fs_fs_data_t *ffd,
       ffd->p2l_page_size = 0x100000;  /* Matches above default in bytes. */
     }
 
+  /* Memory-mapping rev / pack files is opt-in and independent of the
+   * repository format. */
+  SVN_ERR(svn_config_get_bool(config, &ffd->mmap_revision_files,
+                              CONFIG_SECTION_IO,
+                              CONFIG_OPTION_MEMORY_MAP_REVISION_FILES,
+                              FALSE));
+
+  /* Read-ahead hints are only ever given by block-read, i.e. for
+   * format 7+ repositories.  Reading the option never hurts, though. */
+  SVN_ERR(svn_config_get_bool(config, &ffd->prefetch_blocks,
+                              CONFIG_SECTION_IO,
+                              CONFIG_OPTION_PREFETCH_BLOCKS,
+                              FALSE));
+
   if (ffd->format >= SVN_FS_FS__MIN_PACKED_FORMAT)
     {
       SVN_ERR(svn_config_get_bool(config, &ffd->pack_after_commit,
@@ -883,12 +913,14 @@ read_config(fs_fs_data_t *ffd,
           SVN_ERR(parse_compression_option(&ffd->delta_compression_type,
                                            &ffd->delta_compression_level,
                                            compression_val));
-          if (ffd->delta_compression_type == compression_type_lz4 &&
+          if (ffd->delta_compression_type != compression_type_none &&
+              ffd->delta_compression_type != compression_type_zlib &&
               ffd->format < SVN_FS_FS__MIN_SVNDIFF2_FORMAT)
             {
-              return svn_error_create(SVN_ERR_BAD_CONFIG_VALUE, NULL,
-                                      _("Compression type 'lz4' requires "
-                                        "filesystem format 8 or higher"));
+              return svn_error_createf(SVN_ERR_BAD_CONFIG_VALUE, NULL,
+                                       _("Compression type '%s' requires "
+                                         "filesystem format 8 or higher"),
+                                       compression_val);
             }
         }
       else if (compression_level_val)
@@ -925,6 +957,35 @@ read_config(fs_fs_data_t *ffd,
       ffd->delta_compression_level = SVN_DELTA_COMPRESSION_LEVEL_NONE;
     }
 
+  /* Compressing file contents in multiple threads is opt-in. */
+  if (ffd->delta_compression_type != compression_type_none)
+    {
+      apr_int64_t compression_threads;
+
+      SVN_ERR(svn_config_get_int64(config, &compression_threads,
+                                   CONFIG_SECTION_DELTIFICATION,
+                                   CONFIG_OPTION_COMPRESSION_THREADS, 1));
+      ffd->delta_compression_threads
+        = (int)MIN(MAX(1, compression_threads),
+                   SVN_FS_FS_MAX_COMPRESSION_THREADS);
+    }
+  else
+    {
+      ffd->delta_compression_threads = 1;
+    }
+
+  /* Likewise for computing the deltas themselves. */
+  {
+    apr_int64_t deltification_threads;
+
+    SVN_ERR(svn_config_get_int64(config, &deltification_threads,
+                                 CONFIG_SECTION_DELTIFICATION,
+                                 CONFIG_OPTION_DELTIFICATION_THREADS, 1));
+    ffd->deltification_threads
+      = (int)MIN(MAX(1, deltification_threads),
+                 SVN_FS_FS_MAX_COMPRESSION_THREADS);
+  }
+
 #ifdef SVN_DEBUG
   SVN_ERR(svn_config_get_bool(config, &ffd->verify_before_commit,
                               CONFIG_SECTION_DEBUG,
@@ -1066,8 +1127,15 @@ write_config(svn_fs_t *fs,
 "### significantly speed up commits as well as reading the data."            NL
 "### lz4 compression algorithm is supported, starting from format 8"         NL
 "### repositories, available in Subversion 1.10 and higher."                 NL
+"### lz4-hc produces the same format as lz4 at a better compression ratio"   NL
+"### but compresses more slowly.  Reading the data is as fast as with lz4."  NL
+"### auto selects the algorithm for each file individually:  Data that does" NL
+"### not compress well, e.g. archives or media files, gets stored without"   NL
+"### compression, text uses zlib and other binary data lz4-hc."              NL
+"### lz4-hc and auto require format 8 repositories.  Subversion 1.10 can"   NL
+"### read the data they produce but does not accept these values here."      NL
 "### The syntax of this option is:"                                          NL
-"###   " CONFIG_OPTION_COMPRESSION " = none | lz4 | zlib | zlib-1 ... zlib-9" NL
+"###   " CONFIG_OPTION_COMPRESSION " = none | lz4 | lz4-hc | zlib | zlib-1 ... zlib-9 | auto" NL
 "### Versions prior to Subversion 1.10 will ignore this option."             NL
 "### The default value is 'lz4' if supported by the repository format and"   NL
 "### 'zlib' otherwise.  'zlib' is currently equivalent to 'zlib-5'."         NL
@@ -1079,6 +1147,26 @@ write_config(svn_fs_t *fs,
 "### still be used (and it will result in zlib compression with the"         NL
 "### corresponding compression level)."                                      NL
 "###   " CONFIG_OPTION_COMPRESSION_LEVEL " = 0 ... 9 (default is 5)"         NL
+"###"                                                                        NL
+"### Compressing large files can take considerably longer than writing"      NL
+"### them to disk, in particular with zlib.  This setting allows up to the"  NL
+"### given number of threads to compress the data of a single file in"       NL
+"### parallel.  The data written to the repository does not change.  Higher" NL
+"### values speed up commits and 'svnadmin load' of large files at the"      NL
+"### expense of CPU load on the server.  Values are limited to 1 ... 16."    NL
+"### Versions prior to Subversion 1.11 will ignore this option."             NL
+"### The default value is 1, i.e. no extra threads are being used."          NL
+"# " CONFIG_OPTION_COMPRESSION_THREADS " = 1"                                NL
+"###"                                                                        NL
+"### Computing the delta of a large file against its predecessor can"        NL
+"### take a lot of CPU time as well.  This setting allows up to the given"   NL
+"### number of threads to compute the delta windows of a single file in"     NL
+"### parallel, both when storing new file contents and when reading"         NL
+"### deltas, e.g. in 'svnadmin dump --deltas'.  The data being written or"   NL
+"### sent does not change.  Values are limited to 1 ... 16."                 NL
+"### Versions prior to Subversion 1.11 will ignore this option."             NL
+"### The default value is 1, i.e. no extra threads are being used."          NL
+"# " CONFIG_OPTION_DELTIFICATION_THREADS " = 1"                              NL
 ""                                                                           NL
 "[" CONFIG_SECTION_PACKED_REVPROPS "]"                                       NL
 "### This parameter controls the size (in kBytes) of packed revprop files."  NL
@@ -1147,6 +1235,28 @@ write_config(svn_fs_t *fs,
 "### Must be a power of 2."                                                  NL
 "### p2l-page-size is given in kBytes and with a default of 1024 kBytes."    NL
 "# " CONFIG_OPTION_P2L_PAGE_SIZE " = 1024"                                   NL
+"###"                                                                        NL
+"### Committed revision and pack files may be read through read-only memory" NL
+"### mappings instead of buffered file I/O.  This avoids most read() system" NL
+"### calls as well as re-reading whole blocks for small items and lets the"  NL
+"### OS page cache serve the data directly.  It is most effective for large,"NL
+"### packed repositories on 64 bit systems.  Files that cannot be mapped"    NL
+"### will silently be read the traditional way.  Do not enable this if rev"  NL
+"### and pack files may get truncated or rewritten while being read, e.g. by"NL
+"### 'svnadmin load-index' on a network file system shared between servers." NL
+"### This applies to all repository formats and is disabled by default."     NL
+"# " CONFIG_OPTION_MEMORY_MAP_REVISION_FILES " = false"                      NL
+"###"                                                                        NL
+"### When reading data in 'block-read' mode (see svnserve --block-read),"    NL
+"### FSFS may use the log-to-phys index to tell the OS which blocks of the"  NL
+"### rev and pack files the current operation is likely to read next:  the"  NL
+"### delta windows of a representation, the node-revisions of directory"     NL
+"### entries and the changed paths list of the next revision in a history"   NL
+"### walk.  The OS then reads them asynchronously.  This helps with cold"    NL
+"### caches and high-latency storage but only adds overhead if the data"     NL
+"### usually resides in the OS file cache already.  This setting only"       NL
+"### applies to format 7+ repositories and is disabled by default."          NL
+"# " CONFIG_OPTION_PREFETCH_BLOCKS " = false"                                NL
 ""                                                                           NL
 "[" CONFIG_SECTION_DEBUG "]"                                                 NL
 "###"                                                                        NL
@@ -1450,6 +1560,9 @@ svn_fs_fs__youngest_rev(svn_revnum_t *youngest_p,
   fs_fs_data_t *ffd = fs->fsap_data;
 
   SVN_ERR(get_youngest(youngest_p, fs, pool));
+  if (ffd->cache_stamp_root && ffd->youngest_rev_cache != *youngest_p)
+    SVN_ERR(svn_fs_fs__update_cache_stamp(fs, *youngest_p, pool));
+
   ffd->youngest_rev_cache = *youngest_p;
 
   return SVN_NO_ERROR;
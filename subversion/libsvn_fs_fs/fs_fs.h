@@ -288,6 +288,15 @@ svn_fs_fs__get_node_origin(const svn_fs_id_t **origin_id,
 svn_error_t *
 svn_fs_fs__initialize_caches(svn_fs_t *fs, apr_pool_t *pool);
 
+/* Tell the membuffer cache that the data cached for FS is valid for a
+   repository whose youngest revision is YOUNGEST.  This allows entries
+   from cache snapshots to be loaded and new snapshots to include our
+   entries.  Use SCRATCH_POOL for temporary allocations. */
+svn_error_t *
+svn_fs_fs__update_cache_stamp(svn_fs_t *fs,
+                              svn_revnum_t youngest,
+                              apr_pool_t *scratch_pool);
+
 /* Initialize all transaction-local caches in FS according to the global
    cache settings and make TXN_ID part of their key space. Use POOL for
    allocations.
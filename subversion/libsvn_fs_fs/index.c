@@ -3134,6 +3134,62 @@ calc_fnv1(svn_fs_fs__p2l_entry_t *entry,
   return SVN_NO_ERROR;
 }
 
+/* Items up to this size get checksummed in batches by calc_fnv1_batch. */
+#define FNV1_BATCH_ITEM_SIZE 4096
+
+/* Maximum number of items per batch in calc_fnv1_batch. */
+#define FNV1_BATCH_SIZE 8
+
+/* Return TRUE, if the checksum for ENTRY may be calculated by
+ * calc_fnv1_batch. */
+static svn_boolean_t
+fnv1_batchable(const svn_fs_fs__p2l_entry_t *entry)
+{
+  return entry->type != SVN_FS_FS__ITEM_TYPE_UNUSED
+      && entry->size <= FNV1_BATCH_ITEM_SIZE;
+}
+
+/* Like calc_fnv1 but for the COUNT entries starting at index FIRST in
+ * ENTRIES, which is an array of svn_fs_fs__p2l_entry_t *.  COUNT must not
+ * exceed FNV1_BATCH_SIZE and all entries must be fnv1_batchable.  BUFFER
+ * must provide FNV1_BATCH_SIZE * FNV1_BATCH_ITEM_SIZE bytes.
+ * Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+calc_fnv1_batch(apr_array_header_t *entries,
+                int first,
+                int count,
+                unsigned char *buffer,
+                svn_fs_fs__revision_file_t *rev_file,
+                apr_pool_t *scratch_pool)
+{
+  const void *data[FNV1_BATCH_SIZE];
+  apr_size_t lens[FNV1_BATCH_SIZE];
+  apr_uint32_t checksums[FNV1_BATCH_SIZE];
+  int i;
+
+  for (i = 0; i < count; ++i)
+    {
+      svn_fs_fs__p2l_entry_t *entry
+        = APR_ARRAY_IDX(entries, first + i, svn_fs_fs__p2l_entry_t *);
+
+      data[i] = buffer + i * FNV1_BATCH_ITEM_SIZE;
+      lens[i] = (apr_size_t)entry->size;
+
+      SVN_ERR(svn_io_file_seek(rev_file->file, APR_SET, &entry->offset,
+                               scratch_pool));
+      SVN_ERR(svn_io_file_read_full2(rev_file->file,
+                                     buffer + i * FNV1_BATCH_ITEM_SIZE,
+                                     lens[i], NULL, NULL, scratch_pool));
+    }
+
+  svn__fnv1a_32x4_multi(checksums, data, lens, count);
+  for (i = 0; i < count; ++i)
+    APR_ARRAY_IDX(entries, first + i, svn_fs_fs__p2l_entry_t *)
+      ->fnv1_checksum = checksums[i];
+
+  return SVN_NO_ERROR;
+}
+
 /*
  * Index (re-)creation utilities.
  */
@@ -3151,6 +3207,8 @@ svn_fs_fs__p2l_index_from_p2l_entries(const char **protoname,
   /* Use a subpool for immediate temp file cleanup at the end of this
    * function. */
   apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  unsigned char *buffer
+    = apr_palloc(scratch_pool, FNV1_BATCH_SIZE * FNV1_BATCH_ITEM_SIZE);
   int i;
 
   /* Create a proto-index file. */
@@ -3160,16 +3218,39 @@ svn_fs_fs__p2l_index_from_p2l_entries(const char **protoname,
   SVN_ERR(svn_fs_fs__p2l_proto_index_open(&proto_index, *protoname,
                                           scratch_pool));
 
-  /* Write ENTRIES to proto-index file and calculate checksums as we go. */
-  for (i = 0; i < entries->nelts; ++i)
+  /* Write ENTRIES to proto-index file and calculate checksums as we go.
+   * Runs of small items get checksummed in batches. */
+  for (i = 0; i < entries->nelts; )
     {
-      svn_fs_fs__p2l_entry_t *entry
-        = APR_ARRAY_IDX(entries, i, svn_fs_fs__p2l_entry_t *);
+      int count = 0;
+      int k;
       svn_pool_clear(iterpool);
 
-      SVN_ERR(calc_fnv1(entry, rev_file, iterpool));
-      SVN_ERR(svn_fs_fs__p2l_proto_index_add_entry(proto_index, entry,
-                                                   iterpool));
+      while (   i + count < entries->nelts
+             && count < FNV1_BATCH_SIZE
+             && fnv1_batchable(APR_ARRAY_IDX(entries, i + count,
+                                             svn_fs_fs__p2l_entry_t *)))
+        ++count;
+
+      if (count)
+        {
+          SVN_ERR(calc_fnv1_batch(entries, i, count, buffer, rev_file,
+                                  iterpool));
+        }
+      else
+        {
+          SVN_ERR(calc_fnv1(APR_ARRAY_IDX(entries, i,
+                                          svn_fs_fs__p2l_entry_t *),
+                            rev_file, iterpool));
+          count = 1;
+        }
+
+      for (k = 0; k < count; ++k)
+        SVN_ERR(svn_fs_fs__p2l_proto_index_add_entry(proto_index,
+                  APR_ARRAY_IDX(entries, i + k, svn_fs_fs__p2l_entry_t *),
+                  iterpool));
+
+      i += count;
     }
 
   /* Convert proto-index into final index and move it into position.
@@ -20,6 +20,10 @@
  * ====================================================================
  */
 
+#include <string.h>
+#include <apr_mmap.h>
+#include <apr_portable.h>
+
 #include "rev_file.h"
 #include "fs_fs.h"
 #include "index.h"
@@ -28,9 +32,25 @@
 
 #include "../libsvn_fs/fs-loader.h"
 
+#include "svn_dirent_uri.h"
+#include "svn_sorts.h"
+
 #include "private/svn_io_private.h"
 #include "svn_private_config.h"
 
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#if HAVE_POSIX_FADVISE
+#include <fcntl.h>
+#endif
+
+/* Minimum granularity in bytes of the prefetch hints that we give for
+ * memory-mapped rev / pack files.  This is a multiple of all common page
+ * sizes and keeps the number of hints low if the block size is small. */
+#define MIN_PREFETCH_SIZE 0x10000
+
 /* Initialize the *FILE structure for REVISION in filesystem FS.  Set its
  * pool member to the provided POOL. */
 static void
@@ -54,9 +74,179 @@ init_revision_file(svn_fs_fs__revision_file_t *file,
   file->p2l_offset = -1;
   file->p2l_checksum = NULL;
   file->footer_offset = -1;
+  file->mmap = NULL;
+  file->mapped_data = NULL;
+  file->mapped_size = 0;
+  file->mapped_offset = 0;
+  file->prefetch_start = 0;
+  file->prefetch_end = 0;
+  file->mapped_stream = NULL;
   file->pool = pool;
 }
 
+/* Hint the OS that we are about to read the memory-mapped contents of
+ * FILE between offsets START and END.  Like buffered I/O would, extend
+ * that range to whole blocks.  Hints that have just been given are not
+ * being repeated.  Failures are ignored as this is only an optimization.
+ */
+static void
+prefetch_mapped_data(svn_fs_fs__revision_file_t *file,
+                     apr_off_t start,
+                     apr_off_t end)
+{
+#if HAVE_SYS_MMAN_H && HAVE_POSIX_MADVISE
+  apr_off_t granularity = MAX(file->block_size, MIN_PREFETCH_SIZE);
+
+  end = MIN(end, file->mapped_size);
+  if (   (start >= file->prefetch_start && end <= file->prefetch_end)
+      || start >= end)
+    return;
+
+  start -= start % granularity;
+  end += granularity - 1;
+  end = MIN(end - end % granularity, file->mapped_size);
+
+  /* The mapping itself is page-aligned and so is START. */
+  (void)posix_madvise((void *)(file->mapped_data + start),
+                      (size_t)(end - start), POSIX_MADV_WILLNEED);
+
+  file->prefetch_start = start;
+  file->prefetch_end = end;
+#endif
+}
+
+/* Return the number of bytes in the mapping of FILE that follow the
+ * current read position. */
+static apr_size_t
+mapped_remainder(svn_fs_fs__revision_file_t *file)
+{
+  return file->mapped_offset < file->mapped_size
+       ? (apr_size_t)(file->mapped_size - file->mapped_offset)
+       : 0;
+}
+
+/* Implements svn_read_fn_t for FILE->MAPPED_STREAM.  BATON is the
+ * svn_fs_fs__revision_file_t. */
+static svn_error_t *
+mapped_stream_read(void *baton,
+                   char *buffer,
+                   apr_size_t *len)
+{
+  svn_fs_fs__revision_file_t *file = baton;
+
+  *len = MIN(*len, mapped_remainder(file));
+  if (*len == 0)
+    return SVN_NO_ERROR;
+
+  prefetch_mapped_data(file, file->mapped_offset,
+                       file->mapped_offset + *len);
+
+  memcpy(buffer, file->mapped_data + file->mapped_offset, *len);
+  file->mapped_offset += *len;
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_stream_skip_fn_t for FILE->MAPPED_STREAM.  BATON is the
+ * svn_fs_fs__revision_file_t. */
+static svn_error_t *
+mapped_stream_skip(void *baton,
+                   apr_size_t len)
+{
+  svn_fs_fs__revision_file_t *file = baton;
+  file->mapped_offset += MIN(len, mapped_remainder(file));
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_stream_readline_fn_t for FILE->MAPPED_STREAM.  BATON is
+ * the svn_fs_fs__revision_file_t.  Unlike the default implementation,
+ * this does not read byte by byte but scans the mapped data directly. */
+static svn_error_t *
+mapped_stream_readline(void *baton,
+                       svn_stringbuf_t **stringbuf,
+                       const char *eol,
+                       svn_boolean_t *eof,
+                       apr_pool_t *pool)
+{
+  svn_fs_fs__revision_file_t *file = baton;
+  apr_size_t eol_len = strlen(eol);
+  const char *start = file->mapped_data + file->mapped_offset;
+  const char *end = start + mapped_remainder(file);
+  const char *match = start;
+
+  prefetch_mapped_data(file, file->mapped_offset, file->mapped_offset + 1);
+
+  /* Find the first occurrence of EOL. */
+  while ((match = memchr(match, eol[0], end - match)) != NULL)
+    {
+      if (   (apr_size_t)(end - match) >= eol_len
+          && memcmp(match, eol, eol_len) == 0)
+        break;
+
+      ++match;
+    }
+
+  /* Return the line without the EOL and move behind it.  Without EOL,
+   * return everything up to the end of the file. */
+  *eof = match == NULL;
+  if (*eof)
+    match = end;
+
+  *stringbuf = svn_stringbuf_ncreate(start, match - start, pool);
+  file->mapped_offset += (match - start) + (*eof ? 0 : eol_len);
+
+  return SVN_NO_ERROR;
+}
+
+/* Try to map the whole FILE->FILE into memory.  Rev and pack files that
+ * can't be mapped will simply continue to be read through FILE->FILE.
+ * Use SCRATCH_POOL for temporary allocations.
+ */
+static svn_error_t *
+map_revision_file(svn_fs_fs__revision_file_t *file,
+                  apr_pool_t *scratch_pool)
+{
+#if APR_HAS_MMAP
+  apr_finfo_t finfo;
+  apr_mmap_t *mmap;
+
+  SVN_ERR(svn_io_file_info_get(&finfo, APR_FINFO_SIZE, file->file,
+                               scratch_pool));
+
+  /* Empty files can't be mapped.  Also, limit the address space that we
+   * tie up for a single file on 32 bit systems. */
+  if (finfo.size == 0 || finfo.size > APR_SIZE_MAX / 8)
+    return SVN_NO_ERROR;
+
+  if (apr_mmap_create(&mmap, file->file, 0, (apr_size_t)finfo.size,
+                      APR_MMAP_READ, file->pool) != APR_SUCCESS)
+    return SVN_NO_ERROR;
+
+  file->mmap = mmap;
+  file->mapped_data = mmap->mm;
+  file->mapped_size = finfo.size;
+  file->mapped_offset = 0;
+  file->prefetch_start = 0;
+  file->prefetch_end = 0;
+
+  file->mapped_stream = svn_stream_create(file, file->pool);
+  svn_stream_set_read2(file->mapped_stream, mapped_stream_read,
+                       mapped_stream_read);
+  svn_stream_set_skip(file->mapped_stream, mapped_stream_skip);
+  svn_stream_set_readline(file->mapped_stream, mapped_stream_readline);
+
+#if HAVE_SYS_MMAN_H && HAVE_POSIX_MADVISE
+  /* We read items at offsets taken from the indexes and give explicit
+   * hints for the blocks that we are going to access.  Avoid any extra
+   * read-ahead by the OS around page faults. */
+  (void)posix_madvise(mmap->mm, (size_t)finfo.size, POSIX_MADV_RANDOM);
+#endif
+#endif
+
+  return SVN_NO_ERROR;
+}
+
 /* Baton type for set_read_only() */
 typedef struct set_read_only_baton_t
 {
@@ -206,11 +396,19 @@ svn_fs_fs__open_pack_or_rev_file(svn_fs_fs__revision_file_t **file,
                                  apr_pool_t *result_pool,
                                  apr_pool_t *scratch_pool)
 {
+  fs_fs_data_t *ffd = fs->fsap_data;
+
   *file = apr_palloc(result_pool, sizeof(**file));
   init_revision_file(*file, fs, rev, result_pool);
 
-  return svn_error_trace(open_pack_or_rev_file(*file, fs, rev, FALSE,
-                                               result_pool, scratch_pool));
+  SVN_ERR(open_pack_or_rev_file(*file, fs, rev, FALSE, result_pool,
+                                scratch_pool));
+
+  /* Committed rev and pack files are immutable, i.e. safe to map. */
+  if (ffd->mmap_revision_files)
+    SVN_ERR(map_revision_file(*file, scratch_pool));
+
+  return SVN_NO_ERROR;
 }
 
 svn_error_t *
@@ -274,6 +472,7 @@ svn_fs_fs__open_proto_rev_file(svn_fs_fs__revision_file_t **file,
                                apr_pool_t* result_pool,
                                apr_pool_t *scratch_pool)
 {
+  fs_fs_data_t *ffd = fs->fsap_data;
   apr_file_t *apr_file;
   SVN_ERR(svn_io_file_open(&apr_file,
                            svn_fs_fs__path_txn_proto_rev(fs, txn_id,
@@ -286,13 +485,122 @@ svn_fs_fs__open_proto_rev_file(svn_fs_fs__revision_file_t **file,
   (*file)->is_packed = FALSE;
   (*file)->start_revision = SVN_INVALID_REVNUM;
   (*file)->stream = svn_stream_from_aprfile2(apr_file, TRUE, result_pool);
+  (*file)->block_size = ffd->block_size;
+
+  return SVN_NO_ERROR;
+}
+
+svn_error_t *
+svn_fs_fs__rev_file_seek(svn_fs_fs__revision_file_t *file,
+                         apr_off_t *buffer_start,
+                         apr_off_t offset,
+                         apr_pool_t *scratch_pool)
+{
+  if (file->mmap == NULL)
+    return svn_error_trace(svn_io_file_aligned_seek(file->file,
+                                                    file->block_size,
+                                                    buffer_start, offset,
+                                                    scratch_pool));
+
+  if (buffer_start)
+    *buffer_start = offset - (offset % file->block_size);
+
+  file->mapped_offset = offset;
+  prefetch_mapped_data(file, offset, offset + 1);
+
+  return SVN_NO_ERROR;
+}
+
+svn_error_t *
+svn_fs_fs__rev_file_offset(apr_off_t *offset,
+                           svn_fs_fs__revision_file_t *file,
+                           apr_pool_t *scratch_pool)
+{
+  if (file->mmap == NULL)
+    return svn_error_trace(svn_io_file_get_offset(offset, file->file,
+                                                  scratch_pool));
+
+  *offset = file->mapped_offset;
+
+  return SVN_NO_ERROR;
+}
+
+svn_error_t *
+svn_fs_fs__rev_file_read(svn_fs_fs__revision_file_t *file,
+                         void *buf,
+                         apr_size_t nbytes,
+                         apr_size_t *bytes_read,
+                         apr_pool_t *scratch_pool)
+{
+  if (file->mmap == NULL)
+    return svn_error_trace(svn_io_file_read_full2(file->file, buf, nbytes,
+                                                  bytes_read, NULL,
+                                                  scratch_pool));
+
+  /* Reading beyond EOF is an error, just as with svn_io_file_read_full2. */
+  if (nbytes > mapped_remainder(file))
+    {
+      const char *name;
+      SVN_ERR(svn_io_file_name_get(&name, file->file, scratch_pool));
+
+      return svn_error_wrap_apr(APR_EOF, _("Can't read file '%s'"),
+                                svn_dirent_local_style(name, scratch_pool));
+    }
+
+  prefetch_mapped_data(file, file->mapped_offset,
+                       file->mapped_offset + nbytes);
+  memcpy(buf, file->mapped_data + file->mapped_offset, nbytes);
+  file->mapped_offset += nbytes;
+
+  if (bytes_read)
+    *bytes_read = nbytes;
 
   return SVN_NO_ERROR;
 }
 
+svn_boolean_t
+svn_fs_fs__rev_file_prefetch(svn_fs_fs__revision_file_t *file,
+                             apr_off_t start,
+                             apr_off_t end)
+{
+  if (file->mmap)
+    {
+#if HAVE_SYS_MMAN_H && HAVE_POSIX_MADVISE
+      prefetch_mapped_data(file, start, end);
+      return TRUE;
+#endif
+    }
+  else
+    {
+#if HAVE_POSIX_FADVISE
+      apr_os_file_t fd;
+      if (   apr_os_file_get(&fd, file->file) == APR_SUCCESS
+          && posix_fadvise(fd, start, end - start, POSIX_FADV_WILLNEED) == 0)
+        return TRUE;
+#endif
+    }
+
+  return FALSE;
+}
+
+svn_stream_t *
+svn_fs_fs__rev_file_stream(svn_fs_fs__revision_file_t *file)
+{
+  return file->mapped_stream ? file->mapped_stream : file->stream;
+}
+
 svn_error_t *
 svn_fs_fs__close_revision_file(svn_fs_fs__revision_file_t *file)
 {
+#if APR_HAS_MMAP
+  if (file->mmap)
+    {
+      apr_status_t status = apr_mmap_delete(file->mmap);
+      if (status)
+        return svn_error_wrap_apr(status, _("Failed to delete mmap"));
+    }
+#endif
+
   if (file->stream)
     SVN_ERR(svn_stream_close(file->stream));
   if (file->file)
@@ -302,6 +610,9 @@ svn_fs_fs__close_revision_file(svn_fs_fs__revision_file_t *file)
   file->stream = NULL;
   file->l2p_stream = NULL;
   file->p2l_stream = NULL;
+  file->mmap = NULL;
+  file->mapped_data = NULL;
+  file->mapped_stream = NULL;
 
   return SVN_NO_ERROR;
 }
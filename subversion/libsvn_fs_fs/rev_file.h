@@ -90,6 +90,29 @@ typedef struct svn_fs_fs__revision_file_t
    * been called, yet. */
   apr_off_t footer_offset;
 
+  /* Read-only memory mapping of the whole FILE or NULL if FILE is being
+   * read through buffered I/O.  Never set for txn proto-rev files or files
+   * opened for writing.  Use the svn_fs_fs__rev_file_* functions below to
+   * read the rev / pack file contents independently of this. */
+  struct apr_mmap_t *mmap;
+
+  /* Start and length of the mapped data.  Only valid if MMAP is not NULL. */
+  const char *mapped_data;
+  apr_off_t mapped_size;
+
+  /* Current read position within MAPPED_DATA.  This is independent from
+   * FILE's file pointer.  Only valid if MMAP is not NULL. */
+  apr_off_t mapped_offset;
+
+  /* Block-aligned range that we most recently asked the OS to prefetch.
+   * Only valid if MMAP is not NULL. */
+  apr_off_t prefetch_start;
+  apr_off_t prefetch_end;
+
+  /* Stream reading from MAPPED_DATA at MAPPED_OFFSET.  Not NULL exactly
+   * when MMAP is not NULL. */
+  svn_stream_t *mapped_stream;
+
   /* pool containing this object */
   apr_pool_t *pool;
 } svn_fs_fs__revision_file_t;
@@ -137,6 +160,52 @@ svn_fs_fs__open_proto_rev_file(svn_fs_fs__revision_file_t **file,
                                apr_pool_t* result_pool,
                                apr_pool_t *scratch_pool);
 
+/* Position the read pointer of FILE at OFFSET for the next call to
+ * svn_fs_fs__rev_file_read or svn_fs_fs__rev_file_stream.  If BUFFER_START
+ * is not NULL, set it to the block-aligned start of the buffer that
+ * contains OFFSET, like svn_io_file_aligned_seek would do.  Use
+ * SCRATCH_POOL for temporary allocations.
+ */
+svn_error_t *
+svn_fs_fs__rev_file_seek(svn_fs_fs__revision_file_t *file,
+                         apr_off_t *buffer_start,
+                         apr_off_t offset,
+                         apr_pool_t *scratch_pool);
+
+/* Return the current position of FILE's read pointer in *OFFSET.
+ * Use SCRATCH_POOL for temporary allocations.
+ */
+svn_error_t *
+svn_fs_fs__rev_file_offset(apr_off_t *offset,
+                           svn_fs_fs__revision_file_t *file,
+                           apr_pool_t *scratch_pool);
+
+/* Read NBYTES from FILE's current read position into BUF, with the same
+ * semantics as svn_io_file_read_full2 without the HIT_EOF parameter.
+ * Use SCRATCH_POOL for temporary allocations.
+ */
+svn_error_t *
+svn_fs_fs__rev_file_read(svn_fs_fs__revision_file_t *file,
+                         void *buf,
+                         apr_size_t nbytes,
+                         apr_size_t *bytes_read,
+                         apr_pool_t *scratch_pool);
+
+/* Ask the OS to asynchronously read the section [START, END) of FILE
+ * into its cache, such that later reads of it do not block on I/O.
+ * Return TRUE if such a hint could be given on this platform.
+ */
+svn_boolean_t
+svn_fs_fs__rev_file_prefetch(svn_fs_fs__revision_file_t *file,
+                             apr_off_t start,
+                             apr_off_t end);
+
+/* Return a stream reading from FILE's current read position.  Unless FILE
+ * has been memory-mapped, this is FILE->STREAM.
+ */
+svn_stream_t *
+svn_fs_fs__rev_file_stream(svn_fs_fs__revision_file_t *file);
+
 /* Close all files and streams in FILE.
  */
 svn_error_t *
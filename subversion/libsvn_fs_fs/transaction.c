@@ -43,6 +43,7 @@
 #include "lock.h"
 #include "rep-cache.h"
 
+#include "private/svn_delta_private.h"
 #include "private/svn_fs_util.h"
 #include "private/svn_fspath.h"
 #include "private/svn_sorts_private.h"
@@ -1935,8 +1936,8 @@ struct rep_write_baton
      writing to it. */
   void *lockcookie;
 
-  svn_checksum_ctx_t *md5_checksum_ctx;
-  svn_checksum_ctx_t *sha1_checksum_ctx;
+  /* MD5 and SHA-1 checksums over the fulltext, calculated in one pass. */
+  svn_checksum__md5_sha1_ctx_t *checksum_ctx;
 
   /* calculate a modified FNV-1a checksum of the on-disk representation */
   svn_checksum_ctx_t *fnv1a_checksum_ctx;
@@ -1958,8 +1959,7 @@ rep_write_contents(void *baton,
 {
   struct rep_write_baton *b = baton;
 
-  SVN_ERR(svn_checksum_update(b->md5_checksum_ctx, data, *len));
-  SVN_ERR(svn_checksum_update(b->sha1_checksum_ctx, data, *len));
+  svn_checksum__md5_sha1_update(b->checksum_ctx, data, *len);
   b->rep_size += *len;
 
   /* If we are writing a delta, use that stream. */
@@ -2159,17 +2159,33 @@ rep_write_cleanup(void *data)
   return APR_SUCCESS;
 }
 
-static void
+/* Set *HANDLER and *HANDLER_BATON to an svndiff encoder writing to OUTPUT
+   using the compression settings of FS.  If PARALLEL is set, compress the
+   windows in as many threads as configured for FS.  Allocate the encoder
+   in POOL. */
+static svn_error_t *
 txdelta_to_svndiff(svn_txdelta_window_handler_t *handler,
                    void **handler_baton,
                    svn_stream_t *output,
                    svn_fs_t *fs,
+                   svn_boolean_t parallel,
                    apr_pool_t *pool)
 {
   fs_fs_data_t *ffd = fs->fsap_data;
   int svndiff_version;
+  int max_threads = parallel ? ffd->delta_compression_threads : 1;
 
-  if (ffd->delta_compression_type == compression_type_lz4)
+  if (ffd->delta_compression_type == compression_type_auto)
+    {
+      /* The encoder selects the svndiff version per representation. */
+      SVN_ERR_ASSERT_NO_RETURN(ffd->format >= SVN_FS_FS__MIN_SVNDIFF2_FORMAT);
+      svn_txdelta__to_svndiff_adaptive(handler, handler_baton, output,
+                                       ffd->delta_compression_level,
+                                       max_threads, pool);
+      return SVN_NO_ERROR;
+    }
+  else if (ffd->delta_compression_type == compression_type_lz4
+           || ffd->delta_compression_type == compression_type_lz4_hc)
     {
       SVN_ERR_ASSERT_NO_RETURN(ffd->format >= SVN_FS_FS__MIN_SVNDIFF2_FORMAT);
       svndiff_version = 2;
@@ -2184,8 +2200,10 @@ txdelta_to_svndiff(svn_txdelta_window_handler_t *handler,
       svndiff_version = 0;
     }
 
-  svn_txdelta_to_svndiff3(handler, handler_baton, output, svndiff_version,
-                          ffd->delta_compression_level, pool);
+  return svn_error_trace(svn_txdelta__to_svndiff_parallel(
+                           handler, handler_baton, output, svndiff_version,
+                           ffd->delta_compression_level, max_threads,
+                           pool));
 }
 
 /* Get a rep_write_baton and store it in *WB_P for the representation
@@ -2198,6 +2216,7 @@ rep_write_get_baton(struct rep_write_baton **wb_p,
                     node_revision_t *noderev,
                     apr_pool_t *pool)
 {
+  fs_fs_data_t *ffd = fs->fsap_data;
   struct rep_write_baton *b;
   apr_file_t *file;
   representation_t *base_rep;
@@ -2208,8 +2227,7 @@ rep_write_get_baton(struct rep_write_baton **wb_p,
 
   b = apr_pcalloc(pool, sizeof(*b));
 
-  b->sha1_checksum_ctx = svn_checksum_ctx_create(svn_checksum_sha1, pool);
-  b->md5_checksum_ctx = svn_checksum_ctx_create(svn_checksum_md5, pool);
+  b->checksum_ctx = svn_checksum__md5_sha1_ctx_create(pool);
 
   b->fs = fs;
   b->result_pool = pool;
@@ -2259,10 +2277,12 @@ rep_write_get_baton(struct rep_write_baton **wb_p,
                             apr_pool_cleanup_null);
 
   /* Prepare to write the svndiff data. */
-  txdelta_to_svndiff(&wh, &whb, b->rep_stream, fs, pool);
+  SVN_ERR(txdelta_to_svndiff(&wh, &whb, b->rep_stream, fs, TRUE, pool));
 
-  b->delta_stream = svn_txdelta_target_push(wh, whb, source,
-                                            b->scratch_pool);
+  SVN_ERR(svn_txdelta__target_push_parallel(&b->delta_stream, wh, whb,
+                                            source,
+                                            ffd->deltification_threads,
+                                            b->scratch_pool));
 
   *wb_p = b;
 
@@ -2516,6 +2536,8 @@ rep_write_contents_close(void *baton)
   struct rep_write_baton *b = baton;
   representation_t *rep;
   representation_t *old_rep;
+  svn_checksum_t *md5_checksum;
+  svn_checksum_t *sha1_checksum;
   apr_off_t offset;
 
   rep = apr_pcalloc(b->result_pool, sizeof(*rep));
@@ -2535,9 +2557,14 @@ rep_write_contents_close(void *baton)
   SVN_ERR(set_uniquifier(b->fs, rep, b->scratch_pool));
   rep->revision = SVN_INVALID_REVNUM;
 
-  /* Finalize the checksum. */
-  SVN_ERR(digests_final(rep, b->md5_checksum_ctx, b->sha1_checksum_ctx,
-                        b->result_pool));
+  /* Finalize the checksums. */
+  svn_checksum__md5_sha1_final(&md5_checksum, &sha1_checksum,
+                               b->checksum_ctx, b->scratch_pool);
+  memcpy(rep->md5_digest, md5_checksum->digest,
+         svn_checksum_size(md5_checksum));
+  memcpy(rep->sha1_digest, sha1_checksum->digest,
+         svn_checksum_size(sha1_checksum));
+  rep->has_sha1 = TRUE;
 
   /* Check and see if we already have a representation somewhere that's
      identical to the one we just wrote out. */
@@ -2947,7 +2974,8 @@ write_container_delta_rep(representation_t *rep,
   SVN_ERR(svn_io_file_get_offset(&delta_start, file, scratch_pool));
 
   /* Prepare to write the svndiff data. */
-  txdelta_to_svndiff(&diff_wh, &diff_whb, file_stream, fs, scratch_pool);
+  SVN_ERR(txdelta_to_svndiff(&diff_wh, &diff_whb, file_stream, fs, FALSE,
+                             scratch_pool));
 
   whb = apr_pcalloc(scratch_pool, sizeof(*whb));
   whb->stream = svn_txdelta_target_push(diff_wh, diff_whb, source,
@@ -3924,6 +3952,8 @@ commit_body(void *baton, apr_pool_t *pool)
   *cb->new_rev_p = new_rev;
 
   ffd->youngest_rev_cache = new_rev;
+  if (ffd->cache_stamp_root)
+    SVN_ERR(svn_fs_fs__update_cache_stamp(cb->fs, new_rev, pool));
 
   /* Make the directory contents alreday cached for the new revision
    * visible. */
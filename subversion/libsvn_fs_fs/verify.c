@@ -23,6 +23,9 @@
 #include "svn_sorts.h"
 #include "svn_checksum.h"
 #include "svn_time.h"
+#include "svn_hash.h"
+#include "svn_cache_config.h"
+#include "private/svn_parallel.h"
 #include "private/svn_subr_private.h"
 
 #include "verify.h"
@@ -534,23 +537,91 @@ expected_checksum(apr_file_t *file,
   return SVN_NO_ERROR;
 }
 
-/* Verify that the FNV checksum over the next ENTRY->SIZE bytes read
- * from FILE will match ENTRY's expected checksum.  SIZE must not
- * exceed STREAM_THRESHOLD.  Use POOL for allocations.
+/* Number of small items whose checksums get verified in one go. */
+#define CHECKSUM_BATCH_SIZE 8
+
+/* Contents of up to CHECKSUM_BATCH_SIZE small items read from a rev / pack
+ * file.  Their checksums can be calculated in parallel.
+ */
+typedef struct checksum_batch_t
+{
+  /* The p2l entries describing the items. */
+  svn_fs_fs__p2l_entry_t *entries[CHECKSUM_BATCH_SIZE];
+
+  /* Pointers to the item contents within BUFFER and their lengths. */
+  const void *data[CHECKSUM_BATCH_SIZE];
+  apr_size_t lens[CHECKSUM_BATCH_SIZE];
+
+  /* Number of items in this batch. */
+  int count;
+
+  /* Item contents, STREAM_THRESHOLD bytes reserved for each. */
+  unsigned char buffer[CHECKSUM_BATCH_SIZE * STREAM_THRESHOLD];
+} checksum_batch_t;
+
+/* Verify the checksums of all items in BATCH read from FILE and empty it.
+ * Use POOL for allocations.
+ */
+static svn_error_t *
+flush_checksum_batch(checksum_batch_t *batch,
+                     apr_file_t *file,
+                     apr_pool_t *pool)
+{
+  apr_uint32_t actual[CHECKSUM_BATCH_SIZE];
+  int i;
+
+  svn__fnv1a_32x4_multi(actual, batch->data, batch->lens, batch->count);
+  for (i = 0; i < batch->count; ++i)
+    SVN_ERR(expected_checksum(file, batch->entries[i], actual[i], pool));
+
+  batch->count = 0;
+
+  return SVN_NO_ERROR;
+}
+
+/* Return ERR, found while processing the item following those in BATCH,
+ * unless verifying the checksums of the items in BATCH fails.  In that
+ * case, return the checksum error instead because it refers to an
+ * earlier position in FILE.  Use POOL for allocations.
+ */
+static svn_error_t *
+flush_before_error(checksum_batch_t *batch,
+                   apr_file_t *file,
+                   svn_error_t *err,
+                   apr_pool_t *pool)
+{
+  svn_error_t *batch_err = flush_checksum_batch(batch, file, pool);
+  if (batch_err)
+    {
+      svn_error_clear(err);
+      return svn_error_trace(batch_err);
+    }
+
+  return svn_error_trace(err);
+}
+
+/* Read the next ENTRY->SIZE bytes from FILE into BATCH, verifying the
+ * checksums once the batch is full.  SIZE must not exceed STREAM_THRESHOLD.
+ * ENTRY must remain valid until the next flush_checksum_batch() call.
+ * Use POOL for allocations.
  */
 static svn_error_t *
-expected_buffered_checksum(apr_file_t *file,
+expected_buffered_checksum(checksum_batch_t *batch,
+                           apr_file_t *file,
                            svn_fs_fs__p2l_entry_t *entry,
                            apr_pool_t *pool)
 {
-  unsigned char buffer[STREAM_THRESHOLD];
+  unsigned char *buffer = batch->buffer + batch->count * STREAM_THRESHOLD;
   SVN_ERR_ASSERT(entry->size <= STREAM_THRESHOLD);
 
   SVN_ERR(svn_io_file_read_full2(file, buffer, (apr_size_t)entry->size,
                                  NULL, NULL, pool));
-  SVN_ERR(expected_checksum(file, entry,
-                            svn__fnv1a_32x4(buffer, (apr_size_t)entry->size),
-                            pool));
+
+  batch->entries[batch->count] = entry;
+  batch->data[batch->count] = buffer;
+  batch->lens[batch->count] = (apr_size_t)entry->size;
+  if (++batch->count == CHECKSUM_BATCH_SIZE)
+    SVN_ERR(flush_checksum_batch(batch, file, pool));
 
   return SVN_NO_ERROR;
 }
@@ -609,6 +680,9 @@ compare_p2l_to_rev(svn_fs_t *fs,
   apr_off_t max_offset;
   apr_off_t offset = 0;
   svn_fs_fs__revision_file_t *rev_file;
+  checksum_batch_t *batch = apr_palloc(pool, sizeof(*batch));
+
+  batch->count = 0;
 
   /* open the pack / rev file that is covered by the p2l index */
   SVN_ERR(svn_fs_fs__open_pack_or_rev_file(&rev_file, fs, start, pool,
@@ -664,66 +738,83 @@ compare_p2l_to_rev(svn_fs_t *fs,
 
           /* p2l index must cover all rev / pack file offsets exactly once */
           if (entry->offset != offset)
-            return svn_error_createf(SVN_ERR_FS_INDEX_INCONSISTENT,
-                                     NULL,
-                                     _("p2l index entry for revision r%ld"
-                                       " is non-contiguous between offsets "
-                                       " %s and %s"),
-                                     start,
-                                     apr_off_t_toa(pool, offset),
-                                     apr_off_t_toa(pool, entry->offset));
+            return flush_before_error(batch, rev_file->file,
+                     svn_error_createf(SVN_ERR_FS_INDEX_INCONSISTENT,
+                                       NULL,
+                                       _("p2l index entry for revision r%ld"
+                                         " is non-contiguous between offsets "
+                                         " %s and %s"),
+                                       start,
+                                       apr_off_t_toa(pool, offset),
+                                       apr_off_t_toa(pool, entry->offset)),
+                     pool);
 
           /* Check type <-> item dependencies. */
 
           /* Entry types must be within the valid range. */
           if (entry->type >= SVN_FS_FS__ITEM_TYPE_ANY_REP)
-            return svn_error_createf(SVN_ERR_FS_INDEX_CORRUPTION,
-                                     NULL,
-                                     _("p2l index entry for revision r%ld"
-                                       " at offset %s contains invalid item"
-                                       " type %d"),
-                                     start,
-                                     apr_off_t_toa(pool, offset),
-                                     entry->type);
+            return flush_before_error(batch, rev_file->file,
+                     svn_error_createf(SVN_ERR_FS_INDEX_CORRUPTION,
+                                       NULL,
+                                       _("p2l index entry for revision r%ld"
+                                         " at offset %s contains invalid item"
+                                         " type %d"),
+                                       start,
+                                       apr_off_t_toa(pool, offset),
+                                       entry->type),
+                     pool);
 
           /* There can be only one changes entry and that has a fixed type
            * and item number.  Its presence and parse-ability will be checked
            * during later stages of the verification process. */
           if (   (entry->type == SVN_FS_FS__ITEM_TYPE_CHANGES)
               != (entry->item.number == SVN_FS_FS__ITEM_INDEX_CHANGES))
-            return svn_error_createf(SVN_ERR_FS_INDEX_CORRUPTION,
-                                     NULL,
-                                     _("p2l index entry for changes in"
-                                       " revision r%ld is item %ld of type"
-                                       " %d at offset %s"),
-                                     entry->item.revision,
-                                     entry->item.number,
-                                     entry->type,
-                                     apr_off_t_toa(pool, offset));
-
-          /* Check contents. */
-          if (entry->type == SVN_FS_FS__ITEM_TYPE_UNUSED)
+            return flush_before_error(batch, rev_file->file,
+                     svn_error_createf(SVN_ERR_FS_INDEX_CORRUPTION,
+                                       NULL,
+                                       _("p2l index entry for changes in"
+                                         " revision r%ld is item %ld of type"
+                                         " %d at offset %s"),
+                                       entry->item.revision,
+                                       entry->item.number,
+                                       entry->type,
+                                       apr_off_t_toa(pool, offset)),
+                     pool);
+
+          /* Check contents.  Small items get checksummed in batches. */
+          if (   entry->type != SVN_FS_FS__ITEM_TYPE_UNUSED
+              && entry->size < STREAM_THRESHOLD)
             {
-              /* Empty sections must contain NUL bytes only.
-               * Beware of the filler at the end of the p2l index. */
-              if (entry->offset != max_offset)
-                SVN_ERR(read_all_nul(rev_file->file, entry->size, pool));
+              SVN_ERR(expected_buffered_checksum(batch, rev_file->file,
+                                                 entry, pool));
             }
           else
             {
-              /* Generic contents check against checksum. */
-              if (entry->size < STREAM_THRESHOLD)
-                SVN_ERR(expected_buffered_checksum(rev_file->file, entry,
-                                                   pool));
+              /* Report errors in file order. */
+              SVN_ERR(flush_checksum_batch(batch, rev_file->file, pool));
+
+              /* Empty sections must contain NUL bytes only.
+               * Beware of the filler at the end of the p2l index. */
+              if (entry->type == SVN_FS_FS__ITEM_TYPE_UNUSED)
+                {
+                  if (entry->offset != max_offset)
+                    SVN_ERR(read_all_nul(rev_file->file, entry->size,
+                                         pool));
+                }
               else
-                SVN_ERR(expected_streamed_checksum(rev_file->file, entry,
-                                                   pool));
+                {
+                  SVN_ERR(expected_streamed_checksum(rev_file->file, entry,
+                                                     pool));
+                }
             }
 
           /* advance offset */
           offset += entry->size;
         }
 
+      /* ENTRIES will be cleared with ITERPOOL. */
+      SVN_ERR(flush_checksum_batch(batch, rev_file->file, pool));
+
       if (cancel_func)
         SVN_ERR(cancel_func(cancel_baton));
     }
@@ -883,6 +974,167 @@ verify_f7_metadata_consistency(svn_fs_t *fs,
   return SVN_NO_ERROR;
 }
 
+
+
+/* Functions for verifying the indexes of multiple shards concurrently. */
+
+#if APR_HAS_THREADS
+
+/* Baton shared by the callbacks of verify_f7_metadata_parallel(). */
+typedef struct parallel_verify_t
+{
+  /* The filesystem being verified. */
+  svn_fs_t *fs;
+
+  /* Range of revisions to check and the shard that START belongs to. */
+  svn_revnum_t start;
+  svn_revnum_t end;
+  svn_revnum_t first_shard;
+
+  /* Progress notification callback (may be NULL) and its baton. */
+  svn_fs_progress_notify_func_t notify_func;
+  void *notify_baton;
+} parallel_verify_t;
+
+/* Set *START and *END to the revisions in PV that lie within the TASK-th
+   shard of the range. */
+static void
+get_shard_range(svn_revnum_t *start,
+                svn_revnum_t *end,
+                parallel_verify_t *pv,
+                apr_int64_t task)
+{
+  fs_fs_data_t *ffd = pv->fs->fsap_data;
+  svn_revnum_t shard_start = (pv->first_shard + (svn_revnum_t)task)
+                           * ffd->max_files_per_dir;
+
+  *start = MAX(pv->start, shard_start);
+  *end = MIN(pv->end, shard_start + ffd->max_files_per_dir - 1);
+}
+
+/* Implements svn_parallel__worker_init_t.  Open another instance of the
+   filesystem in the parallel_verify_t given as BATON. */
+static svn_error_t *
+open_worker_fs(void **worker_baton,
+               void *baton,
+               apr_pool_t *result_pool,
+               apr_pool_t *scratch_pool)
+{
+  parallel_verify_t *pv = baton;
+  fs_fs_data_t *ffd = pv->fs->fsap_data;
+  apr_hash_t *fs_config = pv->fs->config
+                        ? apr_hash_copy(result_pool, pv->fs->config)
+                        : NULL;
+  svn_fs_t *fs;
+
+  SVN_ERR(ffd->svn_fs_open_(&fs, pv->fs->path, fs_config, result_pool,
+                            scratch_pool));
+  *worker_baton = fs;
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_parallel__task_func_t.  Check the TASK-th shard of the
+   parallel_verify_t given as BATON in the filesystem given as
+   WORKER_BATON. */
+static svn_error_t *
+verify_shard(void **result,
+             void *baton,
+             void *worker_baton,
+             apr_int64_t task,
+             svn_cancel_func_t cancel_func,
+             void *cancel_baton,
+             apr_pool_t *result_pool,
+             apr_pool_t *scratch_pool)
+{
+  svn_revnum_t start, end;
+
+  get_shard_range(&start, &end, baton, task);
+  *result = NULL;
+
+  return svn_error_trace(verify_f7_metadata_consistency(worker_baton,
+                                                        start, end,
+                                                        NULL, NULL,
+                                                        cancel_func,
+                                                        cancel_baton,
+                                                        scratch_pool));
+}
+
+/* Implements svn_parallel__result_func_t.  Send the notification for the
+   TASK-th shard of the parallel_verify_t given as BATON and return
+   TASK_ERR, just like the sequential code does. */
+static svn_error_t *
+report_shard(void *baton,
+             apr_int64_t task,
+             void *result,
+             svn_error_t *task_err,
+             apr_pool_t *scratch_pool)
+{
+  parallel_verify_t *pv = baton;
+  fs_fs_data_t *ffd = pv->fs->fsap_data;
+  svn_revnum_t start, end, pack_start;
+
+  get_shard_range(&start, &end, pv, task);
+  pack_start = svn_fs_fs__packed_base_rev(pv->fs, start);
+  if (pv->notify_func && (pack_start % ffd->max_files_per_dir == 0))
+    pv->notify_func(pack_start, pv->notify_baton, scratch_pool);
+
+  return svn_error_trace(task_err);
+}
+
+/* Like verify_f7_metadata_consistency but check up to JOBS shards at
+ * once, each one in a separate thread with its own instance of FS.
+ * Notifications and errors are reported in revision order, i.e. in the
+ * same way a sequential check would report them.
+ */
+static svn_error_t *
+verify_f7_metadata_parallel(svn_fs_t *fs,
+                            svn_revnum_t start,
+                            svn_revnum_t end,
+                            int jobs,
+                            svn_fs_progress_notify_func_t notify_func,
+                            void *notify_baton,
+                            svn_cancel_func_t cancel_func,
+                            void *cancel_baton,
+                            apr_pool_t *pool)
+{
+  fs_fs_data_t *ffd = fs->fsap_data;
+  parallel_verify_t pv;
+
+  pv.fs = fs;
+  pv.start = start;
+  pv.end = end;
+  pv.first_shard = start / ffd->max_files_per_dir;
+  pv.notify_func = notify_func;
+  pv.notify_baton = notify_baton;
+
+  return svn_error_trace(svn_parallel__run_ordered(
+                           end / ffd->max_files_per_dir - pv.first_shard + 1,
+                           jobs, 4 * jobs,
+                           open_worker_fs, verify_shard, report_shard, &pv,
+                           cancel_func, cancel_baton, pool));
+}
+
+/* Set *JOBS to the number of verification threads requested in
+   FS->CONFIG. */
+static svn_error_t *
+get_verify_jobs(int *jobs,
+                svn_fs_t *fs)
+{
+  const char *value = fs->config
+                    ? svn_hash_gets(fs->config,
+                                    SVN_FS_CONFIG_FSFS_VERIFY_JOBS)
+                    : NULL;
+
+  *jobs = 1;
+  if (value)
+    SVN_ERR(svn_cstring_atoi(jobs, value));
+
+  return SVN_NO_ERROR;
+}
+
+#endif /* APR_HAS_THREADS */
+
 svn_error_t *
 svn_fs_fs__verify(svn_fs_t *fs,
                   svn_revnum_t start,
@@ -909,9 +1161,28 @@ svn_fs_fs__verify(svn_fs_t *fs,
   /* log/phys index consistency.  We need to check them first to make
      sure we can access the rev / pack files in format7. */
   if (svn_fs_fs__use_log_addressing(fs))
-    SVN_ERR(verify_f7_metadata_consistency(fs, start, end,
-                                           notify_func, notify_baton,
-                                           cancel_func, cancel_baton, pool));
+    {
+#if APR_HAS_THREADS
+      /* Shards are independent of each other.  We may check them
+         concurrently as long as the caches can be shared safely. */
+      int jobs;
+      SVN_ERR(get_verify_jobs(&jobs, fs));
+
+      if (   jobs > 1
+          && ffd->max_files_per_dir
+          && ffd->svn_fs_open_
+          && !svn_cache_config_get()->single_threaded)
+        SVN_ERR(verify_f7_metadata_parallel(fs, start, end, jobs,
+                                            notify_func, notify_baton,
+                                            cancel_func, cancel_baton,
+                                            pool));
+      else
+#endif
+        SVN_ERR(verify_f7_metadata_consistency(fs, start, end,
+                                               notify_func, notify_baton,
+                                               cancel_func, cancel_baton,
+                                               pool));
+    }
 
   /* rep cache consistency */
   if (ffd->format >= SVN_FS_FS__MIN_REP_SHARING_FORMAT)
@@ -487,6 +487,11 @@ x_verify(svn_fs_t *fs,
          void *notify_baton,
          svn_cancel_func_t cancel_func,
          void *cancel_baton,
+         svn_error_t *(*svn_fs_open_)(svn_fs_t **,
+                                      const char *,
+                                      apr_hash_t *,
+                                      apr_pool_t *,
+                                      apr_pool_t *),
          svn_mutex__t *common_pool_lock,
          apr_pool_t *scratch_pool,
          apr_pool_t *common_pool)
@@ -37,6 +37,7 @@
 #include "svn_props.h"
 
 #include "svn_private_config.h"
+#include "private/svn_delta_private.h"
 #include "private/svn_dep_compat.h"
 #include "private/svn_fspath.h"
 #include "private/svn_skel.h"
@@ -1964,9 +1965,14 @@ apply_textdelta(void *file_baton,
   negotiate_put_encoding(&svndiff_version, &compression_level,
                          ctx->commit_ctx->session);
   /* Disown the stream; we'll close it explicitly in close_file(). */
-  svn_txdelta_to_svndiff3(handler, handler_baton,
-                          svn_stream_disown(ctx->stream, pool),
-                          svndiff_version, compression_level, pool);
+  if (ctx->commit_ctx->session->supports_svndiff_large_windows)
+    svn_txdelta__to_svndiff_large(handler, handler_baton,
+                                  svn_stream_disown(ctx->stream, pool),
+                                  svndiff_version, compression_level, pool);
+  else
+    svn_txdelta_to_svndiff3(handler, handler_baton,
+                            svn_stream_disown(ctx->stream, pool),
+                            svndiff_version, compression_level, pool);
 
   if (base_checksum)
     ctx->base_checksum = apr_pstrdup(ctx->pool, base_checksum);
@@ -2011,8 +2017,13 @@ create_body_from_txdelta_stream(serf_bucket_t **body_bkt,
   SVN_ERR(b->open_func(&txdelta_stream, b->open_baton, pool, scratch_pool));
 
   negotiate_put_encoding(&svndiff_version, &compression_level, b->session);
-  stream = svn_txdelta_to_svndiff_stream(txdelta_stream, svndiff_version,
-                                         compression_level, pool);
+  if (b->session->supports_svndiff_large_windows)
+    stream = svn_txdelta__to_svndiff_stream_large(txdelta_stream,
+                                                  svndiff_version,
+                                                  compression_level, pool);
+  else
+    stream = svn_txdelta_to_svndiff_stream(txdelta_stream, svndiff_version,
+                                           compression_level, pool);
   *body_bkt = svn_ra_serf__create_stream_bucket(stream, alloc,
                                                 txdelta_stream_errfunc, b);
 
@@ -269,6 +269,10 @@ struct svn_ra_serf__session_t {
   /* Indicates whether the server can understand svndiff version 2. */
   svn_boolean_t supports_svndiff2;
 
+  /* Indicates whether the server can understand svndiff data with large
+     windows. */
+  svn_boolean_t supports_svndiff_large_windows;
+
   /* Indicates whether the server sends the result checksum in the response
    * to a successful PUT request. */
   svn_boolean_t supports_put_result_checksum;
@@ -2033,7 +2033,8 @@ svn_ra_serf__setup_svndiff_accept_encoding(serf_bucket_t *headers,
       /* Don't advertise support for compressed svndiff formats if
          compression is disabled. */
       serf_bucket_headers_setn(
-        headers, "Accept-Encoding", "svndiff");
+        headers, "Accept-Encoding",
+        "svndiff," SVN_DAV_SVNDIFF_LARGE_WINDOWS);
     }
   else if (session->using_compression == svn_tristate_unknown &&
            svn_ra_serf__is_low_latency_connection(session))
@@ -2044,7 +2045,8 @@ svn_ra_serf__setup_svndiff_accept_encoding(serf_bucket_t *headers,
          don't care about worse compression ratio. */
       serf_bucket_headers_setn(
         headers, "Accept-Encoding",
-        "gzip,svndiff2;q=0.9,svndiff1;q=0.8,svndiff;q=0.7");
+        "gzip,svndiff2;q=0.9,svndiff1;q=0.8,svndiff;q=0.7,"
+        SVN_DAV_SVNDIFF_LARGE_WINDOWS);
     }
   else
     {
@@ -2055,7 +2057,8 @@ svn_ra_serf__setup_svndiff_accept_encoding(serf_bucket_t *headers,
          above), we can't do this generally. */
       serf_bucket_headers_setn(
         headers, "Accept-Encoding",
-        "gzip,svndiff1;q=0.9,svndiff2;q=0.8,svndiff;q=0.7");
+        "gzip,svndiff1;q=0.9,svndiff2;q=0.8,svndiff;q=0.7,"
+        SVN_DAV_SVNDIFF_LARGE_WINDOWS);
     }
 }
 
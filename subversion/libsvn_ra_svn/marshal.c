@@ -45,6 +45,7 @@
 
 #include "ra_svn.h"
 
+#include "private/svn_delta_private.h"
 #include "private/svn_string_private.h"
 #include "private/svn_dep_compat.h"
 #include "private/svn_error_private.h"
@@ -283,6 +284,24 @@ svn_ra_svn__svndiff_version(svn_ra_svn_conn_t *conn)
   return 0;
 }
 
+void
+svn_ra_svn__to_svndiff(svn_txdelta_window_handler_t *handler,
+                       void **handler_baton,
+                       svn_stream_t *output,
+                       svn_ra_svn_conn_t *conn,
+                       apr_pool_t *pool)
+{
+  int svndiff_version = svn_ra_svn__svndiff_version(conn);
+  int compression_level = svn_ra_svn_compression_level(conn);
+
+  if (svn_ra_svn_has_capability(conn, SVN_RA_SVN_CAP_SVNDIFF_LARGE_WINDOWS))
+    svn_txdelta__to_svndiff_large(handler, handler_baton, output,
+                                  svndiff_version, compression_level, pool);
+  else
+    svn_txdelta_to_svndiff3(handler, handler_baton, output, svndiff_version,
+                            compression_level, pool);
+}
+
 apr_pool_t *
 svn_ra_svn__get_pool(svn_ra_svn_conn_t *conn)
 {
@@ -855,6 +855,35 @@ svn_repos_dump_fs2(svn_repos_t *repos,
                                             pool));
 }
 
+svn_error_t *
+svn_repos_verify_fs3(svn_repos_t *repos,
+                     svn_revnum_t start_rev,
+                     svn_revnum_t end_rev,
+                     svn_boolean_t check_normalization,
+                     svn_boolean_t metadata_only,
+                     svn_repos_notify_func_t notify_func,
+                     void *notify_baton,
+                     svn_repos_verify_callback_t verify_callback,
+                     void *verify_baton,
+                     svn_cancel_func_t cancel_func,
+                     void *cancel_baton,
+                     apr_pool_t *pool)
+{
+  return svn_error_trace(svn_repos_verify_fs4(repos,
+                                              start_rev,
+                                              end_rev,
+                                              check_normalization,
+                                              metadata_only,
+                                              1,
+                                              notify_func,
+                                              notify_baton,
+                                              verify_callback,
+                                              verify_baton,
+                                              cancel_func,
+                                              cancel_baton,
+                                              pool));
+}
+
 svn_error_t *
 svn_repos_verify_fs2(svn_repos_t *repos,
                      svn_revnum_t start_rev,
@@ -37,10 +37,12 @@
 #include "svn_checksum.h"
 #include "svn_props.h"
 #include "svn_sorts.h"
+#include "svn_cache_config.h"
 
 #include "private/svn_repos_private.h"
 #include "private/svn_mergeinfo_private.h"
 #include "private/svn_fs_private.h"
+#include "private/svn_parallel.h"
 #include "private/svn_sorts_private.h"
 #include "private/svn_utf_private.h"
 #include "private/svn_cache.h"
@@ -2433,12 +2435,211 @@ report_error(svn_revnum_t revision,
     }
 }
 
+/* Process the outcome VERIFY_ERR of verifying revision REV: return
+   cancellation errors, pass other errors to VERIFY_CALLBACK with
+   VERIFY_BATON and report success through NOTIFY_FUNC with NOTIFY_BATON,
+   using NOTIFY as the notification object.  Use SCRATCH_POOL for
+   temporary allocations. */
+static svn_error_t *
+finish_revision(svn_revnum_t rev,
+                svn_error_t *verify_err,
+                svn_repos_notify_func_t notify_func,
+                void *notify_baton,
+                svn_repos_notify_t *notify,
+                svn_repos_verify_callback_t verify_callback,
+                void *verify_baton,
+                apr_pool_t *scratch_pool)
+{
+  if (verify_err && verify_err->apr_err == SVN_ERR_CANCELLED)
+    {
+      return svn_error_trace(verify_err);
+    }
+  else if (verify_err)
+    {
+      SVN_ERR(report_error(rev, verify_err, verify_callback, verify_baton,
+                           scratch_pool));
+    }
+  else if (notify_func)
+    {
+      /* Tell the caller that we're done with this revision. */
+      notify->revision = rev;
+      notify_func(notify_baton, notify, scratch_pool);
+    }
+
+  return SVN_NO_ERROR;
+}
+
+#if APR_HAS_THREADS
+
+/* Baton shared by the callbacks of verify_revisions_parallel(). */
+typedef struct parallel_verify_t
+{
+  /* The filesystem being verified and the first revision to verify. */
+  svn_fs_t *fs;
+  svn_revnum_t start_rev;
+
+  /* Parameters for verify_one_revision() and finish_revision(). */
+  svn_boolean_t check_normalization;
+  svn_repos_notify_func_t notify_func;
+  void *notify_baton;
+  svn_repos_notify_t *notify;
+  svn_repos_verify_callback_t verify_callback;
+  void *verify_baton;
+} parallel_verify_t;
+
+/* Implements svn_repos_notify_func_t.  Append a copy of NOTIFY to the
+   array of svn_repos_notify_t * given as BATON. */
+static void
+record_notification(void *baton,
+                    const svn_repos_notify_t *notify,
+                    apr_pool_t *scratch_pool)
+{
+  apr_array_header_t *notifications = baton;
+  svn_repos_notify_t *copy = apr_pmemdup(notifications->pool, notify,
+                                         sizeof(*notify));
+
+  if (copy->warning_str)
+    copy->warning_str = apr_pstrdup(notifications->pool, copy->warning_str);
+  if (copy->path)
+    copy->path = apr_pstrdup(notifications->pool, copy->path);
+
+  APR_ARRAY_PUSH(notifications, svn_repos_notify_t *) = copy;
+}
+
+/* Implements svn_parallel__worker_init_t.  Open another instance of the
+   filesystem in the parallel_verify_t given as BATON. */
+static svn_error_t *
+open_worker_fs(void **worker_baton,
+               void *baton,
+               apr_pool_t *result_pool,
+               apr_pool_t *scratch_pool)
+{
+  parallel_verify_t *pv = baton;
+  svn_fs_t *fs;
+
+  SVN_ERR(svn_fs_open2(&fs, svn_fs_path(pv->fs, scratch_pool),
+                       svn_fs_config(pv->fs, result_pool),
+                       result_pool, scratch_pool));
+  *worker_baton = fs;
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_parallel__task_func_t.  Verify the TASK-th revision of
+   the parallel_verify_t given as BATON in the filesystem given as
+   WORKER_BATON.  Return the notifications sent while doing so in *RESULT,
+   as an array of svn_repos_notify_t *. */
+static svn_error_t *
+verify_revision_task(void **result,
+                     void *baton,
+                     void *worker_baton,
+                     apr_int64_t task,
+                     svn_cancel_func_t cancel_func,
+                     void *cancel_baton,
+                     apr_pool_t *result_pool,
+                     apr_pool_t *scratch_pool)
+{
+  parallel_verify_t *pv = baton;
+  apr_array_header_t *notifications
+    = apr_array_make(result_pool, 4, sizeof(svn_repos_notify_t *));
+
+  *result = notifications;
+
+  return svn_error_trace(verify_one_revision(worker_baton,
+                                             pv->start_rev
+                                               + (svn_revnum_t)task,
+                                             pv->notify_func
+                                               ? record_notification
+                                               : NULL,
+                                             notifications,
+                                             pv->start_rev,
+                                             pv->check_normalization,
+                                             cancel_func, cancel_baton,
+                                             scratch_pool));
+}
+
+/* Implements svn_parallel__result_func_t.  Replay the notifications
+   recorded for the TASK-th revision of the parallel_verify_t given as
+   BATON and process its outcome TASK_ERR like the sequential code does. */
+static svn_error_t *
+report_revision(void *baton,
+                apr_int64_t task,
+                void *result,
+                svn_error_t *task_err,
+                apr_pool_t *scratch_pool)
+{
+  parallel_verify_t *pv = baton;
+  apr_array_header_t *notifications = result;
+  int i;
+
+  for (i = 0; i < notifications->nelts; ++i)
+    pv->notify_func(pv->notify_baton,
+                    APR_ARRAY_IDX(notifications, i, svn_repos_notify_t *),
+                    scratch_pool);
+
+  return svn_error_trace(finish_revision(pv->start_rev + (svn_revnum_t)task,
+                                         task_err,
+                                         pv->notify_func, pv->notify_baton,
+                                         pv->notify,
+                                         pv->verify_callback,
+                                         pv->verify_baton,
+                                         scratch_pool));
+}
+
+/* Verify the revisions START_REV to END_REV of FS like the loop in
+ * svn_repos_verify_fs4() but with up to JOBS worker threads, each using
+ * its own instance of FS.  All notifications and callbacks are invoked
+ * from this thread and in revision order.  The other parameters are the
+ * same as for svn_repos_verify_fs4().
+ */
+static svn_error_t *
+verify_revisions_parallel(svn_fs_t *fs,
+                          svn_revnum_t start_rev,
+                          svn_revnum_t end_rev,
+                          svn_boolean_t check_normalization,
+                          int jobs,
+                          svn_repos_notify_func_t notify_func,
+                          void *notify_baton,
+                          svn_repos_notify_t *notify,
+                          svn_repos_verify_callback_t verify_callback,
+                          void *verify_baton,
+                          svn_cancel_func_t cancel_func,
+                          void *cancel_baton,
+                          apr_pool_t *scratch_pool)
+{
+  parallel_verify_t pv;
+
+  pv.fs = fs;
+  pv.start_rev = start_rev;
+  pv.check_normalization = check_normalization;
+  pv.notify_func = notify_func;
+  pv.notify_baton = notify_baton;
+  pv.notify = notify;
+  pv.verify_callback = verify_callback;
+  pv.verify_baton = verify_baton;
+
+  /* Some revisions take much longer to verify than others.  Allow the
+     workers to run ahead of the oldest unreported revision such that they
+     are kept busy while we wait for it. */
+  return svn_error_trace(svn_parallel__run_ordered(end_rev - start_rev + 1,
+                                                   jobs, 4 * jobs,
+                                                   open_worker_fs,
+                                                   verify_revision_task,
+                                                   report_revision, &pv,
+                                                   cancel_func,
+                                                   cancel_baton,
+                                                   scratch_pool));
+}
+
+#endif /* APR_HAS_THREADS */
+
 svn_error_t *
-svn_repos_verify_fs3(svn_repos_t *repos,
+svn_repos_verify_fs4(svn_repos_t *repos,
                      svn_revnum_t start_rev,
                      svn_revnum_t end_rev,
                      svn_boolean_t check_normalization,
                      svn_boolean_t metadata_only,
+                     int jobs,
                      svn_repos_notify_func_t notify_func,
                      void *notify_baton,
                      svn_repos_verify_callback_t verify_callback,
@@ -2451,9 +2652,10 @@ svn_repos_verify_fs3(svn_repos_t *repos,
   svn_revnum_t youngest;
   svn_revnum_t rev;
   apr_pool_t *iterpool = svn_pool_create(pool);
-  svn_repos_notify_t *notify;
+  svn_repos_notify_t *notify = NULL;
   svn_fs_progress_notify_func_t verify_notify = NULL;
   struct verify_fs_notify_func_baton_t *verify_notify_baton = NULL;
+  apr_hash_t *fs_config = svn_fs_config(fs, pool);
   svn_error_t *err;
 
   /* Make sure we catch up on the latest revprop changes.  This is the only
@@ -2495,8 +2697,31 @@ svn_repos_verify_fs3(svn_repos_t *repos,
         = svn_repos_notify_create(svn_repos_notify_verify_rev_structure, pool);
     }
 
+  /* Concurrent verification needs caches that may be shared between
+     threads.  Only FSFS has been designed for that kind of access. */
+  if (!APR_HAS_THREADS || svn_cache_config_get()->single_threaded)
+    jobs = 1;
+
+  if (jobs > 1)
+    {
+      const char *fs_type;
+
+      SVN_ERR(svn_fs_type(&fs_type, svn_fs_path(fs, pool), pool));
+      if (strcmp(fs_type, SVN_FS_TYPE_FSFS) != 0)
+        jobs = 1;
+    }
+
+  /* Let the backend check its metadata concurrently as well. */
+  if (jobs > 1)
+    {
+      fs_config = fs_config ? apr_hash_copy(pool, fs_config)
+                            : apr_hash_make(pool);
+      svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_VERIFY_JOBS,
+                    apr_itoa(pool, jobs));
+    }
+
   /* Verify global metadata and backend-specific data first. */
-  err = svn_fs_verify(svn_fs_path(fs, pool), svn_fs_config(fs, pool),
+  err = svn_fs_verify(svn_fs_path(fs, pool), fs_config,
                       start_rev, end_rev,
                       verify_notify, verify_notify_baton,
                       cancel_func, cancel_baton, pool);
@@ -2511,6 +2736,15 @@ svn_repos_verify_fs3(svn_repos_t *repos,
                            verify_baton, iterpool));
     }
 
+#if APR_HAS_THREADS
+  if (!metadata_only && jobs > 1 && start_rev < end_rev)
+    SVN_ERR(verify_revisions_parallel(fs, start_rev, end_rev,
+                                      check_normalization, jobs,
+                                      notify_func, notify_baton, notify,
+                                      verify_callback, verify_baton,
+                                      cancel_func, cancel_baton, pool));
+  else
+#endif
   if (!metadata_only)
     for (rev = start_rev; rev <= end_rev; rev++)
       {
@@ -2522,21 +2756,8 @@ svn_repos_verify_fs3(svn_repos_t *repos,
                                   cancel_func, cancel_baton,
                                   iterpool);
 
-        if (err && err->apr_err == SVN_ERR_CANCELLED)
-          {
-            return svn_error_trace(err);
-          }
-        else if (err)
-          {
-            SVN_ERR(report_error(rev, err, verify_callback, verify_baton,
-                                 iterpool));
-          }
-        else if (notify_func)
-          {
-            /* Tell the caller that we're done with this revision. */
-            notify->revision = rev;
-            notify_func(notify_baton, notify, iterpool);
-          }
+        SVN_ERR(finish_revision(rev, err, notify_func, notify_baton, notify,
+                                verify_callback, verify_baton, iterpool));
       }
 
   /* We're done. */
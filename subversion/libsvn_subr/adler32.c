@@ -26,6 +26,13 @@
 #include <zlib.h>
 
 #include "private/svn_adler32.h"
+#include "private/svn_cpu.h"
+
+#if defined(SVN__SIMD_X86)
+#  include <immintrin.h>
+#elif defined(SVN__SIMD_NEON)
+#  include <arm_neon.h>
+#endif
 
 /**
  * An Adler-32 implementation per RFC1950.
@@ -41,6 +48,332 @@
  */
 #define ADLER_MOD_BASE 65521
 
+/* The SIMD kernels below process the data in blocks of that many bytes.
+ */
+#define BLOCK_SIZE 32
+
+/* Max. number of BLOCK_SIZE blocks that we may feed into a kernel before
+ * we have to reduce the sums modulo ADLER_MOD_BASE.  This is derived from
+ * zlib's NMAX (5552), the largest n for which
+ * 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1 holds.
+ */
+#define MAX_BLOCKS (5552 / BLOCK_SIZE)
+
+/* Update the unreduced Adler-32 sums *S1 and *S2 with the COUNT blocks
+ * of BLOCK_SIZE bytes each starting at INPUT.
+ *
+ * All arithmetic is modulo 2^32.  Hence, the results are exact as long
+ * as the final sums don't overflow, i.e. if *S1 and *S2 are below
+ * ADLER_MOD_BASE and COUNT does not exceed MAX_BLOCKS.
+ */
+typedef void (*block_kernel_t)(apr_uint32_t *s1,
+                               apr_uint32_t *s2,
+                               const unsigned char *input,
+                               apr_size_t count);
+
+/* Portable implementation of block_kernel_t.
+ */
+static void
+blocks_scalar(apr_uint32_t *s1,
+              apr_uint32_t *s2,
+              const unsigned char *input,
+              apr_size_t count)
+{
+  apr_uint32_t a = *s1;
+  apr_uint32_t b = *s2;
+  const unsigned char *last = input + count * BLOCK_SIZE;
+
+  for (; input < last; input += 8)
+    {
+      a += input[0]; b += a;
+      a += input[1]; b += a;
+      a += input[2]; b += a;
+      a += input[3]; b += a;
+      a += input[4]; b += a;
+      a += input[5]; b += a;
+      a += input[6]; b += a;
+      a += input[7]; b += a;
+    }
+
+  *s1 = a;
+  *s2 = b;
+}
+
+#ifdef SVN__SIMD_X86
+
+/* Return the sum of all four 32 bit elements in V.
+ */
+SVN__TARGET("sse2")
+static APR_INLINE apr_uint32_t
+hsum_epi32(__m128i v)
+{
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+
+  return (apr_uint32_t)_mm_cvtsi128_si32(v);
+}
+
+/* SSE2 implementation of block_kernel_t.
+ *
+ * Within a block, S1 is the plain sum over all bytes while S2 grows by
+ * the sum of all bytes weighted by their distance from the block end
+ * plus BLOCK_SIZE times the S1 value at the start of the block.
+ * PS collects the latter across all blocks.  SSE2 lacks an unsigned x
+ * signed byte multiply, so the weights are applied on 16 bit values.
+ */
+SVN__TARGET("sse2")
+static void
+blocks_sse2(apr_uint32_t *s1,
+            apr_uint32_t *s2,
+            const unsigned char *input,
+            apr_size_t count)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i tap1 = _mm_setr_epi16(32, 31, 30, 29, 28, 27, 26, 25);
+  const __m128i tap2 = _mm_setr_epi16(24, 23, 22, 21, 20, 19, 18, 17);
+  const __m128i tap3 = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+  const __m128i tap4 = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+
+  __m128i v_s1 = _mm_setzero_si128();
+  __m128i v_s2 = _mm_setzero_si128();
+  __m128i v_ps = _mm_setzero_si128();
+  apr_uint32_t a = *s1;
+  apr_uint32_t b = *s2 + a * (apr_uint32_t)(count * BLOCK_SIZE);
+
+  for (; count; --count, input += BLOCK_SIZE)
+    {
+      const __m128i bytes1 = _mm_loadu_si128((const __m128i *)input);
+      const __m128i bytes2 = _mm_loadu_si128((const __m128i *)(input + 16));
+
+      v_ps = _mm_add_epi32(v_ps, v_s1);
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+
+      v_s2 = _mm_add_epi32(v_s2,
+                 _mm_madd_epi16(_mm_unpacklo_epi8(bytes1, zero), tap1));
+      v_s2 = _mm_add_epi32(v_s2,
+                 _mm_madd_epi16(_mm_unpackhi_epi8(bytes1, zero), tap2));
+      v_s2 = _mm_add_epi32(v_s2,
+                 _mm_madd_epi16(_mm_unpacklo_epi8(bytes2, zero), tap3));
+      v_s2 = _mm_add_epi32(v_s2,
+                 _mm_madd_epi16(_mm_unpackhi_epi8(bytes2, zero), tap4));
+    }
+
+  v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+  *s1 = a + hsum_epi32(v_s1);
+  *s2 = b + hsum_epi32(v_s2);
+}
+
+/* SSSE3 implementation of block_kernel_t.  Same as blocks_sse2() but
+ * with the byte weighting done by PMADDUBSW.
+ */
+SVN__TARGET("ssse3")
+static void
+blocks_ssse3(apr_uint32_t *s1,
+             apr_uint32_t *s2,
+             const unsigned char *input,
+             apr_size_t count)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+  const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                     24, 23, 22, 21, 20, 19, 18, 17);
+  const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9,
+                                     8, 7, 6, 5, 4, 3, 2, 1);
+
+  __m128i v_s1 = _mm_setzero_si128();
+  __m128i v_s2 = _mm_setzero_si128();
+  __m128i v_ps = _mm_setzero_si128();
+  apr_uint32_t a = *s1;
+  apr_uint32_t b = *s2 + a * (apr_uint32_t)(count * BLOCK_SIZE);
+
+  for (; count; --count, input += BLOCK_SIZE)
+    {
+      const __m128i bytes1 = _mm_loadu_si128((const __m128i *)input);
+      const __m128i bytes2 = _mm_loadu_si128((const __m128i *)(input + 16));
+
+      v_ps = _mm_add_epi32(v_ps, v_s1);
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+
+      v_s2 = _mm_add_epi32(v_s2,
+                 _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+      v_s2 = _mm_add_epi32(v_s2,
+                 _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+    }
+
+  v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+  *s1 = a + hsum_epi32(v_s1);
+  *s2 = b + hsum_epi32(v_s2);
+}
+
+/* AVX2 implementation of block_kernel_t.  Same as blocks_ssse3() but
+ * processing a whole block per instruction.
+ */
+SVN__TARGET("avx2")
+static void
+blocks_avx2(apr_uint32_t *s1,
+            apr_uint32_t *s2,
+            const unsigned char *input,
+            apr_size_t count)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i ones = _mm256_set1_epi16(1);
+  const __m256i tap = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                       24, 23, 22, 21, 20, 19, 18, 17,
+                                       16, 15, 14, 13, 12, 11, 10, 9,
+                                       8, 7, 6, 5, 4, 3, 2, 1);
+
+  __m256i v_s1 = _mm256_setzero_si256();
+  __m256i v_s2 = _mm256_setzero_si256();
+  __m256i v_ps = _mm256_setzero_si256();
+  __m128i r_s1, r_s2;
+  apr_uint32_t a = *s1;
+  apr_uint32_t b = *s2 + a * (apr_uint32_t)(count * BLOCK_SIZE);
+
+  for (; count; --count, input += BLOCK_SIZE)
+    {
+      const __m256i bytes = _mm256_loadu_si256((const __m256i *)input);
+
+      v_ps = _mm256_add_epi32(v_ps, v_s1);
+      v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes, zero));
+      v_s2 = _mm256_add_epi32(v_s2,
+                 _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, tap), ones));
+    }
+
+  v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 5));
+
+  r_s1 = _mm_add_epi32(_mm256_castsi256_si128(v_s1),
+                       _mm256_extracti128_si256(v_s1, 1));
+  r_s2 = _mm_add_epi32(_mm256_castsi256_si128(v_s2),
+                       _mm256_extracti128_si256(v_s2, 1));
+
+  *s1 = a + hsum_epi32(r_s1);
+  *s2 = b + hsum_epi32(r_s2);
+}
+
+#endif /* SVN__SIMD_X86 */
+
+#ifdef SVN__SIMD_NEON
+
+/* NEON implementation of block_kernel_t.  The per-position byte sums
+ * are collected in 16 bit lanes (COUNT <= MAX_BLOCKS keeps them from
+ * overflowing) and get weighted only once at the end.
+ */
+static void
+blocks_neon(apr_uint32_t *s1,
+            apr_uint32_t *s2,
+            const unsigned char *input,
+            apr_size_t count)
+{
+  static const apr_uint16_t taps[32] = { 32, 31, 30, 29, 28, 27, 26, 25,
+                                         24, 23, 22, 21, 20, 19, 18, 17,
+                                         16, 15, 14, 13, 12, 11, 10, 9,
+                                         8, 7, 6, 5, 4, 3, 2, 1 };
+
+  uint32x4_t v_s1 = vdupq_n_u32(0);
+  uint32x4_t v_s2;
+  uint32x4_t v_ps = vdupq_n_u32(0);
+  uint16x8_t col1 = vdupq_n_u16(0);
+  uint16x8_t col2 = vdupq_n_u16(0);
+  uint16x8_t col3 = vdupq_n_u16(0);
+  uint16x8_t col4 = vdupq_n_u16(0);
+  apr_uint32_t a = *s1;
+  apr_uint32_t b = *s2 + a * (apr_uint32_t)(count * BLOCK_SIZE);
+
+  for (; count; --count, input += BLOCK_SIZE)
+    {
+      const uint8x16_t bytes1 = vld1q_u8(input);
+      const uint8x16_t bytes2 = vld1q_u8(input + 16);
+
+      v_ps = vaddq_u32(v_ps, v_s1);
+      v_s1 = vpadalq_u16(v_s1, vpadalq_u8(vpaddlq_u8(bytes1), bytes2));
+
+      col1 = vaddw_u8(col1, vget_low_u8(bytes1));
+      col2 = vaddw_u8(col2, vget_high_u8(bytes1));
+      col3 = vaddw_u8(col3, vget_low_u8(bytes2));
+      col4 = vaddw_u8(col4, vget_high_u8(bytes2));
+    }
+
+  v_s2 = vshlq_n_u32(v_ps, 5);
+  v_s2 = vmlal_u16(v_s2, vget_low_u16(col1), vld1_u16(taps + 0));
+  v_s2 = vmlal_u16(v_s2, vget_high_u16(col1), vld1_u16(taps + 4));
+  v_s2 = vmlal_u16(v_s2, vget_low_u16(col2), vld1_u16(taps + 8));
+  v_s2 = vmlal_u16(v_s2, vget_high_u16(col2), vld1_u16(taps + 12));
+  v_s2 = vmlal_u16(v_s2, vget_low_u16(col3), vld1_u16(taps + 16));
+  v_s2 = vmlal_u16(v_s2, vget_high_u16(col3), vld1_u16(taps + 20));
+  v_s2 = vmlal_u16(v_s2, vget_low_u16(col4), vld1_u16(taps + 24));
+  v_s2 = vmlal_u16(v_s2, vget_high_u16(col4), vld1_u16(taps + 28));
+
+  *s1 = a + vaddvq_u32(v_s1);
+  *s2 = b + vaddvq_u32(v_s2);
+}
+
+#endif /* SVN__SIMD_NEON */
+
+/* Return the fastest block_kernel_t supported by the current CPU or NULL,
+ * if there is no SIMD kernel available.
+ */
+static block_kernel_t
+simd_kernel(void)
+{
+#if defined(SVN__SIMD_X86)
+  apr_uint32_t features = svn_cpu__features();
+  if (features & SVN_CPU__AVX2)
+    return blocks_avx2;
+  if (features & SVN_CPU__SSSE3)
+    return blocks_ssse3;
+  if (features & SVN_CPU__SSE2)
+    return blocks_sse2;
+#elif defined(SVN__SIMD_NEON)
+  if (svn_cpu__features() & SVN_CPU__NEON)
+    return blocks_neon;
+#endif
+
+  return NULL;
+}
+
+/* Update the unreduced sums *S1 and *S2 with LEN bytes from INPUT.
+ * LEN must be less than 5552 to prevent overflows.
+ */
+static APR_INLINE void
+bytes_scalar(apr_uint32_t *s1,
+             apr_uint32_t *s2,
+             const unsigned char *input,
+             apr_size_t len)
+{
+  apr_uint32_t a = *s1;
+  apr_uint32_t b = *s2;
+
+  /* Some loop unrolling
+   * (approx. one clock tick per byte + 2 ticks loop overhead)
+   */
+  for (; len >= 8; len -= 8, input += 8)
+    {
+      a += input[0]; b += a;
+      a += input[1]; b += a;
+      a += input[2]; b += a;
+      a += input[3]; b += a;
+      a += input[4]; b += a;
+      a += input[5]; b += a;
+      a += input[6]; b += a;
+      a += input[7]; b += a;
+    }
+
+  /* Adler-32 calculation as a simple two ticks per iteration loop.
+   */
+  while (len--)
+    {
+      a += *input++;
+      b += a;
+    }
+
+  *s1 = a;
+  *s2 = b;
+}
+
 /*
  * Start with CHECKSUM and update the checksum by processing a chunk
  * of DATA sized LEN.
@@ -48,54 +381,89 @@
 apr_uint32_t
 svn__adler32(apr_uint32_t checksum, const char *data, apr_off_t len)
 {
-  /* The actual limit can be set somewhat higher but should
-   * not be lower because the SIMD code would not be used
-   * in that case.
+  const unsigned char *input = (const unsigned char *)data;
+  apr_uint32_t s1 = checksum & 0xFFFF;
+  apr_uint32_t s2 = checksum >> 16;
+  block_kernel_t kernel = len >= BLOCK_SIZE ? simd_kernel() : NULL;
+
+  /* Feed as many full blocks as we can into the SIMD kernel, if we have
+   * one, reducing the sums often enough to prevent overflows.
    *
-   * However, it must be lower than 5552 to make sure our local
-   * implementation does not suffer from overflows.
+   * Otherwise, larger buffers can be efficiently handled by Marc Adler's
+   * optimized code in zlib.  The limit for that can be set somewhat
+   * higher but should not be lower because zlib's SIMD code would not
+   * be used in that case.
+   *
+   * In any case, what is left for our local implementation must be less
+   * than 5552 bytes to make sure it does not suffer from overflows.
    */
-  if (len >= 80)
+  if (kernel)
+    {
+      while (len >= BLOCK_SIZE)
+        {
+          apr_size_t count = (apr_size_t)(len / BLOCK_SIZE);
+          if (count > MAX_BLOCKS)
+            count = MAX_BLOCKS;
+
+          kernel(&s1, &s2, input, count);
+          s1 %= ADLER_MOD_BASE;
+          s2 %= ADLER_MOD_BASE;
+
+          input += count * BLOCK_SIZE;
+          len -= count * BLOCK_SIZE;
+        }
+    }
+  else if (len >= 80)
     {
-      /* Larger buffers can be efficiently handled by Marc Adler's
-       * optimized code. Also, new zlib versions will come with
-       * SIMD code for x86 and x64.
-       */
       return (apr_uint32_t)adler32(checksum,
                                    (const Bytef *)data,
                                    (uInt)len);
     }
-  else
+
+  bytes_scalar(&s1, &s2, input, (apr_size_t)len);
+
+  return ((s2 % ADLER_MOD_BASE) << 16) | (s1 % ADLER_MOD_BASE);
+}
+
+void
+svn__adler32_blocks(apr_uint32_t *sums,
+                    const char *data,
+                    apr_size_t block_size,
+                    apr_size_t count)
+{
+  const unsigned char *input = (const unsigned char *)data;
+  block_kernel_t kernel = block_size >= BLOCK_SIZE ? simd_kernel() : NULL;
+  apr_size_t i;
+
+  if (kernel == NULL)
+    kernel = blocks_scalar;
+
+  for (i = 0; i < count; ++i)
     {
-      const unsigned char *input = (const unsigned char *)data;
-      apr_uint32_t s1 = checksum & 0xFFFF;
-      apr_uint32_t s2 = checksum >> 16;
-      apr_uint32_t b;
-
-      /* Some loop unrolling
-       * (approx. one clock tick per byte + 2 ticks loop overhead)
-       */
-      for (; len >= 8; len -= 8, input += 8)
+      apr_uint32_t s1 = 0;
+      apr_uint32_t s2 = 0;
+      apr_size_t remaining = block_size;
+
+      /* Since the results are taken modulo 2^32 anyway, we don't need
+       * to reduce the sums in between.  Chunking only protects the
+       * kernels' internal lanes. */
+      while (remaining >= BLOCK_SIZE)
         {
-          s1 += input[0]; s2 += s1;
-          s1 += input[1]; s2 += s1;
-          s1 += input[2]; s2 += s1;
-          s1 += input[3]; s2 += s1;
-          s1 += input[4]; s2 += s1;
-          s1 += input[5]; s2 += s1;
-          s1 += input[6]; s2 += s1;
-          s1 += input[7]; s2 += s1;
+          apr_size_t blocks = remaining / BLOCK_SIZE;
+          if (blocks > MAX_BLOCKS)
+            blocks = MAX_BLOCKS;
+
+          kernel(&s1, &s2, input, blocks);
+          input += blocks * BLOCK_SIZE;
+          remaining -= blocks * BLOCK_SIZE;
         }
 
-      /* Adler-32 calculation as a simple two ticks per iteration loop.
-       */
-      while (len--)
+      for (; remaining; --remaining)
         {
-          b = *input++;
-          s1 += b;
+          s1 += *input++;
           s2 += s1;
         }
 
-      return ((s2 % ADLER_MOD_BASE) << 16) | (s1 % ADLER_MOD_BASE);
+      sums[i] = s2 * 0x10000 + s1;
     }
 }
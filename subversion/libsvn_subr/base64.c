@@ -33,8 +33,16 @@
 #include "svn_io.h"
 #include "svn_error.h"
 #include "svn_base64.h"
+#include "svn_sorts.h"
 #include "private/svn_string_private.h"
 #include "private/svn_subr_private.h"
+#include "private/svn_cpu.h"
+
+#if defined(SVN__SIMD_X86)
+#  include <immintrin.h>
+#elif defined(SVN__SIMD_NEON)
+#  include <arm_neon.h>
+#endif
 
 /* When asked to format the base64-encoded output as multiple lines,
    we put this many chars in each line (plus one new line char) unless
@@ -85,30 +93,246 @@ encode_group(const unsigned char *in, char *out)
   out[3] = base64tab[part2 & 0x3f];
 }
 
-/* Base64-encode a line, i.e. BYTES_PER_LINE bytes from DATA into
-   BASE64_LINELEN chars and append it to STR.  It does not assume that
-   a new line char will be appended, though.
+#if defined(SVN__SIMD_X86)
+
+/* Return the 16 six-bit values of the 12 bytes at the start of IN, each
+   in its own byte.  This is the same bit shuffling as in encode_group. */
+SVN__TARGET("ssse3")
+static APR_INLINE __m128i
+encode_unpack_ssse3(__m128i in)
+{
+  __m128i t0, t1, t2, t3;
+
+  /* Every 32 bit word gets the 3 input bytes for one output group, in
+     the order that lets us extract the 6 bit values with shifts. */
+  in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                         4, 5, 3, 4, 1, 2, 0, 1));
+
+  /* Move the 1st and 3rd value to their target bytes ... */
+  t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+  t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+
+  /* ... and the 2nd and 4th value as well. */
+  t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+  t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+  return _mm_or_si128(t1, t3);
+}
+
+/* Translate the six-bit VALUES into base64tab chars.  Instead of a table
+   lookup, we determine the range every value falls into and add the
+   offset of that range in the ASCII table. */
+SVN__TARGET("ssse3")
+static APR_INLINE __m128i
+encode_translate_ssse3(__m128i values)
+{
+  const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '+' - 62,
+                                        '/' - 63, 'A', 0, 0);
+
+  /* 0..25 -> 13, 26..51 -> 0, 52..63 -> 1..12 */
+  __m128i range = _mm_subs_epu8(values, _mm_set1_epi8(51));
+  __m128i is_upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), values);
+  range = _mm_or_si128(range, _mm_and_si128(is_upper, _mm_set1_epi8(13)));
+
+  return _mm_add_epi8(values, _mm_shuffle_epi8(offsets, range));
+}
+
+/* SSSE3 implementation of encode_simd(). */
+SVN__TARGET("ssse3")
+static apr_size_t
+encode_ssse3(const unsigned char *in, char *out, apr_size_t len)
+{
+  const unsigned char *start = in;
+
+  /* We read 16 bytes but only consume 12 of them. */
+  for (; len >= 16; in += 12, out += 16, len -= 12)
+    {
+      __m128i data = _mm_loadu_si128((const __m128i *)in);
+      data = encode_translate_ssse3(encode_unpack_ssse3(data));
+      _mm_storeu_si128((__m128i *)out, data);
+    }
+
+  return in - start;
+}
+
+/* AVX2 implementation of encode_simd(). */
+SVN__TARGET("avx2")
+static apr_size_t
+encode_avx2(const unsigned char *in, char *out, apr_size_t len)
+{
+  const unsigned char *start = in;
+  const __m256i offsets
+    = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                       '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                       '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                       'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                       '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                       '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  const __m256i spread
+    = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                      10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+
+  /* Same as encode_ssse3 but with 12 input bytes per 128 bit lane. */
+  for (; len >= 28; in += 24, out += 32, len -= 24)
+    {
+      __m256i data, t0, t1, t2, t3, range, is_upper;
+
+      data = _mm256_inserti128_si256(
+               _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)in)),
+               _mm_loadu_si128((const __m128i *)(in + 12)), 1);
+      data = _mm256_shuffle_epi8(data, spread);
+
+      t0 = _mm256_and_si256(data, _mm256_set1_epi32(0x0fc0fc00));
+      t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+      t2 = _mm256_and_si256(data, _mm256_set1_epi32(0x003f03f0));
+      t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+      data = _mm256_or_si256(t1, t3);
+
+      range = _mm256_subs_epu8(data, _mm256_set1_epi8(51));
+      is_upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), data);
+      range = _mm256_or_si256(range,
+                              _mm256_and_si256(is_upper,
+                                               _mm256_set1_epi8(13)));
+      data = _mm256_add_epi8(data, _mm256_shuffle_epi8(offsets, range));
+
+      _mm256_storeu_si256((__m256i *)out, data);
+    }
+
+  /* At most one 128 bit block left. */
+  if (len >= 16)
+    {
+      __m128i data = _mm_loadu_si128((const __m128i *)in);
+      data = encode_translate_ssse3(encode_unpack_ssse3(data));
+      _mm_storeu_si128((__m128i *)out, data);
+      in += 12;
+    }
+
+  return in - start;
+}
+
+#elif defined(SVN__SIMD_NEON)
+
+/* NEON implementation of encode_simd(). */
+static apr_size_t
+encode_neon(const unsigned char *in, char *out, apr_size_t len)
+{
+  const unsigned char *start = in;
+  uint8x16x4_t table;
+
+  table.val[0] = vld1q_u8((const unsigned char *)base64tab);
+  table.val[1] = vld1q_u8((const unsigned char *)base64tab + 16);
+  table.val[2] = vld1q_u8((const unsigned char *)base64tab + 32);
+  table.val[3] = vld1q_u8((const unsigned char *)base64tab + 48);
+
+  /* De-interleave 16 groups of 3 bytes and write 16 groups of 4 chars. */
+  for (; len >= 48; in += 48, out += 64, len -= 48)
+    {
+      uint8x16x3_t data = vld3q_u8(in);
+      uint8x16x4_t result;
+
+      result.val[0] = vshrq_n_u8(data.val[0], 2);
+      result.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(data.val[0], 4),
+                                        vshrq_n_u8(data.val[1], 4)),
+                               vdupq_n_u8(0x3f));
+      result.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(data.val[1], 2),
+                                        vshrq_n_u8(data.val[2], 6)),
+                               vdupq_n_u8(0x3f));
+      result.val[3] = vandq_u8(data.val[2], vdupq_n_u8(0x3f));
+
+      result.val[0] = vqtbl4q_u8(table, result.val[0]);
+      result.val[1] = vqtbl4q_u8(table, result.val[1]);
+      result.val[2] = vqtbl4q_u8(table, result.val[2]);
+      result.val[3] = vqtbl4q_u8(table, result.val[3]);
+
+      vst4q_u8((unsigned char *)out, result);
+    }
+
+  return in - start;
+}
+
+#endif
+
+/* Base64-encode as many whole blocks from the LEN bytes at IN into OUT as
+   the SIMD kernels supported by this machine can handle.  Never read
+   beyond IN + LEN.  Return the number of bytes consumed, which is always
+   a multiple of 3, i.e. the number of chars written is 4/3 of that. */
+static APR_INLINE apr_size_t
+encode_simd(const unsigned char *in, char *out, apr_size_t len)
+{
+#if defined(SVN__SIMD_X86)
+  apr_uint32_t features = svn_cpu__features();
+  if (features & SVN_CPU__AVX2)
+    return encode_avx2(in, out, len);
+  if (features & SVN_CPU__SSSE3)
+    return encode_ssse3(in, out, len);
+#elif defined(SVN__SIMD_NEON)
+  if (svn_cpu__features() & SVN_CPU__NEON)
+    return encode_neon(in, out, len);
+#endif
+
+  return 0;
+}
+
+/* Allowing the encoder kernels to read this many bytes beyond the line
+   end lets them cover the whole line, e.g. 5 blocks of 12 bytes for the
+   SSSE3 kernel. */
+#define LINE_AHEAD 7
+
+/* Base64-encode COUNT lines, i.e. COUNT * BYTES_PER_LINE bytes from DATA
+   into COUNT * BASE64_LINELEN chars and append them to STR.  If
+   BREAK_LINES is set, terminate each line with a new line char.
    The code in this function will simply transform the data without
    performing any boundary checks.  Therefore, DATA must have at least
-   BYTES_PER_LINE left and space for at least another BASE64_LINELEN
-   chars must have been pre-allocated in STR before calling this
-   function. */
+   COUNT * BYTES_PER_LINE left and space for at least another
+   COUNT * (BASE64_LINELEN + 1) chars must have been pre-allocated in STR
+   before calling this function. */
 static void
-encode_line(svn_stringbuf_t *str, const char *data)
+encode_lines(svn_stringbuf_t *str, const char *data, apr_size_t count,
+             svn_boolean_t break_lines)
 {
   /* Translate directly from DATA to STR->DATA. */
   const unsigned char *in = (const unsigned char *)data;
   char *out = str->data + str->len;
-  char *end = out + BASE64_LINELEN;
+  apr_size_t line_bytes = BYTES_PER_LINE;
+  char *line_end;
+  apr_size_t done;
 
-  /* We assume that BYTES_PER_LINE is a multiple of 3 and BASE64_LINELEN
-     a multiple of 4. */
-  for ( ; out != end; in += 3, out += 4)
-    encode_group(in, out);
+  /* Without line breaks, the output is one long line. */
+  if (!break_lines)
+    {
+      line_bytes *= count;
+      count = 1;
+    }
+
+  for (; count > 0; --count)
+    {
+      line_end = out + line_bytes / 3 * 4;
+
+      /* Most of the data can be handled by the SIMD kernels.  Unless
+         this is the last line, we may let them read up to LINE_AHEAD
+         bytes from the next line as well.  Their output for those will
+         be overwritten by the new line char and the next line. */
+      done = encode_simd(in, out, count > 1 ? line_bytes + LINE_AHEAD
+                                            : line_bytes);
+      done = MIN(done, line_bytes);
+      in += done;
+      out += done / 3 * 4;
+
+      /* We assume that BYTES_PER_LINE is a multiple of 3 and
+         BASE64_LINELEN a multiple of 4. */
+      for ( ; out != line_end; in += 3, out += 4)
+        encode_group(in, out);
+
+      if (break_lines)
+        *out++ = '\n';
+    }
 
   /* Expand and terminate the string. */
   *out = '\0';
-  str->len += BASE64_LINELEN;
+  str->len = out - str->data;
 }
 
 /* (Continue to) Base64-encode the byte string DATA (of length LEN)
@@ -150,10 +374,13 @@ encode_bytes(svn_stringbuf_t *str, const void *data, apr_size_t len,
           && (*linelen == 0 || !break_lines)
           && (end - p >= BYTES_PER_LINE))
         {
-          /* Yes, we can encode a whole chunk of data at once. */
-          encode_line(str, p);
-          p += BYTES_PER_LINE;
-          *linelen += BASE64_LINELEN;
+          /* Yes, we can encode all whole lines at once. */
+          apr_size_t count = (end - p) / BYTES_PER_LINE;
+
+          encode_lines(str, p, count, break_lines);
+          p += count * BYTES_PER_LINE;
+          if (!break_lines)
+            *linelen += count * BASE64_LINELEN;
         }
       else
         {
@@ -361,6 +588,238 @@ decode_group_directly(const unsigned char *in, char *out)
   return (part0 | part1 | part2 | part3) != (unsigned char)(-1);
 }
 
+#if defined(SVN__SIMD_X86)
+
+/* Translate the 16 base64 chars in IN into their six-bit values and
+   return them in *VALUES.  Return FALSE if any of them is not a base64
+   char, e.g. a new line or '='.  The validation uses the low and high
+   nibble of each char to look up bit sets of the character classes
+   they may belong to; only valid chars yield a common class. */
+SVN__TARGET("ssse3")
+static APR_INLINE svn_boolean_t
+decode_translate_ssse3(__m128i in, __m128i *values)
+{
+  const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                       0x11, 0x11, 0x11, 0x11, 0x13, 0x1a,
+                                       0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08,
+                                       0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+                                       0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                         0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask_2f = _mm_set1_epi8(0x2f);
+
+  __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+  __m128i lo_nibbles = _mm_and_si128(in, mask_2f);
+  __m128i classes = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles),
+                                  _mm_shuffle_epi8(lut_hi, hi_nibbles));
+  __m128i roll;
+
+  if (_mm_movemask_epi8(_mm_cmpgt_epi8(classes, _mm_setzero_si128())))
+    return FALSE;
+
+  /* The offset to add depends on the high nibble only, except for '/'. */
+  roll = _mm_add_epi8(_mm_cmpeq_epi8(in, mask_2f), hi_nibbles);
+  *values = _mm_add_epi8(in, _mm_shuffle_epi8(lut_roll, roll));
+
+  return TRUE;
+}
+
+/* Pack the four six-bit VALUES in every 32 bit word into three bytes and
+   return them as the first 12 bytes.  This is what decode_group does. */
+SVN__TARGET("ssse3")
+static APR_INLINE __m128i
+decode_pack_ssse3(__m128i values)
+{
+  __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+
+  return _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4,
+                                                10, 9, 8, 14, 13, 12,
+                                                -1, -1, -1, -1));
+}
+
+/* Write the first 12 bytes of DATA to OUT. */
+SVN__TARGET("ssse3")
+static APR_INLINE void
+store_12_bytes(char *out, __m128i data)
+{
+  apr_uint32_t last = (apr_uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(data,
+                                                                     8));
+  _mm_storel_epi64((__m128i *)out, data);
+  memcpy(out + 8, &last, sizeof(last));
+}
+
+/* SSSE3 implementation of decode_simd(). */
+SVN__TARGET("ssse3")
+static apr_size_t
+decode_ssse3(const unsigned char *in, char *out, apr_size_t len)
+{
+  const unsigned char *start = in;
+
+  for (; len >= 16; in += 16, out += 12, len -= 16)
+    {
+      __m128i values;
+      if (!decode_translate_ssse3(_mm_loadu_si128((const __m128i *)in),
+                                  &values))
+        break;
+
+      store_12_bytes(out, decode_pack_ssse3(values));
+    }
+
+  return in - start;
+}
+
+/* AVX2 implementation of decode_simd(). */
+SVN__TARGET("avx2")
+static apr_size_t
+decode_avx2(const unsigned char *in, char *out, apr_size_t len)
+{
+  const unsigned char *start = in;
+  const __m256i lut_lo
+    = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                       0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+                       0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                       0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m256i lut_hi
+    = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                       0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                       0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                       0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lut_roll
+    = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                       0, 0, 0, 0, 0, 0, 0, 0,
+                       0, 16, 19, 4, -65, -65, -71, -71,
+                       0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i pack
+    = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                       -1, -1, -1, -1,
+                       2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                       -1, -1, -1, -1);
+  const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+
+  /* Same as decode_ssse3 but with 32 chars per iteration. */
+  for (; len >= 32; in += 32, out += 24, len -= 32)
+    {
+      __m256i data = _mm256_loadu_si256((const __m256i *)in);
+      __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(data, 4),
+                                            mask_2f);
+      __m256i lo_nibbles = _mm256_and_si256(data, mask_2f);
+      __m256i classes
+        = _mm256_and_si256(_mm256_shuffle_epi8(lut_lo, lo_nibbles),
+                           _mm256_shuffle_epi8(lut_hi, hi_nibbles));
+      __m256i roll;
+
+      if (_mm256_movemask_epi8(_mm256_cmpgt_epi8(classes,
+                                                 _mm256_setzero_si256())))
+        break;
+
+      roll = _mm256_add_epi8(_mm256_cmpeq_epi8(data, mask_2f), hi_nibbles);
+      data = _mm256_add_epi8(data, _mm256_shuffle_epi8(lut_roll, roll));
+
+      data = _mm256_maddubs_epi16(data, _mm256_set1_epi32(0x01400140));
+      data = _mm256_madd_epi16(data, _mm256_set1_epi32(0x00011000));
+      data = _mm256_shuffle_epi8(data, pack);
+
+      /* Move the 12 result bytes of the upper lane next to the lower. */
+      data = _mm256_permutevar8x32_epi32(data,
+                                         _mm256_setr_epi32(0, 1, 2, 4,
+                                                           5, 6, 7, 7));
+      _mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(data));
+      _mm_storel_epi64((__m128i *)(out + 16),
+                       _mm256_extracti128_si256(data, 1));
+    }
+
+  /* At most one 128 bit block left. */
+  if (len >= 16)
+    {
+      __m128i values;
+      if (decode_translate_ssse3(_mm_loadu_si128((const __m128i *)in),
+                                 &values))
+        {
+          store_12_bytes(out, decode_pack_ssse3(values));
+          in += 16;
+        }
+    }
+
+  return in - start;
+}
+
+#elif defined(SVN__SIMD_NEON)
+
+/* Translate the base64 chars in IN into their six-bit values using the
+   128 entry TABLE.  Invalid chars will be translated to 0xff. */
+static APR_INLINE uint8x16_t
+decode_translate_neon(uint8x16_t in, const uint8x16x4_t table[2])
+{
+  /* Out-of-range indexes leave the first operand untouched. */
+  uint8x16_t result = vqtbx4q_u8(vdupq_n_u8(0xff), table[0], in);
+  return vqtbx4q_u8(result, table[1], vsubq_u8(in, vdupq_n_u8(64)));
+}
+
+/* NEON implementation of decode_simd(). */
+static apr_size_t
+decode_neon(const unsigned char *in, char *out, apr_size_t len)
+{
+  const unsigned char *start = in;
+  const unsigned char *lut = (const unsigned char *)reverse_base64;
+  uint8x16x4_t table[2];
+  int i;
+
+  for (i = 0; i < 4; ++i)
+    {
+      table[0].val[i] = vld1q_u8(lut + 16 * i);
+      table[1].val[i] = vld1q_u8(lut + 64 + 16 * i);
+    }
+
+  /* De-interleave 16 groups of 4 chars and write 16 groups of 3 bytes. */
+  for (; len >= 64; in += 64, out += 48, len -= 64)
+    {
+      uint8x16x4_t data = vld4q_u8(in);
+      uint8x16x3_t result;
+      uint8x16_t a = decode_translate_neon(data.val[0], table);
+      uint8x16_t b = decode_translate_neon(data.val[1], table);
+      uint8x16_t c = decode_translate_neon(data.val[2], table);
+      uint8x16_t d = decode_translate_neon(data.val[3], table);
+
+      if (vmaxvq_u8(vorrq_u8(vorrq_u8(a, b), vorrq_u8(c, d))) > 63)
+        break;
+
+      result.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+      result.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+      result.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+
+      vst3q_u8((unsigned char *)out, result);
+    }
+
+  return in - start;
+}
+
+#endif
+
+/* Base64-decode as many whole blocks from the LEN chars at IN into OUT as
+   the SIMD kernels supported by this machine can handle.  Stop at the
+   first block that contains any non-base64 char, including new lines and
+   '='.  Never read beyond IN + LEN.  Return the number of chars consumed,
+   which is always a multiple of 4, i.e. the number of bytes written is
+   3/4 of that. */
+static APR_INLINE apr_size_t
+decode_simd(const unsigned char *in, char *out, apr_size_t len)
+{
+#if defined(SVN__SIMD_X86)
+  apr_uint32_t features = svn_cpu__features();
+  if (features & SVN_CPU__AVX2)
+    return decode_avx2(in, out, len);
+  if (features & SVN_CPU__SSSE3)
+    return decode_ssse3(in, out, len);
+#elif defined(SVN__SIMD_NEON)
+  if (svn_cpu__features() & SVN_CPU__NEON)
+    return decode_neon(in, out, len);
+#endif
+
+  return 0;
+}
+
 /* Base64-encode up to BASE64_LINELEN chars from *DATA and append it to
    STR.  After the function returns, *DATA will point to the first char
    that has not been translated, yet.  Returns TRUE if all BASE64_LINELEN
@@ -378,6 +837,12 @@ decode_line(svn_stringbuf_t *str, const char **data)
   const unsigned char *p = *(const unsigned char **)data;
   char *out = str->data + str->len;
   char *end = out + BYTES_PER_LINE;
+  apr_size_t done;
+
+  /* Most of the line can be handled by the SIMD kernels. */
+  done = decode_simd(p, out, BASE64_LINELEN);
+  p += done;
+  out += done / 4 * 3;
 
   /* We assume that BYTES_PER_LINE is a multiple of 3 and BASE64_LINELEN
      a multiple of 4.  Stop translation as soon as we encounter a special
@@ -431,8 +896,31 @@ decode_bytes(svn_stringbuf_t *str, const char *data, apr_size_t len,
          one line-sized chunk left to decode, we may use the optimized
          code path. */
       if ((*inbuflen == 0) && (end - p >= BASE64_LINELEN))
-        if (decode_line(str, &p))
-          continue;
+        {
+          /* Data without line breaks can be decoded in bulk, up to the
+             next special char. */
+          if (end - p > BASE64_LINELEN && p[BASE64_LINELEN] != '\n')
+            {
+              apr_size_t consumed = decode_simd((const unsigned char *)p,
+                                                str->data + str->len,
+                                                end - p);
+              p += consumed;
+              str->len += consumed / 4 * 3;
+              str->data[str->len] = '\0';
+
+              if (p == end)
+                break;
+            }
+
+          if ((end - p >= BASE64_LINELEN) && decode_line(str, &p))
+            {
+              /* Skip the line break that usually follows. */
+              if (p < end && *p == '\n')
+                ++p;
+
+              continue;
+            }
+        }
 
       /* A special case or decode_line encountered a special char. */
       if (*p == '=')
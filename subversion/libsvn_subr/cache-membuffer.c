@@ -23,10 +23,14 @@
 
 #include <assert.h>
 #include <apr_md5.h>
+#include <apr_shm.h>
 #include <apr_thread_rwlock.h>
+#include <apr_time.h>
 
 #include "svn_pools.h"
 #include "svn_checksum.h"
+#include "svn_dirent_uri.h"
+#include "svn_io.h"
 #include "svn_private_config.h"
 #include "svn_hash.h"
 #include "svn_string.h"
@@ -35,6 +39,7 @@
 #include "private/svn_atomic.h"
 #include "private/svn_dep_compat.h"
 #include "private/svn_mutex.h"
+#include "private/svn_sorts_private.h"
 #include "private/svn_subr_private.h"
 #include "private/svn_string_private.h"
 
@@ -106,6 +111,14 @@
  * with new entries. For details on the fine-tuning involved, see the
  * comments in ensure_data_insertable_l2().
  *
+ * With the "frequency" admission policy, the entry hit counts in the L2
+ * eviction decisions get replaced by access frequency estimates.  These
+ * are kept in a small count-min sketch per segment, similar to TinyLFU,
+ * and also cover keys that are not (or no longer) in cache.  Entries
+ * evicted from L1 must then have been requested more often than the L2
+ * entries they would replace.  Large scans over data that is read only
+ * once will therefore not flush the frequently used entries from L2.
+ *
  * Due to the randomized mapping of keys to entry groups, some groups may
  * overflow.  In that case, there are spare groups that can be chained to
  * an already used group to extend it.
@@ -129,6 +142,27 @@
  * to scale well despite that bottleneck, we simply segment the cache into
  * a number of independent caches (segments). Items will be multiplexed based
  * on their hash key.
+ *
+ * Readers don't need to take the segment lock, though.  Every segment has
+ * a sequence number that writers increment before and after modifying it,
+ * i.e. it is odd while a modification is in progress.  Readers copy the
+ * data they need and then check that the sequence number is still even and
+ * unchanged.  Because the data may be modified concurrently, all indexes
+ * and offsets read that way get validated before use.  Only if that
+ * optimistic read collides with a writer, we take the read lock.
+ *
+ * Pre-fork servers may place the whole cache - segment headers, directory
+ * and data buffers - into an anonymous shared memory block before forking
+ * their worker processes.  Since all processes see that block at the same
+ * address, the pointers within the headers remain valid.  The thread locks
+ * are replaced by a robust, process-shared mutex in each segment header,
+ * then.  Writers take that mutex.  If a process dies while holding it, the
+ * next one to acquire it will find out.  If the dead process was in the
+ * middle of a modification, i.e. the sequence number is odd, the segment
+ * gets reset.  Data readers never take the mutex.  They only use the
+ * lock-free code path and report a cache miss if that keeps colliding
+ * with writers.  Prefix indexes would be assigned independently in each
+ * process, so shared caches don't use them and always store the full keys.
  */
 
 /* APR's read-write lock implementation on Windows is horribly inefficient.
@@ -146,6 +180,73 @@
 #  define USE_SIMPLE_MUTEX 0
 #endif
 
+/* Optimistic (lock-free) reads require us to order memory reads w.r.t.
+ * the segment's sequence number.  Define READ_BARRIER where we know how
+ * to do that.
+ *
+ * The SVN_DEBUG_CACHE_MEMBUFFER checks verify the entry tags in-place,
+ * which is not compatible with data that may change under our feet.
+ */
+#if defined(SVN_DEBUG_CACHE_MEMBUFFER)
+#  define OPTIMISTIC_READS 0
+#elif defined(__clang__) \
+   || (defined(__GNUC__) \
+       && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+#  define OPTIMISTIC_READS 1
+#  define READ_BARRIER() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <intrin.h>
+#  define OPTIMISTIC_READS 1
+   /* x86 does not reorder loads w.r.t. other loads.  So, we only need to
+    * keep the compiler from doing that. */
+#  define READ_BARRIER() _ReadBarrier()
+#else
+#  define OPTIMISTIC_READS 0
+#endif
+
+/* Shared caches rely on memory inherited through fork() and on mutexes
+ * that can be recovered when their owner dies.  Their readers can only
+ * use the lock-free code path.
+ */
+#if APR_HAS_SHARED_MEMORY && APR_HAS_FORK \
+ && defined(HAVE_PTHREAD_MUTEX_CONSISTENT) && OPTIMISTIC_READS
+#  define SHARED_CACHE_SUPPORTED 1
+#  include <errno.h>
+#  include <pthread.h>
+#else
+#  define SHARED_CACHE_SUPPORTED 0
+#endif
+
+/* Number of counters that we update per key in the access frequency
+ * sketch.
+ */
+#define SKETCH_DEPTH 4
+
+/* Access frequency counters saturate at this value.  As TinyLFU shows,
+ * we only need to tell rarely used from frequently used keys.
+ */
+#define MAX_FREQUENCY 15
+
+/* Halve all access frequency counters after this many accesses per
+ * counter.  This makes old accesses count less than recent ones.
+ */
+#define SKETCH_SAMPLES_PER_COUNTER 4
+
+/* Number of lock-free lookup attempts in shared cache segments before we
+ * report a cache miss.
+ */
+#define SHARED_READ_ATTEMPTS 8
+
+/* Number of optimistic lookup attempts before we take the read lock.
+ */
+#define OPTIMISTIC_READ_ATTEMPTS 2
+
+/* Partial getters work on the cached data in-place.  Optimistic reads
+ * need to copy it to the stack first, which we do for items up to this
+ * size only.
+ */
+#define MAX_OPTIMISTIC_PARTIAL_SIZE 0x1000
+
 /* For more efficient copy operations, let's align all data items properly.
  * Since we can't portably align pointers, this is rather the item size
  * granularity which ensures *relative* alignment within the cache - still
@@ -692,6 +793,92 @@ typedef struct cache_level_t
 
 } cache_level_t;
 
+/* A section of a loaded snapshot that has not been copied into the cache,
+ * yet.  See svn_cache__membuffer_load().
+ */
+typedef struct snapshot_section_t
+{
+  /* Key root of all entries in this section. */
+  const char *root;
+
+  /* Path of the snapshot file. */
+  const char *path;
+
+  /* Random ID of the snapshot.  Allows us to detect whether the file at
+   * PATH got replaced.
+   */
+  const char *id;
+
+  /* Stamp of all entries in this section. */
+  const char *stamp;
+
+  /* Offset of this section within the snapshot file. */
+  apr_off_t offset;
+
+  /* Size of this section in bytes. */
+  apr_off_t length;
+
+  /* Checksum over all LENGTH bytes of this section. */
+  const svn_checksum_t *checksum;
+} snapshot_section_t;
+
+/* Process-local information about the snapshot loaded into a cache.
+ */
+typedef struct snapshot_t
+{
+  /* Map key root (const char *) to the snapshot_section_t * to import
+   * once that root's stamp gets confirmed.  NULL if no snapshot has been
+   * loaded.
+   */
+  apr_hash_t *sections;
+
+  /* Allocates SECTIONS and its contents.  Gets cleared upon reload. */
+  apr_pool_t *pool;
+
+  /* Set once svn_cache__membuffer_load() has been called, even if that
+   * failed.  Only then do stamps need to be maintained.  This gets set
+   * during startup and only read afterwards; it needs no locking.
+   */
+  svn_boolean_t enabled;
+
+  /* Serializes access to all of the above. */
+  svn_mutex__t *mutex;
+} snapshot_t;
+
+/* Maximum number of key prefixes that get their own access statistics.
+ * Once we reached that limit, all further prefixes will share a single
+ * record.  This caps the memory used e.g. for per-transaction caches.
+ */
+#define MAX_PREFIX_STATS 1000
+
+/* For the latency histograms, time only one in this many cache accesses.
+ */
+#define LATENCY_SAMPLING_INTERVAL 16
+
+/* Process-local registry of the per-prefix access statistics.  Records
+ * never get removed, so pointers to them remain valid for the lifetime of
+ * the cache.
+ */
+typedef struct prefix_stats_t
+{
+  /* Map prefix (const char *) to svn_cache__prefix_info_t *. */
+  apr_hash_t *map;
+
+  /* Statistics for the prefixes in the prefix pool, indexed like its
+   * VALUES array.  Once set, elements never change and may be read
+   * without taking the MUTEX.  NULL if the prefix pool is empty.
+   */
+  svn_cache__prefix_info_t **by_index;
+
+  /* Shared by all prefixes that came after the first MAX_PREFIX_STATS.
+   * NULL until needed.
+   */
+  svn_cache__prefix_info_t *other;
+
+  /* Serializes access to all of the above. */
+  svn_mutex__t *mutex;
+} prefix_stats_t;
+
 /* The cache header structure.
  */
 struct svn_membuffer_t
@@ -796,6 +983,14 @@ struct svn_membuffer_t
    */
   apr_uint64_t total_hits;
 
+  /* Number of lookups resp. hits served by optimistic_lookup(), i.e.
+   * without holding the segment lock.  Updated atomically and added to
+   * TOTAL_READS resp. TOTAL_HITS when reporting statistics.  Like those,
+   * they are for profiling only and may wrap around.
+   */
+  svn_atomic_t lock_free_reads;
+  svn_atomic_t lock_free_hits;
+
 #if (APR_HAS_THREADS && USE_SIMPLE_MUTEX)
   /* A lock for intra-process synchronization to the cache, or NULL if
    * the cache's creator doesn't feel the cache needs to be
@@ -805,29 +1000,214 @@ struct svn_membuffer_t
 #elif (APR_HAS_THREADS && !USE_SIMPLE_MUTEX)
   /* Same for read-write lock. */
   apr_thread_rwlock_t *lock;
+#endif
 
   /* If set, write access will wait until they get exclusive access.
    * Otherwise, they will become no-ops if the segment is currently
-   * read-locked.  Only used when LOCK is an r/w lock.
+   * read-locked.  Only used when LOCK is an r/w lock or for shared
+   * segments.
    */
   svn_boolean_t allow_blocking_writes;
-#endif
 
   /* A write lock counter, must be either 0 or 1.
    * This one is only used in debug assertions to verify that you used
    * the correct multi-threading settings. */
   svn_atomic_t write_lock_count;
+
+  /* Modification sequence number.  Incremented by writers before and
+   * after every modification of this segment, i.e. an odd value means
+   * that the segment is being modified.  See read_sequence().
+   */
+  volatile svn_atomic_t sequence;
+
+  /* If not set, readers will always take the segment lock.
+   */
+  svn_boolean_t optimistic_reads;
+
+  /* If set, this segment lives in memory shared with other processes and
+   * SHARED_LOCK is being used instead of LOCK.
+   */
+  svn_boolean_t shared;
+
+#if SHARED_CACHE_SUPPORTED
+  /* Robust, process-shared mutex for shared segments.  Only writers and
+   * the administrative functions take it.
+   */
+  pthread_mutex_t shared_lock;
+#endif
+
+  /* Selects how entries get ranked when making room in L2.
+   */
+  svn_cache__admission_policy_t admission_policy;
+
+  /* Count-min sketch of the key access frequencies, FREQUENCY_MASK + 1
+   * saturating counters.  Only maintained for the "frequency" admission
+   * policy.  Updates are not synchronized, i.e. races may cause small
+   * errors in the estimates.  That is acceptable for a heuristics.
+   */
+  unsigned char *frequencies;
+
+  /* Number of counters in FREQUENCIES minus 1.  Must be 2^N - 1.
+   */
+  apr_uint32_t frequency_mask;
+
+  /* Number of accesses recorded in FREQUENCIES since we last aged them.
+   * Updated atomically since record_access() does not take any lock.
+   */
+  volatile svn_atomic_t frequency_samples;
+
+  /* The snapshot to reload data from.  Like the PREFIX_POOL, this is
+   * process-local and the same for all segments.
+   */
+  snapshot_t *snapshot;
+
+  /* Per-prefix access statistics.  Like the PREFIX_POOL, this is
+   * process-local and the same for all segments.
+   */
+  prefix_stats_t *prefix_stats;
 };
 
 /* Align integer VALUE to the next ITEM_ALIGNMENT boundary.
  */
 #define ALIGN_VALUE(value) (((value) + ITEM_ALIGNMENT-1) & -ITEM_ALIGNMENT)
 
+/* Drop all contents of segment CACHE.  The caller must hold the write lock
+ * and have called begin_modification().
+ */
+static void
+reset_segment(svn_membuffer_t *cache)
+{
+  /* Length of the group_initialized array in bytes.
+     See also svn_cache__membuffer_cache_create(). */
+  apr_size_t group_init_size
+    = 1 + (cache->group_count + cache->spare_group_count)
+            / (8 * GROUP_INIT_GRANULARITY);
+
+  /* Mark all groups as "not initialized", which implies "empty". */
+  cache->first_spare_group = NO_INDEX;
+  cache->max_spare_used = 0;
+
+  memset(cache->group_initialized, 0, group_init_size);
+
+  /* Unlink L1 contents. */
+  cache->l1.first = NO_INDEX;
+  cache->l1.last = NO_INDEX;
+  cache->l1.next = NO_INDEX;
+  cache->l1.current_data = cache->l1.start_offset;
+
+  /* Unlink L2 contents. */
+  cache->l2.first = NO_INDEX;
+  cache->l2.last = NO_INDEX;
+  cache->l2.next = NO_INDEX;
+  cache->l2.current_data = cache->l2.start_offset;
+
+  /* Reset content counters.  The per-prefix ones are up to the caller. */
+  cache->data_used = 0;
+  cache->used_entries = 0;
+
+  /* Forget access history. */
+  memset(cache->frequencies, 0, cache->frequency_mask + 1);
+  svn_atomic_set(&cache->frequency_samples, 0);
+}
+
+#if SHARED_CACHE_SUPPORTED
+
+/* Acquire the mutex of the shared segment CACHE.  If TRY_ONLY is set and
+ * the mutex is currently held by someone else, set *SUCCESS to FALSE.
+ * Otherwise, leave *SUCCESS untouched.
+ *
+ * If the previous owner died while holding the mutex, make the mutex
+ * usable again.  If that owner was in the middle of a modification, the
+ * segment contents can't be trusted anymore and will be dropped.
+ */
+static svn_error_t *
+lock_shared_segment(svn_membuffer_t *cache,
+                    svn_boolean_t try_only,
+                    svn_boolean_t *success)
+{
+  int rc = try_only ? pthread_mutex_trylock(&cache->shared_lock)
+                    : pthread_mutex_lock(&cache->shared_lock);
+
+  if (try_only && rc == EBUSY)
+    {
+      *success = FALSE;
+      return SVN_NO_ERROR;
+    }
+
+  if (rc == EOWNERDEAD)
+    {
+      if (svn_atomic_read(&cache->sequence) & 1)
+        {
+          reset_segment(cache);
+          svn_atomic_inc(&cache->sequence);
+        }
+
+      /* The dead owner can't release its debug write lock count anymore. */
+      cache->write_lock_count = 0;
+
+      rc = pthread_mutex_consistent(&cache->shared_lock);
+    }
+
+  if (rc)
+    return svn_error_wrap_apr(APR_FROM_OS_ERROR(rc),
+                              _("Can't lock shared cache mutex"));
+
+  return SVN_NO_ERROR;
+}
+
+/* Release the mutex of the shared segment CACHE.  Return ERR upon success.
+ */
+static svn_error_t *
+unlock_shared_segment(svn_membuffer_t *cache, svn_error_t *err)
+{
+  int rc = pthread_mutex_unlock(&cache->shared_lock);
+  if (err)
+    return err;
+
+  if (rc)
+    return svn_error_wrap_apr(APR_FROM_OS_ERROR(rc),
+                              _("Can't unlock shared cache mutex"));
+
+  return SVN_NO_ERROR;
+}
+
+/* Initialize the robust, process-shared mutex of segment CACHE.
+ */
+static svn_error_t *
+init_shared_segment_lock(svn_membuffer_t *cache)
+{
+  pthread_mutexattr_t attr;
+  int rc = pthread_mutexattr_init(&attr);
+
+  if (!rc)
+    rc = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  if (!rc)
+    rc = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  if (!rc)
+    rc = pthread_mutex_init(&cache->shared_lock, &attr);
+
+  pthread_mutexattr_destroy(&attr);
+  if (rc)
+    return svn_error_wrap_apr(APR_FROM_OS_ERROR(rc),
+                              _("Can't create shared cache mutex"));
+
+  return SVN_NO_ERROR;
+}
+
+#endif /* SHARED_CACHE_SUPPORTED */
+
 /* If locking is supported for CACHE, acquire a read lock for it.
  */
 static svn_error_t *
 read_lock_cache(svn_membuffer_t *cache)
 {
+#if SHARED_CACHE_SUPPORTED
+  /* Only administrative readers get here.  Data lookups in shared
+   * segments never take the lock. */
+  if (cache->shared)
+    return svn_error_trace(lock_shared_segment(cache, FALSE, NULL));
+#endif
+
 #if (APR_HAS_THREADS && USE_SIMPLE_MUTEX)
   return svn_mutex__lock(cache->lock);
 #elif (APR_HAS_THREADS && !USE_SIMPLE_MUTEX)
@@ -851,6 +1231,13 @@ read_lock_cache(svn_membuffer_t *cache)
 static svn_error_t *
 write_lock_cache(svn_membuffer_t *cache, svn_boolean_t *success)
 {
+#if SHARED_CACHE_SUPPORTED
+  if (cache->shared)
+    return svn_error_trace(lock_shared_segment(cache,
+                                               !cache->allow_blocking_writes,
+                                               success));
+#endif
+
 #if (APR_HAS_THREADS && USE_SIMPLE_MUTEX)
   return svn_mutex__lock(cache->lock);
 #elif (APR_HAS_THREADS && !USE_SIMPLE_MUTEX)
@@ -888,6 +1275,11 @@ write_lock_cache(svn_membuffer_t *cache, svn_boolean_t *success)
 static svn_error_t *
 force_write_lock_cache(svn_membuffer_t *cache)
 {
+#if SHARED_CACHE_SUPPORTED
+  if (cache->shared)
+    return svn_error_trace(lock_shared_segment(cache, FALSE, NULL));
+#endif
+
 #if (APR_HAS_THREADS && USE_SIMPLE_MUTEX)
   return svn_mutex__lock(cache->lock);
 #elif (APR_HAS_THREADS && !USE_SIMPLE_MUTEX)
@@ -908,6 +1300,11 @@ force_write_lock_cache(svn_membuffer_t *cache)
 static svn_error_t *
 unlock_cache(svn_membuffer_t *cache, svn_error_t *err)
 {
+#if SHARED_CACHE_SUPPORTED
+  if (cache->shared)
+    return unlock_shared_segment(cache, err);
+#endif
+
 #if (APR_HAS_THREADS && USE_SIMPLE_MUTEX)
   return svn_mutex__unlock(cache->lock, err);
 #elif (APR_HAS_THREADS && !USE_SIMPLE_MUTEX)
@@ -927,6 +1324,25 @@ unlock_cache(svn_membuffer_t *cache, svn_error_t *err)
 #endif
 }
 
+/* Mark CACHE as being modified, i.e. make its sequence number odd.
+ * The caller must hold the write lock.
+ */
+static APR_INLINE void
+begin_modification(svn_membuffer_t *cache)
+{
+  svn_atomic_inc(&cache->sequence);
+}
+
+/* Mark the modification of CACHE as completed, i.e. make its sequence
+ * number even again.  Return ERR.
+ */
+static APR_INLINE svn_error_t *
+end_modification(svn_membuffer_t *cache, svn_error_t *err)
+{
+  svn_atomic_inc(&cache->sequence);
+  return err;
+}
+
 /* If supported, guard the execution of EXPR with a read lock to CACHE.
  * The macro has been modeled after SVN_MUTEX__WITH_LOCK.
  */
@@ -959,7 +1375,9 @@ do {                                                            \
       else                                                      \
         break;                                                  \
     }                                                           \
-  SVN_ERR(unlock_cache(cache, (expr)));                         \
+  begin_modification(cache);                                    \
+  SVN_ERR(unlock_cache(cache,                                   \
+                       end_modification(cache, (expr))));       \
 } while (0)
 
 /* Returns 0 if the entry group identified by GROUP_INDEX in CACHE has not
@@ -1199,6 +1617,125 @@ unchain_entry(svn_membuffer_t *cache,
     get_entry(cache, entry->next)->previous = entry->previous;
 }
 
+/* Set *INFO to the statistics record for PREFIX in STATS and create it if
+ * it does not exist, yet.  PREFIX_IDX is the index of PREFIX in the prefix
+ * pool or NO_INDEX.
+ * To be called by get_prefix_stats() only. */
+static svn_error_t *
+get_prefix_stats_internal(svn_cache__prefix_info_t **info,
+                          prefix_stats_t *stats,
+                          const char *prefix,
+                          apr_uint32_t prefix_idx)
+{
+  apr_pool_t *pool = apr_hash_pool_get(stats->map);
+
+  *info = svn_hash_gets(stats->map, prefix);
+  if (*info == NULL)
+    {
+      if (apr_hash_count(stats->map) < MAX_PREFIX_STATS)
+        {
+          *info = apr_pcalloc(pool, sizeof(**info));
+          (*info)->prefix = apr_pstrdup(pool, prefix);
+          svn_hash_sets(stats->map, (*info)->prefix, *info);
+        }
+      else
+        {
+          if (stats->other == NULL)
+            {
+              stats->other = apr_pcalloc(pool, sizeof(*stats->other));
+              stats->other->prefix = "(other)";
+            }
+
+          *info = stats->other;
+        }
+    }
+
+  if (prefix_idx != NO_INDEX)
+    stats->by_index[prefix_idx] = *info;
+
+  return SVN_NO_ERROR;
+}
+
+/* Thread-safe wrapper around get_prefix_stats_internal. */
+static svn_error_t *
+get_prefix_stats(svn_cache__prefix_info_t **info,
+                 prefix_stats_t *stats,
+                 const char *prefix,
+                 apr_uint32_t prefix_idx)
+{
+  SVN_MUTEX__WITH_LOCK(stats->mutex,
+                       get_prefix_stats_internal(info, stats, prefix,
+                                                 prefix_idx));
+
+  return SVN_NO_ERROR;
+}
+
+/* Return the statistics record for the used ENTRY in CACHE.  Return NULL
+ * if CACHE does not maintain per-prefix data for its entries.
+ *
+ * Shared caches don't because other processes would modify the entries
+ * behind our back.
+ */
+static svn_cache__prefix_info_t *
+get_entry_stats(svn_membuffer_t *cache, entry_t *entry)
+{
+  prefix_stats_t *stats = cache->prefix_stats;
+  svn_cache__prefix_info_t *info = NULL;
+  const char *prefix;
+
+  if (cache->shared)
+    return NULL;
+
+  /* Fast path: No need to look up the prefix by name. */
+  if (entry->key.prefix_idx != NO_INDEX)
+    {
+      info = stats->by_index[entry->key.prefix_idx];
+      if (info)
+        return info;
+
+      prefix = cache->prefix_pool->values[entry->key.prefix_idx];
+    }
+  else
+    {
+      /* The full key starts with the NUL-terminated prefix. */
+      prefix = (const char *)cache->data + entry->offset;
+    }
+
+  /* Statistics are optional.  Simply don't count if we fail here. */
+  svn_error_clear(get_prefix_stats(&info, stats, prefix,
+                                   entry->key.prefix_idx));
+
+  return info;
+}
+
+/* Account for ENTRY having been added to CACHE.  Its data, including the
+ * full key, must already have been written.
+ */
+static void
+count_entry_insertion(svn_membuffer_t *cache, entry_t *entry)
+{
+  svn_cache__prefix_info_t *info = get_entry_stats(cache, entry);
+  if (info)
+    {
+      info->used_entries++;
+      info->used_size += entry->size;
+    }
+}
+
+/* Account for ENTRY being removed from CACHE.  Saturate at 0 because we
+ * might not have counted all insertions, e.g. when CACHE got cleared.
+ */
+static void
+count_entry_removal(svn_membuffer_t *cache, entry_t *entry)
+{
+  svn_cache__prefix_info_t *info = get_entry_stats(cache, entry);
+  if (info)
+    {
+      info->used_entries -= MIN(info->used_entries, 1);
+      info->used_size -= MIN(info->used_size, entry->size);
+    }
+}
+
 /* Remove the used ENTRY from the CACHE, i.e. make it "unused".
  * In contrast to insertion, removal is possible for any entry.
  */
@@ -1221,6 +1758,7 @@ drop_entry(svn_membuffer_t *cache, entry_t *entry)
    */
   cache->used_entries--;
   cache->data_used -= entry->size;
+  count_entry_removal(cache, entry);
 
   /* extend the insertion window, if the entry happens to border it
    */
@@ -1289,6 +1827,18 @@ drop_entry(svn_membuffer_t *cache, entry_t *entry)
     free_spare_group(cache, last_group);
 }
 
+/* Remove the used ENTRY from the CACHE to make room for new data.
+ */
+static void
+evict_entry(svn_membuffer_t *cache, entry_t *entry)
+{
+  svn_cache__prefix_info_t *info = get_entry_stats(cache, entry);
+  if (info)
+    info->evictions++;
+
+  drop_entry(cache, entry);
+}
+
 /* Insert ENTRY into the chain of used dictionary entries. The entry's
  * offset and size members must already have been initialized. Also,
  * the offset must match the beginning of the insertion window.
@@ -1347,6 +1897,105 @@ get_group_index(svn_membuffer_t **cache,
   return (key0 % APR_UINT64_C(5030895599)) % segment0->group_count;
 }
 
+/* Set *INDEX1 and *STEP to the first counter for KEY in the access
+ * frequency sketch of CACHE and the (odd) distance to its next counter.
+ */
+static APR_INLINE void
+get_sketch_position(apr_uint32_t *index1,
+                    apr_uint32_t *step,
+                    svn_membuffer_t *cache,
+                    const entry_key_t *key)
+{
+  /* Group and segment selection already used FINGERPRINT[0] and some of
+   * FINGERPRINT[1].  Mix them to get fresh bits for our purposes. */
+  apr_uint64_t hash = (key->fingerprint[0] ^ key->fingerprint[1])
+                    * APR_UINT64_C(0x9e3779b97f4a7c15);
+
+  *index1 = (apr_uint32_t)(hash >> 32) & cache->frequency_mask;
+  *step = (apr_uint32_t)hash | 1;
+}
+
+/* Return the estimated number of recent accesses to KEY in CACHE.
+ */
+static apr_uint32_t
+estimate_frequency(svn_membuffer_t *cache,
+                   const entry_key_t *key)
+{
+  apr_uint32_t index, step, i;
+  apr_uint32_t result = MAX_FREQUENCY;
+
+  get_sketch_position(&index, &step, cache, key);
+  for (i = 0; i < SKETCH_DEPTH; ++i)
+    {
+      result = MIN(result, cache->frequencies[index]);
+      index = (index + step) & cache->frequency_mask;
+    }
+
+  return result;
+}
+
+/* Halve all access frequency counters in CACHE.
+ */
+static void
+age_frequencies(svn_membuffer_t *cache)
+{
+  apr_uint32_t i;
+  for (i = 0; i <= cache->frequency_mask; ++i)
+    cache->frequencies[i] >>= 1;
+}
+
+/* Count an access to KEY in CACHE, if the admission policy needs that.
+ * Can be called without holding any lock.
+ */
+static void
+record_access(svn_membuffer_t *cache,
+              const entry_key_t *key)
+{
+  apr_uint32_t index, step, i;
+  apr_uint32_t frequency;
+  apr_uint32_t period = (cache->frequency_mask + 1)
+                      * SKETCH_SAMPLES_PER_COUNTER;
+
+  if (cache->admission_policy != svn_cache__admission_frequency)
+    return;
+
+  /* Exactly one thread completes the sampling period and ages the
+   * sketch.  Accesses counted by other threads in the meantime are
+   * kept for the next period. */
+  if (svn_atomic_inc(&cache->frequency_samples) + 1 == period)
+    {
+      age_frequencies(cache);
+      apr_atomic_sub32(&cache->frequency_samples, period);
+    }
+
+  /* Only increment the counters holding the current minimum
+   * ("conservative update").  This reduces the over-estimation
+   * for rare keys caused by collisions. */
+  frequency = estimate_frequency(cache, key);
+  if (frequency == MAX_FREQUENCY)
+    return;
+
+  get_sketch_position(&index, &step, cache, key);
+  for (i = 0; i < SKETCH_DEPTH; ++i)
+    {
+      if (cache->frequencies[index] == frequency)
+        cache->frequencies[index] = (unsigned char)(frequency + 1);
+      index = (index + step) & cache->frequency_mask;
+    }
+}
+
+/* Return the number that the admission policy in CACHE uses to rank
+ * ENTRY.  Higher values mean more important.
+ */
+static APR_INLINE apr_uint64_t
+get_entry_worth(svn_membuffer_t *cache,
+                entry_t *entry)
+{
+  return cache->admission_policy == svn_cache__admission_frequency
+       ? estimate_frequency(cache, &entry->key)
+       : entry->hit_count;
+}
+
 /* Reduce the hit count of ENTRY and update the accumulated hit info
  * in CACHE accordingly.
  */
@@ -1359,8 +2008,11 @@ let_entry_age(svn_membuffer_t *cache, entry_t *entry)
     {
       entry->hit_count -= hits_removed;
     }
-  else
+  else if (   cache->admission_policy != svn_cache__admission_frequency
+           || estimate_frequency(cache, &entry->key) == 0)
     {
+      /* With the frequency policy, only entries that have not been
+       * requested recently lose priority.  Others are still in use. */
       entry->priority /= 2;
     }
 }
@@ -1510,23 +2162,28 @@ find_entry(svn_membuffer_t *cache,
            * groups in the chain.
            */
           cache_level_t *entry_level;
+          apr_uint64_t entry_worth;
           int to_remove = rand() % (GROUP_SIZE * group->header.chain_length);
           entry_group_t *to_shrink
             = get_group(cache, group_index, to_remove / GROUP_SIZE);
 
           entry = &to_shrink->entries[to_remove % GROUP_SIZE];
           entry_level = get_cache_level(cache, entry);
+          entry_worth = get_entry_worth(cache, entry);
           for (i = 0; i < GROUP_SIZE; ++i)
             {
               /* keep L1 entries whenever possible */
 
               cache_level_t *level
                 = get_cache_level(cache, &to_shrink->entries[i]);
+              apr_uint64_t worth
+                = get_entry_worth(cache, &to_shrink->entries[i]);
               if (   (level != entry_level && entry_level == &cache->l1)
-                  || (entry->hit_count > to_shrink->entries[i].hit_count))
+                  || (entry_worth > worth))
                 {
                   entry_level = level;
                   entry = &to_shrink->entries[i];
+                  entry_worth = worth;
                 }
             }
 
@@ -1538,7 +2195,7 @@ find_entry(svn_membuffer_t *cache,
             if (entry != &to_shrink->entries[i])
               let_entry_age(cache, &to_shrink->entries[i]);
 
-          drop_entry(cache, entry);
+          evict_entry(cache, entry);
         }
 
       /* initialize entry for the new key
@@ -1646,8 +2303,11 @@ ensure_data_insertable_l2(svn_membuffer_t *cache,
   /* accumulated "worth" of items dropped so far */
   apr_uint64_t drop_hits = 0;
 
+  /* Hits or access frequency of the new entry, see get_entry_worth(). */
+  apr_uint64_t to_fit_in_worth = get_entry_worth(cache, to_fit_in);
+
   /* estimated "worth" of the new entry */
-  apr_uint64_t drop_hits_limit = (to_fit_in->hit_count + 1)
+  apr_uint64_t drop_hits_limit = (to_fit_in_worth + 1)
                                * (apr_uint64_t)to_fit_in->priority;
 
   /* This loop will eventually terminate because every cache entry
@@ -1702,7 +2362,9 @@ ensure_data_insertable_l2(svn_membuffer_t *cache,
       else
         {
           svn_boolean_t keep;
+          apr_uint64_t entry_worth;
           entry = get_entry(cache, cache->l2.next);
+          entry_worth = get_entry_worth(cache, entry);
 
           if (to_fit_in->priority < SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY)
             {
@@ -1710,7 +2372,7 @@ ensure_data_insertable_l2(svn_membuffer_t *cache,
                * entry is of even lower prio and has fewer hits.
                */
               if (   entry->priority > to_fit_in->priority
-                  || entry->hit_count > to_fit_in->hit_count)
+                  || entry_worth > to_fit_in_worth)
                 return FALSE;
             }
 
@@ -1731,7 +2393,7 @@ ensure_data_insertable_l2(svn_membuffer_t *cache,
                * The new entry may still find room by ousting other entries.
                */
               keep = to_fit_in->priority == entry->priority
-                   ? entry->hit_count >= to_fit_in->hit_count
+                   ? entry_worth >= to_fit_in_worth
                    : entry->priority > to_fit_in->priority;
             }
 
@@ -1753,9 +2415,9 @@ ensure_data_insertable_l2(svn_membuffer_t *cache,
                * provide the same data but in a further stage of processing.
                */
               if (entry->priority > SVN_CACHE__MEMBUFFER_LOW_PRIORITY)
-                drop_hits += entry->hit_count * (apr_uint64_t)entry->priority;
+                drop_hits += entry_worth * (apr_uint64_t)entry->priority;
 
-              drop_entry(cache, entry);
+              evict_entry(cache, entry);
             }
         }
     }
@@ -1823,7 +2485,7 @@ ensure_data_insertable_l1(svn_membuffer_t *cache, apr_size_t size)
               if (keep)
                 promote_entry(cache, entry);
               else
-                drop_entry(cache, entry);
+                evict_entry(cache, entry);
             }
         }
     }
@@ -1832,6 +2494,28 @@ ensure_data_insertable_l1(svn_membuffer_t *cache, apr_size_t size)
    * right answer. */
 }
 
+/* Return a buffer of SIZE bytes.  If *SHARED_MEMORY is not NULL, take it
+ * from there and advance *SHARED_MEMORY.  Otherwise, allocate it in POOL.
+ * If CLEAR is set, zero the buffer contents.
+ */
+static void *
+cache_alloc(unsigned char **shared_memory,
+            apr_size_t size,
+            svn_boolean_t clear,
+            apr_pool_t *pool)
+{
+  void *result;
+  if (*shared_memory == NULL)
+    return clear ? apr_pcalloc(pool, size) : apr_palloc(pool, size);
+
+  result = *shared_memory;
+  *shared_memory += ALIGN_VALUE(size);
+  if (clear)
+    memset(result, 0, size);
+
+  return result;
+}
+
 svn_error_t *
 svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
                                   apr_size_t total_size,
@@ -1839,24 +2523,52 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
                                   apr_size_t segment_count,
                                   svn_boolean_t thread_safe,
                                   svn_boolean_t allow_blocking_writes,
+                                  svn_boolean_t shared,
                                   apr_pool_t *pool)
 {
   svn_membuffer_t *c;
   prefix_pool_t *prefix_pool;
+  apr_size_t prefix_pool_size;
+  snapshot_t *snapshot;
+  prefix_stats_t *prefix_stats;
+  unsigned char *shared_memory = NULL;
 
   apr_uint32_t seg;
   apr_uint32_t group_count;
   apr_uint32_t main_group_count;
   apr_uint32_t spare_group_count;
   apr_uint32_t group_init_size;
+  apr_uint32_t frequency_count;
   apr_uint64_t data_size;
   apr_uint64_t max_entry_size;
 
+#if !SHARED_CACHE_SUPPORTED
+  shared = FALSE;
+#endif
+
   /* Allocate 1% of the cache capacity to the prefix string pool.
+   * Shared caches can't use prefix indexes.  An empty pool makes all
+   * keys use the "full key" code path.
    */
-  SVN_ERR(prefix_pool_create(&prefix_pool, total_size / 100, thread_safe,
+  prefix_pool_size = shared ? 0 : total_size / 100;
+  SVN_ERR(prefix_pool_create(&prefix_pool, prefix_pool_size, thread_safe,
                              pool));
-  total_size -= total_size / 100;
+  total_size -= prefix_pool_size;
+
+  /* No snapshot has been loaded, yet. */
+  snapshot = apr_pcalloc(pool, sizeof(*snapshot));
+  snapshot->pool = svn_pool_create(pool);
+  SVN_ERR(svn_mutex__init(&snapshot->mutex, thread_safe, pool));
+
+  /* No access statistics, yet. */
+  prefix_stats = apr_pcalloc(pool, sizeof(*prefix_stats));
+  prefix_stats->map = svn_hash__make(svn_pool_create(pool));
+  prefix_stats->by_index
+    = prefix_pool->values_max
+    ? apr_pcalloc(pool, prefix_pool->values_max
+                        * sizeof(*prefix_stats->by_index))
+    : NULL;
+  SVN_ERR(svn_mutex__init(&prefix_stats->mutex, thread_safe, pool));
 
   /* Limit the total size (only relevant if we can address > 4GB)
    */
@@ -1910,9 +2622,6 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
          && segment_count < MAX_SEGMENT_COUNT)
     segment_count *= 2;
 
-  /* allocate cache as an array of segments / cache objects */
-  c = apr_palloc(pool, segment_count * sizeof(*c));
-
   /* Split total cache size into segments of equal size
    */
   total_size /= segment_count;
@@ -1963,12 +2672,49 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
   assert(spare_group_count > 0 && main_group_count > 0);
 
   group_init_size = 1 + group_count / (8 * GROUP_INIT_GRANULARITY);
+
+  /* One access frequency counter per main index entry, rounded up to the
+   * next power of two.
+   */
+  frequency_count = 64;
+  while (   frequency_count < main_group_count * GROUP_SIZE
+         && frequency_count < APR_UINT32_MAX / 2)
+    frequency_count *= 2;
+
+  /* Shared caches take all their memory from a single block.  If we can't
+   * get one, fall back to a process-local cache.
+   */
+  if (shared)
+    {
+      apr_shm_t *shm;
+      apr_status_t status;
+      apr_uint64_t shm_size
+        = ALIGN_VALUE(segment_count * sizeof(*c))
+        + segment_count * (  ALIGN_VALUE(group_count * sizeof(entry_group_t))
+                           + ALIGN_VALUE(group_init_size)
+                           + ALIGN_VALUE(frequency_count)
+                           + ALIGN_VALUE(data_size));
+
+      status = shm_size <= APR_SIZE_MAX
+             ? apr_shm_create(&shm, (apr_size_t)shm_size, NULL, pool)
+             : APR_ENOMEM;
+      if (status == APR_SUCCESS)
+        shared_memory = apr_shm_baseaddr_get(shm);
+      else
+        shared = FALSE;
+    }
+
+  /* allocate cache as an array of segments / cache objects */
+  c = cache_alloc(&shared_memory, segment_count * sizeof(*c), FALSE, pool);
+
   for (seg = 0; seg < segment_count; ++seg)
     {
       /* allocate buffers and initialize cache members
        */
       c[seg].segment_count = (apr_uint32_t)segment_count;
       c[seg].prefix_pool = prefix_pool;
+      c[seg].snapshot = snapshot;
+      c[seg].prefix_stats = prefix_stats;
 
       c[seg].group_count = main_group_count;
       c[seg].spare_group_count = spare_group_count;
@@ -1978,12 +2724,21 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
       /* Allocate but don't clear / zero the directory because it would add
          significantly to the server start-up time if the caches are large.
          Group initialization will take care of that in stead. */
-      c[seg].directory = apr_palloc(pool,
-                                    group_count * sizeof(entry_group_t));
+      c[seg].directory = cache_alloc(&shared_memory,
+                                     group_count * sizeof(entry_group_t),
+                                     FALSE, pool);
 
       /* Allocate and initialize directory entries as "not initialized",
          hence "unused" */
-      c[seg].group_initialized = apr_pcalloc(pool, group_init_size);
+      c[seg].group_initialized = cache_alloc(&shared_memory,
+                                             group_init_size, TRUE, pool);
+
+      /* No accesses have been recorded, yet. */
+      c[seg].admission_policy = svn_cache__admission_hit_count;
+      c[seg].frequencies = cache_alloc(&shared_memory, frequency_count,
+                                       TRUE, pool);
+      c[seg].frequency_mask = frequency_count - 1;
+      c[seg].frequency_samples = 0;
 
       /* Allocate 1/4th of the data buffer to L1
        */
@@ -2004,7 +2759,9 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
       c[seg].l2.current_data = c[seg].l2.start_offset;
 
       /* This cast is safe because DATA_SIZE <= MAX_SEGMENT_SIZE. */
-      c[seg].data = apr_palloc(pool, (apr_size_t)ALIGN_VALUE(data_size));
+      c[seg].data = cache_alloc(&shared_memory,
+                                (apr_size_t)ALIGN_VALUE(data_size),
+                                FALSE, pool);
       c[seg].data_used = 0;
       c[seg].max_entry_size = max_entry_size;
 
@@ -2012,6 +2769,8 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
       c[seg].total_reads = 0;
       c[seg].total_writes = 0;
       c[seg].total_hits = 0;
+      c[seg].lock_free_reads = 0;
+      c[seg].lock_free_hits = 0;
 
       /* were allocations successful?
        * If not, initialize a minimal cache structure.
@@ -2028,24 +2787,36 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
        * the cache's creator doesn't feel the cache needs to be
        * thread-safe.
        */
-      SVN_ERR(svn_mutex__init(&c[seg].lock, thread_safe, pool));
+      SVN_ERR(svn_mutex__init(&c[seg].lock, thread_safe && !shared, pool));
 #elif (APR_HAS_THREADS && !USE_SIMPLE_MUTEX)
       /* Same for read-write lock. */
       c[seg].lock = NULL;
-      if (thread_safe)
+      if (thread_safe && !shared)
         {
           apr_status_t status =
               apr_thread_rwlock_create(&(c[seg].lock), pool);
           if (status)
             return svn_error_wrap_apr(status, _("Can't create cache mutex"));
         }
+#endif
 
       /* Select the behavior of write operations.
        */
       c[seg].allow_blocking_writes = allow_blocking_writes;
-#endif
       /* No writers at the moment. */
       c[seg].write_lock_count = 0;
+      c[seg].sequence = 0;
+
+      /* Shared segments are always synchronized - across processes. */
+      c[seg].shared = shared;
+#if SHARED_CACHE_SUPPORTED
+      if (shared)
+        SVN_ERR(init_shared_segment_lock(&c[seg]));
+#endif
+
+      /* Lock-free reads are always safe but only make sense if there
+       * is a lock to avoid. */
+      c[seg].optimistic_reads = thread_safe || shared;
     }
 
   /* done here
@@ -2054,18 +2825,35 @@ svn_cache__membuffer_cache_create(svn_membuffer_t **cache,
   return SVN_NO_ERROR;
 }
 
+/* Reset the usage counters of all records in STATS.
+ * The caller must hold the STATS mutex. */
+static svn_error_t *
+reset_prefix_usage(prefix_stats_t *stats)
+{
+  apr_hash_index_t *hi;
+
+  for (hi = apr_hash_first(NULL, stats->map); hi; hi = apr_hash_next(hi))
+    {
+      svn_cache__prefix_info_t *info = apr_hash_this_val(hi);
+      info->used_entries = 0;
+      info->used_size = 0;
+    }
+
+  if (stats->other)
+    {
+      stats->other->used_entries = 0;
+      stats->other->used_size = 0;
+    }
+
+  return SVN_NO_ERROR;
+}
+
 svn_error_t *
 svn_cache__membuffer_clear(svn_membuffer_t *cache)
 {
   apr_size_t seg;
   apr_size_t segment_count = cache->segment_count;
 
-  /* Length of the group_initialized array in bytes.
-     See also svn_cache__membuffer_cache_create(). */
-  apr_size_t group_init_size
-    = 1 + (cache->group_count + cache->spare_group_count)
-            / (8 * GROUP_INIT_GRANULARITY);
-
   /* Clear segment by segment.  This implies that other thread may read
      and write to other segments after we cleared them and before the
      last segment is done.
@@ -2078,37 +2866,46 @@ svn_cache__membuffer_clear(svn_membuffer_t *cache)
     {
       /* Unconditionally acquire the write lock. */
       SVN_ERR(force_write_lock_cache(&cache[seg]));
+      begin_modification(&cache[seg]);
 
-      /* Mark all groups as "not initialized", which implies "empty". */
-      cache[seg].first_spare_group = NO_INDEX;
-      cache[seg].max_spare_used = 0;
-
-      memset(cache[seg].group_initialized, 0, group_init_size);
-
-      /* Unlink L1 contents. */
-      cache[seg].l1.first = NO_INDEX;
-      cache[seg].l1.last = NO_INDEX;
-      cache[seg].l1.next = NO_INDEX;
-      cache[seg].l1.current_data = cache[seg].l1.start_offset;
-
-      /* Unlink L2 contents. */
-      cache[seg].l2.first = NO_INDEX;
-      cache[seg].l2.last = NO_INDEX;
-      cache[seg].l2.next = NO_INDEX;
-      cache[seg].l2.current_data = cache[seg].l2.start_offset;
-
-      /* Reset content counters. */
-      cache[seg].data_used = 0;
-      cache[seg].used_entries = 0;
+      reset_segment(&cache[seg]);
 
       /* Segment may be used again. */
-      SVN_ERR(unlock_cache(&cache[seg], SVN_NO_ERROR));
+      SVN_ERR(unlock_cache(&cache[seg],
+                           end_modification(&cache[seg], SVN_NO_ERROR)));
     }
 
+  SVN_MUTEX__WITH_LOCK(cache->prefix_stats->mutex,
+                       reset_prefix_usage(cache->prefix_stats));
+
   /* done here */
   return SVN_NO_ERROR;
 }
 
+void
+svn_cache__membuffer_set_optimistic_reads(svn_membuffer_t *cache,
+                                          svn_boolean_t enable)
+{
+  apr_uint32_t seg;
+  apr_uint32_t segment_count = cache->segment_count;
+
+  /* Shared segments have no reader lock to fall back to. */
+  for (seg = 0; seg < segment_count; ++seg)
+    cache[seg].optimistic_reads = enable || cache[seg].shared;
+}
+
+void
+svn_cache__membuffer_set_admission_policy(
+  svn_membuffer_t *cache,
+  svn_cache__admission_policy_t policy)
+{
+  apr_uint32_t seg;
+  apr_uint32_t segment_count = cache->segment_count;
+
+  for (seg = 0; seg < segment_count; ++seg)
+    cache[seg].admission_policy = policy;
+}
+
 /* Look for the cache entry in group GROUP_INDEX of CACHE, identified
  * by the hash value TO_FIND and set *FOUND accordingly.
  *
@@ -2228,6 +3025,7 @@ membuffer_cache_set_internal(svn_membuffer_t *cache,
        * negative value.
        */
       cache->data_used += (apr_uint64_t)size - entry->size;
+      count_entry_removal(cache, entry);
       entry->size = size;
       entry->priority = priority;
 
@@ -2247,6 +3045,7 @@ membuffer_cache_set_internal(svn_membuffer_t *cache,
         memcpy(cache->data + entry->offset + entry->key.key_len, buffer,
                item_size);
 
+      count_entry_insertion(cache, entry);
       cache->total_writes++;
 
       /* Putting the decrement into an assert() to make it disappear
@@ -2291,6 +3090,7 @@ membuffer_cache_set_internal(svn_membuffer_t *cache,
         memcpy(cache->data + entry->offset + entry->key.key_len, buffer,
                item_size);
 
+      count_entry_insertion(cache, entry);
       cache->total_writes++;
     }
   else
@@ -2370,6 +3170,251 @@ increment_hit_counters(svn_membuffer_t *cache, entry_t *entry)
   cache->total_hits++;
 }
 
+#if OPTIMISTIC_READS
+
+/* Return the modification sequence number of CACHE.  Odd values indicate
+ * an ongoing modification.  Cache data reads following this call will
+ * not be reordered to happen before it.
+ */
+static APR_INLINE apr_uint32_t
+read_sequence(svn_membuffer_t *cache)
+{
+  apr_uint32_t sequence = svn_atomic_read(&cache->sequence);
+  READ_BARRIER();
+
+  return sequence;
+}
+
+/* Return TRUE, if CACHE has not been modified since read_sequence()
+ * returned SEQUENCE, i.e. if all data read in between is consistent.
+ */
+static APR_INLINE svn_boolean_t
+sequence_unchanged(svn_membuffer_t *cache, apr_uint32_t sequence)
+{
+  READ_BARRIER();
+
+  return svn_atomic_read(&cache->sequence) == sequence;
+}
+
+/* Lock-free variant of find_entry() with FIND_EMPTY being FALSE.
+ *
+ * Look for the entry matching TO_FIND in group GROUP_INDEX of CACHE.  If
+ * found, set *ENTRY to it and return the location and size of the item
+ * data (i.e. excluding the key) in *OFFSET and *SIZE.  Otherwise, set
+ * *ENTRY to NULL.
+ *
+ * Since CACHE may get modified while we read it, every value read gets
+ * validated before it is being used as an index or offset.  If the data
+ * is obviously inconsistent, return FALSE.  Even if TRUE gets returned,
+ * the caller must check the sequence number before using the result.
+ */
+static svn_boolean_t
+find_entry_optimistic(svn_membuffer_t *cache,
+                      apr_uint32_t group_index,
+                      const full_key_t *to_find,
+                      entry_t **entry,
+                      apr_uint64_t *offset,
+                      apr_size_t *size)
+{
+  const entry_key_t *key = &to_find->entry_key;
+  apr_uint32_t group_limit = cache->group_count + cache->spare_group_count;
+  apr_uint64_t data_size = cache->l1.size + cache->l2.size;
+  const volatile entry_group_t *group = &cache->directory[group_index];
+  apr_size_t chain_length;
+
+  *entry = NULL;
+  if (! is_group_initialized(cache, group_index))
+    return TRUE;
+
+  for (chain_length = 0;
+       chain_length < MAX_GROUP_CHAIN_LENGTH;
+       ++chain_length)
+    {
+      /* Read every header field exactly once. */
+      apr_uint32_t used = group->header.used;
+      apr_uint32_t next = group->header.next;
+      apr_uint32_t i;
+
+      if (used > GROUP_SIZE)
+        return FALSE;
+
+      for (i = 0; i < used; ++i)
+        {
+          const volatile entry_t *candidate = &group->entries[i];
+          apr_uint64_t item_offset;
+          apr_size_t item_size;
+
+          if (   candidate->key.fingerprint[0] != key->fingerprint[0]
+              || candidate->key.fingerprint[1] != key->fingerprint[1]
+              || candidate->key.prefix_idx != key->prefix_idx
+              || candidate->key.key_len != key->key_len)
+            continue;
+
+          /* The item, padding included, must be within the data buffer
+           * and be large enough to contain the key. */
+          item_offset = candidate->offset;
+          item_size = candidate->size;
+          if (   item_offset > data_size
+              || ALIGN_VALUE(item_size) > data_size - item_offset
+              || item_size < key->key_len)
+            return FALSE;
+
+          /* Same as in find_entry(): the full key decides whether this
+           * is a match or a conflict. */
+          if (   key->key_len
+              && memcmp(to_find->full_key.data,
+                        cache->data + item_offset,
+                        key->key_len) != 0)
+            return TRUE;
+
+          *entry = (entry_t *)candidate;
+          *offset = item_offset + key->key_len;
+          *size = item_size - key->key_len;
+
+          return TRUE;
+        }
+
+      /* end of chain? */
+      if (next == NO_INDEX)
+        return TRUE;
+
+      /* only full groups may chain */
+      if (used != GROUP_SIZE || next >= group_limit)
+        return FALSE;
+
+      group = &cache->directory[next];
+    }
+
+  /* Chain too long.  It must have been modified while we followed it. */
+  return FALSE;
+}
+
+#endif
+
+/* Try to look up TO_FIND in group GROUP_INDEX of CACHE without taking
+ * any lock.  Return FALSE, if that did not produce a consistent result.
+ * In that case, the caller must fall back to the locked code path.
+ *
+ * Otherwise, set *FOUND and count the hit.  If BUFFER is not NULL and the
+ * item has been found, copy its serialized data to *BUFFER and set
+ * *ITEM_SIZE to its size.  If *BUFFER is NULL, the copy will be allocated
+ * in RESULT_POOL.  Otherwise, *BUFFER is provided by the caller and has
+ * room for MAX_SIZE bytes; larger items will not be copied but will make
+ * this function return FALSE.
+ */
+static svn_boolean_t
+optimistic_lookup(svn_membuffer_t *cache,
+                  apr_uint32_t group_index,
+                  const full_key_t *to_find,
+                  svn_boolean_t *found,
+                  char **buffer,
+                  apr_size_t *item_size,
+                  apr_size_t max_size,
+                  apr_pool_t *result_pool)
+{
+#if OPTIMISTIC_READS
+  int attempt;
+  char *copy = buffer ? *buffer : NULL;
+  apr_size_t capacity = copy ? max_size : 0;
+
+  if (! cache->optimistic_reads)
+    return FALSE;
+
+  for (attempt = 0; attempt < OPTIMISTIC_READ_ATTEMPTS; ++attempt)
+    {
+      entry_t *entry;
+      apr_uint64_t offset;
+      apr_size_t size = 0;
+      apr_uint32_t sequence = read_sequence(cache);
+
+      /* A writer is active.  Rather than spinning, wait for it to finish
+       * by taking the lock. */
+      if (sequence & 1)
+        return FALSE;
+
+      if (! find_entry_optimistic(cache, group_index, to_find,
+                                  &entry, &offset, &size))
+        continue;
+
+      if (entry && buffer)
+        {
+          /* Copy the padding as well, just like the locked code does. */
+          apr_size_t aligned_size = ALIGN_VALUE(size);
+          if (aligned_size > capacity)
+            {
+              if (*buffer)
+                return FALSE;
+
+              copy = apr_palloc(result_pool, aligned_size);
+              capacity = aligned_size;
+            }
+
+          memcpy(copy, cache->data + offset, aligned_size);
+        }
+
+      if (! sequence_unchanged(cache, sequence))
+        continue;
+
+      /* ENTRY may have been reused by now.  But hit counts are only a
+       * heuristics and a lost or misplaced update is harmless.  We don't
+       * hold the lock, so the statistics must be updated atomically. */
+      svn_atomic_inc(&cache->lock_free_reads);
+      if (entry)
+        {
+          svn_atomic_inc(&entry->hit_count);
+          svn_atomic_inc(&cache->lock_free_hits);
+          *found = TRUE;
+          if (buffer)
+            {
+              *buffer = copy;
+              *item_size = size;
+            }
+        }
+      else
+        {
+          *found = FALSE;
+        }
+
+      return TRUE;
+    }
+#endif
+
+  return FALSE;
+}
+
+/* Like optimistic_lookup() but for shared segments, which have no reader
+ * lock to fall back to.  Retry while writers get in the way, yielding the
+ * CPU for increasing periods.  If we still can't get a consistent result,
+ * report a cache miss.  A cache may always forget its contents, so that
+ * is safe.
+ */
+static void
+shared_lookup(svn_membuffer_t *cache,
+              apr_uint32_t group_index,
+              const full_key_t *to_find,
+              svn_boolean_t *found,
+              char **buffer,
+              apr_size_t *item_size,
+              apr_size_t max_size,
+              apr_pool_t *result_pool)
+{
+  apr_interval_time_t delay = 0;
+  int attempt;
+
+  for (attempt = 0; attempt < SHARED_READ_ATTEMPTS; ++attempt)
+    {
+      if (optimistic_lookup(cache, group_index, to_find, found, buffer,
+                            item_size, max_size, result_pool))
+        return;
+
+      apr_sleep(delay);
+      delay = 2 * delay + 1;
+    }
+
+  svn_atomic_inc(&cache->lock_free_reads);
+  *found = FALSE;
+}
+
 /* Look for the cache entry in group GROUP_INDEX of CACHE, identified
  * by the hash value TO_FIND. If no item has been stored for KEY,
  * *BUFFER will be NULL. Otherwise, return a copy of the serialized
@@ -2447,20 +3492,28 @@ membuffer_cache_get(svn_membuffer_t *cache,
                     apr_pool_t *result_pool)
 {
   apr_uint32_t group_index;
-  char *buffer;
+  char *buffer = NULL;
   apr_size_t size;
+  svn_boolean_t found;
 
   /* find the entry group that will hold the key.
    */
   group_index = get_group_index(&cache, &key->entry_key);
-  WITH_READ_LOCK(cache,
-                 membuffer_cache_get_internal(cache,
-                                              group_index,
-                                              key,
-                                              &buffer,
-                                              &size,
-                                              DEBUG_CACHE_MEMBUFFER_TAG
-                                              result_pool));
+  record_access(cache, &key->entry_key);
+
+  if (cache->shared)
+    shared_lookup(cache, group_index, key, &found, &buffer, &size,
+                  0, result_pool);
+  else if (! optimistic_lookup(cache, group_index, key, &found, &buffer,
+                               &size, 0, result_pool))
+    WITH_READ_LOCK(cache,
+                   membuffer_cache_get_internal(cache,
+                                                group_index,
+                                                key,
+                                                &buffer,
+                                                &size,
+                                                DEBUG_CACHE_MEMBUFFER_TAG
+                                                result_pool));
 
   /* re-construct the original data object from its serialized form.
    */
@@ -2515,13 +3568,22 @@ membuffer_cache_has_key(svn_membuffer_t *cache,
   /* find the entry group that will hold the key.
    */
   apr_uint32_t group_index = get_group_index(&cache, &key->entry_key);
-  cache->total_reads++;
+  record_access(cache, &key->entry_key);
 
-  WITH_READ_LOCK(cache,
-                 membuffer_cache_has_key_internal(cache,
-                                                  group_index,
-                                                  key,
-                                                  found));
+  if (cache->shared)
+    {
+      shared_lookup(cache, group_index, key, found, NULL, NULL, 0, NULL);
+    }
+  else if (! optimistic_lookup(cache, group_index, key, found, NULL, NULL,
+                               0, NULL))
+    {
+      cache->total_reads++;
+      WITH_READ_LOCK(cache,
+                     membuffer_cache_has_key_internal(cache,
+                                                      group_index,
+                                                      key,
+                                                      found));
+    }
 
   return SVN_NO_ERROR;
 }
@@ -2601,6 +3663,43 @@ membuffer_cache_get_partial(svn_membuffer_t *cache,
 {
   apr_uint32_t group_index = get_group_index(&cache, &key->entry_key);
 
+  /* The partial getter usually extracts only a small part of the item.
+   * So, copy only small items to a local buffer; for larger ones, it is
+   * cheaper to take the lock and work in-place.
+   */
+  apr_uint64_t local[MAX_OPTIMISTIC_PARTIAL_SIZE / sizeof(apr_uint64_t)];
+  char *buffer = (char *)local;
+  apr_size_t size;
+
+  record_access(cache, &key->entry_key);
+  if (optimistic_lookup(cache, group_index, key, found, &buffer, &size,
+                        sizeof(local), result_pool))
+    {
+      if (! *found)
+        {
+          *item = NULL;
+          return SVN_NO_ERROR;
+        }
+
+      return deserializer(item, buffer, size, baton, result_pool);
+    }
+
+  /* Shared segments can't be accessed in-place.  Copy larger items to
+   * the heap instead. */
+  if (cache->shared)
+    {
+      buffer = NULL;
+      shared_lookup(cache, group_index, key, found, &buffer, &size,
+                    0, result_pool);
+      if (! *found)
+        {
+          *item = NULL;
+          return SVN_NO_ERROR;
+        }
+
+      return deserializer(item, buffer, size, baton, result_pool);
+    }
+
   WITH_READ_LOCK(cache,
                  membuffer_cache_get_partial_internal
                      (cache, group_index, key, item, found,
@@ -2709,6 +3808,7 @@ membuffer_cache_set_partial_internal(svn_membuffer_t *cache,
                   /* Link the entry properly.
                    */
                   insert_entry(cache, entry);
+                  count_entry_insertion(cache, entry);
                 }
             }
 
@@ -2806,8 +3906,43 @@ typedef struct svn_membuffer_cache_t
   /* if enabled, this will serialize the access to this instance.
    */
   svn_mutex__t *mutex;
+
+  /* Access statistics shared with all front-ends using the same prefix.
+   * Never NULL.
+   */
+  svn_cache__prefix_info_t *stats;
 } svn_membuffer_cache_t;
 
+/* If the access counted as number COUNT shall be timed, return the
+ * current time.  Return 0 otherwise.
+ */
+static APR_INLINE apr_time_t
+start_latency_sample(apr_uint64_t count)
+{
+  return count % LATENCY_SAMPLING_INTERVAL ? 0 : apr_time_now();
+}
+
+/* If START is not 0, add the time elapsed since START to HISTOGRAM.
+ * See SVN_CACHE__LATENCY_BUCKETS for its layout.
+ */
+static void
+finish_latency_sample(apr_uint64_t *histogram,
+                      apr_time_t start)
+{
+  apr_time_t duration;
+  int bucket = 0;
+
+  if (start == 0)
+    return;
+
+  for (duration = apr_time_now() - start;
+       duration > 0 && bucket < SVN_CACHE__LATENCY_BUCKETS - 1;
+       duration >>= 1)
+    ++bucket;
+
+  histogram[bucket]++;
+}
+
 /* Return the prefix key used by CACHE. */
 static const char *
 get_prefix_key(const svn_membuffer_cache_t *cache)
@@ -2927,6 +4062,7 @@ svn_membuffer_cache_get(void **value_p,
                         apr_pool_t *result_pool)
 {
   svn_membuffer_cache_t *cache = cache_void;
+  apr_time_t start;
 
   DEBUG_CACHE_MEMBUFFER_INIT_TAG(result_pool)
 
@@ -2939,6 +4075,8 @@ svn_membuffer_cache_get(void **value_p,
       return SVN_NO_ERROR;
     }
 
+  start = start_latency_sample(cache->stats->gets++);
+
   /* construct the full, i.e. globally unique, key by adding
    * this cache instances' prefix
    */
@@ -2954,6 +4092,10 @@ svn_membuffer_cache_get(void **value_p,
 
   /* return result */
   *found = *value_p != NULL;
+  if (*found)
+    cache->stats->hits++;
+
+  finish_latency_sample(cache->stats->get_latency, start);
 
   return SVN_NO_ERROR;
 }
@@ -2999,6 +4141,7 @@ svn_membuffer_cache_set(void *cache_void,
                         apr_pool_t *scratch_pool)
 {
   svn_membuffer_cache_t *cache = cache_void;
+  apr_time_t start;
 
   DEBUG_CACHE_MEMBUFFER_INIT_TAG(scratch_pool)
 
@@ -3006,6 +4149,8 @@ svn_membuffer_cache_set(void *cache_void,
   if (key == NULL)
     return SVN_NO_ERROR;
 
+  start = start_latency_sample(cache->stats->sets++);
+
   /* construct the full, i.e. globally unique, key by adding
    * this cache instances' prefix
    */
@@ -3014,13 +4159,17 @@ svn_membuffer_cache_set(void *cache_void,
   /* (probably) add the item to the cache. But there is no real guarantee
    * that the item will actually be cached afterwards.
    */
-  return membuffer_cache_set(cache->membuffer,
-                             &cache->combined_key,
-                             value,
-                             cache->serializer,
-                             cache->priority,
-                             DEBUG_CACHE_MEMBUFFER_TAG
-                             scratch_pool);
+  SVN_ERR(membuffer_cache_set(cache->membuffer,
+                              &cache->combined_key,
+                              value,
+                              cache->serializer,
+                              cache->priority,
+                              DEBUG_CACHE_MEMBUFFER_TAG
+                              scratch_pool));
+
+  finish_latency_sample(cache->stats->set_latency, start);
+
+  return SVN_NO_ERROR;
 }
 
 /* Implement svn_cache__vtable_t.iter as "not implemented"
@@ -3048,6 +4197,7 @@ svn_membuffer_cache_get_partial(void **value_p,
                                 apr_pool_t *result_pool)
 {
   svn_membuffer_cache_t *cache = cache_void;
+  apr_time_t start;
 
   DEBUG_CACHE_MEMBUFFER_INIT_TAG(result_pool)
 
@@ -3059,6 +4209,8 @@ svn_membuffer_cache_get_partial(void **value_p,
       return SVN_NO_ERROR;
     }
 
+  start = start_latency_sample(cache->stats->gets++);
+
   combine_key(cache, key, cache->key_len);
   SVN_ERR(membuffer_cache_get_partial(cache->membuffer,
                                       &cache->combined_key,
@@ -3069,6 +4221,11 @@ svn_membuffer_cache_get_partial(void **value_p,
                                       DEBUG_CACHE_MEMBUFFER_TAG
                                       result_pool));
 
+  if (*found)
+    cache->stats->hits++;
+
+  finish_latency_sample(cache->stats->get_latency, start);
+
   return SVN_NO_ERROR;
 }
 
@@ -3087,6 +4244,8 @@ svn_membuffer_cache_set_partial(void *cache_void,
 
   if (key != NULL)
     {
+      apr_time_t start = start_latency_sample(cache->stats->sets++);
+
       combine_key(cache, key, cache->key_len);
       SVN_ERR(membuffer_cache_set_partial(cache->membuffer,
                                           &cache->combined_key,
@@ -3094,6 +4253,8 @@ svn_membuffer_cache_set_partial(void *cache_void,
                                           baton,
                                           DEBUG_CACHE_MEMBUFFER_TAG
                                           scratch_pool));
+
+      finish_latency_sample(cache->stats->set_latency, start);
     }
   return SVN_NO_ERROR;
 }
@@ -3109,9 +4270,15 @@ svn_membuffer_cache_is_cachable(void *cache_void, apr_size_t size)
    * must be small enough to be stored in a 32 bit value.
    */
   svn_membuffer_cache_t *cache = cache_void;
-  return cache->priority > SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY
-       ? cache->membuffer->l2.size >= size && MAX_ITEM_SIZE >= size
-       : size <= cache->membuffer->max_entry_size;
+  svn_boolean_t cachable
+    = cache->priority > SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY
+    ? cache->membuffer->l2.size >= size && MAX_ITEM_SIZE >= size
+    : size <= cache->membuffer->max_entry_size;
+
+  if (!cachable)
+    cache->stats->rejections++;
+
+  return cachable;
 }
 
 /* Add statistics of SEGMENT to INFO.  If INCLUDE_HISTOGRAM is TRUE,
@@ -3431,6 +4598,10 @@ svn_cache__create_membuffer_cache(svn_cache__t **cache_p,
       cache->combined_key.entry_key.key_len = 0;
     }
 
+  /* All front-ends with the same prefix share their statistics. */
+  SVN_ERR(get_prefix_stats(&cache->stats, membuffer->prefix_stats, prefix,
+                           cache->prefix.prefix_idx));
+
   /* initialize the generic cache wrapper
    */
   wrapper->vtable = thread_safe ? &membuffer_cache_synced_vtable
@@ -3448,9 +4619,11 @@ static svn_error_t *
 svn_membuffer_get_global_segment_info(svn_membuffer_t *segment,
                                       svn_cache__info_t *info)
 {
-  info->gets += segment->total_reads;
+  info->gets += segment->total_reads
+              + svn_atomic_read(&segment->lock_free_reads);
   info->sets += segment->total_writes;
-  info->hits += segment->total_hits;
+  info->hits += segment->total_hits
+              + svn_atomic_read(&segment->lock_free_hits);
 
   WITH_READ_LOCK(segment,
                   svn_membuffer_get_segment_info(segment, info, TRUE));
@@ -3478,3 +4651,1170 @@ svn_cache__membuffer_get_global_info(apr_pool_t *pool)
 
   return info;
 }
+
+/* Append a copy of INFO, allocated in RESULT_POOL, to INFOS.  If RESET is
+ * set, reset all access counters in INFO afterwards.
+ */
+static void
+copy_prefix_info(apr_array_header_t *infos,
+                 svn_cache__prefix_info_t *info,
+                 svn_boolean_t reset,
+                 apr_pool_t *result_pool)
+{
+  svn_cache__prefix_info_t *copy = apr_pmemdup(result_pool, info,
+                                               sizeof(*info));
+  copy->prefix = apr_pstrdup(result_pool, info->prefix);
+  APR_ARRAY_PUSH(infos, svn_cache__prefix_info_t *) = copy;
+
+  if (reset)
+    {
+      info->gets = 0;
+      info->hits = 0;
+      info->sets = 0;
+      info->rejections = 0;
+      info->evictions = 0;
+      memset(info->get_latency, 0, sizeof(info->get_latency));
+      memset(info->set_latency, 0, sizeof(info->set_latency));
+    }
+}
+
+/* Implement svn_cache__membuffer_get_prefix_info for the records in
+ * STATS.  The caller must hold the STATS mutex.
+ */
+static svn_error_t *
+get_prefix_info_internal(apr_array_header_t *infos,
+                         prefix_stats_t *stats,
+                         svn_boolean_t reset,
+                         apr_pool_t *result_pool)
+{
+  apr_hash_index_t *hi;
+
+  for (hi = apr_hash_first(NULL, stats->map); hi; hi = apr_hash_next(hi))
+    copy_prefix_info(infos, apr_hash_this_val(hi), reset, result_pool);
+
+  if (stats->other)
+    copy_prefix_info(infos, stats->other, reset, result_pool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Compare the svn_cache__prefix_info_t * at A and B by prefix. */
+static int
+compare_prefix_info(const void *a,
+                    const void *b)
+{
+  const svn_cache__prefix_info_t *lhs
+    = *(const svn_cache__prefix_info_t * const *)a;
+  const svn_cache__prefix_info_t *rhs
+    = *(const svn_cache__prefix_info_t * const *)b;
+
+  return strcmp(lhs->prefix, rhs->prefix);
+}
+
+svn_error_t *
+svn_cache__membuffer_get_prefix_info(apr_array_header_t **infos,
+                                     svn_membuffer_t *cache,
+                                     svn_boolean_t reset,
+                                     apr_pool_t *result_pool)
+{
+  prefix_stats_t *stats = cache->prefix_stats;
+
+  *infos = apr_array_make(result_pool, 16,
+                          sizeof(svn_cache__prefix_info_t *));
+  SVN_MUTEX__WITH_LOCK(stats->mutex,
+                       get_prefix_info_internal(*infos, stats, reset,
+                                                result_pool));
+  svn_sort__array(*infos, compare_prefix_info);
+
+  return SVN_NO_ERROR;
+}
+
+
+/* Snapshot support.
+ *
+ * A snapshot file starts with SNAPSHOT_MAGIC, a byte order mark, the
+ * SNAPSHOT_FORMAT number and a random ID.  It is followed by one section
+ * per stamped key root, a directory of these sections and finally the
+ * offset of that directory.  For each section, the directory lists its
+ * key root, stamp, offset, length and checksum.
+ *
+ * Each section begins with the list of the shared key prefixes used by
+ * its entries.  The entry records follow and SNAPSHOT_END_OF_SECTION
+ * terminates the list.  Every record contains the entry key, the index
+ * of the shared prefix (or NO_INDEX), the priority and the entry data
+ * as found in the cache's data buffer, i.e. including the full key.
+ *
+ * All numbers are stored in host byte order.  Snapshots are not meant
+ * to be portable; we only make sure to reject foreign ones.
+ */
+
+/* First bytes of any snapshot file. */
+#define SNAPSHOT_MAGIC "SVN-MBUF"
+
+/* The snapshot file format that we write and read. */
+#define SNAPSHOT_FORMAT 2
+
+/* Used to detect snapshots written on platforms with different byte
+ * order. */
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+/* Entry size that marks the end of a snapshot section. */
+#define SNAPSHOT_END_OF_SECTION (~(apr_uint64_t)0)
+
+/* Upper limit for the length of any string in a snapshot. */
+#define SNAPSHOT_MAX_STRING_LEN 0x100000
+
+/* Checksum kind protecting the snapshot sections. */
+#define SNAPSHOT_CHECKSUM svn_checksum_fnv1a_32x4
+
+/* Key prefix of the cache entries that store the stamps. */
+#define STAMP_PREFIX "svn:membuffer-stamp"
+
+/* Return an error stating that the snapshot at PATH is corrupt.
+ * Use SCRATCH_POOL for temporary allocations.
+ */
+static svn_error_t *
+snapshot_corrupt(const char *path,
+                 apr_pool_t *scratch_pool)
+{
+  return svn_error_createf(SVN_ERR_MALFORMED_FILE, NULL,
+                           _("Corrupt cache snapshot '%s'"),
+                           svn_dirent_local_style(path, scratch_pool));
+}
+
+/* Return a copy of SECTION allocated in RESULT_POOL. */
+static snapshot_section_t *
+dup_section(const snapshot_section_t *section,
+            apr_pool_t *result_pool)
+{
+  snapshot_section_t *copy = apr_pmemdup(result_pool, section,
+                                         sizeof(*section));
+  copy->root = apr_pstrdup(result_pool, section->root);
+  copy->path = apr_pstrdup(result_pool, section->path);
+  copy->id = apr_pstrdup(result_pool, section->id);
+  copy->stamp = apr_pstrdup(result_pool, section->stamp);
+  copy->checksum = svn_checksum_dup(section->checksum, result_pool);
+
+  return copy;
+}
+
+/* Sequential writer for snapshot files. */
+typedef struct snapshot_writer_t
+{
+  /* Target to write to. */
+  svn_stream_t *stream;
+
+  /* Number of bytes written so far. */
+  apr_off_t offset;
+
+  /* Checksum over all data written since the start of the current
+   * section. */
+  svn_checksum_ctx_t *checksum_ctx;
+} snapshot_writer_t;
+
+/* Write the LEN bytes at DATA to WRITER.
+ */
+static svn_error_t *
+write_data(snapshot_writer_t *writer,
+           const void *data,
+           apr_size_t len)
+{
+  SVN_ERR(svn_stream_write(writer->stream, data, &len));
+  SVN_ERR(svn_checksum_update(writer->checksum_ctx, data, len));
+  writer->offset += len;
+
+  return SVN_NO_ERROR;
+}
+
+/* Write VALUE to WRITER. */
+static svn_error_t *
+write_uint32(snapshot_writer_t *writer,
+             apr_uint32_t value)
+{
+  return write_data(writer, &value, sizeof(value));
+}
+
+/* Write VALUE to WRITER. */
+static svn_error_t *
+write_uint64(snapshot_writer_t *writer,
+             apr_uint64_t value)
+{
+  return write_data(writer, &value, sizeof(value));
+}
+
+/* Write the length of the C string VALUE followed by its contents
+ * to WRITER. */
+static svn_error_t *
+write_string(snapshot_writer_t *writer,
+             const char *value)
+{
+  apr_size_t len = strlen(value);
+  SVN_ERR(write_uint32(writer, (apr_uint32_t)len));
+
+  return write_data(writer, value, len);
+}
+
+/* Start a new section for key ROOT with STAMP in WRITER.  Return its
+ * description in *SECTION, allocated in RESULT_POOL.
+ */
+static svn_error_t *
+begin_section(snapshot_section_t **section,
+              snapshot_writer_t *writer,
+              const char *root,
+              const char *stamp,
+              apr_pool_t *result_pool)
+{
+  *section = apr_pcalloc(result_pool, sizeof(**section));
+  (*section)->root = root;
+  (*section)->stamp = stamp;
+  (*section)->offset = writer->offset;
+
+  return svn_error_trace(svn_checksum_ctx_reset(writer->checksum_ctx));
+}
+
+/* Set the length and checksum of SECTION after all of its contents have
+ * been written to WRITER.  Allocate the checksum in RESULT_POOL.
+ */
+static svn_error_t *
+end_section(snapshot_section_t *section,
+            snapshot_writer_t *writer,
+            apr_pool_t *result_pool)
+{
+  svn_checksum_t *checksum;
+
+  SVN_ERR(svn_checksum_final(&checksum, writer->checksum_ctx, result_pool));
+  section->checksum = checksum;
+  section->length = writer->offset - section->offset;
+
+  return SVN_NO_ERROR;
+}
+
+/* Read exactly LEN bytes from FILE into DATA.  Use SCRATCH_POOL for
+ * temporary allocations. */
+static svn_error_t *
+read_data(apr_file_t *file,
+          void *data,
+          apr_size_t len,
+          apr_pool_t *scratch_pool)
+{
+  return svn_error_trace(svn_io_file_read_full2(file, data, len, NULL,
+                                                NULL, scratch_pool));
+}
+
+/* Read *VALUE from FILE.  Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+read_uint32(apr_uint32_t *value,
+            apr_file_t *file,
+            apr_pool_t *scratch_pool)
+{
+  return read_data(file, value, sizeof(*value), scratch_pool);
+}
+
+/* Read *VALUE from FILE.  Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+read_uint64(apr_uint64_t *value,
+            apr_file_t *file,
+            apr_pool_t *scratch_pool)
+{
+  return read_data(file, value, sizeof(*value), scratch_pool);
+}
+
+/* Read a string written by write_string() from FILE at PATH and return
+ * it in *VALUE, allocated in RESULT_POOL. */
+static svn_error_t *
+read_string(const char **value,
+            apr_file_t *file,
+            const char *path,
+            apr_pool_t *result_pool)
+{
+  apr_uint32_t len;
+  char *buffer;
+
+  SVN_ERR(read_uint32(&len, file, result_pool));
+  if (len > SNAPSHOT_MAX_STRING_LEN)
+    return svn_error_trace(snapshot_corrupt(path, result_pool));
+
+  buffer = apr_palloc(result_pool, len + 1);
+  SVN_ERR(read_data(file, buffer, len, result_pool));
+  buffer[len] = '\0';
+
+  *value = buffer;
+  return SVN_NO_ERROR;
+}
+
+/* Read and verify the header of the snapshot FILE at PATH.  Return the
+ * snapshot's ID in *ID, allocated in RESULT_POOL.
+ */
+static svn_error_t *
+read_header(const char **id,
+            apr_file_t *file,
+            const char *path,
+            apr_pool_t *result_pool)
+{
+  char magic[sizeof(SNAPSHOT_MAGIC) - 1];
+  apr_uint32_t byte_order;
+  apr_uint32_t format;
+
+  SVN_ERR(read_data(file, magic, sizeof(magic), result_pool));
+  SVN_ERR(read_uint32(&byte_order, file, result_pool));
+  if (   memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic))
+      || byte_order != SNAPSHOT_BYTE_ORDER)
+    return svn_error_createf(SVN_ERR_MALFORMED_FILE, NULL,
+                             _("'%s' is not a cache snapshot for this "
+                               "platform"),
+                             svn_dirent_local_style(path, result_pool));
+
+  SVN_ERR(read_uint32(&format, file, result_pool));
+  if (format != SNAPSHOT_FORMAT)
+    return svn_error_createf(SVN_ERR_BAD_VERSION_FILE_FORMAT, NULL,
+                             _("Unsupported cache snapshot format %d "
+                               "in '%s'"),
+                             (int)format,
+                             svn_dirent_local_style(path, result_pool));
+
+  return svn_error_trace(read_string(id, file, path, result_pool));
+}
+
+/* Open the snapshot file that contains SECTION and return it in *FILE,
+ * allocated in RESULT_POOL.  Set *FILE to NULL if that snapshot has been
+ * removed or replaced in the meantime.
+ */
+static svn_error_t *
+open_section(apr_file_t **file,
+             const snapshot_section_t *section,
+             apr_pool_t *result_pool)
+{
+  const char *id;
+  svn_error_t *err;
+
+  err = svn_io_file_open(file, section->path, APR_READ | APR_BUFFERED,
+                         APR_OS_DEFAULT, result_pool);
+  if (err && APR_STATUS_IS_ENOENT(err->apr_err))
+    {
+      svn_error_clear(err);
+      *file = NULL;
+      return SVN_NO_ERROR;
+    }
+
+  SVN_ERR(err);
+  SVN_ERR(read_header(&id, *file, section->path, result_pool));
+  if (strcmp(id, section->id))
+    {
+      SVN_ERR(svn_io_file_close(*file, result_pool));
+      *file = NULL;
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Read all of SECTION from FILE and verify its checksum.  If WRITER is
+ * not NULL, append the data to it.  Use SCRATCH_POOL for temporary
+ * allocations.
+ */
+static svn_error_t *
+read_section(apr_file_t *file,
+             const snapshot_section_t *section,
+             snapshot_writer_t *writer,
+             apr_pool_t *scratch_pool)
+{
+  svn_checksum_ctx_t *context
+    = svn_checksum_ctx_create(SNAPSHOT_CHECKSUM, scratch_pool);
+  char *buffer = apr_palloc(scratch_pool, SVN__STREAM_CHUNK_SIZE);
+  apr_off_t offset = section->offset;
+  apr_off_t remaining = section->length;
+  svn_checksum_t *checksum;
+
+  SVN_ERR(svn_io_file_seek(file, APR_SET, &offset, scratch_pool));
+  while (remaining > 0)
+    {
+      apr_size_t len = (apr_size_t)MIN(remaining, SVN__STREAM_CHUNK_SIZE);
+
+      SVN_ERR(read_data(file, buffer, len, scratch_pool));
+      SVN_ERR(svn_checksum_update(context, buffer, len));
+      if (writer)
+        SVN_ERR(write_data(writer, buffer, len));
+
+      remaining -= len;
+    }
+
+  SVN_ERR(svn_checksum_final(&checksum, context, scratch_pool));
+  if (!svn_checksum_match(checksum, section->checksum))
+    return svn_error_trace(snapshot_corrupt(section->path, scratch_pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Add the stamps stored in SEGMENT to STAMPS, mapping key roots to
+ * stamps, both allocated in RESULT_POOL.
+ */
+static svn_error_t *
+collect_stamps(apr_hash_t *stamps,
+               svn_membuffer_t *segment,
+               apr_pool_t *result_pool)
+{
+  cache_level_t *levels[2];
+  apr_size_t prefix_len = ALIGN_VALUE(sizeof(STAMP_PREFIX));
+  int i;
+
+  levels[0] = &segment->l1;
+  levels[1] = &segment->l2;
+
+  for (i = 0; i < 2; ++i)
+    {
+      apr_uint32_t idx;
+      entry_t *entry;
+
+      for (idx = levels[i]->first; idx != NO_INDEX; idx = entry->next)
+        {
+          const char *data;
+          entry = get_entry(segment, idx);
+          data = (const char *)segment->data + entry->offset;
+
+          /* The stamp cache uses full keys.  Its entries contain the
+           * prefix, the key root and the stamp, all NUL-terminated. */
+          if (   entry->key.prefix_idx != NO_INDEX
+              || entry->key.key_len <= prefix_len
+              || memcmp(data, STAMP_PREFIX, sizeof(STAMP_PREFIX)))
+            continue;
+
+          svn_hash_sets(stamps,
+                        apr_pstrndup(result_pool, data + prefix_len,
+                                     entry->key.key_len - prefix_len),
+                        apr_pstrndup(result_pool,
+                                     data + entry->key.key_len,
+                                     entry->size - entry->key.key_len));
+        }
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Add copies of all sections of SNAPSHOT that have not been imported,
+ * yet, and whose key root is not in STAMPS to PENDING.  Allocate them
+ * in RESULT_POOL.  To be called by collect_pending() only.
+ */
+static svn_error_t *
+collect_pending_internal(apr_array_header_t *pending,
+                         snapshot_t *snapshot,
+                         apr_hash_t *stamps,
+                         apr_pool_t *result_pool)
+{
+  apr_hash_index_t *hi;
+
+  if (snapshot->sections == NULL)
+    return SVN_NO_ERROR;
+
+  for (hi = apr_hash_first(result_pool, snapshot->sections);
+       hi;
+       hi = apr_hash_next(hi))
+    {
+      const snapshot_section_t *section = apr_hash_this_val(hi);
+      if (svn_hash_gets(stamps, section->root) == NULL)
+        APR_ARRAY_PUSH(pending, snapshot_section_t *)
+          = dup_section(section, result_pool);
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Thread-safe wrapper around collect_pending_internal. */
+static svn_error_t *
+collect_pending(apr_array_header_t *pending,
+                snapshot_t *snapshot,
+                apr_hash_t *stamps,
+                apr_pool_t *result_pool)
+{
+  SVN_MUTEX__WITH_LOCK(snapshot->mutex,
+                       collect_pending_internal(pending, snapshot, stamps,
+                                                result_pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Baton type used while writing a snapshot section. */
+typedef struct write_section_baton_t
+{
+  /* Where to write the entries to. */
+  snapshot_writer_t *writer;
+
+  /* Only write entries whose key prefix starts with ROOT. */
+  const char *root;
+  apr_size_t root_len;
+
+  /* Maps all prefix pool indexes below PREFIX_COUNT to the respective
+   * index within the section's prefix list or to NO_INDEX, if those
+   * prefixes don't belong to ROOT. */
+  apr_uint32_t *prefix_map;
+  apr_uint32_t prefix_count;
+
+  /* The prefixes (const char *) used in the section. */
+  apr_array_header_t *prefixes;
+} write_section_baton_t;
+
+/* Initialize BATON->PREFIX_MAP, ->PREFIX_COUNT and ->PREFIXES from
+ * PREFIX_POOL.  Allocate those in RESULT_POOL.  To be called by
+ * map_prefixes() only.
+ */
+static svn_error_t *
+map_prefixes_internal(write_section_baton_t *baton,
+                      prefix_pool_t *prefix_pool,
+                      apr_pool_t *result_pool)
+{
+  apr_uint32_t i;
+
+  baton->prefix_count = prefix_pool->values_used;
+  baton->prefix_map = apr_palloc(result_pool,
+                                 baton->prefix_count
+                                 * sizeof(*baton->prefix_map));
+  baton->prefixes = apr_array_make(result_pool, 16, sizeof(const char *));
+
+  for (i = 0; i < baton->prefix_count; ++i)
+    if (strncmp(prefix_pool->values[i], baton->root, baton->root_len) == 0)
+      {
+        baton->prefix_map[i] = baton->prefixes->nelts;
+        APR_ARRAY_PUSH(baton->prefixes, const char *)
+          = apr_pstrdup(result_pool, prefix_pool->values[i]);
+      }
+    else
+      {
+        baton->prefix_map[i] = NO_INDEX;
+      }
+
+  return SVN_NO_ERROR;
+}
+
+/* Thread-safe wrapper around map_prefixes_internal. */
+static svn_error_t *
+map_prefixes(write_section_baton_t *baton,
+             prefix_pool_t *prefix_pool,
+             apr_pool_t *result_pool)
+{
+  SVN_MUTEX__WITH_LOCK(prefix_pool->mutex,
+                       map_prefixes_internal(baton, prefix_pool,
+                                             result_pool));
+
+  return SVN_NO_ERROR;
+}
+/* Write all entries of SEGMENT whose key prefix starts with BATON->ROOT
+ * to BATON->WRITER.
+ */
+static svn_error_t *
+write_section_entries(write_section_baton_t *baton,
+                      svn_membuffer_t *segment)
+{
+  cache_level_t *levels[2];
+  int i;
+
+  levels[0] = &segment->l1;
+  levels[1] = &segment->l2;
+
+  for (i = 0; i < 2; ++i)
+    {
+      apr_uint32_t idx;
+      entry_t *entry;
+
+      for (idx = levels[i]->first; idx != NO_INDEX; idx = entry->next)
+        {
+          const char *data;
+          apr_uint32_t prefix = NO_INDEX;
+
+          entry = get_entry(segment, idx);
+          data = (const char *)segment->data + entry->offset;
+
+          if (entry->key.prefix_idx != NO_INDEX)
+            {
+              if (entry->key.prefix_idx >= baton->prefix_count)
+                continue;
+
+              prefix = baton->prefix_map[entry->key.prefix_idx];
+              if (prefix == NO_INDEX)
+                continue;
+            }
+          else if (   entry->key.key_len < baton->root_len
+                   || memcmp(data, baton->root, baton->root_len))
+            {
+              continue;
+            }
+
+          SVN_ERR(write_uint64(baton->writer, entry->size));
+          SVN_ERR(write_uint64(baton->writer, entry->key.fingerprint[0]));
+          SVN_ERR(write_uint64(baton->writer, entry->key.fingerprint[1]));
+          SVN_ERR(write_uint64(baton->writer, entry->key.key_len));
+          SVN_ERR(write_uint32(baton->writer, prefix));
+          SVN_ERR(write_uint32(baton->writer, entry->priority));
+          SVN_ERR(write_data(baton->writer, data, entry->size));
+        }
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Append the data of SECTION, written by a previous snapshot, to WRITER
+ * and add its new description to SECTIONS, allocated in RESULT_POOL.
+ * Skip SECTION if its snapshot is no longer available or if it got
+ * corrupted.  Use SCRATCH_POOL for temporary allocations.
+ */
+static svn_error_t *
+copy_section(apr_array_header_t *sections,
+             snapshot_writer_t *writer,
+             const snapshot_section_t *section,
+             apr_pool_t *result_pool,
+             apr_pool_t *scratch_pool)
+{
+  snapshot_section_t *copy;
+  apr_file_t *file = NULL;
+  svn_error_t *err;
+
+  /* Verify the data before writing any of it, such that a broken
+   * section can't spoil the new snapshot. */
+  err = open_section(&file, section, scratch_pool);
+  if (!err && file)
+    err = read_section(file, section, NULL, scratch_pool);
+
+  if (err || !file)
+    {
+      svn_error_clear(err);
+      return SVN_NO_ERROR;
+    }
+
+  SVN_ERR(begin_section(&copy, writer, section->root, section->stamp,
+                        result_pool));
+  SVN_ERR(read_section(file, section, writer, scratch_pool));
+  SVN_ERR(end_section(copy, writer, result_pool));
+  APR_ARRAY_PUSH(sections, snapshot_section_t *) = copy;
+
+  return svn_error_trace(svn_io_file_close(file, scratch_pool));
+}
+
+/* Write the snapshot contents for CACHE to WRITER, using ID as the
+ * snapshot's ID.  Write one section for each key root in STAMPS, as
+ * returned by collect_stamps(), and copy the PENDING sections of the
+ * previous snapshot.  Add the descriptions of all sections written to
+ * SECTIONS, allocated in RESULT_POOL.  Use SCRATCH_POOL for temporary
+ * allocations.
+ */
+static svn_error_t *
+write_snapshot(apr_array_header_t *sections,
+               snapshot_writer_t *writer,
+               svn_membuffer_t *cache,
+               const char *id,
+               apr_hash_t *stamps,
+               const apr_array_header_t *pending,
+               apr_pool_t *result_pool,
+               apr_pool_t *scratch_pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  apr_off_t directory_offset;
+  apr_hash_index_t *hi;
+  int i;
+
+  SVN_ERR(write_data(writer, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC) - 1));
+  SVN_ERR(write_uint32(writer, SNAPSHOT_BYTE_ORDER));
+  SVN_ERR(write_uint32(writer, SNAPSHOT_FORMAT));
+  SVN_ERR(write_string(writer, id));
+
+  /* One section per key root. */
+  for (hi = apr_hash_first(scratch_pool, stamps); hi; hi = apr_hash_next(hi))
+    {
+      write_section_baton_t baton = { 0 };
+      snapshot_section_t *section;
+      apr_uint32_t seg;
+      int k;
+
+      svn_pool_clear(iterpool);
+
+      baton.writer = writer;
+      baton.root = apr_hash_this_key(hi);
+      baton.root_len = apr_hash_this_key_len(hi);
+      SVN_ERR(map_prefixes(&baton, cache->prefix_pool, iterpool));
+
+      SVN_ERR(begin_section(&section, writer, baton.root,
+                            apr_hash_this_val(hi), result_pool));
+      SVN_ERR(write_uint32(writer, (apr_uint32_t)baton.prefixes->nelts));
+      for (k = 0; k < baton.prefixes->nelts; ++k)
+        SVN_ERR(write_string(writer, APR_ARRAY_IDX(baton.prefixes, k,
+                                                   const char *)));
+
+      for (seg = 0; seg < cache->segment_count; ++seg)
+        WITH_READ_LOCK(cache + seg,
+                       write_section_entries(&baton, cache + seg));
+
+      SVN_ERR(write_uint64(writer, SNAPSHOT_END_OF_SECTION));
+      SVN_ERR(end_section(section, writer, result_pool));
+      APR_ARRAY_PUSH(sections, snapshot_section_t *) = section;
+    }
+
+  /* Sections that have not been imported, yet. */
+  for (i = 0; i < pending->nelts; ++i)
+    {
+      svn_pool_clear(iterpool);
+      SVN_ERR(copy_section(sections, writer,
+                           APR_ARRAY_IDX(pending, i, snapshot_section_t *),
+                           result_pool, iterpool));
+    }
+
+  /* The directory of sections. */
+  directory_offset = writer->offset;
+  SVN_ERR(write_uint32(writer, (apr_uint32_t)sections->nelts));
+  for (i = 0; i < sections->nelts; ++i)
+    {
+      const snapshot_section_t *section
+        = APR_ARRAY_IDX(sections, i, const snapshot_section_t *);
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(write_string(writer, section->root));
+      SVN_ERR(write_string(writer, section->stamp));
+      SVN_ERR(write_uint64(writer, section->offset));
+      SVN_ERR(write_uint64(writer, section->length));
+      SVN_ERR(write_string(writer, svn_checksum_serialize(section->checksum,
+                                                          iterpool,
+                                                          iterpool)));
+    }
+
+  SVN_ERR(write_uint64(writer, directory_offset));
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Make the not yet imported sections of SNAPSHOT refer to their copies
+ * in SECTIONS, which have been written to the snapshot at PATH with ID.
+ * To be called by update_pending() only.
+ */
+static svn_error_t *
+update_pending_internal(snapshot_t *snapshot,
+                        const apr_array_header_t *sections,
+                        const char *path,
+                        const char *id)
+{
+  int i;
+
+  if (snapshot->sections == NULL)
+    return SVN_NO_ERROR;
+
+  path = apr_pstrdup(snapshot->pool, path);
+  id = apr_pstrdup(snapshot->pool, id);
+
+  for (i = 0; i < sections->nelts; ++i)
+    {
+      const snapshot_section_t *section
+        = APR_ARRAY_IDX(sections, i, const snapshot_section_t *);
+
+      if (svn_hash_gets(snapshot->sections, section->root))
+        {
+          snapshot_section_t *copy = dup_section(section, snapshot->pool);
+          copy->path = path;
+          copy->id = id;
+          svn_hash_sets(snapshot->sections, copy->root, copy);
+        }
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Thread-safe wrapper around update_pending_internal. */
+static svn_error_t *
+update_pending(snapshot_t *snapshot,
+               const apr_array_header_t *sections,
+               const char *path,
+               const char *id)
+{
+  SVN_MUTEX__WITH_LOCK(snapshot->mutex,
+                       update_pending_internal(snapshot, sections, path,
+                                               id));
+
+  return SVN_NO_ERROR;
+}
+
+svn_error_t *
+svn_cache__membuffer_save(svn_membuffer_t *cache,
+                          const char *path,
+                          apr_pool_t *scratch_pool)
+{
+  apr_hash_t *stamps = apr_hash_make(scratch_pool);
+  apr_array_header_t *pending
+    = apr_array_make(scratch_pool, 0, sizeof(snapshot_section_t *));
+  apr_array_header_t *sections
+    = apr_array_make(scratch_pool, 16, sizeof(snapshot_section_t *));
+  const char *id = svn_uuid_generate(scratch_pool);
+  snapshot_writer_t writer;
+  apr_file_t *file;
+  const char *temp_path;
+  apr_uint32_t seg;
+  svn_error_t *err;
+
+  /* Only entries whose stamps we know can be validated upon reload. */
+  for (seg = 0; seg < cache->segment_count; ++seg)
+    WITH_READ_LOCK(cache + seg,
+                   collect_stamps(stamps, cache + seg, scratch_pool));
+
+  /* Data from the previous snapshot that nobody asked for, yet, is still
+   * valid.  Keep it. */
+  SVN_ERR(collect_pending(pending, cache->snapshot, stamps, scratch_pool));
+
+  /* Never replace an existing snapshot with an empty one.  That happens
+   * e.g. when the server gets stopped before it opened any repository. */
+  if (apr_hash_count(stamps) == 0 && pending->nelts == 0)
+    return SVN_NO_ERROR;
+
+  /* Write to a temporary file first such that we never leave a
+   * partially written snapshot behind. */
+  SVN_ERR(svn_io_open_unique_file3(&file, &temp_path,
+                                   svn_dirent_dirname(path, scratch_pool),
+                                   svn_io_file_del_none,
+                                   scratch_pool, scratch_pool));
+
+  writer.stream = svn_stream_from_aprfile2(file, TRUE, scratch_pool);
+  writer.offset = 0;
+  writer.checksum_ctx = svn_checksum_ctx_create(SNAPSHOT_CHECKSUM,
+                                                scratch_pool);
+
+  err = write_snapshot(sections, &writer, cache, id, stamps, pending,
+                       scratch_pool, scratch_pool);
+  err = svn_error_compose_create(err, svn_stream_close(writer.stream));
+  err = svn_error_compose_create(err, svn_io_file_close(file,
+                                                        scratch_pool));
+
+  /* The pending sections may all have been unreadable. */
+  if (!err && sections->nelts == 0)
+    return svn_error_trace(svn_io_remove_file2(temp_path, TRUE,
+                                               scratch_pool));
+
+  if (!err)
+    err = svn_io_file_rename2(temp_path, path, FALSE, scratch_pool);
+
+  if (err)
+    return svn_error_compose_create(err,
+                                    svn_io_remove_file2(temp_path, TRUE,
+                                                        scratch_pool));
+
+  /* The previous snapshot may just have been replaced. */
+  return svn_error_trace(update_pending(cache->snapshot, sections, path,
+                                        id));
+}
+
+/* Read the section directory of the snapshot at PATH into SNAPSHOT,
+ * replacing its previous contents.  To be called by
+ * svn_cache__membuffer_load() only.
+ */
+static svn_error_t *
+load_snapshot(snapshot_t *snapshot,
+              const char *path,
+              apr_pool_t *scratch_pool)
+{
+  apr_hash_t *sections;
+  apr_file_t *file;
+  const char *id;
+  apr_uint64_t directory_offset;
+  apr_off_t offset;
+  apr_uint32_t count, i;
+
+  /* Should loading fail, leave SNAPSHOT empty. */
+  svn_pool_clear(snapshot->pool);
+  snapshot->sections = NULL;
+  snapshot->enabled = TRUE;
+
+  SVN_ERR(svn_io_file_open(&file, path, APR_READ | APR_BUFFERED,
+                           APR_OS_DEFAULT, scratch_pool));
+  SVN_ERR(read_header(&id, file, path, snapshot->pool));
+
+  offset = -(apr_off_t)sizeof(directory_offset);
+  SVN_ERR(svn_io_file_seek(file, APR_END, &offset, scratch_pool));
+  SVN_ERR(read_uint64(&directory_offset, file, scratch_pool));
+  if (directory_offset >= (apr_uint64_t)offset)
+    return svn_error_trace(snapshot_corrupt(path, scratch_pool));
+
+  offset = (apr_off_t)directory_offset;
+  SVN_ERR(svn_io_file_seek(file, APR_SET, &offset, scratch_pool));
+
+  sections = apr_hash_make(snapshot->pool);
+  SVN_ERR(read_uint32(&count, file, scratch_pool));
+  for (i = 0; i < count; ++i)
+    {
+      snapshot_section_t *section = apr_pcalloc(snapshot->pool,
+                                                sizeof(*section));
+      const char *checksum;
+      apr_uint64_t section_offset, section_length;
+
+      SVN_ERR(read_string(&section->root, file, path, snapshot->pool));
+      SVN_ERR(read_string(&section->stamp, file, path, snapshot->pool));
+      SVN_ERR(read_uint64(&section_offset, file, scratch_pool));
+      SVN_ERR(read_uint64(&section_length, file, scratch_pool));
+      SVN_ERR(read_string(&checksum, file, path, scratch_pool));
+      if (   section_offset >= directory_offset
+          || section_length > directory_offset - section_offset)
+        return svn_error_trace(snapshot_corrupt(path, scratch_pool));
+
+      SVN_ERR(svn_checksum_deserialize(&section->checksum, checksum,
+                                       snapshot->pool, scratch_pool));
+      if (section->checksum->kind != SNAPSHOT_CHECKSUM)
+        return svn_error_trace(snapshot_corrupt(path, scratch_pool));
+
+      section->path = apr_pstrdup(snapshot->pool, path);
+      section->id = id;
+      section->offset = (apr_off_t)section_offset;
+      section->length = (apr_off_t)section_length;
+      svn_hash_sets(sections, section->root, section);
+    }
+
+  SVN_ERR(svn_io_file_close(file, scratch_pool));
+  snapshot->sections = sections;
+
+  return SVN_NO_ERROR;
+}
+
+svn_error_t *
+svn_cache__membuffer_load(svn_membuffer_t *cache,
+                          const char *path,
+                          apr_pool_t *scratch_pool)
+{
+  snapshot_t *snapshot = cache->snapshot;
+  SVN_MUTEX__WITH_LOCK(snapshot->mutex,
+                       load_snapshot(snapshot, path, scratch_pool));
+
+  return SVN_NO_ERROR;
+}
+
+svn_boolean_t
+svn_cache__membuffer_uses_snapshots(svn_membuffer_t *cache)
+{
+  return cache->snapshot->enabled;
+}
+
+/* Remove the section for ROOT from SNAPSHOT and return a copy of it in
+ * *SECTION, allocated in RESULT_POOL.  Set it to NULL if there is no such
+ * section.  To be called by take_section() only.
+ */
+static svn_error_t *
+take_section_internal(snapshot_section_t **section,
+                      snapshot_t *snapshot,
+                      const char *root,
+                      apr_pool_t *result_pool)
+{
+  snapshot_section_t *found = snapshot->sections
+                            ? svn_hash_gets(snapshot->sections, root)
+                            : NULL;
+
+  *section = NULL;
+  if (found)
+    {
+      *section = dup_section(found, result_pool);
+      svn_hash_sets(snapshot->sections, root, NULL);
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Thread-safe wrapper around take_section_internal. */
+static svn_error_t *
+take_section(snapshot_section_t **section,
+             snapshot_t *snapshot,
+             const char *root,
+             apr_pool_t *result_pool)
+{
+  SVN_MUTEX__WITH_LOCK(snapshot->mutex,
+                       take_section_internal(section, snapshot, root,
+                                             result_pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Return TRUE if the fingerprint in KEY matches the full key at the
+ * start of DATA, i.e. the NUL-terminated key prefix padded to
+ * ITEM_ALIGNMENT followed by the zero-padded key.  See
+ * combine_long_key().
+ */
+static svn_boolean_t
+full_key_matches(const entry_key_t *key,
+                 const char *data)
+{
+  const char *prefix_end = memchr(data, 0, key->key_len);
+  const unsigned char *key_data;
+  unsigned char prefix_digest[APR_MD5_DIGESTSIZE];
+  apr_uint64_t prefix_fingerprint[2];
+  apr_size_t prefix_len, aligned_len, len;
+
+  if (prefix_end == NULL)
+    return FALSE;
+
+  prefix_len = ALIGN_VALUE(prefix_end - data + 1);
+  if (prefix_len > key->key_len)
+    return FALSE;
+
+  apr_md5(prefix_digest, data, prefix_end - data);
+  memcpy(prefix_fingerprint, prefix_digest, sizeof(prefix_fingerprint));
+
+  /* We don't know how many of the trailing zeros are padding. */
+  key_data = (const unsigned char *)data + prefix_len;
+  aligned_len = key->key_len - prefix_len;
+  for (len = aligned_len; ALIGN_VALUE(len) == aligned_len; --len)
+    {
+      apr_uint64_t fingerprint[2];
+      svn__fnv1a_32x4_raw((apr_uint32_t *)fingerprint, key_data, len);
+
+      if (   (fingerprint[0] ^ prefix_fingerprint[0]) == key->fingerprint[0]
+          && (fingerprint[1] ^ prefix_fingerprint[1]) == key->fingerprint[1])
+        return TRUE;
+
+      if (len == 0 || key_data[len - 1] != 0)
+        break;
+    }
+
+  return FALSE;
+}
+
+/* Copy all entries from the snapshot SECTION into CACHE.  Use
+ * SCRATCH_POOL for temporary allocations.
+ */
+static svn_error_t *
+import_section(svn_membuffer_t *cache,
+               const snapshot_section_t *section,
+               apr_pool_t *scratch_pool)
+{
+#ifdef SVN_DEBUG_CACHE_MEMBUFFER
+
+  /* Imported entries would not have the tags required by the debug
+   * checks.  Simply start with an empty cache. */
+  return SVN_NO_ERROR;
+
+#else
+
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  const char *path = section->path;
+  apr_file_t *file;
+  apr_uint32_t *prefix_map;
+  apr_uint32_t prefix_count, i;
+  apr_off_t offset = section->offset;
+  svn_membuf_t buffer;
+
+  /* The snapshot may have been removed or replaced in the meantime. */
+  SVN_ERR(open_section(&file, section, scratch_pool));
+  if (file == NULL)
+    return SVN_NO_ERROR;
+
+  /* Don't parse any data that we did not verify. */
+  SVN_ERR(read_section(file, section, NULL, scratch_pool));
+  SVN_ERR(svn_io_file_seek(file, APR_SET, &offset, scratch_pool));
+
+  /* Our prefix pool indexes will differ from the ones in the snapshot. */
+  SVN_ERR(read_uint32(&prefix_count, file, scratch_pool));
+  if (prefix_count > SNAPSHOT_MAX_STRING_LEN)
+    return svn_error_trace(snapshot_corrupt(path, scratch_pool));
+
+  prefix_map = apr_palloc(scratch_pool, prefix_count * sizeof(*prefix_map));
+  for (i = 0; i < prefix_count; ++i)
+    {
+      const char *prefix;
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(read_string(&prefix, file, path, iterpool));
+      SVN_ERR(prefix_pool_get(&prefix_map[i], cache->prefix_pool, prefix));
+    }
+
+  svn_membuf__create(&buffer, 0, scratch_pool);
+  while (TRUE)
+    {
+      full_key_t full_key;
+      const full_key_t *key = &full_key;
+      svn_membuffer_t *segment = cache;
+      apr_uint32_t group_index;
+      apr_uint64_t size, key_len;
+      apr_uint32_t prefix, priority;
+
+      svn_pool_clear(iterpool);
+
+      SVN_ERR(read_uint64(&size, file, iterpool));
+      if (size == SNAPSHOT_END_OF_SECTION)
+        break;
+
+      SVN_ERR(read_uint64(&full_key.entry_key.fingerprint[0], file,
+                          iterpool));
+      SVN_ERR(read_uint64(&full_key.entry_key.fingerprint[1], file,
+                          iterpool));
+      SVN_ERR(read_uint64(&key_len, file, iterpool));
+      SVN_ERR(read_uint32(&prefix, file, iterpool));
+      SVN_ERR(read_uint32(&priority, file, iterpool));
+
+      /* Entries either have a shared prefix or a full key. */
+      if (   size > MAX_ITEM_SIZE
+          || key_len > size
+          || (prefix == NO_INDEX) == (key_len == 0)
+          || (prefix != NO_INDEX && prefix >= prefix_count))
+        return svn_error_trace(snapshot_corrupt(path, iterpool));
+
+      svn_membuf__ensure(&buffer, (apr_size_t)size);
+      SVN_ERR(read_data(file, buffer.data, (apr_size_t)size, iterpool));
+
+      /* Skip entries whose prefix we could not add to our pool. */
+      full_key.entry_key.key_len = (apr_size_t)key_len;
+      full_key.entry_key.prefix_idx = prefix == NO_INDEX
+                                    ? NO_INDEX
+                                    : prefix_map[prefix];
+      if (prefix != NO_INDEX && full_key.entry_key.prefix_idx == NO_INDEX)
+        continue;
+
+      /* With a shared prefix, the fingerprint is the key itself.  Full
+       * keys, however, must produce the fingerprint that we use to find
+       * the entry. */
+      if (   prefix == NO_INDEX
+          && !full_key_matches(&full_key.entry_key, buffer.data))
+        continue;
+
+      full_key.full_key = buffer;
+
+      group_index = get_group_index(&segment, &key->entry_key);
+      WITH_WRITE_LOCK(segment,
+                      membuffer_cache_set_internal(segment,
+                                                   key,
+                                                   group_index,
+                                                   (char *)buffer.data
+                                                     + key_len,
+                                                   (apr_size_t)
+                                                     (size - key_len),
+                                                   priority,
+                                                   iterpool));
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return svn_error_trace(svn_io_file_close(file, scratch_pool));
+
+#endif
+}
+
+svn_error_t *
+svn_cache__membuffer_set_stamp(svn_membuffer_t *cache,
+                               const char *root,
+                               const char *stamp,
+                               apr_pool_t *scratch_pool)
+{
+  svn_cache__t *stamps;
+  svn_stringbuf_t *old_stamp;
+  svn_boolean_t found;
+  snapshot_section_t *section;
+
+  SVN_ERR(svn_cache__create_membuffer_cache(&stamps, cache, NULL, NULL,
+                                            APR_HASH_KEY_STRING,
+                                            STAMP_PREFIX,
+                                            SVN_CACHE__MEMBUFFER_HIGH_PRIORITY,
+                                            FALSE, FALSE,
+                                            scratch_pool, scratch_pool));
+
+  /* If ROOT already has that stamp, any snapshot data for it has been
+   * imported before - possibly by another process. */
+  SVN_ERR(svn_cache__get((void **)&old_stamp, &found, stamps, root,
+                         scratch_pool));
+  if (found && strcmp(old_stamp->data, stamp) == 0)
+    return SVN_NO_ERROR;
+
+  SVN_ERR(svn_cache__set(stamps, root,
+                         svn_stringbuf_create(stamp, scratch_pool),
+                         scratch_pool));
+
+  /* Import snapshot data that is still valid. */
+  SVN_ERR(take_section(&section, cache->snapshot, root, scratch_pool));
+  if (section && strcmp(section->stamp, stamp) == 0)
+    SVN_ERR(import_section(cache, section, scratch_pool));
+
+  return SVN_NO_ERROR;
+}
@@ -21,6 +21,8 @@
  * ====================================================================
  */
 
+#include <apr_strings.h>
+
 #include "cache.h"
 
 svn_error_t *
@@ -317,3 +319,70 @@ svn_cache__format_info(const svn_cache__info_t *info,
                             info->total_entries,
                             histogram);
 }
+
+/* Append the non-empty buckets of the latency HISTOGRAM as "label:count"
+ * pairs to TEXT.  See SVN_CACHE__LATENCY_BUCKETS for the bucket layout.
+ */
+static void
+format_latency(svn_stringbuf_t *text,
+               const apr_uint64_t *histogram)
+{
+  int i;
+  for (i = 0; i < SVN_CACHE__LATENCY_BUCKETS; ++i)
+    if (histogram[i])
+      {
+        if (i == SVN_CACHE__LATENCY_BUCKETS - 1)
+          svn_stringbuf_appendcstr(text,
+                                   apr_psprintf(text->pool, " >=%d:",
+                                                1 << (i - 1)));
+        else
+          svn_stringbuf_appendcstr(text,
+                                   apr_psprintf(text->pool, " <%d:",
+                                                1 << i));
+
+        svn_stringbuf_appendcstr(text,
+                                 apr_psprintf(text->pool,
+                                              "%" APR_UINT64_T_FMT,
+                                              histogram[i]));
+      }
+
+  svn_stringbuf_appendbyte(text, '\n');
+}
+
+svn_string_t *
+svn_cache__format_prefix_info(const svn_cache__prefix_info_t *info,
+                              apr_pool_t *result_pool)
+{
+  apr_uint64_t misses = info->gets - info->hits;
+  double hit_rate = (100.0 * (double)info->hits)
+                  / (double)(info->gets ? info->gets : 1);
+  double write_rate = (100.0 * (double)info->sets)
+                    / (double)(misses ? misses : 1);
+
+  svn_stringbuf_t *text
+    = svn_stringbuf_createf(result_pool,
+                            "%s\n"
+                            "gets    : %" APR_UINT64_T_FMT
+                            ", %" APR_UINT64_T_FMT " hits (%5.2f%%)\n"
+                            "sets    : %" APR_UINT64_T_FMT
+                            " (%5.2f%% of misses)"
+                            ", %" APR_UINT64_T_FMT " rejected by size\n"
+                            "evicted : %" APR_UINT64_T_FMT "\n"
+                            "used    : %" APR_UINT64_T_FMT " kB"
+                            " in %" APR_UINT64_T_FMT " entries\n"
+                            "get usec:",
+                            info->prefix,
+                            info->gets,
+                            info->hits, hit_rate,
+                            info->sets, write_rate,
+                            info->rejections,
+                            info->evictions,
+                            info->used_size / 1024,
+                            info->used_entries);
+
+  format_latency(text, info->get_latency);
+  svn_stringbuf_appendcstr(text, "set usec:");
+  format_latency(text, info->set_latency);
+
+  return svn_string_create_from_buf(text, result_pool);
+}
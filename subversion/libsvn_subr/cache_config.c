@@ -29,44 +29,71 @@
 #include "svn_pools.h"
 #include "svn_sorts.h"
 
-/* The cache settings as a process-wide singleton.
+/* Default configuration:
+ *
+ * Please note that the resources listed below will be allocated
+ * PER PROCESS. Thus, the defaults chosen here are kept deliberately
+ * low to still make a difference yet to ensure that pre-fork servers
+ * on machines with small amounts of RAM aren't severely impacted.
+ */
+
+/* 16 MB for caches.
+ * If you are running a single server process, you may easily increase
+ * that to 50+% of your RAM using svn_fs_set_cache_config().
+ */
+#define DEFAULT_CACHE_SIZE 0x1000000
+
+/* Up to 16 files kept open.
+ * Most OS restrict the number of open file handles to about 1000. To
+ * minimize I/O and OS overhead, values of 500+ can be beneficial (use
+ * svn_fs_set_cache_config() to change the configuration).
+ * When running with a huge in-process cache, this number has little
+ * impact on performance and a more modest value (< 100) may be more
+ * suitable.
+ */
+#define DEFAULT_FILE_HANDLE_COUNT 16
+
+/* Assume multi-threaded operation.  Because this simply activates proper
+ * synchronization between threads, it is a safe default.  Without thread
+ * support, single-threaded is the only supported mode of operation.
  */
-static svn_cache_config_t cache_settings =
-  {
-    /* default configuration:
-     *
-     * Please note that the resources listed below will be allocated
-     * PER PROCESS. Thus, the defaults chosen here are kept deliberately
-     * low to still make a difference yet to ensure that pre-fork servers
-     * on machines with small amounts of RAM aren't severely impacted.
-     */
-    0x1000000,   /* 16 MB for caches.
-                  * If you are running a single server process,
-                  * you may easily increase that to 50+% of your RAM
-                  * using svn_fs_set_cache_config().
-                  */
-    16,          /* up to 16 files kept open.
-                  * Most OS restrict the number of open file handles to
-                  * about 1000. To minimize I/O and OS overhead, values
-                  * of 500+ can be beneficial (use svn_fs_set_cache_config()
-                  * to change the configuration).
-                  * When running with a huge in-process cache, this number
-                  * has little impact on performance and a more modest
-                  * value (< 100) may be more suitable.
-                  */
 #if APR_HAS_THREADS
-    FALSE        /* assume multi-threaded operation.
-                  * Because this simply activates proper synchronization
-                  * between threads, it is a safe default.
-                  */
+#  define DEFAULT_SINGLE_THREADED FALSE
 #else
-    TRUE         /* single-threaded is the only supported mode of operation */
+#  define DEFAULT_SINGLE_THREADED TRUE
 #endif
+
+/* The cache settings as a process-wide singleton.
+ */
+static svn_cache_config2_t cache_settings =
+  {
+    DEFAULT_CACHE_SIZE,
+    DEFAULT_FILE_HANDLE_COUNT,
+    DEFAULT_SINGLE_THREADED,
+    FALSE,       /* Sharing the cache only makes sense for pre-fork servers
+                  * and must be requested explicitly. */
+    FALSE        /* Use the classic admission policy by default. */
 };
 
+/* The subset of CACHE_SETTINGS that is returned by svn_cache_config_get().
+ * svn_cache_config_set() and svn_cache_config_set2() keep it in sync.
+ */
+static svn_cache_config_t cache_settings_v1 =
+  {
+    DEFAULT_CACHE_SIZE,
+    DEFAULT_FILE_HANDLE_COUNT,
+    DEFAULT_SINGLE_THREADED
+  };
+
 /* Get the current FSFS cache configuration. */
 const svn_cache_config_t *
 svn_cache_config_get(void)
+{
+  return &cache_settings_v1;
+}
+
+const svn_cache_config2_t *
+svn_cache_config_get2(void)
 {
   return &cache_settings;
 }
@@ -125,8 +152,9 @@ initialize_cache(void *baton, apr_pool_t *unused_pool)
           (apr_size_t)cache_size,
           (apr_size_t)(cache_size / 5),
           0,
-          ! svn_cache_config_get()->single_threaded,
+          ! cache_settings.single_threaded,
           FALSE,
+          cache_settings.shared_memory,
           pool);
 
       /* Some error occurred. Most likely it's an OOM error but we don't
@@ -139,10 +167,15 @@ initialize_cache(void *baton, apr_pool_t *unused_pool)
 
           /* Document that we actually don't have a cache. */
           cache_settings.cache_size = 0;
+          cache_settings_v1.cache_size = 0;
 
           return svn_error_trace(err);
         }
 
+      if (cache_settings.scan_resistant)
+        svn_cache__membuffer_set_admission_policy(
+            cache, svn_cache__admission_frequency);
+
       /* done */
       *cache_p = cache;
     }
@@ -175,7 +208,49 @@ svn_cache__get_global_membuffer_cache(void)
 
 void
 svn_cache_config_set(const svn_cache_config_t *settings)
+{
+  cache_settings_v1 = *settings;
+
+  cache_settings.cache_size = settings->cache_size;
+  cache_settings.file_handle_count = settings->file_handle_count;
+  cache_settings.single_threaded = settings->single_threaded;
+}
+
+void
+svn_cache_config_set2(const svn_cache_config2_t *settings)
 {
   cache_settings = *settings;
+
+  cache_settings_v1.cache_size = settings->cache_size;
+  cache_settings_v1.file_handle_count = settings->file_handle_count;
+  cache_settings_v1.single_threaded = settings->single_threaded;
+
+  /* A shared cache must exist before the worker processes get forked.
+   * Usually, it would be created upon first use, i.e. in the workers. */
+  if (settings->shared_memory)
+    svn_cache__get_global_membuffer_cache();
+}
+
+svn_error_t *
+svn_cache_config_save_snapshot(const char *path,
+                               apr_pool_t *scratch_pool)
+{
+  svn_membuffer_t *cache = svn_cache__get_global_membuffer_cache();
+  if (cache == NULL)
+    return SVN_NO_ERROR;
+
+  return svn_error_trace(svn_cache__membuffer_save(cache, path,
+                                                   scratch_pool));
 }
 
+svn_error_t *
+svn_cache_config_load_snapshot(const char *path,
+                               apr_pool_t *scratch_pool)
+{
+  svn_membuffer_t *cache = svn_cache__get_global_membuffer_cache();
+  if (cache == NULL)
+    return SVN_NO_ERROR;
+
+  return svn_error_trace(svn_cache__membuffer_load(cache, path,
+                                                   scratch_pool));
+}
@@ -35,6 +35,7 @@
 
 #include "checksum.h"
 #include "fnv1a.h"
+#include "sha1.h"
 
 #include "private/svn_subr_private.h"
 
@@ -475,8 +476,6 @@ svn_checksum(svn_checksum_t **checksum,
              apr_size_t len,
              apr_pool_t *pool)
 {
-  apr_sha1_ctx_t sha1_ctx;
-
   SVN_ERR(validate_kind(kind));
   *checksum = svn_checksum_create(kind, pool);
 
@@ -487,9 +486,7 @@ svn_checksum(svn_checksum_t **checksum,
         break;
 
       case svn_checksum_sha1:
-        apr_sha1_init(&sha1_ctx);
-        apr_sha1_update(&sha1_ctx, data, (unsigned int)len);
-        apr_sha1_final((unsigned char *)(*checksum)->digest, &sha1_ctx);
+        svn_sha1__digest((unsigned char *)(*checksum)->digest, data, len);
         break;
 
       case svn_checksum_fnv1a_32:
@@ -550,8 +547,7 @@ svn_checksum_ctx_create(svn_checksum_kind_t kind,
         break;
 
       case svn_checksum_sha1:
-        ctx->apr_ctx = apr_palloc(pool, sizeof(apr_sha1_ctx_t));
-        apr_sha1_init(ctx->apr_ctx);
+        ctx->apr_ctx = svn_sha1__context_create(pool);
         break;
 
       case svn_checksum_fnv1a_32:
@@ -580,8 +576,7 @@ svn_checksum_ctx_reset(svn_checksum_ctx_t *ctx)
         break;
 
       case svn_checksum_sha1:
-        memset(ctx->apr_ctx, 0, sizeof(apr_sha1_ctx_t));
-        apr_sha1_init(ctx->apr_ctx);
+        svn_sha1__context_reset(ctx->apr_ctx);
         break;
 
       case svn_checksum_fnv1a_32:
@@ -611,7 +606,7 @@ svn_checksum_update(svn_checksum_ctx_t *ctx,
         break;
 
       case svn_checksum_sha1:
-        apr_sha1_update(ctx->apr_ctx, data, (unsigned int)len);
+        svn_sha1__update(ctx->apr_ctx, data, len);
         break;
 
       case svn_checksum_fnv1a_32:
@@ -644,7 +639,8 @@ svn_checksum_final(svn_checksum_t **checksum,
         break;
 
       case svn_checksum_sha1:
-        apr_sha1_final((unsigned char *)(*checksum)->digest, ctx->apr_ctx);
+        svn_sha1__finalize((unsigned char *)(*checksum)->digest,
+                           ctx->apr_ctx);
         break;
 
       case svn_checksum_fnv1a_32:
@@ -665,6 +661,122 @@ svn_checksum_final(svn_checksum_t **checksum,
   return SVN_NO_ERROR;
 }
 
+/* Size of the chunks that svn_checksum__md5_sha1_update() feeds into
+ * the individual checksum algorithms.  Small enough for the data to stay
+ * in the L1 cache between the MD5 and the SHA-1 pass.
+ */
+#define FUSED_CHUNK_SIZE 0x2000
+
+struct svn_checksum__md5_sha1_ctx_t
+{
+  apr_md5_ctx_t md5_ctx;
+  svn_sha1__context_t sha1_ctx;
+};
+
+svn_checksum__md5_sha1_ctx_t *
+svn_checksum__md5_sha1_ctx_create(apr_pool_t *pool)
+{
+  svn_checksum__md5_sha1_ctx_t *ctx = apr_palloc(pool, sizeof(*ctx));
+  svn_checksum__md5_sha1_ctx_reset(ctx);
+
+  return ctx;
+}
+
+void
+svn_checksum__md5_sha1_ctx_reset(svn_checksum__md5_sha1_ctx_t *ctx)
+{
+  apr_md5_init(&ctx->md5_ctx);
+  svn_sha1__context_reset(&ctx->sha1_ctx);
+}
+
+void
+svn_checksum__md5_sha1_update(svn_checksum__md5_sha1_ctx_t *ctx,
+                              const void *data,
+                              apr_size_t len)
+{
+  const char *chunk = data;
+
+  /* Interleave the two algorithms such that we read the data from main
+   * memory only once. */
+  while (len)
+    {
+      apr_size_t chunk_size = MIN(len, FUSED_CHUNK_SIZE);
+
+      apr_md5_update(&ctx->md5_ctx, chunk, chunk_size);
+      svn_sha1__update(&ctx->sha1_ctx, chunk, chunk_size);
+
+      chunk += chunk_size;
+      len -= chunk_size;
+    }
+}
+
+void
+svn_checksum__md5_sha1_final(svn_checksum_t **md5_checksum,
+                             svn_checksum_t **sha1_checksum,
+                             svn_checksum__md5_sha1_ctx_t *ctx,
+                             apr_pool_t *pool)
+{
+  *md5_checksum = svn_checksum_create(svn_checksum_md5, pool);
+  apr_md5_final((unsigned char *)(*md5_checksum)->digest, &ctx->md5_ctx);
+
+  *sha1_checksum = svn_checksum_create(svn_checksum_sha1, pool);
+  svn_sha1__finalize((unsigned char *)(*sha1_checksum)->digest,
+                     &ctx->sha1_ctx);
+}
+
+svn_error_t *
+svn_checksum__multi(apr_array_header_t **checksums,
+                    svn_checksum_kind_t kind,
+                    const apr_array_header_t *contents,
+                    apr_pool_t *result_pool,
+                    apr_pool_t *scratch_pool)
+{
+  int i;
+
+  SVN_ERR(validate_kind(kind));
+  *checksums = apr_array_make(result_pool, contents->nelts,
+                              sizeof(svn_checksum_t *));
+
+  if (kind == svn_checksum_md5 && contents->nelts > 1)
+    {
+      /* Hash all texts in one go, using the multi-buffer code. */
+      const void **data = apr_palloc(scratch_pool,
+                                     contents->nelts * sizeof(*data));
+      apr_size_t *lens = apr_palloc(scratch_pool,
+                                    contents->nelts * sizeof(*lens));
+      unsigned char *digests = apr_palloc(scratch_pool,
+                                          contents->nelts
+                                            * APR_MD5_DIGESTSIZE);
+
+      for (i = 0; i < contents->nelts; ++i)
+        {
+          const svn_string_t *text
+            = APR_ARRAY_IDX(contents, i, const svn_string_t *);
+          data[i] = text->data;
+          lens[i] = text->len;
+        }
+
+      svn__md5_multi(digests, data, lens, contents->nelts);
+
+      for (i = 0; i < contents->nelts; ++i)
+        APR_ARRAY_PUSH(*checksums, svn_checksum_t *)
+          = svn_checksum__from_digest_md5(digests + i * APR_MD5_DIGESTSIZE,
+                                          result_pool);
+    }
+  else
+    {
+      for (i = 0; i < contents->nelts; ++i)
+        {
+          const svn_string_t *text
+            = APR_ARRAY_IDX(contents, i, const svn_string_t *);
+          SVN_ERR(svn_checksum(&APR_ARRAY_PUSH(*checksums, svn_checksum_t *),
+                               kind, text->data, text->len, result_pool));
+        }
+    }
+
+  return SVN_NO_ERROR;
+}
+
 apr_size_t
 svn_checksum_size(const svn_checksum_t *checksum)
 {
@@ -854,3 +966,73 @@ svn_checksum__wrap_write_stream_fnv1a_32x4(apr_uint32_t *digest,
 
   return result;
 }
+
+/* Baton used by the md5_sha1_* stream handlers.
+ */
+typedef struct md5_sha1_stream_baton_t
+{
+  /* Stream we are wrapping. Forward write() and close() operations to it. */
+  svn_stream_t *inner_stream;
+
+  /* Build the checksum data in here. */
+  svn_checksum__md5_sha1_ctx_t *context;
+
+  /* Write the final checksums here. */
+  svn_checksum_t **md5_checksum;
+  svn_checksum_t **sha1_checksum;
+
+  /* Allocate the resulting checksums here. */
+  apr_pool_t *pool;
+} md5_sha1_stream_baton_t;
+
+/* Implement svn_write_fn_t.
+ * Update checksums and pass data on to inner stream.
+ */
+static svn_error_t *
+md5_sha1_write_handler(void *baton,
+                       const char *data,
+                       apr_size_t *len)
+{
+  md5_sha1_stream_baton_t *b = baton;
+
+  svn_checksum__md5_sha1_update(b->context, data, *len);
+  SVN_ERR(svn_stream_write(b->inner_stream, data, len));
+
+  return SVN_NO_ERROR;
+}
+
+/* Implement svn_close_fn_t.
+ * Finalize checksum calculation and write results. Close inner stream.
+ */
+static svn_error_t *
+md5_sha1_close_handler(void *baton)
+{
+  md5_sha1_stream_baton_t *b = baton;
+
+  svn_checksum__md5_sha1_final(b->md5_checksum, b->sha1_checksum,
+                               b->context, b->pool);
+
+  return svn_error_trace(svn_stream_close(b->inner_stream));
+}
+
+svn_stream_t *
+svn_checksum__wrap_write_stream_md5_sha1(svn_checksum_t **md5_checksum,
+                                         svn_checksum_t **sha1_checksum,
+                                         svn_stream_t *inner_stream,
+                                         apr_pool_t *pool)
+{
+  svn_stream_t *outer_stream;
+
+  md5_sha1_stream_baton_t *baton = apr_pcalloc(pool, sizeof(*baton));
+  baton->inner_stream = inner_stream;
+  baton->context = svn_checksum__md5_sha1_ctx_create(pool);
+  baton->md5_checksum = md5_checksum;
+  baton->sha1_checksum = sha1_checksum;
+  baton->pool = pool;
+
+  outer_stream = svn_stream_create(baton, pool);
+  svn_stream_set_write(outer_stream, md5_sha1_write_handler);
+  svn_stream_set_close(outer_stream, md5_sha1_close_handler);
+
+  return outer_stream;
+}
@@ -67,6 +67,16 @@ svn__digests_match(const unsigned char d1[],
                    const unsigned char d2[],
                    apr_size_t digest_size);
 
+/* Calculate the MD5 digests of COUNT independent messages DATA[i] of
+ * LENS[i] bytes each and write them to DIGESTS + i * APR_MD5_DIGESTSIZE.
+ * If supported by the CPU, up to 8 messages are hashed in parallel.
+ */
+void
+svn__md5_multi(unsigned char *digests,
+               const void *const *data,
+               const apr_size_t *lens,
+               apr_size_t count);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -29,13 +29,23 @@
 
 #ifdef SVN_INTERNAL_LZ4
 #include "lz4/lz4internal.h"
+#include "lz4/lz4hcinternal.h"
 #else
 #include <lz4.h>
+#include <lz4hc.h>
 #endif
 
-svn_error_t *
-svn__compress_lz4(const void *data, apr_size_t len,
-                  svn_stringbuf_t *out)
+/* LZ4 HC compression level used by svn__compress_lz4_hc().  This is the
+   upstream default, which gets close to the maximum ratio at a fraction
+   of the maximum effort. */
+#define HC_COMPRESSION_LEVEL 9
+
+/* Common implementation of svn__compress_lz4() and svn__compress_lz4_hc().
+   Use the LZ4 HC algorithm if HIGH_COMPRESSION is set. */
+static svn_error_t *
+compress_lz4(const void *data, apr_size_t len,
+             svn_stringbuf_t *out,
+             svn_boolean_t high_compression)
 {
   apr_size_t hdrlen;
   unsigned char buf[SVN__MAX_ENCODED_UINT_LEN];
@@ -51,8 +61,14 @@ svn__compress_lz4(const void *data, apr_size_t len,
   svn_stringbuf_setempty(out);
   svn_stringbuf_ensure(out, max_compressed_data_len + hdrlen);
   svn_stringbuf_appendbytes(out, (const char *)buf, hdrlen);
-  compressed_data_len = LZ4_compress_default(data, out->data + out->len,
-                                             (int)len, max_compressed_data_len);
+  if (high_compression)
+    compressed_data_len = LZ4_compress_HC(data, out->data + out->len,
+                                          (int)len, max_compressed_data_len,
+                                          HC_COMPRESSION_LEVEL);
+  else
+    compressed_data_len = LZ4_compress_default(data, out->data + out->len,
+                                               (int)len,
+                                               max_compressed_data_len);
   if (!compressed_data_len)
     return svn_error_create(SVN_ERR_LZ4_COMPRESSION_FAILED, NULL, NULL);
 
@@ -70,6 +86,20 @@ svn__compress_lz4(const void *data, apr_size_t len,
   return SVN_NO_ERROR;
 }
 
+svn_error_t *
+svn__compress_lz4(const void *data, apr_size_t len,
+                  svn_stringbuf_t *out)
+{
+  return svn_error_trace(compress_lz4(data, len, out, FALSE));
+}
+
+svn_error_t *
+svn__compress_lz4_hc(const void *data, apr_size_t len,
+                     svn_stringbuf_t *out)
+{
+  return svn_error_trace(compress_lz4(data, len, out, TRUE));
+}
+
 svn_error_t *
 svn__decompress_lz4(const void *data, apr_size_t len,
                     svn_stringbuf_t *out,
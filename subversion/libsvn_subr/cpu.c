@@ -0,0 +1,194 @@
+/*
+ * cpu.c :  run-time detection of CPU features
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#include "svn_string.h"
+#include "private/svn_cpu.h"
+
+#if defined(SVN__SIMD_X86) && defined(_MSC_VER)
+#  include <intrin.h>
+#elif defined(SVN__SIMD_X86)
+#  include <cpuid.h>
+#endif
+
+/* Set in DETECTED_FEATURES once detection has been run. */
+#define FEATURES_VALID 0x80000000u
+
+/* Features detected by detect_features() plus FEATURES_VALID, 0 before
+ * the first call to svn_cpu__features().  Detection is idempotent and
+ * the value is a single word, so racing initializations are harmless.
+ */
+static volatile apr_uint32_t detected_features = 0;
+
+/* Mask set by svn_cpu__set_features_mask(). */
+static volatile apr_uint32_t features_mask = ~(apr_uint32_t)0;
+
+#ifdef SVN__SIMD_X86
+
+/* Set REGS to EAX, EBX, ECX and EDX as returned by CPUID for LEAF and
+ * SUBLEAF.  Return FALSE, if LEAF is not supported by this CPU.
+ */
+static svn_boolean_t
+cpuid(unsigned int regs[4], unsigned int leaf, unsigned int subleaf)
+{
+#ifdef _MSC_VER
+  int info[4];
+
+  __cpuid(info, 0);
+  if ((unsigned int)info[0] < leaf)
+    return FALSE;
+
+  __cpuidex(info, (int)leaf, (int)subleaf);
+  regs[0] = info[0];
+  regs[1] = info[1];
+  regs[2] = info[2];
+  regs[3] = info[3];
+
+  return TRUE;
+#else
+  if (__get_cpuid_max(0, NULL) < leaf)
+    return FALSE;
+
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+  return TRUE;
+#endif
+}
+
+/* Return TRUE if the OS saves and restores the YMM registers, i.e. if it
+ * is safe to use AVX instructions.  CPUID leaf 1 must already indicate
+ * OSXSAVE support.
+ */
+static svn_boolean_t
+os_supports_ymm(void)
+{
+#ifdef _MSC_VER
+  return (_xgetbv(0) & 6) == 6;
+#else
+  unsigned int eax, edx;
+
+  /* XGETBV with ECX=0; use the opcode for old assemblers. */
+  __asm__ volatile (".byte 0x0f, 0x01, 0xd0"
+                    : "=a" (eax), "=d" (edx)
+                    : "c" (0));
+  return (eax & 6) == 6;
+#endif
+}
+
+/* Return the SVN_CPU__* features supported by CPU and OS. */
+static apr_uint32_t
+detect_features(void)
+{
+  unsigned int regs[4];
+  apr_uint32_t features = 0;
+
+  if (cpuid(regs, 1, 0))
+    {
+      if (regs[3] & (1u << 26))
+        features |= SVN_CPU__SSE2;
+      if (regs[2] & (1u << 9))
+        features |= SVN_CPU__SSSE3;
+      if (regs[2] & (1u << 19))
+        features |= SVN_CPU__SSE4_1;
+
+      /* OSXSAVE + AVX are prerequisites for AVX2. */
+      if (   (regs[2] & (1u << 27))
+          && (regs[2] & (1u << 28))
+          && os_supports_ymm()
+          && cpuid(regs, 7, 0)
+          && (regs[1] & (1u << 5)))
+        features |= SVN_CPU__AVX2;
+
+      if (cpuid(regs, 7, 0) && (regs[1] & (1u << 29)))
+        features |= SVN_CPU__SHA;
+    }
+
+  return features;
+}
+
+#else
+
+/* Return the SVN_CPU__* features supported by CPU and OS. */
+static apr_uint32_t
+detect_features(void)
+{
+#ifdef SVN__SIMD_NEON
+  return SVN_CPU__NEON;
+#else
+  return 0;
+#endif
+}
+
+#endif
+
+apr_uint32_t
+svn_cpu__features(void)
+{
+  apr_uint32_t features = detected_features;
+  if (features == 0)
+    {
+      features = detect_features() | FEATURES_VALID;
+      detected_features = features;
+    }
+
+  return features & features_mask & ~FEATURES_VALID;
+}
+
+apr_uint32_t
+svn_cpu__set_features_mask(apr_uint32_t mask)
+{
+  apr_uint32_t old_mask = features_mask;
+  features_mask = mask;
+
+  return old_mask;
+}
+
+const char *
+svn_cpu__features_string(apr_uint32_t features,
+                         apr_pool_t *pool)
+{
+  static const struct
+    {
+      apr_uint32_t flag;
+      const char *name;
+    } names[] =
+    {
+      { SVN_CPU__SSE2,   "sse2" },
+      { SVN_CPU__SSSE3,  "ssse3" },
+      { SVN_CPU__SSE4_1, "sse4.1" },
+      { SVN_CPU__AVX2,   "avx2" },
+      { SVN_CPU__SHA,    "sha" },
+      { SVN_CPU__NEON,   "neon" }
+    };
+
+  svn_stringbuf_t *result = svn_stringbuf_create_empty(pool);
+  apr_size_t i;
+
+  for (i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    if (features & names[i].flag)
+      {
+        if (result->len)
+          svn_stringbuf_appendbyte(result, ' ');
+        svn_stringbuf_appendcstr(result, names[i].name);
+      }
+
+  return result->len ? result->data : "none";
+}
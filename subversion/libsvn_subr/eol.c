@@ -29,45 +29,201 @@
 #include "svn_io.h"
 #include "private/svn_eol_private.h"
 #include "private/svn_dep_compat.h"
+#include "private/svn_cpu.h"
 
-char *
-svn_eol__find_eol_start(char *buf, apr_size_t len)
+#if defined(SVN__SIMD_X86)
+#  include <immintrin.h>
+#elif defined(SVN__SIMD_NEON)
+#  include <arm_neon.h>
+#endif
+
+#if defined(SVN__SIMD_X86)
+
+/* Return the index of the lowest bit set in MASK, which must not be 0. */
+static APR_INLINE int
+lowest_bit(unsigned int mask)
 {
-#if SVN_UNALIGNED_ACCESS_IS_OK
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (int)index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+/* SSE2 implementation of svn_eol__find_any() for complete 16 byte blocks.
+ * Return the position of the first match or of the first byte not
+ * covered by a complete block. */
+SVN__TARGET("sse2")
+static const char *
+find_any_sse2(const char *buf, apr_size_t len, char c1, char c2, char c3)
+{
+  const __m128i v1 = _mm_set1_epi8(c1);
+  const __m128i v2 = _mm_set1_epi8(c2);
+  const __m128i v3 = _mm_set1_epi8(c3);
+
+  for (; len >= 16; buf += 16, len -= 16)
+    {
+      __m128i chunk = _mm_loadu_si128((const __m128i *)(const void *)buf);
+      int mask = _mm_movemask_epi8(
+                   _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, v1),
+                                             _mm_cmpeq_epi8(chunk, v2)),
+                                _mm_cmpeq_epi8(chunk, v3)));
+      if (mask)
+        return buf + lowest_bit(mask);
+    }
+
+  return buf;
+}
+
+/* Like find_any_sse2 but with 32 byte blocks using AVX2.  A remaining
+ * 16 byte block will be checked as well. */
+SVN__TARGET("avx2")
+static const char *
+find_any_avx2(const char *buf, apr_size_t len, char c1, char c2, char c3)
+{
+  const __m256i v1 = _mm256_set1_epi8(c1);
+  const __m256i v2 = _mm256_set1_epi8(c2);
+  const __m256i v3 = _mm256_set1_epi8(c3);
+
+  for (; len >= 32; buf += 32, len -= 32)
+    {
+      __m256i chunk = _mm256_loadu_si256((const __m256i *)(const void *)buf);
+      unsigned int mask = (unsigned int)_mm256_movemask_epi8(
+          _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, v1),
+                                          _mm256_cmpeq_epi8(chunk, v2)),
+                          _mm256_cmpeq_epi8(chunk, v3)));
+      if (mask)
+        return buf + lowest_bit(mask);
+    }
 
-  /* Scan the input one machine word at a time. */
-  for (; len > sizeof(apr_uintptr_t)
-       ; buf += sizeof(apr_uintptr_t), len -= sizeof(apr_uintptr_t))
+  if (len >= 16)
     {
-      /* This is a variant of the well-known strlen test: */
-      apr_uintptr_t chunk = *(const apr_uintptr_t *)buf;
-
-      /* A byte in SVN__R_TEST is \0, iff it was \r in *BUF.
-       * Similarly, SVN__N_TEST is an indicator for \n. */
-      apr_uintptr_t r_test = chunk ^ SVN__R_MASK;
-      apr_uintptr_t n_test = chunk ^ SVN__N_MASK;
-
-      /* A byte in SVN__R_TEST can only be < 0x80, iff it has been \0 before
-       * (i.e. \r in *BUF). Ditto for SVN__N_TEST. */
-      r_test |= (r_test & SVN__LOWER_7BITS_SET) + SVN__LOWER_7BITS_SET;
-      n_test |= (n_test & SVN__LOWER_7BITS_SET) + SVN__LOWER_7BITS_SET;
-
-      /* Check whether at least one of the words contains a byte <0x80
-       * (if one is detected, there was a \r or \n in CHUNK). */
-      if ((r_test & n_test & SVN__BIT_7_SET) != SVN__BIT_7_SET)
-        break;
+      __m128i chunk = _mm_loadu_si128((const __m128i *)(const void *)buf);
+      int mask = _mm_movemask_epi8(
+               _mm_or_si128(
+                 _mm_or_si128(
+                   _mm_cmpeq_epi8(chunk, _mm256_castsi256_si128(v1)),
+                   _mm_cmpeq_epi8(chunk, _mm256_castsi256_si128(v2))),
+                 _mm_cmpeq_epi8(chunk, _mm256_castsi256_si128(v3))));
+      if (mask)
+        return buf + lowest_bit(mask);
+
+      buf += 16;
     }
 
+  return buf;
+}
+
+#elif defined(SVN__SIMD_NEON)
+
+/* NEON implementation of svn_eol__find_any() for complete 16 byte blocks.
+ * Return the position of the first match or of the first byte not
+ * covered by a complete block. */
+static const char *
+find_any_neon(const char *buf, apr_size_t len, char c1, char c2, char c3)
+{
+  const uint8x16_t v1 = vdupq_n_u8((unsigned char)c1);
+  const uint8x16_t v2 = vdupq_n_u8((unsigned char)c2);
+  const uint8x16_t v3 = vdupq_n_u8((unsigned char)c3);
+
+  for (; len >= 16; buf += 16, len -= 16)
+    {
+      uint8x16_t chunk = vld1q_u8((const unsigned char *)buf);
+      uint8x16_t matches = vorrq_u8(vorrq_u8(vceqq_u8(chunk, v1),
+                                             vceqq_u8(chunk, v2)),
+                                    vceqq_u8(chunk, v3));
+
+      /* Narrow to 4 bits per byte to get a 64 bit mask. */
+      apr_uint64_t mask
+        = vget_lane_u64(vreinterpret_u64_u8(
+                          vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)),
+                        0);
+      if (mask)
+        return buf + __builtin_ctzll(mask) / 4;
+    }
+
+  return buf;
+}
+
+#endif
+
+const char *
+svn_eol__find_any(const char *buf,
+                  apr_size_t len,
+                  char c1,
+                  char c2,
+                  char c3)
+{
+  const char *end = buf + len;
+
+#if defined(SVN__SIMD_X86)
+  apr_uint32_t features = svn_cpu__features();
+  if (len >= 32 && (features & SVN_CPU__AVX2))
+    buf = find_any_avx2(buf, len, c1, c2, c3);
+  else if (len >= 16 && (features & SVN_CPU__SSE2))
+    buf = find_any_sse2(buf, len, c1, c2, c3);
+#elif defined(SVN__SIMD_NEON)
+  if (svn_cpu__features() & SVN_CPU__NEON)
+    buf = find_any_neon(buf, len, c1, c2, c3);
+#endif
+
+  len = end - buf;
+
+#if SVN_UNALIGNED_ACCESS_IS_OK
+
+  {
+    /* Multiplying a byte value with this replicates it in every byte. */
+    const apr_uintptr_t ones = SVN__LOWER_7BITS_SET / 0x7f;
+    const apr_uintptr_t mask1 = ones * (unsigned char)c1;
+    const apr_uintptr_t mask2 = ones * (unsigned char)c2;
+    const apr_uintptr_t mask3 = ones * (unsigned char)c3;
+
+    /* Scan the input one machine word at a time. */
+    for (; len > sizeof(apr_uintptr_t)
+         ; buf += sizeof(apr_uintptr_t), len -= sizeof(apr_uintptr_t))
+      {
+        /* This is a variant of the well-known strlen test: */
+        apr_uintptr_t chunk = *(const apr_uintptr_t *)buf;
+
+        /* A byte in TEST1 is \0, iff it was C1 in *BUF.
+         * Similarly for TEST2 and TEST3. */
+        apr_uintptr_t test1 = chunk ^ mask1;
+        apr_uintptr_t test2 = chunk ^ mask2;
+        apr_uintptr_t test3 = chunk ^ mask3;
+
+        /* A byte in TEST1 can only be < 0x80, iff it has been \0 before
+         * (i.e. C1 in *BUF).  Ditto for the other tests. */
+        test1 |= (test1 & SVN__LOWER_7BITS_SET) + SVN__LOWER_7BITS_SET;
+        test2 |= (test2 & SVN__LOWER_7BITS_SET) + SVN__LOWER_7BITS_SET;
+        test3 |= (test3 & SVN__LOWER_7BITS_SET) + SVN__LOWER_7BITS_SET;
+
+        /* Check whether at least one of the words contains a byte <0x80
+         * (if one is detected, there was a match in CHUNK). */
+        if ((test1 & test2 & test3 & SVN__BIT_7_SET) != SVN__BIT_7_SET)
+          break;
+      }
+  }
+
 #endif
 
   /* The remaining odd bytes will be examined the naive way: */
   for (; len > 0; ++buf, --len)
     {
-      if (*buf == '\n' || *buf == '\r')
+      if (*buf == c1 || *buf == c2 || *buf == c3)
         return buf;
     }
 
-  return NULL;
+  return end;
+}
+
+char *
+svn_eol__find_eol_start(char *buf, apr_size_t len)
+{
+  char *eol = (char *)svn_eol__find_any(buf, len, '\r', '\n', '\n');
+
+  return eol == buf + len ? NULL : eol;
 }
 
 const char *
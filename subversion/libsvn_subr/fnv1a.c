@@ -27,8 +27,15 @@
 #include <apr.h>
 
 #include "private/svn_subr_private.h"
+#include "private/svn_cpu.h"
 #include "fnv1a.h"
 
+#if defined(SVN__SIMD_X86)
+#  include <immintrin.h>
+#elif defined(SVN__SIMD_NEON)
+#  include <arm_neon.h>
+#endif
+
 /**
  * See http://www.isthe.com/chongo/tech/comp/fnv/ for more info on FNV-1
  */
@@ -151,6 +158,258 @@ svn__fnv1a_32x4_raw(apr_uint32_t hashes[4],
                        len - processed);
 }
 
+/* Each of the four interleaved hashes forms a strict chain of dependent
+ * XOR and multiply operations.  For a single message, the four scalar
+ * chains already keep the integer multipliers busy, while a vector
+ * multiply has a much longer latency.  SIMD therefore only pays off when
+ * hashing several independent messages at once:  Then, every group of
+ * (up to) 8 messages gets hashed in lock-step up to the length of the
+ * shortest one, 16 bytes - i.e. one step of each lane - at a time.  The
+ * rest of each message is being processed by the scalar code.
+ */
+
+/* Maximum number of messages per group processed by any kernel. */
+enum { MAX_GROUP_SIZE = 8 };
+
+/* Signature of a kernel that updates the SCALING interleaved HASHES for
+ * each of a fixed number of messages in DATA over their first LEN bytes.
+ * LEN must be a multiple of 16.
+ */
+typedef void (*group_kernel_t)(apr_uint32_t hashes[][SCALING],
+                               const unsigned char *const *data,
+                               apr_size_t len);
+
+#if defined(SVN__SIMD_X86)
+
+/* Step the 4 hashes in H for bytes 4*R .. 4*R+3 of the 16 bytes in X. */
+#define SSE41_STEP(h, x, r)                                         \
+  h = _mm_mullo_epi32(                                              \
+        _mm_xor_si128(h, _mm_cvtepu8_epi32(_mm_srli_si128(x, 4 * r))), \
+        prime)
+
+/* Step the 4 hashes in H for the 16 bytes at DATA. */
+#define SSE41_UPDATE(h, data)                                       \
+  do {                                                              \
+    __m128i x_ = _mm_loadu_si128((const __m128i *)(const void *)(data)); \
+    SSE41_STEP(h, x_, 0);                                           \
+    SSE41_STEP(h, x_, 1);                                           \
+    SSE41_STEP(h, x_, 2);                                           \
+    SSE41_STEP(h, x_, 3);                                           \
+  } while (0)
+
+/* SSE4.1 group kernel for 4 messages. */
+SVN__TARGET("sse4.1")
+static void
+group_sse41(apr_uint32_t hashes[][SCALING],
+            const unsigned char *const *data,
+            apr_size_t len)
+{
+  const __m128i prime = _mm_set1_epi32(FNV1_PRIME_32);
+  __m128i h0 = _mm_loadu_si128((const __m128i *)(void *)hashes[0]);
+  __m128i h1 = _mm_loadu_si128((const __m128i *)(void *)hashes[1]);
+  __m128i h2 = _mm_loadu_si128((const __m128i *)(void *)hashes[2]);
+  __m128i h3 = _mm_loadu_si128((const __m128i *)(void *)hashes[3]);
+  apr_size_t i;
+
+  for (i = 0; i < len; i += 16)
+    {
+      SSE41_UPDATE(h0, data[0] + i);
+      SSE41_UPDATE(h1, data[1] + i);
+      SSE41_UPDATE(h2, data[2] + i);
+      SSE41_UPDATE(h3, data[3] + i);
+    }
+
+  _mm_storeu_si128((__m128i *)(void *)hashes[0], h0);
+  _mm_storeu_si128((__m128i *)(void *)hashes[1], h1);
+  _mm_storeu_si128((__m128i *)(void *)hashes[2], h2);
+  _mm_storeu_si128((__m128i *)(void *)hashes[3], h3);
+}
+
+/* Load the hashes of messages K and K+4 into a single register. */
+#define AVX2_LOAD(k) \
+  _mm256_inserti128_si256(                                               \
+    _mm256_castsi128_si256(                                              \
+      _mm_loadu_si128((const __m128i *)(void *)hashes[k])),              \
+    _mm_loadu_si128((const __m128i *)(void *)hashes[k + 4]), 1)
+
+/* Store H back to the hashes of messages K and K+4. */
+#define AVX2_STORE(k, h)                                                 \
+  do {                                                                   \
+    _mm_storeu_si128((__m128i *)(void *)hashes[k],                       \
+                     _mm256_castsi256_si128(h));                         \
+    _mm_storeu_si128((__m128i *)(void *)hashes[k + 4],                   \
+                     _mm256_extracti128_si256(h, 1));                    \
+  } while (0)
+
+/* Step the 8 hashes in H for the 16 bytes at offset I in messages K and
+ * K+4.  The byte shuffles zero-extend 4 bytes per 128 bit lane. */
+#define AVX2_UPDATE(h, k, i)                                             \
+  do {                                                                   \
+    __m256i x_ = _mm256_inserti128_si256(                                \
+      _mm256_castsi128_si256(                                            \
+        _mm_loadu_si128((const __m128i *)(const void *)(data[k] + i))),  \
+      _mm_loadu_si128((const __m128i *)(const void *)(data[k + 4] + i)), \
+      1);                                                                \
+    h = _mm256_mullo_epi32(_mm256_xor_si256(h,                           \
+          _mm256_shuffle_epi8(x_, spread0)), prime);                     \
+    h = _mm256_mullo_epi32(_mm256_xor_si256(h,                           \
+          _mm256_shuffle_epi8(x_, spread1)), prime);                     \
+    h = _mm256_mullo_epi32(_mm256_xor_si256(h,                           \
+          _mm256_shuffle_epi8(x_, spread2)), prime);                     \
+    h = _mm256_mullo_epi32(_mm256_xor_si256(h,                           \
+          _mm256_shuffle_epi8(x_, spread3)), prime);                     \
+  } while (0)
+
+/* Return the shuffle mask that zero-extends bytes 4*R .. 4*R+3 of each
+ * 128 bit lane to 32 bits. */
+#define AVX2_SPREAD(r) \
+  _mm256_setr_epi8(4*r,   -1, -1, -1, 4*r+1, -1, -1, -1,                 \
+                   4*r+2, -1, -1, -1, 4*r+3, -1, -1, -1,                 \
+                   4*r,   -1, -1, -1, 4*r+1, -1, -1, -1,                 \
+                   4*r+2, -1, -1, -1, 4*r+3, -1, -1, -1)
+
+/* AVX2 group kernel for 8 messages. */
+SVN__TARGET("avx2")
+static void
+group_avx2(apr_uint32_t hashes[][SCALING],
+           const unsigned char *const *data,
+           apr_size_t len)
+{
+  const __m256i prime = _mm256_set1_epi32(FNV1_PRIME_32);
+  const __m256i spread0 = AVX2_SPREAD(0);
+  const __m256i spread1 = AVX2_SPREAD(1);
+  const __m256i spread2 = AVX2_SPREAD(2);
+  const __m256i spread3 = AVX2_SPREAD(3);
+  __m256i h0 = AVX2_LOAD(0);
+  __m256i h1 = AVX2_LOAD(1);
+  __m256i h2 = AVX2_LOAD(2);
+  __m256i h3 = AVX2_LOAD(3);
+  apr_size_t i;
+
+  for (i = 0; i < len; i += 16)
+    {
+      AVX2_UPDATE(h0, 0, i);
+      AVX2_UPDATE(h1, 1, i);
+      AVX2_UPDATE(h2, 2, i);
+      AVX2_UPDATE(h3, 3, i);
+    }
+
+  AVX2_STORE(0, h0);
+  AVX2_STORE(1, h1);
+  AVX2_STORE(2, h2);
+  AVX2_STORE(3, h3);
+}
+
+#elif defined(SVN__SIMD_NEON)
+
+/* Step the 4 hashes in H for the 16 bytes at DATA. */
+#define NEON_UPDATE(h, data)                                   \
+  do {                                                         \
+    uint8x16_t x_ = vld1q_u8(data);                            \
+    uint16x8_t lo_ = vmovl_u8(vget_low_u8(x_));                \
+    uint16x8_t hi_ = vmovl_u8(vget_high_u8(x_));               \
+    h = vmulq_u32(veorq_u32(h, vmovl_u16(vget_low_u16(lo_))), prime);  \
+    h = vmulq_u32(veorq_u32(h, vmovl_u16(vget_high_u16(lo_))), prime); \
+    h = vmulq_u32(veorq_u32(h, vmovl_u16(vget_low_u16(hi_))), prime);  \
+    h = vmulq_u32(veorq_u32(h, vmovl_u16(vget_high_u16(hi_))), prime); \
+  } while (0)
+
+/* NEON group kernel for 4 messages. */
+static void
+group_neon(apr_uint32_t hashes[][SCALING],
+           const unsigned char *const *data,
+           apr_size_t len)
+{
+  const uint32x4_t prime = vdupq_n_u32(FNV1_PRIME_32);
+  uint32x4_t h0 = vld1q_u32(hashes[0]);
+  uint32x4_t h1 = vld1q_u32(hashes[1]);
+  uint32x4_t h2 = vld1q_u32(hashes[2]);
+  uint32x4_t h3 = vld1q_u32(hashes[3]);
+  apr_size_t i;
+
+  for (i = 0; i < len; i += 16)
+    {
+      NEON_UPDATE(h0, data[0] + i);
+      NEON_UPDATE(h1, data[1] + i);
+      NEON_UPDATE(h2, data[2] + i);
+      NEON_UPDATE(h3, data[3] + i);
+    }
+
+  vst1q_u32(hashes[0], h0);
+  vst1q_u32(hashes[1], h1);
+  vst1q_u32(hashes[2], h2);
+  vst1q_u32(hashes[3], h3);
+}
+
+#endif
+
+/* Set DIGESTS[0 .. GROUP_SIZE-1] to the modified FNV-1a checksums of the
+ * messages DATA[i] of LENS[i] bytes each, using KERNEL for the common
+ * part of all messages.
+ */
+static void
+fnv1a_32x4_group(apr_uint32_t *digests,
+                 const void *const *data,
+                 const apr_size_t *lens,
+                 apr_size_t group_size,
+                 group_kernel_t kernel)
+{
+  apr_uint32_t hashes[MAX_GROUP_SIZE][SCALING];
+  const unsigned char *starts[MAX_GROUP_SIZE];
+  apr_size_t common = lens[0];
+  apr_size_t i, k;
+
+  for (i = 0; i < group_size; ++i)
+    {
+      for (k = 0; k < SCALING; ++k)
+        hashes[i][k] = FNV1_BASE_32;
+
+      starts[i] = data[i];
+      common = lens[i] < common ? lens[i] : common;
+    }
+
+  common &= ~(apr_size_t)15;
+  if (common)
+    kernel(hashes, starts, common);
+
+  for (i = 0; i < group_size; ++i)
+    {
+      apr_size_t processed = common
+                           + fnv1a_32x4(hashes[i], starts[i] + common,
+                                        lens[i] - common);
+      digests[i] = finalize_fnv1a_32x4(hashes[i], starts[i] + processed,
+                                       lens[i] - processed);
+    }
+}
+
+void
+svn__fnv1a_32x4_multi(apr_uint32_t *digests,
+                      const void *const *data,
+                      const apr_size_t *lens,
+                      apr_size_t count)
+{
+  apr_size_t i = 0;
+
+#if defined(SVN__SIMD_X86)
+  apr_uint32_t features = svn_cpu__features();
+
+  if (features & SVN_CPU__AVX2)
+    for (; i + 8 <= count; i += 8)
+      fnv1a_32x4_group(digests + i, data + i, lens + i, 8, group_avx2);
+
+  if (features & SVN_CPU__SSE4_1)
+    for (; i + 4 <= count; i += 4)
+      fnv1a_32x4_group(digests + i, data + i, lens + i, 4, group_sse41);
+#elif defined(SVN__SIMD_NEON)
+  if (svn_cpu__features() & SVN_CPU__NEON)
+    for (; i + 4 <= count; i += 4)
+      fnv1a_32x4_group(digests + i, data + i, lens + i, 4, group_neon);
+#endif
+
+  for (; i < count; ++i)
+    digests[i] = svn__fnv1a_32x4(data[i], lens[i]);
+}
+
 struct svn_fnv1a_32__context_t
 {
   apr_uint32_t hash;
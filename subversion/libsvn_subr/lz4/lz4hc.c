@@ -0,0 +1,411 @@
+#include "svn_private_config.h"
+#ifdef SVN_INTERNAL_LZ4
+/*
+ * lz4hc.c:  High compression mode for the internal LZ4 copy
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+/* Like the upstream LZ4 HC implementation, this uses hash chains to find
+ * the longest match within the 64kB LZ4 window instead of the single-probe
+ * hash table of the fast mode.  Additionally, matches get deferred by one
+ * byte if that yields a longer match ("lazy matching").  Only complete
+ * blocks are supported, i.e. there is no streaming or dictionary mode.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <apr.h>
+
+#include "lz4hcinternal.h"
+
+/* This file is self-contained instead of including lz4.c for its common
+ * definitions because most of those would be unused here.  The following
+ * constants are defined by the LZ4 block format. */
+#define MINMATCH 4
+#define LASTLITERALS 5
+#define MFLIMIT 12
+#define LZ4HC_MIN_LENGTH (MFLIMIT + 1)
+#define MAX_DISTANCE 65535
+
+#define ML_BITS 4
+#define ML_MASK ((1U << ML_BITS) - 1)
+#define RUN_MASK ((1U << (8 - ML_BITS)) - 1)
+
+typedef unsigned char BYTE;
+typedef apr_uint16_t U16;
+typedef apr_uint32_t U32;
+
+/* Number of hash table bits.  Positions of 4-byte sequences with the same
+ * hash get linked through CHAIN_TABLE. */
+#define LZ4HC_HASH_LOG 15
+#define LZ4HC_HASHTABLESIZE (1 << LZ4HC_HASH_LOG)
+
+/* Size of the chain table.  Must cover the maximum match distance. */
+#define LZ4HC_MAXD (1 << 16)
+#define LZ4HC_MAXD_MASK (LZ4HC_MAXD - 1)
+
+/* Offset added to all positions in the tables such that unused hash table
+ * entries (0) are always out of reach. */
+#define LZ4HC_INDEX_BASE (1 << 16)
+
+/* Match finder state. */
+typedef struct LZ4HC_state_t
+{
+  /* Most recent position for each hash value, as an index. */
+  U32 hash_table[LZ4HC_HASHTABLESIZE];
+
+  /* Distance from each index (modulo LZ4HC_MAXD) to the previous index
+   * with the same hash.  MAX_DISTANCE terminates the chain. */
+  U16 chain_table[LZ4HC_MAXD];
+
+  /* Start of the input.  Index I refers to START + I - LZ4HC_INDEX_BASE. */
+  const BYTE *start;
+
+  /* First index not yet inserted into the tables. */
+  U32 next_to_update;
+} LZ4HC_state_t;
+
+static U32
+LZ4HC_read32(const void *ptr)
+{
+  U32 value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+static void
+LZ4HC_write_le16(BYTE *ptr,
+                 U16 value)
+{
+  ptr[0] = (BYTE)value;
+  ptr[1] = (BYTE)(value >> 8);
+}
+
+/* Return the number of bytes that are equal at IP and MATCH, not counting
+ * anything at or beyond LIMIT. */
+static size_t
+LZ4HC_count(const BYTE *ip,
+            const BYTE *match,
+            const BYTE *limit)
+{
+  const BYTE * const start = ip;
+
+  while (limit - ip >= (ptrdiff_t)sizeof(U32)
+         && LZ4HC_read32(ip) == LZ4HC_read32(match))
+    {
+      ip += sizeof(U32);
+      match += sizeof(U32);
+    }
+
+  while (ip < limit && *ip == *match)
+    {
+      ip++;
+      match++;
+    }
+
+  return (size_t)(ip - start);
+}
+
+static U32
+LZ4HC_hash_ptr(const void *ptr)
+{
+  return (LZ4HC_read32(ptr) * 2654435761U)
+      >> ((MINMATCH * 8) - LZ4HC_HASH_LOG);
+}
+
+static void
+LZ4HC_init(LZ4HC_state_t *state,
+           const BYTE *start)
+{
+  memset(state->hash_table, 0, sizeof(state->hash_table));
+  memset(state->chain_table, 0xFF, sizeof(state->chain_table));
+  state->start = start;
+  state->next_to_update = LZ4HC_INDEX_BASE;
+}
+
+/* Insert all positions up to but not including IP into the hash chains. */
+static void
+LZ4HC_insert(LZ4HC_state_t *state,
+             const BYTE *ip)
+{
+  const BYTE * const start = state->start;
+  U32 const target = (U32)(ip - start) + LZ4HC_INDEX_BASE;
+  U32 idx = state->next_to_update;
+
+  while (idx < target)
+    {
+      U32 const h = LZ4HC_hash_ptr(start + (idx - LZ4HC_INDEX_BASE));
+      size_t delta = idx - state->hash_table[h];
+      if (delta > MAX_DISTANCE)
+        delta = MAX_DISTANCE;
+
+      state->chain_table[idx & LZ4HC_MAXD_MASK] = (U16)delta;
+      state->hash_table[h] = idx;
+      idx++;
+    }
+
+  state->next_to_update = target;
+}
+
+/* Return the length of the longest match for IP that ends before
+ * MATCH_LIMIT, checking at most MAX_ATTEMPTS candidates.  If that is at
+ * least MINMATCH, set *MATCH_POS to the start of the match. */
+static int
+LZ4HC_find_longest_match(LZ4HC_state_t *state,
+                         const BYTE *ip,
+                         const BYTE *match_limit,
+                         const BYTE **match_pos,
+                         int max_attempts)
+{
+  const BYTE * const start = state->start;
+  U32 const current = (U32)(ip - start) + LZ4HC_INDEX_BASE;
+  U32 const low_limit = (current > LZ4HC_INDEX_BASE + MAX_DISTANCE)
+                      ? current - MAX_DISTANCE
+                      : LZ4HC_INDEX_BASE;
+  U32 match_index;
+  int attempts = max_attempts;
+  size_t best = MINMATCH - 1;
+
+  LZ4HC_insert(state, ip);
+  match_index = state->hash_table[LZ4HC_hash_ptr(ip)];
+
+  while (match_index >= low_limit && attempts-- > 0)
+    {
+      const BYTE * const match = start + (match_index - LZ4HC_INDEX_BASE);
+
+      /* Cheap pre-check: a longer match must also differ from the current
+       * best one at the latter's end. */
+      if (match[best] == ip[best]
+          && LZ4HC_read32(match) == LZ4HC_read32(ip))
+        {
+          size_t const length = MINMATCH + LZ4HC_count(ip + MINMATCH,
+                                                       match + MINMATCH,
+                                                       match_limit);
+          if (length > best)
+            {
+              best = length;
+              *match_pos = match;
+            }
+        }
+
+      match_index -= state->chain_table[match_index & LZ4HC_MAXD_MASK];
+    }
+
+  return (int)best;
+}
+
+/* Write the literals from *ANCHOR up to *IP followed by a match of LENGTH
+ * bytes at MATCH to *OP.  Advance *IP and *ANCHOR past the match and *OP
+ * past the output.  Return non-zero if that would exceed OEND. */
+static int
+LZ4HC_encode_sequence(const BYTE **ip,
+                      BYTE **op,
+                      const BYTE **anchor,
+                      int match_length,
+                      const BYTE *match,
+                      BYTE *oend)
+{
+  size_t length = (size_t)(*ip - *anchor);
+  BYTE *token = (*op)++;
+
+  if (*op + length + (2 + 1 + LASTLITERALS) + (length >> 8) > oend)
+    return 1;
+
+  /* Literal length and literals. */
+  if (length >= RUN_MASK)
+    {
+      size_t len = length - RUN_MASK;
+      *token = (BYTE)(RUN_MASK << ML_BITS);
+      for (; len >= 255; len -= 255)
+        *(*op)++ = 255;
+      *(*op)++ = (BYTE)len;
+    }
+  else
+    {
+      *token = (BYTE)(length << ML_BITS);
+    }
+
+  memcpy(*op, *anchor, length);
+  *op += length;
+
+  /* Match offset and length. */
+  LZ4HC_write_le16(*op, (U16)(*ip - match));
+  *op += 2;
+
+  length = (size_t)(match_length - MINMATCH);
+  if (*op + (length >> 8) + (1 + LASTLITERALS) > oend)
+    return 1;
+
+  if (length >= ML_MASK)
+    {
+      *token += ML_MASK;
+      length -= ML_MASK;
+      for (; length >= 510; length -= 510)
+        {
+          *(*op)++ = 255;
+          *(*op)++ = 255;
+        }
+      if (length >= 255)
+        {
+          length -= 255;
+          *(*op)++ = 255;
+        }
+      *(*op)++ = (BYTE)length;
+    }
+  else
+    {
+      *token += (BYTE)length;
+    }
+
+  *ip += match_length;
+  *anchor = *ip;
+
+  return 0;
+}
+
+/* Compress SRC_SIZE bytes from SRC into DST of DST_CAPACITY bytes using
+ * STATE and up to MAX_ATTEMPTS match candidates per position.  Return the
+ * compressed size or 0 if DST is too small. */
+static int
+LZ4HC_compress_generic(LZ4HC_state_t *state,
+                       const char *src,
+                       char *dst,
+                       int src_size,
+                       int dst_capacity,
+                       int max_attempts)
+{
+  const BYTE *ip = (const BYTE *)src;
+  const BYTE *anchor = ip;
+  const BYTE * const iend = ip + src_size;
+  BYTE *op = (BYTE *)dst;
+  BYTE * const oend = op + dst_capacity;
+  size_t last_run;
+
+  LZ4HC_init(state, ip);
+
+  /* Inputs shorter than this can only be stored as literals. */
+  if (src_size >= LZ4HC_MIN_LENGTH)
+    {
+      const BYTE * const mflimit = iend - MFLIMIT;
+      const BYTE * const match_limit = iend - LASTLITERALS;
+
+      ip++;
+      while (ip < mflimit)
+        {
+          const BYTE *match = NULL;
+          int match_length = LZ4HC_find_longest_match(state, ip,
+                                                      match_limit, &match,
+                                                      max_attempts);
+          if (match_length < MINMATCH)
+            {
+              ip++;
+              continue;
+            }
+
+          /* Defer the match while the next position yields a longer one.
+           * That costs us a single literal. */
+          while (ip + 1 < mflimit)
+            {
+              const BYTE *next_match = NULL;
+              int next_length = LZ4HC_find_longest_match(state, ip + 1,
+                                                         match_limit,
+                                                         &next_match,
+                                                         max_attempts);
+              if (next_length <= match_length)
+                break;
+
+              ip++;
+              match = next_match;
+              match_length = next_length;
+            }
+
+          if (LZ4HC_encode_sequence(&ip, &op, &anchor, match_length, match,
+                                    oend))
+            return 0;
+        }
+    }
+
+  /* Encode the remaining literals. */
+  last_run = (size_t)(iend - anchor);
+  if (op + last_run + 1 + ((last_run + 255 - RUN_MASK) / 255) > oend)
+    return 0;
+
+  if (last_run >= RUN_MASK)
+    {
+      size_t len = last_run - RUN_MASK;
+      *op++ = (BYTE)(RUN_MASK << ML_BITS);
+      for (; len >= 255; len -= 255)
+        *op++ = 255;
+      *op++ = (BYTE)len;
+    }
+  else
+    {
+      *op++ = (BYTE)(last_run << ML_BITS);
+    }
+
+  memcpy(op, anchor, last_run);
+  op += last_run;
+
+  return (int)(((char *)op) - dst);
+}
+
+int
+LZ4_compress_HC(const char *src,
+                char *dst,
+                int src_size,
+                int dst_capacity,
+                int compression_level)
+{
+  LZ4HC_state_t *state;
+  int result;
+
+  if ((unsigned)src_size > (unsigned)LZ4_MAX_INPUT_SIZE)
+    return 0;
+
+  if (compression_level <= 0)
+    compression_level = LZ4HC_CLEVEL_DEFAULT;
+  else if (compression_level < LZ4HC_CLEVEL_MIN)
+    compression_level = LZ4HC_CLEVEL_MIN;
+  else if (compression_level > LZ4HC_CLEVEL_MAX)
+    compression_level = LZ4HC_CLEVEL_MAX;
+
+  /* The state is too large for the stack. */
+  state = malloc(sizeof(*state));
+  if (state == NULL)
+    return 0;
+
+  result = LZ4HC_compress_generic(state, src, dst, src_size, dst_capacity,
+                                  1 << (compression_level - 1));
+  free(state);
+
+  return result;
+}
+
+#else /* !SVN_INTERNAL_LZ4 */
+
+/* Silence OSX ranlib warnings about object files with no symbols. */
+#include <apr.h>
+extern const apr_uint32_t svn__fake__lz4hcinternal;
+const apr_uint32_t svn__fake__lz4hcinternal = 0xdeadbeef;
+
+#endif /* SVN_INTERNAL_LZ4 */
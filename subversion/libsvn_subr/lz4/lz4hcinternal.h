@@ -0,0 +1,61 @@
+#include "svn_private_config.h"
+#ifdef SVN_INTERNAL_LZ4
+/*
+ * lz4hcinternal.h:  High compression mode for the internal LZ4 copy
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+/* This provides the subset of the upstream <lz4hc.h> API that Subversion
+ * uses.  The output is a standard LZ4 block that can be decompressed with
+ * LZ4_decompress_safe(), i.e. there is no change to the data format.
+ */
+
+#ifndef LZ4HC_INTERNAL_H
+#define LZ4HC_INTERNAL_H
+
+#include "lz4internal.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Supported compression levels.  Higher levels search more match
+ * candidates, trading compression speed for a better ratio.  Values
+ * outside this range get mapped to the nearest supported level or
+ * to LZ4HC_CLEVEL_DEFAULT if they are <= 0. */
+#define LZ4HC_CLEVEL_MIN         3
+#define LZ4HC_CLEVEL_DEFAULT     9
+#define LZ4HC_CLEVEL_MAX        16
+
+/* Compress SRC_SIZE bytes from SRC into DST, which has room for
+ * DST_CAPACITY bytes, using the LZ4 HC algorithm at COMPRESSION_LEVEL.
+ * Return the number of bytes written to DST or 0 if compression failed,
+ * e.g. because DST_CAPACITY was insufficient.  Compression will always
+ * succeed if DST_CAPACITY >= LZ4_compressBound(SRC_SIZE). */
+int LZ4_compress_HC(const char *src, char *dst, int src_size,
+                    int dst_capacity, int compression_level);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* LZ4HC_INTERNAL_H */
+#endif /* SVN_INTERNAL_LZ4 */
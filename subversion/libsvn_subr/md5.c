@@ -22,12 +22,357 @@
  */
 
 
+#include <string.h>
+
 #include <apr_md5.h>
 
 #include "svn_checksum.h"
 #include "svn_md5.h"
 #include "checksum.h"
 
+#include "private/svn_cpu.h"
+
+#if defined(SVN__SIMD_X86)
+#  include <immintrin.h>
+#endif
+
+#ifdef SVN__SIMD_X86
+
+/* Multi-buffer MD5.
+ *
+ * MD5 is strictly sequential within a single message, so SIMD can't
+ * speed up hashing one stream.  We can, however, hash 8 independent
+ * messages at once by running one of them in each 32 bit lane of an
+ * AVX2 register.  Every lane processes one 64 byte block per step.  When
+ * a message is finished, its lane gets refilled with the next message.
+ */
+
+/* Number of parallel lanes. */
+#define LANES 8
+
+/* MD5 round functions, see RFC 1321. */
+#define MD5_F(x, y, z) \
+  _mm256_xor_si256(z, _mm256_and_si256(x, _mm256_xor_si256(y, z)))
+#define MD5_G(x, y, z) \
+  _mm256_xor_si256(y, _mm256_and_si256(z, _mm256_xor_si256(x, y)))
+#define MD5_H(x, y, z) \
+  _mm256_xor_si256(x, _mm256_xor_si256(y, z))
+#define MD5_I(x, y, z) \
+  _mm256_xor_si256(y, _mm256_or_si256(x, _mm256_xor_si256(z, all_ones)))
+
+/* One MD5 step with round function F on all lanes, using message word K,
+ * rotation S and additive constant T. */
+#define MD5_STEP(f, a, b, c, d, k, s, t)                                  \
+  do                                                                      \
+    {                                                                     \
+      a = _mm256_add_epi32(a, _mm256_add_epi32(f(b, c, d),                \
+                   _mm256_add_epi32(w[k], _mm256_set1_epi32((int)(t))))); \
+      a = _mm256_add_epi32(b, _mm256_or_si256(_mm256_slli_epi32(a, s),    \
+                                              _mm256_srli_epi32(a, 32 - s)));\
+    }                                                                     \
+  while (0)
+
+/* Transpose the 8x8 matrix of 32 bit words in ROWS. */
+SVN__TARGET("avx2")
+static APR_INLINE void
+transpose8x8(__m256i rows[8])
+{
+  __m256i t0 = _mm256_unpacklo_epi32(rows[0], rows[1]);
+  __m256i t1 = _mm256_unpackhi_epi32(rows[0], rows[1]);
+  __m256i t2 = _mm256_unpacklo_epi32(rows[2], rows[3]);
+  __m256i t3 = _mm256_unpackhi_epi32(rows[2], rows[3]);
+  __m256i t4 = _mm256_unpacklo_epi32(rows[4], rows[5]);
+  __m256i t5 = _mm256_unpackhi_epi32(rows[4], rows[5]);
+  __m256i t6 = _mm256_unpacklo_epi32(rows[6], rows[7]);
+  __m256i t7 = _mm256_unpackhi_epi32(rows[6], rows[7]);
+
+  __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+  __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+  __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+  __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+  __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+  __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+  __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+  __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+  rows[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  rows[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  rows[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  rows[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  rows[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  rows[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  rows[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  rows[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+/* Update the MD5 states of all LANES, given as one row per state word in
+ * STATE, with the 64 byte blocks at BLOCKS[0 .. LANES-1].
+ */
+SVN__TARGET("avx2")
+static void
+md5_x8_avx2(apr_uint32_t state[4][LANES],
+            const unsigned char *blocks[LANES])
+{
+  const __m256i all_ones = _mm256_set1_epi32(-1);
+  __m256i w[16];
+  __m256i a = _mm256_loadu_si256((const __m256i *)state[0]);
+  __m256i b = _mm256_loadu_si256((const __m256i *)state[1]);
+  __m256i c = _mm256_loadu_si256((const __m256i *)state[2]);
+  __m256i d = _mm256_loadu_si256((const __m256i *)state[3]);
+  __m256i a0 = a, b0 = b, c0 = c, d0 = d;
+  int i;
+
+  /* MD5 uses little-endian words, just like x86.  Load each lane's block
+   * as two rows of 8 words and transpose them into per-word vectors. */
+  for (i = 0; i < LANES; ++i)
+    {
+      w[i] = _mm256_loadu_si256((const __m256i *)blocks[i]);
+      w[i + 8] = _mm256_loadu_si256((const __m256i *)(blocks[i] + 32));
+    }
+
+  transpose8x8(w);
+  transpose8x8(w + 8);
+
+      MD5_STEP(MD5_F, a, b, c, d,  0,  7, 0xd76aa478);
+      MD5_STEP(MD5_F, d, a, b, c,  1, 12, 0xe8c7b756);
+      MD5_STEP(MD5_F, c, d, a, b,  2, 17, 0x242070db);
+      MD5_STEP(MD5_F, b, c, d, a,  3, 22, 0xc1bdceee);
+      MD5_STEP(MD5_F, a, b, c, d,  4,  7, 0xf57c0faf);
+      MD5_STEP(MD5_F, d, a, b, c,  5, 12, 0x4787c62a);
+      MD5_STEP(MD5_F, c, d, a, b,  6, 17, 0xa8304613);
+      MD5_STEP(MD5_F, b, c, d, a,  7, 22, 0xfd469501);
+      MD5_STEP(MD5_F, a, b, c, d,  8,  7, 0x698098d8);
+      MD5_STEP(MD5_F, d, a, b, c,  9, 12, 0x8b44f7af);
+      MD5_STEP(MD5_F, c, d, a, b, 10, 17, 0xffff5bb1);
+      MD5_STEP(MD5_F, b, c, d, a, 11, 22, 0x895cd7be);
+      MD5_STEP(MD5_F, a, b, c, d, 12,  7, 0x6b901122);
+      MD5_STEP(MD5_F, d, a, b, c, 13, 12, 0xfd987193);
+      MD5_STEP(MD5_F, c, d, a, b, 14, 17, 0xa679438e);
+      MD5_STEP(MD5_F, b, c, d, a, 15, 22, 0x49b40821);
+
+      MD5_STEP(MD5_G, a, b, c, d,  1,  5, 0xf61e2562);
+      MD5_STEP(MD5_G, d, a, b, c,  6,  9, 0xc040b340);
+      MD5_STEP(MD5_G, c, d, a, b, 11, 14, 0x265e5a51);
+      MD5_STEP(MD5_G, b, c, d, a,  0, 20, 0xe9b6c7aa);
+      MD5_STEP(MD5_G, a, b, c, d,  5,  5, 0xd62f105d);
+      MD5_STEP(MD5_G, d, a, b, c, 10,  9, 0x02441453);
+      MD5_STEP(MD5_G, c, d, a, b, 15, 14, 0xd8a1e681);
+      MD5_STEP(MD5_G, b, c, d, a,  4, 20, 0xe7d3fbc8);
+      MD5_STEP(MD5_G, a, b, c, d,  9,  5, 0x21e1cde6);
+      MD5_STEP(MD5_G, d, a, b, c, 14,  9, 0xc33707d6);
+      MD5_STEP(MD5_G, c, d, a, b,  3, 14, 0xf4d50d87);
+      MD5_STEP(MD5_G, b, c, d, a,  8, 20, 0x455a14ed);
+      MD5_STEP(MD5_G, a, b, c, d, 13,  5, 0xa9e3e905);
+      MD5_STEP(MD5_G, d, a, b, c,  2,  9, 0xfcefa3f8);
+      MD5_STEP(MD5_G, c, d, a, b,  7, 14, 0x676f02d9);
+      MD5_STEP(MD5_G, b, c, d, a, 12, 20, 0x8d2a4c8a);
+
+      MD5_STEP(MD5_H, a, b, c, d,  5,  4, 0xfffa3942);
+      MD5_STEP(MD5_H, d, a, b, c,  8, 11, 0x8771f681);
+      MD5_STEP(MD5_H, c, d, a, b, 11, 16, 0x6d9d6122);
+      MD5_STEP(MD5_H, b, c, d, a, 14, 23, 0xfde5380c);
+      MD5_STEP(MD5_H, a, b, c, d,  1,  4, 0xa4beea44);
+      MD5_STEP(MD5_H, d, a, b, c,  4, 11, 0x4bdecfa9);
+      MD5_STEP(MD5_H, c, d, a, b,  7, 16, 0xf6bb4b60);
+      MD5_STEP(MD5_H, b, c, d, a, 10, 23, 0xbebfbc70);
+      MD5_STEP(MD5_H, a, b, c, d, 13,  4, 0x289b7ec6);
+      MD5_STEP(MD5_H, d, a, b, c,  0, 11, 0xeaa127fa);
+      MD5_STEP(MD5_H, c, d, a, b,  3, 16, 0xd4ef3085);
+      MD5_STEP(MD5_H, b, c, d, a,  6, 23, 0x04881d05);
+      MD5_STEP(MD5_H, a, b, c, d,  9,  4, 0xd9d4d039);
+      MD5_STEP(MD5_H, d, a, b, c, 12, 11, 0xe6db99e5);
+      MD5_STEP(MD5_H, c, d, a, b, 15, 16, 0x1fa27cf8);
+      MD5_STEP(MD5_H, b, c, d, a,  2, 23, 0xc4ac5665);
+
+      MD5_STEP(MD5_I, a, b, c, d,  0,  6, 0xf4292244);
+      MD5_STEP(MD5_I, d, a, b, c,  7, 10, 0x432aff97);
+      MD5_STEP(MD5_I, c, d, a, b, 14, 15, 0xab9423a7);
+      MD5_STEP(MD5_I, b, c, d, a,  5, 21, 0xfc93a039);
+      MD5_STEP(MD5_I, a, b, c, d, 12,  6, 0x655b59c3);
+      MD5_STEP(MD5_I, d, a, b, c,  3, 10, 0x8f0ccc92);
+      MD5_STEP(MD5_I, c, d, a, b, 10, 15, 0xffeff47d);
+      MD5_STEP(MD5_I, b, c, d, a,  1, 21, 0x85845dd1);
+      MD5_STEP(MD5_I, a, b, c, d,  8,  6, 0x6fa87e4f);
+      MD5_STEP(MD5_I, d, a, b, c, 15, 10, 0xfe2ce6e0);
+      MD5_STEP(MD5_I, c, d, a, b,  6, 15, 0xa3014314);
+      MD5_STEP(MD5_I, b, c, d, a, 13, 21, 0x4e0811a1);
+      MD5_STEP(MD5_I, a, b, c, d,  4,  6, 0xf7537e82);
+      MD5_STEP(MD5_I, d, a, b, c, 11, 10, 0xbd3af235);
+      MD5_STEP(MD5_I, c, d, a, b,  2, 15, 0x2ad7d2bb);
+      MD5_STEP(MD5_I, b, c, d, a,  9, 21, 0xeb86d391);
+
+  _mm256_storeu_si256((__m256i *)state[0], _mm256_add_epi32(a, a0));
+  _mm256_storeu_si256((__m256i *)state[1], _mm256_add_epi32(b, b0));
+  _mm256_storeu_si256((__m256i *)state[2], _mm256_add_epi32(c, c0));
+  _mm256_storeu_si256((__m256i *)state[3], _mm256_add_epi32(d, d0));
+}
+
+/* Per-lane progress of the multi-buffer MD5 calculation. */
+typedef struct md5_lane_t
+{
+  /* Index of the message being hashed in this lane, -1 if idle. */
+  apr_ssize_t index;
+
+  /* Next full block to hash directly from the message. */
+  const unsigned char *data;
+
+  /* Number of full blocks remaining at DATA. */
+  apr_size_t blocks;
+
+  /* The padded tail of the message: one or two blocks. */
+  unsigned char tail[128];
+
+  /* Next block to hash in TAIL and the number of valid blocks in there. */
+  int tail_pos;
+  int tail_blocks;
+} md5_lane_t;
+
+/* Initial MD5 state, see RFC 1321. */
+static const apr_uint32_t md5_initial_state[4] =
+  { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+
+/* Start hashing LEN bytes at DATA, the message with INDEX, in LANE
+ * number L.  Reset the respective lane in STATE.
+ */
+static void
+start_lane(md5_lane_t *lane,
+           apr_uint32_t state[4][LANES],
+           int l,
+           apr_ssize_t index,
+           const unsigned char *data,
+           apr_size_t len)
+{
+  apr_size_t remainder = len % 64;
+  apr_uint64_t bits = (apr_uint64_t)len * 8;
+  int i;
+
+  lane->index = index;
+  lane->data = data;
+  lane->blocks = len / 64;
+  lane->tail_pos = 0;
+  lane->tail_blocks = remainder + 9 > 64 ? 2 : 1;
+
+  /* Standard MD5 padding: 0x80, zeros, 64 bit little-endian length. */
+  memset(lane->tail, 0, sizeof(lane->tail));
+  memcpy(lane->tail, data + len - remainder, remainder);
+  lane->tail[remainder] = 0x80;
+  for (i = 0; i < 8; ++i)
+    lane->tail[lane->tail_blocks * 64 - 8 + i]
+      = (unsigned char)(bits >> (8 * i));
+
+  for (i = 0; i < 4; ++i)
+    state[i][l] = md5_initial_state[i];
+}
+
+/* AVX2 implementation of svn__md5_multi().
+ */
+static void
+md5_multi_avx2(unsigned char *digests,
+               const void *const *data,
+               const apr_size_t *lens,
+               apr_size_t count)
+{
+  static const unsigned char idle_block[64] = { 0 };
+
+  apr_uint32_t state[4][LANES];
+  md5_lane_t lanes[LANES];
+  const unsigned char *blocks[LANES];
+  apr_size_t next = 0;
+  int active = 0;
+  int l, i;
+
+  for (l = 0; l < LANES; ++l)
+    {
+      if (next < count)
+        {
+          start_lane(&lanes[l], state, l, next, data[next], lens[next]);
+          ++next;
+          ++active;
+        }
+      else
+        {
+          lanes[l].index = -1;
+        }
+    }
+
+  while (active)
+    {
+      for (l = 0; l < LANES; ++l)
+        {
+          md5_lane_t *lane = &lanes[l];
+          if (lane->index < 0)
+            blocks[l] = idle_block;
+          else if (lane->blocks)
+            blocks[l] = lane->data;
+          else
+            blocks[l] = lane->tail + 64 * lane->tail_pos;
+        }
+
+      md5_x8_avx2(state, blocks);
+
+      for (l = 0; l < LANES; ++l)
+        {
+          md5_lane_t *lane = &lanes[l];
+          if (lane->index < 0)
+            continue;
+
+          if (lane->blocks)
+            {
+              lane->data += 64;
+              --lane->blocks;
+              continue;
+            }
+
+          if (++lane->tail_pos < lane->tail_blocks)
+            continue;
+
+          /* Message complete.  Its digest is the little-endian state. */
+          for (i = 0; i < 4; ++i)
+            {
+              unsigned char *digest = digests + lane->index * 16 + 4 * i;
+              digest[0] = (unsigned char)(state[i][l]);
+              digest[1] = (unsigned char)(state[i][l] >> 8);
+              digest[2] = (unsigned char)(state[i][l] >> 16);
+              digest[3] = (unsigned char)(state[i][l] >> 24);
+            }
+
+          if (next < count)
+            {
+              start_lane(lane, state, l, next, data[next], lens[next]);
+              ++next;
+            }
+          else
+            {
+              lane->index = -1;
+              --active;
+            }
+        }
+    }
+}
+
+#endif /* SVN__SIMD_X86 */
+
+void
+svn__md5_multi(unsigned char *digests,
+               const void *const *data,
+               const apr_size_t *lens,
+               apr_size_t count)
+{
+  apr_size_t i;
+
+#ifdef SVN__SIMD_X86
+  /* With just a single message, most lanes would idle. */
+  if (count > 1 && (svn_cpu__features() & SVN_CPU__AVX2))
+    {
+      md5_multi_avx2(digests, data, lens, count);
+      return;
+    }
+#endif
+
+  for (i = 0; i < count; ++i)
+    apr_md5(digests + i * APR_MD5_DIGESTSIZE, data[i], lens[i]);
+}
+
 
 
 /* These are all deprecated, and just wrap the internal functions defined
@@ -0,0 +1,351 @@
+/*
+ * parallel.c:  processing a sequence of tasks in worker threads
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
+#include <apr_thread_proc.h>
+
+#include "svn_pools.h"
+#include "svn_sorts.h"
+#include "svn_private_config.h"
+
+#include "private/svn_atomic.h"
+#include "private/svn_parallel.h"
+
+#if APR_HAS_THREADS
+
+/* How long the calling thread waits for a worker before it checks for
+   cancellation again, in microseconds. */
+#define POLL_INTERVAL (100 * 1000)
+
+/* The outcome of a single task. */
+typedef struct slot_t
+{
+  /* Thread-safe pool, private to this slot.  Holds RESULT. */
+  apr_pool_t *pool;
+
+  /* Returned by the task function.  Valid once DONE has been set. */
+  void *result;
+  svn_error_t *err;
+
+  /* Set by the worker when RESULT and ERR are valid.  Protected by the
+     MUTEX in the run_t. */
+  svn_boolean_t done;
+} slot_t;
+
+/* Ring buffer of tasks that get processed concurrently and are reported
+   in order by the calling thread. */
+typedef struct run_t
+{
+  /* Task t is being processed in slot t % SLOT_COUNT. */
+  slot_t *slots;
+  int slot_count;
+
+  /* Number of tasks in total. */
+  apr_int64_t task_count;
+
+  /* The oldest task not reported yet and the next task to be picked up
+     by a worker.  Protected by MUTEX. */
+  apr_int64_t first_task;
+  apr_int64_t next_task;
+
+  /* Parameters given to svn_parallel__run_ordered(). */
+  svn_parallel__task_func_t task_func;
+  void *baton;
+
+  /* Non-zero when the workers shall stop as soon as possible. */
+  volatile svn_atomic_t aborted;
+
+  /* Protects the fields above and notifies all threads of completed or
+     released slots. */
+  apr_thread_mutex_t *mutex;
+  apr_thread_cond_t *cond;
+} run_t;
+
+/* A worker thread and its private resources. */
+typedef struct worker_t
+{
+  /* Created by the worker init function, allocated in POOL. */
+  void *baton;
+
+  /* Root pool, private to this worker. */
+  apr_pool_t *pool;
+
+  /* NULL if the thread has not been started. */
+  apr_thread_t *thread;
+
+  /* Where to get the tasks from. */
+  run_t *run;
+} worker_t;
+
+/* Return the slot in RUN that TASK uses. */
+static slot_t *
+get_slot(run_t *run,
+         apr_int64_t task)
+{
+  return &run->slots[task % run->slot_count];
+}
+
+/* Implements svn_cancel_func_t for the run_t given as BATON. */
+static svn_error_t *
+check_aborted(void *baton)
+{
+  run_t *run = baton;
+
+  if (svn_atomic_read(&run->aborted))
+    return svn_error_create(SVN_ERR_CANCELLED, NULL, NULL);
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements apr_thread_start_t.  Process the tasks queued in the
+   worker_t given as DATA until none are left. */
+static void * APR_THREAD_FUNC
+worker_thread(apr_thread_t *thread,
+              void *data)
+{
+  worker_t *worker = data;
+  run_t *run = worker->run;
+  apr_pool_t *iterpool = svn_pool_create(worker->pool);
+
+  while (TRUE)
+    {
+      slot_t *slot = NULL;
+      apr_int64_t task = 0;
+      void *result = NULL;
+      svn_error_t *err;
+
+      /* Wait for the slot of the next task to become available. */
+      apr_thread_mutex_lock(run->mutex);
+      while (   !svn_atomic_read(&run->aborted)
+             && run->next_task < run->task_count
+             && run->next_task >= run->first_task + run->slot_count)
+        apr_thread_cond_wait(run->cond, run->mutex);
+
+      if (!svn_atomic_read(&run->aborted)
+          && run->next_task < run->task_count)
+        {
+          task = run->next_task++;
+          slot = get_slot(run, task);
+        }
+      apr_thread_mutex_unlock(run->mutex);
+
+      if (slot == NULL)
+        break;
+
+      svn_pool_clear(iterpool);
+      err = run->task_func(&result, run->baton, worker->baton, task,
+                           check_aborted, run, slot->pool, iterpool);
+
+      apr_thread_mutex_lock(run->mutex);
+      slot->result = result;
+      slot->err = err;
+      slot->done = TRUE;
+      apr_thread_cond_broadcast(run->cond);
+      apr_thread_mutex_unlock(run->mutex);
+    }
+
+  svn_pool_destroy(iterpool);
+  apr_thread_exit(thread, APR_SUCCESS);
+
+  return NULL;
+}
+
+/* Block until a worker in RUN has finished SLOT.  Poll CANCEL_FUNC with
+   CANCEL_BATON while waiting. */
+static svn_error_t *
+wait_for_slot(run_t *run,
+              slot_t *slot,
+              svn_cancel_func_t cancel_func,
+              void *cancel_baton)
+{
+  svn_boolean_t done = FALSE;
+
+  while (!done)
+    {
+      apr_status_t status;
+
+      if (cancel_func)
+        SVN_ERR(cancel_func(cancel_baton));
+
+      status = apr_thread_mutex_lock(run->mutex);
+      if (status)
+        return svn_error_wrap_apr(status, _("Can't lock mutex"));
+
+      if (!slot->done)
+        status = apr_thread_cond_timedwait(run->cond, run->mutex,
+                                           POLL_INTERVAL);
+
+      done = slot->done;
+      apr_thread_mutex_unlock(run->mutex);
+
+      if (status && !APR_STATUS_IS_TIMEUP(status))
+        return svn_error_wrap_apr(status,
+                                  _("Can't wait on condition variable"));
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Make SLOT in RUN available for the task following TASK, which has
+   just been reported. */
+static svn_error_t *
+release_slot(run_t *run,
+             slot_t *slot,
+             apr_int64_t task)
+{
+  apr_status_t status;
+
+  svn_pool_clear(slot->pool);
+  slot->result = NULL;
+
+  status = apr_thread_mutex_lock(run->mutex);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't lock mutex"));
+
+  slot->done = FALSE;
+  run->first_task = task + 1;
+  apr_thread_cond_broadcast(run->cond);
+  apr_thread_mutex_unlock(run->mutex);
+
+  return SVN_NO_ERROR;
+}
+
+svn_error_t *
+svn_parallel__run_ordered(apr_int64_t task_count,
+                          int jobs,
+                          int window,
+                          svn_parallel__worker_init_t init_func,
+                          svn_parallel__task_func_t task_func,
+                          svn_parallel__result_func_t result_func,
+                          void *baton,
+                          svn_cancel_func_t cancel_func,
+                          void *cancel_baton,
+                          apr_pool_t *scratch_pool)
+{
+  run_t *run = apr_pcalloc(scratch_pool, sizeof(*run));
+  worker_t *workers;
+  apr_pool_t *iterpool;
+  svn_error_t *err = SVN_NO_ERROR;
+  apr_status_t status;
+  apr_int64_t task;
+  int i;
+
+  if (task_count <= 0)
+    return SVN_NO_ERROR;
+
+  run->task_count = task_count;
+  run->task_func = task_func;
+  run->baton = baton;
+
+  status = apr_thread_mutex_create(&run->mutex, APR_THREAD_MUTEX_DEFAULT,
+                                   scratch_pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create mutex"));
+
+  status = apr_thread_cond_create(&run->cond, scratch_pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create condition variable"));
+
+  /* There is no point in having more workers or slots than tasks. */
+  jobs = (int)MIN(MAX(jobs, 1), task_count);
+  run->slot_count = (int)MIN(MAX(window, jobs), task_count);
+  run->slots = apr_pcalloc(scratch_pool,
+                           run->slot_count * sizeof(*run->slots));
+  for (i = 0; i < run->slot_count; ++i)
+    run->slots[i].pool = svn_pool_create(NULL);
+
+  /* The thread objects live in the workers' pools because SCRATCH_POOL
+     may not be thread-safe. */
+  iterpool = svn_pool_create(scratch_pool);
+  workers = apr_pcalloc(scratch_pool, jobs * sizeof(*workers));
+  for (i = 0; i < jobs && !err; ++i)
+    {
+      worker_t *worker = &workers[i];
+
+      worker->run = run;
+      worker->pool = svn_pool_create(NULL);
+      if (init_func)
+        err = init_func(&worker->baton, baton, worker->pool, iterpool);
+
+      if (!err)
+        {
+          status = apr_thread_create(&worker->thread, NULL, worker_thread,
+                                     worker, worker->pool);
+          if (status)
+            err = svn_error_wrap_apr(status, _("Can't create thread"));
+        }
+    }
+
+  /* Report the results in task order. */
+  for (task = 0; task < task_count && !err; ++task)
+    {
+      slot_t *slot = get_slot(run, task);
+      svn_error_t *task_err;
+
+      svn_pool_clear(iterpool);
+
+      err = wait_for_slot(run, slot, cancel_func, cancel_baton);
+      if (err)
+        break;
+
+      task_err = slot->err;
+      slot->err = NULL;
+
+      err = result_func(baton, task, slot->result, task_err, iterpool);
+      if (!err)
+        err = release_slot(run, slot, task);
+    }
+
+  /* Stop all workers and release their resources. */
+  apr_thread_mutex_lock(run->mutex);
+  svn_atomic_set(&run->aborted, TRUE);
+  apr_thread_cond_broadcast(run->cond);
+  apr_thread_mutex_unlock(run->mutex);
+
+  for (i = 0; i < jobs; ++i)
+    {
+      worker_t *worker = &workers[i];
+
+      if (worker->thread)
+        {
+          apr_status_t retval;
+          apr_thread_join(&retval, worker->thread);
+        }
+
+      if (worker->pool)
+        svn_pool_destroy(worker->pool);
+    }
+
+  for (i = 0; i < run->slot_count; ++i)
+    {
+      svn_error_clear(run->slots[i].err);
+      svn_pool_destroy(run->slots[i].pool);
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return svn_error_trace(err);
+}
+
+#endif /* APR_HAS_THREADS */
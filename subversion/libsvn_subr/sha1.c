@@ -0,0 +1,350 @@
+/*
+ * sha1.c :  SHA-1 implementation with hardware acceleration
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#include <string.h>
+
+#include <apr.h>
+
+#include "private/svn_cpu.h"
+#include "sha1.h"
+
+#if defined(SVN__SIMD_X86)
+#  include <immintrin.h>
+#endif
+
+/* This is a straight-forward implementation of FIPS 180-4.  The reason we
+ * don't simply use APR's SHA-1 code is that we want to make use of the
+ * SHA extensions found in many x86 CPUs.  They speed up SHA-1 calculation
+ * by a factor of 3 to 5.
+ */
+
+/* Initial hash value H(0). */
+static const apr_uint32_t initial_state[5] =
+  { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+
+/* Update STATE with COUNT consecutive 64 byte blocks starting at DATA.
+ */
+typedef void (*compress_func_t)(apr_uint32_t state[5],
+                                const unsigned char *data,
+                                apr_size_t count);
+
+/* Rotate X left by N bits. */
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+/* Return the message schedule word W[I] for I >= 16, using and updating
+ * the ring buffer W of the last 16 words. */
+#define SCHEDULE(i)                                                     \
+  (w[(i) & 15] = ROTL(w[((i) + 13) & 15] ^ w[((i) + 8) & 15]             \
+                      ^ w[((i) + 2) & 15] ^ w[(i) & 15], 1))
+
+/* One SHA-1 round with round function value F, constant K and message
+ * word W.  Instead of rotating the variables, the callers rotate the
+ * arguments. */
+#define ROUND(a, b, c, d, e, f, k, w)                                   \
+  do                                                                    \
+    {                                                                   \
+      e += ROTL(a, 5) + (f) + (k) + (w);                                \
+      b = ROTL(b, 30);                                                  \
+    }                                                                   \
+  while (0)
+
+#define F1(b, c, d) ((d) ^ ((b) & ((c) ^ (d))))
+#define F2(b, c, d) ((b) ^ (c) ^ (d))
+#define F3(b, c, d) (((b) & (c)) | ((d) & ((b) | (c))))
+
+/* Five consecutive rounds starting at round I with function F and
+ * constant K.  W is computed by the expression WF. */
+#define ROUNDS5(i, f, k, wf)                                            \
+  do                                                                    \
+    {                                                                   \
+      ROUND(a, b, c, d, e, f(b, c, d), k, wf((i)));                     \
+      ROUND(e, a, b, c, d, f(a, b, c), k, wf((i) + 1));                 \
+      ROUND(d, e, a, b, c, f(e, a, b), k, wf((i) + 2));                 \
+      ROUND(c, d, e, a, b, f(d, e, a), k, wf((i) + 3));                 \
+      ROUND(b, c, d, e, a, f(c, d, e), k, wf((i) + 4));                 \
+    }                                                                   \
+  while (0)
+
+#define LOADED(i) w[(i)]
+
+/* Portable implementation of compress_func_t.
+ */
+static void
+compress_scalar(apr_uint32_t state[5],
+                const unsigned char *data,
+                apr_size_t count)
+{
+  for (; count; --count, data += 64)
+    {
+      apr_uint32_t w[16];
+      apr_uint32_t a = state[0];
+      apr_uint32_t b = state[1];
+      apr_uint32_t c = state[2];
+      apr_uint32_t d = state[3];
+      apr_uint32_t e = state[4];
+      int i;
+
+      for (i = 0; i < 16; ++i)
+        w[i] = ((apr_uint32_t)data[4 * i] << 24)
+             | ((apr_uint32_t)data[4 * i + 1] << 16)
+             | ((apr_uint32_t)data[4 * i + 2] << 8)
+             | ((apr_uint32_t)data[4 * i + 3]);
+
+      ROUNDS5(0, F1, 0x5a827999, LOADED);
+      ROUNDS5(5, F1, 0x5a827999, LOADED);
+      ROUNDS5(10, F1, 0x5a827999, LOADED);
+      ROUND(a, b, c, d, e, F1(b, c, d), 0x5a827999, w[15]);
+      ROUND(e, a, b, c, d, F1(a, b, c), 0x5a827999, SCHEDULE(16));
+      ROUND(d, e, a, b, c, F1(e, a, b), 0x5a827999, SCHEDULE(17));
+      ROUND(c, d, e, a, b, F1(d, e, a), 0x5a827999, SCHEDULE(18));
+      ROUND(b, c, d, e, a, F1(c, d, e), 0x5a827999, SCHEDULE(19));
+
+      ROUNDS5(20, F2, 0x6ed9eba1, SCHEDULE);
+      ROUNDS5(25, F2, 0x6ed9eba1, SCHEDULE);
+      ROUNDS5(30, F2, 0x6ed9eba1, SCHEDULE);
+      ROUNDS5(35, F2, 0x6ed9eba1, SCHEDULE);
+
+      ROUNDS5(40, F3, 0x8f1bbcdc, SCHEDULE);
+      ROUNDS5(45, F3, 0x8f1bbcdc, SCHEDULE);
+      ROUNDS5(50, F3, 0x8f1bbcdc, SCHEDULE);
+      ROUNDS5(55, F3, 0x8f1bbcdc, SCHEDULE);
+
+      ROUNDS5(60, F2, 0xca62c1d6, SCHEDULE);
+      ROUNDS5(65, F2, 0xca62c1d6, SCHEDULE);
+      ROUNDS5(70, F2, 0xca62c1d6, SCHEDULE);
+      ROUNDS5(75, F2, 0xca62c1d6, SCHEDULE);
+
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+    }
+}
+
+#ifdef SVN__SIMD_X86
+
+/* Process 4 SHA-1 rounds, group G (0 .. 19) with round function F, using
+ * the SHA extensions.  This expands to straight-line code with all index
+ * calculations being constant.
+ *
+ * M[G % 4] contains the message words for this group.  The message
+ * schedule for the groups G+1 .. G+3 gets updated in parallel such that
+ * the SHA1MSG1, XOR and SHA1MSG2 steps are each applied to one of the
+ * other message registers.  E[0] and E[1] alternate as the "E" input.
+ */
+#define SHA_NI_ROUNDS4(g, f)                                                \
+  do                                                                        \
+    {                                                                       \
+      if ((g) < 4)                                                          \
+        m[(g) % 4] = _mm_shuffle_epi8(                                      \
+                       _mm_loadu_si128((const __m128i *)(data + 16 * (g))), \
+                       byte_order);                                         \
+      if ((g) == 0)                                                         \
+        e[0] = _mm_add_epi32(e[0], m[0]);                                   \
+      else                                                                  \
+        e[(g) % 2] = _mm_sha1nexte_epu32(e[(g) % 2], m[(g) % 4]);           \
+      e[((g) + 1) % 2] = abcd;                                              \
+      abcd = _mm_sha1rnds4_epu32(abcd, e[(g) % 2], f);                      \
+      if ((g) >= 3 && (g) <= 18)                                            \
+        m[((g) + 1) % 4] = _mm_sha1msg2_epu32(m[((g) + 1) % 4],             \
+                                              m[(g) % 4]);                  \
+      if ((g) >= 2 && (g) <= 17)                                            \
+        m[((g) + 2) % 4] = _mm_xor_si128(m[((g) + 2) % 4], m[(g) % 4]);     \
+      if ((g) >= 1 && (g) <= 16)                                            \
+        m[((g) + 3) % 4] = _mm_sha1msg1_epu32(m[((g) + 3) % 4],             \
+                                              m[(g) % 4]);                  \
+    }                                                                       \
+  while (0)
+
+/* Implementation of compress_func_t using the x86 SHA extensions.
+ */
+SVN__TARGET("sha,sse4.1")
+static void
+compress_sha_ni(apr_uint32_t state[5],
+                const unsigned char *data,
+                apr_size_t count)
+{
+  const __m128i byte_order = _mm_set_epi64x(0x0001020304050607LL,
+                                            0x08090a0b0c0d0e0fLL);
+  __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state),
+                                   0x1b);
+  __m128i e[2];
+  __m128i m[4];
+
+  e[0] = _mm_set_epi32((int)state[4], 0, 0, 0);
+  e[1] = _mm_setzero_si128();
+
+  for (; count; --count, data += 64)
+    {
+      const __m128i abcd_save = abcd;
+      const __m128i e_save = e[0];
+
+      SHA_NI_ROUNDS4(0, 0);
+      SHA_NI_ROUNDS4(1, 0);
+      SHA_NI_ROUNDS4(2, 0);
+      SHA_NI_ROUNDS4(3, 0);
+      SHA_NI_ROUNDS4(4, 0);
+      SHA_NI_ROUNDS4(5, 1);
+      SHA_NI_ROUNDS4(6, 1);
+      SHA_NI_ROUNDS4(7, 1);
+      SHA_NI_ROUNDS4(8, 1);
+      SHA_NI_ROUNDS4(9, 1);
+      SHA_NI_ROUNDS4(10, 2);
+      SHA_NI_ROUNDS4(11, 2);
+      SHA_NI_ROUNDS4(12, 2);
+      SHA_NI_ROUNDS4(13, 2);
+      SHA_NI_ROUNDS4(14, 2);
+      SHA_NI_ROUNDS4(15, 3);
+      SHA_NI_ROUNDS4(16, 3);
+      SHA_NI_ROUNDS4(17, 3);
+      SHA_NI_ROUNDS4(18, 3);
+      SHA_NI_ROUNDS4(19, 3);
+
+      e[0] = _mm_sha1nexte_epu32(e[0], e_save);
+      abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+  _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1b));
+  state[4] = (apr_uint32_t)_mm_extract_epi32(e[0], 3);
+}
+
+#endif /* SVN__SIMD_X86 */
+
+/* Return the fastest compress_func_t available on this machine.
+ */
+static compress_func_t
+get_compress_func(void)
+{
+#ifdef SVN__SIMD_X86
+  const apr_uint32_t required = SVN_CPU__SHA | SVN_CPU__SSSE3
+                              | SVN_CPU__SSE4_1;
+  if ((svn_cpu__features() & required) == required)
+    return compress_sha_ni;
+#endif
+
+  return compress_scalar;
+}
+
+svn_sha1__context_t *
+svn_sha1__context_create(apr_pool_t *pool)
+{
+  svn_sha1__context_t *context = apr_palloc(pool, sizeof(*context));
+  svn_sha1__context_reset(context);
+
+  return context;
+}
+
+void
+svn_sha1__context_reset(svn_sha1__context_t *context)
+{
+  memcpy(context->state, initial_state, sizeof(initial_state));
+  context->length = 0;
+}
+
+void
+svn_sha1__update(svn_sha1__context_t *context,
+                 const void *data,
+                 apr_size_t len)
+{
+  const unsigned char *input = data;
+  apr_size_t buffered = (apr_size_t)(context->length % 64);
+  compress_func_t compress = get_compress_func();
+
+  context->length += len;
+
+  /* Complete a partial block from previous calls first. */
+  if (buffered)
+    {
+      apr_size_t to_copy = 64 - buffered;
+      if (to_copy > len)
+        to_copy = len;
+
+      memcpy(context->buffer + buffered, input, to_copy);
+      input += to_copy;
+      len -= to_copy;
+
+      if (buffered + to_copy < 64)
+        return;
+
+      compress(context->state, context->buffer, 1);
+    }
+
+  /* Process all full blocks directly from the input buffer. */
+  if (len >= 64)
+    {
+      compress(context->state, input, len / 64);
+      input += len & ~(apr_size_t)63;
+      len &= 63;
+    }
+
+  if (len)
+    memcpy(context->buffer, input, len);
+}
+
+void
+svn_sha1__finalize(unsigned char digest[SVN_SHA1__DIGESTSIZE],
+                   svn_sha1__context_t *context)
+{
+  apr_size_t buffered = (apr_size_t)(context->length % 64);
+  apr_uint64_t bits = context->length * 8;
+  unsigned char *buffer = context->buffer;
+  compress_func_t compress = get_compress_func();
+  int i;
+
+  /* Padding: a single 1 bit, zeros and the 64 bit message length in
+   * big-endian notation. */
+  buffer[buffered++] = 0x80;
+  if (buffered > 56)
+    {
+      memset(buffer + buffered, 0, 64 - buffered);
+      compress(context->state, buffer, 1);
+      buffered = 0;
+    }
+
+  memset(buffer + buffered, 0, 56 - buffered);
+  for (i = 0; i < 8; ++i)
+    buffer[56 + i] = (unsigned char)(bits >> (56 - 8 * i));
+
+  compress(context->state, buffer, 1);
+
+  for (i = 0; i < 5; ++i)
+    {
+      digest[4 * i]     = (unsigned char)(context->state[i] >> 24);
+      digest[4 * i + 1] = (unsigned char)(context->state[i] >> 16);
+      digest[4 * i + 2] = (unsigned char)(context->state[i] >> 8);
+      digest[4 * i + 3] = (unsigned char)(context->state[i]);
+    }
+}
+
+void
+svn_sha1__digest(unsigned char digest[SVN_SHA1__DIGESTSIZE],
+                 const void *data,
+                 apr_size_t len)
+{
+  svn_sha1__context_t context;
+
+  svn_sha1__context_reset(&context);
+  svn_sha1__update(&context, data, len);
+  svn_sha1__finalize(digest, &context);
+}
@@ -62,6 +62,7 @@ struct svn_stream_t {
   svn_stream_seek_fn_t seek_fn;
   svn_stream_data_available_fn_t data_available_fn;
   svn_stream_readline_fn_t readline_fn;
+  svn_stream__write_buffer_fn_t write_buffer_fn;
   apr_file_t *file; /* Maybe NULL */
 };
 
@@ -111,6 +112,9 @@ void
 svn_stream_set_write(svn_stream_t *stream, svn_write_fn_t write_fn)
 {
   stream->write_fn = write_fn;
+
+  /* Any write buffer belongs to the previous write function. */
+  stream->write_buffer_fn = NULL;
 }
 
 void
@@ -145,6 +149,13 @@ svn_stream_set_readline(svn_stream_t *stream,
   stream->readline_fn = readline_fn;
 }
 
+void
+svn_stream__set_write_buffer(svn_stream_t *stream,
+                             svn_stream__write_buffer_fn_t write_buffer_fn)
+{
+  stream->write_buffer_fn = write_buffer_fn;
+}
+
 /* Standard implementation for svn_stream_read_full() based on
    multiple svn_stream_read2() calls (in separate function to make
    it more likely for svn_stream_read_full to be inlined) */
@@ -222,6 +233,22 @@ svn_stream_write(svn_stream_t *stream, const char *data, apr_size_t *len)
 }
 
 
+svn_error_t *
+svn_stream__get_write_buffer(char **buffer,
+                             svn_stream_t *stream,
+                             apr_size_t len)
+{
+  if (stream->write_buffer_fn == NULL)
+    {
+      *buffer = NULL;
+      return SVN_NO_ERROR;
+    }
+
+  return svn_error_trace(stream->write_buffer_fn(stream->baton, buffer,
+                                                 len));
+}
+
+
 svn_error_t *
 svn_stream_reset(svn_stream_t *stream)
 {
@@ -1649,7 +1676,27 @@ write_handler_stringbuf(void *baton, const char *data, apr_size_t *len)
 {
   struct stringbuf_stream_baton *btn = baton;
 
-  svn_stringbuf_appendbytes(btn->str, data, *len);
+  /* Data from write_buffer_handler_stringbuf() is already in place. */
+  if (data == btn->str->data + btn->str->len)
+    {
+      btn->str->len += *len;
+      btn->str->data[btn->str->len] = '\0';
+    }
+  else
+    {
+      svn_stringbuf_appendbytes(btn->str, data, *len);
+    }
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+write_buffer_handler_stringbuf(void *baton, char **buffer, apr_size_t len)
+{
+  struct stringbuf_stream_baton *btn = baton;
+
+  svn_stringbuf_ensure(btn->str, btn->str->len + len);
+  *buffer = btn->str->data + btn->str->len;
   return SVN_NO_ERROR;
 }
 
@@ -1742,6 +1789,7 @@ svn_stream_from_stringbuf(svn_stringbuf_t *str,
   svn_stream_set_read2(stream, read_handler_stringbuf, read_handler_stringbuf);
   svn_stream_set_skip(stream, skip_handler_stringbuf);
   svn_stream_set_write(stream, write_handler_stringbuf);
+  svn_stream__set_write_buffer(stream, write_buffer_handler_stringbuf);
   svn_stream_set_mark(stream, mark_handler_stringbuf);
   svn_stream_set_seek(stream, seek_handler_stringbuf);
   svn_stream_set_data_available(stream, data_available_handler_stringbuf);
@@ -1110,55 +1110,59 @@ translate_chunk(svn_stream_t *dst,
                 b->nl_translation_skippable = svn_tristate_false;
             }
 
-          /* We're in the boring state; look for interesting characters.
-             Offset len such that it will become 0 in the first iteration.
-           */
-          len = 0 - b->eol_str_len;
-
-          /* Look for the next EOL (or $) that actually needs translation.
-             Stop there or at EOF, whichever is encountered first.
-           */
-          do
+          /* We're in the boring state; look for interesting characters. */
+          if (b->nl_translation_skippable == svn_tristate_true
+              && b->eol_str_len == 1 && b->eol_str[0] == '\n')
             {
-              /* skip current EOL */
-              len += b->eol_str_len;
-
-              if (b->keywords)
+              /* Bulk copy path for the most frequent case:  The LFs are
+                 already in the desired format and can't become part of
+                 a CRLF unless there is a CR, which we would stop at.
+                 So, everything up to the next CR or '$' can be copied
+                 without looking at the EOLs individually. */
+              len = svn_eol__find_any(p, end - p, '\r', '\r',
+                                      b->keywords ? '$' : '\r') - p;
+            }
+          else
+            {
+              /* Offset len such that it will become 0 in the first
+                 iteration. */
+              len = 0 - b->eol_str_len;
+
+              /* Look for the next EOL (or $) that actually needs
+                 translation.  Stop there or at EOF, whichever is
+                 encountered first.
+               */
+              do
                 {
-                  /* Check 4 bytes at once to allow for efficient pipelining
-                    and to reduce loop condition overhead. */
-                  while ((end - p) >= (len + 4))
-                    {
-                      if (interesting[(unsigned char)p[len]]
-                          || interesting[(unsigned char)p[len+1]]
-                          || interesting[(unsigned char)p[len+2]]
-                          || interesting[(unsigned char)p[len+3]])
-                        break;
+                  /* skip current EOL */
+                  len += b->eol_str_len;
 
-                      len += 4;
+                  if (b->keywords)
+                    {
+                      /* Find the next '$' or, if we translate them, EOL
+                         using our vectorized scanner. */
+                      const char *start = p + len;
+                      len += svn_eol__find_any(start, end - start, '$',
+                                               b->eol_str ? '\r' : '$',
+                                               b->eol_str ? '\n' : '$')
+                           - start;
                     }
+                  else
+                    {
+                      /* use our optimized sub-routine to find the next EOL */
+                      const char *start = p + len;
+                      const char *eol
+                        = svn_eol__find_eol_start((char *)start, end - start);
 
-                  /* Found an interesting char or EOF in the next 4 bytes.
-                     Find its exact position. */
-                  while ((p + len) < end
-                         && !interesting[(unsigned char)p[len]])
-                    ++len;
-                }
-              else
-                {
-                  /* use our optimized sub-routine to find the next EOL */
-                  const char *start = p + len;
-                  const char *eol
-                    = svn_eol__find_eol_start((char *)start, end - start);
-
-                  /* EOL will be NULL if we did not find a line ending */
-                  len += (eol ? eol : end) - start;
+                      /* EOL will be NULL if we did not find a line ending */
+                      len += (eol ? eol : end) - start;
+                    }
                 }
+              while (b->nl_translation_skippable
+                       == svn_tristate_true &&  /* can potentially skip EOLs */
+                     (end - p) > (len + 2) &&   /* not too close to EOF */
+                     eol_unchanged(b, p + len)); /* EOL format already ok */
             }
-          while (b->nl_translation_skippable ==
-                   svn_tristate_true &&       /* can potentially skip EOLs */
-                 (end - p) > (len + 2) &&     /* not too close to EOF */
-                 eol_unchanged(b, p + len));  /* EOL format already ok */
 
           while ((p + len) < end && !interesting[(unsigned char)p[len]])
             len++;
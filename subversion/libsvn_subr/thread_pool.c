@@ -0,0 +1,103 @@
+/*
+ * thread_pool.c:  process-wide pool of worker threads
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#include <apr_thread_pool.h>
+
+#include "svn_pools.h"
+#include "svn_private_config.h"
+
+#include "private/svn_atomic.h"
+#include "private/svn_thread_pool.h"
+
+#if APR_HAS_THREADS
+
+/* Maximum number of threads in WORKER_THREADS, i.e. the number of tasks
+   that can be processed concurrently throughout the process. */
+#define MAX_WORKER_THREADS 16
+
+/* Number of microseconds that an unused thread remains in the pool before
+   being terminated. */
+#define WORKER_THREAD_IDLE_LIMIT 1000000
+
+/* Thread pool shared by all parallel delta computations, encoders and
+   file diffs. */
+static apr_thread_pool_t *worker_threads = NULL;
+
+/* Keep track on whether we already created WORKER_THREADS. */
+static volatile svn_atomic_t worker_threads_initialized = FALSE;
+
+/* Destructor function that cleans up WORKER_THREADS.
+   Must be run as a pre-cleanup hook. */
+static apr_status_t
+worker_threads_pre_cleanup(void *data)
+{
+  apr_thread_pool_t *tp = worker_threads;
+  if (!worker_threads)
+    return APR_SUCCESS;
+
+  worker_threads = NULL;
+  worker_threads_initialized = FALSE;
+
+  return apr_thread_pool_destroy(tp);
+}
+
+/* Implements svn_atomic__err_init_func_t.  Create WORKER_THREADS. */
+static svn_error_t *
+create_worker_threads(void *baton,
+                      apr_pool_t *scratch_pool)
+{
+  /* The thread pool must be allocated from a thread-safe pool that
+     lives as long as the process. */
+  apr_pool_t *pool = svn_pool_create(NULL);
+  apr_status_t status;
+
+  status = apr_thread_pool_create(&worker_threads, 0, MAX_WORKER_THREADS,
+                                  pool);
+  if (status)
+    return svn_error_wrap_apr(status, _("Can't create worker threads"));
+
+  /* The sub-pools containing the thread objects must still be valid
+     when the threads get terminated. */
+  apr_pool_pre_cleanup_register(pool, NULL, worker_threads_pre_cleanup);
+
+  /* Let idle threads linger for a while in case more tasks arrive. */
+  apr_thread_pool_idle_wait_set(worker_threads, WORKER_THREAD_IDLE_LIMIT);
+
+  /* Don't queue requests unless we reached the worker thread limit. */
+  apr_thread_pool_threshold_set(worker_threads, 0);
+
+  return SVN_NO_ERROR;
+}
+
+svn_error_t *
+svn_thread_pool__get(apr_thread_pool_t **threads,
+                     apr_pool_t *scratch_pool)
+{
+  SVN_ERR(svn_atomic__init_once(&worker_threads_initialized,
+                                create_worker_threads, NULL, scratch_pool));
+  *threads = worker_threads;
+
+  return SVN_NO_ERROR;
+}
+
+#endif /* APR_HAS_THREADS */
@@ -59,6 +59,13 @@
 #include "private/svn_utf_private.h"
 #include "private/svn_eol_private.h"
 #include "private/svn_dep_compat.h"
+#include "private/svn_cpu.h"
+
+#if defined(SVN__SIMD_X86)
+#  include <immintrin.h>
+#elif defined(SVN__SIMD_NEON)
+#  include <arm_neon.h>
+#endif
 
 /* Lookup table to categorise each octet in the string. */
 static const char octet_category[256] = {
@@ -276,10 +283,346 @@ first_non_fsm_start_char(const char *data, apr_size_t max_len)
   return data;
 }
 
+#if defined(SVN__SIMD_X86) || defined(SVN__SIMD_NEON)
+
+/* The SIMD kernels validate 16 or 32 bytes at a time using the lookup
+ * algorithm described in
+ *
+ *    John Keiser, Daniel Lemire: "Validating UTF-8 In Less Than One
+ *    Instruction Per Byte", Software: Practice and Experience 51 (2021)
+ *
+ * Every pair of consecutive bytes gets classified by looking up the high
+ * nibble of the first byte, its low nibble and the high nibble of the
+ * second byte in three tables and ANDing the results.  Any bit left set
+ * flags one of the error classes below.  Missing 3rd and 4th bytes of a
+ * sequence are detected by checking the bytes 2 and 3 positions earlier.
+ *
+ * The kernels only report whether there is an error somewhere in a block.
+ * The exact position is then being found by running the FSM from the
+ * start of the character that overlaps the beginning of that block.
+ */
+
+/* Error classes for a pair of consecutive bytes. */
+#define TOO_SHORT       0x01   /* 11______ 0_______, 11______ 11______ */
+#define TOO_LONG        0x02   /* 0_______ 10______ */
+#define OVERLONG_3      0x04   /* 11100000 100_____ */
+#define TOO_LARGE       0x08   /* 11110100 1001____, 11110100 101_____ */
+#define SURROGATE       0x10   /* 11101101 101_____ */
+#define OVERLONG_2      0x20   /* 1100000_ 10______ */
+#define TOO_LARGE_1000  0x40   /* 11110101 1000____, 1111011_ 1000____ */
+#define OVERLONG_4      0x40   /* 11110000 1000____ */
+#define TWO_CONTS       0x80   /* 10______ 10______ */
+#define CARRY           (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+/* Error classes indexed by the high nibble of the first byte. */
+static const unsigned char byte_1_high[16] = {
+  TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,                 /* 0_______ */
+  TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+  TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,             /* 10______ */
+  TOO_SHORT | OVERLONG_2,                                 /* 1100____ */
+  TOO_SHORT,                                              /* 1101____ */
+  TOO_SHORT | OVERLONG_3 | SURROGATE,                     /* 1110____ */
+  TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4     /* 1111____ */
+};
+
+/* Error classes indexed by the low nibble of the first byte. */
+static const unsigned char byte_1_low[16] = {
+  CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,           /* ____0000 */
+  CARRY | OVERLONG_2,                                     /* ____0001 */
+  CARRY,                                                  /* ____001_ */
+  CARRY,
+  CARRY | TOO_LARGE,                                      /* ____0100 */
+  CARRY | TOO_LARGE | TOO_LARGE_1000,                     /* ____0101 */
+  CARRY | TOO_LARGE | TOO_LARGE_1000,                     /* ____011_ */
+  CARRY | TOO_LARGE | TOO_LARGE_1000,
+  CARRY | TOO_LARGE | TOO_LARGE_1000,                     /* ____1___ */
+  CARRY | TOO_LARGE | TOO_LARGE_1000,
+  CARRY | TOO_LARGE | TOO_LARGE_1000,
+  CARRY | TOO_LARGE | TOO_LARGE_1000,
+  CARRY | TOO_LARGE | TOO_LARGE_1000,
+  CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,         /* ____1101 */
+  CARRY | TOO_LARGE | TOO_LARGE_1000,
+  CARRY | TOO_LARGE | TOO_LARGE_1000
+};
+
+/* Error classes indexed by the high nibble of the second byte. */
+static const unsigned char byte_2_high[16] = {
+  TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,             /* 0_______ */
+  TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+  TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3          /* 1000____ */
+    | TOO_LARGE_1000 | OVERLONG_4,
+  TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3          /* 1001____ */
+    | TOO_LARGE,
+  TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE           /* 101_____ */
+    | TOO_LARGE,
+  TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE
+    | TOO_LARGE,
+  TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT              /* 11______ */
+};
+
+/* Per-byte upper limits for the last block not to end in an incomplete
+ * multi-byte sequence. */
+static const unsigned char max_complete[32] = {
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf
+};
+
+#endif
+
+#if defined(SVN__SIMD_X86)
+
+/* Return the number of bytes at the start of DATA of LEN bytes that are
+ * covered by complete 16 byte blocks in which no error has been found.
+ * The last of them may still end with an incomplete character. */
+SVN__TARGET("ssse3")
+static apr_size_t
+validate_ssse3(const char *data, apr_size_t len)
+{
+  const __m128i table_1_high = _mm_loadu_si128((const void *)byte_1_high);
+  const __m128i table_1_low = _mm_loadu_si128((const void *)byte_1_low);
+  const __m128i table_2_high = _mm_loadu_si128((const void *)byte_2_high);
+  const __m128i max_input = _mm_loadu_si128((const void *)(max_complete
+                                                           + 16));
+  const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i prev_input = zero;
+  __m128i prev_incomplete = zero;
+  apr_size_t pos;
+
+  for (pos = 0; pos + 16 <= len; pos += 16)
+    {
+      __m128i input = _mm_loadu_si128((const void *)(data + pos));
+      __m128i error;
+
+      if (_mm_movemask_epi8(input) == 0)
+        {
+          /* Pure ASCII.  Only the previous block may have been cut short. */
+          error = prev_incomplete;
+        }
+      else
+        {
+          __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+          __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+          __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+          __m128i special_cases, must_be_23;
+
+          special_cases
+            = _mm_and_si128(
+                _mm_and_si128(
+                  _mm_shuffle_epi8(table_1_high,
+                                   _mm_and_si128(_mm_srli_epi16(prev1, 4),
+                                                 nibble_mask)),
+                  _mm_shuffle_epi8(table_1_low,
+                                   _mm_and_si128(prev1, nibble_mask))),
+                _mm_shuffle_epi8(table_2_high,
+                                 _mm_and_si128(_mm_srli_epi16(input, 4),
+                                               nibble_mask)));
+
+          /* Bit 7 is set where the 3rd or 4th byte of a sequence must be. */
+          must_be_23
+            = _mm_or_si128(_mm_subs_epu8(prev2,
+                                         _mm_set1_epi8((char)(0xe0 - 0x80))),
+                           _mm_subs_epu8(prev3,
+                                         _mm_set1_epi8((char)(0xf0 - 0x80))));
+
+          error = _mm_xor_si128(_mm_and_si128(must_be_23,
+                                              _mm_set1_epi8((char)0x80)),
+                                special_cases);
+          prev_incomplete = _mm_subs_epu8(input, max_input);
+        }
+
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) != 0xffff)
+        break;
+
+      prev_input = input;
+    }
+
+  return pos;
+}
+
+/* Like validate_ssse3 but using AVX2 and 32 byte blocks. */
+SVN__TARGET("avx2")
+static apr_size_t
+validate_avx2(const char *data, apr_size_t len)
+{
+  const __m256i table_1_high
+    = _mm256_broadcastsi128_si256(_mm_loadu_si128((const void *)byte_1_high));
+  const __m256i table_1_low
+    = _mm256_broadcastsi128_si256(_mm_loadu_si128((const void *)byte_1_low));
+  const __m256i table_2_high
+    = _mm256_broadcastsi128_si256(_mm_loadu_si128((const void *)byte_2_high));
+  const __m256i max_input = _mm256_loadu_si256((const void *)max_complete);
+  const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+  __m256i prev_input = _mm256_setzero_si256();
+  __m256i prev_incomplete = _mm256_setzero_si256();
+  apr_size_t pos;
+
+  for (pos = 0; pos + 32 <= len; pos += 32)
+    {
+      __m256i input = _mm256_loadu_si256((const void *)(data + pos));
+      __m256i error;
+
+      if (_mm256_movemask_epi8(input) == 0)
+        {
+          /* Pure ASCII.  Only the previous block may have been cut short. */
+          error = prev_incomplete;
+        }
+      else
+        {
+          /* Bytes 16 .. 31 of PREV_INPUT followed by bytes 0 .. 15 of
+           * INPUT, i.e. what _mm256_alignr_epi8 needs for the low lane. */
+          __m256i shifted = _mm256_permute2x128_si256(prev_input, input,
+                                                      0x21);
+          __m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+          __m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+          __m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+          __m256i special_cases, must_be_23;
+
+          special_cases
+            = _mm256_and_si256(
+                _mm256_and_si256(
+                  _mm256_shuffle_epi8(table_1_high,
+                                      _mm256_and_si256(
+                                        _mm256_srli_epi16(prev1, 4),
+                                        nibble_mask)),
+                  _mm256_shuffle_epi8(table_1_low,
+                                      _mm256_and_si256(prev1,
+                                                       nibble_mask))),
+                _mm256_shuffle_epi8(table_2_high,
+                                    _mm256_and_si256(
+                                      _mm256_srli_epi16(input, 4),
+                                      nibble_mask)));
+
+          /* Bit 7 is set where the 3rd or 4th byte of a sequence must be. */
+          must_be_23
+            = _mm256_or_si256(
+                _mm256_subs_epu8(prev2,
+                                 _mm256_set1_epi8((char)(0xe0 - 0x80))),
+                _mm256_subs_epu8(prev3,
+                                 _mm256_set1_epi8((char)(0xf0 - 0x80))));
+
+          error = _mm256_xor_si256(
+                    _mm256_and_si256(must_be_23,
+                                     _mm256_set1_epi8((char)0x80)),
+                    special_cases);
+          prev_incomplete = _mm256_subs_epu8(input, max_input);
+        }
+
+      if (!_mm256_testz_si256(error, error))
+        break;
+
+      prev_input = input;
+    }
+
+  return pos;
+}
+
+#elif defined(SVN__SIMD_NEON)
+
+/* Like validate_ssse3 but using NEON. */
+static apr_size_t
+validate_neon(const char *data, apr_size_t len)
+{
+  const uint8x16_t table_1_high = vld1q_u8(byte_1_high);
+  const uint8x16_t table_1_low = vld1q_u8(byte_1_low);
+  const uint8x16_t table_2_high = vld1q_u8(byte_2_high);
+  const uint8x16_t max_input = vld1q_u8(max_complete + 16);
+  const uint8x16_t nibble_mask = vdupq_n_u8(0x0f);
+  uint8x16_t prev_input = vdupq_n_u8(0);
+  uint8x16_t prev_incomplete = vdupq_n_u8(0);
+  apr_size_t pos;
+
+  for (pos = 0; pos + 16 <= len; pos += 16)
+    {
+      uint8x16_t input = vld1q_u8((const unsigned char *)data + pos);
+      uint8x16_t error;
+
+      if (vmaxvq_u8(input) < 0x80)
+        {
+          /* Pure ASCII.  Only the previous block may have been cut short. */
+          error = prev_incomplete;
+        }
+      else
+        {
+          uint8x16_t prev1 = vextq_u8(prev_input, input, 15);
+          uint8x16_t prev2 = vextq_u8(prev_input, input, 14);
+          uint8x16_t prev3 = vextq_u8(prev_input, input, 13);
+          uint8x16_t special_cases, must_be_23;
+
+          special_cases
+            = vandq_u8(vandq_u8(vqtbl1q_u8(table_1_high,
+                                           vshrq_n_u8(prev1, 4)),
+                                vqtbl1q_u8(table_1_low,
+                                           vandq_u8(prev1, nibble_mask))),
+                       vqtbl1q_u8(table_2_high, vshrq_n_u8(input, 4)));
+
+          /* Bit 7 is set where the 3rd or 4th byte of a sequence must be. */
+          must_be_23 = vorrq_u8(vqsubq_u8(prev2, vdupq_n_u8(0xe0 - 0x80)),
+                                vqsubq_u8(prev3, vdupq_n_u8(0xf0 - 0x80)));
+
+          error = veorq_u8(vandq_u8(must_be_23, vdupq_n_u8(0x80)),
+                           special_cases);
+          prev_incomplete = vqsubq_u8(input, max_input);
+        }
+
+      if (vmaxvq_u8(error) != 0)
+        break;
+
+      prev_input = input;
+    }
+
+  return pos;
+}
+
+#endif
+
+/* Return the position in DATA of LEN bytes from which on the FSM must be
+ * run to complete the validation.  All data before that position is
+ * well-formed and the FSM will start in FSM_START.
+ */
+static const char *
+first_fsm_char(const char *data, apr_size_t len)
+{
+#if defined(SVN__SIMD_X86) || defined(SVN__SIMD_NEON)
+  apr_size_t pos;
+  int i;
+
+#if defined(SVN__SIMD_X86)
+  apr_uint32_t features = svn_cpu__features();
+  if (len >= 32 && (features & SVN_CPU__AVX2))
+    pos = validate_avx2(data, len);
+  else if (len >= 16 && (features & SVN_CPU__SSSE3))
+    pos = validate_ssse3(data, len);
+  else
+    return first_non_fsm_start_char(data, len);
+#else
+  if (len >= 16 && (svn_cpu__features() & SVN_CPU__NEON))
+    pos = validate_neon(data, len);
+  else
+    return first_non_fsm_start_char(data, len);
+#endif
+
+  /* The last character before POS may be incomplete or be the cause of
+   * an error in the next block.  Restart at its lead byte. */
+  for (i = 0; i < 3 && pos > 0; ++i, --pos)
+    if (((unsigned char)data[pos - 1] & 0xc0) != 0x80)
+      break;
+
+  if (pos > 0 && (unsigned char)data[pos - 1] >= 0xc0)
+    --pos;
+
+  return data + pos;
+#else
+  return first_non_fsm_start_char(data, len);
+#endif
+}
+
 const char *
 svn_utf__last_valid(const char *data, apr_size_t len)
 {
-  const char *start = first_non_fsm_start_char(data, len);
+  const char *start = first_fsm_char(data, len);
   const char *end = data + len;
   int state = FSM_START;
 
@@ -313,7 +656,7 @@ svn_utf__is_valid(const char *data, apr_size_t len)
   if (!data)
     return FALSE;
 
-  data = first_non_fsm_start_char(data, len);
+  data = first_fsm_char(data, len);
 
   while (data < end)
     {
@@ -38,6 +38,11 @@
 
 #include "svn_private_config.h"
 
+/* Maximum number of lines of each file to compare at once when merging
+   text files internally.  This bounds the memory used for merging very
+   large files to roughly 100 MB.  Smaller files are not affected. */
+#define MERGE_WINDOW_LINES (256 * 1024)
+
 /* Contains some information on the merge target before merge, and some
    information needed for the diff processing. */
 typedef struct merge_target_t
@@ -404,6 +409,7 @@ do_text_merge(svn_boolean_t *contains_conflicts,
   svn_diff_file_options_t *diff3_options;
 
   diff3_options = svn_diff_file_options_create(pool);
+  diff3_options->diff3_window_lines = MERGE_WINDOW_LINES;
 
   if (merge_options)
     SVN_ERR(svn_diff_file_options_parse(diff3_options,
@@ -42,6 +42,8 @@
 #include "svn_private_config.h"
 #include "private/svn_wc_private.h"
 #include "private/svn_sqlite.h"
+#include "private/svn_string_private.h"
+#include "private/svn_subr_private.h"
 #include "private/svn_token.h"
 
 /* WC-1.0 administrative area extensions */
@@ -999,6 +1001,165 @@ remove_suffix(const char *str, const char *suffix, apr_pool_t *result_pool)
   return NULL;
 }
 
+/* Text-bases of up to this many bytes get read into memory and their MD5
+   checksums get calculated in batches of up to SMALL_TEXT_BASE_BATCH by
+   svn_checksum__multi().  Working copies consist mostly of small files. */
+#define SMALL_TEXT_BASE_SIZE 0x4000
+#define SMALL_TEXT_BASE_BATCH 64
+
+/* Add the pristine text of SIZE bytes with the checksums SHA1_CHECKSUM and
+   MD5_CHECKSUM, that has been written to the temporary file TEMP_PATH, to
+   the pristine store of SDB which is located in directory
+   NEW_WCROOT_ABSPATH.  Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+install_text_base(const char *temp_path,
+                  const svn_checksum_t *sha1_checksum,
+                  const svn_checksum_t *md5_checksum,
+                  svn_filesize_t size,
+                  const char *new_wcroot_abspath,
+                  svn_sqlite__db_t *sdb,
+                  apr_pool_t *scratch_pool)
+{
+  const char *pristine_path;
+  svn_sqlite__stmt_t *stmt;
+
+  /* Insert a row into the pristine table. */
+  SVN_ERR(svn_sqlite__get_statement(&stmt, sdb,
+                                    STMT_INSERT_OR_IGNORE_PRISTINE));
+  SVN_ERR(svn_sqlite__bind_checksum(stmt, 1, sha1_checksum, scratch_pool));
+  SVN_ERR(svn_sqlite__bind_checksum(stmt, 2, md5_checksum, scratch_pool));
+  SVN_ERR(svn_sqlite__bind_int64(stmt, 3, size));
+  SVN_ERR(svn_sqlite__insert(NULL, stmt));
+
+  SVN_ERR(svn_wc__db_pristine_get_future_path(&pristine_path,
+                                              new_wcroot_abspath,
+                                              sha1_checksum,
+                                              scratch_pool, scratch_pool));
+
+  /* Ensure any sharding directories exist. */
+  SVN_ERR(svn_wc__ensure_directory(svn_dirent_dirname(pristine_path,
+                                                      scratch_pool),
+                                   scratch_pool));
+
+  /* Now move the file into the pristine store, overwriting
+     existing files with the same checksum. */
+  SVN_ERR(svn_io_file_move(temp_path, pristine_path, scratch_pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Add the checksums SHA1_CHECKSUM and MD5_CHECKSUM of the text-base file
+   TEXT_BASE_BASENAME to TEXT_BASES_INFO, allocating in RESULT_POOL. */
+static void
+add_text_base_info(apr_hash_t *text_bases_info,
+                   const char *text_base_basename,
+                   const svn_checksum_t *sha1_checksum,
+                   const svn_checksum_t *md5_checksum,
+                   apr_pool_t *result_pool)
+{
+  const char *versioned_file_name;
+  svn_boolean_t is_revert_base;
+  svn_wc__text_base_info_t *info;
+  svn_wc__text_base_file_info_t *file_info;
+
+  /* Determine the versioned file name and whether this is a normal base
+   * or a revert base. */
+  versioned_file_name = remove_suffix(text_base_basename,
+                                      SVN_WC__REVERT_EXT, result_pool);
+  if (versioned_file_name)
+    {
+      is_revert_base = TRUE;
+    }
+  else
+    {
+      versioned_file_name = remove_suffix(text_base_basename,
+                                          SVN_WC__BASE_EXT, result_pool);
+      is_revert_base = FALSE;
+    }
+
+  if (! versioned_file_name)
+    {
+       /* Some file that doesn't end with .svn-base or .svn-revert.
+          No idea why that would be in our administrative area, but
+          we shouldn't segfault on this case.
+
+          Note that we already copied this file in the pristine store,
+          but the next cleanup will take care of that.
+        */
+      return;
+    }
+
+  /* Create a new info struct for this versioned file, or fill in the
+   * existing one if this is the second text-base we've found for it. */
+  info = svn_hash_gets(text_bases_info, versioned_file_name);
+  if (info == NULL)
+    info = apr_pcalloc(result_pool, sizeof (*info));
+  file_info = (is_revert_base ? &info->revert_base : &info->normal_base);
+
+  file_info->sha1_checksum = svn_checksum_dup(sha1_checksum, result_pool);
+  file_info->md5_checksum = svn_checksum_dup(md5_checksum, result_pool);
+  svn_hash_sets(text_bases_info, versioned_file_name, info);
+}
+
+/* Copy the small text-bases named in BASENAMES, whose contents are given
+   as the svn_string_t * elements of CONTENTS, into the pristine store of
+   SDB which is located in directory NEW_WCROOT_ABSPATH and add their
+   checksums to TEXT_BASES_INFO, allocated in RESULT_POOL.
+
+   All MD5 checksums are calculated in one go. */
+static svn_error_t *
+migrate_small_text_bases(apr_hash_t *text_bases_info,
+                         const apr_array_header_t *basenames,
+                         const apr_array_header_t *contents,
+                         const char *new_wcroot_abspath,
+                         svn_sqlite__db_t *sdb,
+                         apr_pool_t *result_pool,
+                         apr_pool_t *scratch_pool)
+{
+  apr_array_header_t *md5_checksums;
+  apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  int i;
+
+  SVN_ERR(svn_checksum__multi(&md5_checksums, svn_checksum_md5, contents,
+                              scratch_pool, scratch_pool));
+
+  for (i = 0; i < contents->nelts; ++i)
+    {
+      const char *text_base_basename = APR_ARRAY_IDX(basenames, i,
+                                                     const char *);
+      const svn_string_t *text = APR_ARRAY_IDX(contents, i,
+                                               const svn_string_t *);
+      const svn_checksum_t *md5_checksum = APR_ARRAY_IDX(md5_checksums, i,
+                                                         svn_checksum_t *);
+      svn_checksum_t *sha1_checksum;
+      const char *temp_path;
+      svn_stream_t *result_stream;
+      apr_size_t len = text->len;
+
+      svn_pool_clear(iterpool);
+
+      SVN_ERR(svn_checksum(&sha1_checksum, svn_checksum_sha1, text->data,
+                           text->len, iterpool));
+
+      SVN_ERR(svn_stream_open_unique(&result_stream, &temp_path,
+                                     new_wcroot_abspath,
+                                     svn_io_file_del_none,
+                                     iterpool, iterpool));
+      SVN_ERR(svn_stream_write(result_stream, text->data, &len));
+      SVN_ERR(svn_stream_close(result_stream));
+
+      SVN_ERR(install_text_base(temp_path, sha1_checksum, md5_checksum,
+                                text->len, new_wcroot_abspath, sdb,
+                                iterpool));
+      add_text_base_info(text_bases_info, text_base_basename,
+                         sha1_checksum, md5_checksum, result_pool);
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
 /* Copy all the text-base files from the administrative area of WC directory
    DIR_ABSPATH into the pristine store of SDB which is located in directory
    NEW_WCROOT_ABSPATH.
@@ -1016,6 +1177,13 @@ migrate_text_bases(apr_hash_t **text_bases_info,
 {
   apr_hash_t *dirents;
   apr_pool_t *iterpool = svn_pool_create(scratch_pool);
+  apr_pool_t *batch_pool = svn_pool_create(scratch_pool);
+  apr_array_header_t *basenames
+    = apr_array_make(scratch_pool, SMALL_TEXT_BASE_BATCH,
+                     sizeof(const char *));
+  apr_array_header_t *contents
+    = apr_array_make(scratch_pool, SMALL_TEXT_BASE_BATCH,
+                     sizeof(svn_string_t *));
   apr_hash_index_t *hi;
   const char *text_base_dir = svn_wc__adm_child(dir_abspath,
                                                 TEXT_BASE_SUBDIR,
@@ -1024,30 +1192,54 @@ migrate_text_bases(apr_hash_t **text_bases_info,
   *text_bases_info = apr_hash_make(result_pool);
 
   /* Iterate over the text-base files */
-  SVN_ERR(svn_io_get_dirents3(&dirents, text_base_dir, TRUE,
+  SVN_ERR(svn_io_get_dirents3(&dirents, text_base_dir, FALSE,
                               scratch_pool, scratch_pool));
   for (hi = apr_hash_first(scratch_pool, dirents); hi;
        hi = apr_hash_next(hi))
     {
       const char *text_base_basename = apr_hash_this_key(hi);
+      const svn_io_dirent2_t *dirent = apr_hash_this_val(hi);
+      const char *text_base_path;
       svn_checksum_t *md5_checksum;
       svn_checksum_t *sha1_checksum;
 
       svn_pool_clear(iterpool);
 
+      text_base_path = svn_dirent_join(text_base_dir, text_base_basename,
+                                       iterpool);
+
+      /* Collect small text-bases and copy them in batches. */
+      if (dirent->kind == svn_node_file
+          && dirent->filesize <= SMALL_TEXT_BASE_SIZE)
+        {
+          svn_stringbuf_t *text;
+
+          SVN_ERR(svn_stringbuf_from_file2(&text, text_base_path,
+                                           batch_pool));
+          APR_ARRAY_PUSH(basenames, const char *) = text_base_basename;
+          APR_ARRAY_PUSH(contents, svn_string_t *)
+            = svn_stringbuf__morph_into_string(text);
+
+          if (contents->nelts == SMALL_TEXT_BASE_BATCH)
+            {
+              SVN_ERR(migrate_small_text_bases(*text_bases_info, basenames,
+                                               contents, new_wcroot_abspath,
+                                               sdb, result_pool, iterpool));
+              apr_array_clear(basenames);
+              apr_array_clear(contents);
+              svn_pool_clear(batch_pool);
+            }
+
+          continue;
+        }
+
       /* Calculate its checksums and copy it to the pristine store */
       {
-        const char *pristine_path;
-        const char *text_base_path;
         const char *temp_path;
-        svn_sqlite__stmt_t *stmt;
         apr_finfo_t finfo;
         svn_stream_t *read_stream;
         svn_stream_t *result_stream;
 
-        text_base_path = svn_dirent_join(text_base_dir, text_base_basename,
-                                         iterpool);
-
         /* Create a copy and calculate a checksum in one step */
         SVN_ERR(svn_stream_open_unique(&result_stream, &temp_path,
                                        new_wcroot_abspath,
@@ -1071,76 +1263,22 @@ migrate_text_bases(apr_hash_t **text_bases_info,
 
         SVN_ERR(svn_io_stat(&finfo, text_base_path, APR_FINFO_SIZE, iterpool));
 
-        /* Insert a row into the pristine table. */
-        SVN_ERR(svn_sqlite__get_statement(&stmt, sdb,
-                                          STMT_INSERT_OR_IGNORE_PRISTINE));
-        SVN_ERR(svn_sqlite__bind_checksum(stmt, 1, sha1_checksum, iterpool));
-        SVN_ERR(svn_sqlite__bind_checksum(stmt, 2, md5_checksum, iterpool));
-        SVN_ERR(svn_sqlite__bind_int64(stmt, 3, finfo.size));
-        SVN_ERR(svn_sqlite__insert(NULL, stmt));
-
-        SVN_ERR(svn_wc__db_pristine_get_future_path(&pristine_path,
-                                                    new_wcroot_abspath,
-                                                    sha1_checksum,
-                                                    iterpool, iterpool));
-
-        /* Ensure any sharding directories exist. */
-        SVN_ERR(svn_wc__ensure_directory(svn_dirent_dirname(pristine_path,
-                                                            iterpool),
-                                         iterpool));
-
-        /* Now move the file into the pristine store, overwriting
-           existing files with the same checksum. */
-        SVN_ERR(svn_io_file_move(temp_path, pristine_path, iterpool));
+        SVN_ERR(install_text_base(temp_path, sha1_checksum, md5_checksum,
+                                  finfo.size, new_wcroot_abspath, sdb,
+                                  iterpool));
       }
 
       /* Add the checksums for this text-base to *TEXT_BASES_INFO. */
-      {
-        const char *versioned_file_name;
-        svn_boolean_t is_revert_base;
-        svn_wc__text_base_info_t *info;
-        svn_wc__text_base_file_info_t *file_info;
-
-        /* Determine the versioned file name and whether this is a normal base
-         * or a revert base. */
-        versioned_file_name = remove_suffix(text_base_basename,
-                                            SVN_WC__REVERT_EXT, result_pool);
-        if (versioned_file_name)
-          {
-            is_revert_base = TRUE;
-          }
-        else
-          {
-            versioned_file_name = remove_suffix(text_base_basename,
-                                                SVN_WC__BASE_EXT, result_pool);
-            is_revert_base = FALSE;
-          }
-
-        if (! versioned_file_name)
-          {
-             /* Some file that doesn't end with .svn-base or .svn-revert.
-                No idea why that would be in our administrative area, but
-                we shouldn't segfault on this case.
-
-                Note that we already copied this file in the pristine store,
-                but the next cleanup will take care of that.
-              */
-            continue;
-          }
-
-        /* Create a new info struct for this versioned file, or fill in the
-         * existing one if this is the second text-base we've found for it. */
-        info = svn_hash_gets(*text_bases_info, versioned_file_name);
-        if (info == NULL)
-          info = apr_pcalloc(result_pool, sizeof (*info));
-        file_info = (is_revert_base ? &info->revert_base : &info->normal_base);
-
-        file_info->sha1_checksum = svn_checksum_dup(sha1_checksum, result_pool);
-        file_info->md5_checksum = svn_checksum_dup(md5_checksum, result_pool);
-        svn_hash_sets(*text_bases_info, versioned_file_name, info);
-      }
+      add_text_base_info(*text_bases_info, text_base_basename,
+                         sha1_checksum, md5_checksum, result_pool);
     }
 
+  if (contents->nelts)
+    SVN_ERR(migrate_small_text_bases(*text_bases_info, basenames, contents,
+                                     new_wcroot_abspath, sdb, result_pool,
+                                     iterpool));
+
+  svn_pool_destroy(batch_pool);
   svn_pool_destroy(iterpool);
 
   return SVN_NO_ERROR;
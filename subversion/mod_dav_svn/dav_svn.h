@@ -275,6 +275,9 @@ struct dav_resource_private {
   /* SVNDIFF version we can transmit to the client.  */
   int svndiff_version;
 
+  /* Whether the client accepts SVNDIFF data with large windows.  */
+  svn_boolean_t svndiff_large_windows;
+
   /* the value of any SVN_DAV_OPTIONS_HEADER that came in the request */
   const char *svn_client_options;
 
@@ -29,12 +29,14 @@
 
 #include <httpd.h>
 #include <http_config.h>
+#include <http_core.h>
 #include <http_request.h>
 #include <http_log.h>
 #include <ap_provider.h>
 #include <mod_dav.h>
 
 #include "svn_hash.h"
+#include "svn_pools.h"
 #include "svn_version.h"
 #include "svn_cache_config.h"
 #include "svn_utf.h"
@@ -120,6 +122,61 @@ extern module AP_MODULE_DECLARE_DATA dav_svn_module;
 /* The authz_svn provider for bypassing path authz. */
 static authz_svn__subreq_bypass_func_t pathauthz_bypass_func = NULL;
 
+/* Set by SVNInMemoryCacheShared.  We apply it only after all directives
+   have been read because it causes the cache to be created immediately. */
+static svn_boolean_t cache_shared_memory = FALSE;
+
+/* Set by SVNInMemoryCacheSnapshot.  NULL if not configured. */
+static const char *cache_snapshot_path = NULL;
+
+/* Pool cleanup function saving the cache contents to DATA, the snapshot
+   file path.  Registered with the configuration pool, i.e. it runs in
+   the parent process whenever httpd shuts down or restarts. */
+static apr_status_t
+save_cache_snapshot(void *data)
+{
+  const char *path = data;
+  apr_pool_t *pool = svn_pool_create(NULL);
+  apr_status_t status = APR_SUCCESS;
+  svn_error_t *serr = svn_cache_config_save_snapshot(path, pool);
+
+  if (serr)
+    {
+      ap_log_error(APLOG_MARK, APLOG_WARNING, serr->apr_err, NULL,
+                   "mod_dav_svn: error saving the cache snapshot '%s': '%s'",
+                   path, serr->message ? serr->message : "(no more info)");
+      status = serr->apr_err;
+      svn_error_clear(serr);
+    }
+
+  svn_pool_destroy(pool);
+  return status;
+}
+
+/* Return TRUE if httpd runs the post_config hooks only to check the
+   configuration.  It will then clear the configuration pool and read the
+   configuration again before it starts serving requests. */
+static svn_boolean_t
+is_pre_config_pass(server_rec *s)
+{
+#ifdef AP_SQ_MAIN_STATE
+  return ap_state_query(AP_SQ_MAIN_STATE) == AP_SQ_MS_CREATE_PRE_CONFIG;
+#else
+  /* Older httpd versions don't tell us.  But the process pool survives
+     the first pass, so we can remember that we have seen it. */
+  const char *key = "mod_dav_svn-pre-config-pass";
+  void *data = NULL;
+
+  apr_pool_userdata_get(&data, key, s->process->pool);
+  if (data)
+    return FALSE;
+
+  apr_pool_userdata_set((const void *)1, key, apr_pool_cleanup_null,
+                        s->process->pool);
+  return TRUE;
+#endif
+}
+
 static int
 init(apr_pool_t *p, apr_pool_t *plog, apr_pool_t *ptemp, server_rec *s)
 {
@@ -150,6 +207,39 @@ init(apr_pool_t *p, apr_pool_t *plog, apr_pool_t *ptemp, server_rec *s)
   conf = ap_get_module_config(s->module_config, &dav_svn_module);
   svn_utf_initialize2(conf->use_utf8, p);
 
+  /* A shared cache must be created here, i.e. in the parent process,
+     before the worker processes get forked. */
+  if (cache_shared_memory)
+    {
+      svn_cache_config2_t settings = *svn_cache_config_get2();
+      settings.shared_memory = TRUE;
+      svn_cache_config_set2(&settings);
+    }
+
+  /* Only a shared cache gets filled by the workers and is visible here,
+     where we save it. */
+  if (cache_snapshot_path && !cache_shared_memory)
+    {
+      ap_log_perror(APLOG_MARK, APLOG_WARNING, 0, p,
+                    "mod_dav_svn: SVNInMemoryCacheSnapshot requires "
+                    "SVNInMemoryCacheShared; ignoring it");
+    }
+  else if (cache_snapshot_path && !is_pre_config_pass(s))
+    {
+      /* During the first pass, the cleanup would run before we even
+         started and replace the snapshot with an empty one. */
+      serr = svn_cache_config_load_snapshot(cache_snapshot_path, ptemp);
+      if (serr && !APR_STATUS_IS_ENOENT(serr->apr_err))
+        ap_log_perror(APLOG_MARK, APLOG_WARNING, serr->apr_err, p,
+                      "mod_dav_svn: error loading the cache snapshot "
+                      "'%s': '%s'", cache_snapshot_path,
+                      serr->message ? serr->message : "(no more info)");
+      svn_error_clear(serr);
+
+      apr_pool_cleanup_register(p, cache_snapshot_path, save_cache_snapshot,
+                                apr_pool_cleanup_null);
+    }
+
   return OK;
 }
 
@@ -624,6 +714,24 @@ SVNInMemoryCacheSize_cmd(cmd_parms *cmd, void *config, const char *arg1)
   return NULL;
 }
 
+static const char *
+SVNInMemoryCacheShared_cmd(cmd_parms *cmd, void *config, int arg)
+{
+  cache_shared_memory = arg ? TRUE : FALSE;
+
+  return NULL;
+}
+
+static const char *
+SVNInMemoryCacheSnapshot_cmd(cmd_parms *cmd, void *config, const char *arg1)
+{
+  cache_snapshot_path = svn_dirent_internal_style(
+                          ap_server_root_relative(cmd->pool, arg1),
+                          cmd->pool);
+
+  return NULL;
+}
+
 static const char *
 SVNCompressionLevel_cmd(cmd_parms *cmd, void *config, const char *arg1)
 {
@@ -1388,6 +1496,20 @@ static const command_rec cmds[] =
                 "specifies the maximum size in kB per process of Subversion's "
                 "in-memory object cache (default value is 16384; 0 switches "
                 "to dynamically sized caches)."),
+
+  /* per server */
+  AP_INIT_FLAG("SVNInMemoryCacheShared", SVNInMemoryCacheShared_cmd, NULL,
+               RSRC_CONF,
+               "enables sharing Subversion's in-memory object cache among "
+               "all httpd processes forked by the same parent instead of "
+               "using one per process (default is Off)."),
+
+  /* per server */
+  AP_INIT_TAKE1("SVNInMemoryCacheSnapshot", SVNInMemoryCacheSnapshot_cmd,
+                NULL, RSRC_CONF,
+                "specifies a file to save Subversion's in-memory object "
+                "cache to when httpd stops and to load it from when httpd "
+                "starts.  Requires SVNInMemoryCacheShared."),
   /* per server */
   AP_INIT_TAKE1("SVNCompressionLevel", SVNCompressionLevel_cmd, NULL,
                 RSRC_CONF,
@@ -40,6 +40,7 @@
 #include "svn_dav.h"
 #include "svn_props.h"
 
+#include "private/svn_delta_private.h"
 #include "private/svn_log.h"
 #include "private/svn_fspath.h"
 
@@ -89,6 +90,9 @@ typedef struct update_ctx_t {
   /* SVNDIFF version to send to client.  */
   int svndiff_version;
 
+  /* Whether the client accepts SVNDIFF data with large windows.  */
+  svn_boolean_t svndiff_large_windows;
+
   /* Compression level of SVNDIFF deltas. */
   int compression_level;
 
@@ -828,9 +832,14 @@ upd_apply_textdelta(void *file_baton,
                                                      wb->uc->output,
                                                      file->pool);
 
-  svn_txdelta_to_svndiff3(&(wb->handler), &(wb->handler_baton),
-                          base64_stream, file->uc->svndiff_version,
-                          file->uc->compression_level, file->pool);
+  if (file->uc->svndiff_large_windows)
+    svn_txdelta__to_svndiff_large(&(wb->handler), &(wb->handler_baton),
+                                  base64_stream, file->uc->svndiff_version,
+                                  file->uc->compression_level, file->pool);
+  else
+    svn_txdelta_to_svndiff3(&(wb->handler), &(wb->handler_baton),
+                            base64_stream, file->uc->svndiff_version,
+                            file->uc->compression_level, file->pool);
 
   *handler = window_handler;
   *handler_baton = wb;
@@ -1197,6 +1206,7 @@ dav_svn__update_report(const dav_resource *resource,
     }
 
   uc.svndiff_version = resource->info->svndiff_version;
+  uc.svndiff_large_windows = resource->info->svndiff_large_windows;
   uc.compression_level = dav_svn__get_compression_level(resource->info->r);
   uc.resource = resource;
   uc.output = output;
@@ -53,6 +53,7 @@
 #include "mod_dav_svn.h"
 #include "svn_ra.h"  /* for SVN_RA_CAPABILITY_* */
 #include "svn_dirent_uri.h"
+#include "private/svn_delta_private.h"
 #include "private/svn_log.h"
 #include "private/svn_fspath.h"
 #include "private/svn_repos_private.h"
@@ -1752,9 +1753,12 @@ static int get_svndiff_version(const struct accept_rec *rec)
 }
 
 /* Parse and handle any possible Accept-Encoding header that has been
-   sent as part of the request.  */
+   sent as part of the request.  Set *SVNDIFF_LARGE_WINDOWS to whether
+   the client accepts svndiff data with large windows.  */
 static void
-negotiate_encoding_prefs(request_rec *r, int *svndiff_version)
+negotiate_encoding_prefs(request_rec *r,
+                         int *svndiff_version,
+                         svn_boolean_t *svndiff_large_windows)
 {
   /* It would be nice if mod_negotiation
      <http://httpd.apache.org/docs-2.1/mod/mod_negotiation.html> could
@@ -1767,6 +1771,7 @@ negotiate_encoding_prefs(request_rec *r, int *svndiff_version)
   apr_array_header_t *svndiff_encodings;
   svn_boolean_t accepts_svndiff2 = FALSE;
 
+  *svndiff_large_windows = FALSE;
   encoding_prefs = do_header_line(r->pool,
                                   apr_table_get(r->headers_in,
                                                 "Accept-Encoding"));
@@ -1789,6 +1794,9 @@ negotiate_encoding_prefs(request_rec *r, int *svndiff_version)
 
       if (version == 2)
         accepts_svndiff2 = TRUE;
+
+      if (strcmp(rec->name, SVN_DAV_SVNDIFF_LARGE_WINDOWS) == 0)
+        *svndiff_large_windows = TRUE;
     }
 
   if (dav_svn__get_compression_level(r) == 0)
@@ -2267,7 +2275,8 @@ get_resource(request_rec *r,
       && strcmp(ct, SVN_SVNDIFF_MIME_TYPE) == 0;
   }
 
-  negotiate_encoding_prefs(r, &comb->priv.svndiff_version);
+  negotiate_encoding_prefs(r, &comb->priv.svndiff_version,
+                           &comb->priv.svndiff_large_windows);
 
   /* ### and another hack for computing diffs to send to the client */
   comb->priv.delta_base = apr_table_get(r->headers_in,
@@ -3780,6 +3789,8 @@ deliver(const dav_resource *resource, ap_filter_t *unused)
       svn_txdelta_window_handler_t handler;
       void * h_baton;
       diff_ctx_t dc = { 0 };
+      int compression_level =
+        dav_svn__get_compression_level(resource->info->r);
 
       /* First order of business is to parse it. */
       serr = dav_svn__simple_parse_uri(&info, resource,
@@ -3836,10 +3847,14 @@ deliver(const dav_resource *resource, ap_filter_t *unused)
           svn_stream_set_close(o_stream, close_filter);
 
           /* get a handler/baton for writing into the output stream */
-          svn_txdelta_to_svndiff3(&handler, &h_baton,
-                                  o_stream, resource->info->svndiff_version,
-                                  dav_svn__get_compression_level(resource->info->r),
-                                  resource->pool);
+          if (resource->info->svndiff_large_windows)
+            svn_txdelta__to_svndiff_large(&handler, &h_baton, o_stream,
+                                          resource->info->svndiff_version,
+                                          compression_level, resource->pool);
+          else
+            svn_txdelta_to_svndiff3(&handler, &h_baton, o_stream,
+                                    resource->info->svndiff_version,
+                                    compression_level, resource->pool);
 
           /* got everything set up. read in delta windows and shove them into
              the handler, which pushes data into the output stream, which goes
@@ -70,6 +70,7 @@
 int dav_svn__status(request_rec *r)
 {
   svn_cache__info_t *info;
+  svn_membuffer_t *membuffer;
   svn_string_t *text_stats;
   apr_array_header_t *lines;
   int i;
@@ -113,7 +114,46 @@ int dav_svn__status(request_rec *r)
       ap_rvputs(r, "<dt>", line, "</dt>\n", SVN_VA_NULL);
     }
 
-  ap_rvputs(r, "</dl></body></html>\n", SVN_VA_NULL);
+  ap_rvputs(r, "</dl>\n", SVN_VA_NULL);
+
+  /* Break the numbers down by cache, i.e. by key prefix. */
+  membuffer = svn_cache__get_global_membuffer_cache();
+  if (membuffer)
+    {
+      svn_error_t *serr;
+      apr_array_header_t *infos;
+
+      serr = svn_cache__membuffer_get_prefix_info(&infos, membuffer, FALSE,
+                                                  r->pool);
+      if (serr)
+        {
+          infos = apr_array_make(r->pool, 0,
+                                 sizeof(svn_cache__prefix_info_t *));
+          svn_error_clear(serr);
+        }
+
+      ap_rvputs(r, "<h2>Statistics per Cache Prefix</h2>\n", SVN_VA_NULL);
+      for (i = 0; i < infos->nelts; ++i)
+        {
+          const svn_cache__prefix_info_t *prefix_info
+            = APR_ARRAY_IDX(infos, i, const svn_cache__prefix_info_t *);
+          int k;
+
+          text_stats = svn_cache__format_prefix_info(prefix_info, r->pool);
+          lines = svn_cstring_split(text_stats->data, "\n", FALSE, r->pool);
+
+          ap_rvputs(r, "<dl>\n", SVN_VA_NULL);
+          for (k = 0; k < lines->nelts; ++k)
+            {
+              const char *line = APR_ARRAY_IDX(lines, k, const char *);
+              ap_rvputs(r, "<dt>", ap_escape_html(r->pool, line), "</dt>\n",
+                        SVN_VA_NULL);
+            }
+          ap_rvputs(r, "</dl>\n", SVN_VA_NULL);
+        }
+    }
+
+  ap_rvputs(r, "</body></html>\n", SVN_VA_NULL);
 
   return 0;
 }
@@ -38,6 +38,10 @@
 
 #include "svn_private_config.h"
 
+/* Number of worker threads used to split and hash the lines of large
+   files before comparing them. */
+#define BLAME_DIFF_THREADS 4
+
 typedef struct blame_baton_t
 {
   svn_cl__opt_state_t *opt_state;
@@ -300,6 +304,7 @@ svn_cl__blame(apr_getopt_t *os,
 
   subpool = svn_pool_create(pool);
 
+  diff_options->max_threads = BLAME_DIFF_THREADS;
   if (opt_state->extensions)
     {
       apr_array_header_t *opts;
@@ -225,7 +225,9 @@ const apr_getopt_option_t svn_cl__options[] =
                        "                             "
                        "  -U ARG, --context ARG: Show ARG lines of context\n"
                        "                             "
-                       "  -p, --show-c-function: Show C function name")},
+                       "  -p, --show-c-function: Show C function name\n"
+                       "                             "
+                       "  --histogram: Use the histogram diff algorithm")},
   {"targets",       opt_targets, 1,
                     N_("pass contents of file ARG as additional args")},
   {"depth",         opt_depth, 1,
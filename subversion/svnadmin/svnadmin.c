@@ -49,6 +49,7 @@
 #include "private/svn_subr_private.h"
 #include "private/svn_cmdline_private.h"
 #include "private/svn_fspath.h"
+#include "private/svn_cache.h"
 
 #include "svn_private_config.h"
 
@@ -60,6 +61,10 @@
  * The current threshold is 64MB. */
 #define BLOCK_READ_CACHE_THRESHOLD (0x40 * 0x100000)
 
+/* Upper limit for --jobs.  Every job is a separate thread with its own
+ * filesystem instance. */
+#define MAX_JOBS 64
+
 static svn_cancel_func_t check_cancel = NULL;
 
 /* Custom filesystem warning function. */
@@ -152,10 +157,12 @@ enum svnadmin__cmdline_options_t
     svnadmin__check_normalization,
     svnadmin__metadata_only,
     svnadmin__no_flush_to_disk,
+    svnadmin__cache_stats,
     svnadmin__normalize_props,
     svnadmin__exclude,
     svnadmin__include,
-    svnadmin__glob
+    svnadmin__glob,
+    svnadmin__jobs
   };
 
 /* Option codes and descriptions.
@@ -257,6 +264,15 @@ static const apr_getopt_option_t options_table[] =
         "                             minimize redundant operations. Default: 16.\n"
         "                             [used for FSFS repositories only]")},
 
+    {"jobs",                  svnadmin__jobs, 1,
+     N_("verify up to ARG revisions and shards in parallel\n"
+        "                             (uses threads; default: 1, maximum: 64)\n"
+        "                             [used for FSFS repositories only]")},
+
+    {"cache-stats",           svnadmin__cache_stats, 0,
+     N_("print in-memory cache statistics per cache to\n"
+        "                             stderr when done")},
+
     {"compatible-version",     svnadmin__compatible_version, 1,
      N_("use repository format compatible with Subversion\n"
         "                             version ARG (\"1.5.5\", \"1.7\", etc.)")},
@@ -349,7 +365,7 @@ static const svn_opt_subcommand_desc3_t cmd_table[] =
     "delta from the preceding revision.  If no revisions are specified,\n"
     "this will simply deltify the HEAD revision.\n"
    )},
-   {'r', 'q', 'M'} },
+   {'r', 'q', 'M', svnadmin__cache_stats} },
 
   {"dump", subcommand_dump, {0}, {N_(
     "usage: svnadmin dump REPOS_PATH [-r LOWER[:UPPER] [--incremental]]\n"
@@ -369,7 +385,8 @@ static const svn_opt_subcommand_desc3_t cmd_table[] =
     "excluded, the copy is transformed into an add (unlike in 'svndumpfilter').\n"
    )},
   {'r', svnadmin__incremental, svnadmin__deltas, 'q', 'M', 'F',
-   svnadmin__exclude, svnadmin__include, svnadmin__glob },
+   svnadmin__exclude, svnadmin__include, svnadmin__glob,
+   svnadmin__cache_stats },
   {{'F', N_("write to file ARG instead of stdout")}} },
 
   {"dump-revprops", subcommand_dump_revprops, {0}, {N_(
@@ -456,7 +473,7 @@ static const svn_opt_subcommand_desc3_t cmd_table[] =
     svnadmin__use_pre_commit_hook, svnadmin__use_post_commit_hook,
     svnadmin__parent_dir, svnadmin__normalize_props,
     svnadmin__bypass_prop_validation, 'M',
-    svnadmin__no_flush_to_disk, 'F'},
+    svnadmin__no_flush_to_disk, 'F', svnadmin__cache_stats},
    {{'F', N_("read from file ARG instead of stdin")}} },
 
   {"load-revprops", subcommand_load_revprops, {0}, {N_(
@@ -506,7 +523,7 @@ static const svn_opt_subcommand_desc3_t cmd_table[] =
     "Possibly compact the repository into a more efficient storage model.\n"
     "This may not apply to all repositories, in which case, exit.\n"
    )},
-   {'q', 'M'} },
+   {'q', 'M', svnadmin__cache_stats} },
 
   {"recover", subcommand_recover, {0}, {N_(
     "usage: svnadmin recover REPOS_PATH\n"
@@ -605,7 +622,8 @@ static const svn_opt_subcommand_desc3_t cmd_table[] =
     "Verify the data stored in the repository.\n"
    )},
    {'t', 'r', 'q', svnadmin__keep_going, 'M',
-    svnadmin__check_normalization, svnadmin__metadata_only} },
+    svnadmin__check_normalization, svnadmin__metadata_only,
+    svnadmin__cache_stats, svnadmin__jobs} },
 
   { NULL, NULL, {0}, {NULL}, {0} }
 };
@@ -639,10 +657,12 @@ struct svnadmin_opt_state
   svn_boolean_t bypass_prop_validation;             /* --bypass-prop-validation */
   svn_boolean_t ignore_dates;                       /* --ignore-dates */
   svn_boolean_t no_flush_to_disk;                   /* --no-flush-to-disk */
+  svn_boolean_t cache_stats;                        /* --cache-stats */
   svn_boolean_t normalize_props;                    /* --normalize_props */
   enum svn_repos_load_uuid uuid_action;             /* --ignore-uuid,
                                                        --force-uuid */
   apr_uint64_t memory_cache_size;                   /* --memory-cache-size M */
+  int jobs;                                         /* --jobs */
   const char *parent_dir;                           /* --parent-dir */
   const char *file;                                 /* --file */
   apr_array_header_t *exclude;                      /* --exclude */
@@ -990,7 +1010,7 @@ struct repos_verify_callback_baton
 };
 
 /* Implementation of svn_repos_verify_callback_t to handle errors coming
-   from svn_repos_verify_fs3(). */
+   from svn_repos_verify_fs4(). */
 static svn_error_t *
 repos_verify_callback(void *baton,
                       svn_revnum_t revision,
@@ -2247,9 +2267,10 @@ subcommand_verify(apr_getopt_t *os, void *baton, apr_pool_t *pool)
     apr_array_make(pool, 0, sizeof(struct verification_error *));
   verify_baton.result_pool = pool;
 
-  SVN_ERR(svn_repos_verify_fs3(repos, lower, upper,
+  SVN_ERR(svn_repos_verify_fs4(repos, lower, upper,
                                opt_state->check_normalization,
                                opt_state->metadata_only,
+                               opt_state->jobs,
                                !opt_state->quiet
                                  ? repos_notify_handler : NULL,
                                feedback_stream,
@@ -2846,6 +2867,33 @@ subcommand_delrevprop(apr_getopt_t *os, void *baton, apr_pool_t *pool)
 }
 
 
+/* Print the per-prefix statistics of the global membuffer cache to stderr.
+ * Use SCRATCH_POOL for temporary allocations. */
+static svn_error_t *
+print_cache_stats(apr_pool_t *scratch_pool)
+{
+  svn_membuffer_t *membuffer = svn_cache__get_global_membuffer_cache();
+  apr_array_header_t *infos;
+  int i;
+
+  if (membuffer == NULL)
+    return SVN_NO_ERROR;
+
+  SVN_ERR(svn_cache__membuffer_get_prefix_info(&infos, membuffer, FALSE,
+                                               scratch_pool));
+  for (i = 0; i < infos->nelts; ++i)
+    {
+      const svn_cache__prefix_info_t *info
+        = APR_ARRAY_IDX(infos, i, const svn_cache__prefix_info_t *);
+      svn_string_t *text = svn_cache__format_prefix_info(info, scratch_pool);
+
+      SVN_ERR(svn_cmdline_fputs(text->data, stderr, scratch_pool));
+    }
+
+  return SVN_NO_ERROR;
+}
+
+
 
 /** Main. **/
 
@@ -2887,6 +2935,7 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
   opt_state.start_revision.kind = svn_opt_revision_unspecified;
   opt_state.end_revision.kind = svn_opt_revision_unspecified;
   opt_state.memory_cache_size = svn_cache_config_get()->cache_size;
+  opt_state.jobs = 1;
 
   /* Parse options. */
   SVN_ERR(svn_cmdline__getopt_init(&os, argc, argv, pool));
@@ -3081,6 +3130,18 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
       case svnadmin__no_flush_to_disk:
         opt_state.no_flush_to_disk = TRUE;
         break;
+      case svnadmin__cache_stats:
+        opt_state.cache_stats = TRUE;
+        break;
+      case svnadmin__jobs:
+        SVN_ERR(svn_cstring_atoi(&opt_state.jobs, opt_arg));
+        if (opt_state.jobs < 1)
+          return svn_error_create(SVN_ERR_CL_ARG_PARSING_ERROR, NULL,
+                                  _("--jobs requires a positive number"));
+        if (opt_state.jobs > MAX_JOBS)
+          return svn_error_createf(SVN_ERR_CL_ARG_PARSING_ERROR, NULL,
+                                   _("--jobs must not exceed %d"), MAX_JOBS);
+        break;
       case svnadmin__normalize_props:
         opt_state.normalize_props = TRUE;
         break;
@@ -3228,13 +3289,17 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
     svn_cache_config_t settings = *svn_cache_config_get();
 
     settings.cache_size = opt_state.memory_cache_size;
-    settings.single_threaded = TRUE;
+    /* Worker threads for --jobs share the caches. */
+    settings.single_threaded = opt_state.jobs <= 1;
 
     svn_cache_config_set(&settings);
   }
 
   /* Run the subcommand. */
   err = (*subcommand->cmd_func)(os, &opt_state, pool);
+  if (opt_state.cache_stats)
+    err = svn_error_compose_create(err, print_cache_stats(pool));
+
   if (err)
     {
       /* For argument-related problems, suggest using the 'help'
@@ -483,6 +483,28 @@ print_stats(svn_fs_fs__stats_t *stats,
   print_histograms_by_extension(stats, pool);
 }
 
+/* Print the read-ahead statistics of FS, if it gave read-ahead hints.
+ * Use POOL for temporary allocations.
+ */
+static void
+print_prefetch_stats(svn_fs_t *fs,
+                     apr_pool_t *pool)
+{
+  svn_fs_fs__prefetch_stats_t stats;
+  svn_fs_fs__get_prefetch_stats(&stats, fs);
+
+  if (stats.requests == 0 && stats.hits == 0 && stats.misses == 0)
+    return;
+
+  printf("\nRead-ahead statistics:\n");
+  printf(_("%20s read-ahead requests\n"
+           "%20s blocks read after a read-ahead request (hits)\n"
+           "%20s blocks read without a read-ahead request (misses)\n"),
+         svn__ui64toa_sep(stats.requests, ',', pool),
+         svn__ui64toa_sep(stats.hits, ',', pool),
+         svn__ui64toa_sep(stats.misses, ',', pool));
+}
+
 /* Our progress function simply prints the REVISION number and makes it
  * appear immediately.
  */
@@ -509,6 +531,7 @@ subcommand__stats(apr_getopt_t *os, void *baton, apr_pool_t *pool)
                                check_cancel, NULL, pool, pool));
 
   print_stats(stats, pool);
+  print_prefetch_stats(fs, pool);
 
   return SVN_NO_ERROR;
 }
@@ -55,6 +55,7 @@
 #include "private/svn_dep_compat.h"
 #include "private/svn_cmdline_private.h"
 #include "private/svn_atomic.h"
+#include "private/svn_cache.h"
 #include "private/svn_mutex.h"
 #include "private/svn_subr_private.h"
 
@@ -222,6 +223,9 @@ void winservice_notify_stop(void)
 #define SVNSERVE_OPT_MAX_REQUEST     274
 #define SVNSERVE_OPT_MAX_RESPONSE    275
 #define SVNSERVE_OPT_CACHE_NODEPROPS 276
+#define SVNSERVE_OPT_MEMORY_CACHE_SHARED 277
+#define SVNSERVE_OPT_MEMORY_CACHE_SNAPSHOT 278
+#define SVNSERVE_OPT_LOG_CACHE_STATS 279
 
 /* Text macro because we can't use #ifdef sections inside a N_("...")
    macro expansion. */
@@ -297,6 +301,36 @@ static const apr_getopt_option_t svnserve__options[] =
         "0 switches to dynamically sized caches.\n"
         "                             "
         "[used for FSFS and FSX repositories only]")},
+    {"memory-cache-shared", SVNSERVE_OPT_MEMORY_CACHE_SHARED, 1,
+     N_("enable or disable sharing the in-memory cache\n"
+        "                             "
+        "among all server processes.\n"
+        "                             "
+        "Default is no.\n"
+        "                             "
+        "[mode: daemon; ignored with --threads]")},
+    {"memory-cache-snapshot", SVNSERVE_OPT_MEMORY_CACHE_SNAPSHOT, 1,
+     N_("load the in-memory cache contents from file ARG\n"
+        "                             "
+        "at startup and save them there upon SIGTERM or\n"
+        "                             "
+        "SIGINT.  Cached data is only reused for\n"
+        "                             "
+        "repositories that did not change in between.\n"
+        "                             "
+        "Requires --memory-cache-shared in fork mode.\n"
+        "                             "
+        "[mode: daemon]")},
+    {"log-cache-stats", SVNSERVE_OPT_LOG_CACHE_STATS, 0,
+     N_("write in-memory cache statistics per cache to\n"
+        "                             "
+        "the log upon SIGUSR1 and when shutting down.\n"
+        "                             "
+        "In fork mode, every connection process writes\n"
+        "                             "
+        "its statistics when it is done.\n"
+        "                             "
+        "[mode: daemon, listen-once]")},
     {"cache-txdeltas", SVNSERVE_OPT_CACHE_TXDELTAS, 1,
      N_("enable or disable caching of deltas between older\n"
         "                             "
@@ -492,6 +526,57 @@ static void sigchld_handler(int signo)
 }
 #endif
 
+/* Set by sigterm_handler() to make the main loop exit gracefully. */
+static volatile sig_atomic_t shutdown_requested = FALSE;
+
+/* Only installed when we need to save the cache before exiting. */
+static void sigterm_handler(int signo)
+{
+  /* The accept() gets interrupted, so the main loop will notice. */
+  shutdown_requested = TRUE;
+}
+
+/* Set by sigusr1_handler() to make the main loop log the cache stats. */
+static volatile sig_atomic_t cache_stats_requested = FALSE;
+
+#ifdef SIGUSR1
+static void sigusr1_handler(int signo)
+{
+  /* The accept() gets interrupted, so the main loop will notice. */
+  cache_stats_requested = TRUE;
+}
+#endif
+
+/* Write the per-prefix statistics of the global membuffer cache to
+ * LOGGER.  Use SCRATCH_POOL for temporary allocations.
+ */
+static void
+log_cache_stats(logger_t *logger,
+                apr_pool_t *scratch_pool)
+{
+  svn_membuffer_t *membuffer = svn_cache__get_global_membuffer_cache();
+  apr_array_header_t *infos;
+  svn_error_t *err;
+  int i;
+
+  if (membuffer == NULL)
+    return;
+
+  err = svn_cache__membuffer_get_prefix_info(&infos, membuffer, FALSE,
+                                             scratch_pool);
+  for (i = 0; !err && i < infos->nelts; ++i)
+    {
+      const svn_cache__prefix_info_t *info
+        = APR_ARRAY_IDX(infos, i, const svn_cache__prefix_info_t *);
+      svn_string_t *text = svn_cache__format_prefix_info(info, scratch_pool);
+
+      err = logger__write(logger, text->data, text->len);
+    }
+
+  logger__log_error(logger, err, NULL, NULL);
+  svn_error_clear(err);
+}
+
 /* Redirect stdout to stderr.  ARG is the pool.
  *
  * In tunnel or inetd mode, we don't want hook scripts corrupting the
@@ -515,7 +600,8 @@ static apr_status_t redirect_stdout(void *arg)
 
 /* Wait for the next client connection to come in from SOCK.  Allocate
  * the connection in a root pool from CONNECTION_POOLS and assign PARAMS.
- * Return the connection object in *CONNECTION.
+ * Return the connection object in *CONNECTION.  Set it to NULL if we
+ * were asked to shut down instead.
  *
  * Use HANDLING_MODE for proper internal cleanup.
  */
@@ -545,6 +631,22 @@ accept_connection(connection_t **connection,
         exit(0);
       #endif
 
+      if (shutdown_requested)
+        {
+          svn_pool_destroy(connection_pool);
+          *connection = NULL;
+          return SVN_NO_ERROR;
+        }
+
+      if (cache_stats_requested)
+        {
+          apr_pool_t *scratch_pool = svn_pool_create(pool);
+
+          cache_stats_requested = FALSE;
+          log_cache_stats(params->logger, scratch_pool);
+          svn_pool_destroy(scratch_pool);
+        }
+
       status = apr_socket_accept(&(*connection)->usock, sock,
                                  connection_pool);
       if (handling_mode == connection_mode_fork)
@@ -725,6 +827,9 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
   svn_boolean_t cache_txdeltas = TRUE;
   svn_boolean_t cache_revprops = FALSE;
   svn_boolean_t use_block_read = FALSE;
+  svn_boolean_t memory_cache_shared = FALSE;
+  const char *memory_cache_snapshot = NULL;
+  svn_boolean_t log_stats = FALSE;
   apr_uint16_t port = SVN_RA_SVN_PORT;
   const char *host = NULL;
   int family = APR_INET;
@@ -909,6 +1014,23 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
           }
           break;
 
+        case SVNSERVE_OPT_MEMORY_CACHE_SHARED:
+          memory_cache_shared
+            = svn_tristate__from_word(arg) == svn_tristate_true;
+          break;
+
+        case SVNSERVE_OPT_LOG_CACHE_STATS:
+          log_stats = TRUE;
+          break;
+
+        case SVNSERVE_OPT_MEMORY_CACHE_SNAPSHOT:
+          SVN_ERR(svn_utf_cstring_to_utf8(&memory_cache_snapshot, arg, pool));
+          memory_cache_snapshot = svn_dirent_internal_style(
+                                      memory_cache_snapshot, pool);
+          SVN_ERR(svn_dirent_get_absolute(&memory_cache_snapshot,
+                                          memory_cache_snapshot, pool));
+          break;
+
         case SVNSERVE_OPT_CACHE_TXDELTAS:
           cache_txdeltas = svn_tristate__from_word(arg) == svn_tristate_true;
           break;
@@ -1079,6 +1201,31 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
                _("Option --tunnel-user is only valid in tunnel mode"));
     }
 
+  if (memory_cache_snapshot && run_mode != run_mode_daemon)
+    {
+      return svn_error_create(SVN_ERR_CL_ARG_PARSING_ERROR, NULL,
+               _("Option --memory-cache-snapshot is only valid in daemon "
+                 "mode"));
+    }
+
+  if (   log_stats
+      && (   (run_mode != run_mode_daemon && run_mode != run_mode_listen_once)
+          || params.logger == NULL))
+    {
+      return svn_error_create(SVN_ERR_CL_ARG_PARSING_ERROR, NULL,
+               _("Option --log-cache-stats is only valid in listen-once "
+                 "mode and in daemon mode with --log-file"));
+    }
+
+  /* Forked connection handlers would fill their private caches only. */
+  if (   memory_cache_snapshot && !memory_cache_shared
+      && handling_mode == connection_mode_fork)
+    {
+      return svn_error_create(SVN_ERR_CL_ARG_PARSING_ERROR, NULL,
+               _("Option --memory-cache-snapshot requires "
+                 "--memory-cache-shared in fork mode"));
+    }
+
   if (run_mode == run_mode_inetd || run_mode == run_mode_tunnel)
     {
       apr_pool_t *connection_pool;
@@ -1274,7 +1421,7 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
    * keep the per-process caches smaller than the default.
    * Also, apply the respective command line parameters, if given. */
   {
-    svn_cache_config_t settings = *svn_cache_config_get();
+    svn_cache_config2_t settings = *svn_cache_config_get2();
 
     if (params.memory_cache_size != -1)
       settings.cache_size = params.memory_cache_size;
@@ -1294,9 +1441,38 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
 #endif
       }
 
-    svn_cache_config_set(&settings);
+    /* Only forked connection handlers can share their parent's cache.
+     * Setting this will create the cache right away, i.e. before we fork.
+     */
+    settings.shared_memory = memory_cache_shared
+                          && handling_mode == connection_mode_fork
+                          && run_mode == run_mode_daemon;
+
+    svn_cache_config_set2(&settings);
   }
 
+  /* Pick up the cache contents from our last run.  A broken snapshot
+   * must not prevent us from serving requests. */
+  if (memory_cache_snapshot)
+    {
+      err = svn_cache_config_load_snapshot(memory_cache_snapshot, pool);
+      if (err && !APR_STATUS_IS_ENOENT(err->apr_err))
+        logger__log_error(params.logger, err, NULL, NULL);
+      svn_error_clear(err);
+    }
+
+  /* Shut down gracefully if we have something to save or report. */
+  if (memory_cache_snapshot || log_stats)
+    {
+      apr_signal(SIGTERM, sigterm_handler);
+      apr_signal(SIGINT, sigterm_handler);
+    }
+
+#ifdef SIGUSR1
+  if (log_stats)
+    apr_signal(SIGUSR1, sigusr1_handler);
+#endif
+
 #if APR_HAS_THREADS
   SVN_ERR(svn_root_pools__create(&connection_pools));
 
@@ -1335,9 +1511,15 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
       connection_t *connection = NULL;
       SVN_ERR(accept_connection(&connection, sock, &params, handling_mode,
                                 pool));
+      if (connection == NULL)
+        break;
+
       if (run_mode == run_mode_listen_once)
         {
           err = serve_socket(connection, connection->pool);
+          if (log_stats)
+            log_cache_stats(params.logger, connection->pool);
+
           close_connection(connection);
           return err;
         }
@@ -1352,8 +1534,20 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
               /* the child would't listen to the main server's socket */
               apr_socket_close(sock);
 
+              /* Only the main process saves the cache snapshot. */
+              if (memory_cache_snapshot || log_stats)
+                {
+                  apr_signal(SIGTERM, SIG_DFL);
+                  apr_signal(SIGINT, SIG_DFL);
+                }
+
               /* serve_socket() logs any error it returns, so ignore it. */
               svn_error_clear(serve_socket(connection, connection->pool));
+
+              /* Our access statistics die with this process. */
+              if (log_stats)
+                log_cache_stats(params.logger, connection->pool);
+
               close_connection(connection);
               return SVN_NO_ERROR;
             }
@@ -1391,7 +1585,23 @@ sub_main(int *exit_code, int argc, const char *argv[], apr_pool_t *pool)
       close_connection(connection);
     }
 
-  /* NOTREACHED */
+  /* We have been asked to shut down.  Threads that are still serving
+   * requests may add more data but that is not a problem for the
+   * snapshot. */
+  apr_socket_close(sock);
+  if (log_stats)
+    log_cache_stats(params.logger, pool);
+
+  if (memory_cache_snapshot)
+    {
+      err = svn_cache_config_save_snapshot(memory_cache_snapshot, pool);
+      if (err)
+        logger__log_error(params.logger, err, NULL, NULL);
+
+      return svn_error_trace(err);
+    }
+
+  return SVN_NO_ERROR;
 }
 
 int
@@ -3826,6 +3826,66 @@ def load_issue4725(sbox):
   sbox2.build(create_wc=False, empty=True)
   load_and_verify_dumpstream(sbox2, None, [], None, False, dump, '-M100')
 
+@SkipUnless(svntest.main.is_fs_type_fsfs)
+def verify_jobs(sbox):
+  "svnadmin verify --jobs"
+
+  # No support for modifying pack files
+  if svntest.main.options.fsfs_packing:
+    raise svntest.Skip('fsfs packing set')
+
+  # Configure two revisions per shard, such that the metadata check runs
+  # on many shards.  With 2 jobs, the workers may run 8 revisions or
+  # shards ahead, so 20 revisions make the result window wrap around.
+  sbox.build(create_wc=False, empty=True)
+  patch_format(sbox.repo_dir, shard_size=2)
+  for i in range(1, 21):
+    svntest.actions.run_and_verify_svn(None, [],
+                                       'mkdir', '-m', 'log_msg',
+                                       sbox.repo_url + '/dir%d' % i)
+
+  # The output of a parallel verification must be the same as that of
+  # a sequential one, both for a healthy and for a corrupt repository.
+  def verify_both(*varargs):
+    exit_code, output, errput = svntest.main.run_svnadmin("verify",
+                                                          sbox.repo_dir,
+                                                          *varargs)
+    exit_code2, output2, errput2 = svntest.main.run_svnadmin("verify",
+                                                             "--jobs", "2",
+                                                             sbox.repo_dir,
+                                                             *varargs)
+    svntest.verify.compare_and_display_lines(
+      "Standard output", "STDOUT:", output, output2)
+    svntest.verify.compare_and_display_lines(
+      "Standard error output", "STDERR:", errput, errput2)
+    if exit_code != exit_code2:
+      raise svntest.Failure("Exit codes differ: %d vs. %d"
+                            % (exit_code, exit_code2))
+
+  verify_both()
+
+  # Corrupt revisions in an early and in a late shard.
+  for rev in [5, 17]:
+    path = os.path.join(sbox.repo_dir, 'db', 'revs', str(rev // 2), str(rev))
+    fp = open(path, 'r+b')
+    fp.write(b"inserting junk to corrupt the rev")
+    fp.close()
+
+  verify_both()
+  verify_both("--keep-going")
+  verify_both("--keep-going", "--quiet")
+
+  # Invalid job counts are rejected.
+  svntest.actions.run_and_verify_svnadmin(None, ".*--jobs.*",
+                                          "verify", "--jobs", "0",
+                                          sbox.repo_dir)
+  svntest.actions.run_and_verify_svnadmin(None, ".*--jobs.*",
+                                          "verify", "--jobs", "100000",
+                                          sbox.repo_dir)
+
+  # Don't leave a corrupt repository
+  svntest.main.safe_rmtree(sbox.repo_dir, True)
+
 ########################################################################
 # Run the tests
 
@@ -3900,6 +3960,7 @@ test_list = [ None,
               dump_exclude_all_rev_changes,
               dump_invalid_filtering_option,
               load_issue4725,
+              verify_jobs,
              ]
 
 if __name__ == '__main__':
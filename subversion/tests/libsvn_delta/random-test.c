@@ -37,6 +37,7 @@
 #include "svn_pools.h"
 #include "svn_error.h"
 
+#include "private/svn_delta_private.h"
 #include "../../libsvn_delta/delta.h"
 #include "delta-window-test.h"
 
@@ -47,6 +48,7 @@
 #define DEFAULT_PRINT_WINDOWS 0
 #define SEEDS 50
 #define MAXSEQ 100
+#define MAX_CHAIN_LENGTH 20
 
 
 /* Initialize parameters for the random tests. */
@@ -515,6 +517,123 @@ random_combine_test(apr_pool_t *pool)
 }
 
 
+/* Return a single delta window that turns SOURCE into TARGET,
+   allocated in POOL. */
+static svn_txdelta_window_t *
+make_window(const svn_stringbuf_t *source,
+            const svn_stringbuf_t *target,
+            apr_pool_t *pool)
+{
+  svn_txdelta__ops_baton_t build_baton = { 0 };
+  svn_stringbuf_t *data = svn_stringbuf_dup(source, pool);
+  svn_txdelta_window_t *window;
+
+  svn_stringbuf_appendstr(data, target);
+  build_baton.new_data = svn_stringbuf_create_empty(pool);
+  if (source->len == 0)
+    svn_txdelta__insert_op(&build_baton, svn_txdelta_new, 0, target->len,
+                           target->data, pool);
+  else
+    svn_txdelta__xdelta(&build_baton, data->data, source->len, target->len,
+                        pool);
+
+  window = svn_txdelta__make_window(&build_baton, pool);
+  window->sview_len = source->len;
+  window->tview_len = target->len;
+
+  return window;
+}
+
+/* (Note: *LAST_SEED is an output parameter.) */
+static svn_error_t *
+do_random_chain_test(apr_pool_t *pool,
+                     apr_uint32_t *last_seed)
+{
+  apr_uint32_t seed, maxlen;
+  apr_size_t bytes_range;
+  int i, iterations, dump_files, print_windows;
+  const char *random_bytes;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+
+  /* Initialize parameters and print out the seed in case we dump core
+     or something. */
+  init_params(&seed, &maxlen, &iterations, &dump_files, &print_windows,
+              &random_bytes, &bytes_range, pool);
+
+  for (i = 0; i < iterations; i++)
+    {
+      apr_uint32_t subseed_base;
+      svn_stringbuf_t *versions[MAX_CHAIN_LENGTH + 1];
+      const svn_txdelta_window_t *windows[MAX_CHAIN_LENGTH];
+      svn_txdelta_window_t *composite, *pairwise;
+      svn_stringbuf_t *result;
+      int count, k;
+
+      svn_pool_clear(iterpool);
+
+      /* Generate a chain of similar versions and deltas between them. */
+      subseed_base = svn_test_rand((*last_seed = seed, &seed));
+      count = 1 + svn_test_rand(&seed) % MAX_CHAIN_LENGTH;
+      for (k = 0; k <= count; ++k)
+        {
+          apr_file_t *file = generate_random_file(maxlen, subseed_base,
+                                                  &seed, random_bytes,
+                                                  bytes_range, dump_files,
+                                                  iterpool);
+          SVN_ERR(svn_stringbuf_from_aprfile(&versions[k], file, iterpool));
+          apr_file_close(file);
+
+          if (k > 0)
+            windows[k - 1] = make_window(versions[k - 1], versions[k],
+                                         iterpool);
+        }
+
+      /* Compose the whole chain at once and pairwise, newest first. */
+      composite = svn_txdelta__compose_chain(windows, count, iterpool);
+      pairwise = svn_txdelta_window_dup(windows[count - 1], iterpool);
+      for (k = count - 2; k >= 0; --k)
+        pairwise = svn_txdelta_compose_windows(windows[k], pairwise,
+                                               iterpool);
+
+      if (print_windows)
+        {
+          delta_window_print(composite, "chain", stdout);
+          delta_window_print(pairwise, "pairs", stdout);
+        }
+
+      SVN_TEST_ASSERT(composite->sview_len == versions[0]->len);
+      SVN_TEST_ASSERT(composite->tview_len == versions[count]->len);
+
+      /* Both must reproduce the newest version from the oldest one. */
+      result = svn_stringbuf_create_ensure(composite->tview_len, iterpool);
+      result->len = composite->tview_len;
+      svn_txdelta_apply_instructions(composite, versions[0]->data,
+                                     result->data, &result->len);
+      SVN_TEST_ASSERT(svn_stringbuf_compare(result, versions[count]));
+
+      result->len = pairwise->tview_len;
+      svn_txdelta_apply_instructions(pairwise, versions[0]->data,
+                                     result->data, &result->len);
+      SVN_TEST_ASSERT(svn_stringbuf_compare(result, versions[count]));
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_test_driver_t. */
+static svn_error_t *
+random_chain_test(apr_pool_t *pool)
+{
+  apr_uint32_t seed;
+  svn_error_t *err = do_random_chain_test(pool, &seed);
+  if (err)
+    fprintf(stderr, "SEED: %lu\n", (unsigned long)seed);
+  return err;
+}
+
+
 /* (Note: *LAST_SEED is an output parameter.) */
 static svn_error_t *
 do_random_txdelta_to_svndiff_stream_test(apr_pool_t *pool,
@@ -625,6 +744,8 @@ static struct svn_test_descriptor_t test_funcs[] =
                    "random combine delta test"),
     SVN_TEST_PASS2(random_txdelta_to_svndiff_stream_test,
                    "random txdelta to svndiff stream test"),
+    SVN_TEST_PASS2(random_chain_test,
+                   "random delta chain composition test"),
 #ifdef SVN_RANGE_INDEX_TEST_H
     SVN_TEST_PASS2(random_range_index_test,
                    "random range index test"),
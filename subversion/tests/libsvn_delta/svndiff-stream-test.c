@@ -22,6 +22,7 @@
  */
 
 #include "svn_delta.h"
+#include "private/svn_delta_private.h"
 #include "../svn_test.h"
 
 static svn_error_t *
@@ -66,6 +67,255 @@ test_txdelta_to_svndiff_stream_small_reads(apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+/* Set *SVNDIFF to the svndiff representation of the delta between SOURCE
+ * and TARGET in the given SVNDIFF_VERSION, encoded by up to MAX_THREADS
+ * threads.  Use POOL for all allocations. */
+static svn_error_t *
+encode_svndiff(svn_stringbuf_t **svndiff,
+               const svn_string_t *source,
+               const svn_string_t *target,
+               int svndiff_version,
+               int max_threads,
+               apr_pool_t *pool)
+{
+  svn_txdelta_stream_t *txstream;
+  svn_txdelta_window_handler_t handler;
+  void *handler_baton;
+
+  *svndiff = svn_stringbuf_create_empty(pool);
+  svn_txdelta2(&txstream, svn_stream_from_string(source, pool),
+               svn_stream_from_string(target, pool), FALSE, pool);
+  SVN_ERR(svn_txdelta__to_svndiff_parallel(&handler, &handler_baton,
+                                           svn_stream_from_stringbuf(*svndiff,
+                                                                     pool),
+                                           svndiff_version,
+                                           SVN_DELTA_COMPRESSION_LEVEL_DEFAULT,
+                                           max_threads, pool));
+
+  return svn_error_trace(svn_txdelta_send_txstream(txstream, handler,
+                                                   handler_baton, pool));
+}
+
+static svn_error_t *
+test_txdelta_to_svndiff_parallel(apr_pool_t *pool)
+{
+  svn_stringbuf_t *source = svn_stringbuf_create_empty(pool);
+  svn_stringbuf_t *target = svn_stringbuf_create_empty(pool);
+  const svn_string_t *source_str, *target_str;
+  apr_uint32_t seed = 0;
+  int i, version;
+
+  /* Create almost 1MB of compressible data spanning many delta windows,
+   * with every 100th line changed in the target. */
+  for (i = 0; i < 40000; ++i)
+    {
+      const char *line = apr_psprintf(pool, "line %d: %08x\n", i,
+                                      svn_test_rand(&seed) & 0xf0f0f0f0);
+      svn_stringbuf_appendcstr(source, line);
+      svn_stringbuf_appendcstr(target, i % 100 ? line : "changed\n");
+    }
+
+  source_str = svn_string_create_from_buf(source, pool);
+  target_str = svn_string_create_from_buf(target, pool);
+
+  for (version = 0; version <= 2; ++version)
+    {
+      svn_stringbuf_t *expected, *actual;
+
+      SVN_ERR(encode_svndiff(&expected, source_str, target_str, version, 1,
+                             pool));
+      SVN_ERR(encode_svndiff(&actual, source_str, target_str, version, 4,
+                             pool));
+
+      /* The parallel encoder must produce exactly the same output. */
+      SVN_TEST_ASSERT(expected->len > 8);
+      SVN_TEST_ASSERT(svn_stringbuf_compare(expected, actual));
+    }
+
+  return SVN_NO_ERROR;
+}
+
+/* Baton for count_window_handler(). */
+typedef struct count_baton_t
+{
+  svn_txdelta_window_handler_t handler;
+  void *handler_baton;
+  int count;
+} count_baton_t;
+
+/* Implements svn_txdelta_window_handler_t.  Count the windows and pass
+ * them on to the handler in the count_baton_t BATON. */
+static svn_error_t *
+count_window_handler(svn_txdelta_window_t *window,
+                     void *baton)
+{
+  count_baton_t *b = baton;
+
+  if (window)
+    ++b->count;
+
+  return svn_error_trace(b->handler(window, b->handler_baton));
+}
+
+/* Set *TARGET to the result of applying SVNDIFF to SOURCE and
+ * *WINDOW_COUNT to the number of windows in SVNDIFF.  Use POOL for all
+ * allocations. */
+static svn_error_t *
+apply_svndiff(svn_stringbuf_t **target,
+              int *window_count,
+              const svn_stringbuf_t *svndiff,
+              const svn_string_t *source,
+              apr_pool_t *pool)
+{
+  count_baton_t b = { 0 };
+  svn_stream_t *stream;
+  apr_size_t len = svndiff->len;
+
+  *target = svn_stringbuf_create_empty(pool);
+  svn_txdelta_apply(svn_stream_from_string(source, pool),
+                    svn_stream_from_stringbuf(*target, pool),
+                    NULL, NULL, pool, &b.handler, &b.handler_baton);
+
+  stream = svn_txdelta_parse_svndiff(count_window_handler, &b, TRUE, pool);
+  SVN_ERR(svn_stream_write(stream, svndiff->data, &len));
+  SVN_ERR(svn_stream_close(stream));
+
+  *window_count = b.count;
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_txdelta_to_svndiff_large(apr_pool_t *pool)
+{
+  svn_stringbuf_t *source = svn_stringbuf_create_empty(pool);
+  svn_stringbuf_t *target = svn_stringbuf_create_empty(pool);
+  const svn_string_t *source_str, *target_str;
+  apr_uint32_t seed = 0;
+  int i, version;
+
+  /* Create about 4MB of data with every 100th line changed and some
+   * lines inserted in the target, so that windows use all kinds of ops. */
+  for (i = 0; i < 200000; ++i)
+    {
+      const char *line = apr_psprintf(pool, "line %d: %08x\n", i,
+                                      svn_test_rand(&seed));
+      svn_stringbuf_appendcstr(source, line);
+      svn_stringbuf_appendcstr(target, i % 100 ? line : "changed\n");
+      if (i % 1000 == 0)
+        svn_stringbuf_appendcstr(target, "inserted\ninserted\n");
+    }
+
+  source_str = svn_string_create_from_buf(source, pool);
+  target_str = svn_string_create_from_buf(target, pool);
+
+  for (version = 0; version <= 2; ++version)
+    {
+      svn_stringbuf_t *standard, *large, *pulled, *result;
+      svn_txdelta_stream_t *txstream;
+      svn_txdelta_window_handler_t handler;
+      void *handler_baton;
+      int standard_count, large_count;
+
+      SVN_ERR(encode_svndiff(&standard, source_str, target_str, version, 1,
+                             pool));
+
+      large = svn_stringbuf_create_empty(pool);
+      svn_txdelta2(&txstream, svn_stream_from_string(source_str, pool),
+                   svn_stream_from_string(target_str, pool), FALSE, pool);
+      svn_txdelta__to_svndiff_large(&handler, &handler_baton,
+                                    svn_stream_from_stringbuf(large, pool),
+                                    version,
+                                    SVN_DELTA_COMPRESSION_LEVEL_DEFAULT,
+                                    pool);
+      SVN_ERR(svn_txdelta_send_txstream(txstream, handler, handler_baton,
+                                        pool));
+      SVN_TEST_INT_ASSERT(large->data[3], version | 0x10);
+
+      /* The pull-style encoder produces the same output. */
+      pulled = svn_stringbuf_create_empty(pool);
+      svn_txdelta2(&txstream, svn_stream_from_string(source_str, pool),
+                   svn_stream_from_string(target_str, pool), FALSE, pool);
+      SVN_ERR(svn_stream_copy3(
+                svn_txdelta__to_svndiff_stream_large(
+                  txstream, version, SVN_DELTA_COMPRESSION_LEVEL_DEFAULT,
+                  pool),
+                svn_stream_from_stringbuf(pulled, pool),
+                NULL, NULL, pool));
+      SVN_TEST_ASSERT(svn_stringbuf_compare(large, pulled));
+
+      /* Both deltas reproduce the target but the large windows variant
+       * needs much fewer windows. */
+      SVN_ERR(apply_svndiff(&result, &standard_count, standard, source_str,
+                            pool));
+      SVN_TEST_STRING_ASSERT(result->data, target_str->data);
+      SVN_ERR(apply_svndiff(&result, &large_count, large, source_str,
+                            pool));
+      SVN_TEST_STRING_ASSERT(result->data, target_str->data);
+      SVN_TEST_ASSERT(large_count * 8 <= standard_count);
+    }
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_txdelta_to_svndiff_adaptive(apr_pool_t *pool)
+{
+  svn_stringbuf_t *text = svn_stringbuf_create_empty(pool);
+  svn_stringbuf_t *binary = svn_stringbuf_create_empty(pool);
+  svn_stringbuf_t *random = svn_stringbuf_create_empty(pool);
+  const svn_string_t *source = svn_string_create_empty(pool);
+  const svn_stringbuf_t *targets[4];
+  const int expected_versions[4] = { 1, 2, 0, 2 };
+  apr_uint32_t seed = 0;
+  int i;
+
+  for (i = 0; i < 20000; ++i)
+    {
+      apr_uint32_t value = svn_test_rand(&seed);
+
+      svn_stringbuf_appendcstr(text, apr_psprintf(pool, "line %d: %08x\n",
+                                                  i, value & 0xf0f0f0f0));
+      svn_stringbuf_appendbytes(binary, (const char *)&i, sizeof(i));
+      svn_stringbuf_appendbytes(binary, "\0\0\0\0", 4);
+      svn_stringbuf_appendbytes(random, (const char *)&value, sizeof(value));
+    }
+
+  targets[0] = text;
+  targets[1] = binary;
+  targets[2] = random;
+  targets[3] = svn_stringbuf_create_empty(pool);
+
+  for (i = 0; i < 4; ++i)
+    {
+      svn_stringbuf_t *svndiff = svn_stringbuf_create_empty(pool);
+      svn_stringbuf_t *result;
+      svn_txdelta_stream_t *txstream;
+      svn_txdelta_window_handler_t handler;
+      void *handler_baton;
+      int window_count;
+
+      svn_txdelta2(&txstream, svn_stream_from_string(source, pool),
+                   svn_stream_from_stringbuf(
+                     svn_stringbuf_dup(targets[i], pool), pool),
+                   FALSE, pool);
+      svn_txdelta__to_svndiff_adaptive(&handler, &handler_baton,
+                                       svn_stream_from_stringbuf(svndiff,
+                                                                 pool),
+                                       SVN_DELTA_COMPRESSION_LEVEL_DEFAULT,
+                                       2, pool);
+      SVN_ERR(svn_txdelta_send_txstream(txstream, handler, handler_baton,
+                                        pool));
+
+      /* The format depends on the contents but any svndiff reader can
+       * handle the result. */
+      SVN_TEST_INT_ASSERT(svndiff->data[3], expected_versions[i]);
+      SVN_ERR(apply_svndiff(&result, &window_count, svndiff, source, pool));
+      SVN_TEST_ASSERT(svn_stringbuf_compare(result, targets[i]));
+    }
+
+  return SVN_NO_ERROR;
+}
+
 static int max_threads = -1;
 
 static struct svn_test_descriptor_t test_funcs[] =
@@ -73,6 +323,12 @@ static struct svn_test_descriptor_t test_funcs[] =
   SVN_TEST_NULL,
   SVN_TEST_PASS2(test_txdelta_to_svndiff_stream_small_reads,
                  "test svn_txdelta_to_svndiff_stream() small reads"),
+  SVN_TEST_PASS2(test_txdelta_to_svndiff_parallel,
+                 "test the parallel svndiff encoder"),
+  SVN_TEST_PASS2(test_txdelta_to_svndiff_large,
+                 "test svndiff encoding with large windows"),
+  SVN_TEST_PASS2(test_txdelta_to_svndiff_adaptive,
+                 "test svndiff format selection by content"),
   SVN_TEST_NULL
 };
 
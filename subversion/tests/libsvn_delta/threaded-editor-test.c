@@ -0,0 +1,426 @@
+/*
+ * threaded-editor-test.c:  test the threaded delta editor
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#include "svn_delta.h"
+#include "svn_pools.h"
+#include "private/svn_delta_private.h"
+#include "../svn_test.h"
+
+/* Edit baton of the recording editor. */
+typedef struct record_baton_t
+{
+  /* Log of all calls received, one per line. */
+  svn_stringbuf_t *log;
+
+  /* If set, fail when closing the file with this path. */
+  const char *fail_path;
+
+  /* Set when abort_edit has been called. */
+  svn_boolean_t aborted;
+} record_baton_t;
+
+/* Directory and file baton of the recording editor. */
+typedef struct node_baton_t
+{
+  record_baton_t *rb;
+  const char *path;
+
+  /* Text received through apply_textdelta. */
+  svn_stringbuf_t *contents;
+} node_baton_t;
+
+static node_baton_t *
+make_node(record_baton_t *rb,
+          const char *path,
+          apr_pool_t *pool)
+{
+  node_baton_t *nb = apr_pcalloc(pool, sizeof(*nb));
+  nb->rb = rb;
+  nb->path = path;
+  nb->contents = svn_stringbuf_create_empty(pool);
+
+  return nb;
+}
+
+static svn_error_t *
+record_open_root(void *edit_baton,
+                 svn_revnum_t base_revision,
+                 apr_pool_t *pool,
+                 void **root_baton)
+{
+  record_baton_t *rb = edit_baton;
+
+  svn_stringbuf_appendcstr(rb->log, "open_root\n");
+  *root_baton = make_node(rb, "", pool);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+record_delete_entry(const char *path,
+                    svn_revnum_t revision,
+                    void *parent_baton,
+                    apr_pool_t *pool)
+{
+  node_baton_t *parent = parent_baton;
+
+  svn_stringbuf_appendcstr(parent->rb->log,
+                           apr_psprintf(pool, "delete_entry %s\n", path));
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+record_add_directory(const char *path,
+                     void *parent_baton,
+                     const char *copyfrom_path,
+                     svn_revnum_t copyfrom_revision,
+                     apr_pool_t *pool,
+                     void **child_baton)
+{
+  node_baton_t *parent = parent_baton;
+
+  svn_stringbuf_appendcstr(parent->rb->log,
+                           apr_psprintf(pool, "add_directory %s\n", path));
+  *child_baton = make_node(parent->rb, path, pool);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+record_close_directory(void *dir_baton,
+                       apr_pool_t *pool)
+{
+  node_baton_t *nb = dir_baton;
+
+  svn_stringbuf_appendcstr(nb->rb->log,
+                           apr_psprintf(pool, "close_directory %s\n",
+                                        nb->path));
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+record_add_file(const char *path,
+                void *parent_baton,
+                const char *copyfrom_path,
+                svn_revnum_t copyfrom_revision,
+                apr_pool_t *pool,
+                void **file_baton)
+{
+  node_baton_t *parent = parent_baton;
+
+  svn_stringbuf_appendcstr(parent->rb->log,
+                           apr_psprintf(pool, "add_file %s\n", path));
+  *file_baton = make_node(parent->rb, path, pool);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+record_apply_textdelta(void *file_baton,
+                       const char *base_checksum,
+                       apr_pool_t *pool,
+                       svn_txdelta_window_handler_t *handler,
+                       void **handler_baton)
+{
+  node_baton_t *nb = file_baton;
+
+  svn_stringbuf_appendcstr(nb->rb->log,
+                           apr_psprintf(pool, "apply_textdelta %s\n",
+                                        nb->path));
+  svn_txdelta_apply(svn_stream_empty(pool),
+                    svn_stream_from_stringbuf(nb->contents, pool),
+                    NULL, NULL, pool, handler, handler_baton);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+record_change_file_prop(void *file_baton,
+                        const char *name,
+                        const svn_string_t *value,
+                        apr_pool_t *pool)
+{
+  node_baton_t *nb = file_baton;
+
+  svn_stringbuf_appendcstr(nb->rb->log,
+                           apr_psprintf(pool, "change_file_prop %s %s=%s\n",
+                                        nb->path, name, value->data));
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+record_close_file(void *file_baton,
+                  const char *text_checksum,
+                  apr_pool_t *pool)
+{
+  node_baton_t *nb = file_baton;
+
+  if (nb->rb->fail_path && strcmp(nb->path, nb->rb->fail_path) == 0)
+    return svn_error_create(SVN_ERR_TEST_FAILED, NULL, "close_file failed");
+
+  svn_stringbuf_appendcstr(nb->rb->log,
+                           apr_psprintf(pool, "close_file %s %s\n",
+                                        nb->path, nb->contents->data));
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+record_close_edit(void *edit_baton,
+                  apr_pool_t *pool)
+{
+  record_baton_t *rb = edit_baton;
+
+  svn_stringbuf_appendcstr(rb->log, "close_edit\n");
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+record_abort_edit(void *edit_baton,
+                  apr_pool_t *pool)
+{
+  record_baton_t *rb = edit_baton;
+
+  rb->aborted = TRUE;
+
+  return SVN_NO_ERROR;
+}
+
+/* Return a recording editor in *EDITOR and *EDIT_BATON that logs into a
+ * string allocated in the thread-safe LOG_POOL. */
+static void
+get_record_editor(const svn_delta_editor_t **editor,
+                  record_baton_t **edit_baton,
+                  apr_pool_t *log_pool,
+                  apr_pool_t *pool)
+{
+  svn_delta_editor_t *record_editor = svn_delta_default_editor(pool);
+  record_baton_t *rb = apr_pcalloc(pool, sizeof(*rb));
+
+  record_editor->open_root = record_open_root;
+  record_editor->delete_entry = record_delete_entry;
+  record_editor->add_directory = record_add_directory;
+  record_editor->close_directory = record_close_directory;
+  record_editor->add_file = record_add_file;
+  record_editor->apply_textdelta = record_apply_textdelta;
+  record_editor->change_file_prop = record_change_file_prop;
+  record_editor->close_file = record_close_file;
+  record_editor->close_edit = record_close_edit;
+  record_editor->abort_edit = record_abort_edit;
+
+  rb->log = svn_stringbuf_create_empty(log_pool);
+
+  *editor = record_editor;
+  *edit_baton = rb;
+}
+
+/* Add the file "A/file<I>" with some contents to the directory with
+ * DIR_BATON using EDITOR.  All temporary data gets cleared before we
+ * return such that the editor can't rely on it. */
+static svn_error_t *
+add_file(const svn_delta_editor_t *editor,
+         void *dir_baton,
+         int i,
+         apr_pool_t *pool)
+{
+  apr_pool_t *file_pool = svn_pool_create(pool);
+  svn_stringbuf_t *contents = svn_stringbuf_create_empty(file_pool);
+  svn_txdelta_window_handler_t handler;
+  void *handler_baton;
+  void *file_baton;
+  int k;
+
+  /* Large enough to span several delta windows. */
+  for (k = 0; k < 20000; ++k)
+    svn_stringbuf_appendcstr(contents,
+                             apr_psprintf(file_pool, "%d:%d,", i, k));
+
+  SVN_ERR(editor->add_file(apr_psprintf(file_pool, "A/file%d", i),
+                           dir_baton, NULL, SVN_INVALID_REVNUM, file_pool,
+                           &file_baton));
+  SVN_ERR(editor->apply_textdelta(file_baton, NULL, file_pool, &handler,
+                                  &handler_baton));
+  SVN_ERR(svn_txdelta_send_string(svn_string_create_from_buf(contents,
+                                                              file_pool),
+                                  handler, handler_baton, file_pool));
+  SVN_ERR(editor->change_file_prop(file_baton, "prop",
+                                   svn_string_createf(file_pool, "%d", i),
+                                   file_pool));
+  SVN_ERR(editor->close_file(file_baton, NULL, file_pool));
+
+  svn_pool_destroy(file_pool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Drive EDITOR with a small tree of FILE_COUNT files. */
+static svn_error_t *
+drive_editor(const svn_delta_editor_t *editor,
+             void *edit_baton,
+             int file_count,
+             apr_pool_t *pool)
+{
+  apr_pool_t *dir_pool = svn_pool_create(pool);
+  void *root_baton;
+  void *dir_baton;
+  int i;
+
+  SVN_ERR(editor->open_root(edit_baton, 1, pool, &root_baton));
+  SVN_ERR(editor->delete_entry("B", 1, root_baton, pool));
+  SVN_ERR(editor->add_directory("A", root_baton, NULL, SVN_INVALID_REVNUM,
+                                dir_pool, &dir_baton));
+
+  for (i = 0; i < file_count; ++i)
+    SVN_ERR(add_file(editor, dir_baton, i, pool));
+
+  SVN_ERR(editor->close_directory(dir_baton, dir_pool));
+  svn_pool_destroy(dir_pool);
+
+  SVN_ERR(editor->close_directory(root_baton, pool));
+
+  return svn_error_trace(editor->close_edit(edit_baton, pool));
+}
+
+static svn_error_t *
+test_threaded_editor(apr_pool_t *pool)
+{
+  apr_pool_t *log_pool = svn_pool_create(NULL);
+  const svn_delta_editor_t *record_editor;
+  record_baton_t *expected;
+  record_baton_t *actual;
+  int queue_size;
+
+  /* What a direct drive produces. */
+  get_record_editor(&record_editor, &expected, log_pool, pool);
+  SVN_ERR(drive_editor(record_editor, expected, 10, pool));
+
+  /* A queue size of 1 maximizes contention. */
+  for (queue_size = 1; queue_size <= 64; queue_size *= 8)
+    {
+      apr_pool_t *iterpool = svn_pool_create(pool);
+      const svn_delta_editor_t *editor;
+      void *edit_baton;
+
+      get_record_editor(&record_editor, &actual, log_pool, iterpool);
+      SVN_ERR(svn_delta__get_threaded_editor(&editor, &edit_baton,
+                                             record_editor, actual,
+                                             queue_size, iterpool));
+      SVN_ERR(drive_editor(editor, edit_baton, 10, iterpool));
+
+      SVN_TEST_STRING_ASSERT(actual->log->data, expected->log->data);
+      svn_pool_destroy(iterpool);
+    }
+
+  svn_pool_destroy(log_pool);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_threaded_editor_error(apr_pool_t *pool)
+{
+  apr_pool_t *log_pool = svn_pool_create(NULL);
+  const svn_delta_editor_t *record_editor;
+  const svn_delta_editor_t *editor;
+  record_baton_t *rb;
+  void *edit_baton;
+
+  get_record_editor(&record_editor, &rb, log_pool, pool);
+  rb->fail_path = "A/file2";
+  SVN_ERR(svn_delta__get_threaded_editor(&editor, &edit_baton,
+                                         record_editor, rb, 4, pool));
+
+  /* The error surfaces somewhere during the drive. */
+  SVN_TEST_ASSERT_ERROR(drive_editor(editor, edit_baton, 10, pool),
+                        SVN_ERR_TEST_FAILED);
+
+  /* Nothing after the failed call must have been executed. */
+  SVN_TEST_ASSERT(strstr(rb->log->data, "close_file A/file1 ") != NULL);
+  SVN_TEST_ASSERT(strstr(rb->log->data, "add_file A/file3") == NULL);
+  SVN_TEST_ASSERT(strstr(rb->log->data, "close_edit") == NULL);
+
+  SVN_ERR(editor->abort_edit(edit_baton, pool));
+  SVN_TEST_ASSERT(rb->aborted);
+
+  svn_pool_destroy(log_pool);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_threaded_editor_abort(apr_pool_t *pool)
+{
+  apr_pool_t *log_pool = svn_pool_create(NULL);
+  apr_pool_t *edit_pool = svn_pool_create(pool);
+  const svn_delta_editor_t *record_editor;
+  const svn_delta_editor_t *editor;
+  record_baton_t *rb;
+  void *edit_baton;
+  void *root_baton;
+  void *dir_baton;
+
+  get_record_editor(&record_editor, &rb, log_pool, pool);
+  SVN_ERR(svn_delta__get_threaded_editor(&editor, &edit_baton,
+                                         record_editor, rb, 2, edit_pool));
+
+  SVN_ERR(editor->open_root(edit_baton, 1, edit_pool, &root_baton));
+  SVN_ERR(editor->add_directory("A", root_baton, NULL, SVN_INVALID_REVNUM,
+                                edit_pool, &dir_baton));
+  SVN_ERR(add_file(editor, dir_baton, 0, edit_pool));
+  SVN_ERR(editor->abort_edit(edit_baton, edit_pool));
+
+  SVN_TEST_ASSERT(rb->aborted);
+  SVN_TEST_ASSERT(strstr(rb->log->data, "close_edit") == NULL);
+
+  /* Destroying an edit that has not been finished must not hang. */
+  SVN_ERR(svn_delta__get_threaded_editor(&editor, &edit_baton,
+                                         record_editor, rb, 2, edit_pool));
+  SVN_ERR(editor->open_root(edit_baton, 1, edit_pool, &root_baton));
+  svn_pool_destroy(edit_pool);
+
+  svn_pool_destroy(log_pool);
+
+  return SVN_NO_ERROR;
+}
+
+/* The test table.  */
+
+static int max_threads = 3;
+
+static struct svn_test_descriptor_t test_funcs[] =
+{
+  SVN_TEST_NULL,
+  SVN_TEST_PASS2(test_threaded_editor,
+                 "test replaying an edit in a separate thread"),
+  SVN_TEST_PASS2(test_threaded_editor_error,
+                 "test error reporting of the threaded editor"),
+  SVN_TEST_PASS2(test_threaded_editor_abort,
+                 "test aborting the threaded editor"),
+  SVN_TEST_NULL
+};
+
+SVN_TEST_MAIN
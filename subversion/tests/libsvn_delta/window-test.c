@@ -22,13 +22,16 @@
  */
 
 #include <apr_pools.h>
+#include <apr_md5.h>
 
 #include "../svn_test.h"
 
 #include "svn_types.h"
 #include "svn_error.h"
 #include "svn_delta.h"
+#include "svn_sorts.h"
 
+#include "private/svn_delta_private.h"
 #include "private/svn_subr_private.h"
 
 static svn_error_t *
@@ -96,6 +99,144 @@ stream_window_test(apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+/* Return TRUE if the delta windows A and B are identical. */
+static svn_boolean_t
+windows_equal(const svn_txdelta_window_t *a,
+              const svn_txdelta_window_t *b)
+{
+  int i;
+
+  if (   a->sview_offset != b->sview_offset
+      || a->sview_len != b->sview_len
+      || a->tview_len != b->tview_len
+      || a->num_ops != b->num_ops
+      || a->src_ops != b->src_ops
+      || !svn_string_compare(a->new_data, b->new_data))
+    return FALSE;
+
+  for (i = 0; i < a->num_ops; ++i)
+    if (   a->ops[i].action_code != b->ops[i].action_code
+        || a->ops[i].offset != b->ops[i].offset
+        || a->ops[i].length != b->ops[i].length)
+      return FALSE;
+
+  return TRUE;
+}
+
+/* Implements svn_txdelta_window_handler_t.  Append a copy of WINDOW to
+ * the apr_array_header_t given as BATON. */
+static svn_error_t *
+collect_window(svn_txdelta_window_t *window,
+               void *baton)
+{
+  apr_array_header_t *windows = baton;
+
+  if (window)
+    APR_ARRAY_PUSH(windows, svn_txdelta_window_t *)
+      = svn_txdelta_window_dup(window, windows->pool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *WINDOWS to the delta windows between SOURCE and TARGET, computed
+ * by a target-push stream with up to MAX_THREADS threads.  Write TARGET
+ * in chunks of CHUNK_SIZE bytes.  Use POOL for all allocations. */
+static svn_error_t *
+push_windows(apr_array_header_t **windows,
+             const svn_string_t *source,
+             const svn_string_t *target,
+             int max_threads,
+             apr_size_t chunk_size,
+             apr_pool_t *pool)
+{
+  svn_stream_t *stream;
+  apr_size_t pos;
+
+  *windows = apr_array_make(pool, 16, sizeof(svn_txdelta_window_t *));
+  SVN_ERR(svn_txdelta__target_push_parallel(&stream, collect_window,
+                                            *windows,
+                                            svn_stream_from_string(source,
+                                                                   pool),
+                                            max_threads, pool));
+
+  for (pos = 0; pos < target->len; pos += chunk_size)
+    {
+      apr_size_t len = MIN(chunk_size, target->len - pos);
+      SVN_ERR(svn_stream_write(stream, target->data + pos, &len));
+    }
+
+  return svn_error_trace(svn_stream_close(stream));
+}
+
+static svn_error_t *
+parallel_window_test(apr_pool_t *pool)
+{
+  svn_stringbuf_t *source = svn_stringbuf_create_empty(pool);
+  svn_stringbuf_t *target = svn_stringbuf_create_empty(pool);
+  const svn_string_t *source_str, *target_str;
+  svn_txdelta_stream_t *serial, *parallel;
+  apr_array_header_t *expected, *actual;
+  apr_uint32_t seed = 0;
+  int i, count = 0;
+
+  /* Create about 1MB of data spanning many delta windows, with every
+   * 100th line changed and the target being longer than the source. */
+  for (i = 0; i < 50000; ++i)
+    {
+      const char *line = apr_psprintf(pool, "line %d: %08x\n", i,
+                                      svn_test_rand(&seed));
+      if (i < 40000)
+        svn_stringbuf_appendcstr(source, line);
+      svn_stringbuf_appendcstr(target, i % 100 ? line : "changed\n");
+    }
+
+  source_str = svn_string_create_from_buf(source, pool);
+  target_str = svn_string_create_from_buf(target, pool);
+
+  /* Pull mode. */
+  svn_txdelta2(&serial, svn_stream_from_string(source_str, pool),
+               svn_stream_from_string(target_str, pool), TRUE, pool);
+  SVN_ERR(svn_txdelta__parallel(&parallel,
+                                svn_stream_from_string(source_str, pool),
+                                svn_stream_from_string(target_str, pool),
+                                TRUE, 4, pool));
+
+  while (1)
+    {
+      svn_txdelta_window_t *expected_window, *actual_window;
+
+      SVN_ERR(svn_txdelta_next_window(&expected_window, serial, pool));
+      SVN_ERR(svn_txdelta_next_window(&actual_window, parallel, pool));
+      if (expected_window == NULL)
+        {
+          SVN_TEST_ASSERT(actual_window == NULL);
+          break;
+        }
+
+      SVN_TEST_ASSERT(actual_window != NULL);
+      SVN_TEST_ASSERT(windows_equal(expected_window, actual_window));
+      ++count;
+    }
+
+  SVN_TEST_ASSERT(count > 8);
+  SVN_TEST_ASSERT(memcmp(svn_txdelta_md5_digest(serial),
+                         svn_txdelta_md5_digest(parallel),
+                         APR_MD5_DIGESTSIZE) == 0);
+
+  /* Push mode, with chunks not aligned to window boundaries. */
+  SVN_ERR(push_windows(&expected, source_str, target_str, 1, 30000, pool));
+  SVN_ERR(push_windows(&actual, source_str, target_str, 4, 30000, pool));
+
+  SVN_TEST_INT_ASSERT(expected->nelts, count);
+  SVN_TEST_INT_ASSERT(actual->nelts, count);
+  for (i = 0; i < count; ++i)
+    SVN_TEST_ASSERT(windows_equal(
+                      APR_ARRAY_IDX(expected, i, svn_txdelta_window_t *),
+                      APR_ARRAY_IDX(actual, i, svn_txdelta_window_t *)));
+
+  return SVN_NO_ERROR;
+}
+
 
 
 /* The test table.  */
@@ -107,6 +248,8 @@ static struct svn_test_descriptor_t test_funcs[] =
     SVN_TEST_NULL,
     SVN_TEST_PASS2(stream_window_test,
                    "txdelta stream and windows test"),
+    SVN_TEST_PASS2(parallel_window_test,
+                   "parallel txdelta stream test"),
     SVN_TEST_NULL
   };
 
@@ -3065,6 +3065,931 @@ three_way_double_add(apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+/* Baton for the reconstruct_* output functions. */
+typedef struct reconstruct_baton_t
+{
+  /* The lines of the original, modified and latest text. */
+  apr_array_header_t *lines[3];
+
+  /* Expected start of the next range in each of the texts. */
+  apr_off_t next[3];
+
+  /* The text reconstructed from the diff. */
+  svn_stringbuf_t *result;
+
+  /* Set if any range was inconsistent or a conflict was found. */
+  svn_boolean_t failed;
+} reconstruct_baton_t;
+
+/* Check that the LENGTH lines starting at START in text I of BATON follow
+ * the previous range in that text.  If TAKE is set, append them to the
+ * result in BATON. */
+static void
+reconstruct_range(reconstruct_baton_t *baton,
+                  int i,
+                  apr_off_t start,
+                  apr_off_t length,
+                  svn_boolean_t take)
+{
+  apr_off_t k;
+
+  if (start != baton->next[i] || start + length > baton->lines[i]->nelts)
+    {
+      baton->failed = TRUE;
+      return;
+    }
+
+  baton->next[i] += length;
+  if (take)
+    for (k = start; k < start + length; k++)
+      svn_stringbuf_appendcstr(baton->result,
+                               APR_ARRAY_IDX(baton->lines[i], k,
+                                             const char *));
+}
+
+/* Check that the LENGTH lines starting at START1 and START2 in the texts
+ * I and J of BATON are identical. */
+static void
+reconstruct_compare(reconstruct_baton_t *baton,
+                    int i,
+                    apr_off_t start1,
+                    int j,
+                    apr_off_t start2,
+                    apr_off_t length)
+{
+  apr_off_t k;
+
+  if (   start1 + length > baton->lines[i]->nelts
+      || start2 + length > baton->lines[j]->nelts)
+    {
+      baton->failed = TRUE;
+      return;
+    }
+
+  for (k = 0; k < length; k++)
+    if (strcmp(APR_ARRAY_IDX(baton->lines[i], start1 + k, const char *),
+               APR_ARRAY_IDX(baton->lines[j], start2 + k, const char *)))
+      baton->failed = TRUE;
+}
+
+static svn_error_t *
+reconstruct_common(void *output_baton,
+                   apr_off_t original_start, apr_off_t original_length,
+                   apr_off_t modified_start, apr_off_t modified_length,
+                   apr_off_t latest_start, apr_off_t latest_length)
+{
+  reconstruct_baton_t *baton = output_baton;
+
+  reconstruct_compare(baton, 0, original_start, 1, modified_start,
+                      original_length);
+  reconstruct_range(baton, 0, original_start, original_length, TRUE);
+  reconstruct_range(baton, 1, modified_start, modified_length, FALSE);
+  if (baton->lines[2])
+    {
+      reconstruct_compare(baton, 0, original_start, 2, latest_start,
+                          original_length);
+      reconstruct_range(baton, 2, latest_start, latest_length, FALSE);
+    }
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+reconstruct_diff_modified(void *output_baton,
+                          apr_off_t original_start,
+                          apr_off_t original_length,
+                          apr_off_t modified_start,
+                          apr_off_t modified_length,
+                          apr_off_t latest_start,
+                          apr_off_t latest_length)
+{
+  reconstruct_baton_t *baton = output_baton;
+
+  reconstruct_range(baton, 0, original_start, original_length, FALSE);
+  reconstruct_range(baton, 1, modified_start, modified_length, TRUE);
+  if (baton->lines[2])
+    {
+      reconstruct_compare(baton, 0, original_start, 2, latest_start,
+                          original_length);
+      reconstruct_range(baton, 2, latest_start, latest_length, FALSE);
+    }
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+reconstruct_diff_latest(void *output_baton,
+                        apr_off_t original_start, apr_off_t original_length,
+                        apr_off_t modified_start, apr_off_t modified_length,
+                        apr_off_t latest_start, apr_off_t latest_length)
+{
+  reconstruct_baton_t *baton = output_baton;
+
+  reconstruct_compare(baton, 0, original_start, 1, modified_start,
+                      original_length);
+  reconstruct_range(baton, 0, original_start, original_length, FALSE);
+  reconstruct_range(baton, 1, modified_start, modified_length, FALSE);
+  reconstruct_range(baton, 2, latest_start, latest_length, TRUE);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+reconstruct_diff_common(void *output_baton,
+                        apr_off_t original_start, apr_off_t original_length,
+                        apr_off_t modified_start, apr_off_t modified_length,
+                        apr_off_t latest_start, apr_off_t latest_length)
+{
+  reconstruct_baton_t *baton = output_baton;
+
+  reconstruct_compare(baton, 1, modified_start, 2, latest_start,
+                      modified_length);
+  reconstruct_range(baton, 0, original_start, original_length, FALSE);
+  reconstruct_range(baton, 1, modified_start, modified_length, TRUE);
+  reconstruct_range(baton, 2, latest_start, latest_length, FALSE);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+reconstruct_conflict(void *output_baton,
+                     apr_off_t original_start, apr_off_t original_length,
+                     apr_off_t modified_start, apr_off_t modified_length,
+                     apr_off_t latest_start, apr_off_t latest_length,
+                     svn_diff_t *resolved_diff)
+{
+  reconstruct_baton_t *baton = output_baton;
+
+  baton->failed = TRUE;
+
+  return SVN_NO_ERROR;
+}
+
+static const svn_diff_output_fns_t reconstruct_fns =
+{
+  reconstruct_common,
+  reconstruct_diff_modified,
+  reconstruct_diff_latest,
+  reconstruct_diff_common,
+  reconstruct_conflict
+};
+
+/* Return the lines of TEXT, including their line endings. */
+static apr_array_header_t *
+split_lines(const svn_string_t *text,
+            apr_pool_t *pool)
+{
+  apr_array_header_t *lines = apr_array_make(pool, 0, sizeof(const char *));
+  const char *line = text->data;
+  const char *eol;
+
+  while ((eol = strchr(line, '\n')) != NULL)
+    {
+      APR_ARRAY_PUSH(lines, const char *)
+        = apr_pstrndup(pool, line, eol - line + 1);
+      line = eol + 1;
+    }
+
+  if (*line)
+    APR_ARRAY_PUSH(lines, const char *) = line;
+
+  return lines;
+}
+
+/* Return a text of LINE_COUNT lines with many repetitions, using SEED as
+ * random number generator state.  Unless RARE_LINES is set, the text
+ * consists of only two different lines. */
+static svn_string_t *
+make_repetitive_text(int line_count,
+                     svn_boolean_t rare_lines,
+                     apr_uint32_t *seed,
+                     apr_pool_t *pool)
+{
+  svn_stringbuf_t *text = svn_stringbuf_create_empty(pool);
+  int i;
+
+  for (i = 0; i < line_count; i++)
+    {
+      apr_uint32_t r = svn_test_rand(seed) % (rare_lines ? 100 : 60);
+
+      /* Mostly blank lines and braces, some rarer and some unique lines. */
+      if (r < 30)
+        svn_stringbuf_appendcstr(text, "\n");
+      else if (r < 60)
+        svn_stringbuf_appendcstr(text, "}\n");
+      else if (r < 90)
+        svn_stringbuf_appendcstr(text, apr_psprintf(pool, "line %u\n",
+                                                    r % 8));
+      else
+        svn_stringbuf_appendcstr(text,
+                                 apr_psprintf(pool, "unique %u\n",
+                                              svn_test_rand(seed)));
+    }
+
+  return svn_string_create_from_buf(text, pool);
+}
+
+/* Return a copy of TEXT with random lines replaced, inserted and deleted,
+ * using SEED as random number generator state. */
+static svn_string_t *
+modify_text(const svn_string_t *text,
+            apr_uint32_t *seed,
+            apr_pool_t *pool)
+{
+  apr_array_header_t *lines = split_lines(text, pool);
+  svn_stringbuf_t *result = svn_stringbuf_create_empty(pool);
+  int i;
+
+  for (i = 0; i < lines->nelts; i++)
+    {
+      apr_uint32_t r = svn_test_rand(seed) % 100;
+      const char *line = APR_ARRAY_IDX(lines, i, const char *);
+
+      if (r < 5)
+        continue;
+      else if (r < 10)
+        svn_stringbuf_appendcstr(result, "}\n");
+      else if (r < 15)
+        svn_stringbuf_appendcstr(result,
+                                 apr_psprintf(pool, "new %u\n",
+                                              svn_test_rand(seed)));
+      else if (r < 20)
+        line = "\n";
+
+      svn_stringbuf_appendcstr(result, line);
+    }
+
+  return svn_string_create_from_buf(result, pool);
+}
+
+/* Check that the ranges in DIFF are consistent with the ORIGINAL, MODIFIED
+ * and, for three-way diffs, LATEST texts and that taking the lines from
+ * the ranges as selected by the svn_diff_output_fns_t results in
+ * EXPECTED.  There must not be any conflicts. */
+static svn_error_t *
+check_diff(svn_diff_t *diff,
+           const svn_string_t *original,
+           const svn_string_t *modified,
+           const svn_string_t *latest,
+           const svn_string_t *expected,
+           apr_pool_t *pool)
+{
+  reconstruct_baton_t baton = { { NULL } };
+  int i;
+
+  baton.lines[0] = split_lines(original, pool);
+  baton.lines[1] = split_lines(modified, pool);
+  baton.lines[2] = latest ? split_lines(latest, pool) : NULL;
+  baton.result = svn_stringbuf_create_empty(pool);
+
+  SVN_ERR(svn_diff_output2(diff, &baton, &reconstruct_fns, NULL, NULL));
+
+  SVN_TEST_ASSERT(!baton.failed);
+  for (i = 0; i < 3 && baton.lines[i]; i++)
+    SVN_TEST_INT_ASSERT(baton.next[i], baton.lines[i]->nelts);
+
+  SVN_TEST_STRING_ASSERT(baton.result->data, expected->data);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_histogram_diff_random(apr_pool_t *pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_diff_file_options_t *options = svn_diff_file_options_create(pool);
+  apr_uint32_t seed = 0x1234;
+  int i;
+
+  options->algorithm = svn_diff_file_algorithm_histogram;
+
+  for (i = 0; i < 200; i++)
+    {
+      svn_string_t *original, *modified;
+      svn_diff_t *diff;
+
+      svn_pool_clear(iterpool);
+      original = make_repetitive_text(i * 5, i % 4 != 0, &seed, iterpool);
+      modified = modify_text(original, &seed, iterpool);
+
+      SVN_ERR(svn_diff_mem_string_diff(&diff, original, modified, options,
+                                       iterpool));
+      SVN_ERR(check_diff(diff, original, modified, NULL, modified,
+                         iterpool));
+      SVN_ERR(svn_diff_mem_string_diff(&diff, modified, original, options,
+                                       iterpool));
+      SVN_ERR(check_diff(diff, modified, original, NULL, original,
+                         iterpool));
+
+      /* Merges without overlapping changes. */
+      SVN_ERR(svn_diff_mem_string_diff3(&diff, original, original, modified,
+                                        options, iterpool));
+      SVN_ERR(check_diff(diff, original, original, modified, modified,
+                         iterpool));
+      SVN_ERR(svn_diff_mem_string_diff3(&diff, original, modified, original,
+                                        options, iterpool));
+      SVN_ERR(check_diff(diff, original, modified, original, modified,
+                         iterpool));
+      SVN_ERR(svn_diff_mem_string_diff3(&diff, original, modified, modified,
+                                        options, iterpool));
+      SVN_ERR(check_diff(diff, original, modified, modified, modified,
+                         iterpool));
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_histogram_diff_files(apr_pool_t *pool)
+{
+  svn_diff_file_options_t *options = svn_diff_file_options_create(pool);
+  apr_array_header_t *args = apr_array_make(pool, 1, sizeof(const char *));
+  const char *filename1 = svn_test_data_path("histogram1", pool);
+  const char *filename2 = svn_test_data_path("histogram2", pool);
+  svn_string_t *original = svn_string_create(
+    "void f(void)" NL
+    "{" NL
+    "  foo();" NL
+    "}" NL
+    "" NL
+    "void g(void)" NL
+    "{" NL
+    "  bar();" NL
+    "}" NL, pool);
+  svn_string_t *modified = svn_string_create(
+    "void g(void)" NL
+    "{" NL
+    "  bar();" NL
+    "}" NL
+    "" NL
+    "void f(void)" NL
+    "{" NL
+    "  foo(1);" NL
+    "}" NL, pool);
+  svn_diff_t *diff;
+
+  APR_ARRAY_PUSH(args, const char *) = "--histogram";
+  SVN_ERR(svn_diff_file_options_parse(options, args, pool));
+  SVN_TEST_ASSERT(options->algorithm == svn_diff_file_algorithm_histogram);
+
+  SVN_ERR(make_file(filename1, original->data, pool));
+  SVN_ERR(make_file(filename2, modified->data, pool));
+
+  SVN_ERR(svn_diff_file_diff_2(&diff, filename1, filename2, options, pool));
+  SVN_ERR(check_diff(diff, original, modified, NULL, modified, pool));
+
+  SVN_ERR(svn_diff_file_diff3_2(&diff, filename1, filename1, filename2,
+                                options, pool));
+  SVN_ERR(check_diff(diff, original, original, modified, modified, pool));
+
+  SVN_ERR(svn_io_remove_file2(filename1, FALSE, pool));
+  SVN_ERR(svn_io_remove_file2(filename2, FALSE, pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Baton for the int_* diff callbacks comparing two arrays of ints. */
+typedef struct int_diff_baton_t
+{
+  /* The original and the modified array. */
+  apr_array_header_t *values[2];
+
+  /* Next element to return from each array. */
+  int next[2];
+
+  /* Lines found to be common / changed in each array. */
+  apr_off_t common[2];
+  apr_off_t changed[2];
+
+  /* Set if a common range did not contain equal values. */
+  svn_boolean_t failed;
+} int_diff_baton_t;
+
+/* Implements svn_diff_fns2_t.datasources_open */
+static svn_error_t *
+int_datasources_open(void *baton,
+                     apr_off_t *prefix_lines,
+                     apr_off_t *suffix_lines,
+                     const svn_diff_datasource_e *datasources,
+                     apr_size_t datasources_len)
+{
+  *prefix_lines = 0;
+  *suffix_lines = 0;
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_diff_fns2_t.datasource_close */
+static svn_error_t *
+int_datasource_close(void *baton,
+                     svn_diff_datasource_e datasource)
+{
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_diff_fns2_t.datasource_get_next_token.  Use a hash
+ * function with very many collisions. */
+static svn_error_t *
+int_get_next_token(apr_uint32_t *hash,
+                   void **token,
+                   void *baton,
+                   svn_diff_datasource_e datasource)
+{
+  int_diff_baton_t *b = baton;
+  int i = datasource == svn_diff_datasource_original ? 0 : 1;
+
+  if (b->next[i] < b->values[i]->nelts)
+    {
+      int *value = &APR_ARRAY_IDX(b->values[i], b->next[i], int);
+
+      *token = value;
+      *hash = *value % 5;
+      b->next[i]++;
+    }
+  else
+    *token = NULL;
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_diff_fns2_t.token_compare */
+static svn_error_t *
+int_token_compare(void *baton,
+                  void *ltoken,
+                  void *rtoken,
+                  int *compare)
+{
+  int lhs = *(int *)ltoken;
+  int rhs = *(int *)rtoken;
+
+  *compare = lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+
+  return SVN_NO_ERROR;
+}
+
+static const svn_diff_fns2_t int_diff_fns =
+{
+  int_datasources_open,
+  int_datasource_close,
+  int_get_next_token,
+  int_token_compare,
+  NULL,
+  NULL
+};
+
+/* Implements svn_diff_output_fns_t.output_common */
+static svn_error_t *
+int_output_common(void *baton,
+                  apr_off_t original_start,
+                  apr_off_t original_length,
+                  apr_off_t modified_start,
+                  apr_off_t modified_length,
+                  apr_off_t latest_start,
+                  apr_off_t latest_length)
+{
+  int_diff_baton_t *b = baton;
+  apr_off_t k;
+
+  for (k = 0; k < original_length; k++)
+    if (APR_ARRAY_IDX(b->values[0], original_start + k, int)
+        != APR_ARRAY_IDX(b->values[1], modified_start + k, int))
+      b->failed = TRUE;
+
+  b->common[0] += original_length;
+  b->common[1] += modified_length;
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_diff_output_fns_t.output_diff_modified */
+static svn_error_t *
+int_output_diff_modified(void *baton,
+                         apr_off_t original_start,
+                         apr_off_t original_length,
+                         apr_off_t modified_start,
+                         apr_off_t modified_length,
+                         apr_off_t latest_start,
+                         apr_off_t latest_length)
+{
+  int_diff_baton_t *b = baton;
+
+  b->changed[0] += original_length;
+  b->changed[1] += modified_length;
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_token_hash_collisions(apr_pool_t *pool)
+{
+  static const svn_diff_output_fns_t output_fns =
+    { int_output_common, int_output_diff_modified };
+  int_diff_baton_t baton = { { NULL } };
+  svn_diff_t *diff;
+  int kept = 0;
+  int i;
+
+  /* Enough distinct tokens to grow the token table a few times, almost
+   * all of them sharing their hash value with many others. */
+  baton.values[0] = apr_array_make(pool, 5000, sizeof(int));
+  baton.values[1] = apr_array_make(pool, 5000, sizeof(int));
+  for (i = 0; i < 5000; i++)
+    {
+      APR_ARRAY_PUSH(baton.values[0], int) = i;
+      if (i % 7 == 0)
+        {
+          APR_ARRAY_PUSH(baton.values[1], int) = 5000 + i;
+        }
+      else if (i % 11 != 0)
+        {
+          APR_ARRAY_PUSH(baton.values[1], int) = i;
+          kept++;
+        }
+    }
+
+  SVN_ERR(svn_diff_diff_2(&diff, &baton, &int_diff_fns, pool));
+  SVN_ERR(svn_diff_output2(diff, &baton, &output_fns, NULL, NULL));
+
+  SVN_TEST_ASSERT(!baton.failed);
+  SVN_TEST_INT_ASSERT(baton.common[0], kept);
+  SVN_TEST_INT_ASSERT(baton.common[1], kept);
+  SVN_TEST_INT_ASSERT(baton.common[0] + baton.changed[0],
+                      baton.values[0]->nelts);
+  SVN_TEST_INT_ASSERT(baton.common[1] + baton.changed[1],
+                      baton.values[1]->nelts);
+
+  return SVN_NO_ERROR;
+}
+
+/* Append a description of a hunk of type TAG with the given ranges to
+ * the svn_stringbuf_t BATON. */
+static svn_error_t *
+describe_hunk(void *baton,
+              const char *tag,
+              apr_off_t original_start,
+              apr_off_t original_length,
+              apr_off_t modified_start,
+              apr_off_t modified_length,
+              apr_off_t latest_start,
+              apr_off_t latest_length)
+{
+  svn_stringbuf_t *description = baton;
+  char buffer[200];
+
+  apr_snprintf(buffer, sizeof(buffer),
+               "%s %" APR_OFF_T_FMT ",%" APR_OFF_T_FMT
+               " %" APR_OFF_T_FMT ",%" APR_OFF_T_FMT
+               " %" APR_OFF_T_FMT ",%" APR_OFF_T_FMT "\n",
+               tag, original_start, original_length,
+               modified_start, modified_length,
+               latest_start, latest_length);
+  svn_stringbuf_appendcstr(description, buffer);
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_diff_output_fns_t.output_common */
+static svn_error_t *
+describe_common(void *baton,
+                apr_off_t original_start,
+                apr_off_t original_length,
+                apr_off_t modified_start,
+                apr_off_t modified_length,
+                apr_off_t latest_start,
+                apr_off_t latest_length)
+{
+  return describe_hunk(baton, "common", original_start, original_length,
+                       modified_start, modified_length,
+                       latest_start, latest_length);
+}
+
+/* Implements svn_diff_output_fns_t.output_diff_modified */
+static svn_error_t *
+describe_diff_modified(void *baton,
+                       apr_off_t original_start,
+                       apr_off_t original_length,
+                       apr_off_t modified_start,
+                       apr_off_t modified_length,
+                       apr_off_t latest_start,
+                       apr_off_t latest_length)
+{
+  return describe_hunk(baton, "modified", original_start, original_length,
+                       modified_start, modified_length,
+                       latest_start, latest_length);
+}
+
+/* Implements svn_diff_output_fns_t.output_diff_latest */
+static svn_error_t *
+describe_diff_latest(void *baton,
+                     apr_off_t original_start,
+                     apr_off_t original_length,
+                     apr_off_t modified_start,
+                     apr_off_t modified_length,
+                     apr_off_t latest_start,
+                     apr_off_t latest_length)
+{
+  return describe_hunk(baton, "latest", original_start, original_length,
+                       modified_start, modified_length,
+                       latest_start, latest_length);
+}
+
+/* Implements svn_diff_output_fns_t.output_diff_common */
+static svn_error_t *
+describe_diff_common(void *baton,
+                     apr_off_t original_start,
+                     apr_off_t original_length,
+                     apr_off_t modified_start,
+                     apr_off_t modified_length,
+                     apr_off_t latest_start,
+                     apr_off_t latest_length)
+{
+  return describe_hunk(baton, "both", original_start, original_length,
+                       modified_start, modified_length,
+                       latest_start, latest_length);
+}
+
+/* Implements svn_diff_output_fns_t.output_conflict */
+static svn_error_t *
+describe_conflict(void *baton,
+                  apr_off_t original_start,
+                  apr_off_t original_length,
+                  apr_off_t modified_start,
+                  apr_off_t modified_length,
+                  apr_off_t latest_start,
+                  apr_off_t latest_length,
+                  svn_diff_t *resolved_diff)
+{
+  static const svn_diff_output_fns_t describe_fns =
+    {
+      describe_common,
+      describe_diff_modified,
+      describe_diff_latest,
+      describe_diff_common,
+      describe_conflict
+    };
+
+  SVN_ERR(describe_hunk(baton, "conflict", original_start, original_length,
+                        modified_start, modified_length,
+                        latest_start, latest_length));
+  if (resolved_diff)
+    SVN_ERR(svn_diff_output2(resolved_diff, baton, &describe_fns,
+                             NULL, NULL));
+
+  return SVN_NO_ERROR;
+}
+
+/* Return a description of all hunks in DIFF, allocated in POOL. */
+static svn_error_t *
+describe_diff(const char **description,
+              svn_diff_t *diff,
+              apr_pool_t *pool)
+{
+  static const svn_diff_output_fns_t describe_fns =
+    {
+      describe_common,
+      describe_diff_modified,
+      describe_diff_latest,
+      describe_diff_common,
+      describe_conflict
+    };
+  svn_stringbuf_t *buffer = svn_stringbuf_create_empty(pool);
+
+  SVN_ERR(svn_diff_output2(diff, buffer, &describe_fns, NULL, NULL));
+  *description = buffer->data;
+
+  return SVN_NO_ERROR;
+}
+
+/* Return the concatenation of the lines in LINES from FIRST up to but
+ * not including LAST, allocated in POOL. */
+static svn_string_t *
+join_lines(const apr_array_header_t *lines,
+           int first,
+           int last,
+           apr_pool_t *pool)
+{
+  svn_stringbuf_t *text = svn_stringbuf_create_empty(pool);
+  int i;
+
+  for (i = first; i < last; i++)
+    svn_stringbuf_appendcstr(text, APR_ARRAY_IDX(lines, i, const char *));
+
+  return svn_string_create_from_buf(text, pool);
+}
+
+static svn_error_t *
+test_diff3_windowed(apr_pool_t *pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_diff_file_options_t *options = svn_diff_file_options_create(pool);
+  svn_diff_file_options_t *window_options
+    = svn_diff_file_options_create(pool);
+  const char *filenames[4];
+  apr_uint32_t seed = 0x3333;
+  int i, k;
+
+  for (k = 0; k < 4; k++)
+    filenames[k] = svn_test_data_path(apr_psprintf(pool, "windowed%d", k),
+                                      pool);
+
+  for (i = 0; i < 100; i++)
+    {
+      /* One large merge to cross chunk boundaries. */
+      int line_count = i == 99 ? 40000 : i * 10;
+      svn_string_t *original, *modified, *latest, *merged;
+      apr_array_header_t *lines, *modified_lines, *latest_lines;
+      const char *description, *window_description;
+      svn_diff_t *diff;
+
+      svn_pool_clear(iterpool);
+      window_options->diff3_window_lines = i == 99 ? 1000 : i % 30 + 20;
+
+      /* Change the first half in MODIFIED and the second half in LATEST,
+       * separated by a few unique lines. */
+      original = make_repetitive_text(line_count, TRUE, &seed, iterpool);
+      original = svn_string_createf(iterpool, "%s"
+                                    "sep 1" NL "sep 2" NL "sep 3" NL "%s",
+                                    original->data,
+                                    make_repetitive_text(line_count, TRUE,
+                                                         &seed,
+                                                         iterpool)->data);
+      lines = split_lines(original, iterpool);
+      modified = svn_string_createf(
+                   iterpool, "%s%s",
+                   modify_text(join_lines(lines, 0, line_count, iterpool),
+                               &seed, iterpool)->data,
+                   join_lines(lines, line_count, lines->nelts,
+                              iterpool)->data);
+      latest = svn_string_createf(
+                 iterpool, "%s%s",
+                 join_lines(lines, 0, line_count + 3, iterpool)->data,
+                 modify_text(join_lines(lines, line_count + 3,
+                                        lines->nelts, iterpool),
+                             &seed, iterpool)->data);
+      modified_lines = split_lines(modified, iterpool);
+      latest_lines = split_lines(latest, iterpool);
+      merged = svn_string_createf(
+                 iterpool, "%s%s",
+                 join_lines(modified_lines, 0,
+                            modified_lines->nelts - line_count,
+                            iterpool)->data,
+                 join_lines(latest_lines, line_count + 3,
+                            latest_lines->nelts, iterpool)->data);
+
+      SVN_ERR(make_file(filenames[0], original->data, iterpool));
+      SVN_ERR(make_file(filenames[1], modified->data, iterpool));
+      SVN_ERR(make_file(filenames[2], latest->data, iterpool));
+      SVN_ERR(make_file(filenames[3], merged->data, iterpool));
+
+      SVN_ERR(svn_diff_file_diff3_2(&diff, filenames[0], filenames[1],
+                                    filenames[2], window_options,
+                                    iterpool));
+      SVN_ERR(check_diff(diff, original, modified, latest, merged,
+                         iterpool));
+
+      SVN_ERR(svn_diff_file_diff3_2(&diff, filenames[0], filenames[0],
+                                    filenames[3], window_options,
+                                    iterpool));
+      SVN_ERR(check_diff(diff, original, original, merged, merged,
+                         iterpool));
+
+      /* A window larger than the files changes nothing. */
+      window_options->diff3_window_lines = 2 * line_count + 4;
+      SVN_ERR(svn_diff_file_diff3_2(&diff, filenames[0], filenames[1],
+                                    filenames[2], window_options,
+                                    iterpool));
+      SVN_ERR(describe_diff(&window_description, diff, iterpool));
+      SVN_ERR(svn_diff_file_diff3_2(&diff, filenames[0], filenames[1],
+                                    filenames[2], options, iterpool));
+      SVN_ERR(describe_diff(&description, diff, iterpool));
+      SVN_TEST_STRING_ASSERT(window_description, description);
+    }
+
+  for (k = 0; k < 4; k++)
+    SVN_ERR(svn_io_remove_file2(filenames[k], FALSE, pool));
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Append a random line to each of the COUNT texts in TEXTS.  If VARY is
+ * set, all but the first text may get a different whitespace, EOL style or
+ * contents.  Use SEED as random number generator state. */
+static void
+append_line_variants(svn_stringbuf_t **texts,
+                     int count,
+                     svn_boolean_t vary,
+                     apr_uint32_t *seed,
+                     apr_pool_t *pool)
+{
+  static const char * const spaces[] = { "", " ", "\t", "  \t " };
+  static const char * const eols[] = { "\n", "\r\n", "\r" };
+  apr_uint32_t r = svn_test_rand(seed);
+  int i;
+
+  for (i = 0; i < count; i++)
+    {
+      apr_uint32_t v = (vary && i > 0) ? svn_test_rand(seed) % 128 : 0;
+      int space = (v == 1) + (v == 2) * 2;
+      int eol = (v == 3);
+
+      svn_stringbuf_appendcstr(texts[i],
+                               apr_psprintf(pool, "%sline%s%u%s%s",
+                                            spaces[(r + space) % 4],
+                                            spaces[(r >> 2) % 4],
+                                            (r >> 8) % 1000 + (v == 4),
+                                            spaces[(r >> 4) % 4],
+                                            eols[((r >> 6) + eol) % 3]));
+    }
+}
+
+static svn_error_t *
+test_parallel_tokens(apr_pool_t *pool)
+{
+  /* SLOT_SIZE in diff_file.c */
+  const apr_size_t slot_size = 4 * 131072;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_diff_file_options_t *options = svn_diff_file_options_create(pool);
+  svn_diff_file_options_t *parallel_options
+    = svn_diff_file_options_create(pool);
+  svn_stringbuf_t *texts[3];
+  const char *filenames[3];
+  apr_uint32_t seed = 0x2222;
+  int i, k;
+
+  for (k = 0; k < 3; k++)
+    {
+      filenames[k] = svn_test_data_path(apr_psprintf(pool, "parallel%d", k),
+                                        pool);
+      texts[k] = svn_stringbuf_create(k ? "B\n" : "A\n", pool);
+    }
+
+  /* Identical lines up to a CRLF that straddles the end of the first slot,
+   * such that all files get split at the same positions. */
+  while (texts[0]->len < slot_size - 100)
+    append_line_variants(texts, 3, FALSE, &seed, pool);
+  for (k = 0; k < 3; k++)
+    {
+      svn_stringbuf_appendfill(texts[k], 'x', slot_size - 2 - texts[k]->len);
+      svn_stringbuf_appendcstr(texts[k], "\r\n");
+    }
+
+  /* Varying lines, including one that exceeds a slot. */
+  while (texts[0]->len < 2 * slot_size)
+    append_line_variants(texts, 3, TRUE, &seed, pool);
+  for (k = 0; k < 3; k++)
+    {
+      svn_stringbuf_appendfill(texts[k], ' ', slot_size + 1000);
+      svn_stringbuf_appendcstr(texts[k], "long\r");
+    }
+  while (texts[0]->len < 3 * slot_size)
+    append_line_variants(texts, 3, TRUE, &seed, pool);
+
+  for (k = 0; k < 3; k++)
+    SVN_ERR(make_file(filenames[k], texts[k]->data, pool));
+
+  parallel_options->max_threads = 4;
+
+  for (i = 0; i < 6; i++)
+    {
+      const char *description, *parallel_description;
+      svn_diff_t *diff;
+
+      svn_pool_clear(iterpool);
+      options->ignore_space = i % 3;
+      options->ignore_eol_style = i / 3;
+      parallel_options->ignore_space = options->ignore_space;
+      parallel_options->ignore_eol_style = options->ignore_eol_style;
+
+      SVN_ERR(svn_diff_file_diff_2(&diff, filenames[0], filenames[1],
+                                   options, iterpool));
+      SVN_ERR(describe_diff(&description, diff, iterpool));
+      SVN_ERR(svn_diff_file_diff_2(&diff, filenames[0], filenames[1],
+                                   parallel_options, iterpool));
+      SVN_ERR(describe_diff(&parallel_description, diff, iterpool));
+      SVN_TEST_STRING_ASSERT(parallel_description, description);
+
+      SVN_ERR(svn_diff_file_diff3_2(&diff, filenames[0], filenames[1],
+                                    filenames[2], options, iterpool));
+      SVN_ERR(describe_diff(&description, diff, iterpool));
+      SVN_ERR(svn_diff_file_diff3_2(&diff, filenames[0], filenames[1],
+                                    filenames[2], parallel_options,
+                                    iterpool));
+      SVN_ERR(describe_diff(&parallel_description, diff, iterpool));
+      SVN_TEST_STRING_ASSERT(parallel_description, description);
+    }
+
+  for (k = 0; k < 3; k++)
+    SVN_ERR(svn_io_remove_file2(filenames[k], FALSE, pool));
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
 /* ========================================================================== */
 
 
@@ -3109,6 +4034,16 @@ static struct svn_test_descriptor_t test_funcs[] =
                    "2-way issue #3362 test v2"),
     SVN_TEST_XFAIL2(three_way_double_add,
                    "3-way merge, double add"),
+    SVN_TEST_PASS2(test_histogram_diff_random,
+                   "histogram diff of random texts"),
+    SVN_TEST_PASS2(test_histogram_diff_files,
+                   "histogram diff option and file diffs"),
+    SVN_TEST_PASS2(test_token_hash_collisions,
+                   "many distinct tokens with colliding hashes"),
+    SVN_TEST_PASS2(test_diff3_windowed,
+                   "3-way merge of files in windows"),
+    SVN_TEST_PASS2(test_parallel_tokens,
+                   "split and hash lines in worker threads"),
     SVN_TEST_NULL
   };
 
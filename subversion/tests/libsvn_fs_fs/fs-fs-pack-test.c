@@ -30,12 +30,14 @@
 #include "../../libsvn_fs_fs/fs_fs.h"
 #include "../../libsvn_fs_fs/low_level.h"
 #include "../../libsvn_fs_fs/pack.h"
+#include "../../libsvn_fs_fs/rev_file.h"
 #include "../../libsvn_fs_fs/util.h"
 
 #include "svn_hash.h"
 #include "svn_pools.h"
 #include "svn_props.h"
 #include "svn_fs.h"
+#include "private/svn_fs_fs_private.h"
 #include "private/svn_string_private.h"
 
 #include "../svn_test_fs.h"
@@ -1887,6 +1889,209 @@ large_delta_against_plain(const svn_test_opts_t *opts,
 
 #undef REPO_NAME
 
+/* ------------------------------------------------------------------------ */
+
+#define REPO_NAME "test-repo-read-mapped-fs"
+#define SHARD_SIZE 5
+#define MAX_REV 11
+
+static svn_error_t *
+read_mapped_fs(const svn_test_opts_t *opts,
+               apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  apr_hash_t *fs_config = apr_hash_make(pool);
+  const char *conf_path;
+  svn_stringbuf_t *conf;
+  svn_revnum_t i;
+  int block_read;
+
+  /* The last two revisions remain unpacked. */
+  SVN_ERR(create_packed_filesystem(REPO_NAME, opts, MAX_REV, SHARD_SIZE,
+                                   pool));
+
+  /* Enable memory-mapped rev / pack file access. */
+  conf_path = svn_dirent_join(REPO_NAME, PATH_CONFIG, pool);
+  SVN_ERR(svn_stringbuf_from_file2(&conf, conf_path, pool));
+  svn_stringbuf_appendcstr(conf,
+                           "\n[" CONFIG_SECTION_IO "]\n"
+                           CONFIG_OPTION_MEMORY_MAP_REVISION_FILES
+                           " = true\n");
+  SVN_ERR(svn_io_remove_file2(conf_path, FALSE, pool));
+  SVN_ERR(svn_io_file_create_bytes(conf_path, conf->data, conf->len, pool));
+
+  /* Read all contents with and without block-read.  Use a separate cache
+   * namespace each time to make sure we actually read from disk. */
+  for (block_read = 0; block_read < 2; ++block_read)
+    {
+      svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_CACHE_NS,
+                    svn_uuid_generate(pool));
+      svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_BLOCK_READ,
+                    block_read ? "1" : "0");
+      SVN_ERR(svn_fs_open2(&fs, REPO_NAME, fs_config, pool, pool));
+
+      for (i = 1; i <= MAX_REV; i++)
+        {
+          svn_fs_root_t *rev_root;
+          svn_stream_t *rstream;
+          svn_stringbuf_t *rstring;
+          const char *expected;
+
+          SVN_ERR(svn_fs_revision_root(&rev_root, fs, i, pool));
+          SVN_ERR(svn_fs_file_contents(&rstream, rev_root, "iota", pool));
+          SVN_ERR(svn_test__stream_to_string(&rstring, rstream, pool));
+
+          expected = i == 1 ? "This is the file 'iota'.\n"
+                            : get_rev_contents(i, pool);
+          SVN_TEST_STRING_ASSERT(rstring->data, expected);
+        }
+    }
+
+  SVN_ERR(svn_fs_verify(REPO_NAME, fs_config, 0, MAX_REV, NULL, NULL,
+                        NULL, NULL, pool));
+
+  /* Low-level access to a pack file and to a non-packed rev file. */
+  for (i = 1; i <= MAX_REV; i += MAX_REV - 1)
+    {
+      svn_fs_fs__revision_file_t *rev_file;
+      svn_stringbuf_t *expected, *actual, *line;
+      svn_boolean_t eof;
+      apr_off_t offset;
+
+      SVN_ERR(svn_fs_fs__open_pack_or_rev_file(&rev_file, fs, i, pool,
+                                               pool));
+#if APR_HAS_MMAP
+      SVN_TEST_ASSERT(rev_file->mmap != NULL);
+#endif
+
+      /* Reading through the mapping yields the file contents ... */
+      SVN_ERR(svn_stringbuf_from_aprfile(&expected, rev_file->file, pool));
+      actual = svn_stringbuf_create_ensure(expected->len, pool);
+      SVN_ERR(svn_fs_fs__rev_file_seek(rev_file, NULL, 0, pool));
+      SVN_ERR(svn_fs_fs__rev_file_read(rev_file, actual->data,
+                                       expected->len, &actual->len, pool));
+      actual->data[actual->len] = '\0';
+      SVN_TEST_ASSERT(svn_stringbuf_compare(actual, expected));
+
+      /* ... but nothing beyond it. */
+      SVN_TEST_ASSERT_ANY_ERROR(svn_fs_fs__rev_file_read(rev_file,
+                                                         actual->data, 1,
+                                                         NULL, pool));
+
+      /* Line-based reads leave the read pointer right behind the EOL. */
+      SVN_ERR(svn_fs_fs__rev_file_seek(rev_file, NULL, 0, pool));
+      SVN_ERR(svn_stream_readline(svn_fs_fs__rev_file_stream(rev_file),
+                                  &line, "\n", &eof, pool));
+      SVN_ERR(svn_fs_fs__rev_file_offset(&offset, rev_file, pool));
+      SVN_TEST_ASSERT(!eof);
+      SVN_TEST_ASSERT(offset == (apr_off_t)line->len + 1);
+      SVN_TEST_ASSERT(expected->data[line->len] == '\n');
+      SVN_TEST_ASSERT(memcmp(line->data, expected->data, line->len) == 0);
+
+      SVN_ERR(svn_fs_fs__close_revision_file(rev_file));
+    }
+
+  return SVN_NO_ERROR;
+}
+
+#undef REPO_NAME
+#undef SHARD_SIZE
+#undef MAX_REV
+
+/* ------------------------------------------------------------------------ */
+
+#define REPO_NAME "test-repo-prefetch-blocks"
+#define SHARD_SIZE 5
+#define MAX_REV 11
+
+static svn_error_t *
+prefetch_blocks(const svn_test_opts_t *opts,
+                apr_pool_t *pool)
+{
+  svn_fs_t *fs;
+  fs_fs_data_t *ffd;
+  svn_fs_fs__prefetch_stats_t stats;
+  apr_hash_t *fs_config = apr_hash_make(pool);
+  const char *conf_path;
+  svn_stringbuf_t *conf;
+  svn_revnum_t i;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+
+  /* Read-ahead hints are only given in block-read mode. */
+  if (opts->server_minor_version && (opts->server_minor_version < 9))
+    return svn_error_create(SVN_ERR_TEST_SKIPPED, NULL,
+                            "pre-1.9 SVN doesn't support block-read");
+
+  /* The last two revisions remain unpacked. */
+  SVN_ERR(create_packed_filesystem(REPO_NAME, opts, MAX_REV, SHARD_SIZE,
+                                   pool));
+
+  conf_path = svn_dirent_join(REPO_NAME, PATH_CONFIG, pool);
+  SVN_ERR(svn_stringbuf_from_file2(&conf, conf_path, pool));
+  svn_stringbuf_appendcstr(conf,
+                           "\n[" CONFIG_SECTION_IO "]\n"
+                           CONFIG_OPTION_PREFETCH_BLOCKS " = true\n");
+  SVN_ERR(svn_io_remove_file2(conf_path, FALSE, pool));
+  SVN_ERR(svn_io_file_create_bytes(conf_path, conf->data, conf->len, pool));
+
+  /* Use a fresh cache namespace to make sure we actually read from disk. */
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_CACHE_NS,
+                svn_uuid_generate(pool));
+  svn_hash_sets(fs_config, SVN_FS_CONFIG_FSFS_BLOCK_READ, "1");
+  SVN_ERR(svn_fs_open2(&fs, REPO_NAME, fs_config, pool, pool));
+  ffd = fs->fsap_data;
+  SVN_TEST_ASSERT(ffd->prefetch_blocks);
+
+  /* Walk the history backwards like "log -v" would. */
+  for (i = MAX_REV; i > 0; i--)
+    {
+      svn_fs_root_t *rev_root;
+      apr_hash_t *changes;
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_fs_revision_root(&rev_root, fs, i, iterpool));
+      SVN_ERR(svn_fs_paths_changed2(&changes, rev_root, iterpool));
+      SVN_TEST_ASSERT(apr_hash_count(changes) > 0);
+    }
+
+  /* Traverse the youngest trees like an export would. */
+  for (i = MAX_REV - 1; i <= MAX_REV; i++)
+    {
+      svn_fs_root_t *rev_root;
+      apr_hash_t *entries;
+      apr_hash_index_t *hi;
+
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_fs_revision_root(&rev_root, fs, i, iterpool));
+      SVN_ERR(svn_fs_dir_entries(&entries, rev_root, "", iterpool));
+      for (hi = apr_hash_first(iterpool, entries); hi; hi = apr_hash_next(hi))
+        {
+          svn_fs_dirent_t *dirent = apr_hash_this_val(hi);
+          svn_node_kind_t kind;
+
+          SVN_ERR(svn_fs_check_path(&kind, rev_root, dirent->name,
+                                    iterpool));
+          SVN_TEST_ASSERT(kind == dirent->kind);
+        }
+    }
+
+  /* Every block read from disk counts as either hit or miss.  Unless the
+   * platform does not support read-ahead hints, the history walk alone
+   * produces hits when crossing from the unpacked revs into the pack. */
+  svn_fs_fs__get_prefetch_stats(&stats, fs);
+  SVN_TEST_ASSERT(stats.hits + stats.misses > 0);
+  if (stats.requests)
+    SVN_TEST_ASSERT(stats.hits > 0);
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+#undef REPO_NAME
+#undef SHARD_SIZE
+#undef MAX_REV
+
 
 
 /* The test table.  */
@@ -1942,6 +2147,10 @@ static struct svn_test_descriptor_t test_funcs[] =
                        "pack with limited memory for metadata"),
     SVN_TEST_OPTS_PASS(large_delta_against_plain,
                        "large deltas against PLAIN, issue #4658"),
+    SVN_TEST_OPTS_PASS(read_mapped_fs,
+                       "read memory-mapped rev and pack files"),
+    SVN_TEST_OPTS_PASS(prefetch_blocks,
+                       "read-ahead hints for block-read"),
     SVN_TEST_NULL
   };
 
@@ -405,14 +405,14 @@ load_index(const svn_test_opts_t *opts, apr_pool_t *pool)
   APR_ARRAY_PUSH(alt_entries, svn_fs_fs__p2l_entry_t *) = &entry;
 
   SVN_ERR(svn_fs_fs__load_index(svn_repos_fs(repos), rev, alt_entries, pool));
-  SVN_TEST_ASSERT_ERROR(svn_repos_verify_fs3(repos, rev, rev, FALSE, FALSE,
-                                             NULL, NULL, NULL, NULL, NULL,
+  SVN_TEST_ASSERT_ERROR(svn_repos_verify_fs4(repos, rev, rev, FALSE, FALSE,
+                                             1, NULL, NULL, NULL, NULL, NULL,
                                              NULL, pool),
                         SVN_ERR_FS_INDEX_CORRUPTION);
 
   /* Restore the original index. */
   SVN_ERR(svn_fs_fs__load_index(svn_repos_fs(repos), rev, entries, pool));
-  SVN_ERR(svn_repos_verify_fs3(repos, rev, rev, FALSE, FALSE, NULL, NULL,
+  SVN_ERR(svn_repos_verify_fs4(repos, rev, rev, FALSE, FALSE, 1, NULL, NULL,
                                NULL, NULL, NULL, NULL, pool));
 
   return SVN_NO_ERROR;
@@ -22,11 +22,18 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <apr_general.h>
 #include <apr_lib.h>
 #include <apr_time.h>
+#include <apr_thread_proc.h>
 
+#if APR_HAS_FORK
+#include <unistd.h>
+#endif
+
+#include "svn_dirent_uri.h"
 #include "svn_pools.h"
 
 #include "private/svn_cache.h"
@@ -34,6 +41,16 @@
 
 #include "../svn_test.h"
 
+/* Membuffer caches can only be shared between processes that get forked
+ * and when they can use robust mutexes.
+ */
+#if APR_HAS_FORK && APR_HAS_SHARED_MEMORY \
+ && defined(HAVE_PTHREAD_MUTEX_CONSISTENT)
+#  define SHARED_MEMBUFFER_SUPPORTED 1
+#else
+#  define SHARED_MEMBUFFER_SUPPORTED 0
+#endif
+
 /* Create memcached cache if configured */
 static svn_error_t *
 create_memcache(svn_memcache_t **memcache,
@@ -210,7 +227,7 @@ test_membuffer_cache_basic(apr_pool_t *pool)
   svn_membuffer_t *membuffer;
 
   SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 10*1024, 1, 0,
-                                            TRUE, TRUE, pool));
+                                            TRUE, TRUE, FALSE, pool));
 
   /* Create a cache with just one entry. */
   SVN_ERR(svn_cache__create_membuffer_cache(&cache,
@@ -268,7 +285,7 @@ test_membuffer_serializer_error_handling(apr_pool_t *pool)
   void *val;
 
   SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 10*1024, 1, 0,
-                                            TRUE, TRUE, pool));
+                                            TRUE, TRUE, FALSE, pool));
 
   /* Create a cache with just one entry. */
   SVN_ERR(svn_cache__create_membuffer_cache(&cache,
@@ -300,7 +317,7 @@ test_membuffer_serializer_error_handling(apr_pool_t *pool)
 
   /* Create a new cache. */
   SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 10*1024, 1, 0,
-                                            TRUE, TRUE, pool));
+                                            TRUE, TRUE, FALSE, pool));
   SVN_ERR(svn_cache__create_membuffer_cache(&cache,
                                             membuffer,
                                             serialize_revnum,
@@ -387,7 +404,7 @@ test_membuffer_cache_clearing(apr_pool_t *pool)
 
   /* Create a simple cache for strings, keyed by strings. */
   SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 10*1024, 1, 0,
-                                            TRUE, TRUE, pool));
+                                            TRUE, TRUE, FALSE, pool));
   SVN_ERR(svn_cache__create_membuffer_cache(&cache,
                                             membuffer,
                                             serialize_revnum,
@@ -505,7 +522,7 @@ test_membuffer_unaligned_string_keys(apr_pool_t *pool)
   const char *unaligned_prefix = apr_pstrdup(pool, "_cache:") + 1;
 
   SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 10*1024, 1, 0,
-                                            TRUE, TRUE, pool));
+                                            TRUE, TRUE, FALSE, pool));
 
   /* Create a cache with just one entry. */
   SVN_ERR(svn_cache__create_membuffer_cache(
@@ -555,7 +572,7 @@ test_membuffer_unaligned_fixed_keys(apr_pool_t *pool)
   const char *unaligned_prefix = apr_pstrdup(pool, "_cache:") + 1;
 
   SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 10*1024, 1, 0,
-                                            TRUE, TRUE, pool));
+                                            TRUE, TRUE, FALSE, pool));
 
   /* Create a cache with just one entry. */
   SVN_ERR(svn_cache__create_membuffer_cache(
@@ -590,6 +607,951 @@ test_membuffer_unaligned_fixed_keys(apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+/* Size of the self-validating test item for KEY.  Some of them will be
+ * too large for lock-free partial getters. */
+static apr_size_t
+pattern_size(apr_uint32_t key)
+{
+  return sizeof(key) + (key * 397) % 6000;
+}
+
+/* Return TRUE, if the DATA_LEN bytes in DATA are a valid test item,
+ * i.e. one produced by serialize_pattern(). */
+static svn_boolean_t
+is_pattern(const void *data,
+           apr_size_t data_len)
+{
+  const unsigned char *bytes = data;
+  apr_uint32_t key;
+  apr_size_t i;
+
+  if (data_len < sizeof(key))
+    return FALSE;
+
+  memcpy(&key, data, sizeof(key));
+  if (data_len != pattern_size(key))
+    return FALSE;
+
+  for (i = sizeof(key); i < data_len; ++i)
+    if (bytes[i] != (unsigned char)(key + i))
+      return FALSE;
+
+  return TRUE;
+}
+
+/* Implements svn_cache__serialize_func_t.  IN is the apr_uint32_t key
+ * for which a self-validating test item will be created. */
+static svn_error_t *
+serialize_pattern(void **data,
+                  apr_size_t *data_len,
+                  void *in,
+                  apr_pool_t *pool)
+{
+  apr_uint32_t key = *(const apr_uint32_t *)in;
+  apr_size_t size = pattern_size(key);
+  unsigned char *bytes = apr_palloc(pool, size);
+  apr_size_t i;
+
+  memcpy(bytes, &key, sizeof(key));
+  for (i = sizeof(key); i < size; ++i)
+    bytes[i] = (unsigned char)(key + i);
+
+  *data = bytes;
+  *data_len = size;
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_cache__deserialize_func_t.  Return the key stored in
+ * the test item DATA. */
+static svn_error_t *
+deserialize_pattern(void **out,
+                    void *data,
+                    apr_size_t data_len,
+                    apr_pool_t *pool)
+{
+  if (! is_pattern(data, data_len))
+    return svn_error_create(SVN_ERR_TEST_FAILED, NULL,
+                            "corrupted item returned by cache");
+
+  *out = apr_pmemdup(pool, data, sizeof(apr_uint32_t));
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_cache__partial_getter_func_t.  Same as
+ * deserialize_pattern. */
+static svn_error_t *
+get_pattern_key(void **out,
+                const void *data,
+                apr_size_t data_len,
+                void *baton,
+                apr_pool_t *result_pool)
+{
+  if (! is_pattern(data, data_len))
+    return svn_error_create(SVN_ERR_TEST_FAILED, NULL,
+                            "corrupted item passed to partial getter");
+
+  *out = apr_pmemdup(result_pool, data, sizeof(apr_uint32_t));
+  return SVN_NO_ERROR;
+}
+
+/* Per-thread data for concurrent_cache_access. */
+typedef struct cache_access_baton_t
+{
+  /* The shared cache to hammer. */
+  svn_membuffer_t *membuffer;
+
+  /* Random number generator state for this thread. */
+  apr_uint32_t seed;
+
+  /* Result of the thread's work. */
+  svn_error_t *err;
+} cache_access_baton_t;
+
+/* Randomly read and write items from / to BATON->MEMBUFFER through a
+ * private front-end and verify all results.  Use POOL for allocations.
+ */
+static svn_error_t *
+concurrent_cache_access(cache_access_baton_t *baton,
+                        apr_pool_t *pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_cache__t *cache;
+  int i;
+
+  SVN_ERR(svn_cache__create_membuffer_cache(&cache, baton->membuffer,
+                                            serialize_pattern,
+                                            deserialize_pattern,
+                                            sizeof(apr_uint32_t),
+                                            "cache:",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE,
+                                            pool, pool));
+
+  for (i = 0; i < 20000; ++i)
+    {
+      /* The lower bits of svn_test_rand() are correlated. */
+      apr_uint32_t key = (svn_test_rand(&baton->seed) >> 16) % 1000;
+      apr_uint32_t op = (svn_test_rand(&baton->seed) >> 16) % 8;
+      apr_uint32_t *found_key = &key;
+      svn_boolean_t found;
+
+      svn_pool_clear(iterpool);
+      if (op < 2)
+        SVN_ERR(svn_cache__set(cache, &key, &key, iterpool));
+      else if (op < 5)
+        SVN_ERR(svn_cache__get((void **)&found_key, &found, cache, &key,
+                               iterpool));
+      else if (op < 7)
+        SVN_ERR(svn_cache__get_partial((void **)&found_key, &found, cache,
+                                       &key, get_pattern_key, NULL,
+                                       iterpool));
+      else
+        SVN_ERR(svn_cache__has_key(&found, cache, &key, iterpool));
+
+      if (found && *found_key != key)
+        return svn_error_createf(SVN_ERR_TEST_FAILED, NULL,
+                                 "expected item %u but found %u",
+                                 (unsigned)key, (unsigned)*found_key);
+    }
+
+  svn_pool_destroy(iterpool);
+  return SVN_NO_ERROR;
+}
+
+#if APR_HAS_THREADS
+
+static void *
+APR_THREAD_FUNC cache_access_thread(apr_thread_t *tid, void *data)
+{
+  cache_access_baton_t *baton = data;
+  apr_pool_t *pool = svn_pool_create(NULL);
+
+  baton->err = concurrent_cache_access(baton, pool);
+
+  svn_pool_destroy(pool);
+  apr_thread_exit(tid, APR_SUCCESS);
+
+  return NULL;
+}
+
+#endif
+
+#define APR_ERR(expr)                           \
+  do {                                          \
+    apr_status_t status = (expr);               \
+    if (status)                                 \
+      return svn_error_wrap_apr(status, NULL);  \
+  } while (0)
+
+static svn_error_t *
+test_membuffer_concurrent_access(apr_pool_t *pool)
+{
+#if APR_HAS_THREADS
+  /* Many threads reading and writing the same, small cache segment.
+     Readers must either find nothing or the correct data, no matter
+     whether they use the lock-free code path or not.
+   */
+  enum { THREAD_COUNT = 8 };
+  svn_membuffer_t *membuffer;
+  cache_access_baton_t batons[THREAD_COUNT];
+  apr_thread_t *threads[THREAD_COUNT];
+  svn_error_t *err = SVN_NO_ERROR;
+  int optimistic;
+  int i;
+
+  SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 256 * 1024,
+                                            16 * 1024, 1, TRUE, TRUE, FALSE,
+                                            pool));
+
+  for (optimistic = 1; optimistic >= 0; --optimistic)
+    {
+      svn_cache__membuffer_set_optimistic_reads(membuffer, optimistic);
+
+      for (i = 0; i < THREAD_COUNT; ++i)
+        {
+          batons[i].membuffer = membuffer;
+          batons[i].seed = (apr_uint32_t)i;
+          batons[i].err = SVN_NO_ERROR;
+          APR_ERR(apr_thread_create(&threads[i], NULL, cache_access_thread,
+                                    &batons[i], pool));
+        }
+
+      /* wait for the threads to finish */
+      for (i = 0; i < THREAD_COUNT; ++i)
+        {
+          apr_status_t retval;
+          APR_ERR(apr_thread_join(&retval, threads[i]));
+          APR_ERR(retval);
+          err = svn_error_compose_create(err, batons[i].err);
+        }
+
+      SVN_ERR(err);
+    }
+#endif
+
+  return SVN_NO_ERROR;
+}
+
+#if SHARED_MEMBUFFER_SUPPORTED
+
+/* Start a new child process in *PROC that runs FUNC with BATON and POOL
+ * and then terminates.  Its exit code will reflect FUNC's success.
+ */
+static svn_error_t *
+start_child(apr_proc_t *proc,
+            svn_error_t *(*func)(cache_access_baton_t *, apr_pool_t *),
+            cache_access_baton_t *baton,
+            apr_pool_t *pool)
+{
+  apr_status_t status = apr_proc_fork(proc, pool);
+
+  if (status == APR_INCHILD)
+    {
+      svn_error_t *err = func(baton, pool);
+      int exit_code = err ? EXIT_FAILURE : EXIT_SUCCESS;
+
+      /* Don't run the parent's exit handlers. */
+      svn_error_clear(err);
+      _exit(exit_code);
+    }
+
+  if (status != APR_INPARENT)
+    return svn_error_wrap_apr(status, NULL);
+
+  return SVN_NO_ERROR;
+}
+
+/* Wait for the child process PROC to terminate and return an error if
+ * it did not succeed. */
+static svn_error_t *
+wait_for_child(apr_proc_t *proc)
+{
+  apr_exit_why_e why;
+  int exit_code;
+  apr_status_t status = apr_proc_wait(proc, &exit_code, &why, APR_WAIT);
+
+  if (status != APR_CHILD_DONE)
+    return svn_error_wrap_apr(status, NULL);
+  if (!APR_PROC_CHECK_EXIT(why) || exit_code != EXIT_SUCCESS)
+    return svn_error_create(SVN_ERR_TEST_FAILED, NULL,
+                            "child process failed");
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements the FUNC for start_child.  Store a single, well-known item
+ * in BATON->MEMBUFFER. */
+static svn_error_t *
+store_marker(cache_access_baton_t *baton,
+             apr_pool_t *pool)
+{
+  svn_cache__t *cache;
+  apr_uint32_t key = 4242;
+
+  SVN_ERR(svn_cache__create_membuffer_cache(&cache, baton->membuffer,
+                                            serialize_pattern,
+                                            deserialize_pattern,
+                                            sizeof(apr_uint32_t),
+                                            "cache:",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE,
+                                            pool, pool));
+
+  return svn_error_trace(svn_cache__set(cache, &key, &key, pool));
+}
+
+#endif
+
+static svn_error_t *
+test_membuffer_shared(apr_pool_t *pool)
+{
+#if SHARED_MEMBUFFER_SUPPORTED
+  /* Several processes hammering the same shared cache segment must not
+     corrupt it.  Data written by one process must be visible to all
+     others that share the cache.
+   */
+  enum { CHILD_COUNT = 4 };
+  svn_membuffer_t *membuffer;
+  cache_access_baton_t batons[CHILD_COUNT];
+  apr_proc_t children[CHILD_COUNT];
+  apr_proc_t child;
+  svn_cache__t *cache;
+  apr_uint32_t key = 4242;
+  apr_uint32_t *found_key;
+  svn_boolean_t found;
+  svn_error_t *err = SVN_NO_ERROR;
+  int i;
+
+  SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 256 * 1024,
+                                            16 * 1024, 1, FALSE, TRUE, TRUE,
+                                            pool));
+  SVN_ERR(svn_cache__create_membuffer_cache(&cache, membuffer,
+                                            serialize_pattern,
+                                            deserialize_pattern,
+                                            sizeof(apr_uint32_t),
+                                            "cache:",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE,
+                                            pool, pool));
+
+  for (i = 0; i < CHILD_COUNT; ++i)
+    {
+      batons[i].membuffer = membuffer;
+      batons[i].seed = (apr_uint32_t)i;
+      batons[i].err = SVN_NO_ERROR;
+      SVN_ERR(start_child(&children[i], concurrent_cache_access, &batons[i],
+                          pool));
+    }
+
+  for (i = 0; i < CHILD_COUNT; ++i)
+    err = svn_error_compose_create(err, wait_for_child(&children[i]));
+
+  SVN_ERR(err);
+
+  /* Items written by a child are visible to the parent. */
+  SVN_ERR(svn_cache__get((void **)&found_key, &found, cache, &key, pool));
+  SVN_TEST_ASSERT(!found);
+
+  SVN_ERR(start_child(&child, store_marker, &batons[0], pool));
+  SVN_ERR(wait_for_child(&child));
+
+  SVN_ERR(svn_cache__get((void **)&found_key, &found, cache, &key, pool));
+  SVN_TEST_ASSERT(found);
+  SVN_TEST_ASSERT(*found_key == key);
+#endif
+
+  return SVN_NO_ERROR;
+}
+
+#if SHARED_MEMBUFFER_SUPPORTED
+
+/* Implements svn_cache__partial_setter_func_t.  Terminate the process
+ * while it holds the write lock and is in the middle of a modification. */
+static svn_error_t *
+die_while_modifying(void **data,
+                    apr_size_t *data_len,
+                    void *baton,
+                    apr_pool_t *result_pool)
+{
+  _exit(EXIT_SUCCESS);
+}
+
+/* Implements the FUNC for start_child.  Modify the well-known item in
+ * BATON->MEMBUFFER and die while doing so. */
+static svn_error_t *
+kill_writer(cache_access_baton_t *baton,
+            apr_pool_t *pool)
+{
+  svn_cache__t *cache;
+  apr_uint32_t key = 4242;
+
+  SVN_ERR(svn_cache__create_membuffer_cache(&cache, baton->membuffer,
+                                            serialize_pattern,
+                                            deserialize_pattern,
+                                            sizeof(apr_uint32_t),
+                                            "cache:",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE,
+                                            pool, pool));
+
+  SVN_ERR(svn_cache__set_partial(cache, &key, die_while_modifying, NULL,
+                                 pool));
+
+  return svn_error_create(SVN_ERR_TEST_FAILED, NULL,
+                          "writer survived the modification");
+}
+
+#endif
+
+static svn_error_t *
+test_membuffer_shared_owner_died(apr_pool_t *pool)
+{
+#if SHARED_MEMBUFFER_SUPPORTED
+  /* A process dying while it holds the lock of a shared cache segment
+     must not block the other processes.  The partially modified segment
+     contents must not be used.
+   */
+  svn_membuffer_t *membuffer;
+  cache_access_baton_t baton;
+  apr_proc_t child;
+  svn_cache__t *cache;
+  apr_uint32_t key = 4242;
+  apr_uint32_t *found_key;
+  svn_boolean_t found;
+
+  SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 256 * 1024,
+                                            16 * 1024, 1, FALSE, TRUE, TRUE,
+                                            pool));
+  SVN_ERR(svn_cache__create_membuffer_cache(&cache, membuffer,
+                                            serialize_pattern,
+                                            deserialize_pattern,
+                                            sizeof(apr_uint32_t),
+                                            "cache:",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE,
+                                            pool, pool));
+
+  SVN_ERR(svn_cache__set(cache, &key, &key, pool));
+
+  baton.membuffer = membuffer;
+  baton.seed = 0;
+  baton.err = SVN_NO_ERROR;
+  SVN_ERR(start_child(&child, kill_writer, &baton, pool));
+  SVN_ERR(wait_for_child(&child));
+
+  /* The interrupted modification hides the segment contents. */
+  SVN_ERR(svn_cache__get((void **)&found_key, &found, cache, &key, pool));
+  SVN_TEST_ASSERT(!found);
+
+  /* Writers recover the segment and don't block. */
+  SVN_ERR(svn_cache__set(cache, &key, &key, pool));
+  SVN_ERR(svn_cache__get((void **)&found_key, &found, cache, &key, pool));
+  SVN_TEST_ASSERT(found);
+  SVN_TEST_ASSERT(*found_key == key);
+#endif
+
+  return SVN_NO_ERROR;
+}
+
+/* Size of the items used by replay_trace(). */
+#define TRACE_ITEM_SIZE 512
+
+/* Implements svn_cache__serialize_func_t.  IN is an apr_uint32_t key for
+ * which a TRACE_ITEM_SIZE bytes item will be created. */
+static svn_error_t *
+serialize_trace_item(void **data,
+                     apr_size_t *data_len,
+                     void *in,
+                     apr_pool_t *pool)
+{
+  char *bytes = apr_pcalloc(pool, TRACE_ITEM_SIZE);
+  memcpy(bytes, in, sizeof(apr_uint32_t));
+
+  *data = bytes;
+  *data_len = TRACE_ITEM_SIZE;
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_cache__deserialize_func_t for serialize_trace_item. */
+static svn_error_t *
+deserialize_trace_item(void **out,
+                       void *data,
+                       apr_size_t data_len,
+                       apr_pool_t *pool)
+{
+  *out = apr_pmemdup(pool, data, sizeof(apr_uint32_t));
+  return SVN_NO_ERROR;
+}
+
+/* Replay a synthetic access trace against a new 1MB membuffer cache that
+ * uses the admission POLICY.  The trace consists of ROUNDS rounds, each
+ * with 4000 random reads from a hot set of HOT_SET_SIZE keys followed by
+ * a scan over SCAN_SIZE keys that never get accessed again.  Like our
+ * real users, add all items that are missing from the cache.
+ *
+ * Return the hit rate in percent for the hot set accesses in *HIT_RATE.
+ * Use POOL for all allocations.
+ */
+static svn_error_t *
+replay_trace(double *hit_rate,
+             svn_cache__admission_policy_t policy,
+             apr_uint32_t hot_set_size,
+             apr_uint32_t scan_size,
+             int rounds,
+             apr_pool_t *pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_membuffer_t *membuffer;
+  svn_cache__t *cache;
+  apr_uint32_t seed = 0;
+  apr_uint32_t next_cold_key = hot_set_size;
+  apr_uint32_t hits = 0;
+  apr_uint32_t gets = 0;
+  apr_uint32_t i;
+  int round;
+
+  SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 1024 * 1024,
+                                            200 * 1024, 1, FALSE, TRUE,
+                                            FALSE, pool));
+  svn_cache__membuffer_set_admission_policy(membuffer, policy);
+  SVN_ERR(svn_cache__create_membuffer_cache(&cache, membuffer,
+                                            serialize_trace_item,
+                                            deserialize_trace_item,
+                                            sizeof(apr_uint32_t),
+                                            "trace:",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE,
+                                            pool, pool));
+
+  for (round = 0; round < rounds; ++round)
+    {
+      for (i = 0; i < 4000; ++i)
+        {
+          apr_uint32_t key = (svn_test_rand(&seed) >> 16) % hot_set_size;
+          apr_uint32_t *value;
+          svn_boolean_t found;
+
+          svn_pool_clear(iterpool);
+          SVN_ERR(svn_cache__get((void **)&value, &found, cache, &key,
+                                 iterpool));
+          if (found)
+            ++hits;
+          else
+            SVN_ERR(svn_cache__set(cache, &key, &key, iterpool));
+
+          ++gets;
+        }
+
+      for (i = 0; i < scan_size; ++i)
+        {
+          apr_uint32_t key = next_cold_key++;
+          apr_uint32_t *value;
+          svn_boolean_t found;
+
+          svn_pool_clear(iterpool);
+          SVN_ERR(svn_cache__get((void **)&value, &found, cache, &key,
+                                 iterpool));
+          if (!found)
+            SVN_ERR(svn_cache__set(cache, &key, &key, iterpool));
+        }
+    }
+
+  *hit_rate = 100.0 * hits / gets;
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_membuffer_admission_policies(const svn_test_opts_t *opts,
+                                  apr_pool_t *pool)
+{
+  double hit_count_rate, frequency_rate;
+
+  /* Without scans, both policies should do about equally well. */
+  SVN_ERR(replay_trace(&hit_count_rate, svn_cache__admission_hit_count,
+                       1000, 0, 20, pool));
+  SVN_ERR(replay_trace(&frequency_rate, svn_cache__admission_frequency,
+                       1000, 0, 20, pool));
+  if (opts->verbose)
+    printf("no scans:   hit count %.1f%%, frequency %.1f%%\n",
+           hit_count_rate, frequency_rate);
+
+  SVN_TEST_ASSERT(frequency_rate + 5.0 > hit_count_rate);
+
+  /* Scans over 4x the cache size push the hot set out of the cache
+   * unless the admission policy recognizes them as one-off accesses. */
+  SVN_ERR(replay_trace(&hit_count_rate, svn_cache__admission_hit_count,
+                       1000, 4000, 20, pool));
+  SVN_ERR(replay_trace(&frequency_rate, svn_cache__admission_frequency,
+                       1000, 4000, 20, pool));
+  if (opts->verbose)
+    printf("with scans: hit count %.1f%%, frequency %.1f%%\n",
+           hit_count_rate, frequency_rate);
+
+  SVN_TEST_ASSERT(frequency_rate > hit_count_rate + 5.0);
+
+  return SVN_NO_ERROR;
+}
+
+/* Set *FOUND to whether the keys "key" and 42 can be found in CACHE
+ * and FIXED_KEY_CACHE, respectively.  Use POOL for allocations.
+ */
+static svn_error_t *
+lookup_snapshot_items(svn_boolean_t *found,
+                      svn_cache__t *cache,
+                      svn_cache__t *fixed_key_cache,
+                      apr_pool_t *pool)
+{
+  apr_uint32_t key = 42;
+  apr_uint32_t *value;
+  svn_stringbuf_t *string;
+  svn_boolean_t string_found, fixed_found;
+
+  SVN_ERR(svn_cache__get((void **)&string, &string_found, cache, "key",
+                         pool));
+  SVN_ERR(svn_cache__get((void **)&value, &fixed_found, fixed_key_cache,
+                         &key, pool));
+
+  if (string_found)
+    SVN_TEST_STRING_ASSERT(string->data, "value");
+  if (fixed_found)
+    SVN_TEST_ASSERT(*value == key);
+
+  SVN_TEST_ASSERT(string_found == fixed_found);
+  *found = string_found;
+
+  return SVN_NO_ERROR;
+}
+
+/* Create a membuffer cache in *MEMBUFFER and two front-ends for it with
+ * the key prefixes ROOT "STRINGS" and ROOT "FIXED" in *CACHE and
+ * *FIXED_KEY_CACHE, respectively.  Use POOL for allocations.
+ */
+static svn_error_t *
+create_snapshot_caches(svn_membuffer_t **membuffer,
+                       svn_cache__t **cache,
+                       svn_cache__t **fixed_key_cache,
+                       const char *root,
+                       apr_pool_t *pool)
+{
+  SVN_ERR(svn_cache__membuffer_cache_create(membuffer, 1024 * 1024,
+                                            64 * 1024, 0,
+                                            FALSE, TRUE, FALSE, pool));
+  SVN_ERR(svn_cache__create_membuffer_cache(cache, *membuffer, NULL, NULL,
+                                            APR_HASH_KEY_STRING,
+                                            apr_pstrcat(pool, root,
+                                                        "STRINGS",
+                                                        SVN_VA_NULL),
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE, pool, pool));
+  SVN_ERR(svn_cache__create_membuffer_cache(fixed_key_cache, *membuffer,
+                                            serialize_pattern,
+                                            deserialize_pattern,
+                                            sizeof(apr_uint32_t),
+                                            apr_pstrcat(pool, root,
+                                                        "FIXED",
+                                                        SVN_VA_NULL),
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE, pool, pool));
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_membuffer_snapshot(apr_pool_t *pool)
+{
+  svn_membuffer_t *membuffer;
+  svn_cache__t *cache, *fixed_key_cache;
+  svn_cache__t *unstamped_cache, *unstamped_fixed_key_cache;
+  apr_uint32_t key = 42;
+  svn_boolean_t found;
+  const char *snapshot_path;
+
+  SVN_ERR(svn_test_make_sandbox_dir(&snapshot_path, "cache-snapshot",
+                                    pool));
+  snapshot_path = svn_dirent_join(snapshot_path, "snapshot", pool);
+
+  /* Fill a cache for two key roots but only one of them is stamped. */
+  SVN_ERR(create_snapshot_caches(&membuffer, &cache, &fixed_key_cache,
+                                 "repo1:", pool));
+  SVN_ERR(svn_cache__create_membuffer_cache(&unstamped_cache, membuffer,
+                                            NULL, NULL,
+                                            APR_HASH_KEY_STRING,
+                                            "repo2:STRINGS",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE, pool, pool));
+  SVN_ERR(svn_cache__create_membuffer_cache(&unstamped_fixed_key_cache,
+                                            membuffer,
+                                            serialize_pattern,
+                                            deserialize_pattern,
+                                            sizeof(apr_uint32_t),
+                                            "repo2:FIXED",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE, pool, pool));
+
+  SVN_ERR(svn_cache__membuffer_set_stamp(membuffer, "repo1:", "r10",
+                                         pool));
+  SVN_ERR(svn_cache__set(cache, "key",
+                         svn_stringbuf_create("value", pool), pool));
+  SVN_ERR(svn_cache__set(fixed_key_cache, &key, &key, pool));
+  SVN_ERR(svn_cache__set(unstamped_cache, "key",
+                         svn_stringbuf_create("value", pool), pool));
+  SVN_ERR(svn_cache__set(unstamped_fixed_key_cache, &key, &key, pool));
+
+  SVN_ERR(svn_cache__membuffer_save(membuffer, snapshot_path, pool));
+
+  /* Entries only get loaded once their stamp has been confirmed. */
+  SVN_ERR(create_snapshot_caches(&membuffer, &cache, &fixed_key_cache,
+                                 "repo1:", pool));
+  SVN_ERR(svn_cache__membuffer_load(membuffer, snapshot_path, pool));
+  SVN_ERR(lookup_snapshot_items(&found, cache, fixed_key_cache, pool));
+  SVN_TEST_ASSERT(!found);
+
+  SVN_ERR(svn_cache__membuffer_set_stamp(membuffer, "repo1:", "r10",
+                                         pool));
+  SVN_ERR(lookup_snapshot_items(&found, cache, fixed_key_cache, pool));
+  SVN_TEST_ASSERT(found);
+
+  /* Entries without a stamp have not been saved. */
+  SVN_ERR(create_snapshot_caches(&membuffer, &cache, &fixed_key_cache,
+                                 "repo2:", pool));
+  SVN_ERR(svn_cache__membuffer_load(membuffer, snapshot_path, pool));
+  SVN_ERR(svn_cache__membuffer_set_stamp(membuffer, "repo2:", "r10",
+                                         pool));
+  SVN_ERR(lookup_snapshot_items(&found, cache, fixed_key_cache, pool));
+  SVN_TEST_ASSERT(!found);
+
+  /* Stale entries get dropped. */
+  SVN_ERR(create_snapshot_caches(&membuffer, &cache, &fixed_key_cache,
+                                 "repo1:", pool));
+  SVN_ERR(svn_cache__membuffer_load(membuffer, snapshot_path, pool));
+  SVN_ERR(svn_cache__membuffer_set_stamp(membuffer, "repo1:", "r11",
+                                         pool));
+  SVN_ERR(lookup_snapshot_items(&found, cache, fixed_key_cache, pool));
+  SVN_TEST_ASSERT(!found);
+
+  SVN_ERR(svn_cache__membuffer_set_stamp(membuffer, "repo1:", "r10",
+                                         pool));
+  SVN_ERR(lookup_snapshot_items(&found, cache, fixed_key_cache, pool));
+  SVN_TEST_ASSERT(!found);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_membuffer_snapshot_update(apr_pool_t *pool)
+{
+  svn_membuffer_t *membuffer;
+  svn_cache__t *cache, *fixed_key_cache;
+  apr_uint32_t key = 42;
+  svn_boolean_t found;
+  const char *sandbox_path, *snapshot_path, *corrupt_path;
+  svn_stringbuf_t *contents;
+  svn_error_t *err;
+
+  SVN_ERR(svn_test_make_sandbox_dir(&sandbox_path, "cache-snapshot-update",
+                                    pool));
+  snapshot_path = svn_dirent_join(sandbox_path, "snapshot", pool);
+  corrupt_path = svn_dirent_join(sandbox_path, "corrupt", pool);
+
+  SVN_ERR(create_snapshot_caches(&membuffer, &cache, &fixed_key_cache,
+                                 "repo1:", pool));
+  SVN_ERR(svn_cache__membuffer_set_stamp(membuffer, "repo1:", "r10",
+                                         pool));
+  SVN_ERR(svn_cache__set(cache, "key",
+                         svn_stringbuf_create("value", pool), pool));
+  SVN_ERR(svn_cache__set(fixed_key_cache, &key, &key, pool));
+  SVN_ERR(svn_cache__membuffer_save(membuffer, snapshot_path, pool));
+
+  /* Keep a corrupted copy of the snapshot.  Its only section starts
+   * right after the 56 byte header with the list of key prefixes. */
+  SVN_ERR(svn_stringbuf_from_file2(&contents, snapshot_path, pool));
+  SVN_TEST_ASSERT(contents->len > 64);
+  contents->data[64] ^= 0x5a;
+  SVN_ERR(svn_io_file_create_bytes(corrupt_path, contents->data,
+                                   contents->len, pool));
+
+  /* An empty cache must not replace the snapshot. */
+  SVN_ERR(create_snapshot_caches(&membuffer, &cache, &fixed_key_cache,
+                                 "repo1:", pool));
+  SVN_ERR(svn_cache__membuffer_save(membuffer, snapshot_path, pool));
+
+  /* Neither may a cache that did not use the snapshot's contents. */
+  SVN_ERR(create_snapshot_caches(&membuffer, &cache, &fixed_key_cache,
+                                 "repo1:", pool));
+  SVN_ERR(svn_cache__membuffer_load(membuffer, snapshot_path, pool));
+  SVN_ERR(svn_cache__membuffer_set_stamp(membuffer, "repo2:", "r10",
+                                         pool));
+  SVN_ERR(svn_cache__membuffer_save(membuffer, snapshot_path, pool));
+
+  SVN_ERR(create_snapshot_caches(&membuffer, &cache, &fixed_key_cache,
+                                 "repo1:", pool));
+  SVN_ERR(svn_cache__membuffer_load(membuffer, snapshot_path, pool));
+  SVN_ERR(svn_cache__membuffer_set_stamp(membuffer, "repo1:", "r10",
+                                         pool));
+  SVN_ERR(lookup_snapshot_items(&found, cache, fixed_key_cache, pool));
+  SVN_TEST_ASSERT(found);
+
+  /* Corrupted sections must not be imported. */
+  SVN_ERR(create_snapshot_caches(&membuffer, &cache, &fixed_key_cache,
+                                 "repo1:", pool));
+  err = svn_cache__membuffer_load(membuffer, corrupt_path, pool);
+  if (!err)
+    err = svn_cache__membuffer_set_stamp(membuffer, "repo1:", "r10", pool);
+  SVN_TEST_ASSERT_ANY_ERROR(err);
+
+  SVN_ERR(lookup_snapshot_items(&found, cache, fixed_key_cache, pool));
+  SVN_TEST_ASSERT(!found);
+
+  return SVN_NO_ERROR;
+}
+
+/* Return the statistics for PREFIX in INFOS, an array of
+ * svn_cache__prefix_info_t *.  Return NULL if there are none.
+ */
+static const svn_cache__prefix_info_t *
+find_prefix_info(apr_array_header_t *infos,
+                 const char *prefix)
+{
+  int i;
+  for (i = 0; i < infos->nelts; ++i)
+    {
+      const svn_cache__prefix_info_t *info
+        = APR_ARRAY_IDX(infos, i, const svn_cache__prefix_info_t *);
+      if (strcmp(info->prefix, prefix) == 0)
+        return info;
+    }
+
+  return NULL;
+}
+
+/* Return the sum of all buckets in the latency HISTOGRAM. */
+static apr_uint64_t
+count_latency_samples(const apr_uint64_t *histogram)
+{
+  apr_uint64_t count = 0;
+  int i;
+
+  for (i = 0; i < SVN_CACHE__LATENCY_BUCKETS; ++i)
+    count += histogram[i];
+
+  return count;
+}
+
+static svn_error_t *
+test_membuffer_prefix_stats(apr_pool_t *pool)
+{
+  svn_membuffer_t *membuffer;
+  svn_cache__t *cache, *fixed_key_cache;
+  svn_cache__info_t global_info;
+  apr_array_header_t *infos;
+  const svn_cache__prefix_info_t *info;
+  apr_uint64_t hits = 0;
+  apr_uint64_t used_entries = 0;
+  apr_uint64_t used_size = 0;
+  svn_stringbuf_t *value;
+  svn_boolean_t found;
+  apr_uint32_t key;
+  int i;
+
+  /* Small enough to evict most of the items we put into it. */
+  SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, 64 * 1024, 0, 1,
+                                            TRUE, TRUE, FALSE, pool));
+  SVN_ERR(svn_cache__create_membuffer_cache(&cache, membuffer, NULL, NULL,
+                                            APR_HASH_KEY_STRING, "strings:",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE, pool, pool));
+  SVN_ERR(svn_cache__create_membuffer_cache(&fixed_key_cache, membuffer,
+                                            serialize_trace_item,
+                                            deserialize_trace_item,
+                                            sizeof(apr_uint32_t), "fixed:",
+                                            SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY,
+                                            FALSE, FALSE, pool, pool));
+
+  SVN_ERR(svn_cache__set(cache, "a", svn_stringbuf_create("a", pool),
+                         pool));
+  SVN_ERR(svn_cache__set(cache, "b", svn_stringbuf_create("b", pool),
+                         pool));
+  SVN_ERR(svn_cache__get((void **)&value, &found, cache, "a", pool));
+  SVN_TEST_ASSERT(found);
+  SVN_ERR(svn_cache__get((void **)&value, &found, cache, "c", pool));
+  SVN_TEST_ASSERT(!found);
+  SVN_TEST_ASSERT(!svn_cache__is_cachable(cache, 0x10000000));
+
+  for (key = 0; key < 1000; ++key)
+    SVN_ERR(svn_cache__set(fixed_key_cache, &key, &key, pool));
+  for (key = 0; key < 1000; ++key)
+    {
+      apr_uint32_t *result;
+      SVN_ERR(svn_cache__get((void **)&result, &found, fixed_key_cache,
+                             &key, pool));
+      if (found)
+        ++hits;
+    }
+
+  SVN_ERR(svn_cache__membuffer_get_prefix_info(&infos, membuffer, FALSE,
+                                               pool));
+
+  info = find_prefix_info(infos, "strings:");
+  SVN_TEST_ASSERT(info);
+  SVN_TEST_ASSERT(info->gets == 2 && info->hits == 1 && info->sets == 2);
+  SVN_TEST_ASSERT(info->rejections == 1);
+  SVN_TEST_ASSERT(info->evictions + info->used_entries == 2);
+
+  info = find_prefix_info(infos, "fixed:");
+  SVN_TEST_ASSERT(info);
+  SVN_TEST_ASSERT(info->gets == 1000 && info->hits == hits);
+  SVN_TEST_ASSERT(info->sets == 1000 && info->rejections == 0);
+  SVN_TEST_ASSERT(info->evictions > 0);
+  SVN_TEST_ASSERT(info->evictions + info->used_entries <= 1000);
+  SVN_TEST_ASSERT(info->used_entries == hits);
+
+  /* Only every LATENCY_SAMPLING_INTERVAL-th access gets timed. */
+  SVN_TEST_ASSERT(count_latency_samples(info->get_latency) > 0);
+  SVN_TEST_ASSERT(count_latency_samples(info->get_latency) < 1000);
+  SVN_TEST_ASSERT(count_latency_samples(info->set_latency) > 0);
+
+  /* The per-prefix usage must add up to the cache's total usage. */
+  for (i = 0; i < infos->nelts; ++i)
+    {
+      info = APR_ARRAY_IDX(infos, i, const svn_cache__prefix_info_t *);
+      used_entries += info->used_entries;
+      used_size += info->used_size;
+    }
+
+  SVN_ERR(svn_cache__get_info(cache, &global_info, FALSE, pool));
+  SVN_TEST_ASSERT(used_entries == global_info.used_entries);
+  SVN_TEST_ASSERT(used_size == global_info.used_size);
+
+  /* Resetting clears the access counters only. */
+  SVN_ERR(svn_cache__membuffer_get_prefix_info(&infos, membuffer, TRUE,
+                                               pool));
+  SVN_ERR(svn_cache__membuffer_get_prefix_info(&infos, membuffer, FALSE,
+                                               pool));
+  info = find_prefix_info(infos, "strings:");
+  SVN_TEST_ASSERT(info->gets == 0 && info->hits == 0 && info->sets == 0);
+  SVN_TEST_ASSERT(info->rejections == 0);
+  SVN_TEST_ASSERT(count_latency_samples(info->get_latency) == 0);
+  SVN_TEST_ASSERT(info->evictions == 0);
+  info = find_prefix_info(infos, "fixed:");
+  SVN_TEST_ASSERT(info->used_entries == hits);
+
+  /* Clearing the cache clears the usage as well. */
+  SVN_ERR(svn_cache__membuffer_clear(membuffer));
+  SVN_ERR(svn_cache__membuffer_get_prefix_info(&infos, membuffer, FALSE,
+                                               pool));
+  for (i = 0; i < infos->nelts; ++i)
+    {
+      info = APR_ARRAY_IDX(infos, i, const svn_cache__prefix_info_t *);
+      SVN_TEST_ASSERT(info->used_entries == 0 && info->used_size == 0);
+    }
+
+  return SVN_NO_ERROR;
+}
+
 
 /* The test table.  */
 
@@ -616,6 +1578,23 @@ static struct svn_test_descriptor_t test_funcs[] =
                    "test membuffer cache with unaligned string keys"),
     SVN_TEST_PASS2(test_membuffer_unaligned_fixed_keys,
                    "test membuffer cache with unaligned fixed keys"),
+    SVN_TEST_SKIP2(test_membuffer_concurrent_access,
+                   ! APR_HAS_THREADS,
+                   "test concurrent membuffer cache access"),
+    SVN_TEST_SKIP2(test_membuffer_shared,
+                   ! SHARED_MEMBUFFER_SUPPORTED,
+                   "test membuffer cache shared between processes"),
+    SVN_TEST_SKIP2(test_membuffer_shared_owner_died,
+                   ! SHARED_MEMBUFFER_SUPPORTED,
+                   "test shared membuffer cache after writer died"),
+    SVN_TEST_OPTS_PASS(test_membuffer_admission_policies,
+                       "compare membuffer admission policies on traces"),
+    SVN_TEST_PASS2(test_membuffer_snapshot,
+                   "save and reload membuffer cache snapshots"),
+    SVN_TEST_PASS2(test_membuffer_snapshot_update,
+                   "don't lose or import broken snapshot data"),
+    SVN_TEST_PASS2(test_membuffer_prefix_stats,
+                   "per-prefix membuffer cache statistics"),
     SVN_TEST_NULL
   };
 
@@ -27,9 +27,25 @@
 
 #include "svn_error.h"
 #include "svn_io.h"
+#include "svn_sorts.h"
+#include "private/svn_adler32.h"
+#include "private/svn_cpu.h"
+#include "private/svn_subr_private.h"
 
 #include "../svn_test.h"
 
+/* CPU feature masks that select the various SIMD kernels, starting with
+ * the portable implementations.  Masks for features not available on the
+ * current machine simply fall back to the next-best kernel. */
+static const apr_uint32_t kernel_masks[] =
+  {
+    0,
+    SVN_CPU__SSE2,
+    SVN_CPU__SSE2 | SVN_CPU__SSSE3,
+    SVN_CPU__SSE2 | SVN_CPU__SSSE3 | SVN_CPU__SSE4_1,
+    ~(apr_uint32_t)0
+  };
+
 /* Verify that DIGEST of checksum type KIND can be parsed and
  * converted back to a string matching DIGEST.  NAME will be used
  * to identify the type of checksum in error messages.
@@ -364,6 +380,280 @@ test_checksummed_stream_reset(apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+/* Return the pseudo-adler32 checksum over LEN bytes at DATA as defined
+ * by svn__adler32_blocks(), using the most straight-forward code. */
+static apr_uint32_t
+pseudo_adler32(const unsigned char *data, apr_size_t len)
+{
+  apr_uint32_t s1 = 0;
+  apr_uint32_t s2 = 0;
+
+  for (; len; --len)
+    {
+      s1 += *data++;
+      s2 += s1;
+    }
+
+  return s2 * 0x10000 + s1;
+}
+
+static svn_error_t *
+test_adler32_kernels(apr_pool_t *pool)
+{
+  enum { BUFFER_SIZE = 0x40000 };
+  unsigned char *buffer = apr_palloc(pool, BUFFER_SIZE);
+  apr_uint32_t seed = 0x12345678;
+  apr_uint32_t old_mask;
+  apr_size_t i, k;
+  svn_error_t *err = SVN_NO_ERROR;
+
+  /* Random data with some runs of 0xff to hit the overflow limits. */
+  for (i = 0; i < BUFFER_SIZE; ++i)
+    buffer[i] = (unsigned char)svn_test_rand(&seed);
+  memset(buffer + 1000, 0xff, 10000);
+
+  old_mask = svn_cpu__set_features_mask(0);
+  for (k = 0; k < sizeof(kernel_masks) / sizeof(kernel_masks[0]); ++k)
+    {
+      svn_cpu__set_features_mask(kernel_masks[k]);
+      for (i = 0; i < 2000 && !err; ++i)
+        {
+          apr_size_t offset = svn_test_rand(&seed) % 1000;
+          apr_size_t len = i % 100 ? svn_test_rand(&seed) % 300
+                                   : svn_test_rand(&seed) % 0x30000;
+          apr_size_t block_size = 1 + svn_test_rand(&seed) % 512;
+          apr_uint32_t initial = i % 2 ? 1 : svn_test_rand(&seed) % 65521;
+          apr_uint32_t sums[4];
+          int b;
+
+          if (svn__adler32(initial, (const char *)buffer + offset, len)
+              != adler32(initial, buffer + offset, (uInt)len))
+            err = svn_error_createf(SVN_ERR_TEST_FAILED, NULL,
+                                    "Adler-32 mismatch for %d bytes "
+                                    "with features %s", (int)len,
+                                    svn_cpu__features_string(
+                                        svn_cpu__features(), pool));
+
+          svn__adler32_blocks(sums, (const char *)buffer + offset,
+                              block_size, 4);
+          for (b = 0; b < 4 && !err; ++b)
+            if (sums[b] != pseudo_adler32(buffer + offset + b * block_size,
+                                          block_size))
+              err = svn_error_createf(SVN_ERR_TEST_FAILED, NULL,
+                                      "Pseudo-Adler-32 mismatch for %d "
+                                      "byte blocks with features %s",
+                                      (int)block_size,
+                                      svn_cpu__features_string(
+                                          svn_cpu__features(), pool));
+        }
+    }
+
+  svn_cpu__set_features_mask(old_mask);
+
+  return svn_error_trace(err);
+}
+
+static svn_error_t *
+test_sha1_kernels(apr_pool_t *pool)
+{
+  enum { BUFFER_SIZE = 0x10000 };
+  char *buffer = apr_palloc(pool, BUFFER_SIZE);
+  apr_uint32_t seed = 0x9e3779b9;
+  apr_uint32_t old_mask;
+  svn_checksum_t *expected;
+  svn_checksum_t *reference[40];
+  apr_size_t i, k;
+
+  /* FIPS 180-2 test vector. */
+  SVN_ERR(svn_checksum_parse_hex(&expected, svn_checksum_sha1,
+                                 "a9993e364706816aba3e25717850c26c9cd0d89d",
+                                 pool));
+
+  for (i = 0; i < BUFFER_SIZE; ++i)
+    buffer[i] = (char)svn_test_rand(&seed);
+
+  old_mask = svn_cpu__set_features_mask(0);
+  for (k = 0; k < sizeof(kernel_masks) / sizeof(kernel_masks[0]); ++k)
+    {
+      svn_checksum_t *actual;
+      svn_checksum_ctx_t *ctx = svn_checksum_ctx_create(svn_checksum_sha1,
+                                                        pool);
+      svn_cpu__set_features_mask(kernel_masks[k]);
+
+      SVN_ERR(svn_checksum(&actual, svn_checksum_sha1, "abc", 3, pool));
+      SVN_TEST_ASSERT(svn_checksum_match(expected, actual));
+
+      /* Check all the different padding cases, feeding the data in
+       * variable-sized chunks.  The first kernel (portable code) provides
+       * the reference results. */
+      for (i = 0; i < 40; ++i)
+        {
+          apr_size_t len = i < 20 ? 50 + i : 1000 * i;
+          apr_size_t pos = 0;
+
+          SVN_ERR(svn_checksum_ctx_reset(ctx));
+          while (pos < len)
+            {
+              apr_size_t chunk = MIN(1 + svn_test_rand(&seed) % 200,
+                                     len - pos);
+              SVN_ERR(svn_checksum_update(ctx, buffer + pos, chunk));
+              pos += chunk;
+            }
+
+          SVN_ERR(svn_checksum_final(&actual, ctx, pool));
+          if (k == 0)
+            reference[i] = actual;
+          else
+            SVN_TEST_ASSERT(svn_checksum_match(reference[i], actual));
+        }
+    }
+
+  svn_cpu__set_features_mask(old_mask);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_md5_sha1_fused(apr_pool_t *pool)
+{
+  enum { BUFFER_SIZE = 0x12345 };
+  char *buffer = apr_palloc(pool, BUFFER_SIZE);
+  apr_uint32_t seed = 0x31415926;
+  svn_checksum__md5_sha1_ctx_t *ctx;
+  svn_checksum_t *md5, *sha1, *expected;
+  apr_size_t i;
+
+  for (i = 0; i < BUFFER_SIZE; ++i)
+    buffer[i] = (char)svn_test_rand(&seed);
+
+  ctx = svn_checksum__md5_sha1_ctx_create(pool);
+  svn_checksum__md5_sha1_update(ctx, buffer, 1);
+  svn_checksum__md5_sha1_update(ctx, buffer + 1, BUFFER_SIZE - 1);
+  svn_checksum__md5_sha1_final(&md5, &sha1, ctx, pool);
+
+  SVN_ERR(svn_checksum(&expected, svn_checksum_md5, buffer, BUFFER_SIZE,
+                       pool));
+  SVN_TEST_ASSERT(svn_checksum_match(expected, md5));
+  SVN_ERR(svn_checksum(&expected, svn_checksum_sha1, buffer, BUFFER_SIZE,
+                       pool));
+  SVN_TEST_ASSERT(svn_checksum_match(expected, sha1));
+
+  /* Reset and re-use. */
+  svn_checksum__md5_sha1_ctx_reset(ctx);
+  svn_checksum__md5_sha1_final(&md5, &sha1, ctx, pool);
+  SVN_TEST_ASSERT(svn_checksum_is_empty_checksum(md5));
+  SVN_TEST_ASSERT(svn_checksum_is_empty_checksum(sha1));
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_checksum_multi(apr_pool_t *pool)
+{
+  enum { BUFFER_SIZE = 0x10000, COUNT = 50 };
+  char *buffer = apr_palloc(pool, BUFFER_SIZE);
+  apr_uint32_t seed = 0x27182818;
+  apr_array_header_t *contents = apr_array_make(pool, COUNT,
+                                                sizeof(svn_string_t *));
+  apr_uint32_t old_mask;
+  apr_size_t i, k;
+
+  for (i = 0; i < BUFFER_SIZE; ++i)
+    buffer[i] = (char)svn_test_rand(&seed);
+
+  /* Texts of very different lengths, including all padding cases. */
+  for (i = 0; i < COUNT; ++i)
+    {
+      apr_size_t len = i < 10 ? 51 + i
+                              : svn_test_rand(&seed) % (i % 7 ? 500 : 40000);
+      APR_ARRAY_PUSH(contents, svn_string_t *)
+        = svn_string_ncreate(buffer + i, len, pool);
+    }
+
+  old_mask = svn_cpu__set_features_mask(0);
+  for (k = 0; k < sizeof(kernel_masks) / sizeof(kernel_masks[0]); ++k)
+    {
+      svn_checksum_kind_t kind;
+      svn_cpu__set_features_mask(kernel_masks[k]);
+
+      for (kind = svn_checksum_md5; kind <= svn_checksum_fnv1a_32x4; ++kind)
+        {
+          apr_array_header_t *checksums;
+          SVN_ERR(svn_checksum__multi(&checksums, kind, contents,
+                                      pool, pool));
+          SVN_TEST_ASSERT(checksums->nelts == COUNT);
+
+          for (i = 0; i < COUNT; ++i)
+            {
+              const svn_string_t *text
+                = APR_ARRAY_IDX(contents, i, const svn_string_t *);
+              svn_checksum_t *expected;
+
+              SVN_ERR(svn_checksum(&expected, kind, text->data, text->len,
+                                   pool));
+              SVN_TEST_ASSERT(svn_checksum_match(expected,
+                                APR_ARRAY_IDX(checksums, i,
+                                              svn_checksum_t *)));
+            }
+        }
+    }
+
+  svn_cpu__set_features_mask(old_mask);
+
+  return SVN_NO_ERROR;
+}
+
+static svn_error_t *
+test_fnv1a_kernels(apr_pool_t *pool)
+{
+  enum { BUFFER_SIZE = 0x10000, MAX_COUNT = 21 };
+  unsigned char *buffer = apr_palloc(pool, BUFFER_SIZE);
+  apr_uint32_t seed = 0x2545f491;
+  apr_uint32_t old_mask;
+  apr_size_t i, k;
+  svn_error_t *err = SVN_NO_ERROR;
+
+  for (i = 0; i < BUFFER_SIZE; ++i)
+    buffer[i] = (unsigned char)svn_test_rand(&seed);
+
+  old_mask = svn_cpu__set_features_mask(0);
+  for (k = 0; k < sizeof(kernel_masks) / sizeof(kernel_masks[0]); ++k)
+    {
+      svn_cpu__set_features_mask(kernel_masks[k]);
+      for (i = 0; i < 300 && !err; ++i)
+        {
+          const void *data[MAX_COUNT];
+          apr_size_t lens[MAX_COUNT];
+          apr_uint32_t digests[MAX_COUNT];
+          apr_size_t count = 1 + i % MAX_COUNT;
+          apr_size_t max_len = i % 3 ? 5000 : 100;
+          apr_size_t m;
+
+          /* Mix equal and random lengths including empty messages. */
+          for (m = 0; m < count; ++m)
+            {
+              lens[m] = i % 4 ? svn_test_rand(&seed) % max_len : max_len;
+              data[m] = buffer + svn_test_rand(&seed) % (BUFFER_SIZE
+                                                         - max_len);
+            }
+
+          svn__fnv1a_32x4_multi(digests, data, lens, count);
+          for (m = 0; m < count && !err; ++m)
+            if (digests[m] != svn__fnv1a_32x4(data[m], lens[m]))
+              err = svn_error_createf(SVN_ERR_TEST_FAILED, NULL,
+                                      "FNV-1a x4 mismatch for message %d "
+                                      "of %d bytes with features %s",
+                                      (int)m, (int)lens[m],
+                                      svn_cpu__features_string(
+                                          svn_cpu__features(), pool));
+        }
+    }
+
+  svn_cpu__set_features_mask(old_mask);
+
+  return svn_error_trace(err);
+}
+
 /* An array of all test functions */
 
 static int max_threads = 1;
@@ -389,6 +679,16 @@ static struct svn_test_descriptor_t test_funcs[] =
                    "read from checksummed stream"),
     SVN_TEST_PASS2(test_checksummed_stream_reset,
                    "reset checksummed stream"),
+    SVN_TEST_PASS2(test_adler32_kernels,
+                   "Adler-32 SIMD kernels vs. zlib"),
+    SVN_TEST_PASS2(test_sha1_kernels,
+                   "SHA-1 kernels"),
+    SVN_TEST_PASS2(test_md5_sha1_fused,
+                   "fused MD5 / SHA-1 checksum context"),
+    SVN_TEST_PASS2(test_checksum_multi,
+                   "multi-buffer checksums"),
+    SVN_TEST_PASS2(test_fnv1a_kernels,
+                   "modified FNV-1a multi-buffer kernels"),
     SVN_TEST_NULL
   };
 
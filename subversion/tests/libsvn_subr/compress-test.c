@@ -76,6 +76,48 @@ test_compress_lz4_empty(apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+static svn_error_t *
+test_compress_lz4_hc(apr_pool_t *pool)
+{
+  static const char * const words[] =
+    { "alpha ", "bravo ", "charlie ", "delta\n", "echo ", "foxtrot ",
+      "golf\n", "hotel ", "\x01\x02\x03", "\xff\xfe" };
+  svn_stringbuf_t *input = svn_stringbuf_create_empty(pool);
+  svn_stringbuf_t *compressed = svn_stringbuf_create_empty(pool);
+  svn_stringbuf_t *compressed_hc = svn_stringbuf_create_empty(pool);
+  svn_stringbuf_t *decompressed = svn_stringbuf_create_empty(pool);
+  const char repeated[] = "aaaaaaaaaaaaaaaaaaaa";
+  apr_uint32_t seed = 42;
+  apr_size_t len;
+
+  /* Inputs around the minimum size that allows for any match. */
+  for (len = 0; len < 20; ++len)
+    {
+      SVN_ERR(svn__compress_lz4_hc(repeated, len, compressed_hc));
+      SVN_ERR(svn__decompress_lz4(compressed_hc->data, compressed_hc->len,
+                                  decompressed, len));
+      SVN_TEST_ASSERT(decompressed->len == len);
+    }
+
+  /* Input exceeding the LZ4 window, with matches of all kinds of lengths
+     and distances. */
+  while (input->len < 200000)
+    {
+      seed = seed * 1103515245 + 12345;
+      svn_stringbuf_appendcstr(input, words[(seed >> 16) % 10]);
+    }
+
+  SVN_ERR(svn__compress_lz4(input->data, input->len, compressed));
+  SVN_ERR(svn__compress_lz4_hc(input->data, input->len, compressed_hc));
+  SVN_TEST_ASSERT(compressed_hc->len <= compressed->len);
+
+  SVN_ERR(svn__decompress_lz4(compressed_hc->data, compressed_hc->len,
+                              decompressed, input->len));
+  SVN_TEST_ASSERT(svn_stringbuf_compare(decompressed, input));
+
+  return SVN_NO_ERROR;
+}
+
 static int max_threads = -1;
 
 static struct svn_test_descriptor_t test_funcs[] =
@@ -87,6 +129,8 @@ static struct svn_test_descriptor_t test_funcs[] =
                  "test svn__compress_lz4()"),
   SVN_TEST_PASS2(test_compress_lz4_empty,
                  "test svn__compress_lz4() with empty input"),
+  SVN_TEST_PASS2(test_compress_lz4_hc,
+                 "test svn__compress_lz4_hc()"),
   SVN_TEST_NULL
 };
 
@@ -28,6 +28,7 @@
 #include "svn_base64.h"
 #include <apr_general.h>
 
+#include "private/svn_cpu.h"
 #include "private/svn_io_private.h"
 
 #include "../svn_test.h"
@@ -772,6 +773,112 @@ test_stream_base64_2(apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+/* Set *RESULT to the base64 encoding (if ENCODE is set, using
+ * BREAK_LINES) or decoding of SOURCE.  Feed the data to the stream in
+ * chunks of random size based on SEED.  Allocate *RESULT in POOL. */
+static svn_error_t *
+base64_in_chunks(svn_stringbuf_t **result,
+                 const svn_stringbuf_t *source,
+                 svn_boolean_t encode,
+                 svn_boolean_t break_lines,
+                 apr_uint32_t *seed,
+                 apr_pool_t *pool)
+{
+  svn_stream_t *stream;
+  apr_size_t pos = 0;
+
+  *result = svn_stringbuf_create_empty(pool);
+  stream = svn_stream_from_stringbuf(*result, pool);
+  stream = encode ? svn_base64_encode2(stream, break_lines, pool)
+                  : svn_base64_decode(stream, pool);
+
+  while (pos < source->len)
+    {
+      apr_size_t len = 1 + svn_test_rand(seed) % 300;
+      if (len > source->len - pos)
+        len = source->len - pos;
+
+      SVN_ERR(svn_stream_write(stream, source->data + pos, &len));
+      pos += len;
+    }
+
+  return svn_error_trace(svn_stream_close(stream));
+}
+
+/* The SIMD base64 kernels must produce the same output as the portable
+ * code, for valid as well as for corrupted input. */
+static svn_error_t *
+test_stream_base64_kernels(apr_pool_t *pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  apr_uint32_t old_mask = svn_cpu__set_features_mask(~(apr_uint32_t)0);
+  apr_uint32_t seed = 0xba5e64;
+  svn_error_t *err = SVN_NO_ERROR;
+  int i;
+
+  for (i = 0; i < 400 && !err; ++i)
+    {
+      svn_boolean_t break_lines = i & 1;
+      svn_boolean_t corrupt = (i % 3) == 0;
+      apr_size_t len = svn_test_rand(&seed) % 3000;
+      svn_stringbuf_t *data;
+      svn_stringbuf_t *encoded, *encoded_plain, *decoded, *decoded_plain;
+      apr_size_t k;
+
+      svn_pool_clear(iterpool);
+      data = svn_stringbuf_create_ensure(len, iterpool);
+      for (k = 0; k < len; ++k)
+        svn_stringbuf_appendbyte(data, (char)svn_test_rand(&seed));
+
+      svn_cpu__set_features_mask(~(apr_uint32_t)0);
+      err = base64_in_chunks(&encoded, data, TRUE, break_lines, &seed,
+                             iterpool);
+      svn_cpu__set_features_mask(0);
+      if (!err)
+        err = base64_in_chunks(&encoded_plain, data, TRUE, break_lines,
+                               &seed, iterpool);
+      if (err)
+        break;
+
+      if (!svn_stringbuf_compare(encoded, encoded_plain))
+        {
+          err = svn_error_createf(SVN_ERR_TEST_FAILED, NULL,
+                                  "Encoding mismatch for %d bytes", (int)len);
+          break;
+        }
+
+      /* Sprinkle special and invalid chars over the encoded data. */
+      if (corrupt && encoded->len)
+        for (k = 0; k < 3; ++k)
+          encoded->data[svn_test_rand(&seed) % encoded->len]
+            = "\n=*\x80 "[svn_test_rand(&seed) % 5];
+
+      svn_cpu__set_features_mask(~(apr_uint32_t)0);
+      err = base64_in_chunks(&decoded, encoded, FALSE, FALSE, &seed,
+                             iterpool);
+      svn_cpu__set_features_mask(0);
+      if (!err)
+        err = base64_in_chunks(&decoded_plain, encoded, FALSE, FALSE, &seed,
+                               iterpool);
+      if (err)
+        break;
+
+      if (!svn_stringbuf_compare(decoded, decoded_plain))
+        err = svn_error_createf(SVN_ERR_TEST_FAILED, NULL,
+                                "Decoding mismatch for '%s'",
+                                encoded->data);
+      else if (!corrupt && !svn_stringbuf_compare(decoded, data))
+        err = svn_error_createf(SVN_ERR_TEST_FAILED, NULL,
+                                "Round trip failed for '%s'",
+                                encoded->data);
+    }
+
+  svn_cpu__set_features_mask(old_mask);
+  svn_pool_destroy(iterpool);
+
+  return svn_error_trace(err);
+}
+
 static svn_error_t *
 test_stringbuf_from_stream(apr_pool_t *pool)
 {
@@ -1000,6 +1107,40 @@ test_stream_readline_file_crlf(apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+static svn_error_t *
+test_stream_write_buffer(apr_pool_t *pool)
+{
+  svn_stringbuf_t *str = svn_stringbuf_create("abc", pool);
+  svn_stream_t *stream = svn_stream_from_stringbuf(str, pool);
+  char *buffer;
+  apr_size_t len;
+
+  /* Stringbuf streams hand out their unused tail ... */
+  SVN_ERR(svn_stream__get_write_buffer(&buffer, stream, 10000));
+  SVN_TEST_ASSERT(buffer == str->data + str->len);
+  memset(buffer, 'x', 10000);
+
+  /* ... and take what has been put there without copying it. */
+  len = 10000;
+  SVN_ERR(svn_stream_write(stream, buffer, &len));
+  SVN_TEST_ASSERT(str->len == 10003);
+  SVN_TEST_ASSERT(str->data[str->len] == '\0');
+  SVN_TEST_ASSERT(str->data[2] == 'c' && str->data[10002] == 'x');
+
+  /* Regular writes still work. */
+  len = 3;
+  SVN_ERR(svn_stream_write(stream, "def", &len));
+  SVN_TEST_ASSERT(str->len == 10006);
+  SVN_TEST_STRING_ASSERT(str->data + 10003, "def");
+
+  /* Other streams don't provide buffers. */
+  SVN_ERR(svn_stream__get_write_buffer(&buffer, svn_stream_empty(pool),
+                                       100));
+  SVN_TEST_ASSERT(buffer == NULL);
+
+  return SVN_NO_ERROR;
+}
+
 /* The test table.  */
 
 static int max_threads = 1;
@@ -1037,6 +1178,10 @@ static struct svn_test_descriptor_t test_funcs[] =
                    "test reading LF-terminated lines from file"),
     SVN_TEST_PASS2(test_stream_readline_file_crlf,
                    "test reading CRLF-terminated lines from file"),
+    SVN_TEST_PASS2(test_stream_base64_kernels,
+                   "test SIMD base64 kernels against portable code"),
+    SVN_TEST_PASS2(test_stream_write_buffer,
+                   "test write buffers of stringbuf streams"),
     SVN_TEST_NULL
   };
 
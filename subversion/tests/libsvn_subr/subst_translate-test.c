@@ -28,10 +28,13 @@
 #include "../svn_test.h"
 
 #include "svn_types.h"
+#include "svn_pools.h"
 #include "svn_string.h"
 #include "svn_subst.h"
 #include "svn_hash.h"
 
+#include "private/svn_cpu.h"
+
 #define ARRAY_LEN(ary) ((sizeof (ary)) / (sizeof ((ary)[0])))
 
 /* Test inputs and expected output for svn_subst_translate_string2(). */
@@ -500,6 +503,104 @@ test_svn_subst_long_keywords(apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+/* Translate SOURCE to EOL_STR with keyword expansion using KEYWORDS,
+ * writing it to the translating stream in chunks of random size taken
+ * from *SEED.  Return the result in *RESULT, allocated in POOL. */
+static svn_error_t *
+translate_in_chunks(const char **result,
+                    const svn_stringbuf_t *source,
+                    const char *eol_str,
+                    apr_hash_t *keywords,
+                    apr_uint32_t *seed,
+                    apr_pool_t *pool)
+{
+  svn_stringbuf_t *dst_stringbuf = svn_stringbuf_create_empty(pool);
+  svn_stream_t *dst_stream = svn_stream_from_stringbuf(dst_stringbuf, pool);
+  apr_size_t pos = 0;
+
+  dst_stream = svn_subst_stream_translated(dst_stream, eol_str, TRUE,
+                                           keywords, TRUE, pool);
+  while (pos < source->len)
+    {
+      apr_size_t len = 1 + svn_test_rand(seed) % 100;
+      if (len > source->len - pos)
+        len = source->len - pos;
+
+      SVN_ERR(svn_stream_write(dst_stream, source->data + pos, &len));
+      pos += len;
+    }
+
+  SVN_ERR(svn_stream_close(dst_stream));
+  *result = dst_stringbuf->data;
+
+  return SVN_NO_ERROR;
+}
+
+/* Compare translation to LF, which uses a bulk copy path, with the
+ * translation to CRLF for random text with mixed EOLs and keywords.
+ * Also, the vectorized scanners must not make a difference. */
+static svn_error_t *
+test_svn_subst_translate_random(apr_pool_t *pool)
+{
+  static const char *const pieces[] =
+    {
+      "int x = 0;", " ", "abcdefghijklmnopqrstuvwxyz0123456789",
+      "\n", "\n", "\r", "\r\n", "\n\r", "$", "$Rev$", "$Rev: 12 $",
+      "$Id$", "$$"
+    };
+  apr_hash_t *keywords = apr_hash_make(pool);
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  apr_uint32_t old_mask = svn_cpu__set_features_mask(~(apr_uint32_t)0);
+  apr_uint32_t seed = 0x5eed;
+  svn_error_t *err = SVN_NO_ERROR;
+  int i;
+
+  svn_hash_sets(keywords, "Rev", svn_string_create("42", pool));
+
+  for (i = 0; i < 300 && !err; ++i)
+    {
+      svn_stringbuf_t *source;
+      const char *lf_simd, *lf_plain, *crlf;
+      svn_stringbuf_t *normalized;
+      apr_size_t count = svn_test_rand(&seed) % 400;
+      apr_size_t k;
+
+      svn_pool_clear(iterpool);
+      source = svn_stringbuf_create_empty(iterpool);
+      for (k = 0; k < count; ++k)
+        svn_stringbuf_appendcstr(source,
+                                 pieces[svn_test_rand(&seed)
+                                        % ARRAY_LEN(pieces)]);
+
+      svn_cpu__set_features_mask(~(apr_uint32_t)0);
+      err = translate_in_chunks(&lf_simd, source, "\n", keywords, &seed,
+                                iterpool);
+      if (!err)
+        err = translate_in_chunks(&crlf, source, "\r\n", keywords, &seed,
+                                  iterpool);
+
+      svn_cpu__set_features_mask(0);
+      if (!err)
+        err = translate_in_chunks(&lf_plain, source, "\n", keywords, &seed,
+                                  iterpool);
+      if (err)
+        break;
+
+      normalized = svn_stringbuf_create(crlf, iterpool);
+      svn_stringbuf_replace_all(normalized, "\r\n", "\n");
+
+      if (strcmp(lf_simd, normalized->data) || strcmp(lf_simd, lf_plain))
+        err = svn_error_createf(SVN_ERR_TEST_FAILED, NULL,
+                                "Translation mismatch for input '%s'",
+                                source->data);
+    }
+
+  svn_cpu__set_features_mask(old_mask);
+  svn_pool_destroy(iterpool);
+
+  return svn_error_trace(err);
+}
+
 static int max_threads = 1;
 
 static struct svn_test_descriptor_t test_funcs[] =
@@ -519,6 +620,8 @@ static struct svn_test_descriptor_t test_funcs[] =
                    "test truncated keywords (issue 4349)"),
     SVN_TEST_PASS2(test_svn_subst_long_keywords,
                    "test long keywords (issue 4350)"),
+    SVN_TEST_PASS2(test_svn_subst_translate_random,
+                   "test translation of random text in chunks"),
     SVN_TEST_NULL
   };
 
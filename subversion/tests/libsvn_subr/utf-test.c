@@ -25,6 +25,7 @@
 #include "svn_utf.h"
 #include "svn_pools.h"
 
+#include "private/svn_cpu.h"
 #include "private/svn_string_private.h"
 #include "private/svn_utf_private.h"
 
@@ -215,6 +216,93 @@ utf_validate2(apr_pool_t *pool)
   return SVN_NO_ERROR;
 }
 
+/* Compare the SIMD validation kernels with the plain FSM using random
+   strings long enough to cover several blocks.  Mostly valid characters
+   are mixed with random bytes and with specific malformed sequences. */
+static svn_error_t *
+utf_validate_kernels(apr_pool_t *pool)
+{
+  static const char *const valid[] =
+    {
+      "a", "\x7F", "\xC2\x80", "\xDF\xBF", "\xE0\xA0\x80",
+      "\xED\x9F\xBF", "\xEE\x80\x80", "\xF0\x90\x80\x80",
+      "\xF3\xBF\xBF\xBF", "\xF4\x8F\xBF\xBF"
+    };
+  static const char *const invalid[] =
+    {
+      "\x80", "\xBF\xBF", "\xC0\x80", "\xC1\xBF", "\xC2",
+      "\xE0\x9F\xBF", "\xE1\x80", "\xED\xA0\x80", "\xF0\x8F\xBF\xBF",
+      "\xF0\x90\x80", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xFF"
+    };
+  static const apr_uint32_t kernel_masks[] =
+    {
+      SVN_CPU__SSE2 | SVN_CPU__SSSE3,
+      SVN_CPU__SSE2 | SVN_CPU__SSSE3 | SVN_CPU__SSE4_1,
+      ~(apr_uint32_t)0
+    };
+  apr_uint32_t old_mask = svn_cpu__set_features_mask(0);
+  svn_error_t *err = SVN_NO_ERROR;
+  int i;
+
+  seed_val();
+
+  for (i = 0; i < 20000 && !err; ++i)
+    {
+      char str[400];
+      apr_size_t len = 0;
+      apr_size_t target_len = range_rand(0, 300);
+      const char *last;
+      svn_boolean_t is_valid;
+      apr_size_t k;
+
+      while (len < target_len)
+        {
+          apr_uint32_t kind = range_rand(0, 99);
+          const char *chr;
+
+          if (kind < 2)
+            chr = invalid[range_rand(0, sizeof(invalid) / sizeof(*invalid)
+                                        - 1)];
+          else if (kind < 5)
+            {
+              str[len++] = (char)range_rand(0, 255);
+              continue;
+            }
+          else if (kind < 50)
+            chr = valid[0];
+          else
+            chr = valid[range_rand(0, sizeof(valid) / sizeof(*valid) - 1)];
+
+          memcpy(str + len, chr, strlen(chr));
+          len += strlen(chr);
+        }
+
+      /* The plain FSM is our reference. */
+      svn_cpu__set_features_mask(0);
+      last = svn_utf__last_valid(str, len);
+      is_valid = svn_utf__is_valid(str, len);
+
+      for (k = 0; k < sizeof(kernel_masks) / sizeof(*kernel_masks); ++k)
+        {
+          svn_cpu__set_features_mask(kernel_masks[k]);
+          if (   svn_utf__last_valid(str, len) != last
+              || svn_utf__is_valid(str, len) != is_valid)
+            {
+              err = svn_error_createf(SVN_ERR_TEST_FAILED, NULL,
+                                      "SIMD validation test %d failed "
+                                      "with features %s", i,
+                                      svn_cpu__features_string(
+                                          svn_cpu__features(), pool));
+              break;
+            }
+        }
+    }
+
+  svn_cpu__set_features_mask(old_mask);
+
+  return svn_error_trace(err);
+}
+
 /* Test conversion from different codepages to utf8. */
 static svn_error_t *
 test_utf_cstring_to_utf8_ex2(apr_pool_t *pool)
@@ -1010,6 +1098,8 @@ static struct svn_test_descriptor_t test_funcs[] =
                    "test is_valid/last_valid"),
     SVN_TEST_PASS2(utf_validate2,
                    "test last_valid/last_valid2"),
+    SVN_TEST_PASS2(utf_validate_kernels,
+                   "test SIMD UTF-8 validation vs. FSM"),
     SVN_TEST_PASS2(test_utf_cstring_to_utf8_ex2,
                    "test svn_utf_cstring_to_utf8_ex2"),
     SVN_TEST_PASS2(test_utf_cstring_from_utf8_ex2,
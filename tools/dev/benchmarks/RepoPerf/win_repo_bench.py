@@ -66,6 +66,10 @@ svnserve_params = {
   'fast':"-M 1024 -c 0 --cache-revprops yes --block-read yes --client-speed 1000"
 }
 
+# FSFS rev / pack file access modes to compare.  The value is the setting
+# of "memory-map-revision-files" in the repositories' fsfs.conf.
+fsfs_io_modes = [('buffered', 'false'), ('mmap', 'true')]
+
 
 def clear_memory():
   """ Clear in-RAM portion of the file / disk cache """
@@ -184,12 +188,30 @@ def set_config(config):
   shutil.copyfile(apache_config_template, apache_config_file)
 
 
-def run_test_cs_configurations(command, args):
+def set_fsfs_io_mode(value):
+  """ Set "memory-map-revision-files" to VALUE in the fsfs.conf of all
+      copies of all REPOSITORIES. """
+
+  option = 'memory-map-revision-files'
+  for run in range(0, repetitions):
+    for repository in repositories:
+      conf_path = os.path.join(repo_parent, repository + str(run),
+                               'db', 'fsfs.conf')
+      with open(conf_path) as conf_file:
+        lines = [line for line in conf_file
+                 if not line.strip().startswith(option)]
+      lines.append('\n[io]\n%s = %s\n' % (option, value))
+      with open(conf_path, 'w') as conf_file:
+        conf_file.writelines(lines)
+
+
+def run_test_cs_configurations(command, args, title=None):
   """ Run client COMMAND with basic arguments ARGS in all configurations
-      repeatedly with all servers on all repositories. """
+      repeatedly with all servers on all repositories.  Show TITLE in the
+      output, defaulting to COMMAND. """
 
   print
-  print(command)
+  print(title or command)
   print("")
 
   for config in configurations:
@@ -262,6 +284,13 @@ def bench():
   run_test_cs_configurations('null-log', ['-v', '--limit', '50000', '-q'])
   run_test_cs_configurations('null-export', ['-q'])
 
+  # Compare buffered with memory-mapped reading of rev / pack files.
+  for mode, value in fsfs_io_modes:
+    set_fsfs_io_mode(value)
+    run_test_cs_configurations('null-export', ['-q'],
+                               'null-export (' + mode + ')')
+  set_fsfs_io_mode('false')
+
   run_test_admin_configurations('dump', ['-q'])
 
 # main function
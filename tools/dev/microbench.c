@@ -0,0 +1,1460 @@
+/* microbench.c -- micro-benchmarks for performance-critical kernels
+ *
+ * ====================================================================
+ *    Licensed to the Apache Software Foundation (ASF) under one
+ *    or more contributor license agreements.  See the NOTICE file
+ *    distributed with this work for additional information
+ *    regarding copyright ownership.  The ASF licenses this file
+ *    to you under the Apache License, Version 2.0 (the
+ *    "License"); you may not use this file except in compliance
+ *    with the License.  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing,
+ *    software distributed under the License is distributed on an
+ *    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ *    KIND, either express or implied.  See the License for the
+ *    specific language governing permissions and limitations
+ *    under the License.
+ * ====================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <apr_thread_proc.h>
+#include <apr_time.h>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+#include "svn_pools.h"
+#include "svn_base64.h"
+#include "svn_checksum.h"
+#include "svn_cmdline.h"
+#include "svn_delta.h"
+#include "svn_diff.h"
+#include "svn_error.h"
+#include "svn_hash.h"
+#include "svn_io.h"
+#include "svn_sorts.h"
+#include "svn_string.h"
+#include "svn_subst.h"
+
+#include "private/svn_adler32.h"
+#include "private/svn_cache.h"
+#include "private/svn_cpu.h"
+#include "private/svn_delta_private.h"
+#include "private/svn_subr_private.h"
+#include "private/svn_utf_private.h"
+
+#include "svn_private_config.h"
+
+/* Default size of the test data in KB and number of passes over it. */
+#define DEFAULT_SIZE_KB 1024
+#define DEFAULT_PASSES 1000
+
+/* CPU feature masks that select the various SIMD kernels, starting with
+ * the portable implementations. */
+static const apr_uint32_t kernel_masks[] =
+  {
+    0,
+    SVN_CPU__SSE2,
+    SVN_CPU__SSE2 | SVN_CPU__SSSE3,
+    SVN_CPU__SSE2 | SVN_CPU__SSSE3 | SVN_CPU__SSE4_1,
+    ~(apr_uint32_t)0
+  };
+
+/* Parameters common to all benchmarks. */
+typedef struct bench_params_t
+{
+  /* Test data, SIZE bytes of pseudo-random content. */
+  char *data;
+  apr_size_t size;
+
+  /* Number of times to process DATA. */
+  int passes;
+} bench_params_t;
+
+/* Signature of a benchmark function. */
+typedef svn_error_t *(*bench_func_t)(const bench_params_t *params,
+                                     apr_pool_t *pool);
+
+/* Print the throughput for processing BYTES of data within the time since
+ * START, prefixed by NAME and the effective CPU feature set.  Use POOL for
+ * temporaries. */
+static svn_error_t *
+print_throughput(const char *name,
+                 apr_uint64_t bytes,
+                 apr_time_t start,
+                 apr_pool_t *pool)
+{
+  apr_time_t elapsed = apr_time_now() - start;
+  double gb_per_sec = elapsed
+                    ? (double)bytes / (double)elapsed / 1000.0
+                    : 0.0;
+
+  return svn_error_trace(svn_cmdline_printf(pool, "%-12s %-30s %8.2f GB/s\n",
+                           name,
+                           svn_cpu__features_string(svn_cpu__features(),
+                                                    pool),
+                           gb_per_sec));
+}
+
+/* Print the rate of OPERATIONS per second within the time since START,
+ * prefixed by NAME and DETAILS.  Use POOL for temporaries. */
+static svn_error_t *
+print_rate(const char *name,
+           const char *details,
+           apr_uint64_t operations,
+           apr_time_t start,
+           apr_pool_t *pool)
+{
+  apr_time_t elapsed = apr_time_now() - start;
+  double mops_per_sec = elapsed
+                      ? (double)operations / (double)elapsed
+                      : 0.0;
+
+  return svn_error_trace(svn_cmdline_printf(pool,
+                                            "%-12s %-30s %8.2f Mops/s\n",
+                                            name, details, mops_per_sec));
+}
+
+/* Print the average time per operation for OPERATIONS done within the
+ * time since START, prefixed by NAME and DETAILS.  Use POOL for
+ * temporaries. */
+static svn_error_t *
+print_latency(const char *name,
+              const char *details,
+              apr_uint64_t operations,
+              apr_time_t start,
+              apr_pool_t *pool)
+{
+  apr_time_t elapsed = apr_time_now() - start;
+  double usec_per_op = operations
+                     ? (double)elapsed / (double)operations
+                     : 0.0;
+
+  return svn_error_trace(svn_cmdline_printf(pool,
+                                            "%-12s %-30s %10.1f us\n",
+                                            name, details, usec_per_op));
+}
+
+/* Run FUNC once for each entry in KERNEL_MASKS that selects a different
+ * set of CPU features.  Restore the original mask afterwards. */
+static svn_error_t *
+for_each_kernel(bench_func_t func,
+                const bench_params_t *params,
+                apr_pool_t *pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  apr_uint32_t old_mask = svn_cpu__set_features_mask(~(apr_uint32_t)0);
+  apr_uint32_t last_features = ~(apr_uint32_t)0;
+  svn_error_t *err = SVN_NO_ERROR;
+  apr_size_t i;
+
+  for (i = 0; i < sizeof(kernel_masks) / sizeof(kernel_masks[0]); ++i)
+    {
+      svn_pool_clear(iterpool);
+
+      svn_cpu__set_features_mask(kernel_masks[i]);
+      if (svn_cpu__features() == last_features)
+        continue;
+
+      last_features = svn_cpu__features();
+      err = func(params, iterpool);
+      if (err)
+        break;
+    }
+
+  svn_cpu__set_features_mask(old_mask);
+  svn_pool_destroy(iterpool);
+
+  return svn_error_trace(err);
+}
+
+/* Implements bench_func_t for svn__adler32(). */
+static svn_error_t *
+bench_adler32(const bench_params_t *params,
+              apr_pool_t *pool)
+{
+  apr_time_t start = apr_time_now();
+  apr_uint32_t sum = 0;
+  int i;
+
+  for (i = 0; i < params->passes; ++i)
+    sum = svn__adler32(sum, params->data, params->size);
+
+  /* Make the result observable so it does not get optimized away. */
+  if (sum == 0)
+    SVN_ERR(svn_cmdline_printf(pool, "(zero checksum)\n"));
+
+  return svn_error_trace(print_throughput("adler32",
+                                          (apr_uint64_t)params->size
+                                            * params->passes,
+                                          start, pool));
+}
+
+/* Implements bench_func_t for svn__adler32_blocks() as used by xdelta. */
+static svn_error_t *
+bench_adler32_blocks(const bench_params_t *params,
+                     apr_pool_t *pool)
+{
+  enum { BLOCK_SIZE = 64, BATCH = 256 };
+  apr_uint32_t sums[BATCH];
+  apr_uint32_t total = 0;
+  apr_time_t start = apr_time_now();
+  apr_size_t count = params->size / (BLOCK_SIZE * BATCH);
+  apr_size_t k;
+  int i;
+
+  for (i = 0; i < params->passes; ++i)
+    for (k = 0; k < count; ++k)
+      {
+        svn__adler32_blocks(sums, params->data + k * BLOCK_SIZE * BATCH,
+                            BLOCK_SIZE, BATCH);
+        total += sums[BATCH - 1];
+      }
+
+  if (total == 0)
+    SVN_ERR(svn_cmdline_printf(pool, "(zero checksum)\n"));
+
+  return svn_error_trace(print_throughput("adler32x64",
+                                          (apr_uint64_t)count * BATCH
+                                            * BLOCK_SIZE * params->passes,
+                                          start, pool));
+}
+
+/* Implements bench_func_t, running all Adler-32 benchmarks. */
+static svn_error_t *
+run_adler32(const bench_params_t *params,
+            apr_pool_t *pool)
+{
+  SVN_ERR(for_each_kernel(bench_adler32, params, pool));
+  SVN_ERR(for_each_kernel(bench_adler32_blocks, params, pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements bench_func_t for svn_checksum() with SHA-1. */
+static svn_error_t *
+bench_sha1(const bench_params_t *params,
+           apr_pool_t *pool)
+{
+  apr_time_t start = apr_time_now();
+  svn_checksum_t *checksum;
+  int i;
+
+  for (i = 0; i < params->passes; ++i)
+    SVN_ERR(svn_checksum(&checksum, svn_checksum_sha1, params->data,
+                         params->size, pool));
+
+  return svn_error_trace(print_throughput("sha1",
+                                          (apr_uint64_t)params->size
+                                            * params->passes,
+                                          start, pool));
+}
+
+/* Implements bench_func_t comparing separate MD5 and SHA-1 contexts with
+ * the fused context. */
+static svn_error_t *
+bench_md5_sha1(const bench_params_t *params,
+               apr_pool_t *pool)
+{
+  enum { CHUNK_SIZE = 0x4000 };
+  apr_uint64_t total = (apr_uint64_t)params->size * params->passes;
+  svn_checksum_ctx_t *md5_ctx = svn_checksum_ctx_create(svn_checksum_md5,
+                                                        pool);
+  svn_checksum_ctx_t *sha1_ctx = svn_checksum_ctx_create(svn_checksum_sha1,
+                                                         pool);
+  svn_checksum__md5_sha1_ctx_t *fused_ctx
+    = svn_checksum__md5_sha1_ctx_create(pool);
+  svn_checksum_t *md5, *sha1;
+  apr_time_t start;
+  apr_size_t pos;
+  int i;
+
+  /* Stream-like usage with typical write sizes. */
+  start = apr_time_now();
+  for (i = 0; i < params->passes; ++i)
+    for (pos = 0; pos + CHUNK_SIZE <= params->size; pos += CHUNK_SIZE)
+      {
+        SVN_ERR(svn_checksum_update(md5_ctx, params->data + pos,
+                                    CHUNK_SIZE));
+        SVN_ERR(svn_checksum_update(sha1_ctx, params->data + pos,
+                                    CHUNK_SIZE));
+      }
+
+  SVN_ERR(svn_checksum_final(&md5, md5_ctx, pool));
+  SVN_ERR(svn_checksum_final(&sha1, sha1_ctx, pool));
+  SVN_ERR(print_throughput("md5+sha1", total, start, pool));
+
+  start = apr_time_now();
+  for (i = 0; i < params->passes; ++i)
+    for (pos = 0; pos + CHUNK_SIZE <= params->size; pos += CHUNK_SIZE)
+      svn_checksum__md5_sha1_update(fused_ctx, params->data + pos,
+                                    CHUNK_SIZE);
+
+  svn_checksum__md5_sha1_final(&md5, &sha1, fused_ctx, pool);
+
+  return svn_error_trace(print_throughput("md5_sha1", total, start, pool));
+}
+
+/* Implements bench_func_t for svn_checksum__multi() with MD5 on 4k texts,
+ * i.e. typical small file sizes. */
+static svn_error_t *
+bench_md5_multi(const bench_params_t *params,
+                apr_pool_t *pool)
+{
+  enum { TEXT_SIZE = 0x1000 };
+  apr_size_t count = params->size / TEXT_SIZE;
+  apr_array_header_t *contents = apr_array_make(pool, (int)count,
+                                                sizeof(svn_string_t *));
+  apr_array_header_t *checksums;
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  apr_time_t start;
+  apr_size_t k;
+  int i;
+
+  for (k = 0; k < count; ++k)
+    APR_ARRAY_PUSH(contents, svn_string_t *)
+      = svn_string_ncreate(params->data + k * TEXT_SIZE, TEXT_SIZE, pool);
+
+  start = apr_time_now();
+  for (i = 0; i < params->passes; ++i)
+    {
+      svn_pool_clear(iterpool);
+      SVN_ERR(svn_checksum__multi(&checksums, svn_checksum_md5, contents,
+                                  iterpool, iterpool));
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return svn_error_trace(print_throughput("md5x4k",
+                                          (apr_uint64_t)count * TEXT_SIZE
+                                            * params->passes,
+                                          start, pool));
+}
+
+/* Implements bench_func_t, running all checksum benchmarks. */
+static svn_error_t *
+run_checksum(const bench_params_t *params,
+             apr_pool_t *pool)
+{
+  SVN_ERR(for_each_kernel(bench_sha1, params, pool));
+  SVN_ERR(for_each_kernel(bench_md5_sha1, params, pool));
+  SVN_ERR(for_each_kernel(bench_md5_multi, params, pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements bench_func_t for svn__fnv1a_32x4(). */
+static svn_error_t *
+bench_fnv1a(const bench_params_t *params,
+            apr_pool_t *pool)
+{
+  apr_time_t start = apr_time_now();
+  apr_uint32_t sum = 0;
+  int i;
+
+  for (i = 0; i < params->passes; ++i)
+    sum += svn__fnv1a_32x4(params->data, params->size);
+
+  /* Make the result observable so it does not get optimized away. */
+  if (sum == 0)
+    SVN_ERR(svn_cmdline_printf(pool, "(zero checksum)\n"));
+
+  return svn_error_trace(print_throughput("fnv1a",
+                                          (apr_uint64_t)params->size
+                                            * params->passes,
+                                          start, pool));
+}
+
+/* Implements bench_func_t for svn__fnv1a_32x4_multi() on 4k items,
+ * i.e. typical p2l item sizes. */
+static svn_error_t *
+bench_fnv1a_multi(const bench_params_t *params,
+                  apr_pool_t *pool)
+{
+  enum { ITEM_SIZE = 0x1000 };
+  apr_size_t count = params->size / ITEM_SIZE;
+  const void **data = apr_palloc(pool, count * sizeof(*data));
+  apr_size_t *lens = apr_palloc(pool, count * sizeof(*lens));
+  apr_uint32_t *digests = apr_palloc(pool, count * sizeof(*digests));
+  apr_time_t start;
+  apr_size_t k;
+  int i;
+
+  for (k = 0; k < count; ++k)
+    {
+      data[k] = params->data + k * ITEM_SIZE;
+      lens[k] = ITEM_SIZE;
+    }
+
+  start = apr_time_now();
+  for (i = 0; i < params->passes; ++i)
+    svn__fnv1a_32x4_multi(digests, data, lens, count);
+
+  return svn_error_trace(print_throughput("fnv1ax4k",
+                                          (apr_uint64_t)count * ITEM_SIZE
+                                            * params->passes,
+                                          start, pool));
+}
+
+/* Implements bench_func_t, running all FNV-1a benchmarks. */
+static svn_error_t *
+run_fnv1a(const bench_params_t *params,
+          apr_pool_t *pool)
+{
+  SVN_ERR(for_each_kernel(bench_fnv1a, params, pool));
+  SVN_ERR(for_each_kernel(bench_fnv1a_multi, params, pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements bench_func_t for svn_utf__is_valid() on mixed ASCII /
+ * multi-byte text as well as on pure ASCII. */
+static svn_error_t *
+bench_utf8(const bench_params_t *params,
+           apr_pool_t *pool)
+{
+  static const char sample[]
+    = "Log message: Fix the \xC3\xA9l\xC3\xA8ve handling in "
+      "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E paths \xF0\x9F\x98\x80. ";
+  char *text = apr_palloc(pool, params->size);
+  char *ascii = apr_palloc(pool, params->size);
+  apr_uint64_t total = (apr_uint64_t)params->size * params->passes;
+  apr_size_t len = 0;
+  apr_time_t start;
+  svn_boolean_t valid = TRUE;
+  int i;
+
+  /* Fill with complete copies of SAMPLE only, so TEXT remains valid. */
+  while (len + sizeof(sample) - 1 <= params->size)
+    {
+      memcpy(text + len, sample, sizeof(sample) - 1);
+      len += sizeof(sample) - 1;
+    }
+
+  memset(text + len, 'x', params->size - len);
+  memset(ascii, 'x', params->size);
+
+  start = apr_time_now();
+  for (i = 0; i < params->passes; ++i)
+    valid &= svn_utf__is_valid(text, params->size);
+
+  SVN_ERR(print_throughput("utf8", total, start, pool));
+
+  start = apr_time_now();
+  for (i = 0; i < params->passes; ++i)
+    valid &= svn_utf__is_valid(ascii, params->size);
+
+  SVN_ERR(print_throughput("utf8-ascii", total, start, pool));
+
+  if (!valid)
+    SVN_ERR(svn_cmdline_printf(pool, "(invalid UTF-8)\n"));
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements bench_func_t, running all UTF-8 benchmarks. */
+static svn_error_t *
+run_utf8(const bench_params_t *params,
+         apr_pool_t *pool)
+{
+  return svn_error_trace(for_each_kernel(bench_utf8, params, pool));
+}
+
+/* Pass the TEXT of SIZE bytes PASSES times through a translating stream
+ * with the given EOL_STR and KEYWORDS and print the throughput labeled
+ * NAME.  Use POOL for allocations. */
+static svn_error_t *
+translate_text(const char *name,
+               const char *text,
+               apr_size_t size,
+               int passes,
+               const char *eol_str,
+               apr_hash_t *keywords,
+               apr_pool_t *pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  apr_time_t start = apr_time_now();
+  int i;
+
+  for (i = 0; i < passes; ++i)
+    {
+      svn_stream_t *stream;
+      apr_size_t pos, len;
+
+      svn_pool_clear(iterpool);
+      stream = svn_subst_stream_translated(svn_stream_empty(iterpool),
+                                           eol_str, TRUE, keywords, TRUE,
+                                           iterpool);
+
+      /* Write in the chunk size used by svn_stream_copy3. */
+      for (pos = 0; pos < size; pos += len)
+        {
+          len = MIN(SVN__STREAM_CHUNK_SIZE, size - pos);
+          SVN_ERR(svn_stream_write(stream, text + pos, &len));
+        }
+
+      SVN_ERR(svn_stream_close(stream));
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return svn_error_trace(print_throughput(name,
+                                          (apr_uint64_t)size * passes,
+                                          start, pool));
+}
+
+/* Implements bench_func_t for svn_subst_stream_translated() on source
+ * code-like text with LF line endings and a few keywords, translating
+ * it the way checkout / export would. */
+static svn_error_t *
+bench_subst(const bench_params_t *params,
+            apr_pool_t *pool)
+{
+  static const char line[]
+    = "    SVN_ERR(svn_stream_write(stream, text + pos, &len)); /* x */\n";
+  static const char keyword_line[] = "/* $Id$ -- $Rev$ */\n";
+  char *text = apr_palloc(pool, params->size);
+  apr_hash_t *keywords = apr_hash_make(pool);
+  apr_size_t len = 0;
+  int lines = 0;
+
+  svn_hash_sets(keywords, "Rev", svn_string_create("1234", pool));
+  svn_hash_sets(keywords, "Id", svn_string_create("file.c 1234 user",
+                                                  pool));
+
+  /* One keyword line per 100 regular lines. */
+  while (len + sizeof(line) - 1 <= params->size)
+    {
+      const char *source = ++lines % 100 ? line : keyword_line;
+      apr_size_t source_len = strlen(source);
+
+      memcpy(text + len, source, source_len);
+      len += source_len;
+    }
+
+  SVN_ERR(translate_text("subst-lf", text, len, params->passes, "\n",
+                         NULL, pool));
+  SVN_ERR(translate_text("subst-lf-kw", text, len, params->passes, "\n",
+                         keywords, pool));
+  SVN_ERR(translate_text("subst-crlf", text, len, params->passes, "\r\n",
+                         NULL, pool));
+  SVN_ERR(translate_text("subst-kw", text, len, params->passes, NULL,
+                         keywords, pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements bench_func_t, running all translation benchmarks. */
+static svn_error_t *
+run_subst(const bench_params_t *params,
+          apr_pool_t *pool)
+{
+  return svn_error_trace(for_each_kernel(bench_subst, params, pool));
+}
+
+/* Push SIZE bytes of TEXT PASSES times through a base64 encoding stream
+ * (if ENCODE is set, with BREAK_LINES) or decoding stream and print the
+ * throughput w.r.t. the input size under NAME.  Use POOL for allocations.
+ */
+static svn_error_t *
+base64_text(const char *name,
+            const char *text,
+            apr_size_t size,
+            int passes,
+            svn_boolean_t encode,
+            svn_boolean_t break_lines,
+            apr_pool_t *pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  apr_time_t start = apr_time_now();
+  int i;
+
+  for (i = 0; i < passes; ++i)
+    {
+      svn_stream_t *stream;
+      apr_size_t pos, len;
+
+      svn_pool_clear(iterpool);
+      stream = svn_stream_empty(iterpool);
+      stream = encode ? svn_base64_encode2(stream, break_lines, iterpool)
+                      : svn_base64_decode(stream, iterpool);
+
+      /* Write in the chunk size used by svn_stream_copy3. */
+      for (pos = 0; pos < size; pos += len)
+        {
+          len = MIN(SVN__STREAM_CHUNK_SIZE, size - pos);
+          SVN_ERR(svn_stream_write(stream, text + pos, &len));
+        }
+
+      SVN_ERR(svn_stream_close(stream));
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return svn_error_trace(print_throughput(name,
+                                          (apr_uint64_t)size * passes,
+                                          start, pool));
+}
+
+/* Implements bench_func_t for base64 encoding and decoding of binary
+ * data, with and without line breaks as e.g. in svndiff windows sent
+ * over ra_serf. */
+static svn_error_t *
+bench_base64(const bench_params_t *params,
+             apr_pool_t *pool)
+{
+  svn_string_t data;
+  const svn_string_t *lines, *no_lines;
+
+  data.data = params->data;
+  data.len = params->size;
+  lines = svn_base64_encode_string2(&data, TRUE, pool);
+  no_lines = svn_base64_encode_string2(&data, FALSE, pool);
+
+  SVN_ERR(base64_text("base64-encode", data.data, data.len,
+                      params->passes, TRUE, TRUE, pool));
+  SVN_ERR(base64_text("base64-encode-nobreak", data.data, data.len,
+                      params->passes, TRUE, FALSE, pool));
+  SVN_ERR(base64_text("base64-decode", lines->data, lines->len,
+                      params->passes, FALSE, FALSE, pool));
+  SVN_ERR(base64_text("base64-decode-nobreak", no_lines->data,
+                      no_lines->len, params->passes, FALSE, FALSE, pool));
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements bench_func_t, running all base64 benchmarks. */
+static svn_error_t *
+run_base64(const bench_params_t *params,
+           apr_pool_t *pool)
+{
+  return svn_error_trace(for_each_kernel(bench_base64, params, pool));
+}
+
+/* Set *RESULT to the delta window that turns SOURCE into TARGET.  Both
+ * must fit into a single window.  Allocate the result in POOL. */
+static svn_error_t *
+make_delta_window(svn_txdelta_window_t **result,
+                  svn_stringbuf_t *source,
+                  svn_stringbuf_t *target,
+                  apr_pool_t *pool)
+{
+  svn_txdelta_stream_t *stream;
+
+  svn_txdelta2(&stream, svn_stream_from_stringbuf(source, pool),
+               svn_stream_from_stringbuf(target, pool), FALSE, pool);
+
+  return svn_error_trace(svn_txdelta_next_window(result, stream, pool));
+}
+
+/* Reconstruct the last text of the delta chain in WINDOWS[0 .. COUNT-1]
+ * from BASE by applying one window after the other, i.e. the way FSFS
+ * used to do it, using the buffers BUF1 and BUF2. */
+static void
+apply_chain(svn_txdelta_window_t **windows,
+            int count,
+            const char *base,
+            char *buf1,
+            char *buf2)
+{
+  const char *source = base;
+  int i;
+
+  for (i = 0; i < count; ++i)
+    {
+      char *target = (i % 2) ? buf2 : buf1;
+      apr_size_t len = windows[i]->tview_len;
+
+      svn_txdelta_apply_instructions(windows[i], source, target, &len);
+      source = target;
+    }
+}
+
+/* Implements bench_func_t comparing the reconstruction of texts from
+ * delta chains of 1 to 1000 windows, as in long FSFS delta chains of
+ * heavily edited files.  The text is expanded window by window, composed
+ * pairwise into a single window and composed as a whole chain. */
+static svn_error_t *
+run_compose(const bench_params_t *params,
+            apr_pool_t *pool)
+{
+  enum { MAX_CHAIN = 1000, EDITS = 4, MAX_EDIT = 64 };
+  static const int chain_lengths[]
+    = { 1, 2, 5, 10, 20, 50, 100, 200, 500, MAX_CHAIN };
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_txdelta_window_t **windows
+    = apr_palloc(pool, MAX_CHAIN * sizeof(*windows));
+  apr_size_t size = MIN(params->size, 100 * 1024);
+  svn_stringbuf_t *base = svn_stringbuf_ncreate(params->data, size, pool);
+  svn_stringbuf_t *text = base;
+  char *buf1, *buf2;
+  apr_uint32_t seed = 0xc0ffee;
+  apr_size_t i;
+  int k;
+
+  /* Each version differs from its predecessor by a few small edits. */
+  for (k = 0; k < MAX_CHAIN; ++k)
+    {
+      svn_stringbuf_t *next = svn_stringbuf_dup(text, pool);
+      int e;
+
+      for (e = 0; e < EDITS; ++e)
+        {
+          apr_size_t pos, len;
+
+          seed = seed * 1103515245 + 12345;
+          pos = (seed >> 8) % next->len;
+          len = MIN(1 + (seed >> 4) % MAX_EDIT, next->len - pos);
+          seed = seed * 1103515245 + 12345;
+          svn_stringbuf_replace(next, pos, (seed >> 24) % 2 ? len : 0,
+                                params->data + (seed >> 8) % (size - len),
+                                len);
+        }
+
+      /* Keep the texts within a single delta window. */
+      if (next->len > size)
+        svn_stringbuf_chop(next, next->len - size);
+
+      SVN_ERR(make_delta_window(&windows[k], text, next, pool));
+      text = next;
+    }
+
+  buf1 = apr_palloc(pool, size);
+  buf2 = apr_palloc(pool, size);
+
+  for (i = 0; i < sizeof(chain_lengths) / sizeof(chain_lengths[0]); ++i)
+    {
+      int count = chain_lengths[i];
+      int repeats = MAX(1, params->passes / count);
+      const char *details = apr_psprintf(pool, "%d windows", count);
+      apr_time_t start;
+      int r;
+
+      start = apr_time_now();
+      for (r = 0; r < repeats; ++r)
+        apply_chain(windows, count, base->data, buf1, buf2);
+
+      SVN_ERR(print_latency("apply", details, repeats, start, pool));
+
+      start = apr_time_now();
+      for (r = 0; r < repeats; ++r)
+        {
+          svn_txdelta_window_t *composite;
+
+          svn_pool_clear(iterpool);
+          composite = svn_txdelta_window_dup(windows[count - 1], iterpool);
+          for (k = count - 2; k >= 0; --k)
+            composite = svn_txdelta_compose_windows(windows[k], composite,
+                                                    iterpool);
+
+          apply_chain(&composite, 1, base->data, buf1, buf2);
+        }
+
+      SVN_ERR(print_latency("pairwise", details, repeats, start, pool));
+
+      start = apr_time_now();
+      for (r = 0; r < repeats; ++r)
+        {
+          svn_txdelta_window_t *composite;
+
+          svn_pool_clear(iterpool);
+          composite = svn_txdelta__compose_chain(
+                        (const svn_txdelta_window_t * const *)windows,
+                        count, iterpool);
+
+          apply_chain(&composite, 1, base->data, buf1, buf2);
+        }
+
+      SVN_ERR(print_latency("chain", details, repeats, start, pool));
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements svn_diff_output_fns_t.output_diff_modified.  Count the
+ * changes and the changed lines in the apr_off_t[2] given as BATON. */
+static svn_error_t *
+count_changes(void *baton,
+              apr_off_t original_start,
+              apr_off_t original_length,
+              apr_off_t modified_start,
+              apr_off_t modified_length,
+              apr_off_t latest_start,
+              apr_off_t latest_length)
+{
+  apr_off_t *counts = baton;
+
+  counts[0]++;
+  counts[1] += original_length + modified_length;
+
+  return SVN_NO_ERROR;
+}
+
+/* Fill ORIGINAL and MODIFIED with about LINE_COUNT lines of a diff test
+ * case of the given KIND, using SEED as random number generator state. */
+static void
+make_diff_texts(svn_stringbuf_t *original,
+                svn_stringbuf_t *modified,
+                const char *kind,
+                int line_count,
+                apr_uint32_t *seed,
+                apr_pool_t *pool)
+{
+  int i;
+
+  if (strcmp(kind, "lockfile") == 0)
+    {
+      /* Package lists with many identical lines, a quarter of the
+       * versions bumped and some packages added or removed. */
+      for (i = 0; i < line_count / 4; i++)
+        {
+          const char *name = apr_psprintf(pool, "{\n  \"name\": \"pkg-%d\",\n",
+                                          i);
+          apr_uint32_t version, r;
+
+          *seed = *seed * 1103515245 + 12345;
+          version = (*seed >> 8) % 1000;
+          r = (*seed >> 20) % 16;
+
+          svn_stringbuf_appendcstr(original, name);
+          svn_stringbuf_appendcstr(original,
+                                   apr_psprintf(pool,
+                                                "  \"version\": \"1.%u\"\n"
+                                                "},\n", version));
+          if (r == 0)
+            continue;
+
+          if (r == 1)
+            svn_stringbuf_appendcstr(modified,
+                                     apr_psprintf(pool,
+                                                  "{\n"
+                                                  "  \"name\": \"new-%d\",\n"
+                                                  "  \"version\": \"1.0\"\n"
+                                                  "},\n", i));
+
+          svn_stringbuf_appendcstr(modified, name);
+          svn_stringbuf_appendcstr(modified,
+                                   apr_psprintf(pool,
+                                                "  \"version\": \"1.%u\"\n"
+                                                "},\n",
+                                                r < 6 ? version + 1
+                                                      : version));
+        }
+    }
+  else if (strcmp(kind, "generated") == 0)
+    {
+      /* Generated code consisting of almost identical blocks, with some
+       * of them removed and some boilerplate added. */
+      for (i = 0; i < line_count / 8; i++)
+        {
+          const char *block = apr_psprintf(pool,
+                                           "    case %d:\n"
+                                           "      x = y;\n"
+                                           "      y = z;\n"
+                                           "      z = 0;\n"
+                                           "      break;\n"
+                                           "\n"
+                                           "    default:\n"
+                                           "      break;\n", i);
+
+          *seed = *seed * 1103515245 + 12345;
+          svn_stringbuf_appendcstr(original, block);
+          if ((*seed >> 8) % 8 == 0)
+            continue;
+
+          if ((*seed >> 8) % 8 == 1)
+            svn_stringbuf_appendcstr(modified,
+                                     "      x = y;\n"
+                                     "      y = z;\n"
+                                     "      z = 0;\n"
+                                     "      break;\n"
+                                     "\n");
+
+          svn_stringbuf_appendcstr(modified, block);
+        }
+    }
+  else
+    {
+      /* Blocks of 50 lines in random order. */
+      int block_count = MAX(1, line_count / 50);
+      int *order = apr_palloc(pool, block_count * sizeof(*order));
+      int k;
+
+      for (i = 0; i < block_count; i++)
+        order[i] = i;
+
+      for (i = 0; i < block_count; i++)
+        {
+          int j, temp;
+
+          *seed = *seed * 1103515245 + 12345;
+          j = (*seed >> 8) % block_count;
+          temp = order[i];
+          order[i] = order[j];
+          order[j] = temp;
+        }
+
+      for (i = 0; i < block_count; i++)
+        for (k = 0; k < 50; k++)
+          {
+            svn_stringbuf_appendcstr(original,
+                                     apr_psprintf(pool, "line %d\n",
+                                                  i * 50 + k));
+            svn_stringbuf_appendcstr(modified,
+                                     apr_psprintf(pool, "line %d\n",
+                                                  order[i] * 50 + k));
+          }
+    }
+}
+
+/* Return the peak resident set size of this process in kB, or 0 if that
+ * is not available on this platform. */
+static apr_int64_t
+get_peak_rss(void)
+{
+#ifndef WIN32
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    return usage.ru_maxrss;
+#endif
+
+  return 0;
+}
+
+/* Implements bench_func_t comparing the default diff algorithm with the
+ * histogram diff on inputs that are hard for the former:  Files with
+ * many changes to lines that aren't unique, like lockfiles and generated
+ * code, and files with moved blocks.  The texts have about PARAMS->SIZE
+ * / 32 lines.  Report the time, by how much the peak memory usage of the
+ * process grew and the size of the resulting diff.  Since the peak can
+ * only go up, the histogram diff, which needs less memory, goes first. */
+static svn_error_t *
+run_diff(const bench_params_t *params,
+         apr_pool_t *pool)
+{
+  static const char *kinds[] = { "lockfile", "generated", "moved" };
+  static const struct
+  {
+    const char *name;
+    svn_diff_file_algorithm_t algorithm;
+  } algorithms[] =
+  {
+    { "histogram", svn_diff_file_algorithm_histogram },
+    { "default", svn_diff_file_algorithm_default }
+  };
+  static const svn_diff_output_fns_t count_fns = { NULL, count_changes };
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_diff_file_options_t *options = svn_diff_file_options_create(pool);
+  int line_count = (int)(params->size / 32);
+  apr_size_t i, k;
+
+  for (i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+    {
+      svn_stringbuf_t *original = svn_stringbuf_create_empty(pool);
+      svn_stringbuf_t *modified = svn_stringbuf_create_empty(pool);
+      apr_uint32_t seed = 0xd1ff;
+
+      const svn_string_t *original_str, *modified_str;
+
+      make_diff_texts(original, modified, kinds[i], line_count, &seed,
+                      pool);
+      original_str = svn_string_create_from_buf(original, pool);
+      modified_str = svn_string_create_from_buf(modified, pool);
+
+      for (k = 0; k < sizeof(algorithms) / sizeof(algorithms[0]); k++)
+        {
+          apr_off_t counts[2] = { 0, 0 };
+          apr_int64_t peak_rss = get_peak_rss();
+          svn_diff_t *diff;
+          apr_time_t start;
+
+          svn_pool_clear(iterpool);
+          options->algorithm = algorithms[k].algorithm;
+
+          start = apr_time_now();
+          SVN_ERR(svn_diff_mem_string_diff(&diff, original_str,
+                                           modified_str, options,
+                                           iterpool));
+
+          SVN_ERR(print_latency(algorithms[k].name,
+                                apr_psprintf(iterpool, "%s, %d lines",
+                                             kinds[i], line_count),
+                                1, start, iterpool));
+          SVN_ERR(svn_cmdline_printf(iterpool,
+                                     "%-12s peak memory +%" APR_INT64_T_FMT
+                                     " kB\n",
+                                     "", get_peak_rss() - peak_rss));
+
+          SVN_ERR(svn_diff_output2(diff, counts, &count_fns, NULL, NULL));
+          SVN_ERR(svn_cmdline_printf(iterpool,
+                                     "%-12s %" APR_OFF_T_FMT " changes, %"
+                                     APR_OFF_T_FMT " changed lines\n",
+                                     "", counts[0], counts[1]));
+        }
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Write the LEN bytes at DATA to a temporary file that will be removed
+ * when POOL gets cleaned up.  Return its path in *PATH. */
+static svn_error_t *
+write_temp_file(const char **path,
+                const char *data,
+                apr_size_t len,
+                apr_pool_t *pool)
+{
+  apr_file_t *file;
+
+  SVN_ERR(svn_io_open_unique_file3(&file, path, NULL,
+                                   svn_io_file_del_on_pool_cleanup,
+                                   pool, pool));
+  SVN_ERR(svn_io_file_write_full(file, data, len, NULL, pool));
+
+  return svn_error_trace(svn_io_file_close(file, pool));
+}
+
+/* Write three large generated files with one line per byte of
+ * PARAMS->SIZE each, i.e. 1M lines by default, to temporary files that
+ * will be removed when POOL gets cleaned up.  Return their paths in
+ * PATHS.  Half of the lines are unique, the others repeat a few
+ * patterns.  The second and third file each change about 1% of the
+ * lines of the first one. */
+static svn_error_t *
+make_large_diff_files(const char *paths[3],
+                      const bench_params_t *params,
+                      apr_pool_t *pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_stringbuf_t *texts[3];
+  apr_size_t line_count = params->size;
+  apr_uint32_t seed = 0x1a7e;
+  apr_size_t i;
+
+  for (i = 0; i < 3; i++)
+    texts[i] = svn_stringbuf_create_ensure(line_count * 24, iterpool);
+
+  for (i = 0; i < line_count; i++)
+    {
+      char line[64];
+      apr_uint32_t r;
+
+      seed = seed * 1103515245 + 12345;
+      if (i % 2)
+        apr_snprintf(line, sizeof(line),
+                     "    \"id_%" APR_SIZE_T_FMT "\": %u,\n",
+                     i, (seed >> 8) % 100000);
+      else
+        apr_snprintf(line, sizeof(line), "    \"field\": %u,\n",
+                     (unsigned)(i % 64));
+
+      r = (seed >> 20) % 200;
+      svn_stringbuf_appendcstr(texts[0], line);
+      if (r == 0)
+        continue;
+
+      if (r == 1)
+        svn_stringbuf_appendcstr(texts[1], "    \"new\": 1,\n");
+      svn_stringbuf_appendcstr(texts[1], line);
+
+      if (r == 2)
+        continue;
+      if (r == 3)
+        svn_stringbuf_appendcstr(texts[2], "    \"other\": 1,\n");
+      svn_stringbuf_appendcstr(texts[2], line);
+    }
+
+  for (i = 0; i < 3; i++)
+    SVN_ERR(write_temp_file(&paths[i], texts[i]->data, texts[i]->len,
+                            pool));
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements bench_func_t for 2-way and 3-way diffs of the files created
+ * by make_large_diff_files().
+ *
+ * The execution time is dominated by the tokenization of the files.  Use
+ * a tool like "/usr/bin/time -v" to see the peak memory usage. */
+static svn_error_t *
+run_diff_large(const bench_params_t *params,
+               apr_pool_t *pool)
+{
+  static const int thread_counts[] = { 0, 4 };
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_diff_file_options_t *options = svn_diff_file_options_create(pool);
+  const char *paths[3];
+  svn_diff_t *diff;
+  apr_time_t start;
+  apr_size_t i;
+
+  SVN_ERR(make_large_diff_files(paths, params, pool));
+
+  for (i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++)
+    {
+      const char *label;
+
+      svn_pool_clear(iterpool);
+      options->max_threads = thread_counts[i];
+      label = apr_psprintf(iterpool,
+                           "%" APR_SIZE_T_FMT " lines, %d threads",
+                           params->size, options->max_threads);
+
+      start = apr_time_now();
+      SVN_ERR(svn_diff_file_diff_2(&diff, paths[0], paths[1], options,
+                                   iterpool));
+      SVN_ERR(print_latency("diff", label, 1, start, iterpool));
+
+      start = apr_time_now();
+      SVN_ERR(svn_diff_file_diff3_2(&diff, paths[0], paths[1], paths[2],
+                                    options, iterpool));
+      SVN_ERR(print_latency("diff3", label, 1, start, iterpool));
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Implements bench_func_t for windowed 3-way diffs of the files created
+ * by make_large_diff_files(), with decreasing memory bounds.  Report
+ * by how much the peak memory usage of the process grew.  Since that
+ * can only go up, the runs with smaller windows go first. */
+static svn_error_t *
+run_merge_large(const bench_params_t *params,
+                apr_pool_t *pool)
+{
+  static const apr_off_t windows[] = { 16384, 65536, 262144, 1048576, 0 };
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_diff_file_options_t *options = svn_diff_file_options_create(pool);
+  const char *paths[3];
+  apr_size_t i;
+
+  SVN_ERR(make_large_diff_files(paths, params, pool));
+
+  for (i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+    {
+      apr_int64_t peak_rss = get_peak_rss();
+      svn_diff_t *diff;
+      apr_time_t start;
+
+      svn_pool_clear(iterpool);
+      options->diff3_window_lines = windows[i];
+
+      start = apr_time_now();
+      SVN_ERR(svn_diff_file_diff3_2(&diff, paths[0], paths[1], paths[2],
+                                    options, iterpool));
+      SVN_ERR(print_latency("diff3",
+                            windows[i]
+                              ? apr_psprintf(iterpool,
+                                             "%" APR_OFF_T_FMT
+                                             " line windows", windows[i])
+                              : "no window",
+                            1, start, iterpool));
+      SVN_ERR(svn_cmdline_printf(iterpool,
+                                 "%-12s peak memory +%" APR_INT64_T_FMT
+                                 " kB\n",
+                                 "", get_peak_rss() - peak_rss));
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+#if APR_HAS_THREADS
+
+/* Per-thread data for the membuffer cache benchmark. */
+typedef struct cache_reader_t
+{
+  /* The shared cache and the number of items in it. */
+  svn_membuffer_t *membuffer;
+  apr_uint32_t item_count;
+
+  /* Number of lookups to do and the random number generator state. */
+  int lookups;
+  apr_uint32_t seed;
+
+  /* Number of items found.  */
+  int hits;
+
+  /* Result of the thread's work. */
+  svn_error_t *err;
+} cache_reader_t;
+
+/* Look up READER->LOOKUPS random items in READER->MEMBUFFER through a
+ * private cache front-end, just like parallel svnserve connections do.
+ * Use POOL for allocations. */
+static svn_error_t *
+read_cache_items(cache_reader_t *reader,
+                 apr_pool_t *pool)
+{
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_cache__t *cache;
+  int i;
+
+  SVN_ERR(svn_cache__create_membuffer_cache(
+              &cache, reader->membuffer, NULL, NULL, sizeof(apr_uint32_t),
+              "bench:", SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY, FALSE, FALSE,
+              pool, pool));
+
+  for (i = 0; i < reader->lookups; ++i)
+    {
+      apr_uint32_t key;
+      svn_stringbuf_t *value;
+      svn_boolean_t found;
+
+      reader->seed = reader->seed * 1103515245 + 12345;
+      key = (reader->seed >> 16) % reader->item_count;
+
+      if (i % 256 == 0)
+        svn_pool_clear(iterpool);
+
+      SVN_ERR(svn_cache__get((void **)&value, &found, cache, &key,
+                             iterpool));
+      reader->hits += found;
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+/* Thread function running read_cache_items() for DATA. */
+static void *
+APR_THREAD_FUNC cache_reader_thread(apr_thread_t *tid, void *data)
+{
+  cache_reader_t *reader = data;
+  apr_pool_t *pool = svn_pool_create(NULL);
+
+  reader->err = read_cache_items(reader, pool);
+
+  svn_pool_destroy(pool);
+  apr_thread_exit(tid, APR_SUCCESS);
+
+  return NULL;
+}
+
+/* Let THREAD_COUNT threads concurrently look up a total of LOOKUPS random
+ * items out of the first ITEM_COUNT ones in MEMBUFFER and print the
+ * number of cache hits per second.  Use POOL for allocations. */
+static svn_error_t *
+read_cache_concurrently(svn_membuffer_t *membuffer,
+                        apr_uint32_t item_count,
+                        int thread_count,
+                        int lookups,
+                        apr_pool_t *pool)
+{
+  apr_thread_t **threads = apr_palloc(pool,
+                                      thread_count * sizeof(*threads));
+  cache_reader_t *readers = apr_pcalloc(pool,
+                                        thread_count * sizeof(*readers));
+  svn_error_t *err = SVN_NO_ERROR;
+  apr_status_t status;
+  apr_uint64_t hits = 0;
+  apr_time_t start = apr_time_now();
+  int i;
+
+  for (i = 0; i < thread_count; ++i)
+    {
+      readers[i].membuffer = membuffer;
+      readers[i].item_count = item_count;
+      readers[i].lookups = lookups / thread_count;
+      readers[i].seed = (apr_uint32_t)i;
+
+      status = apr_thread_create(&threads[i], NULL, cache_reader_thread,
+                                 &readers[i], pool);
+      if (status)
+        return svn_error_wrap_apr(status, "Can't create thread");
+    }
+
+  for (i = 0; i < thread_count; ++i)
+    {
+      apr_status_t retval;
+
+      status = apr_thread_join(&retval, threads[i]);
+      if (status)
+        return svn_error_wrap_apr(status, "Can't join thread");
+
+      err = svn_error_compose_create(err, readers[i].err);
+      hits += readers[i].hits;
+    }
+
+  SVN_ERR(err);
+
+  return svn_error_trace(print_rate("membuffer",
+                                    apr_psprintf(pool, "%d threads",
+                                                 thread_count),
+                                    hits, start, pool));
+}
+
+/* Implements bench_func_t for svn_cache__get() on a membuffer cache of
+ * PARAMS->SIZE bytes that contains all requested items, with 1 to 128
+ * concurrent readers.  Each configuration does 1000 * PARAMS->PASSES
+ * lookups in total, once with and once without lock-free reads. */
+static svn_error_t *
+run_membuffer(const bench_params_t *params,
+              apr_pool_t *pool)
+{
+  enum { ITEM_SIZE = 64 };
+  apr_pool_t *iterpool = svn_pool_create(pool);
+  svn_membuffer_t *membuffer;
+  svn_cache__t *cache;
+  svn_stringbuf_t *value = svn_stringbuf_ncreate(params->data, ITEM_SIZE,
+                                                 pool);
+  apr_uint32_t item_count = (apr_uint32_t)(params->size / 1024);
+  apr_uint32_t key;
+  int optimistic;
+  int thread_count;
+
+  /* Same configuration as the global membuffer cache. */
+  SVN_ERR(svn_cache__membuffer_cache_create(&membuffer, params->size,
+                                            params->size / 5, 0,
+                                            TRUE, FALSE, FALSE, pool));
+  SVN_ERR(svn_cache__create_membuffer_cache(
+              &cache, membuffer, NULL, NULL, sizeof(apr_uint32_t),
+              "bench:", SVN_CACHE__MEMBUFFER_DEFAULT_PRIORITY, FALSE, FALSE,
+              pool, pool));
+
+  /* The cache index can hold about 2 entries per kB.  Leave plenty of
+   * room, so all items will remain cached. */
+  for (key = 0; key < item_count; ++key)
+    SVN_ERR(svn_cache__set(cache, &key, value, pool));
+
+  for (optimistic = 0; optimistic <= 1; ++optimistic)
+    {
+      SVN_ERR(svn_cmdline_printf(pool, "%s:\n",
+                                 optimistic ? "lock-free reads"
+                                            : "locked reads"));
+      svn_cache__membuffer_set_optimistic_reads(membuffer, optimistic);
+
+      for (thread_count = 1; thread_count <= 128; thread_count *= 2)
+        {
+          svn_pool_clear(iterpool);
+          SVN_ERR(read_cache_concurrently(membuffer, item_count,
+                                          thread_count,
+                                          params->passes * 1000,
+                                          iterpool));
+        }
+    }
+
+  svn_pool_destroy(iterpool);
+
+  return SVN_NO_ERROR;
+}
+
+#endif
+
+/* All benchmarks that we know, addressed by name. */
+static const struct
+{
+  const char *name;
+  bench_func_t func;
+  const char *description;
+} benchmarks[] =
+{
+  { "adler32", run_adler32,
+    "Adler-32 and xdelta block checksums for all SIMD kernels" },
+  { "checksum", run_checksum,
+    "SHA-1, fused MD5 / SHA-1 and multi-buffer MD5 checksums" },
+  { "fnv1a", run_fnv1a,
+    "Modified FNV-1a for single and multiple buffers" },
+  { "utf8", run_utf8,
+    "UTF-8 validation of mixed text and of pure ASCII" },
+  { "subst", run_subst,
+    "EOL and keyword translation of source code-like text" },
+  { "base64", run_base64,
+    "base64 encoding and decoding with and without line breaks" },
+  { "compose", run_compose,
+    "Expanding delta chains of 1 to 1000 windows" },
+  { "diff", run_diff,
+    "Default and histogram diff of texts with many changes" },
+  { "diff-large", run_diff_large,
+    "2-way and 3-way diff of files with SIZE_KB * 1024 lines" },
+  { "merge-large", run_merge_large,
+    "Memory-bounded 3-way diff of files with SIZE_KB * 1024 lines" },
+#if APR_HAS_THREADS
+  { "membuffer", run_membuffer,
+    "Membuffer cache hits with 1 to 128 concurrent readers" },
+#endif
+  { NULL, NULL, NULL }
+};
+
+/* Print the usage message using POOL for temporaries. */
+static svn_error_t *
+print_usage(apr_pool_t *pool)
+{
+  int i;
+
+  SVN_ERR(svn_cmdline_printf(pool,
+            "usage: microbench BENCHMARK [SIZE_KB [PASSES]]\n"
+            "\n"
+            "Available benchmarks:\n"));
+  for (i = 0; benchmarks[i].name; ++i)
+    SVN_ERR(svn_cmdline_printf(pool, "  %-12s %s\n",
+                               benchmarks[i].name,
+                               benchmarks[i].description));
+
+  return SVN_NO_ERROR;
+}
+
+int main(int argc, const char *argv[])
+{
+  apr_pool_t *pool;
+  svn_error_t *err = SVN_NO_ERROR;
+  bench_params_t params;
+  apr_uint32_t seed = 0x5eed;
+  apr_size_t i;
+  int k;
+
+  if (svn_cmdline_init("microbench", stderr) != EXIT_SUCCESS)
+    return EXIT_FAILURE;
+
+  pool = svn_pool_create(NULL);
+
+  if (argc < 2 || argc > 4)
+    {
+      svn_error_clear(print_usage(pool));
+      return EXIT_FAILURE;
+    }
+
+  params.size = (argc > 2 ? atoi(argv[2]) : DEFAULT_SIZE_KB) * 1024;
+  params.passes = argc > 3 ? atoi(argv[3]) : DEFAULT_PASSES;
+  params.data = apr_palloc(pool, params.size);
+
+  /* Simple LCG to fill the buffer with incompressible data. */
+  for (i = 0; i < params.size; ++i)
+    {
+      seed = seed * 1103515245 + 12345;
+      params.data[i] = (char)(seed >> 16);
+    }
+
+  for (k = 0; benchmarks[k].name; ++k)
+    if (strcmp(benchmarks[k].name, argv[1]) == 0)
+      break;
+
+  if (benchmarks[k].name)
+    err = benchmarks[k].func(&params, pool);
+  else
+    err = print_usage(pool);
+
+  if (err)
+    return svn_cmdline_handle_exit_error(err, pool, "microbench: ");
+
+  svn_pool_destroy(pool);
+  return EXIT_SUCCESS;
+}